@@ -0,0 +1,95 @@
+#include "audioconvert.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+#ifdef CAPTURE_HAVE_SAMPLERATE
+#include <samplerate.h>
+#endif
+
+namespace {
+
+std::vector<float> randomSamples(size_t count) {
+  std::mt19937                          rng(42);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  std::vector<float>                    samples(count);
+  for (auto &sample : samples) {
+    sample = dist(rng);
+  }
+  return samples;
+}
+
+/** Arguments: channels, frames per packet */
+void BM_DownmixToMono(benchmark::State &state) {
+  const int32_t      channels = static_cast<int32_t>(state.range(0));
+  const size_t       frames   = static_cast<size_t>(state.range(1));
+  std::vector<float> src      = randomSamples(frames * channels);
+  std::vector<float> dst(frames);
+
+  for (auto _ : state) {
+    downmixToMono(src.data(), channels, frames, dst.data());
+    benchmark::DoNotOptimize(dst.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(frames));
+}
+
+/** Argument: samples per packet */
+void BM_FloatToInt16(benchmark::State &state) {
+  const size_t         count = static_cast<size_t>(state.range(0));
+  std::vector<float>   src   = randomSamples(count);
+  std::vector<int16_t> dst(count);
+
+  for (auto _ : state) {
+    convertFloatToInt16(src.data(), count, dst.data());
+    benchmark::DoNotOptimize(dst.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
+}
+
+#ifdef CAPTURE_HAVE_SAMPLERATE
+/** Arguments: libsamplerate converter type, channels; 48 kHz -> 16 kHz in 10 ms packets as a speech pipeline would */
+void BM_Resample(benchmark::State &state) {
+  const int          converter = static_cast<int>(state.range(0));
+  const int          channels  = static_cast<int>(state.range(1));
+  const long         inFrames  = 480;
+  const double       ratio     = 16000.0 / 48000.0;
+  std::vector<float> src       = randomSamples(static_cast<size_t>(inFrames) * channels);
+  std::vector<float> dst(static_cast<size_t>(inFrames * ratio + 1) * channels);
+
+  int        error     = 0;
+  SRC_STATE *resampler = src_new(converter, channels, &error);
+  if (!resampler) {
+    state.SkipWithError(src_strerror(error));
+    return;
+  }
+
+  for (auto _ : state) {
+    SRC_DATA data;
+    data.data_in       = src.data();
+    data.input_frames  = inFrames;
+    data.data_out      = dst.data();
+    data.output_frames = static_cast<long>(dst.size() / channels);
+    data.end_of_input  = 0;
+    data.src_ratio     = ratio;
+    src_process(resampler, &data);
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetItemsProcessed(state.iterations() * inFrames);
+  state.SetLabel(src_get_name(converter));
+  src_delete(resampler);
+}
+#endif
+
+} // namespace
+
+// 10 ms packets at 48 kHz, and a 100 ms burst
+BENCHMARK(BM_DownmixToMono)->Args({2, 480})->Args({2, 4800})->Args({6, 480})->Args({6, 4800});
+BENCHMARK(BM_FloatToInt16)->Arg(480)->Arg(960)->Arg(9600);
+
+#ifdef CAPTURE_HAVE_SAMPLERATE
+BENCHMARK(BM_Resample)
+    ->ArgsProduct({{SRC_SINC_BEST_QUALITY, SRC_SINC_MEDIUM_QUALITY, SRC_SINC_FASTEST, SRC_ZERO_ORDER_HOLD, SRC_LINEAR},
+                   {1, 2}})
+    ->Unit(benchmark::kMicrosecond);
+#endif
@@ -0,0 +1,76 @@
+#include "bufferpool.h"
+#include "colorconvert.h"
+#include "rawframe.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+using ConvertFunction = void (*)(const uint8_t *, int32_t, int32_t, int32_t, const YUVPlanes &);
+
+std::vector<uint8_t> randomFrame(int32_t width, int32_t height) {
+  std::mt19937         rng(42);
+  std::vector<uint8_t> frame(static_cast<size_t>(width) * height * 4);
+  for (auto &byte : frame) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  return frame;
+}
+
+void runConversion(benchmark::State &state, ConvertFunction convert, bool nv12) {
+  const int32_t        width  = static_cast<int32_t>(state.range(0));
+  const int32_t        height = static_cast<int32_t>(state.range(1));
+  std::vector<uint8_t> src    = randomFrame(width, height);
+  std::vector<uint8_t> dst(yuv420FrameSize(width, height));
+  YUVPlanes            planes = nv12 ? nv12Planes(dst.data(), width, height) : i420Planes(dst.data(), width, height);
+
+  for (auto _ : state) {
+    convert(src.data(), width * 4, width, height, planes);
+    benchmark::DoNotOptimize(dst.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(src.size()));
+  state.SetLabel(colorConvertBackend());
+}
+
+void BM_BGRAToI420(benchmark::State &state) {
+  runConversion(state, convertBGRAToI420, false);
+}
+
+void BM_BGRAToI420Scalar(benchmark::State &state) {
+  runConversion(state, convertBGRAToI420Scalar, false);
+}
+
+void BM_BGRAToNV12(benchmark::State &state) {
+  runConversion(state, convertBGRAToNV12, true);
+}
+
+void BM_BGRAToNV12Scalar(benchmark::State &state) {
+  runConversion(state, convertBGRAToNV12Scalar, true);
+}
+
+/** Full delivery-side cost: pooled buffer acquisition plus conversion */
+void BM_PackRawFrameI420(benchmark::State &state) {
+  const int32_t        width  = static_cast<int32_t>(state.range(0));
+  const int32_t        height = static_cast<int32_t>(state.range(1));
+  std::vector<uint8_t> src    = randomFrame(width, height);
+  auto                 pool   = FrameBufferPool::create();
+
+  for (auto _ : state) {
+    RawFrame frame;
+    packRawFrame(*pool, ImageFormat::I420, src.data(), width, height, width * 4, frame);
+    benchmark::DoNotOptimize(frame.buffer->data());
+  }
+  state.counters["allocations"] = static_cast<double>(pool->allocationCount());
+}
+
+} // namespace
+
+#define FRAME_SIZES Args({1280, 720})->Args({1920, 1080})->Args({3840, 2160})->Unit(benchmark::kMicrosecond)
+
+BENCHMARK(BM_BGRAToI420)->FRAME_SIZES;
+BENCHMARK(BM_BGRAToI420Scalar)->FRAME_SIZES;
+BENCHMARK(BM_BGRAToNV12)->FRAME_SIZES;
+BENCHMARK(BM_BGRAToNV12Scalar)->FRAME_SIZES;
+BENCHMARK(BM_PackRawFrameI420)->FRAME_SIZES;
@@ -0,0 +1,89 @@
+// End-to-end delivery benchmark: native capture -> N-API thread-safe function -> JS listener.
+//
+// Runs the synthetic Linux backend at a frame rate far above what the pipeline
+// can reach and counts what arrives in the 'video-frame' and 'audio-data'
+// listeners. Prints one JSON document to stdout so results can be archived
+// next to capture_core_bench.json.
+//
+//   node bench/delivery.mjs [seconds]
+//
+// Audio is paced in real time by the synthetic source (one packet per 10 ms),
+// so audio packets/s shows whether delivery keeps up rather than a ceiling.
+import { monitorEventLoopDelay } from "node:perf_hooks";
+
+const seconds = Number(process.argv[2] ?? 5);
+const cases = [
+  { width: 1280, height: 720, imageFormat: "bgra" },
+  { width: 1920, height: 1080, imageFormat: "bgra" },
+  { width: 1920, height: 1080, imageFormat: "i420" },
+  { width: 1280, height: 720, imageFormat: "jpeg" },
+  { width: 1920, height: 1080, imageFormat: "jpeg" },
+];
+
+process.env.DESKTOP_CAPTURE_VIDEO_BACKEND = "synthetic";
+process.env.DESKTOP_CAPTURE_AUDIO_BACKEND = "synthetic";
+const { MediaCapture } = await import("../index.mjs");
+
+async function run({ width, height, imageFormat }) {
+  process.env.DESKTOP_CAPTURE_SYNTHETIC = `displays=${width}x${height};pattern=bars`;
+
+  const capture = new MediaCapture();
+  let frames = 0;
+  let frameBytes = 0;
+  let packets = 0;
+  let samples = 0;
+  capture.on("video-frame", (frame) => {
+    frames++;
+    frameBytes += frame.data.byteLength;
+  });
+  capture.on("audio-data", (data) => {
+    packets++;
+    samples += data.length;
+  });
+
+  const lag = monitorEventLoopDelay({ resolution: 1 });
+  await capture.startCapture({
+    displayId: 1,
+    frameRate: 10000,
+    imageFormat,
+    audioSampleRate: 48000,
+    audioChannels: 2,
+  });
+  lag.enable();
+  const start = process.hrtime.bigint();
+  await new Promise((resolve) => setTimeout(resolve, seconds * 1000));
+  const elapsed = Number(process.hrtime.bigint() - start) / 1e9;
+  lag.disable();
+  await capture.stopCapture();
+
+  return {
+    name: `delivery/${width}x${height}/${imageFormat}`,
+    seconds: elapsed,
+    frames_per_second: frames / elapsed,
+    bytes_per_second: frameBytes / elapsed,
+    audio_packets_per_second: packets / elapsed,
+    audio_samples_per_second: samples / elapsed,
+    event_loop_delay_p99_ms: lag.percentile(99) / 1e6,
+  };
+}
+
+const benchmarks = [];
+for (const c of cases) {
+  benchmarks.push(await run(c));
+}
+
+console.log(
+  JSON.stringify(
+    {
+      context: {
+        date: new Date().toISOString(),
+        node: process.version,
+        platform: process.platform,
+        arch: process.arch,
+      },
+      benchmarks,
+    },
+    null,
+    2
+  )
+);
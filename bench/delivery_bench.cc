@@ -0,0 +1,104 @@
+#include "capture/capture.h"
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+namespace {
+
+/** Counts frames delivered by the C API */
+struct Counter {
+  std::mutex              mutex;
+  std::condition_variable cv;
+  int64_t                 frames = 0;
+  int64_t                 bytes  = 0;
+};
+
+void onVideo(uint8_t *, int32_t, int32_t, int32_t, const char *, const char *, size_t size, void *ctx) {
+  auto *counter = static_cast<Counter *>(ctx);
+  {
+    std::lock_guard<std::mutex> lock(counter->mutex);
+    counter->frames++;
+    counter->bytes += static_cast<int64_t>(size);
+  }
+  counter->cv.notify_one();
+}
+
+void onExit(char *, void *) {}
+
+/**
+ * Capture-to-callback throughput of the native pipeline with the synthetic
+ * backend: source, crop copy, encode and hand-off, everything except the
+ * JavaScript listener (see delivery.mjs for that part).
+ *
+ * Arguments: width, height, 0 = raw BGRA / 1 = JPEG. The frame rate is set far
+ * above what the pipeline can reach, so the pacing sleep never kicks in.
+ */
+void BM_DeliverFrames(benchmark::State &state) {
+  const int32_t width  = static_cast<int32_t>(state.range(0));
+  const int32_t height = static_cast<int32_t>(state.range(1));
+  const bool    jpeg   = state.range(2) != 0;
+
+  std::string synthetic = "displays=" + std::to_string(width) + "x" + std::to_string(height) + ";pattern=bars";
+  setenv("DESKTOP_CAPTURE_SYNTHETIC", synthetic.c_str(), 1);
+  setenv("DESKTOP_CAPTURE_VIDEO_BACKEND", "synthetic", 1);
+
+  MediaCaptureConfigC config;
+  std::memset(&config, 0, sizeof(config));
+  config.frameRate   = 10000.0f;
+  config.displayID   = 1;
+  config.imageFormat = jpeg ? 0 : 1;
+
+  Counter counter;
+  void   *capture = createMediaCapture();
+  startMediaCapture(capture, config, onVideo, nullptr, onExit, &counter);
+
+  // Each iteration waits for a fixed number of frames; the first frame primes the pipeline
+  constexpr int64_t kFramesPerIteration = 10;
+  int64_t           target              = 1;
+  {
+    std::unique_lock<std::mutex> lock(counter.mutex);
+    if (!counter.cv.wait_for(lock, std::chrono::seconds(5), [&] { return counter.frames >= target; })) {
+      lock.unlock();
+      stopMediaCapture(capture, nullptr, nullptr);
+      destroyMediaCapture(capture);
+      state.SkipWithError("no frames delivered");
+      return;
+    }
+    target = counter.frames;
+  }
+  int64_t startBytes = counter.bytes;
+
+  for (auto _ : state) {
+    target += kFramesPerIteration;
+    auto                         start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(counter.mutex);
+    counter.cv.wait(lock, [&] { return counter.frames >= target; });
+    state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  stopMediaCapture(capture, nullptr, nullptr);
+  destroyMediaCapture(capture);
+  unsetenv("DESKTOP_CAPTURE_SYNTHETIC");
+  unsetenv("DESKTOP_CAPTURE_VIDEO_BACKEND");
+
+  state.counters["frames_per_second"] =
+      benchmark::Counter(static_cast<double>(state.iterations() * kFramesPerIteration), benchmark::Counter::kIsRate);
+  state.counters["bytes_per_second"] =
+      benchmark::Counter(static_cast<double>(counter.bytes - startBytes), benchmark::Counter::kIsRate);
+  state.SetLabel(jpeg ? "jpeg" : "bgra");
+}
+
+} // namespace
+
+BENCHMARK(BM_DeliverFrames)
+    ->Args({1280, 720, 0})
+    ->Args({1920, 1080, 0})
+    ->Args({3840, 2160, 0})
+    ->Args({1280, 720, 1})
+    ->Args({1920, 1080, 1})
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
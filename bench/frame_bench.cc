@@ -0,0 +1,83 @@
+#include "capture/capture.h"
+#include "croprect.h"
+#include "jpegcodec.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+/** BGRA frame whose rows are padded like a mapped GPU texture */
+struct PaddedFrame {
+  int32_t              width;
+  int32_t              height;
+  int32_t              bytesPerRow;
+  std::vector<uint8_t> pixels;
+};
+
+PaddedFrame randomFrame(int32_t width, int32_t height) {
+  PaddedFrame frame;
+  frame.width       = width;
+  frame.height      = height;
+  frame.bytesPerRow = (width * 4 + 255) & ~255;
+  frame.pixels.resize(static_cast<size_t>(frame.bytesPerRow) * height);
+
+  std::mt19937 rng(42);
+  for (auto &byte : frame.pixels) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  return frame;
+}
+
+/** Row-by-row copy out of the mapped texture, as processFrame does for the full target */
+void BM_CopyFrameRegion(benchmark::State &state) {
+  PaddedFrame          src = randomFrame(static_cast<int32_t>(state.range(0)), static_cast<int32_t>(state.range(1)));
+  MediaCaptureRectC    region = {0, 0, src.width, src.height};
+  std::vector<uint8_t> dst(static_cast<size_t>(src.width) * 4 * src.height);
+
+  for (auto _ : state) {
+    copyFrameRegion(src.pixels.data(), src.bytesPerRow, region, 4, dst.data(), src.width * 4);
+    benchmark::DoNotOptimize(dst.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(dst.size()));
+}
+
+/**
+ * JPEG at the default (medium) quality. Random pixels are the worst case for
+ * the entropy coder, so a smooth gradient with some detail is used instead.
+ */
+void BM_EncodeJPEG(benchmark::State &state) {
+  if (!jpegCodecAvailable()) {
+    state.SkipWithError("built without a JPEG codec");
+    return;
+  }
+
+  const int32_t        width  = static_cast<int32_t>(state.range(0));
+  const int32_t        height = static_cast<int32_t>(state.range(1));
+  std::vector<uint8_t> src(static_cast<size_t>(width) * height * 4);
+  for (int32_t y = 0; y < height; y++) {
+    for (int32_t x = 0; x < width; x++) {
+      uint8_t *pixel = &src[(static_cast<size_t>(y) * width + x) * 4];
+      pixel[0]       = static_cast<uint8_t>(x * 255 / width);
+      pixel[1]       = static_cast<uint8_t>(y * 255 / height);
+      pixel[2]       = static_cast<uint8_t>(((x / 8) ^ (y / 8)) & 1 ? 200 : 40);
+      pixel[3]       = 255;
+    }
+  }
+
+  std::vector<uint8_t> jpeg;
+  for (auto _ : state) {
+    encodeJPEG(src.data(), width, height, width * 4, 75, jpeg);
+    benchmark::DoNotOptimize(jpeg.data());
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(src.size()));
+  state.counters["jpeg_bytes"] = static_cast<double>(jpeg.size());
+}
+
+} // namespace
+
+#define FRAME_SIZES Args({1280, 720})->Args({1920, 1080})->Args({3840, 2160})->Unit(benchmark::kMicrosecond)
+
+BENCHMARK(BM_CopyFrameRegion)->FRAME_SIZES;
+BENCHMARK(BM_EncodeJPEG)->FRAME_SIZES;
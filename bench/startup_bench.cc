@@ -0,0 +1,116 @@
+#include "capture/capture.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/** Records when the first frame and the first audio packet arrive */
+struct FirstArrival {
+  std::mutex              mutex;
+  std::condition_variable cv;
+  Clock::time_point       video;
+  Clock::time_point       audio;
+  bool                    sawVideo = false;
+  bool                    sawAudio = false;
+};
+
+void onVideo(uint8_t *, int32_t, int32_t, int32_t, const char *, const char *, size_t, void *ctx) {
+  auto *arrival = static_cast<FirstArrival *>(ctx);
+  {
+    std::lock_guard<std::mutex> lock(arrival->mutex);
+    if (arrival->sawVideo) {
+      return;
+    }
+    arrival->video    = Clock::now();
+    arrival->sawVideo = true;
+  }
+  arrival->cv.notify_one();
+}
+
+void onAudio(int32_t, int32_t, float *, int32_t, void *ctx) {
+  auto *arrival = static_cast<FirstArrival *>(ctx);
+  {
+    std::lock_guard<std::mutex> lock(arrival->mutex);
+    if (arrival->sawAudio) {
+      return;
+    }
+    arrival->audio    = Clock::now();
+    arrival->sawAudio = true;
+  }
+  arrival->cv.notify_one();
+}
+
+void onExit(char *, void *) {}
+
+/**
+ * Time from startMediaCapture() to the first video frame and the first audio
+ * packet with the synthetic backend, cold or after prepareMediaCapture().
+ * The iteration time is the later of the two; creating the instance and
+ * preparing it are not timed.
+ *
+ * Argument: 0 = cold start / 1 = prepared start.
+ */
+void BM_TimeToFirstData(benchmark::State &state) {
+  const bool prepared = state.range(0) != 0;
+
+  setenv("DESKTOP_CAPTURE_SYNTHETIC", "displays=1920x1080;pattern=bars", 1);
+  setenv("DESKTOP_CAPTURE_VIDEO_BACKEND", "synthetic", 1);
+
+  MediaCaptureConfigC config;
+  std::memset(&config, 0, sizeof(config));
+  config.frameRate       = 30.0f;
+  config.displayID       = 1;
+  config.imageFormat     = 1;
+  config.audioSampleRate = 48000;
+  config.audioChannels   = 2;
+
+  double videoMs = 0;
+  double audioMs = 0;
+  for (auto _ : state) {
+    FirstArrival arrival;
+    void        *capture = createMediaCapture();
+    if (prepared) {
+      prepareMediaCapture(capture, config, onExit, nullptr);
+    }
+
+    auto start = Clock::now();
+    startMediaCapture(capture, config, onVideo, onAudio, onExit, &arrival);
+    bool ok;
+    {
+      std::unique_lock<std::mutex> lock(arrival.mutex);
+      ok = arrival.cv.wait_for(lock, std::chrono::seconds(5), [&] { return arrival.sawVideo && arrival.sawAudio; });
+    }
+    stopMediaCapture(capture, nullptr, nullptr);
+    destroyMediaCapture(capture);
+    if (!ok) {
+      state.SkipWithError("no first frame or audio packet");
+      break;
+    }
+
+    double video = std::chrono::duration<double, std::milli>(arrival.video - start).count();
+    double audio = std::chrono::duration<double, std::milli>(arrival.audio - start).count();
+    videoMs += video;
+    audioMs += audio;
+    state.SetIterationTime(std::max(video, audio) / 1000.0);
+  }
+
+  unsetenv("DESKTOP_CAPTURE_SYNTHETIC");
+  unsetenv("DESKTOP_CAPTURE_VIDEO_BACKEND");
+
+  if (state.iterations() > 0) {
+    state.counters["first_frame_ms"] = videoMs / static_cast<double>(state.iterations());
+    state.counters["first_audio_ms"] = audioMs / static_cast<double>(state.iterations());
+  }
+  state.SetLabel(prepared ? "prepared" : "cold");
+}
+
+} // namespace
+
+BENCHMARK(BM_TimeToFirstData)->Arg(0)->Arg(1)->UseManualTime()->Unit(benchmark::kMillisecond);
@@ -3,12 +3,13 @@
  * @brief Desktop/window audio and video capture APIs
  * 
  * This header defines structures and functions for capturing audio and video
- * from desktop displays and application windows on macOS and Windows.
+ * from desktop displays and application windows on macOS, Windows and Linux.
  */
 
 #ifndef _CAPTURE_H_
 #define _CAPTURE_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -62,6 +63,19 @@ struct MediaCaptureTargetC {
 
 typedef struct MediaCaptureTargetC MediaCaptureTargetC;
 
+/**
+ * @struct MediaCaptureRectC
+ * @brief Rectangle in target coordinates (pixels on Windows, points on macOS)
+ */
+struct MediaCaptureRectC {
+  int32_t x;      /**< Left edge */
+  int32_t y;      /**< Top edge */
+  int32_t width;  /**< Width; 0 selects the full target */
+  int32_t height; /**< Height; 0 selects the full target */
+};
+
+typedef struct MediaCaptureRectC MediaCaptureRectC;
+
 /**
  * @struct MediaCaptureConfigC
  * @brief Media capture configuration (audio and video)
@@ -76,11 +90,106 @@ struct MediaCaptureConfigC {
   char*    bundleID;        /**< Application bundle ID for macOS (can be NULL) */
   int32_t  isElectron;      /**< 0=false(default), 1=true */
   int32_t  qualityValue;    /**< Precise JPEG quality value (0-100), overrides quality enum if > 0 */
-  int32_t  imageFormat;     /**< Image format (0=jpeg, 1=raw) */
+  int32_t  imageFormat;     /**< Image format (0=jpeg, 1=raw BGRA; I420/NV12 are converted from raw by the caller) */
+  MediaCaptureRectC cropRect; /**< Region of interest, clamped to the target (zero size = full target) */
+  float    maxEncodeMsPerFrame; /**< Adaptive quality: mean encode time budget per frame in ms (0 = no limit) */
+  float    maxBytesPerSecond;   /**< Adaptive quality: encoded output budget in bytes per second (0 = no limit) */
+  int32_t  minQualityValue;     /**< Adaptive quality: lowest JPEG quality (0 = default of 30) */
+  float    minScale;            /**< Adaptive quality: smallest downscale factor (0 = default of 0.25) */
+  float    minFrameRate;        /**< Adaptive quality: lowest frame rate (0 = default of 1) */
 };
 
 typedef struct MediaCaptureConfigC MediaCaptureConfigC;
 
+/**
+ * @struct MediaCaptureTargetRefC
+ * @brief One video target of a multi-target media capture
+ */
+struct MediaCaptureTargetRefC {
+  uint32_t          displayID; /**< Display to capture (0 if capturing a window) */
+  uint32_t          windowID;  /**< Window to capture (0 if capturing a display) */
+  MediaCaptureRectC cropRect;  /**< Region of interest (zero size = full target) */
+};
+
+typedef struct MediaCaptureTargetRefC MediaCaptureTargetRefC;
+
+/**
+ * @struct MediaCaptureRenditionC
+ * @brief One output rendition of a multi-rendition media capture
+ */
+struct MediaCaptureRenditionC {
+  float   frameRate;   /**< Frames per second (<= 0 uses the frame rate of the configuration) */
+  float   scale;       /**< Downscale factor of the captured frame (<= 0 or 1 = full size) */
+  int32_t maxWidth;    /**< Largest output width in pixels; the height follows (0 = no limit) */
+  int32_t imageFormat; /**< 0 = JPEG, 1 = raw BGRA */
+  int32_t quality;     /**< JPEG quality 1-100 (0 uses the quality of the configuration) */
+};
+
+typedef struct MediaCaptureRenditionC MediaCaptureRenditionC;
+
+/**
+ * @struct MediaCaptureQualityStatsC
+ * @brief State and decisions of the adaptive quality controller
+ */
+struct MediaCaptureQualityStatsC {
+  int32_t  quality;        /**< JPEG quality in effect */
+  float    scale;          /**< Downscale factor in effect (1 = full size) */
+  float    frameRate;      /**< Frame rate in effect */
+  float    encodeMs;       /**< Smoothed encode time per frame */
+  float    bytesPerSecond; /**< Smoothed encoded output rate */
+  float    queueDepth;     /**< Smoothed number of frames waiting for the encoder */
+  uint64_t downgrades;     /**< Number of downward adjustments */
+  uint64_t upgrades;       /**< Number of upward adjustments */
+  int32_t  lastAdjustment; /**< 0=none, 1=lower quality, 2=lower scale, 3=lower frame rate, 4-6=raise the same */
+  int32_t  lastPressure;   /**< Cause of the last downgrade: 0=none, 1=encode time, 2=bandwidth, 3=backlog */
+};
+
+typedef struct MediaCaptureQualityStatsC MediaCaptureQualityStatsC;
+
+/**
+ * @struct MediaCaptureStageStatsC
+ * @brief Latency distribution of one pipeline stage
+ */
+struct MediaCaptureStageStatsC {
+  uint64_t count;  /**< Number of samples */
+  float    meanMs; /**< Mean duration */
+  float    maxMs;  /**< Longest duration */
+  float    p50Ms;  /**< Median */
+  float    p90Ms;  /**< 90th percentile */
+  float    p99Ms;  /**< 99th percentile */
+  float    p999Ms; /**< 99.9th percentile */
+};
+
+typedef struct MediaCaptureStageStatsC MediaCaptureStageStatsC;
+
+/**
+ * @struct MediaCaptureStatsC
+ * @brief Counters and per-stage latencies of a running capture, cumulative since start
+ */
+struct MediaCaptureStatsC {
+  uint64_t framesCaptured;  /**< Frames read from the system */
+  uint64_t framesDelivered; /**< Frames encoded and handed to the video callback */
+  uint64_t framesDropped;   /**< Frames discarded because the encoder fell behind */
+  uint64_t encodeFailures;  /**< Frames the encoder failed on */
+  uint64_t acquireFailures; /**< Frames that could not be read, e.g. while a window is minimized */
+  uint64_t videoBytes;      /**< Bytes handed to the video callback */
+  uint64_t queueDepth;      /**< Frames currently waiting for the encoder */
+  MediaCaptureStageStatsC acquire;      /**< Waiting for and reading a frame */
+  MediaCaptureStageStatsC copy;         /**< Copying pixels out of the system buffer */
+  MediaCaptureStageStatsC queueWait;    /**< Time a frame waited for the encoder */
+  MediaCaptureStageStatsC encode;       /**< Encoding */
+  MediaCaptureStageStatsC videoDeliver; /**< Video callback invocation */
+  uint64_t audioPackets; /**< Packets handed to the audio callback */
+  uint64_t audioFrames;  /**< Sample frames handed to the audio callback */
+  uint64_t audioDropped; /**< Sample frames lost before delivery */
+  MediaCaptureStageStatsC audioAcquire; /**< Reading a packet from the system */
+  MediaCaptureStageStatsC downmix;      /**< Channel conversion */
+  MediaCaptureStageStatsC resample;     /**< Sample rate conversion */
+  MediaCaptureStageStatsC audioDeliver; /**< Audio callback invocation */
+};
+
+typedef struct MediaCaptureStatsC MediaCaptureStatsC;
+
 /**
  * @struct AudioFormatInfoC
  * @brief Detailed audio format information
@@ -119,6 +228,21 @@ typedef void (*EnumerateMediaCaptureTargetsCallback)(MediaCaptureTargetC*, int32
  */
 typedef void (*MediaCaptureDataCallback)(uint8_t*, int32_t, int32_t, int32_t, const char*, const char*, size_t, void*);
 
+/**
+ * @brief Callback for video frames of a multi-target capture
+ * @param targetIndex Index of the frame's target (or rendition) in the array passed to startMultiTargetMediaCapture
+ *                    (or startMultiRenditionMediaCapture)
+ * @param data Pointer to raw video frame data
+ * @param width Frame width in pixels
+ * @param height Frame height in pixels
+ * @param bytesPerRow Bytes per row (stride)
+ * @param timestamp Frame timestamp as string representing milliseconds since Unix epoch
+ * @param format Format string (e.g., "jpeg", "bgra")
+ * @param size Size of data in bytes
+ * @param context User data pointer
+ */
+typedef void (*MediaCaptureTargetDataCallback)(int32_t, uint8_t*, int32_t, int32_t, int32_t, const char*, const char*, size_t, void*);
+
 /**
  * @brief Callback for audio data
  * @param channels Number of audio channels
@@ -211,6 +335,17 @@ void startCapture(void*, CaptureConfig, StartCaptureDataCallback, StartCaptureEx
  */
 void stopCapture(void*, StopCaptureCallback, void*);
 
+/**
+ * @brief Read the audio counters and stage latencies of an audio capture
+ *
+ * Only the audio fields of MediaCaptureStatsC are filled.
+ *
+ * @param handle Pointer returned by createCapture
+ * @param stats Receives the statistics
+ * @return 1 if capture is running and stats were written, 0 otherwise
+ */
+int32_t getCaptureStats(void*, MediaCaptureStatsC*);
+
 /**
  * @brief Enumerate available media capture targets
  * @param type Target type filter (0=all, 1=display, 2=window)
@@ -231,6 +366,23 @@ void* createMediaCapture(void);
  */
 void destroyMediaCapture(void*);
 
+/**
+ * @brief Open capture resources ahead of startMediaCapture
+ *
+ * Opens the capture source of the configured target and the audio stream, so
+ * a following startMediaCapture with the same displayID, windowID and audio
+ * format only has to start them. A start with a different configuration
+ * releases them and opens its own; stopMediaCapture and destroyMediaCapture
+ * release them too. Preparing again replaces the previous preparation.
+ *
+ * @param handle Pointer returned by createMediaCapture
+ * @param config Capture configuration of the coming start
+ * @param callback Called once, possibly on another thread, with NULL when
+ *                 ready or an error message
+ * @param context User data pointer passed to callback
+ */
+void prepareMediaCapture(void*, MediaCaptureConfigC, MediaCaptureExitCallback, void*);
+
 /**
  * @brief Start media capture (audio and video)
  * @param handle Pointer returned by createMediaCapture
@@ -242,6 +394,50 @@ void destroyMediaCapture(void*);
  */
 void startMediaCapture(void*, MediaCaptureConfigC, MediaCaptureDataCallback, MediaCaptureAudioDataCallback, MediaCaptureExitCallback, void*);
 
+/**
+ * @brief Start media capture of several displays or windows in one session
+ *
+ * All targets share one capture thread (and, on Windows, one D3D device), one
+ * pool of encoder threads that serves the targets round-robin, and one
+ * delivery thread, so every frame callback comes from the same thread. The
+ * video fields of config apply to every target; its displayID and windowID
+ * only select the audio source, as in startMediaCapture. Stop with
+ * stopMediaCapture. Not supported on macOS.
+ *
+ * @param handle Pointer returned by createMediaCapture
+ * @param config Capture configuration
+ * @param targets Video targets, copied before the call returns
+ * @param targetCount Number of targets (at least 1)
+ * @param videoCallback Callback for video frames, tagged with the target index
+ * @param audioCallback Callback for audio data (can be NULL)
+ * @param exitCallback Callback for exit events
+ * @param context User data pointer passed to callbacks
+ */
+void startMultiTargetMediaCapture(void*, MediaCaptureConfigC, const MediaCaptureTargetRefC*, int32_t, MediaCaptureTargetDataCallback, MediaCaptureAudioDataCallback, MediaCaptureExitCallback, void*);
+
+/**
+ * @brief Start media capture of one target delivered in several renditions
+ *
+ * The target is acquired once for every rendition that is due, and the same
+ * copy of the frame is downscaled and encoded for each of them on a shared
+ * pool of encoder threads. Renditions run on a common timeline, so a 1 fps
+ * rendition shares every tenth acquisition of a 10 fps one. Every frame
+ * callback comes from one delivery thread. config selects the target, crop
+ * rectangle and audio; its frame rate, quality and image format are only the
+ * defaults of renditions that leave them unset, and adaptive quality is not
+ * applied. Stop with stopMediaCapture. Not supported on macOS.
+ *
+ * @param handle Pointer returned by createMediaCapture
+ * @param config Capture configuration
+ * @param renditions Output renditions, copied before the call returns
+ * @param renditionCount Number of renditions (at least 1)
+ * @param videoCallback Callback for video frames, tagged with the rendition index
+ * @param audioCallback Callback for audio data (can be NULL)
+ * @param exitCallback Callback for exit events
+ * @param context User data pointer passed to callbacks
+ */
+void startMultiRenditionMediaCapture(void*, MediaCaptureConfigC, const MediaCaptureRenditionC*, int32_t, MediaCaptureTargetDataCallback, MediaCaptureAudioDataCallback, MediaCaptureExitCallback, void*);
+
 /**
  * @brief Stop media capture
  * @param handle Pointer returned by createMediaCapture
@@ -250,6 +446,72 @@ void startMediaCapture(void*, MediaCaptureConfigC, MediaCaptureDataCallback, Med
  */
 void stopMediaCapture(void*, StopCaptureCallback, void*);
 
+/**
+ * @brief Change the region of interest of a running media capture
+ *
+ * Takes effect from the next frame without restarting the capture. A later
+ * startMediaCapture uses the cropRect of its own configuration. A
+ * multi-target capture applies it to every target. A crop that lies
+ * outside any captured target is rejected and the previous one is kept.
+ *
+ * @param handle Pointer returned by createMediaCapture
+ * @param cropRect New region of interest (zero size = full target)
+ * @param callback Called once, possibly on another thread, with NULL when
+ *                 applied or an error message
+ * @param context User data pointer passed to callback
+ */
+void setMediaCaptureCropRect(void*, MediaCaptureRectC, MediaCaptureExitCallback, void*);
+
+/**
+ * @brief Apply a new configuration to a running media capture without stopping it
+ *
+ * Frame rate, quality, image format, crop and the adaptive quality settings
+ * take effect between two frames, and the audio sample rate and channel
+ * count between two audio packets, without reopening the capture source or
+ * the audio device. Only a different displayID or windowID restarts the
+ * capture, with the callbacks of the running start. A multi-target capture
+ * keeps its targets; its displayID and windowID select the audio source.
+ *
+ * @param handle Pointer returned by createMediaCapture
+ * @param config Complete new configuration
+ * @param callback Called once, possibly on another thread, with NULL when
+ *                 applied or an error message
+ * @param context User data pointer passed to callback
+ */
+void reconfigureMediaCapture(void*, MediaCaptureConfigC, MediaCaptureExitCallback, void*);
+
+/**
+ * @brief Read the adaptive quality controller of a running media capture
+ * @param handle Pointer returned by createMediaCapture
+ * @param stats Receives the controller state
+ * @return 1 if adaptive quality is active, 0 otherwise (stats is left untouched)
+ */
+int32_t getMediaCaptureQualityStats(void*, MediaCaptureQualityStatsC*);
+
+/**
+ * @brief Read the counters and stage latencies of a media capture
+ * @param handle Pointer returned by createMediaCapture
+ * @param stats Receives the statistics
+ * @return 1 if capture is running and stats were written, 0 otherwise
+ */
+int32_t getMediaCaptureStats(void*, MediaCaptureStatsC*);
+
+/**
+ * @brief Start or stop recording trace spans of all captures in the process
+ *
+ * Enabling discards the spans of the previous session; disabling keeps them
+ * for writeCaptureTrace.
+ * @param enabled Non-zero to record
+ */
+void setCaptureTracing(int32_t);
+
+/**
+ * @brief Write the recorded spans as Chrome Trace Event JSON (loadable in Perfetto)
+ * @param path Destination file, replaced if it exists
+ * @return 1 on success, 0 if the file could not be written
+ */
+int32_t writeCaptureTrace(const char*);
+
 #ifdef __cplusplus
 }
 #endif
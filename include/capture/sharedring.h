@@ -0,0 +1,426 @@
+/**
+ * @file sharedring.h
+ * @brief Layout of the shared-memory frame ring, and a header-only reader for other processes
+ *
+ * A capture started with the `sharedMemory` option publishes every video frame
+ * and audio packet into a named shared-memory segment (POSIX shm_open, or a
+ * named file mapping on Windows). Any process can map it read-only and read
+ * the payloads in place, without a copy and without a round trip through the
+ * capturing process.
+ *
+ * The segment holds one ring of fixed-size slots per track. Each slot is
+ * guarded by a sequence lock: the writer makes the slot's sequence odd while it
+ * fills the slot and publishes 2n+2 when item n is complete. A reader checks
+ * the sequence before and after using a slot, so a slow reader never blocks
+ * the writer; it finds out that it was lapped and skips ahead instead.
+ *
+ * Reading loop:
+ * @code
+ *   SharedRingReaderC reader;
+ *   if (sharedRingOpen("my-capture", &reader) != SHARED_RING_OK) return;
+ *   uint64_t next = sharedRingWriteIndex(&reader, SHARED_RING_VIDEO);
+ *   for (;;) {
+ *     SharedRingFrameC frame;
+ *     int status = sharedRingBeginRead(&reader, SHARED_RING_VIDEO, next, &frame);
+ *     if (status == SHARED_RING_NOT_READY) { if (sharedRingClosed(&reader)) break; sleep; continue; }
+ *     if (status == SHARED_RING_OVERWRITTEN) { next = sharedRingOldest(&reader, SHARED_RING_VIDEO); continue; }
+ *     use(frame.data, frame.size);
+ *     if (!sharedRingEndRead(&reader, &frame)) discard what use() produced;
+ *     next++;
+ *   }
+ *   sharedRingClose(&reader);
+ * @endcode
+ */
+
+#ifndef _SHAREDRING_H_
+#define _SHAREDRING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_WIN32)
+/* Keep std::min/std::max usable in C++ code that includes this header */
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** "CRNG" */
+#define SHARED_RING_MAGIC 0x474E5243u
+
+/** Incremented whenever the layout changes */
+#define SHARED_RING_VERSION 1u
+
+/** Size of SharedRingSlotC; the payload follows it */
+#define SHARED_RING_SLOT_HEADER_BYTES 64u
+
+/** Longest name accepted by sharedRingOpen, without the OS prefix */
+#define SHARED_RING_MAX_NAME 200
+
+/** Tracks */
+enum {
+  SHARED_RING_VIDEO  = 0,
+  SHARED_RING_AUDIO  = 1,
+  SHARED_RING_TRACKS = 2
+};
+
+/** Payload formats */
+enum {
+  SHARED_RING_JPEG    = 0, /**< JPEG image */
+  SHARED_RING_BGRA    = 1, /**< BGRA pixels, bytesPerRow per row */
+  SHARED_RING_FLOAT32 = 2  /**< Interleaved 32-bit float samples */
+};
+
+/** Results of sharedRingOpen and sharedRingBeginRead */
+enum {
+  SHARED_RING_OK          = 0,
+  SHARED_RING_NOT_READY   = 1, /**< The item has not been written yet */
+  SHARED_RING_OVERWRITTEN = 2, /**< The writer has reused the item's slot */
+  SHARED_RING_NOT_FOUND   = 3, /**< No ring with this name exists */
+  SHARED_RING_INVALID     = 4  /**< Not a ring, a different layout version, or a bad argument */
+};
+
+/**
+ * @struct SharedRingTrackC
+ * @brief One ring of slots
+ */
+struct SharedRingTrackC {
+  uint64_t offset;     /**< Offset of the first slot from the start of the segment */
+  uint64_t slotBytes;  /**< Distance between slots, slot header included */
+  uint32_t slotCount;  /**< Number of slots; 0 if the track is not published */
+  uint32_t reserved;
+  uint64_t writeIndex; /**< Items published so far; item n is in slot n % slotCount */
+  uint64_t padding[4];
+};
+
+typedef struct SharedRingTrackC SharedRingTrackC;
+
+/**
+ * @struct SharedRingHeaderC
+ * @brief Start of the segment
+ */
+struct SharedRingHeaderC {
+  uint32_t         magic;      /**< SHARED_RING_MAGIC once the writer has initialized the segment */
+  uint32_t         version;    /**< SHARED_RING_VERSION */
+  uint64_t         totalBytes; /**< Size of the segment */
+  uint32_t         writerPid;  /**< Process ID of the capturing process */
+  uint32_t         closed;     /**< Non-zero once the writer has stopped; nothing more will be published */
+  uint64_t         padding[5];
+  SharedRingTrackC tracks[SHARED_RING_TRACKS];
+};
+
+typedef struct SharedRingHeaderC SharedRingHeaderC;
+
+/**
+ * @struct SharedRingSlotC
+ * @brief Header of one slot; the payload follows it
+ */
+struct SharedRingSlotC {
+  uint64_t sequence;    /**< 2n+1 while item n is being written, 2n+2 once it is complete */
+  uint32_t format;      /**< SHARED_RING_JPEG, SHARED_RING_BGRA or SHARED_RING_FLOAT32 */
+  uint32_t size;        /**< Payload bytes */
+  int32_t  width;       /**< Video frame width */
+  int32_t  height;      /**< Video frame height */
+  int32_t  bytesPerRow; /**< Video row stride */
+  int32_t  channels;    /**< Audio channels */
+  int32_t  sampleRate;  /**< Audio sample rate in Hz */
+  int32_t  frameCount;  /**< Audio sample frames */
+  int64_t  timestampMs; /**< Capture time in milliseconds since the Unix epoch */
+  uint64_t padding[2];
+};
+
+typedef struct SharedRingSlotC SharedRingSlotC;
+
+/**
+ * @struct SharedRingReaderC
+ * @brief A read-only mapping of a ring
+ */
+struct SharedRingReaderC {
+  const uint8_t *base;   /**< Start of the mapping */
+  size_t         size;   /**< Bytes mapped */
+  void          *handle; /**< Windows file mapping handle */
+};
+
+typedef struct SharedRingReaderC SharedRingReaderC;
+
+/**
+ * @struct SharedRingFrameC
+ * @brief An item being read, filled in by sharedRingBeginRead
+ */
+struct SharedRingFrameC {
+  uint64_t               index;       /**< Item number within its track */
+  const SharedRingSlotC *slot;        /**< Slot the item lives in */
+  const uint8_t         *data;        /**< Payload, inside the mapping */
+  uint32_t               size;        /**< Payload bytes */
+  uint32_t               format;      /**< SHARED_RING_JPEG, SHARED_RING_BGRA or SHARED_RING_FLOAT32 */
+  int32_t                width;       /**< Video frame width */
+  int32_t                height;      /**< Video frame height */
+  int32_t                bytesPerRow; /**< Video row stride */
+  int32_t                channels;    /**< Audio channels */
+  int32_t                sampleRate;  /**< Audio sample rate in Hz */
+  int32_t                frameCount;  /**< Audio sample frames */
+  int64_t                timestampMs; /**< Capture time in milliseconds since the Unix epoch */
+};
+
+typedef struct SharedRingFrameC SharedRingFrameC;
+
+/** @name Memory ordering between the writer and readers */
+///@{
+static inline uint64_t sharedRingLoadAcquire(const volatile uint64_t *value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+#if defined(_M_ARM64)
+  return __ldar64((unsigned __int64 volatile *)value);
+#else
+  /* x86 loads already have acquire semantics; only the compiler must not reorder */
+  uint64_t result = *value;
+  _ReadWriteBarrier();
+  return result;
+#endif
+#else
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void sharedRingFenceAcquire(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+#if defined(_M_ARM64)
+  __dmb(_ARM64_BARRIER_ISHLD);
+#else
+  _ReadWriteBarrier();
+#endif
+#else
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
+}
+///@}
+
+/**
+ * @brief OS name of the segment: "/name" on POSIX, "Local\name" on Windows
+ * @return 0 if the name is empty, too long or contains a path separator
+ */
+static inline int sharedRingOsName(const char *name, char *osName, size_t capacity) {
+  size_t length = name ? strlen(name) : 0;
+  if (length == 0 || length > SHARED_RING_MAX_NAME || strchr(name, '/') || strchr(name, '\\')) {
+    return 0;
+  }
+#if defined(_WIN32)
+  const char *prefix = "Local\\";
+#else
+  const char *prefix = "/";
+#endif
+  size_t prefixLength = strlen(prefix);
+  if (prefixLength + length + 1 > capacity) {
+    return 0;
+  }
+  memcpy(osName, prefix, prefixLength);
+  memcpy(osName + prefixLength, name, length + 1);
+  return 1;
+}
+
+static inline const SharedRingHeaderC *sharedRingHeader(const SharedRingReaderC *reader) {
+  return (const SharedRingHeaderC *)reader->base;
+}
+
+/**
+ * @brief Unmap a ring opened with sharedRingOpen
+ */
+static inline void sharedRingClose(SharedRingReaderC *reader) {
+  if (!reader) {
+    return;
+  }
+#if defined(_WIN32)
+  if (reader->base) {
+    UnmapViewOfFile(reader->base);
+  }
+  if (reader->handle) {
+    CloseHandle((HANDLE)reader->handle);
+  }
+#else
+  if (reader->base) {
+    munmap((void *)reader->base, reader->size);
+  }
+#endif
+  reader->base   = NULL;
+  reader->size   = 0;
+  reader->handle = NULL;
+}
+
+/**
+ * @brief Map the ring published under a name
+ * @param name Name given to the `sharedMemory` option
+ * @param reader Receives the mapping
+ * @return SHARED_RING_OK, SHARED_RING_NOT_FOUND or SHARED_RING_INVALID
+ */
+static inline int sharedRingOpen(const char *name, SharedRingReaderC *reader) {
+  char osName[SHARED_RING_MAX_NAME + 16];
+  if (!reader) {
+    return SHARED_RING_INVALID;
+  }
+  reader->base   = NULL;
+  reader->size   = 0;
+  reader->handle = NULL;
+  if (!sharedRingOsName(name, osName, sizeof(osName))) {
+    return SHARED_RING_INVALID;
+  }
+
+#if defined(_WIN32)
+  HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, osName);
+  if (!mapping) {
+    return SHARED_RING_NOT_FOUND;
+  }
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  MEMORY_BASIC_INFORMATION info;
+  if (!view || VirtualQuery(view, &info, sizeof(info)) == 0) {
+    if (view) {
+      UnmapViewOfFile(view);
+    }
+    CloseHandle(mapping);
+    return SHARED_RING_INVALID;
+  }
+  reader->base   = (const uint8_t *)view;
+  reader->size   = info.RegionSize;
+  reader->handle = mapping;
+#else
+  int fd = shm_open(osName, O_RDONLY, 0);
+  if (fd < 0) {
+    return SHARED_RING_NOT_FOUND;
+  }
+  struct stat info;
+  void       *view = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(SharedRingHeaderC)) {
+    view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (view == MAP_FAILED) {
+    return SHARED_RING_INVALID;
+  }
+  reader->base = (const uint8_t *)view;
+  reader->size = (size_t)info.st_size;
+#endif
+
+  const SharedRingHeaderC *header = sharedRingHeader(reader);
+  int                      valid  = reader->size >= sizeof(SharedRingHeaderC) && header->magic == SHARED_RING_MAGIC &&
+                header->version == SHARED_RING_VERSION && header->totalBytes <= reader->size;
+  for (int track = 0; valid && track < SHARED_RING_TRACKS; track++) {
+    const SharedRingTrackC *ring = &header->tracks[track];
+    valid = ring->slotCount == 0 || (ring->slotBytes >= SHARED_RING_SLOT_HEADER_BYTES && ring->offset <= header->totalBytes &&
+                                     ring->slotBytes * ring->slotCount <= header->totalBytes - ring->offset);
+  }
+  if (!valid) {
+    sharedRingClose(reader);
+    return SHARED_RING_INVALID;
+  }
+  return SHARED_RING_OK;
+}
+
+/**
+ * @brief Whether the writer has stopped; items already published can still be read
+ */
+static inline int sharedRingClosed(const SharedRingReaderC *reader) {
+  return *(const volatile uint32_t *)&sharedRingHeader(reader)->closed != 0;
+}
+
+/**
+ * @brief Number of items published on a track; the next item will have this index
+ */
+static inline uint64_t sharedRingWriteIndex(const SharedRingReaderC *reader, int track) {
+  return sharedRingLoadAcquire(&sharedRingHeader(reader)->tracks[track].writeIndex);
+}
+
+/**
+ * @brief Oldest item of a track that has not been overwritten yet
+ */
+static inline uint64_t sharedRingOldest(const SharedRingReaderC *reader, int track) {
+  uint64_t written = sharedRingWriteIndex(reader, track);
+  uint32_t slots   = sharedRingHeader(reader)->tracks[track].slotCount;
+  /* The slot after the newest item may be in the middle of a write */
+  return written >= slots ? written - slots + 1 : 0;
+}
+
+/**
+ * @brief Locate an item and read its header
+ *
+ * frame->data points into the mapping; it stays valid until the writer laps
+ * the reader, which sharedRingEndRead detects. frame is zeroed first, so its
+ * fields are defined whatever the result.
+ * @return SHARED_RING_OK, SHARED_RING_NOT_READY, SHARED_RING_OVERWRITTEN or SHARED_RING_INVALID
+ */
+static inline int sharedRingBeginRead(
+    const SharedRingReaderC *reader, int track, uint64_t index, SharedRingFrameC *frame) {
+  if (!frame) {
+    return SHARED_RING_INVALID;
+  }
+  memset(frame, 0, sizeof(*frame));
+  if (!reader || !reader->base || track < 0 || track >= SHARED_RING_TRACKS) {
+    return SHARED_RING_INVALID;
+  }
+  const SharedRingTrackC *ring = &sharedRingHeader(reader)->tracks[track];
+  if (ring->slotCount == 0) {
+    return SHARED_RING_NOT_READY;
+  }
+
+  const uint8_t         *slotBase = reader->base + ring->offset + (index % ring->slotCount) * ring->slotBytes;
+  const SharedRingSlotC *slot     = (const SharedRingSlotC *)slotBase;
+  const uint64_t         expected = 2 * index + 2;
+
+  uint64_t before = sharedRingLoadAcquire(&slot->sequence);
+  if (before != expected) {
+    return before < expected ? SHARED_RING_NOT_READY : SHARED_RING_OVERWRITTEN;
+  }
+
+  frame->index       = index;
+  frame->slot        = slot;
+  frame->data        = slotBase + SHARED_RING_SLOT_HEADER_BYTES;
+  frame->size        = slot->size;
+  frame->format      = slot->format;
+  frame->width       = slot->width;
+  frame->height      = slot->height;
+  frame->bytesPerRow = slot->bytesPerRow;
+  frame->channels    = slot->channels;
+  frame->sampleRate  = slot->sampleRate;
+  frame->frameCount  = slot->frameCount;
+  frame->timestampMs = slot->timestampMs;
+
+  sharedRingFenceAcquire();
+  if (sharedRingLoadAcquire(&slot->sequence) != expected) {
+    return SHARED_RING_OVERWRITTEN;
+  }
+  if (frame->size > ring->slotBytes - SHARED_RING_SLOT_HEADER_BYTES) {
+    return SHARED_RING_INVALID;
+  }
+  return SHARED_RING_OK;
+}
+
+/**
+ * @brief Check that an item was not overwritten while it was being used
+ * @return 1 if everything read from frame->data since sharedRingBeginRead is intact
+ */
+static inline int sharedRingEndRead(const SharedRingReaderC *reader, const SharedRingFrameC *frame) {
+  (void)reader;
+  sharedRingFenceAcquire();
+  return sharedRingLoadAcquire(&frame->slot->sequence) == 2 * frame->index + 2;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHAREDRING_H_ */
@@ -1,4 +1,5 @@
 import { EventEmitter } from "events";
+import { Readable } from "stream";
 
 // Common type definitions
 export interface DisplayInfo {
@@ -25,6 +26,7 @@ export interface StartCaptureConfig {
 export interface AudioCapture extends EventEmitter {
   startCapture(config: StartCaptureConfig): void;
   stopCapture(): Promise<void>;
+  getStats(): MediaCaptureAudioStats;
 
   // AudioCapture events
   on(event: "data", listener: (buffer: Buffer) => void): this;
@@ -67,6 +69,30 @@ export interface MediaCaptureTarget {
   };
 }
 
+/** Targets selected natively; windows carry no display, so displayId only narrows displays */
+export interface MediaCaptureTargetFilter {
+  appName?: string; // Case-insensitive substring of the application name
+  minWidth?: number;
+  minHeight?: number;
+  displayId?: number;
+}
+
+export interface MediaCaptureEnumerateOptions extends MediaCaptureTargetFilter {
+  maxAgeMs?: number; // Reuse a cached enumeration this recent; 0 always asks the OS (default: the watch interval while watching, else 0)
+}
+
+export interface MediaCaptureWatchTargetsOptions extends MediaCaptureTargetFilter {
+  type?: MediaCaptureTargetType; // Default: All
+  intervalMs?: number; // Time between polls (default 1000, minimum 100); all watchers share the shortest
+}
+
+/** Payload of "targets-changed"; updated targets changed title, application or size */
+export interface MediaCaptureTargetChanges {
+  added: MediaCaptureTarget[];
+  removed: MediaCaptureTarget[];
+  updated: MediaCaptureTarget[];
+}
+
 // Export constants matching the implementation
 export enum MediaCaptureQuality {
   High,
@@ -74,6 +100,17 @@ export enum MediaCaptureQuality {
   Low,
 }
 
+/**
+ * Region of interest in target coordinates (pixels on Windows, points on macOS).
+ * A zero width or height selects the full target.
+ */
+export interface MediaCaptureRect {
+  x: number;
+  y: number;
+  width: number;
+  height: number;
+}
+
 export interface MediaCaptureConfig {
   frameRate: number;
   quality: number; // Using MediaCaptureQuality enum values (High, Medium, Low)
@@ -86,6 +123,263 @@ export interface MediaCaptureConfig {
   windowId?: number;
   bundleId?: string;
   isElectron?: boolean; // isElectron is used to determine if the capture is for electron app
+  cropRect?: MediaCaptureRect; // Only this region is copied and encoded; clamped to the target bounds
+  imageFormat?: MediaCaptureImageFormat; // Frame format delivered in "video-frame" (default "jpeg")
+  keyframeIntervalMs?: number; // "delta" only: maximum time between keyframes (default 5000)
+  deltaTileSize?: number; // "delta" only: change detection tile size in pixels, 16-512 (default 64)
+  // Adaptive quality (Windows): when a budget is set, JPEG quality, downscale and frame rate are
+  // lowered under load and restored when there is headroom. The configured values are the maximums.
+  maxEncodeMsPerFrame?: number; // Mean encode time budget per frame
+  maxBytesPerSecond?: number; // Encoded output budget
+  minQualityValue?: number; // Lowest JPEG quality the controller may use (default 30)
+  minScale?: number; // Smallest downscale factor (default 0.25)
+  minFrameRate?: number; // Lowest frame rate (default 1)
+  trace?: boolean; // Record per-frame spans of every capture thread until stopCapture (see dumpTrace)
+  sharedMemory?: MediaCaptureSharedMemoryOptions; // Also publish frames and audio for other processes
+  lookback?: MediaCaptureLookbackOptions; // Keep the last seconds natively for snapshot() instead of delivering
+  // Capture several displays or windows on shared threads; displayId/windowId then only select
+  // the audio source. Not supported on macOS; displays only on Windows.
+  targets?: MediaCaptureTargetConfig[];
+  // Deliver the one target several times, each at its own rate, size, format and quality, from one
+  // acquisition per tick. Not supported on macOS; displays only on Windows.
+  renditions?: MediaCaptureRenditionConfig[];
+  // Derive several audio formats from the one capture; "audio-data" then carries tap chunks
+  // instead of the plain stream. Without audioSampleRate/audioChannels, audio is captured at
+  // the highest rate and channel count any tap asks for.
+  audioTaps?: MediaCaptureAudioTapConfig[];
+}
+
+/**
+ * One target of a multi-target capture. Its frames carry targetIndex, its index in targets.
+ */
+export interface MediaCaptureTargetConfig {
+  displayId?: number;
+  windowId?: number;
+  cropRect?: MediaCaptureRect;
+}
+
+/**
+ * One audio output of a capture. Its chunks carry tap, its index in audioTaps, and their
+ * sync position counts samples at the tap's own rate.
+ */
+export interface MediaCaptureAudioTapConfig {
+  sampleRate?: number; // Default: the capture rate, 16000 for "logmel"
+  channels?: 1 | 2; // 1 downmixes, 2 duplicates mono; default: the capture layout
+  // Float32Array or Int16Array samples, or log-mel feature frames of the mono downmix (default "f32")
+  format?: "f32" | "s16" | "logmel";
+  chunkMs?: number; // Regroup into chunks of this duration; 0 keeps the capture's blocks
+  // "logmel" only, as librosa.feature.melspectrogram(center=False) followed by a natural log
+  nFft?: number; // Transform size, 16-8192 (default 512); powers of two take the FFT
+  winLength?: number; // Hann window length, up to nFft (default 400 with the default nFft, else nFft)
+  hop?: number; // Samples between frames, 1 to nFft (default 160)
+  nMels?: number; // Mel bins per frame, 1-512 (default 80)
+  fmin?: number; // Lowest filter edge in Hz (default 0)
+  fmax?: number; // Highest filter edge in Hz (default sampleRate / 2)
+}
+
+/**
+ * Shape of the data of a "logmel" tap chunk: a row-major Float32Array of frames rows of
+ * melBins log energies. sync describes the first sample of the first frame.
+ */
+export interface MediaCaptureAudioFeatures {
+  frames: number;
+  melBins: number;
+}
+
+/**
+ * One output of a multi-rendition capture. Its frames carry rendition, its index in renditions.
+ */
+export interface MediaCaptureRenditionConfig {
+  frameRate?: number; // Default: config.frameRate
+  scale?: number; // Downscale factor, up to 1 (full size)
+  maxWidth?: number; // Largest width in pixels; the height follows
+  imageFormat?: Exclude<MediaCaptureImageFormat, "delta">; // Default: config.imageFormat
+  quality?: number; // JPEG quality 1-100 (default: config.qualityValue or quality)
+}
+
+/**
+ * Shared-memory ring that other processes can read with SharedFrameReader, or natively
+ * with include/capture/sharedring.h. A frame larger than a slot is skipped.
+ */
+export interface MediaCaptureSharedMemoryOptions {
+  name: string; // Must not be in use by another capture
+  videoSlots?: number; // Video frames kept (default 4; 0 disables video)
+  videoSlotBytes?: number; // Largest video frame (default 8 MiB, enough for 1080p BGRA)
+  audioSlots?: number; // Audio packets kept (default 64; 0 disables audio)
+  audioSlotBytes?: number; // Largest audio packet (default 64 KiB)
+}
+
+/**
+ * Look-back buffer: the last seconds of audio and encoded frames, kept in native memory
+ * of a fixed size. While it is set nothing is delivered to JavaScript; snapshot() copies
+ * from it, also after stopCapture() until the next start.
+ */
+export interface MediaCaptureLookbackOptions {
+  seconds?: number; // Longest span a snapshot can cover (default 30)
+  maxBytes?: number; // Memory for audio and frames together (default 256 MiB); audio takes at most half
+}
+
+export interface MediaCaptureSnapshotOptions {
+  seconds?: number; // Span to copy, ending at the newest frame or sample (default: everything held)
+  dir?: string; // Write the snapshot there as a recording instead of resolving with it
+}
+
+/**
+ * Media copied by snapshot(). Audio and frames are views into one ArrayBuffer; the first
+ * frame is the one on screen when the span starts.
+ */
+export interface MediaCaptureSnapshot {
+  buffer: ArrayBuffer;
+  audio: {
+    data: Float32Array; // Interleaved
+    sampleRate: number;
+    channels: number;
+    timestamp: number; // Capture time of the first sample, in milliseconds since the Unix epoch
+  } | null;
+  frames: {
+    data: Uint8Array;
+    width: number;
+    height: number;
+    bytesPerRow: number;
+    format: "jpeg" | "bgra";
+    timestamp: number;
+  }[];
+}
+
+/**
+ * startRecording options: the capture configuration plus where and how to write it.
+ * Audio is interleaved 32-bit float. "mjpeg" writes concatenated JPEG frames with a .csv
+ * index of offset, size, width, height and timestamp; "frames" writes one file per frame
+ * into dir/frames. At least one of audio and video must be set.
+ */
+export interface MediaCaptureRecordingOptions extends MediaCaptureConfig {
+  dir: string; // Created if it does not exist
+  audio?: "wav" | "raw" | "none";
+  video?: "mjpeg" | "frames" | "none";
+  segmentBytes?: number; // Start a new file when a segment reaches this size (default: no limit)
+  segmentSeconds?: number; // Start a new file after this much media (default: no limit)
+}
+
+export interface MediaCaptureQualityStats {
+  quality: number; // JPEG quality in effect
+  scale: number; // Downscale factor in effect; frames are scale * target size
+  frameRate: number; // Frame rate in effect
+  encodeMs: number; // Smoothed encode time per frame
+  bytesPerSecond: number; // Smoothed encoded output rate
+  queueDepth: number; // Smoothed number of frames waiting for the encoder
+  downgrades: number;
+  upgrades: number;
+  lastAdjustment:
+    | "none"
+    | "lower-quality"
+    | "lower-scale"
+    | "lower-frame-rate"
+    | "raise-quality"
+    | "raise-scale"
+    | "raise-frame-rate";
+  lastPressure: "none" | "encode-time" | "bandwidth" | "backlog"; // Cause of the last downgrade
+}
+
+/**
+ * Latency distribution of one stage. Percentiles come from a log-linear histogram
+ * and are accurate to about 3%. All values are 0 when count is 0.
+ */
+export interface MediaCaptureStageStats {
+  count: number;
+  meanMs: number;
+  maxMs: number;
+  p50Ms: number;
+  p90Ms: number;
+  p99Ms: number;
+  p999Ms: number;
+}
+
+export interface MediaCaptureVideoStats {
+  framesCaptured: number;
+  framesDelivered: number; // Frames handed to the native callback
+  framesDropped: number; // Frames dropped because the encoder fell behind
+  encodeFailures: number;
+  acquireFailures: number; // Frames that could not be read, e.g. while a window is minimized or the crop is outside it
+  bytes: number; // Encoded bytes delivered
+  queueDepth: number; // Frames waiting for the encoder
+  jsDelivered: number; // Frames that reached the "video-frame" listener
+  jsDropped: number; // Frames dropped because the JavaScript queue or a paused stream was full
+  stages: {
+    acquire: MediaCaptureStageStats; // Reading a frame from the system
+    copy: MediaCaptureStageStats; // Copying the (cropped) pixels out of system memory
+    queueWait: MediaCaptureStageStats; // Waiting for the encoder
+    encode: MediaCaptureStageStats;
+    deliver: MediaCaptureStageStats; // Native callback
+    jsDispatch: MediaCaptureStageStats; // Native callback to listener
+    captureToJs: MediaCaptureStageStats; // Frame timestamp to listener, millisecond resolution
+  };
+}
+
+export interface MediaCaptureAudioStats {
+  packets: number;
+  frames: number; // Sample frames
+  dropped: number; // Sample frames lost before delivery
+  jsDelivered: number;
+  jsDropped: number; // Packets dropped because the JavaScript queue or a paused stream was full
+  stages: {
+    acquire: MediaCaptureStageStats;
+    downmix: MediaCaptureStageStats;
+    resample: MediaCaptureStageStats;
+    deliver: MediaCaptureStageStats;
+    jsDispatch: MediaCaptureStageStats;
+  };
+}
+
+/**
+ * Counters and stage latencies since startCapture. Native counters are 0 while not
+ * capturing, and on macOS only the js* fields are measured.
+ */
+export interface MediaCaptureStats {
+  video: MediaCaptureVideoStats;
+  audio: MediaCaptureAudioStats;
+  recording: MediaCaptureRecordingStats | null; // Current or last recording
+  startup: MediaCaptureStartupStats;
+}
+
+/**
+ * Time from the last startCapture() call to its first "video-frame" and "audio-data"
+ * callbacks on the native side, in ms; null until they arrive.
+ */
+export interface MediaCaptureStartupStats {
+  prepared: boolean; // The start used resources opened by prepare()
+  firstFrameMs: number | null;
+  firstAudioMs: number | null;
+}
+
+export interface MediaCaptureRecordingStats {
+  videoFrames: number;
+  audioFrames: number; // Sample frames
+  bytesWritten: number;
+  droppedChunks: number; // Frames and audio packets dropped because the disk fell behind
+  segments: number; // Files opened
+}
+
+/**
+ * Video frame formats.
+ * - "jpeg": JPEG encoded
+ * - "bgra": packed BGRA, bytesPerRow = width * 4
+ * - "i420": Y plane (width x height), then U and V planes (ceil(width/2) x ceil(height/2) each)
+ * - "nv12": Y plane (width x height), then interleaved UV plane (ceil(width/2) pairs x ceil(height/2) rows)
+ * - "delta": periodic full keyframes, otherwise only the regions that changed, each as a JPEG patch
+ *   (see MediaCaptureVideoFrame.patches); frames with no change are not emitted
+ * Raw YUV formats use BT.601 limited range; bytesPerRow is the Y plane stride.
+ */
+export type MediaCaptureImageFormat = "jpeg" | "bgra" | "i420" | "nv12" | "delta";
+
+/**
+ * A JPEG-encoded region of a "delta" frame, to be drawn at (x, y) over the previous frame.
+ */
+export interface MediaCaptureDeltaPatch {
+  x: number;
+  y: number;
+  width: number;
+  height: number;
+  data: Uint8Array; // JPEG bytes (a view into frame.data)
 }
 
 export interface MediaCaptureVideoFrame {
@@ -94,12 +388,148 @@ export interface MediaCaptureVideoFrame {
   height: number;
   bytesPerRow: number;
   timestamp: number;
-  isJpeg: boolean; // true for JPEG encoded frames (always true on Windows), false for RAW format (macOS only)
+  format: MediaCaptureImageFormat; // Layout of data
+  isJpeg: boolean; // true when format is "jpeg"
+  // "delta" frames only. A delta applies to the frame whose sequence equals baseSequence;
+  // after a gap, discard deltas until the next keyframe.
+  isKeyframe?: boolean;
+  sequence?: number;
+  baseSequence?: number;
+  patches?: MediaCaptureDeltaPatch[];
+  // Acquisition time in ms on the capture clock shared with "audio-data" (not on macOS)
+  captureTime?: number;
+  // Index (per channel) of the audio sample captured at captureTime; negative before audio started
+  audioPosition?: number;
+  // Multi-target captures only: which entry of config.targets produced the frame
+  targetIndex?: number;
+  displayId?: number;
+  windowId?: number;
+  // Multi-rendition captures only: which entry of config.renditions the frame is
+  rendition?: number;
+}
+
+/**
+ * Passed with "audio-data" where the backend stamps audio (Windows and Linux).
+ * position counts samples per channel since capture started, so a frame's
+ * audioPosition indexes straight into the concatenated audio.
+ */
+export interface MediaCaptureAudioSync {
+  captureTime: number; // Capture time of the first sample, in ms on the capture clock
+  position: number; // Stream position of the first sample
+}
+
+export type MediaCaptureOverflowPolicy = "drop-oldest" | "drop-newest";
+
+export interface MediaCaptureStreamOptions {
+  highWaterMark?: number; // Readable buffer size; frames or blocks in object mode, bytes otherwise
+  objectMode?: boolean; // Default: true for video, false for audio (interleaved Float32 bytes)
+  buffer?: number; // Items held natively while the stream is full (default: 4 video frames, 64 audio blocks)
+  overflow?: MediaCaptureOverflowPolicy; // Default: "drop-oldest" for video, "drop-newest" for audio
+  tap?: number; // Audio with audioTaps: only chunks of this tap
+}
+
+export interface MediaCapturePullOptions {
+  buffer?: number; // Items held natively until the iterator asks for them (default: 4 video frames, 64 audio chunks)
+  overflow?: MediaCaptureOverflowPolicy; // Default: "drop-oldest" for video, "drop-newest" for audio
+}
+
+export interface MediaCaptureAudioPullOptions extends MediaCapturePullOptions {
+  chunkMs?: number; // Regroup audio into chunks of this duration; 0 keeps the backend's blocks (ignored with audioTaps)
+}
+
+/** Object-mode chunks of createAudioStream() and items of audio() */
+export interface MediaCaptureAudioChunk {
+  data: Float32Array | Int16Array; // Int16Array for an "s16" tap
+  sampleRate: number;
+  channels: number;
+  sync?: MediaCaptureAudioSync;
+  tap?: number; // Index in audioTaps
+  features?: MediaCaptureAudioFeatures; // "logmel" taps
 }
 
 export interface MediaCapture extends EventEmitter {
+  /**
+   * Open the target and audio device of a coming startCapture() ahead of time, so the
+   * start only has to begin streaming. Used by the next startCapture() with the same
+   * displayId, windowId and audio format; released by any other start and by
+   * stopCapture(). On macOS this resolves the target and its content filter only.
+   */
+  prepare(config: MediaCaptureConfig): Promise<void>;
   startCapture(config: MediaCaptureConfig): void;
   stopCapture(): Promise<void>;
+  /**
+   * Capture straight to disk from the native threads; no "video-frame" or "audio-data"
+   * events are emitted. stopCapture() resolves once the files are complete and rejects
+   * if any data could not be written.
+   */
+  startRecording(options: MediaCaptureRecordingOptions): Promise<void>;
+  /**
+   * Copy the last seconds held by the lookback buffer on a worker thread. With dir, the
+   * snapshot is written there like a recording (audio-0001.wav, plus video-0001.mjpeg and
+   * its .csv index for JPEG frames or frames/ otherwise) and the promise resolves with dir.
+   */
+  snapshot(options?: MediaCaptureSnapshotOptions & { dir?: undefined }): Promise<MediaCaptureSnapshot>;
+  snapshot(options: MediaCaptureSnapshotOptions & { dir: string }): Promise<string>;
+  /**
+   * Change settings of the running capture without stopping it. The given keys replace
+   * those of the start configuration: frame rate, quality, imageFormat, audio format,
+   * cropRect and the adaptive quality budget apply from the next frame or audio block.
+   * Another displayId, windowId or bundleId switches the target (Linux and Windows
+   * restart the capture with the same listeners). targets, renditions, audioTaps,
+   * sharedMemory, lookback, trace, the delta options and a switch to or from 'delta'
+   * reject; stop and start again.
+   */
+  reconfigure(config: Partial<MediaCaptureConfig>): Promise<void>;
+  /**
+   * Change the region of interest of the running capture without restarting it.
+   * Pass null to capture the full target again. Rejects if the rectangle is malformed
+   * or lies outside the captured target; the capture keeps running with the previous crop then.
+   */
+  setCropRect(rect: MediaCaptureRect | null): Promise<void>;
+  /**
+   * Current state of the adaptive quality controller, or null when no budget is active
+   * or the platform does not support it.
+   */
+  getQualityStats(): MediaCaptureQualityStats | null;
+  /**
+   * Per-stage counters and latency histograms, or null when the platform is not supported.
+   */
+  getStats(): MediaCaptureStats | null;
+  /**
+   * Write the spans recorded with `trace: true` as Chrome Trace Event JSON, loadable in
+   * Perfetto. Works during capture and after it stopped; throws if the file cannot be written.
+   */
+  dumpTrace(path: string): void;
+  /**
+   * Readable of video frames. While its buffer is above highWaterMark, the native side
+   * stops queuing frames for JavaScript and holds up to `buffer` of them instead, so a
+   * slow consumer does not grow memory. Ends when stopCapture() resolves; destroyed with
+   * the error when the capture exits with one.
+   */
+  createVideoStream(options?: MediaCaptureStreamOptions): Readable;
+  /**
+   * Readable of audio with the same backpressure as createVideoStream(). Chunks are
+   * interleaved Float32 bytes, or MediaCaptureAudioChunk objects in object mode.
+   */
+  createAudioStream(options?: MediaCaptureStreamOptions): Readable;
+  /**
+   * Async iterator of video frames. Frames wait in a bounded native queue until next() is
+   * called, and are not emitted as "video-frame" events while the iterator is open. One
+   * iterator per track at a time; it finishes when stopCapture() resolves, and throws the
+   * error after the remaining items when the capture exits with one.
+   */
+  frames(options?: MediaCapturePullOptions): AsyncIterableIterator<MediaCaptureVideoFrame>;
+  /**
+   * Async iterator of audio, like frames(). With chunkMs, each chunk is that long and its
+   * sync stamp describes its first sample.
+   */
+  audio(options?: MediaCaptureAudioPullOptions): AsyncIterableIterator<MediaCaptureAudioChunk>;
+  /**
+   * Emit "targets-changed" for the targets matching options. Adding the first
+   * "targets-changed" listener starts watching with no filter; removing the last stops it.
+   */
+  watchTargets(options?: MediaCaptureWatchTargetsOptions): void;
+  unwatchTargets(): void;
 
   on(
     event: "video-frame",
@@ -109,14 +539,21 @@ export interface MediaCapture extends EventEmitter {
   on(
     event: "audio-data",
     listener: (
-      audioData: Float32Array,
+      audioData: Float32Array | Int16Array,
       sampleRate: number,
-      channels: number
+      channels: number,
+      sync?: MediaCaptureAudioSync,
+      tap?: number,
+      features?: MediaCaptureAudioFeatures
     ) => void
   ): this;
 
   on(event: "error", listener: (error: Error) => void): this;
   on(event: "exit", listener: () => void): this;
+  on(
+    event: "targets-changed",
+    listener: (changes: MediaCaptureTargetChanges) => void
+  ): this;
 
   once(
     event: "video-frame",
@@ -126,14 +563,21 @@ export interface MediaCapture extends EventEmitter {
   once(
     event: "audio-data",
     listener: (
-      audioData: Float32Array,
+      audioData: Float32Array | Int16Array,
       sampleRate: number,
-      channels: number
+      channels: number,
+      sync?: MediaCaptureAudioSync,
+      tap?: number,
+      features?: MediaCaptureAudioFeatures
     ) => void
   ): this;
 
   once(event: "error", listener: (error: Error) => void): this;
   once(event: "exit", listener: () => void): this;
+  once(
+    event: "targets-changed",
+    listener: (changes: MediaCaptureTargetChanges) => void
+  ): this;
 }
 
 export var MediaCapture: MediaCaptureConstructor;
@@ -141,7 +585,8 @@ export var MediaCapture: MediaCaptureConstructor;
 interface MediaCaptureConstructor {
   new (): MediaCapture;
   enumerateMediaCaptureTargets(
-    type?: MediaCaptureTargetType
+    type?: MediaCaptureTargetType,
+    options?: MediaCaptureEnumerateOptions
   ): Promise<MediaCaptureTarget[]>;
 
   /**
@@ -162,3 +607,40 @@ export enum MediaCaptureTargetType {
  * @returns True if the current environment supports MediaCapture
  */
 export function isMediaCaptureSupported(): boolean;
+
+export interface SharedVideoFrame {
+  data: Uint8Array;
+  width: number;
+  height: number;
+  bytesPerRow: number;
+  format: "jpeg" | "bgra";
+  isJpeg: boolean;
+  timestamp: number;
+  index: number; // Position in the stream, counting from the start of the capture
+  skipped: number; // Frames overwritten before this reader got to them
+}
+
+export interface SharedAudioPacket {
+  data: Float32Array; // Interleaved samples
+  sampleRate: number;
+  channels: number;
+  frameCount: number;
+  timestamp: number;
+  index: number;
+  skipped: number;
+}
+
+/**
+ * Reads what a MediaCapture started with the sharedMemory option publishes, usually from
+ * another process. Reading starts with the next item published after construction.
+ */
+export class SharedFrameReader {
+  /** Throws if no capture is publishing under this name */
+  constructor(name: string);
+  /** Next frame, or null if none has been published since the last read */
+  read(track?: "video"): SharedVideoFrame | null;
+  read(track: "audio"): SharedAudioPacket | null;
+  /** true once the capture stopped; items already published can still be read */
+  readonly closed: boolean;
+  close(): void;
+}
@@ -1,4 +1,5 @@
 import { EventEmitter } from "events";
+import { Readable } from "stream";
 import path from "path";
 import { fileURLToPath } from "url";
 import bindings from "bindings";
@@ -49,11 +50,19 @@ class AudioCapture extends _AudioCapture {
 
 export { AudioCapture };
 
+/// SharedFrameReader
+// Reads the frames and audio a MediaCapture publishes with the sharedMemory option,
+// typically from another process
+const { SharedFrameReader } = bindings("addon");
+
+export { SharedFrameReader };
+
 /// MediaCapture
-// Available on Apple Silicon macOS and Windows
+// Available on Apple Silicon macOS, Windows and Linux (X11 or synthetic source)
 const isSupportedPlatform =
   (process.platform === "darwin" && process.arch === "arm64") ||
-  process.platform === "win32";
+  process.platform === "win32" ||
+  process.platform === "linux";
 let MediaCaptureImplementation;
 if (isSupportedPlatform) {
   // Use the actual MediaCapture implementation on supported platforms
@@ -65,16 +74,47 @@ if (isSupportedPlatform) {
       this._nativeInstance = new NativeMediaCapture();
 
       // Bind methods to this class
+      this.prepare = this._nativeInstance.prepare.bind(this._nativeInstance);
       this.startCapture = this._nativeInstance.startCapture.bind(
         this._nativeInstance
       );
-      this.stopCapture = this._nativeInstance.stopCapture.bind(
+      const stopCapture = this._nativeInstance.stopCapture.bind(
+        this._nativeInstance
+      );
+      this.stopCapture = (...args) =>
+        stopCapture(...args).then((result) => {
+          // Streams and iterators end once capture has stopped and everything queued was delivered
+          this._endStreams();
+          return result;
+        });
+      this.startRecording = this._nativeInstance.startRecording.bind(
         this._nativeInstance
       );
+      this.snapshot = this._nativeInstance.snapshot.bind(this._nativeInstance);
+      this.reconfigure = this._nativeInstance.reconfigure.bind(
+        this._nativeInstance
+      );
+      this.setCropRect = this._nativeInstance.setCropRect.bind(
+        this._nativeInstance
+      );
+      this.getQualityStats = this._nativeInstance.getQualityStats.bind(
+        this._nativeInstance
+      );
+      this.getStats = this._nativeInstance.getStats.bind(this._nativeInstance);
+      this.dumpTrace = this._nativeInstance.dumpTrace.bind(this._nativeInstance);
+
+      // Streams whose buffer is full, per track; the native side holds that
+      // track's data while any of them is paused
+      this._pausedStreams = { video: new Set(), audio: new Set() };
+      this._endOnStop = new Set();
 
       // More robust event forwarding mechanism
       const self = this;
       this._nativeInstance.emit = function (event, ...args) {
+        // "error" means the capture exited; nothing follows, so streams and iterators end with it
+        if (event === "error") {
+          self._endStreams(args[0]);
+        }
         // Forward events to self instead of this
         return self.emit(event, ...args);
       };
@@ -85,6 +125,226 @@ if (isSupportedPlatform) {
         writable: true,
         enumerable: false,
       });
+
+      // "targets-changed" is only polled for while someone listens
+      this._targetWatch = null;
+      this.on("newListener", (event) => {
+        if (event === "targets-changed" && !this._targetWatch) {
+          this.watchTargets();
+        }
+      });
+      this.on("removeListener", (event) => {
+        if (
+          event === "targets-changed" &&
+          this.listenerCount("targets-changed") === 0
+        ) {
+          this.unwatchTargets();
+        }
+      });
+    }
+
+    /**
+     * End the open streams and iterators
+     * @param {Error} [error] Why the capture exited; streams are destroyed with it
+     */
+    _endStreams(error) {
+      for (const end of [...this._endOnStop]) {
+        end(error);
+      }
+    }
+
+    /**
+     * Emit "targets-changed" for the targets matching a filter
+     * @param {Object} [options] type, appName, minWidth, minHeight, displayId and intervalMs
+     */
+    watchTargets(options = {}) {
+      this._targetWatch = options;
+      this._nativeInstance.watchTargets(options);
+    }
+
+    /**
+     * Stop emitting "targets-changed"
+     */
+    unwatchTargets() {
+      this._targetWatch = null;
+      this._nativeInstance.unwatchTargets();
+    }
+
+    /**
+     * Create a Readable of video frames with backpressure
+     * @param {Object} [options] highWaterMark, objectMode, buffer and overflow
+     * @returns {Readable} Stream of the frame objects "video-frame" emits
+     */
+    createVideoStream(options = {}) {
+      return this._createStream("video", options);
+    }
+
+    /**
+     * Create a Readable of audio with backpressure
+     * @param {Object} [options] highWaterMark, objectMode, buffer, overflow and tap
+     * @returns {Readable} Interleaved sample bytes, or {data, sampleRate, channels, sync, tap, features}
+     *   objects in object mode
+     */
+    createAudioStream(options = {}) {
+      return this._createStream("audio", options);
+    }
+
+    _createStream(track, options) {
+      const video = track === "video";
+      const objectMode = options.objectMode ?? video;
+      const delivery = {
+        buffer: options.buffer ?? (video ? 4 : 64),
+        overflow: options.overflow ?? (video ? "drop-oldest" : "drop-newest"),
+      };
+      const paused = this._pausedStreams[track];
+      const native = this._nativeInstance;
+
+      const release = () => {
+        if (paused.delete(stream) && paused.size === 0) {
+          native.resumeDelivery(track);
+        }
+      };
+      const push = (chunk) => {
+        if (!stream.push(chunk) && !paused.has(stream)) {
+          paused.add(stream);
+          native.pauseDelivery(track, delivery);
+        }
+      };
+
+      const event = video ? "video-frame" : "audio-data";
+      const listener = video
+        ? (frame) => push(frame)
+        : (data, sampleRate, channels, sync, tap, features) => {
+            // With audioTaps, a stream can follow one tap; the others still share its backpressure
+            if (options.tap !== undefined && tap !== options.tap) {
+              return;
+            }
+            push(
+              objectMode
+                ? { data, sampleRate, channels, sync, tap, features }
+                : Buffer.from(data.buffer, data.byteOffset, data.byteLength)
+            );
+          };
+      const detach = () => {
+        this.off(event, listener);
+        this._endOnStop.delete(end);
+        release();
+      };
+      const end = (error) => {
+        detach();
+        if (error) {
+          stream.destroy(error);
+        } else {
+          stream.push(null);
+        }
+      };
+
+      const stream = new Readable({
+        objectMode,
+        highWaterMark: options.highWaterMark,
+        read: release,
+        destroy(error, callback) {
+          detach();
+          callback(error);
+        },
+      });
+      this.on(event, listener);
+      this._endOnStop.add(end);
+      return stream;
+    }
+
+    /**
+     * Async iterator of video frames, pulled from a bounded native queue
+     * @param {Object} [options] buffer and overflow
+     * @returns {AsyncIterableIterator<Object>} The frame objects "video-frame" emits
+     */
+    frames(options = {}) {
+      return this._pull("video", options);
+    }
+
+    /**
+     * Async iterator of audio, pulled from a bounded native queue
+     * @param {Object} [options] chunkMs, buffer and overflow
+     * @returns {AsyncIterableIterator<Object>} {data, sampleRate, channels, sync, tap, features} chunks
+     */
+    audio(options = {}) {
+      return this._pull("audio", options);
+    }
+
+    _pull(track, options) {
+      const native = this._nativeInstance;
+      const queue = [];
+      const waiting = [];
+      let finished = false;
+      // Error the capture exited with, thrown by the first next() after the remaining items
+      let failure = null;
+
+      const deliver = (items) => {
+        queue.push(...items);
+        while (waiting.length > 0 && queue.length > 0) {
+          waiting.shift().resolve({ value: queue.shift(), done: false });
+        }
+      };
+      const finish = (error) => {
+        if (finished) {
+          return;
+        }
+        finished = true;
+        this._endOnStop.delete(end);
+        native.closePull(track);
+        if (error && waiting.length > 0) {
+          for (const { reject } of waiting.splice(0)) {
+            reject(error);
+          }
+        } else if (error) {
+          failure = error;
+        }
+        for (const { resolve } of waiting.splice(0)) {
+          resolve({ value: undefined, done: true });
+        }
+      };
+      const end = (error) => {
+        const items = native.pull(track);
+        if (items) {
+          deliver(items);
+        }
+        finish(error);
+      };
+
+      // The track is held natively from here on; nothing is emitted while nobody awaits
+      native.openPull(track, options, deliver);
+      this._endOnStop.add(end);
+
+      return {
+        next() {
+          if (queue.length > 0) {
+            return Promise.resolve({ value: queue.shift(), done: false });
+          }
+          if (finished) {
+            const error = failure;
+            failure = null;
+            return error ? Promise.reject(error) : Promise.resolve({ value: undefined, done: true });
+          }
+          // With a request already waiting, the native side will wake it
+          if (waiting.length === 0) {
+            const items = native.pull(track);
+            if (items && items.length > 0) {
+              deliver(items);
+              return Promise.resolve({ value: queue.shift(), done: false });
+            }
+          }
+          return new Promise((resolve, reject) => waiting.push({ resolve, reject }));
+        },
+        return() {
+          queue.length = 0;
+          failure = null;
+          finish();
+          return Promise.resolve({ value: undefined, done: true });
+        },
+        [Symbol.asyncIterator]() {
+          return this;
+        },
+      };
     }
 
     // Add static methods as needed
@@ -108,25 +368,88 @@ if (isSupportedPlatform) {
     constructor() {
       super();
       console.warn(
-        "MediaCapture is only available on Apple Silicon (ARM64) macOS devices and Windows."
+        "MediaCapture is only available on Apple Silicon (ARM64) macOS devices, Windows and Linux."
+      );
+    }
+
+    prepare() {
+      throw new Error(
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
       );
     }
 
     startCapture() {
       throw new Error(
-        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS and Windows."
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
       );
     }
 
     stopCapture() {
       throw new Error(
-        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS and Windows."
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
+      );
+    }
+    startRecording() {
+      throw new Error(
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
+      );
+    }
+    snapshot() {
+      throw new Error(
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
+      );
+    }
+    reconfigure() {
+      throw new Error(
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
+      );
+    }
+    setCropRect() {
+      throw new Error(
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
+      );
+    }
+    getQualityStats() {
+      return null;
+    }
+    getStats() {
+      return null;
+    }
+    dumpTrace() {
+      throw new Error(
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
+      );
+    }
+    createVideoStream() {
+      throw new Error(
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
+      );
+    }
+    createAudioStream() {
+      throw new Error(
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
+      );
+    }
+    frames() {
+      throw new Error(
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
+      );
+    }
+    audio() {
+      throw new Error(
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
+      );
+    }
+    watchTargets() {
+      throw new Error(
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
       );
     }
+    unwatchTargets() {}
 
     static enumerateMediaCaptureTargets() {
       throw new Error(
-        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS and Windows."
+        "MediaCapture is not supported on this platform. Only available on Apple Silicon macOS, Windows and Linux."
       );
     }
 
@@ -220,3 +220,9 @@ public func stopCapture(_ p: UnsafeMutableRawPointer, _ callback: StopCaptureCal
         callback(context)
     }
 }
+
+/// The legacy capture has no native stage timings on macOS.
+@_cdecl("getCaptureStats")
+public func getCaptureStats(_ p: UnsafeMutableRawPointer, _ stats: UnsafeMutablePointer<MediaCaptureStatsC>) -> Int32 {
+    return 0
+}
@@ -206,6 +206,19 @@ public class MediaCapture: NSObject, @unchecked Sendable {
     private var mediaHandler: ((StreamableMediaData) -> Void)?
     private var errorHandler: ((String) -> Void)?
     
+    // Region of interest, kept across restarts and reconnections
+    private var cropRect: CGRect?
+    private var streamConfiguration: SCStreamConfiguration?
+    private var targetBounds: CGRect = .zero
+    private var fullOutputSize: CGSize = .zero
+
+    // Target of the running stream, to tell whether reconfigure() swaps the filter
+    private var currentTarget: MediaCaptureTarget?
+
+    // Content filter built by prepare(target:) for the next start
+    public private(set) var preparedTarget: MediaCaptureTarget?
+    private var preparedFilter: SCContentFilter?
+    
     public override init() {
         super.init()
     }
@@ -310,49 +323,21 @@ public class MediaCapture: NSObject, @unchecked Sendable {
         
         // Configure resolution based on target type and quality
         if captureVideo {
-            if framesPerSecond >= 1.0 {
-                configuration.minimumFrameInterval = CMTime(value: 1, timescale: CMTimeScale(framesPerSecond))
-            } else {
-                let seconds = 1.0 / framesPerSecond
-                configuration.minimumFrameInterval = CMTime(seconds: seconds, preferredTimescale: 600)
-            }
-
-            // Get scaling factor based on quality
-            let scaleFactor = Double(quality.scale)
-
-            if target.isWindow {
-                // For window capture, use the window dimensions
-                let windowWidth = Int(target.frame.width)
-                let windowHeight = Int(target.frame.height)
-                
-                if windowWidth > 0 && windowHeight > 0 {
-                    // Apply scaling based on quality
-                    let scaledWidth = Int(Double(windowWidth) * scaleFactor)
-                    let scaledHeight = Int(Double(windowHeight) * scaleFactor)
-                    
-                    // Always set dimensions for window capture to ensure correct size
-                    configuration.width = scaledWidth
-                    configuration.height = scaledHeight
-                }
-            } else {
-                // For display capture, use the display dimensions
-                let mainDisplayID = target.displayID > 0 ? target.displayID : CGMainDisplayID()
-                let width = CGDisplayPixelsWide(mainDisplayID)
-                let height = CGDisplayPixelsHigh(mainDisplayID)
-                
-                let scaledWidth = Int(Double(width) * scaleFactor)
-                let scaledHeight = Int(Double(height) * scaleFactor)
-                
-                configuration.width = scaledWidth
-                configuration.height = scaledHeight
-            }
+            applyVideoSettings(to: configuration, target: target, framesPerSecond: framesPerSecond, quality: quality)
             
             // Cursor display settings
             configuration.showsCursor = true
         } 
         
-        // Create ContentFilter.
-        let filter = try await createContentFilter(from: target)
+        // Create ContentFilter, unless prepare(target:) already built it for this target.
+        let filter: SCContentFilter
+        if let prepared = preparedFilter, preparedTarget == target {
+            filter = prepared
+        } else {
+            filter = try await createContentFilter(from: target)
+        }
+        preparedTarget = nil
+        preparedFilter = nil
         
         // Create MediaCaptureOutput.
         let output = MediaCaptureOutput()
@@ -388,6 +373,7 @@ public class MediaCapture: NSObject, @unchecked Sendable {
         streamOutput = output
         
         // Create SCStream.
+        streamConfiguration = configuration
         stream = SCStream(filter: filter, configuration: configuration, delegate: output)
         
         // Add stream output.
@@ -402,10 +388,159 @@ public class MediaCapture: NSObject, @unchecked Sendable {
         // Start capturing.
         try await stream?.startCapture()
         
+        currentTarget = target
         running = true
         return true
     }
+
+    /// Applies new settings to the running stream without stopping it.
+    ///
+    /// Frame interval, output size, image settings and the audio format go
+    /// through `updateConfiguration`; another target swaps the content filter
+    /// with `updateContentFilter`. Neither restarts the stream.
+    /// - Parameters:
+    ///   - target: The capture target; may differ from the current one.
+    ///   - framesPerSecond: Frames per second; 0 keeps video off if it was off.
+    ///   - quality: Capture quality.
+    ///   - imageFormat: Format of captured images (jpeg, raw).
+    ///   - imageQuality: Quality of image compression (0.0-1.0).
+    ///   - audioSampleRate: Audio sampling rate in Hz.
+    ///   - audioChannelCount: Number of audio channels.
+    public func reconfigure(
+        target: MediaCaptureTarget,
+        framesPerSecond: Double,
+        quality: CaptureQuality,
+        imageFormat: ImageFormat,
+        imageQuality: ImageQuality = .standard,
+        audioSampleRate: Int,
+        audioChannelCount: Int
+    ) async throws {
+        guard running, let stream = stream, let configuration = streamConfiguration, let output = streamOutput else {
+            throw NSError(domain: "MediaCapture", code: 5, userInfo: [NSLocalizedDescriptionKey: "No capture in progress"])
+        }
+
+        if target != currentTarget {
+            try await stream.updateContentFilter(try await createContentFilter(from: target))
+            currentTarget = target
+        }
+
+        configuration.sampleRate = audioSampleRate
+        configuration.channelCount = audioChannelCount
+        if framesPerSecond > 0 {
+            applyVideoSettings(to: configuration, target: target, framesPerSecond: framesPerSecond, quality: quality)
+        }
+        try await stream.updateConfiguration(configuration)
+
+        output.configureAudioSettings(sampleRate: audioSampleRate, channelCount: audioChannelCount)
+        output.configureImageSettings(format: imageFormat, quality: imageQuality)
+        if framesPerSecond > 0 {
+            output.configureFrameRate(fps: framesPerSecond)
+        }
+    }
+
+    /// Sets the frame interval and the output size of a target at a capture quality.
+    private func applyVideoSettings(
+        to configuration: SCStreamConfiguration,
+        target: MediaCaptureTarget,
+        framesPerSecond: Double,
+        quality: CaptureQuality
+    ) {
+        if framesPerSecond >= 1.0 {
+            configuration.minimumFrameInterval = CMTime(value: 1, timescale: CMTimeScale(framesPerSecond))
+        } else {
+            let seconds = 1.0 / framesPerSecond
+            configuration.minimumFrameInterval = CMTime(seconds: seconds, preferredTimescale: 600)
+        }
+
+        // Get scaling factor based on quality
+        let scaleFactor = Double(quality.scale)
+
+        if target.isWindow {
+            // For window capture, use the window dimensions
+            let windowWidth = Int(target.frame.width)
+            let windowHeight = Int(target.frame.height)
+            
+            if windowWidth > 0 && windowHeight > 0 {
+                // Apply scaling based on quality
+                let scaledWidth = Int(Double(windowWidth) * scaleFactor)
+                let scaledHeight = Int(Double(windowHeight) * scaleFactor)
+                
+                // Always set dimensions for window capture to ensure correct size
+                configuration.width = scaledWidth
+                configuration.height = scaledHeight
+            }
+        } else {
+            // For display capture, use the display dimensions
+            let mainDisplayID = target.displayID > 0 ? target.displayID : CGMainDisplayID()
+            let width = CGDisplayPixelsWide(mainDisplayID)
+            let height = CGDisplayPixelsHigh(mainDisplayID)
+            
+            let scaledWidth = Int(Double(width) * scaleFactor)
+            let scaledHeight = Int(Double(height) * scaleFactor)
+            
+            configuration.width = scaledWidth
+            configuration.height = scaledHeight
+        }
+        
+        // Region of interest
+        targetBounds = CGRect(origin: .zero, size: target.frame.size)
+        fullOutputSize = CGSize(width: configuration.width, height: configuration.height)
+        applyCropRect(to: configuration)
+    }
+    
+    /// Sets the region of interest of the capture.
+    /// - Parameter rect: Region in target coordinates (points), or nil for the full target.
+    ///   Applied immediately to a running stream via `sourceRect`, without restarting it.
+    public func updateCropRect(_ rect: CGRect?) async throws {
+        if let rect = rect, rect.width > 0, rect.height > 0 {
+            cropRect = rect
+        } else {
+            cropRect = nil
+        }
+        
+        guard let stream = stream, let configuration = streamConfiguration else { return }
+        applyCropRect(to: configuration)
+        try await stream.updateConfiguration(configuration)
+    }
+    
+    /// Applies the current region of interest to a stream configuration.
+    private func applyCropRect(to configuration: SCStreamConfiguration) {
+        guard fullOutputSize.width > 0, fullOutputSize.height > 0 else { return }
+        
+        // Clamp to the target; an empty intersection falls back to the full target
+        var region = CGRect.null
+        if let rect = cropRect {
+            region = targetBounds.isEmpty ? rect : rect.intersection(targetBounds)
+        }
+        
+        if region.isNull || region.isEmpty {
+            configuration.sourceRect = .null
+            configuration.width = Int(fullOutputSize.width)
+            configuration.height = Int(fullOutputSize.height)
+            return
+        }
+        
+        // Keep the output scale of the selected quality for the cropped area
+        let scaleX = targetBounds.isEmpty ? 1.0 : fullOutputSize.width / targetBounds.width
+        let scaleY = targetBounds.isEmpty ? 1.0 : fullOutputSize.height / targetBounds.height
+        configuration.sourceRect = region
+        configuration.width = max(1, Int(region.width * scaleX))
+        configuration.height = max(1, Int(region.height * scaleY))
+    }
     
+    /// Builds the content filter of a target ahead of `startCapture`.
+    ///
+    /// ScreenCaptureKit has no way to open a stream without starting it, so
+    /// this only takes the shareable-content query off the start path. The
+    /// next `startCapture` for the same target uses the filter; any start or
+    /// stop discards it.
+    /// - Parameter target: The capture target of the coming start.
+    public func prepare(target: MediaCaptureTarget) async throws {
+        let filter = try await createContentFilter(from: target)
+        preparedTarget = target
+        preparedFilter = filter
+    }
+
     /// Creates an `SCContentFilter` from a `MediaCaptureTarget`.
     private func createContentFilter(from target: MediaCaptureTarget) async throws -> SCContentFilter {
         let content = try await SCShareableContent.excludingDesktopWindows(false, onScreenWindowsOnly: true)
@@ -470,10 +605,14 @@ public class MediaCapture: NSObject, @unchecked Sendable {
     
     /// Stops capturing.
     public func stopCapture() async {
+        preparedTarget = nil
+        preparedFilter = nil
         if running {
             try? await stream?.stopCapture()
             stream = nil
+            streamConfiguration = nil
             streamOutput = nil
+            currentTarget = nil
             running = false
             mediaHandler = nil
         }
@@ -484,7 +623,9 @@ public class MediaCapture: NSObject, @unchecked Sendable {
         if running {
             let localStream = stream
             stream = nil
+            streamConfiguration = nil
             streamOutput = nil
+            currentTarget = nil
             
             let semaphore = DispatchSemaphore(value: 0)
             DispatchQueue.global(qos: .userInitiated).async {
@@ -75,6 +75,13 @@ fileprivate func findMediaWindow(_ windows: [SCWindow], _ windowID: UInt32) -> S
     return nil
 }
 
+fileprivate func mediaCropRect(_ rect: MediaCaptureRectC) -> CGRect? {
+    if rect.width <= 0 || rect.height <= 0 {
+        return nil
+    }
+    return CGRect(x: Int(rect.x), y: Int(rect.y), width: Int(rect.width), height: Int(rect.height))
+}
+
 // Bridge functions to C/C++ layer
 
 @_cdecl("createMediaCapture")
@@ -203,13 +210,8 @@ public func enumerateMediaCaptureTargets(_ type: Int32, _ callback: EnumerateMed
         }
     }
     
-    if Thread.isMainThread {
-        executeCallbacks()
-    } else {
-        DispatchQueue.main.async {
-            executeCallbacks()
-        }
-    }
+    // Callers read the results before this returns, including the target registry's polling thread
+    executeCallbacks()
 }
 
 // C callback type definitions
@@ -229,6 +231,89 @@ public typealias MediaCaptureExitCallback = @convention(c) (
     UnsafePointer<Int8>?, UnsafeRawPointer?
 ) -> Void
 
+/// Finds the display, window or application window a configuration names.
+/// The bundle ID is passed as a String because the caller frees the C string once the call returns.
+fileprivate func resolveMediaTarget(_ config: MediaCaptureConfigC, bundleID: String?) async throws -> MediaCaptureTarget? {
+    var target: MediaCaptureTarget?
+
+    if config.displayID > 0 {
+        let targets = try await MediaCapture.availableCaptureTargets(ofType: .screen)
+        target = targets.first { $0.displayID == config.displayID }
+
+        if target == nil {
+            fputs("DEBUG: Display with ID \(config.displayID) not found\n", stderr)
+        }
+    } else if config.windowID > 0 {
+        let targets = try await MediaCapture.availableCaptureTargets(ofType: .window)
+        target = targets.first { $0.windowID == config.windowID }
+
+        if target == nil {
+            fputs("DEBUG: Window with ID \(config.windowID) not found\n", stderr)
+        }
+    } else if let bundleID = bundleID {
+        let targets = try await MediaCapture.availableCaptureTargets(ofType: .window)
+        target = targets.first {
+            if let appName = $0.applicationName {
+                return appName.contains(bundleID)
+            }
+            return false
+        }
+
+        if target == nil {
+            fputs("DEBUG: App with bundle ID \(bundleID) not found\n", stderr)
+        }
+    }
+    return target
+}
+
+/// Whether a prepared target is the display or window a configuration names; bundle IDs are always resolved again.
+fileprivate func mediaTargetMatches(_ target: MediaCaptureTarget, _ config: MediaCaptureConfigC) -> Bool {
+    if config.displayID > 0 {
+        return target.displayID == config.displayID
+    }
+    if config.windowID > 0 {
+        return target.windowID == config.windowID
+    }
+    return false
+}
+
+@_cdecl("prepareMediaCapture")
+public func prepareMediaCapture(
+    _ p: UnsafeMutableRawPointer,
+    _ config: MediaCaptureConfigC,
+    _ callback: MediaCaptureExitCallback,
+    _ context: UnsafeMutableRawPointer?
+) {
+    if p == UnsafeMutableRawPointer(bitPattern: 0) {
+        "Invalid MediaCapture instance".withCString { ptr in
+            callback(ptr, context)
+        }
+        return
+    }
+
+    let capture = Unmanaged<MediaCapture>.fromOpaque(p).takeUnretainedValue()
+    let sendableCtx = MediaSendableContext(value: context)
+    let bundleID = config.bundleID.map { String(cString: $0) }
+
+    Task {
+        let context = sendableCtx.value
+        do {
+            guard let target = try await resolveMediaTarget(config, bundleID: bundleID) else {
+                "No valid capture target found".withCString { ptr in
+                    callback(ptr, context)
+                }
+                return
+            }
+            try await capture.prepare(target: target)
+            callback(nil, context)
+        } catch {
+            "Exception during prepareMediaCapture: \(error.localizedDescription)".withCString { ptr in
+                callback(ptr, context)
+            }
+        }
+    }
+}
+
 @_cdecl("startMediaCapture")
 public func startMediaCapture(
     _ p: UnsafeMutableRawPointer,
@@ -251,6 +336,7 @@ public func startMediaCapture(
     let capture = Unmanaged<MediaCapture>.fromOpaque(p).takeUnretainedValue()
 
     let sendableCtx = MediaSendableContext(value: context)
+    let bundleID = config.bundleID.map { String(cString: $0) }
 
     Task {
         let context = sendableCtx.value
@@ -260,7 +346,7 @@ public func startMediaCapture(
 
             // fputs("DEBUG: Configured quality: \(quality)\n", stderr)
 
-            if config.displayID == 0 && config.windowID == 0 && config.bundleID == nil {
+            if config.displayID == 0 && config.windowID == 0 && bundleID == nil {
                 fputs("DEBUG: No valid capture target specified\n", stderr)
                 "No valid capture target specified".withCString { ptr in
                     exitCallback(ptr, context)
@@ -268,38 +354,12 @@ public func startMediaCapture(
                 return
             }
 
+            // A target resolved by prepareMediaCapture saves another enumeration
             var target: MediaCaptureTarget?
-
-            if config.displayID > 0 {
-                // fputs("DEBUG: Finding display with ID \(config.displayID)\n", stderr)
-                let targets = try await MediaCapture.availableCaptureTargets(ofType: .screen)
-                target = targets.first { $0.displayID == config.displayID }
-
-                if target == nil {
-                    fputs("DEBUG: Display with ID \(config.displayID) not found\n", stderr)
-                }
-            } else if config.windowID > 0 {
-                // fputs("DEBUG: Finding window with ID \(config.windowID)\n", stderr)
-                let targets = try await MediaCapture.availableCaptureTargets(ofType: .window)
-                target = targets.first { $0.windowID == config.windowID }
-
-                if target == nil {
-                    fputs("DEBUG: Window with ID \(config.windowID) not found\n", stderr)
-                }
-            } else if let bundleID = config.bundleID {
-                // fputs("DEBUG: Finding app with bundle ID \(String(cString: bundleID))\n", stderr)
-                let targets = try await MediaCapture.availableCaptureTargets(ofType: .window)
-                let bundleIDStr = String(cString: bundleID)
-                target = targets.first {
-                    if let appName = $0.applicationName {
-                        return appName.contains(bundleIDStr)
-                    }
-                    return false
-                }
-
-                if target == nil {
-                    fputs("DEBUG: App with bundle ID \(String(cString: bundleID)) not found\n", stderr)
-                }
+            if let prepared = capture.preparedTarget, mediaTargetMatches(prepared, config) {
+                target = prepared
+            } else {
+                target = try await resolveMediaTarget(config, bundleID: bundleID)
             }
 
             guard let captureTarget = target else {
@@ -319,6 +379,9 @@ public func startMediaCapture(
             fputs("DEBUG: Starting capture with target: \(targetDesc), Size=\(Int(captureTarget.frame.width))x\(Int(captureTarget.frame.height))\n", stderr)
             */
 
+            // The configured region of interest replaces any previous one
+            try await capture.updateCropRect(mediaCropRect(config.cropRect))
+
             let success = try await capture.startCapture(
                 target: captureTarget,
                 mediaHandler: { media in
@@ -384,6 +447,7 @@ public func startMediaCapture(
                 },
                 framesPerSecond: Double(config.frameRate),
                 quality: quality,
+                imageFormat: config.imageFormat == 1 ? .raw : .jpeg,
                 audioSampleRate: Int(config.audioSampleRate),
                 audioChannelCount: Int(config.audioChannels),
                 isElectron: config.isElectron != 0
@@ -427,6 +491,42 @@ public func startMediaCapture(
     }
 }
 
+/// Each ScreenCaptureKit stream already runs on its own queues; sharing one
+/// capture thread between targets is not implemented on macOS yet.
+@_cdecl("startMultiTargetMediaCapture")
+public func startMultiTargetMediaCapture(
+    _ p: UnsafeMutableRawPointer,
+    _ config: MediaCaptureConfigC,
+    _ targets: UnsafePointer<MediaCaptureTargetRefC>?,
+    _ targetCount: Int32,
+    _ videoCallback: MediaCaptureTargetDataCallback,
+    _ audioCallback: MediaCaptureAudioDataCallback,
+    _ exitCallback: MediaCaptureExitCallback,
+    _ context: UnsafeMutableRawPointer?
+) {
+    "Capturing several targets in one session is not supported on macOS".withCString { ptr in
+        exitCallback(ptr, context)
+    }
+}
+
+/// The ScreenCaptureKit path encodes in its sample handler; sharing its
+/// frames between several renditions is not implemented on macOS yet.
+@_cdecl("startMultiRenditionMediaCapture")
+public func startMultiRenditionMediaCapture(
+    _ p: UnsafeMutableRawPointer,
+    _ config: MediaCaptureConfigC,
+    _ renditions: UnsafePointer<MediaCaptureRenditionC>?,
+    _ renditionCount: Int32,
+    _ videoCallback: MediaCaptureTargetDataCallback,
+    _ audioCallback: MediaCaptureAudioDataCallback,
+    _ exitCallback: MediaCaptureExitCallback,
+    _ context: UnsafeMutableRawPointer?
+) {
+    "Delivering several renditions in one session is not supported on macOS".withCString { ptr in
+        exitCallback(ptr, context)
+    }
+}
+
 @_cdecl("stopMediaCapture")
 public func stopMediaCapture(_ p: UnsafeMutableRawPointer, _ callback: StopCaptureCallback, _ context: UnsafeMutableRawPointer?) {
     let capture = Unmanaged<MediaCapture>.fromOpaque(p).takeUnretainedValue()
@@ -443,4 +543,87 @@ public func stopMediaCapture(_ p: UnsafeMutableRawPointer, _ callback: StopCaptu
             capture.stopCaptureSync()
         }
     }
-}
\ No newline at end of file
+}
+
+@_cdecl("setMediaCaptureCropRect")
+public func setMediaCaptureCropRect(
+    _ p: UnsafeMutableRawPointer,
+    _ cropRect: MediaCaptureRectC,
+    _ callback: MediaCaptureExitCallback,
+    _ context: UnsafeMutableRawPointer?
+) {
+    let capture = Unmanaged<MediaCapture>.fromOpaque(p).takeUnretainedValue()
+    let rect = mediaCropRect(cropRect)
+    let sendableCtx = MediaSendableContext(value: context)
+
+    Task {
+        let context = sendableCtx.value
+        do {
+            try await capture.updateCropRect(rect)
+            callback(nil, context)
+        } catch {
+            "Failed to update crop rect: \(error.localizedDescription)".withCString { ptr in
+                callback(ptr, context)
+            }
+        }
+    }
+}
+
+@_cdecl("reconfigureMediaCapture")
+public func reconfigureMediaCapture(
+    _ p: UnsafeMutableRawPointer,
+    _ config: MediaCaptureConfigC,
+    _ callback: MediaCaptureExitCallback,
+    _ context: UnsafeMutableRawPointer?
+) {
+    if p == UnsafeMutableRawPointer(bitPattern: 0) {
+        "Invalid MediaCapture instance".withCString { ptr in
+            callback(ptr, context)
+        }
+        return
+    }
+
+    let capture = Unmanaged<MediaCapture>.fromOpaque(p).takeUnretainedValue()
+    let sendableCtx = MediaSendableContext(value: context)
+    let bundleID = config.bundleID.map { String(cString: $0) }
+
+    Task {
+        let context = sendableCtx.value
+        do {
+            guard let target = try await resolveMediaTarget(config, bundleID: bundleID) else {
+                "No valid capture target found".withCString { ptr in
+                    callback(ptr, context)
+                }
+                return
+            }
+            try await capture.updateCropRect(mediaCropRect(config.cropRect))
+            try await capture.reconfigure(
+                target: target,
+                framesPerSecond: Double(config.frameRate),
+                quality: MediaCapture.CaptureQuality(rawValue: Int(config.quality)) ?? .medium,
+                imageFormat: config.imageFormat == 1 ? .raw : .jpeg,
+                audioSampleRate: Int(config.audioSampleRate),
+                audioChannelCount: Int(config.audioChannels)
+            )
+            callback(nil, context)
+        } catch {
+            "Exception during reconfigureMediaCapture: \(error.localizedDescription)".withCString { ptr in
+                callback(ptr, context)
+            }
+        }
+    }
+}
+
+/// Adaptive quality needs the native encode pipeline; ScreenCaptureKit frames
+/// are encoded in Swift, so budgets are not applied on macOS yet.
+@_cdecl("getMediaCaptureQualityStats")
+public func getMediaCaptureQualityStats(_ p: UnsafeMutableRawPointer, _ stats: UnsafeMutablePointer<MediaCaptureQualityStatsC>) -> Int32 {
+    return 0
+}
+
+/// Stage timings come from the native pipelines; on macOS only the addon's
+/// delivery statistics are available.
+@_cdecl("getMediaCaptureStats")
+public func getMediaCaptureStats(_ p: UnsafeMutableRawPointer, _ stats: UnsafeMutablePointer<MediaCaptureStatsC>) -> Int32 {
+    return 0
+}
@@ -0,0 +1,194 @@
+/**
+ * @file adaptivequality.cc
+ * @brief Implementation of the adaptive quality controller
+ */
+#include "adaptivequality.h"
+#include <algorithm>
+
+namespace {
+
+/** Weight of the newest sample in the exponential moving averages */
+constexpr double kSmoothing = 0.2;
+
+double smooth(double average, double value) {
+  return average + kSmoothing * (value - average);
+}
+
+} // namespace
+
+AdaptiveQualityController::AdaptiveQualityController(
+    const QualityBudget &budget, const QualityBounds &bounds, const QualitySettings &initial) :
+    budget(budget),
+    bounds(clampBounds(bounds, initial)),
+    ceiling(initial) {
+  state.settings = initial;
+}
+
+QualityBounds AdaptiveQualityController::clampBounds(const QualityBounds &bounds, const QualitySettings &initial) {
+  return {std::min(std::max(bounds.minQuality, 1), initial.quality),
+          std::min(std::max(bounds.minScale, 0.01), initial.scale),
+          std::min(std::max(bounds.minFrameRate, 0.1), initial.frameRate)};
+}
+
+bool AdaptiveQualityController::enabled() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return budget.maxEncodeMsPerFrame > 0 || budget.maxBytesPerSecond > 0;
+}
+
+void AdaptiveQualityController::reconfigure(
+    const QualityBudget &budget, const QualityBounds &bounds, const QualitySettings &initial) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->budget    = budget;
+  this->bounds    = clampBounds(bounds, initial);
+  ceiling         = initial;
+  state.settings  = initial;
+  settleRemaining = kSettleSamples;
+  headroomSamples = 0;
+}
+
+bool AdaptiveQualityController::addSample(const EncodeSample &sample) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  const double intervalMs = (lastTimestampNs > 0 && sample.timestampNs > lastTimestampNs)
+                                ? static_cast<double>(sample.timestampNs - lastTimestampNs) / 1e6
+                                : 0;
+  lastTimestampNs = sample.timestampNs;
+
+  if (!primed) {
+    state.encodeMs   = sample.encodeMs;
+    state.queueDepth = static_cast<double>(sample.queueDepth);
+    bytesPerFrame    = static_cast<double>(sample.bytes);
+    frameIntervalMs  = 1000.0 / state.settings.frameRate;
+    primed           = true;
+  } else {
+    state.encodeMs   = smooth(state.encodeMs, sample.encodeMs);
+    state.queueDepth = smooth(state.queueDepth, static_cast<double>(sample.queueDepth));
+    bytesPerFrame    = smooth(bytesPerFrame, static_cast<double>(sample.bytes));
+    if (intervalMs > 0) {
+      frameIntervalMs = smooth(frameIntervalMs, intervalMs);
+    }
+  }
+
+  // Frames may be delivered slower than the configured rate, never faster
+  const double deliveredRate = std::min(state.settings.frameRate, 1000.0 / std::max(frameIntervalMs, 1e-3));
+  state.bytesPerSecond       = bytesPerFrame * deliveredRate;
+
+  if (budget.maxEncodeMsPerFrame <= 0 && budget.maxBytesPerSecond <= 0) {
+    return false;
+  }
+  if (settleRemaining > 0) {
+    settleRemaining--;
+    return false;
+  }
+
+  const double encodeRatio = budget.maxEncodeMsPerFrame > 0 ? state.encodeMs / budget.maxEncodeMsPerFrame : 0;
+  const double bytesRatio  = budget.maxBytesPerSecond > 0 ? state.bytesPerSecond / budget.maxBytesPerSecond : 0;
+
+  QualityPressure pressure = QualityPressure::None;
+  if (encodeRatio > 1.0 || bytesRatio > 1.0) {
+    pressure = encodeRatio >= bytesRatio ? QualityPressure::EncodeTime : QualityPressure::Bandwidth;
+  } else if (state.queueDepth > 1.0) {
+    pressure = QualityPressure::Backlog;
+  }
+
+  bool changed = false;
+  if (pressure != QualityPressure::None) {
+    headroomSamples = 0;
+    changed         = downgrade(pressure);
+  } else if (encodeRatio < kHeadroom && bytesRatio < kHeadroom && state.queueDepth < 0.5) {
+    if (++headroomSamples >= kRecoverySamples) {
+      headroomSamples = 0;
+      changed         = upgrade();
+    }
+  } else {
+    headroomSamples = 0;
+  }
+
+  if (changed) {
+    settleRemaining = kSettleSamples;
+  }
+  return changed;
+}
+
+bool AdaptiveQualityController::downgrade(QualityPressure pressure) {
+  QualitySettings &s = state.settings;
+
+  auto lowerQuality = [&] {
+    if (s.quality <= bounds.minQuality) {
+      return false;
+    }
+    s.quality            = std::max(bounds.minQuality, s.quality - 10);
+    state.lastAdjustment = QualityAdjustment::LowerQuality;
+    return true;
+  };
+  auto lowerScale = [&] {
+    if (s.scale <= bounds.minScale) {
+      return false;
+    }
+    s.scale              = std::max(bounds.minScale, s.scale * 0.75);
+    state.lastAdjustment = QualityAdjustment::LowerScale;
+    return true;
+  };
+  auto lowerFrameRate = [&] {
+    if (s.frameRate <= bounds.minFrameRate) {
+      return false;
+    }
+    s.frameRate          = std::max(bounds.minFrameRate, s.frameRate * 0.75);
+    state.lastAdjustment = QualityAdjustment::LowerFrameRate;
+    return true;
+  };
+
+  // Bytes respond most to quality; encode time and backlog to the number of pixels
+  const bool changed = pressure == QualityPressure::Bandwidth ? (lowerQuality() || lowerScale() || lowerFrameRate())
+                                                               : (lowerScale() || lowerFrameRate() || lowerQuality());
+  if (changed) {
+    state.downgrades++;
+    state.lastPressure = pressure;
+  }
+  return changed;
+}
+
+bool AdaptiveQualityController::upgrade() {
+  QualitySettings &s = state.settings;
+
+  auto raiseFrameRate = [&] {
+    if (s.frameRate >= ceiling.frameRate) {
+      return false;
+    }
+    s.frameRate          = std::min(ceiling.frameRate, s.frameRate * 1.25);
+    state.lastAdjustment = QualityAdjustment::RaiseFrameRate;
+    return true;
+  };
+  auto raiseScale = [&] {
+    if (s.scale >= ceiling.scale) {
+      return false;
+    }
+    s.scale              = std::min(ceiling.scale, s.scale * 1.25);
+    state.lastAdjustment = QualityAdjustment::RaiseScale;
+    return true;
+  };
+  auto raiseQuality = [&] {
+    if (s.quality >= ceiling.quality) {
+      return false;
+    }
+    s.quality            = std::min(ceiling.quality, s.quality + 5);
+    state.lastAdjustment = QualityAdjustment::RaiseQuality;
+    return true;
+  };
+
+  const bool changed = raiseFrameRate() || raiseScale() || raiseQuality();
+  if (changed) {
+    state.upgrades++;
+  }
+  return changed;
+}
+
+QualitySettings AdaptiveQualityController::settings() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return state.settings;
+}
+
+AdaptiveQualityStats AdaptiveQualityController::stats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return state;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file adaptivequality.h
+ * @brief Closed-loop controller that keeps video encoding within budget
+ *
+ * The encode stage reports the cost of every frame (encode time, output size,
+ * queue depth). When a budget is exceeded the controller steps down one knob
+ * at a time; after a sustained period well under budget it steps back up.
+ *
+ *  - Encode time or a growing queue: downscale first, then frame rate, then quality
+ *  - Output bytes per second: quality first, then downscale, then frame rate
+ *
+ * Recovery undoes the cheapest-to-restore knob first (frame rate, downscale,
+ * quality) in smaller steps, and every change is followed by a settling
+ * period so the smoothed measurements reflect the new settings.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * @struct QualityBudget
+ * @brief Limits the controller keeps the encoder within; 0 disables a limit
+ */
+struct QualityBudget {
+  double maxEncodeMsPerFrame = 0; /**< Mean encode time per frame */
+  double maxBytesPerSecond   = 0; /**< Encoded output rate */
+};
+
+/**
+ * @struct QualitySettings
+ * @brief Encoder settings chosen by the controller
+ */
+struct QualitySettings {
+  int32_t quality   = 75;  /**< JPEG quality (1-100) */
+  double  scale     = 1.0; /**< Output size relative to the captured frame (0-1] */
+  double  frameRate = 30;  /**< Capture rate in frames per second */
+};
+
+/**
+ * @struct QualityBounds
+ * @brief Range the controller may move the settings in
+ *
+ * The upper bounds are the configured settings, so the controller never
+ * produces more than was asked for.
+ */
+struct QualityBounds {
+  int32_t minQuality   = 30;   /**< Lowest JPEG quality */
+  double  minScale     = 0.25; /**< Smallest downscale factor */
+  double  minFrameRate = 1;    /**< Lowest frame rate */
+};
+
+/**
+ * @struct EncodeSample
+ * @brief Cost of one encoded frame
+ */
+struct EncodeSample {
+  double  encodeMs    = 0; /**< Time spent encoding */
+  size_t  bytes       = 0; /**< Encoded size */
+  size_t  queueDepth  = 0; /**< Frames waiting for the encoder afterwards */
+  int64_t timestampNs = 0; /**< Monotonic completion time */
+};
+
+/**
+ * @enum QualityPressure
+ * @brief Budget that triggered the last downgrade
+ */
+enum class QualityPressure : int32_t {
+  None       = 0, /**< No downgrade yet */
+  EncodeTime = 1, /**< maxEncodeMsPerFrame exceeded */
+  Bandwidth  = 2, /**< maxBytesPerSecond exceeded */
+  Backlog    = 3  /**< Frames accumulating in the encode queue */
+};
+
+/**
+ * @enum QualityAdjustment
+ * @brief The knob moved by the last decision
+ */
+enum class QualityAdjustment : int32_t {
+  None           = 0,
+  LowerQuality   = 1,
+  LowerScale     = 2,
+  LowerFrameRate = 3,
+  RaiseQuality   = 4,
+  RaiseScale     = 5,
+  RaiseFrameRate = 6
+};
+
+/**
+ * @struct AdaptiveQualityStats
+ * @brief Controller state and decisions
+ */
+struct AdaptiveQualityStats {
+  QualitySettings   settings;                                 /**< Settings currently in effect */
+  double            encodeMs       = 0;                       /**< Smoothed encode time per frame */
+  double            bytesPerSecond = 0;                       /**< Smoothed output rate */
+  double            queueDepth     = 0;                       /**< Smoothed queue depth */
+  uint64_t          downgrades     = 0;                       /**< Number of downward steps */
+  uint64_t          upgrades       = 0;                       /**< Number of upward steps */
+  QualityAdjustment lastAdjustment = QualityAdjustment::None; /**< Most recent step */
+  QualityPressure   lastPressure   = QualityPressure::None;   /**< Cause of the most recent downgrade */
+};
+
+/**
+ * @class AdaptiveQualityController
+ * @brief Adjusts quality, downscale and frame rate from measured encode cost
+ *
+ * addSample() is called from the encode thread; settings() and stats() may be
+ * called from any thread.
+ */
+class AdaptiveQualityController {
+public:
+  /** Samples to wait after a change before judging its effect */
+  static constexpr int kSettleSamples = 8;
+
+  /** Consecutive samples well under budget required before stepping up */
+  static constexpr int kRecoverySamples = 30;
+
+  /** Fraction of a budget below which the encoder is considered to have headroom */
+  static constexpr double kHeadroom = 0.7;
+
+  /**
+   * @param budget Limits to enforce
+   * @param bounds Lower bounds of the settings
+   * @param initial Configured settings, also used as upper bounds
+   */
+  AdaptiveQualityController(const QualityBudget &budget, const QualityBounds &bounds, const QualitySettings &initial);
+
+  /**
+   * @brief Whether any limit is configured
+   */
+  bool enabled() const;
+
+  /**
+   * @brief Replace the budget, bounds and configured settings while frames keep arriving
+   *
+   * The settings restart from initial and the measurements are kept, so the
+   * controller judges the new settings after the usual settling period.
+   *
+   * @param budget Limits to enforce
+   * @param bounds Lower bounds of the settings
+   * @param initial Configured settings, also used as upper bounds
+   */
+  void reconfigure(const QualityBudget &budget, const QualityBounds &bounds, const QualitySettings &initial);
+
+  /**
+   * @brief Record the cost of one frame and possibly adjust the settings
+   * @return true if the settings changed
+   */
+  bool addSample(const EncodeSample &sample);
+
+  /**
+   * @brief Settings the encoder should use for the next frame
+   */
+  QualitySettings settings() const;
+
+  /**
+   * @brief Snapshot of measurements and decisions
+   */
+  AdaptiveQualityStats stats() const;
+
+private:
+  /** Step down one knob; returns false if everything is at its lower bound */
+  bool downgrade(QualityPressure pressure);
+
+  /** Step up one knob; returns false if everything is at its upper bound */
+  bool upgrade();
+
+  /** Bounds clamped to the configured settings */
+  static QualityBounds clampBounds(const QualityBounds &bounds, const QualitySettings &initial);
+
+  mutable std::mutex mutex;
+
+  /** @name Configuration; guarded by mutex */
+  ///@{
+  QualityBudget   budget;
+  QualityBounds   bounds;
+  QualitySettings ceiling;
+  ///@}
+
+  AdaptiveQualityStats state;
+  int64_t              lastTimestampNs = 0;
+  double               frameIntervalMs = 0; /**< Smoothed time between samples */
+  double               bytesPerFrame   = 0; /**< Smoothed encoded size */
+  bool                 primed          = false;
+  int                  settleRemaining = kSettleSamples;
+  int                  headroomSamples = 0;
+};
@@ -0,0 +1,74 @@
+/**
+ * @file audiochunker.cc
+ * @brief Implementation of fixed-duration audio chunking
+ */
+#include "audiochunker.h"
+#include <algorithm>
+
+AudioChunker::AudioChunker(uint32_t chunkMs) : chunkMs(chunkMs) {}
+
+void AudioChunker::push(const float *samples, uint32_t frames, int32_t channels, int32_t sampleRate,
+                        const SyncStamp &stamp, const ChunkCallback &onChunk) {
+  if (!samples || frames == 0 || channels <= 0 || sampleRate <= 0) {
+    return;
+  }
+  if (channels != currentChannels || sampleRate != currentRate) {
+    flush(onChunk);
+    currentChannels = channels;
+    currentRate     = sampleRate;
+    chunkFrames     = static_cast<uint32_t>(static_cast<uint64_t>(sampleRate) * chunkMs / 1000);
+  }
+  if (chunkFrames == 0) {
+    onChunk(samples, frames, stamp);
+    return;
+  }
+
+  uint32_t offset = 0;
+
+  // Complete the partial chunk first
+  if (pendingFrames > 0) {
+    uint32_t take = std::min(frames, chunkFrames - pendingFrames);
+    pending.insert(pending.end(), samples, samples + static_cast<size_t>(take) * channels);
+    pendingFrames += take;
+    offset = take;
+    if (pendingFrames < chunkFrames) {
+      return;
+    }
+    onChunk(pending.data(), chunkFrames, pendingStamp);
+    pending.clear();
+    pendingFrames = 0;
+  }
+
+  // Whole chunks are passed on straight from the block
+  while (frames - offset >= chunkFrames) {
+    onChunk(samples + static_cast<size_t>(offset) * channels, chunkFrames, advance(stamp, offset));
+    offset += chunkFrames;
+  }
+
+  if (offset < frames) {
+    pending.assign(samples + static_cast<size_t>(offset) * channels, samples + static_cast<size_t>(frames) * channels);
+    pendingFrames = frames - offset;
+    pendingStamp  = advance(stamp, offset);
+  }
+}
+
+void AudioChunker::flush(const ChunkCallback &onChunk) {
+  if (pendingFrames > 0) {
+    onChunk(pending.data(), pendingFrames, pendingStamp);
+  }
+  pending.clear();
+  pendingFrames = 0;
+}
+
+SyncStamp AudioChunker::advance(const SyncStamp &stamp, uint32_t frames) const {
+  SyncStamp advanced = stamp;
+  if (frames > 0 && currentRate > 0) {
+    if (advanced.valid) {
+      advanced.captureNs += static_cast<int64_t>(static_cast<double>(frames) * 1e9 / currentRate);
+    }
+    if (advanced.hasAudio) {
+      advanced.audioPosition += frames;
+    }
+  }
+  return advanced;
+}
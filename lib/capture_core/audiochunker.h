@@ -0,0 +1,81 @@
+/**
+ * @file audiochunker.h
+ * @brief Regroups audio blocks into chunks of a fixed duration
+ *
+ * Backends deliver audio in whatever block size the device uses. A consumer
+ * that processes fixed windows (speech recognition, level meters) wants
+ * chunks of a set length instead, each stamped with the capture time and
+ * stream position of its first sample.
+ */
+#pragma once
+
+#include "avsync.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * @class AudioChunker
+ * @brief Splits and joins interleaved float blocks into fixed-length chunks
+ *
+ * Used from the audio delivery thread only.
+ */
+class AudioChunker {
+public:
+  /**
+   * @brief Receives a chunk; samples are only valid during the call
+   * @param samples Interleaved samples, frames * channels
+   * @param frames Samples per channel in the chunk
+   * @param stamp Stamp of the chunk's first sample; invalid if the blocks had none
+   */
+  using ChunkCallback = std::function<void(const float *samples, uint32_t frames, const SyncStamp &stamp)>;
+
+  /**
+   * @brief Constructor
+   * @param chunkMs Chunk duration in milliseconds; 0 passes blocks through unchanged
+   */
+  explicit AudioChunker(uint32_t chunkMs);
+
+  /**
+   * @brief Append a block and pass on every chunk it completes
+   *
+   * A change of channel count or sample rate first passes on the partial
+   * chunk of the previous format, so no samples are lost or mixed.
+   *
+   * @param samples Interleaved samples, frames * channels
+   * @param frames Samples per channel in the block
+   * @param channels Channel count of the block
+   * @param sampleRate Sample rate of the block
+   * @param stamp Stamp of the block's first sample
+   * @param onChunk Called for each completed chunk, in order
+   */
+  void push(const float *samples, uint32_t frames, int32_t channels, int32_t sampleRate, const SyncStamp &stamp,
+            const ChunkCallback &onChunk);
+
+  /**
+   * @brief Pass on the partial chunk, if any
+   */
+  void flush(const ChunkCallback &onChunk);
+
+  /**
+   * @brief Channel count of the chunks being collected
+   */
+  int32_t channels() const { return currentChannels; }
+
+  /**
+   * @brief Sample rate of the chunks being collected
+   */
+  int32_t sampleRate() const { return currentRate; }
+
+private:
+  /** Stamp of the sample `frames` after the one stamped by stamp */
+  SyncStamp advance(const SyncStamp &stamp, uint32_t frames) const;
+
+  uint32_t           chunkMs;
+  uint32_t           chunkFrames     = 0;
+  int32_t            currentChannels = 0;
+  int32_t            currentRate     = 0;
+  std::vector<float> pending;
+  uint32_t           pendingFrames = 0;
+  SyncStamp          pendingStamp;
+};
@@ -0,0 +1,43 @@
+/**
+ * @file audioconvert.cc
+ * @brief Implementation of the audio sample conversions
+ */
+#include "audioconvert.h"
+#include <algorithm>
+#include <cstring>
+
+void downmixToMono(const float *src, int32_t channels, size_t frameCount, float *dst) {
+  if (channels <= 1) {
+    if (dst != src) {
+      std::memcpy(dst, src, frameCount * sizeof(float));
+    }
+    return;
+  }
+
+  // Stereo is by far the common case; the fixed-count loop vectorizes
+  if (channels == 2) {
+    for (size_t i = 0; i < frameCount; i++) {
+      dst[i] = (src[2 * i] + src[2 * i + 1]) * 0.5f;
+    }
+    return;
+  }
+
+  const float scale = 1.0f / static_cast<float>(channels);
+  for (size_t i = 0; i < frameCount; i++) {
+    const float *frame = src + i * channels;
+    float        sum   = 0.0f;
+    for (int32_t ch = 0; ch < channels; ch++) {
+      sum += frame[ch];
+    }
+    dst[i] = sum * scale;
+  }
+}
+
+void convertFloatToInt16(const float *src, size_t count, int16_t *dst) {
+  // Clamp before scaling so +1.0 maps to 32767 and -1.0 to -32767, symmetric around zero.
+  // Rounding by adding +-0.5 and truncating keeps the loop free of library calls so it vectorizes.
+  for (size_t i = 0; i < count; i++) {
+    float sample = std::min(1.0f, std::max(-1.0f, src[i])) * 32767.0f;
+    dst[i]       = static_cast<int16_t>(sample + (sample >= 0.0f ? 0.5f : -0.5f));
+  }
+}
@@ -0,0 +1,33 @@
+/**
+ * @file audioconvert.h
+ * @brief Sample format and channel conversions on the audio delivery path
+ *
+ * Backends receive interleaved float samples from the system in whatever
+ * channel layout the device uses; these helpers reduce them to the layout and
+ * sample type the caller asked for. All functions write into caller-provided
+ * buffers and never allocate.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Average all channels of each frame into one
+ * @param src Interleaved samples, frameCount * channels
+ * @param channels Number of channels in src (1 copies the input)
+ * @param frameCount Number of frames
+ * @param dst Receives frameCount samples; may not alias src unless channels == 1
+ */
+void downmixToMono(const float *src, int32_t channels, size_t frameCount, float *dst);
+
+/**
+ * @brief Convert float samples in [-1, 1] to signed 16-bit PCM
+ *
+ * Out-of-range input is clamped rather than wrapped.
+ *
+ * @param src Float samples
+ * @param count Number of samples
+ * @param dst Receives count samples
+ */
+void convertFloatToInt16(const float *src, size_t count, int16_t *dst);
@@ -0,0 +1,114 @@
+/**
+ * @file audioring.h
+ * @brief Single-producer single-consumer ring of audio samples
+ *
+ * Sits between a real-time reader thread and the thread that delivers audio
+ * to callbacks. The storage is allocated once in the constructor, and neither
+ * write() nor read() takes a lock or allocates, so the reader never blocks on
+ * a slow consumer. When the ring is full, write() drops the newest samples and
+ * counts them as an overrun rather than overwriting data being read.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+/**
+ * @class AudioRingBuffer
+ * @brief Fixed-capacity lock-free FIFO of interleaved float samples
+ */
+class AudioRingBuffer {
+public:
+  /**
+   * @brief Constructor
+   * @param capacity Number of samples the ring holds (at least 1)
+   */
+  explicit AudioRingBuffer(size_t capacity) :
+      samples(new float[capacity > 0 ? capacity : 1]), sampleCount(capacity > 0 ? capacity : 1) {}
+
+  AudioRingBuffer(const AudioRingBuffer &)            = delete;
+  AudioRingBuffer &operator=(const AudioRingBuffer &) = delete;
+
+  /**
+   * @brief Append samples (producer thread only)
+   * @param data Samples to append
+   * @param count Number of samples
+   * @return Number of samples written; the rest were dropped and counted in overruns()
+   */
+  size_t write(const float *data, size_t count) {
+    uint64_t head    = writePos.load(std::memory_order_relaxed);
+    uint64_t tail    = readPos.load(std::memory_order_acquire);
+    size_t   free    = sampleCount - static_cast<size_t>(head - tail);
+    size_t   written = std::min(count, free);
+
+    copyIn(static_cast<size_t>(head % sampleCount), data, written);
+    writePos.store(head + written, std::memory_order_release);
+
+    if (written < count) {
+      overrunCount.fetch_add(count - written, std::memory_order_relaxed);
+    }
+    return written;
+  }
+
+  /**
+   * @brief Remove the oldest samples (consumer thread only)
+   * @param data Receives up to count samples
+   * @param count Maximum number of samples to read
+   * @return Number of samples read
+   */
+  size_t read(float *data, size_t count) {
+    uint64_t tail = readPos.load(std::memory_order_relaxed);
+    uint64_t head = writePos.load(std::memory_order_acquire);
+    size_t   got  = std::min(count, static_cast<size_t>(head - tail));
+
+    copyOut(static_cast<size_t>(tail % sampleCount), data, got);
+    readPos.store(tail + got, std::memory_order_release);
+    return got;
+  }
+
+  /**
+   * @brief Number of samples waiting to be read
+   */
+  size_t available() const {
+    return static_cast<size_t>(writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_acquire));
+  }
+
+  /**
+   * @brief Maximum number of samples held
+   */
+  size_t capacity() const {
+    return sampleCount;
+  }
+
+  /**
+   * @brief Total number of samples dropped because the ring was full
+   */
+  uint64_t overruns() const {
+    return overrunCount.load(std::memory_order_relaxed);
+  }
+
+private:
+  void copyIn(size_t offset, const float *data, size_t count) {
+    size_t first = std::min(count, sampleCount - offset);
+    std::memcpy(samples.get() + offset, data, first * sizeof(float));
+    std::memcpy(samples.get(), data + first, (count - first) * sizeof(float));
+  }
+
+  void copyOut(size_t offset, float *data, size_t count) const {
+    size_t first = std::min(count, sampleCount - offset);
+    std::memcpy(data, samples.get() + offset, first * sizeof(float));
+    std::memcpy(data + first, samples.get(), (count - first) * sizeof(float));
+  }
+
+  std::unique_ptr<float[]> samples;
+  size_t                   sampleCount;
+
+  // Producer and consumer positions on separate cache lines
+  alignas(64) std::atomic<uint64_t> writePos{0};
+  alignas(64) std::atomic<uint64_t> readPos{0};
+  std::atomic<uint64_t>             overrunCount{0};
+};
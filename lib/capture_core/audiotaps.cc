@@ -0,0 +1,300 @@
+/**
+ * @file audiotaps.cc
+ * @brief Implementation of the audio resampler and tap set
+ */
+#include "audiotaps.h"
+#include "audioconvert.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+} // namespace
+
+void AudioResampler::configure(int32_t inputRate, int32_t outputRate, int32_t channels) {
+  this->inputRate  = inputRate;
+  this->outputRate = outputRate;
+  this->channels   = channels;
+  kernel.clear();
+  kernelHalfWidth = 0;
+  polyphase       = false;
+
+  if (inputRate <= 0 || outputRate <= 0 || channels <= 0 || inputRate == outputRate) {
+    reset();
+    return;
+  }
+
+  uint64_t divisor = std::gcd(static_cast<uint64_t>(inputRate), static_cast<uint64_t>(outputRate));
+  ratioIn          = inputRate / divisor;
+  ratioOut         = outputRate / divisor;
+
+  // Zeros of the sinc are 1 / (2 * cutoff) input frames apart; downsampling widens the kernel
+  cutoff          = 0.5 * kCutoff * std::min(1.0, static_cast<double>(outputRate) / inputRate);
+  kernelHalfWidth = static_cast<int32_t>(std::ceil(kZeroCrossings / (2.0 * cutoff)));
+  const int32_t taps = 2 * kernelHalfWidth;
+
+  if (ratioOut <= kMaxPhases) {
+    // Output frame k sits at input frame floor(k * in / out) plus phase (k * in % out) / out
+    polyphase = true;
+    kernel.resize(ratioOut * taps);
+    for (uint64_t phase = 0; phase < ratioOut; phase++) {
+      const double frac  = static_cast<double>(phase) / ratioOut;
+      float       *row   = kernel.data() + phase * taps;
+      double       total = 0;
+      for (int32_t m = 0; m < taps; m++) {
+        double weight = kernelAt(std::fabs(m - kernelHalfWidth + 1 - frac));
+        row[m]        = static_cast<float>(weight);
+        total += weight;
+      }
+      // Normalize each phase to unity gain at DC
+      for (int32_t m = 0; m < taps; m++) {
+        row[m] = static_cast<float>(row[m] / total);
+      }
+    }
+  } else {
+    kernel.resize(static_cast<size_t>(kernelHalfWidth) * kTablePhases + 2);
+    for (size_t i = 0; i < kernel.size(); i++) {
+      kernel[i] = static_cast<float>(kernelAt(static_cast<double>(i) / kTablePhases));
+    }
+    weights.resize(taps);
+  }
+  reset();
+}
+
+double AudioResampler::kernelAt(double d) const {
+  if (d >= kernelHalfWidth) {
+    return 0.0;
+  }
+  double x      = 2.0 * cutoff * d;
+  double sinc   = x == 0.0 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+  double u      = d / kernelHalfWidth;
+  double window = 0.42 + 0.5 * std::cos(kPi * u) + 0.08 * std::cos(2.0 * kPi * u);
+  return 2.0 * cutoff * sinc * window;
+}
+
+void AudioResampler::reset() {
+  // Silence before the first frame lets output frame 0 line up with input frame 0
+  history.assign(static_cast<size_t>(kernelHalfWidth) * std::max(channels, 0), 0.0f);
+  historyStart = -kernelHalfWidth;
+  inputFrames  = 0;
+  outputFrames = 0;
+  outputOffset = 0;
+}
+
+uint32_t AudioResampler::process(const float *input, uint32_t frames, std::vector<float> &out) {
+  out.clear();
+  if (!input || frames == 0 || channels <= 0) {
+    return 0;
+  }
+  if (inputRate == outputRate || kernelHalfWidth == 0) {
+    out.assign(input, input + static_cast<size_t>(frames) * channels);
+    outputOffset = 0;
+    inputFrames += frames;
+    outputFrames += frames;
+    return frames;
+  }
+
+  const int64_t blockStart = inputFrames;
+  history.insert(history.end(), input, input + static_cast<size_t>(frames) * channels);
+  inputFrames += frames;
+
+  const int32_t taps = 2 * kernelHalfWidth;
+  outputOffset       = static_cast<double>(outputFrames * ratioIn) / ratioOut - blockStart;
+
+  uint32_t produced = 0;
+  for (;;) {
+    const uint64_t position = outputFrames * ratioIn;
+    const int64_t  centre   = static_cast<int64_t>(position / ratioOut);
+    const uint64_t phase    = position % ratioOut;
+    if (centre + kernelHalfWidth >= inputFrames) {
+      break;
+    }
+
+    const float *row = nullptr;
+    if (polyphase) {
+      row = kernel.data() + phase * taps;
+    } else {
+      const double frac  = static_cast<double>(phase) / ratioOut;
+      double       total = 0;
+      for (int32_t m = 0; m < taps; m++) {
+        double  table = std::fabs(m - kernelHalfWidth + 1 - frac) * kTablePhases;
+        size_t  index = static_cast<size_t>(table);
+        double  t     = table - index;
+        double  value = kernel[index] + t * (kernel[index + 1] - kernel[index]);
+        weights[m]    = static_cast<float>(value);
+        total += value;
+      }
+      for (int32_t m = 0; m < taps; m++) {
+        weights[m] = static_cast<float>(weights[m] / total);
+      }
+      row = weights.data();
+    }
+
+    const float *base = history.data() + static_cast<size_t>(centre - kernelHalfWidth + 1 - historyStart) * channels;
+    for (int32_t ch = 0; ch < channels; ch++) {
+      float sum = 0.0f;
+      for (int32_t m = 0; m < taps; m++) {
+        sum += row[m] * base[static_cast<size_t>(m) * channels + ch];
+      }
+      out.push_back(sum);
+    }
+    outputFrames++;
+    produced++;
+  }
+
+  // Keep only the input the next output frame still needs
+  const int64_t nextFirst = static_cast<int64_t>(outputFrames * ratioIn / ratioOut) - kernelHalfWidth + 1;
+  if (nextFirst > historyStart) {
+    history.erase(history.begin(), history.begin() + static_cast<size_t>(nextFirst - historyStart) * channels);
+    historyStart = nextFirst;
+  }
+  return produced;
+}
+
+size_t AudioTapSet::addTap(const AudioTapConfig &config) {
+  taps.push_back(std::make_unique<Tap>(config));
+  return taps.size() - 1;
+}
+
+void AudioTapSet::preferredCaptureFormat(int32_t &sampleRate, int32_t &channels) const {
+  int32_t rate  = 0;
+  int32_t count = 0;
+  for (const auto &tap : taps) {
+    rate  = std::max(rate, tap->config.sampleRate);
+    count = std::max(count, tap->config.channels);
+  }
+  if (rate > 0) {
+    sampleRate = rate;
+  }
+  if (count > 0) {
+    channels = count;
+  }
+}
+
+void AudioTapSet::push(const float *samples, uint32_t frames, int32_t channels, int32_t sampleRate,
+                       const SyncStamp &stamp, const ChunkCallback &onChunk) {
+  if (!samples || frames == 0 || channels <= 0 || sampleRate <= 0) {
+    return;
+  }
+  if (channels != sourceChannels || sampleRate != sourceRate) {
+    configure(channels, sampleRate, onChunk);
+  }
+
+  // Each channel conversion is computed once, however many taps use it
+  bool needMono   = false;
+  bool needStereo = false;
+  for (const auto &tap : taps) {
+    needMono |= tap->outChannels == 1 && channels != 1;
+    needStereo |= tap->outChannels == 2 && channels != 2;
+  }
+  if (needMono) {
+    mono.resize(frames);
+    downmixToMono(samples, channels, frames, mono.data());
+  }
+  if (needStereo) {
+    // Mono is duplicated; wider layouts keep their front left and right channels
+    stereo.resize(static_cast<size_t>(frames) * 2);
+    for (uint32_t i = 0; i < frames; i++) {
+      const float *frame = samples + static_cast<size_t>(i) * channels;
+      stereo[2 * i]      = frame[0];
+      stereo[2 * i + 1]  = channels == 1 ? frame[0] : frame[1];
+    }
+  }
+
+  for (size_t index = 0; index < taps.size(); index++) {
+    Tap         &tap   = *taps[index];
+    const float *input = tap.outChannels == channels ? samples : tap.outChannels == 1 ? mono.data() : stereo.data();
+
+    if (tap.outRate == sourceRate) {
+      tap.chunker.push(input, frames, tap.outChannels, tap.outRate, stamp, chunkCallback(index, onChunk));
+      continue;
+    }
+
+    uint32_t count = tap.resampler.process(input, frames, tap.resampled);
+    if (count == 0) {
+      continue;
+    }
+
+    // Stamp the first resampled frame at its input position, on the tap's sample clock
+    SyncStamp tapStamp = stamp;
+    double    offset   = tap.resampler.lastOutputOffset();
+    if (tapStamp.valid) {
+      tapStamp.captureNs += std::llround(offset * 1e9 / sourceRate);
+    }
+    if (tapStamp.hasAudio) {
+      tapStamp.audioPosition =
+          std::llround((static_cast<double>(tapStamp.audioPosition) + offset) * tap.outRate / sourceRate);
+    }
+    tap.chunker.push(
+        tap.resampled.data(), count, tap.outChannels, tap.outRate, tapStamp, chunkCallback(index, onChunk));
+  }
+}
+
+void AudioTapSet::flush(const ChunkCallback &onChunk) {
+  for (size_t index = 0; index < taps.size(); index++) {
+    taps[index]->chunker.flush(chunkCallback(index, onChunk));
+  }
+}
+
+void AudioTapSet::reset() {
+  for (auto &tap : taps) {
+    tap->chunker = AudioChunker(tap->config.chunkMs);
+    if (tap->mel) {
+      tap->mel->reset();
+    }
+  }
+  sourceChannels = 0;
+  sourceRate     = 0;
+}
+
+void AudioTapSet::configure(int32_t channels, int32_t sampleRate, const ChunkCallback &onChunk) {
+  flush(onChunk);
+  sourceChannels = channels;
+  sourceRate     = sampleRate;
+  for (auto &tap : taps) {
+    tap->outChannels = tap->config.channels == 1 || tap->config.channels == 2 ? tap->config.channels : channels;
+    tap->outRate     = tap->config.sampleRate > 0 ? tap->config.sampleRate : sampleRate;
+    if (tap->config.format == AudioSampleFormat::LogMel) {
+      // Features are computed from the mono downmix at the tap's rate
+      MelSpectrogramConfig mel = tap->config.mel;
+      mel.sampleRate           = tap->outRate;
+      tap->outChannels         = 1;
+      tap->mel                 = std::make_unique<MelSpectrogram>(mel);
+    }
+    tap->resampler.configure(sampleRate, tap->outRate, tap->outChannels);
+  }
+}
+
+AudioChunker::ChunkCallback AudioTapSet::chunkCallback(size_t index, const ChunkCallback &onChunk) {
+  return [this, index, &onChunk](const float *samples, uint32_t frames, const SyncStamp &stamp) {
+    Tap          &tap = *taps[index];
+    AudioTapChunk chunk;
+    chunk.tap        = index;
+    chunk.samples    = samples;
+    chunk.frames     = frames;
+    chunk.channels   = tap.outChannels;
+    chunk.sampleRate = tap.outRate;
+    chunk.format     = tap.config.format;
+    chunk.stamp      = stamp;
+    if (tap.mel) {
+      tap.mel->push(samples, frames, stamp, [&](const float *features, uint32_t rows, const SyncStamp &first) {
+        chunk.stamp         = first;
+        chunk.features      = features;
+        chunk.featureFrames = rows;
+        chunk.melBins       = static_cast<int32_t>(tap.mel->config().nMels);
+        onChunk(chunk);
+      });
+      return;
+    }
+    if (tap.config.format == AudioSampleFormat::Int16) {
+      size_t count = static_cast<size_t>(frames) * tap.outChannels;
+      tap.pcm.resize(count);
+      convertFloatToInt16(samples, count, tap.pcm.data());
+      chunk.pcm16 = tap.pcm.data();
+    }
+    onChunk(chunk);
+  };
+}
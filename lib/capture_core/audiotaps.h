@@ -0,0 +1,261 @@
+/**
+ * @file audiotaps.h
+ * @brief Several output formats of one audio capture
+ *
+ * A session often needs the same device audio twice: 48 kHz stereo float for
+ * a recording and 16 kHz mono 16-bit PCM for speech recognition. Opening the
+ * device twice costs a second client and lets the two streams drift apart.
+ * An AudioTapSet instead takes the blocks of one capture and derives every
+ * tap from them:
+ *
+ * - channel conversions are computed once per block and shared, so any
+ *   number of mono taps cost one downmix;
+ * - each tap has its own AudioResampler, so taps at different rates never
+ *   wait on each other's state;
+ * - each tap has its own AudioChunker and sample format, and its chunks are
+ *   stamped with positions on the tap's own sample clock;
+ * - a LogMel tap turns its mono stream into log-mel feature frames with a
+ *   MelSpectrogram, so speech models get features instead of PCM.
+ */
+#pragma once
+
+#include "audiochunker.h"
+#include "avsync.h"
+#include "melspectrogram.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * @class AudioResampler
+ * @brief Streaming windowed-sinc sample rate converter for interleaved float audio
+ *
+ * The kernel is a Blackman-windowed sinc with its cutoff just below the
+ * lower of the two Nyquist frequencies. For the usual rate pairs (48000 to
+ * 16000, 44100 to 48000) the weights of every output phase are computed
+ * once; other pairs interpolate a finely sampled kernel. Output frame k
+ * lies exactly at input frame k * inputRate / outputRate, tracked as an
+ * integer ratio so long streams do not drift, and the filter state is
+ * carried across blocks, so the output does not depend on how the input
+ * was split.
+ */
+class AudioResampler {
+public:
+  /** Zero crossings of the sinc on each side of the kernel centre */
+  static constexpr int32_t kZeroCrossings = 16;
+
+  /** Table points per input sample of the interpolated kernel */
+  static constexpr int32_t kTablePhases = 128;
+
+  /** Largest number of output phases given their own weights */
+  static constexpr uint64_t kMaxPhases = 1024;
+
+  /** Cutoff as a fraction of the lower Nyquist frequency */
+  static constexpr double kCutoff = 0.92;
+
+  /**
+   * @brief Set the conversion and clear the filter state
+   * @param inputRate Sample rate of the input blocks
+   * @param outputRate Sample rate of the output
+   * @param channels Interleaved channel count of input and output
+   */
+  void configure(int32_t inputRate, int32_t outputRate, int32_t channels);
+
+  /**
+   * @brief Clear the filter state; the next input starts a new stream
+   */
+  void reset();
+
+  /**
+   * @brief Convert a block
+   *
+   * The output lags the input by halfWidth() input frames, so a block may
+   * complete output frames that lie in the previous block.
+   *
+   * @param input Interleaved samples, frames * channels
+   * @param frames Samples per channel in the block
+   * @param out Receives the completed output frames (replaced, not appended)
+   * @return Number of output frames
+   */
+  uint32_t process(const float *input, uint32_t frames, std::vector<float> &out);
+
+  /**
+   * @brief Input position of the first frame of the last process() output
+   *
+   * In input frames relative to the first frame of the block passed to that
+   * call; negative when the output starts in an earlier block.
+   */
+  double lastOutputOffset() const {
+    return outputOffset;
+  }
+
+  /**
+   * @brief Kernel half width in input frames (0 when the rates are equal)
+   */
+  int32_t halfWidth() const {
+    return kernelHalfWidth;
+  }
+
+private:
+  int32_t inputRate  = 0;
+  int32_t outputRate = 0;
+  int32_t channels   = 0;
+
+  /** Rates divided by their greatest common divisor */
+  uint64_t ratioIn  = 1;
+  uint64_t ratioOut = 1;
+
+  /** Kernel value at a distance of d input frames from its centre */
+  double kernelAt(double d) const;
+
+  int32_t kernelHalfWidth = 0;
+  double  cutoff          = 0; /**< In cycles per input frame */
+
+  /** With polyphase, 2 * halfWidth weights per output phase; else h(i / kTablePhases) */
+  std::vector<float> kernel;
+  bool               polyphase = false;
+  std::vector<float> weights; /**< Weights of the current output frame when not polyphase */
+
+  /** Input frames from historyStart on; starts with halfWidth frames of silence */
+  std::vector<float> history;
+  int64_t            historyStart = 0;
+  int64_t            inputFrames  = 0; /**< Input frames received since reset */
+  uint64_t           outputFrames = 0; /**< Output frames produced since reset */
+  double             outputOffset = 0;
+};
+
+/**
+ * @enum AudioSampleFormat
+ * @brief Sample format of a tap's chunks
+ */
+enum class AudioSampleFormat : int32_t {
+  Float32 = 0, /**< 32-bit float in [-1, 1] */
+  Int16   = 1, /**< Signed 16-bit PCM */
+  LogMel  = 2, /**< Log-mel feature frames of the mono stream */
+};
+
+/**
+ * @struct AudioTapConfig
+ * @brief Output settings of one tap
+ */
+struct AudioTapConfig {
+  int32_t              sampleRate = 0; /**< Output rate in Hz (0 = the capture rate) */
+  int32_t              channels   = 0; /**< 0 = the capture layout, 1 = mono downmix, 2 = stereo */
+  AudioSampleFormat    format     = AudioSampleFormat::Float32;
+  uint32_t             chunkMs    = 0; /**< Chunk duration in milliseconds (0 = one chunk per block) */
+  MelSpectrogramConfig mel        = {}; /**< LogMel taps only; its sampleRate is the tap's */
+};
+
+/**
+ * @struct AudioTapChunk
+ * @brief A chunk of one tap; the buffers are only valid during the callback
+ */
+struct AudioTapChunk {
+  size_t            tap        = 0;       /**< Index returned by AudioTapSet::addTap */
+  const float      *samples    = nullptr; /**< Interleaved float samples, frames * channels */
+  const int16_t    *pcm16      = nullptr; /**< The same samples as 16-bit PCM (Int16 taps only) */
+  uint32_t          frames     = 0;
+  int32_t           channels   = 0;
+  int32_t           sampleRate = 0;
+  AudioSampleFormat format     = AudioSampleFormat::Float32;
+  SyncStamp         stamp;                /**< audioPosition counts frames at the tap's sample rate */
+
+  /** @name LogMel taps: the features completed by this chunk; stamp is that of the first one */
+  ///@{
+  const float *features      = nullptr; /**< Row-major, featureFrames rows of melBins values */
+  uint32_t     featureFrames = 0;
+  int32_t      melBins       = 0;
+  ///@}
+};
+
+/**
+ * @class AudioTapSet
+ * @brief Derives several tap streams from the blocks of one audio capture
+ *
+ * Used from the audio delivery thread only.
+ */
+class AudioTapSet {
+public:
+  /** Receives each chunk of every tap, in order per tap */
+  using ChunkCallback = std::function<void(const AudioTapChunk &chunk)>;
+
+  /**
+   * @brief Add a tap; only allowed before the first push()
+   * @return Index of the tap, passed with its chunks
+   */
+  size_t addTap(const AudioTapConfig &config);
+
+  /**
+   * @brief Number of taps added
+   */
+  size_t tapCount() const {
+    return taps.size();
+  }
+
+  /**
+   * @brief Capture format that serves every tap without upsampling
+   *
+   * The highest tap rate and channel count; taps that follow the capture
+   * format do not raise either. Leaves the arguments unchanged when no tap
+   * names a value.
+   */
+  void preferredCaptureFormat(int32_t &sampleRate, int32_t &channels) const;
+
+  /**
+   * @brief Derive every tap from a captured block
+   *
+   * A change of channel count or sample rate passes on the partial chunks of
+   * the previous format and restarts the resamplers.
+   *
+   * @param samples Interleaved samples, frames * channels
+   * @param frames Samples per channel in the block
+   * @param channels Channel count of the block
+   * @param sampleRate Sample rate of the block
+   * @param stamp Stamp of the block's first sample
+   * @param onChunk Called for each completed chunk
+   */
+  void push(const float *samples, uint32_t frames, int32_t channels, int32_t sampleRate, const SyncStamp &stamp,
+            const ChunkCallback &onChunk);
+
+  /**
+   * @brief Pass on the partial chunk of every tap
+   */
+  void flush(const ChunkCallback &onChunk);
+
+  /**
+   * @brief Drop partial chunks and filter state; the next push() starts a new stream
+   */
+  void reset();
+
+private:
+  struct Tap {
+    explicit Tap(const AudioTapConfig &config) : config(config), chunker(config.chunkMs) {}
+
+    AudioTapConfig                  config;
+    AudioResampler                  resampler;
+    AudioChunker                    chunker;
+    int32_t                         outChannels = 0;
+    int32_t                         outRate     = 0;
+    std::vector<float>              resampled;
+    std::vector<int16_t>            pcm;
+    std::unique_ptr<MelSpectrogram> mel;
+  };
+
+  /** Adopt a new capture format */
+  void configure(int32_t channels, int32_t sampleRate, const ChunkCallback &onChunk);
+
+  /** Chunker callback that converts a tap's chunks to its format and passes them on */
+  AudioChunker::ChunkCallback chunkCallback(size_t index, const ChunkCallback &onChunk);
+
+  std::vector<std::unique_ptr<Tap>> taps;
+
+  int32_t sourceChannels = 0;
+  int32_t sourceRate     = 0;
+
+  /** @name Channel conversions of the current block, shared by all taps */
+  ///@{
+  std::vector<float> mono;
+  std::vector<float> stereo;
+  ///@}
+};
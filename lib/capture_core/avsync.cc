@@ -0,0 +1,104 @@
+/**
+ * @file avsync.cc
+ * @brief Implementation of the shared audio/video capture clock
+ */
+#include "avsync.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+thread_local SyncStamp threadStamp;
+
+} // namespace
+
+int64_t AvSyncClock::addAudio(int64_t firstSampleNs, uint32_t frames, int32_t sampleRate) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // Samples already in the stream were counted at the old rate, so only the estimate restarts
+  if (sampleRate != this->sampleRate) {
+    this->sampleRate = sampleRate;
+    originCount      = 0;
+  }
+
+  int64_t first = position;
+  if (sampleRate > 0) {
+    int64_t origin = firstSampleNs - static_cast<int64_t>(static_cast<double>(first) * 1e9 / sampleRate);
+    if (originCount > 0 && origin - originNs > kGapNs) {
+      originCount = 0;
+    }
+    origins[nextOrigin] = origin;
+    nextOrigin          = (nextOrigin + 1) % origins.size();
+    originCount         = std::min(originCount + 1, origins.size());
+    updateOrigin();
+  }
+  position += frames;
+  return first;
+}
+
+void AvSyncClock::updateOrigin() {
+  // The window is small and audio blocks arrive at most a few hundred times a second
+  int64_t earliest = origins[(nextOrigin + origins.size() - 1) % origins.size()];
+  for (size_t i = 1; i < originCount; i++) {
+    earliest = std::min(earliest, origins[(nextOrigin + origins.size() - 1 - i) % origins.size()]);
+  }
+  originNs = earliest;
+}
+
+SyncStamp AvSyncClock::stampAt(int64_t captureNs) const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  SyncStamp stamp;
+  stamp.valid     = true;
+  stamp.captureNs = captureNs;
+  if (originCount > 0 && sampleRate > 0) {
+    stamp.hasAudio      = true;
+    stamp.audioPosition = static_cast<int64_t>(std::floor(static_cast<double>(captureNs - originNs) * sampleRate / 1e9));
+  }
+  return stamp;
+}
+
+SyncStamp AvSyncClock::stampForAudio(int64_t position) const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  SyncStamp stamp;
+  stamp.valid         = true;
+  stamp.hasAudio      = true;
+  stamp.audioPosition = position;
+  if (sampleRate > 0) {
+    stamp.captureNs = originNs + static_cast<int64_t>(static_cast<double>(position) * 1e9 / sampleRate);
+  }
+  return stamp;
+}
+
+int64_t AvSyncClock::audioFrames() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return position;
+}
+
+void AvSyncClock::reset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  originCount = 0;
+  nextOrigin  = 0;
+  originNs    = 0;
+  position    = 0;
+  sampleRate  = 0;
+}
+
+SyncStamp syncStampAt(const AvSyncClock *clock, int64_t captureNs) {
+  if (clock) {
+    return clock->stampAt(captureNs);
+  }
+  SyncStamp stamp;
+  stamp.valid     = true;
+  stamp.captureNs = captureNs;
+  return stamp;
+}
+
+void setCurrentSyncStamp(const SyncStamp &stamp) {
+  threadStamp = stamp;
+}
+
+SyncStamp currentSyncStamp() {
+  return threadStamp;
+}
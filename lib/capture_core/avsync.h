@@ -0,0 +1,121 @@
+/**
+ * @file avsync.h
+ * @brief Shared audio/video capture clock
+ *
+ * Audio and video are captured on unrelated threads, and their callbacks run
+ * at different delays after acquisition. An AvSyncClock relates both to the
+ * monotonicNowNs() clock:
+ *
+ * - the audio source reports every block it delivers, with the capture time
+ *   of its first sample as well as it knows it. Each report gives one
+ *   estimate of when sample 0 was captured (the origin). Reports are only
+ *   ever late, never early, so the clock takes the earliest origin of the
+ *   last kWindowBlocks reports: jitter is filtered out and slow drift between
+ *   the audio device and the system clock is still followed;
+ * - the video pipelines ask for the audio sample position at a frame's
+ *   acquisition time, so each frame says which audio sample was captured at
+ *   the same instant.
+ *
+ * A report whose origin is more than kGapNs later than the estimate means
+ * the device skipped time (a loopback device delivers nothing during
+ * silence). The clock then starts over from that report.
+ *
+ * Callbacks read the stamp of the frame or block being delivered with
+ * currentSyncStamp(), the same way they read the trace sequence.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * @struct SyncStamp
+ * @brief Capture time of a frame or audio block on the shared clock
+ */
+struct SyncStamp {
+  bool    valid         = false; /**< Whether the callback being run has a stamp */
+  int64_t captureNs     = 0;     /**< Acquisition time on the monotonicNowNs() clock */
+  bool    hasAudio      = false; /**< Whether audioPosition is known */
+  int64_t audioPosition = 0;     /**< Audio sample (per channel) captured at captureNs; negative before audio started */
+};
+
+/**
+ * @class AvSyncClock
+ * @brief Maps monotonic time to audio sample positions; shared by the audio and video threads
+ */
+class AvSyncClock {
+public:
+  /** Number of audio blocks the origin estimate is taken over */
+  static constexpr size_t kWindowBlocks = 128;
+
+  /** An origin this much later than the estimate is treated as a gap in the audio */
+  static constexpr int64_t kGapNs = 80000000;
+
+  /**
+   * @brief Report an audio block appended to the stream
+   * @param firstSampleNs Capture time of the block's first sample on the monotonicNowNs() clock
+   * @param frames Number of samples per channel in the block
+   * @param sampleRate Sample rate of the delivered stream
+   * @return Position of the block's first sample in the stream
+   */
+  int64_t addAudio(int64_t firstSampleNs, uint32_t frames, int32_t sampleRate);
+
+  /**
+   * @brief Stamp for something captured at a given time
+   * @param captureNs Acquisition time on the monotonicNowNs() clock
+   * @return Stamp with the matching audio position, if any audio has been reported
+   */
+  SyncStamp stampAt(int64_t captureNs) const;
+
+  /**
+   * @brief Stamp for an audio block
+   * @param position Position of the block's first sample, as returned by addAudio()
+   * @return Stamp whose capture time is the smoothed time of that sample
+   */
+  SyncStamp stampForAudio(int64_t position) const;
+
+  /**
+   * @brief Number of samples per channel reported so far
+   */
+  int64_t audioFrames() const;
+
+  /**
+   * @brief Forget all reported audio
+   */
+  void reset();
+
+private:
+  /** Recompute originNs from the window (caller holds mutex) */
+  void updateOrigin();
+
+  mutable std::mutex mutex;
+
+  std::array<int64_t, kWindowBlocks> origins{};
+  size_t                             originCount = 0;
+  size_t                             nextOrigin  = 0;
+
+  /** Estimated capture time of sample 0 */
+  int64_t originNs = 0;
+
+  int64_t position   = 0;
+  int32_t sampleRate = 0;
+};
+
+/**
+ * @brief Stamp for something captured at a given time, with or without a clock
+ * @param clock Clock shared with the audio source, or nullptr
+ * @param captureNs Acquisition time on the monotonicNowNs() clock
+ */
+SyncStamp syncStampAt(const AvSyncClock *clock, int64_t captureNs);
+
+/**
+ * @brief Set the stamp of the frame or block whose callback this thread is about to run
+ */
+void setCurrentSyncStamp(const SyncStamp &stamp);
+
+/**
+ * @brief Stamp set by the capture thread calling the current callback; invalid if there is none
+ */
+SyncStamp currentSyncStamp();
@@ -0,0 +1,60 @@
+/**
+ * @file bufferpool.cc
+ * @brief Implementation of the frame buffer pool
+ */
+#include "bufferpool.h"
+
+std::shared_ptr<FrameBufferPool> FrameBufferPool::create(size_t maxRetained) {
+  return std::shared_ptr<FrameBufferPool>(new FrameBufferPool(maxRetained));
+}
+
+FrameBufferPool::FrameBufferPool(size_t maxRetained) : maxRetained(maxRetained) {}
+
+FrameBufferPool::Buffer FrameBufferPool::acquire(size_t size) {
+  std::unique_ptr<std::vector<uint8_t>> buffer;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Prefer a buffer that is already large enough so resize() does not reallocate
+    for (size_t i = idle.size(); i-- > 0;) {
+      if (idle[i]->capacity() >= size) {
+        buffer = std::move(idle[i]);
+        idle.erase(idle.begin() + i);
+        break;
+      }
+    }
+    if (!buffer && !idle.empty()) {
+      buffer = std::move(idle.back());
+      idle.pop_back();
+    }
+  }
+
+  if (!buffer) {
+    buffer = std::make_unique<std::vector<uint8_t>>();
+  }
+  if (buffer->capacity() < size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  buffer->resize(size);
+
+  std::weak_ptr<FrameBufferPool> owner = weak_from_this();
+  return Buffer(buffer.release(), [owner](std::vector<uint8_t> *released) {
+    if (auto pool = owner.lock()) {
+      pool->recycle(released);
+    } else {
+      delete released;
+    }
+  });
+}
+
+void FrameBufferPool::recycle(std::vector<uint8_t> *buffer) {
+  std::unique_ptr<std::vector<uint8_t>> owned(buffer);
+  std::lock_guard<std::mutex>           lock(mutex);
+  if (idle.size() < maxRetained) {
+    idle.push_back(std::move(owned));
+  }
+}
+
+size_t FrameBufferPool::idleCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return idle.size();
+}
@@ -0,0 +1,69 @@
+/**
+ * @file bufferpool.h
+ * @brief Recycling pool for frame-sized byte buffers
+ *
+ * Raw frames are several megabytes each (a 1080p I420 frame is ~3 MB), so the
+ * delivery path takes its buffers from this pool instead of allocating one per
+ * frame. A buffer returns to the pool when its last shared_ptr is released,
+ * which may happen on any thread and may outlive the pool itself.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @class FrameBufferPool
+ * @brief Thread-safe pool of byte vectors
+ *
+ * Must be owned by a std::shared_ptr (see create()).
+ */
+class FrameBufferPool : public std::enable_shared_from_this<FrameBufferPool> {
+public:
+  /** Shared handle to a pooled buffer */
+  using Buffer = std::shared_ptr<std::vector<uint8_t>>;
+
+  /** Default number of idle buffers kept for reuse */
+  static constexpr size_t kDefaultMaxRetained = 4;
+
+  /**
+   * @brief Create a pool
+   * @param maxRetained Number of idle buffers kept; extra buffers are freed on release
+   */
+  static std::shared_ptr<FrameBufferPool> create(size_t maxRetained = kDefaultMaxRetained);
+
+  /**
+   * @brief Take a buffer of exactly size bytes
+   *
+   * Reuses an idle buffer when one is available; its previous contents are not
+   * cleared.
+   */
+  Buffer acquire(size_t size);
+
+  /**
+   * @brief Number of idle buffers currently held
+   */
+  size_t idleCount() const;
+
+  /**
+   * @brief Number of buffers allocated because none could be reused
+   */
+  uint64_t allocationCount() const {
+    return allocations.load(std::memory_order_relaxed);
+  }
+
+private:
+  explicit FrameBufferPool(size_t maxRetained);
+
+  /** Take back a released buffer, or free it if the pool is full */
+  void recycle(std::vector<uint8_t> *buffer);
+
+  const size_t                                       maxRetained;
+  mutable std::mutex                                 mutex;
+  std::vector<std::unique_ptr<std::vector<uint8_t>>> idle;
+  std::atomic<uint64_t>                              allocations{0};
+};
@@ -0,0 +1,111 @@
+/**
+ * @file capturestats.cc
+ * @brief Implementation of the capture statistics helpers
+ */
+#include "capturestats.h"
+#include <cstring>
+
+AudioStatsSnapshot AudioStats::snapshot() const {
+  AudioStatsSnapshot snapshot;
+  snapshot.packets  = packets.load(std::memory_order_relaxed);
+  snapshot.frames   = frames.load(std::memory_order_relaxed);
+  snapshot.dropped  = dropped.load(std::memory_order_relaxed);
+  snapshot.acquire  = acquire.snapshot();
+  snapshot.downmix  = downmix.snapshot();
+  snapshot.resample = resample.snapshot();
+  snapshot.deliver  = deliver.snapshot();
+  return snapshot;
+}
+
+void AudioStats::reset() {
+  packets.store(0);
+  frames.store(0);
+  dropped.store(0);
+  acquire.reset();
+  downmix.reset();
+  resample.reset();
+  deliver.reset();
+}
+
+void DeliveryStats::reset() {
+  videoDelivered.store(0);
+  videoDropped.store(0);
+  audioDelivered.store(0);
+  audioDropped.store(0);
+  videoDispatch.reset();
+  audioDispatch.reset();
+  captureToJs.reset();
+}
+
+void StartupTiming::prepared(uint32_t displayID, uint32_t windowID) {
+  preparedDisplayID.store(displayID);
+  preparedWindowID.store(windowID);
+  hasPrepared.store(true);
+}
+
+void StartupTiming::begin(uint32_t displayID, uint32_t windowID) {
+  // A start consumes the preparation, whether or not it was for this target
+  bool prepared = hasPrepared.exchange(false) && preparedDisplayID.load() == displayID &&
+                  preparedWindowID.load() == windowID;
+  startedPrepared.store(prepared);
+  firstVideoNs.store(0);
+  firstAudioNs.store(0);
+  beginNs.store(monotonicNowNs());
+}
+
+StartupSnapshot StartupTiming::snapshot() const {
+  StartupSnapshot snapshot;
+  int64_t         begin = beginNs.load();
+  if (begin == 0) {
+    return snapshot;
+  }
+  snapshot.prepared = startedPrepared.load();
+  int64_t video     = firstVideoNs.load();
+  int64_t audio     = firstAudioNs.load();
+  if (video >= begin) {
+    snapshot.firstFrameMs = static_cast<double>(video - begin) / 1e6;
+  }
+  if (audio >= begin) {
+    snapshot.firstAudioMs = static_cast<double>(audio - begin) / 1e6;
+  }
+  return snapshot;
+}
+
+void exportStageStats(const StageTimingSnapshot &snapshot, MediaCaptureStageStatsC &out) {
+  out.count  = snapshot.count;
+  out.meanMs = static_cast<float>(snapshot.meanMs);
+  out.maxMs  = static_cast<float>(snapshot.maxMs);
+  out.p50Ms  = static_cast<float>(snapshot.p50Ms);
+  out.p90Ms  = static_cast<float>(snapshot.p90Ms);
+  out.p99Ms  = static_cast<float>(snapshot.p99Ms);
+  out.p999Ms = static_cast<float>(snapshot.p999Ms);
+}
+
+void exportCaptureStats(const VideoPipelineStats *video, const AudioStatsSnapshot *audio, MediaCaptureStatsC &out) {
+  std::memset(&out, 0, sizeof(out));
+
+  if (video) {
+    out.framesCaptured  = video->framesCaptured;
+    out.framesDelivered = video->framesEncoded;
+    out.framesDropped   = video->framesDropped;
+    out.encodeFailures  = video->encodeFailures;
+    out.acquireFailures = video->acquireFailures;
+    out.videoBytes      = video->bytesDelivered;
+    out.queueDepth      = video->queueDepth;
+    exportStageStats(video->acquire, out.acquire);
+    exportStageStats(video->copy, out.copy);
+    exportStageStats(video->queueWait, out.queueWait);
+    exportStageStats(video->encode, out.encode);
+    exportStageStats(video->deliver, out.videoDeliver);
+  }
+
+  if (audio) {
+    out.audioPackets = audio->packets;
+    out.audioFrames  = audio->frames;
+    out.audioDropped = audio->dropped;
+    exportStageStats(audio->acquire, out.audioAcquire);
+    exportStageStats(audio->downmix, out.downmix);
+    exportStageStats(audio->resample, out.resample);
+    exportStageStats(audio->deliver, out.audioDeliver);
+  }
+}
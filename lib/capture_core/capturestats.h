@@ -0,0 +1,145 @@
+/**
+ * @file capturestats.h
+ * @brief Counters and latency histograms for getStats()
+ *
+ * The video pipeline keeps its own counters (see VideoPipelineStats). This
+ * header adds the audio equivalent, the last hop into JavaScript that only the
+ * addon can see, and the conversion of all of it to MediaCaptureStatsC for the
+ * C API.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "capture/capture.h"
+#include "stagetiming.h"
+#include "videopipeline.h"
+
+/**
+ * @struct AudioStatsSnapshot
+ * @brief Point-in-time copy of AudioStats
+ */
+struct AudioStatsSnapshot {
+  uint64_t            packets = 0; /**< Packets handed to the audio callback */
+  uint64_t            frames  = 0; /**< Sample frames handed to the audio callback */
+  uint64_t            dropped = 0; /**< Sample frames lost before delivery */
+  StageTimingSnapshot acquire;     /**< Reading a packet from the system */
+  StageTimingSnapshot downmix;     /**< Channel conversion */
+  StageTimingSnapshot resample;    /**< Sample rate conversion */
+  StageTimingSnapshot deliver;     /**< Audio callback invocation */
+};
+
+/**
+ * @struct AudioStats
+ * @brief Counters and stage timings of an audio backend, updated from its capture thread
+ */
+struct AudioStats {
+  std::atomic<uint64_t> packets{0};
+  std::atomic<uint64_t> frames{0};
+  std::atomic<uint64_t> dropped{0};
+  StageTiming           acquire;
+  StageTiming           downmix;
+  StageTiming           resample;
+  StageTiming           deliver;
+
+  /**
+   * @brief Count one delivered packet
+   */
+  void addPacket(int32_t frameCount) {
+    packets.fetch_add(1, std::memory_order_relaxed);
+    frames.fetch_add(static_cast<uint64_t>(frameCount), std::memory_order_relaxed);
+  }
+
+  AudioStatsSnapshot snapshot() const;
+  void               reset();
+};
+
+/**
+ * @struct DeliveryStats
+ * @brief What happens between the native callbacks and the JavaScript listeners
+ *
+ * Owned by the addon. captureToJs is measured against the frame's wall-clock
+ * timestamp, which the C API carries in milliseconds, so it has millisecond
+ * resolution; the dispatch stages use the monotonic clock.
+ */
+struct DeliveryStats {
+  std::atomic<uint64_t> videoDelivered{0}; /**< Frames that reached the listener */
+  std::atomic<uint64_t> videoDropped{0};   /**< Frames dropped because the JS queue or a paused stream was full */
+  std::atomic<uint64_t> audioDelivered{0}; /**< Packets that reached the listener */
+  std::atomic<uint64_t> audioDropped{0};   /**< Packets dropped because the JS queue or a paused stream was full */
+  StageTiming           videoDispatch;     /**< Native callback to video listener */
+  StageTiming           audioDispatch;     /**< Native callback to audio listener */
+  StageTiming           captureToJs;       /**< Frame acquisition to video listener */
+
+  void reset();
+};
+
+/**
+ * @struct StartupSnapshot
+ * @brief Point-in-time copy of StartupTiming
+ */
+struct StartupSnapshot {
+  bool   prepared     = false; /**< The capture started on resources opened by prepare() */
+  double firstFrameMs = -1;    /**< Start call until the first video callback; -1 until there is one */
+  double firstAudioMs = -1;    /**< Start call until the first audio callback; -1 until there is one */
+};
+
+/**
+ * @class StartupTiming
+ * @brief Time from a start call to the first video and audio callbacks
+ *
+ * prepared() and begin() are called by the thread that prepares and starts
+ * captures, firstVideo() and firstAudio() by the capture threads on every
+ * callback; only the first one after begin() is recorded.
+ */
+class StartupTiming {
+public:
+  /**
+   * @brief Record a completed prepare(); the next begin() for the same target counts as prepared
+   */
+  void prepared(uint32_t displayID, uint32_t windowID);
+
+  /**
+   * @brief Start timing a capture of a target
+   */
+  void begin(uint32_t displayID, uint32_t windowID);
+
+  void firstVideo() {
+    markOnce(firstVideoNs);
+  }
+
+  void firstAudio() {
+    markOnce(firstAudioNs);
+  }
+
+  StartupSnapshot snapshot() const;
+
+private:
+  void markOnce(std::atomic<int64_t> &at) {
+    if (at.load(std::memory_order_relaxed) == 0) {
+      int64_t expected = 0;
+      at.compare_exchange_strong(expected, monotonicNowNs(), std::memory_order_relaxed);
+    }
+  }
+
+  std::atomic<bool>    hasPrepared{false};
+  std::atomic<uint32_t> preparedDisplayID{0};
+  std::atomic<uint32_t> preparedWindowID{0};
+  std::atomic<bool>    startedPrepared{false};
+  std::atomic<int64_t> beginNs{0};
+  std::atomic<int64_t> firstVideoNs{0};
+  std::atomic<int64_t> firstAudioNs{0};
+};
+
+/**
+ * @brief Copy a histogram summary into its C representation
+ */
+void exportStageStats(const StageTimingSnapshot &snapshot, MediaCaptureStageStatsC &out);
+
+/**
+ * @brief Fill the C statistics from a video pipeline and an audio backend
+ * @param video Video pipeline counters, or nullptr when video is not running
+ * @param audio Audio backend counters, or nullptr when audio is not running
+ * @param out Receives the statistics; missing parts are zeroed
+ */
+void exportCaptureStats(const VideoPipelineStats *video, const AudioStatsSnapshot *audio, MediaCaptureStatsC &out);
@@ -0,0 +1,294 @@
+/**
+ * @file capturetrace.cc
+ * @brief Implementation of the per-thread span rings and the Chrome trace writer
+ */
+#include "capturetrace.h"
+#include "videopipeline.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <unistd.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::atomic<bool> traceEnabled{false};
+
+/** Spans of one thread; written only by the thread that leased it */
+struct ThreadRing {
+  std::unique_ptr<TraceSpan[]> spans{new TraceSpan[kTraceEventsPerThread]};
+  std::atomic<uint64_t>        writePos{0};
+  std::atomic<uint64_t>        startPos{0}; /**< Spans before this belong to a previous session */
+  std::atomic<bool>            leased{false};
+};
+
+struct TraceRegistry {
+  std::mutex                               mutex;
+  std::vector<std::unique_ptr<ThreadRing>> rings;
+  std::map<uint32_t, std::string>          threadNames;
+};
+
+TraceRegistry &registry() {
+  // Never destroyed: threads may still exit and return their rings during static destruction
+  static TraceRegistry *instance = new TraceRegistry;
+  return *instance;
+}
+
+uint32_t osThreadId() {
+#if defined(_WIN32)
+  return static_cast<uint32_t>(GetCurrentThreadId());
+#elif defined(__APPLE__)
+  uint64_t id = 0;
+  pthread_threadid_np(nullptr, &id);
+  return static_cast<uint32_t>(id);
+#else
+  return static_cast<uint32_t>(syscall(SYS_gettid));
+#endif
+}
+
+uint32_t osProcessId() {
+#if defined(_WIN32)
+  return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+  return static_cast<uint32_t>(getpid());
+#endif
+}
+
+/** The calling thread's ring, handed back for reuse when the thread exits */
+struct RingLease {
+  ThreadRing *ring     = nullptr;
+  uint32_t    threadId = 0;
+
+  ~RingLease() {
+    if (ring) {
+      ring->leased.store(false, std::memory_order_release);
+    }
+  }
+};
+
+thread_local RingLease   lease;
+thread_local uint64_t    threadSequence = kNoTraceSequence;
+thread_local const char *threadName     = nullptr;
+
+ThreadRing *leaseRing() {
+  TraceRegistry              &traces = registry();
+  std::lock_guard<std::mutex> lock(traces.mutex);
+  for (const std::unique_ptr<ThreadRing> &ring : traces.rings) {
+    if (!ring->leased.exchange(true, std::memory_order_acquire)) {
+      return ring.get();
+    }
+  }
+  traces.rings.push_back(std::make_unique<ThreadRing>());
+  traces.rings.back()->leased.store(true);
+  return traces.rings.back().get();
+}
+
+void appendEscaped(std::string &out, const char *text) {
+  for (const char *c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      out += '\\';
+    }
+    if (static_cast<unsigned char>(*c) >= 0x20) {
+      out += *c;
+    }
+  }
+}
+
+} // namespace
+
+bool captureTraceEnabled() {
+  return traceEnabled.load(std::memory_order_relaxed);
+}
+
+void setCaptureTraceEnabled(bool enabled) {
+  TraceRegistry              &traces = registry();
+  std::lock_guard<std::mutex> lock(traces.mutex);
+  if (enabled && !traceEnabled.load()) {
+    for (const std::unique_ptr<ThreadRing> &ring : traces.rings) {
+      ring->startPos.store(ring->writePos.load(std::memory_order_acquire));
+    }
+  }
+  traceEnabled.store(enabled);
+}
+
+void setTraceThreadName(const char *name) {
+  if (threadName == name) {
+    return;
+  }
+  threadName                  = name;
+  TraceRegistry              &traces = registry();
+  std::lock_guard<std::mutex> lock(traces.mutex);
+  traces.threadNames[osThreadId()] = name;
+}
+
+void traceSpan(const char *name, uint64_t sequence, int64_t beginNs, int64_t endNs) {
+  if (!traceEnabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  if (!lease.ring) {
+    lease.ring     = leaseRing();
+    lease.threadId = osThreadId();
+  }
+
+  ThreadRing *ring = lease.ring;
+  uint64_t    pos  = ring->writePos.load(std::memory_order_relaxed);
+  TraceSpan  &span = ring->spans[pos % kTraceEventsPerThread];
+  span.name        = name;
+  span.sequence    = sequence;
+  span.beginNs     = beginNs;
+  span.endNs       = endNs;
+  span.threadId    = lease.threadId;
+  ring->writePos.store(pos + 1, std::memory_order_release);
+}
+
+uint64_t currentTraceSequence() {
+  return threadSequence;
+}
+
+void setCurrentTraceSequence(uint64_t sequence) {
+  threadSequence = sequence;
+}
+
+std::vector<TraceSpan> collectTraceSpans() {
+  std::vector<TraceSpan>      result;
+  TraceRegistry              &traces = registry();
+  std::lock_guard<std::mutex> lock(traces.mutex);
+
+  for (const std::unique_ptr<ThreadRing> &ring : traces.rings) {
+    uint64_t head  = ring->writePos.load(std::memory_order_acquire);
+    uint64_t first = std::max(ring->startPos.load(), head > kTraceEventsPerThread ? head - kTraceEventsPerThread : 0);
+
+    std::vector<TraceSpan> copied;
+    copied.reserve(static_cast<size_t>(head - first));
+    for (uint64_t pos = first; pos < head; pos++) {
+      copied.push_back(ring->spans[pos % kTraceEventsPerThread]);
+    }
+
+    // The owner keeps writing while we copy; anything it may have lapped is discarded
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t after = ring->writePos.load(std::memory_order_acquire);
+    uint64_t valid = after >= kTraceEventsPerThread ? after - kTraceEventsPerThread + 1 : 0;
+    for (uint64_t pos = first; pos < head; pos++) {
+      if (pos >= valid) {
+        result.push_back(copied[static_cast<size_t>(pos - first)]);
+      }
+    }
+  }
+  return result;
+}
+
+std::string captureTraceJSON() {
+  std::vector<TraceSpan>          spans = collectTraceSpans();
+  std::map<uint32_t, std::string> names;
+  {
+    TraceRegistry              &traces = registry();
+    std::lock_guard<std::mutex> lock(traces.mutex);
+    names = traces.threadNames;
+  }
+
+  const uint32_t pid = osProcessId();
+  char           number[96];
+  std::string    json;
+  json.reserve(256 + spans.size() * 128);
+  json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  snprintf(number, sizeof(number), "%u", pid);
+  json += "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":";
+  json += number;
+  json += ",\"tid\":0,\"args\":{\"name\":\"desktop-media-capture\"}}";
+
+  // Name only the threads that appear in the trace
+  std::vector<uint32_t> threads;
+  for (const TraceSpan &span : spans) {
+    threads.push_back(span.threadId);
+  }
+  std::sort(threads.begin(), threads.end());
+  threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+  for (uint32_t tid : threads) {
+    auto name = names.find(tid);
+    if (name == names.end()) {
+      continue;
+    }
+    snprintf(number, sizeof(number), "%u,\"tid\":%u", pid, tid);
+    json += ",{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":";
+    json += number;
+    json += ",\"args\":{\"name\":\"";
+    appendEscaped(json, name->second.c_str());
+    json += "\"}}";
+  }
+
+  // Complete events ("X") with microsecond timestamps on the monotonic clock
+  for (const TraceSpan &span : spans) {
+    json += ",{\"ph\":\"X\",\"cat\":\"capture\",\"name\":\"";
+    appendEscaped(json, span.name ? span.name : "");
+    snprintf(number, sizeof(number), "\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", pid, span.threadId,
+             static_cast<double>(span.beginNs) / 1000.0,
+             static_cast<double>(std::max<int64_t>(0, span.endNs - span.beginNs)) / 1000.0);
+    json += number;
+    if (span.sequence != kNoTraceSequence) {
+      snprintf(number, sizeof(number), ",\"args\":{\"seq\":%llu}", static_cast<unsigned long long>(span.sequence));
+      json += number;
+    }
+    json += '}';
+  }
+  json += "]}\n";
+  return json;
+}
+
+bool writeCaptureTraceFile(const char *path, std::string &error) {
+  if (!path || !*path) {
+    error = "No trace file path given";
+    return false;
+  }
+  std::string json = captureTraceJSON();
+
+  FILE *file = std::fopen(path, "wb");
+  if (!file) {
+    error = std::string("Cannot open trace file ") + path;
+    return false;
+  }
+  bool written = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+  if (std::fclose(file) != 0 || !written) {
+    error = std::string("Failed to write trace file ") + path;
+    return false;
+  }
+  return true;
+}
+
+TraceScope::TraceScope(const char *name, uint64_t sequence) : name(name), sequence(sequence) {
+  if (captureTraceEnabled()) {
+    beginNs = monotonicNowNs();
+  }
+}
+
+TraceScope::~TraceScope() {
+  if (beginNs != 0) {
+    traceSpan(name, sequence, beginNs, monotonicNowNs());
+  }
+}
+
+extern "C" {
+
+void setCaptureTracing(int32_t enabled) {
+  setCaptureTraceEnabled(enabled != 0);
+}
+
+int32_t writeCaptureTrace(const char *path) {
+  std::string error;
+  if (!writeCaptureTraceFile(path, error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 0;
+  }
+  return 1;
+}
+
+} // extern "C"
@@ -0,0 +1,116 @@
+/**
+ * @file capturetrace.h
+ * @brief Opt-in span tracing of the capture threads, exported as Chrome Trace Event JSON
+ *
+ * Where getStats() summarizes each stage, a trace shows every frame and audio
+ * packet as it moves through the capture, encoder, audio and JavaScript
+ * threads, which is what it takes to see where a stall or a burst of jitter
+ * came from. The output loads in Perfetto (ui.perfetto.dev) and chrome://tracing.
+ *
+ * Each thread writes into its own fixed ring of spans with no locks and no
+ * allocation after its first span; when the ring is full the oldest spans are
+ * overwritten, so a long session keeps about the last kTraceEventsPerThread
+ * spans of each thread. Rings of exited threads are reused by new ones. While
+ * tracing is disabled, a span costs one relaxed atomic load.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Sequence number of spans that do not belong to a frame or packet */
+constexpr uint64_t kNoTraceSequence = ~0ull;
+
+/** Number of spans kept per thread */
+constexpr size_t kTraceEventsPerThread = 16384;
+
+/**
+ * @struct TraceSpan
+ * @brief One completed span
+ */
+struct TraceSpan {
+  const char *name     = nullptr;          /**< Stage name; must be a string literal */
+  uint64_t    sequence = kNoTraceSequence; /**< Frame or packet sequence number */
+  int64_t     beginNs  = 0;                /**< Start, on the monotonicNowNs() clock */
+  int64_t     endNs    = 0;                /**< End, on the monotonicNowNs() clock */
+  uint32_t    threadId = 0;                /**< OS thread ID of the recording thread */
+};
+
+/**
+ * @brief Whether spans are currently being recorded
+ */
+bool captureTraceEnabled();
+
+/**
+ * @brief Start or stop recording
+ *
+ * Enabling discards the spans of any previous session; disabling keeps them
+ * so they can still be written out.
+ */
+void setCaptureTraceEnabled(bool enabled);
+
+/**
+ * @brief Name the calling thread in the trace
+ * @param name Thread name; must be a string literal. Cheap to call repeatedly.
+ */
+void setTraceThreadName(const char *name);
+
+/**
+ * @brief Record a span with timestamps the caller already took
+ * @param name Stage name; must be a string literal
+ * @param sequence Frame or packet sequence number, or kNoTraceSequence
+ * @param beginNs Start on the monotonicNowNs() clock
+ * @param endNs End on the monotonicNowNs() clock
+ */
+void traceSpan(const char *name, uint64_t sequence, int64_t beginNs, int64_t endNs);
+
+/**
+ * @brief Frame sequence number the calling thread is delivering
+ *
+ * Set by the video pipeline around the frame callback so that code running
+ * inside it (the addon) can tag its own spans with the frame they belong to.
+ */
+uint64_t currentTraceSequence();
+
+/**
+ * @brief Set the value returned by currentTraceSequence() on the calling thread
+ */
+void setCurrentTraceSequence(uint64_t sequence);
+
+/**
+ * @brief Copy out the spans recorded since tracing was last enabled, oldest first per thread
+ */
+std::vector<TraceSpan> collectTraceSpans();
+
+/**
+ * @brief Serialize the recorded spans as Chrome Trace Event JSON
+ */
+std::string captureTraceJSON();
+
+/**
+ * @brief Write captureTraceJSON() to a file
+ * @param path Destination file, replaced if it exists
+ * @param error Receives a description on failure
+ * @return true on success
+ */
+bool writeCaptureTraceFile(const char *path, std::string &error);
+
+/**
+ * @class TraceScope
+ * @brief Records a span covering its own lifetime
+ */
+class TraceScope {
+public:
+  explicit TraceScope(const char *name, uint64_t sequence = kNoTraceSequence);
+  ~TraceScope();
+
+  TraceScope(const TraceScope &)            = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  const char *name;
+  uint64_t    sequence;
+  int64_t     beginNs = 0;
+};
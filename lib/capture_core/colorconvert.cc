@@ -0,0 +1,299 @@
+/**
+ * @file colorconvert.cc
+ * @brief Scalar and vectorized BGRA to I420/NV12 conversion
+ *
+ * All paths use the same integer arithmetic:
+ *   Y  = ((66 R + 129 G +  25 B + 128) >> 8) + 16
+ *   Cb = ((-38 R -  74 G + 112 B + 128) >> 8) + 128
+ *   Cr = ((112 R -  94 G -  18 B + 128) >> 8) + 128
+ * where chroma uses the rounded 2x2 mean (sum + 2) >> 2 of each component.
+ * Every intermediate fits in 16 bits, which the SIMD paths rely on.
+ */
+#include "colorconvert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CAPTURE_COLORCONVERT_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define CAPTURE_COLORCONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+inline uint8_t lumaOf(int b, int g, int r) {
+  return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+inline uint8_t cbOf(int b, int g, int r) {
+  return static_cast<uint8_t>(((112 * b - 74 * g - 38 * r + 128) >> 8) + 128);
+}
+
+inline uint8_t crOf(int b, int g, int r) {
+  return static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+/**
+ * @struct RowPair
+ * @brief Source and destination rows for one chroma row
+ *
+ * row1 equals row0 and yOut1 is null when the frame has an odd last row.
+ * Chroma sample cx is written to uOut[cx * chromaStep] and vOut[cx * chromaStep].
+ */
+struct RowPair {
+  const uint8_t *row0;
+  const uint8_t *row1;
+  uint8_t       *yOut0;
+  uint8_t       *yOut1;
+  uint8_t       *uOut;
+  uint8_t       *vOut;
+  int32_t        chromaStep;
+};
+
+/** Convert columns [x, width) of a row pair; x must be even */
+void convertRowPairScalar(const RowPair &rows, int32_t x, int32_t width) {
+  for (; x < width; x += 2) {
+    const int32_t  x1  = (x + 1 < width) ? x + 1 : x;
+    const uint8_t *p00 = rows.row0 + x * 4;
+    const uint8_t *p01 = rows.row0 + x1 * 4;
+    const uint8_t *p10 = rows.row1 + x * 4;
+    const uint8_t *p11 = rows.row1 + x1 * 4;
+
+    rows.yOut0[x] = lumaOf(p00[0], p00[1], p00[2]);
+    if (x1 != x) {
+      rows.yOut0[x1] = lumaOf(p01[0], p01[1], p01[2]);
+    }
+    if (rows.yOut1) {
+      rows.yOut1[x] = lumaOf(p10[0], p10[1], p10[2]);
+      if (x1 != x) {
+        rows.yOut1[x1] = lumaOf(p11[0], p11[1], p11[2]);
+      }
+    }
+
+    const int b = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+    const int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+    const int r = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+
+    const int32_t cx                = x / 2;
+    rows.uOut[cx * rows.chromaStep] = cbOf(b, g, r);
+    rows.vOut[cx * rows.chromaStep] = crOf(b, g, r);
+  }
+}
+
+#if defined(CAPTURE_COLORCONVERT_SSE2)
+
+/** Split 8 BGRA pixels into 16-bit B, G and R lanes */
+inline void unpackBGR(const uint8_t *p, __m128i &b, __m128i &g, __m128i &r) {
+  const __m128i mask = _mm_set1_epi32(0xFF);
+  const __m128i lo   = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  const __m128i hi   = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16));
+  b = _mm_packs_epi32(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+  g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8), mask), _mm_and_si128(_mm_srli_epi32(hi, 8), mask));
+  r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), mask), _mm_and_si128(_mm_srli_epi32(hi, 16), mask));
+}
+
+/** Luma of 8 pixels as 16-bit lanes; the unsigned sum peaks at 56228 */
+inline __m128i lumaSSE2(__m128i b, __m128i g, __m128i r) {
+  __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+  sum         = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+  sum         = _mm_add_epi16(sum, _mm_set1_epi16(128));
+  return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+}
+
+/** Rounded mean of horizontally adjacent pairs across two rows of 16 pixels */
+inline __m128i average2x2(__m128i row0lo, __m128i row0hi, __m128i row1lo, __m128i row1hi) {
+  const __m128i ones = _mm_set1_epi16(1);
+  const __m128i lo   = _mm_madd_epi16(_mm_add_epi16(row0lo, row1lo), ones);
+  const __m128i hi   = _mm_madd_epi16(_mm_add_epi16(row0hi, row1hi), ones);
+  return _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(lo, hi), _mm_set1_epi16(2)), 2);
+}
+
+/** Convert 16-pixel blocks of a row pair; returns the first column left for the scalar tail */
+int32_t convertRowPairSIMD(const RowPair &rows, int32_t width, bool interleaved) {
+  const __m128i k128 = _mm_set1_epi16(128);
+  const int32_t end  = width & ~15;
+
+  for (int32_t x = 0; x < end; x += 16) {
+    __m128i b0lo, g0lo, r0lo, b0hi, g0hi, r0hi;
+    __m128i b1lo, g1lo, r1lo, b1hi, g1hi, r1hi;
+    unpackBGR(rows.row0 + x * 4, b0lo, g0lo, r0lo);
+    unpackBGR(rows.row0 + x * 4 + 32, b0hi, g0hi, r0hi);
+    unpackBGR(rows.row1 + x * 4, b1lo, g1lo, r1lo);
+    unpackBGR(rows.row1 + x * 4 + 32, b1hi, g1hi, r1hi);
+
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(rows.yOut0 + x),
+        _mm_packus_epi16(lumaSSE2(b0lo, g0lo, r0lo), lumaSSE2(b0hi, g0hi, r0hi)));
+    if (rows.yOut1) {
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i *>(rows.yOut1 + x),
+          _mm_packus_epi16(lumaSSE2(b1lo, g1lo, r1lo), lumaSSE2(b1hi, g1hi, r1hi)));
+    }
+
+    const __m128i b = average2x2(b0lo, b0hi, b1lo, b1hi);
+    const __m128i g = average2x2(g0lo, g0hi, g1lo, g1hi);
+    const __m128i r = average2x2(r0lo, r0hi, r1lo, r1hi);
+
+    __m128i cb = _mm_sub_epi16(
+        _mm_mullo_epi16(b, _mm_set1_epi16(112)),
+        _mm_add_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(74)), _mm_mullo_epi16(r, _mm_set1_epi16(38))));
+    __m128i cr = _mm_sub_epi16(
+        _mm_mullo_epi16(r, _mm_set1_epi16(112)),
+        _mm_add_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(94)), _mm_mullo_epi16(b, _mm_set1_epi16(18))));
+    cb = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(cb, k128), 8), k128);
+    cr = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(cr, k128), 8), k128);
+
+    const int32_t cx = x / 2;
+    if (interleaved) {
+      const __m128i uv = _mm_unpacklo_epi8(_mm_packus_epi16(cb, cb), _mm_packus_epi16(cr, cr));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(rows.uOut + cx * 2), uv);
+    } else {
+      const __m128i packed = _mm_packus_epi16(cb, cr);
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(rows.uOut + cx), packed);
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(rows.vOut + cx), _mm_srli_si128(packed, 8));
+    }
+  }
+  return end;
+}
+
+#elif defined(CAPTURE_COLORCONVERT_NEON)
+
+/** Luma of 16 deinterleaved pixels; the unsigned sum peaks at 56228 */
+inline uint8x16_t lumaNEON(const uint8x16x4_t &p) {
+  uint16x8_t lo = vmlal_u8(vdupq_n_u16(128), vget_low_u8(p.val[2]), vdup_n_u8(66));
+  lo            = vmlal_u8(lo, vget_low_u8(p.val[1]), vdup_n_u8(129));
+  lo            = vmlal_u8(lo, vget_low_u8(p.val[0]), vdup_n_u8(25));
+  uint16x8_t hi = vmlal_u8(vdupq_n_u16(128), vget_high_u8(p.val[2]), vdup_n_u8(66));
+  hi            = vmlal_u8(hi, vget_high_u8(p.val[1]), vdup_n_u8(129));
+  hi            = vmlal_u8(hi, vget_high_u8(p.val[0]), vdup_n_u8(25));
+  return vaddq_u8(vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)), vdupq_n_u8(16));
+}
+
+/** Rounded mean of horizontally adjacent pairs across two rows, as signed lanes */
+inline int16x8_t average2x2(uint8x16_t row0, uint8x16_t row1) {
+  return vreinterpretq_s16_u16(vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(row0), row1), 2));
+}
+
+/** Convert 16-pixel blocks of a row pair; returns the first column left for the scalar tail */
+int32_t convertRowPairSIMD(const RowPair &rows, int32_t width, bool interleaved) {
+  const int16x8_t k128 = vdupq_n_s16(128);
+  const int32_t   end  = width & ~15;
+
+  for (int32_t x = 0; x < end; x += 16) {
+    const uint8x16x4_t p0 = vld4q_u8(rows.row0 + x * 4);
+    const uint8x16x4_t p1 = vld4q_u8(rows.row1 + x * 4);
+
+    vst1q_u8(rows.yOut0 + x, lumaNEON(p0));
+    if (rows.yOut1) {
+      vst1q_u8(rows.yOut1 + x, lumaNEON(p1));
+    }
+
+    const int16x8_t b = average2x2(p0.val[0], p1.val[0]);
+    const int16x8_t g = average2x2(p0.val[1], p1.val[1]);
+    const int16x8_t r = average2x2(p0.val[2], p1.val[2]);
+
+    int16x8_t cb = vmlsq_n_s16(vmlsq_n_s16(vmulq_n_s16(b, 112), g, 74), r, 38);
+    int16x8_t cr = vmlsq_n_s16(vmlsq_n_s16(vmulq_n_s16(r, 112), g, 94), b, 18);
+    cb           = vaddq_s16(vshrq_n_s16(vaddq_s16(cb, k128), 8), k128);
+    cr           = vaddq_s16(vshrq_n_s16(vaddq_s16(cr, k128), 8), k128);
+
+    const int32_t cx = x / 2;
+    if (interleaved) {
+      uint8x8x2_t uv;
+      uv.val[0] = vqmovun_s16(cb);
+      uv.val[1] = vqmovun_s16(cr);
+      vst2_u8(rows.uOut + cx * 2, uv);
+    } else {
+      vst1_u8(rows.uOut + cx, vqmovun_s16(cb));
+      vst1_u8(rows.vOut + cx, vqmovun_s16(cr));
+    }
+  }
+  return end;
+}
+
+#endif
+
+void convertFrame(
+    const uint8_t *src, int32_t srcStride, int32_t width, int32_t height, const YUVPlanes &dst, bool interleaved,
+    bool vectorized) {
+  for (int32_t y = 0; y < height; y += 2) {
+    const bool    hasRow1 = (y + 1 < height);
+    const int32_t cy      = y / 2;
+
+    RowPair rows;
+    rows.row0       = src + static_cast<size_t>(y) * srcStride;
+    rows.row1       = hasRow1 ? rows.row0 + srcStride : rows.row0;
+    rows.yOut0      = dst.y + static_cast<size_t>(y) * dst.yStride;
+    rows.yOut1      = hasRow1 ? rows.yOut0 + dst.yStride : nullptr;
+    rows.uOut       = dst.u + static_cast<size_t>(cy) * dst.uStride;
+    rows.vOut       = interleaved ? rows.uOut + 1 : dst.v + static_cast<size_t>(cy) * dst.vStride;
+    rows.chromaStep = interleaved ? 2 : 1;
+
+    int32_t x = 0;
+#if defined(CAPTURE_COLORCONVERT_SSE2) || defined(CAPTURE_COLORCONVERT_NEON)
+    if (vectorized) {
+      x = convertRowPairSIMD(rows, width, interleaved);
+    }
+#else
+    (void)vectorized;
+#endif
+    convertRowPairScalar(rows, x, width);
+  }
+}
+
+} // namespace
+
+size_t yuv420FrameSize(int32_t width, int32_t height) {
+  const size_t chromaWidth  = static_cast<size_t>(width + 1) / 2;
+  const size_t chromaHeight = static_cast<size_t>(height + 1) / 2;
+  return static_cast<size_t>(width) * height + 2 * chromaWidth * chromaHeight;
+}
+
+YUVPlanes i420Planes(uint8_t *data, int32_t width, int32_t height) {
+  const int32_t chromaWidth  = (width + 1) / 2;
+  const int32_t chromaHeight = (height + 1) / 2;
+
+  YUVPlanes planes;
+  planes.y       = data;
+  planes.yStride = width;
+  planes.u       = data + static_cast<size_t>(width) * height;
+  planes.uStride = chromaWidth;
+  planes.v       = planes.u + static_cast<size_t>(chromaWidth) * chromaHeight;
+  planes.vStride = chromaWidth;
+  return planes;
+}
+
+YUVPlanes nv12Planes(uint8_t *data, int32_t width, int32_t height) {
+  YUVPlanes planes;
+  planes.y       = data;
+  planes.yStride = width;
+  planes.u       = data + static_cast<size_t>(width) * height;
+  planes.uStride = ((width + 1) / 2) * 2;
+  return planes;
+}
+
+void convertBGRAToI420(const uint8_t *src, int32_t srcStride, int32_t width, int32_t height, const YUVPlanes &dst) {
+  convertFrame(src, srcStride, width, height, dst, false, true);
+}
+
+void convertBGRAToNV12(const uint8_t *src, int32_t srcStride, int32_t width, int32_t height, const YUVPlanes &dst) {
+  convertFrame(src, srcStride, width, height, dst, true, true);
+}
+
+void convertBGRAToI420Scalar(const uint8_t *src, int32_t srcStride, int32_t width, int32_t height, const YUVPlanes &dst) {
+  convertFrame(src, srcStride, width, height, dst, false, false);
+}
+
+void convertBGRAToNV12Scalar(const uint8_t *src, int32_t srcStride, int32_t width, int32_t height, const YUVPlanes &dst) {
+  convertFrame(src, srcStride, width, height, dst, true, false);
+}
+
+const char *colorConvertBackend() {
+#if defined(CAPTURE_COLORCONVERT_SSE2)
+  return "sse2";
+#elif defined(CAPTURE_COLORCONVERT_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
@@ -0,0 +1,79 @@
+/**
+ * @file colorconvert.h
+ * @brief BGRA to planar YUV 4:2:0 conversion
+ *
+ * Converts captured BGRA frames into I420 (three planes) or NV12 (luma plane
+ * plus interleaved chroma plane) using BT.601 limited-range coefficients in
+ * 8-bit fixed point. Chroma is the rounded mean of each 2x2 block; the last
+ * column or row is repeated for odd sizes.
+ *
+ * The vectorized paths (SSE2 on x86-64, NEON on arm64) produce results that
+ * are bit-identical to the scalar reference.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @struct YUVPlanes
+ * @brief Destination planes of a 4:2:0 conversion
+ *
+ * For NV12, u receives the interleaved UV plane and v is unused.
+ */
+struct YUVPlanes {
+  uint8_t *y       = nullptr; /**< Luma plane */
+  uint8_t *u       = nullptr; /**< Cb plane (I420) or interleaved CbCr plane (NV12) */
+  uint8_t *v       = nullptr; /**< Cr plane (I420 only) */
+  int32_t  yStride = 0;       /**< Luma row stride in bytes */
+  int32_t  uStride = 0;       /**< Cb (or CbCr) row stride in bytes */
+  int32_t  vStride = 0;       /**< Cr row stride in bytes */
+};
+
+/**
+ * @brief Size in bytes of a tightly packed 4:2:0 frame
+ * @param width Frame width in pixels
+ * @param height Frame height in pixels
+ */
+size_t yuv420FrameSize(int32_t width, int32_t height);
+
+/**
+ * @brief Describe the planes of a tightly packed I420 frame stored at data
+ */
+YUVPlanes i420Planes(uint8_t *data, int32_t width, int32_t height);
+
+/**
+ * @brief Describe the planes of a tightly packed NV12 frame stored at data
+ */
+YUVPlanes nv12Planes(uint8_t *data, int32_t width, int32_t height);
+
+/**
+ * @brief Convert a BGRA frame to I420 using the fastest available path
+ * @param src First byte of the BGRA frame
+ * @param srcStride Source row stride in bytes
+ * @param width Frame width in pixels
+ * @param height Frame height in pixels
+ * @param dst Destination planes
+ */
+void convertBGRAToI420(const uint8_t *src, int32_t srcStride, int32_t width, int32_t height, const YUVPlanes &dst);
+
+/**
+ * @brief Convert a BGRA frame to NV12 using the fastest available path
+ * @see convertBGRAToI420
+ */
+void convertBGRAToNV12(const uint8_t *src, int32_t srcStride, int32_t width, int32_t height, const YUVPlanes &dst);
+
+/**
+ * @brief Scalar reference implementation of convertBGRAToI420
+ */
+void convertBGRAToI420Scalar(const uint8_t *src, int32_t srcStride, int32_t width, int32_t height, const YUVPlanes &dst);
+
+/**
+ * @brief Scalar reference implementation of convertBGRAToNV12
+ */
+void convertBGRAToNV12Scalar(const uint8_t *src, int32_t srcStride, int32_t width, int32_t height, const YUVPlanes &dst);
+
+/**
+ * @brief Name of the vectorized path compiled in ("sse2", "neon" or "scalar")
+ */
+const char *colorConvertBackend();
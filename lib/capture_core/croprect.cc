@@ -0,0 +1,49 @@
+/**
+ * @file croprect.cc
+ * @brief Implementation of the region-of-interest helpers
+ */
+#include "croprect.h"
+#include <algorithm>
+#include <cstring>
+
+bool resolveCropRect(const MediaCaptureRectC &requested, int32_t frameWidth, int32_t frameHeight, MediaCaptureRectC &out) {
+  if (requested.width <= 0 || requested.height <= 0) {
+    out = {0, 0, frameWidth, frameHeight};
+    return frameWidth > 0 && frameHeight > 0;
+  }
+
+  // Intersect in 64 bits so x + width cannot overflow
+  int64_t left   = std::max<int64_t>(0, requested.x);
+  int64_t top    = std::max<int64_t>(0, requested.y);
+  int64_t right  = std::min<int64_t>(frameWidth, static_cast<int64_t>(requested.x) + requested.width);
+  int64_t bottom = std::min<int64_t>(frameHeight, static_cast<int64_t>(requested.y) + requested.height);
+
+  if (right <= left || bottom <= top) {
+    out = {0, 0, 0, 0};
+    return false;
+  }
+
+  out.x      = static_cast<int32_t>(left);
+  out.y      = static_cast<int32_t>(top);
+  out.width  = static_cast<int32_t>(right - left);
+  out.height = static_cast<int32_t>(bottom - top);
+  return true;
+}
+
+void copyFrameRegion(
+    const uint8_t *src, int32_t srcBytesPerRow, const MediaCaptureRectC &rect, int32_t bytesPerPixel, uint8_t *dst,
+    int32_t dstBytesPerRow) {
+  const size_t   rowBytes = static_cast<size_t>(rect.width) * bytesPerPixel;
+  const uint8_t *srcRow   = src + static_cast<size_t>(rect.y) * srcBytesPerRow + static_cast<size_t>(rect.x) * bytesPerPixel;
+
+  // Full-width rows with matching strides are contiguous
+  if (rowBytes == static_cast<size_t>(srcBytesPerRow) && srcBytesPerRow == dstBytesPerRow) {
+    std::memcpy(dst, srcRow, rowBytes * rect.height);
+    return;
+  }
+
+  for (int32_t row = 0; row < rect.height; row++) {
+    std::memcpy(dst + static_cast<size_t>(row) * dstBytesPerRow, srcRow, rowBytes);
+    srcRow += srcBytesPerRow;
+  }
+}
@@ -0,0 +1,65 @@
+/**
+ * @file croprect.h
+ * @brief Region-of-interest helpers shared by the platform backends
+ *
+ * Backends copy only the requested sub-rectangle out of the mapped frame, so
+ * the encoder never sees (or pays for) pixels outside the region of interest.
+ */
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include "capture/capture.h"
+
+/**
+ * @brief Clamp a requested crop rectangle to the frame bounds
+ * @param requested Requested rectangle; a zero width or height selects the full frame
+ * @param frameWidth Frame width in pixels
+ * @param frameHeight Frame height in pixels
+ * @param out Receives the effective rectangle
+ * @return false if the rectangle lies entirely outside the frame
+ */
+bool resolveCropRect(const MediaCaptureRectC &requested, int32_t frameWidth, int32_t frameHeight, MediaCaptureRectC &out);
+
+/**
+ * @brief Copy a sub-rectangle of a packed frame into a destination buffer
+ * @param src First byte of the source frame
+ * @param srcBytesPerRow Source row stride in bytes
+ * @param rect Region to copy; must already be clamped with resolveCropRect()
+ * @param bytesPerPixel Bytes per pixel (4 for BGRA)
+ * @param dst Destination buffer, at least dstBytesPerRow * rect.height bytes
+ * @param dstBytesPerRow Destination row stride in bytes
+ */
+void copyFrameRegion(
+    const uint8_t *src, int32_t srcBytesPerRow, const MediaCaptureRectC &rect, int32_t bytesPerPixel, uint8_t *dst,
+    int32_t dstBytesPerRow);
+
+/**
+ * @class SharedCropRect
+ * @brief Crop rectangle that can be replaced while capture is running
+ *
+ * Written from the JavaScript thread and read once per frame by the capture
+ * stage.
+ */
+class SharedCropRect {
+public:
+  /**
+   * @brief Replace the current rectangle
+   */
+  void set(const MediaCaptureRectC &rect) {
+    std::lock_guard<std::mutex> lock(mutex);
+    value = rect;
+  }
+
+  /**
+   * @brief Get a copy of the current rectangle
+   */
+  MediaCaptureRectC get() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return value;
+  }
+
+private:
+  mutable std::mutex mutex;
+  MediaCaptureRectC  value = {0, 0, 0, 0};
+};
@@ -0,0 +1,213 @@
+/**
+ * @file deliverygate.h
+ * @brief Pausable hand-off between a capture thread and a consumer with backpressure
+ *
+ * While a consumer keeps up, items pass straight through. When it signals
+ * that it is full, the gate is paused and the capture thread parks items in a
+ * bounded buffer instead; once the buffer is full, the overflow policy decides
+ * whether the oldest held item or the new one is dropped. Resuming hands the
+ * held items back, oldest first, so the consumer can deliver them before
+ * anything captured later.
+ *
+ * A pulling consumer keeps the gate paused and takes held items itself. When
+ * it finds none, it arms a wake-up instead: the next admitted item is held
+ * and reported as Wake, so the capture thread schedules exactly one hand-off
+ * for however many items arrive before it runs.
+ *
+ * The capture thread never waits on the consumer: both sides take a short
+ * lock that only guards the buffer.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+
+/**
+ * @enum OverflowPolicy
+ * @brief What a paused gate does when its buffer is full
+ */
+enum class OverflowPolicy {
+  DropOldest, /**< Keep the latest items; suits live video */
+  DropNewest  /**< Keep the earliest items; suits gapless audio up to the point of overflow */
+};
+
+/**
+ * @brief Parse a policy name ("drop-oldest", "drop-newest")
+ * @return false if the name is unknown
+ */
+inline bool parseOverflowPolicy(const std::string &name, OverflowPolicy &policy) {
+  if (name == "drop-oldest") {
+    policy = OverflowPolicy::DropOldest;
+  } else if (name == "drop-newest") {
+    policy = OverflowPolicy::DropNewest;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @enum GateResult
+ * @brief Outcome of DeliveryGate::admit
+ */
+enum class GateResult {
+  Deliver, /**< Not paused; the caller delivers the item itself */
+  Held,    /**< Paused; the item was moved into the buffer */
+  Dropped, /**< Paused and full; an item was dropped under the overflow policy */
+  Wake     /**< Paused; the item was held and a waiting consumer should be woken */
+};
+
+/**
+ * @class DeliveryGate
+ * @brief Bounded buffer in front of a consumer that can pause delivery
+ *
+ * @tparam T Item type; must be movable
+ */
+template <typename T>
+class DeliveryGate {
+public:
+  /**
+   * @brief Set the buffer size and overflow policy; trims held items that no longer fit
+   * @param capacity Items held while paused; 0 drops everything until resumed
+   * @param policy What to drop once the buffer is full
+   */
+  void configure(size_t capacity, OverflowPolicy policy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->capacity = capacity;
+    this->policy   = policy;
+    while (held.size() > capacity) {
+      dropLocked();
+    }
+  }
+
+  /**
+   * @brief Pass an item from the capture thread
+   * @param item Moved from if the result is Held or Wake, or if it is Dropped under DropOldest
+   * @return Whether the caller delivers the item now, or what happened to it
+   */
+  GateResult admit(T &item) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!paused) {
+      return GateResult::Deliver;
+    }
+    if (held.size() < capacity) {
+      held.push_back(std::move(item));
+      if (wake) {
+        wake = false;
+        return GateResult::Wake;
+      }
+      return GateResult::Held;
+    }
+    dropped++;
+    if (policy == OverflowPolicy::DropOldest && capacity > 0) {
+      held.pop_front();
+      held.push_back(std::move(item));
+    }
+    return GateResult::Dropped;
+  }
+
+  /**
+   * @brief Hold items from now on
+   */
+  void pause() {
+    std::lock_guard<std::mutex> lock(mutex);
+    paused = true;
+  }
+
+  /**
+   * @brief Stop holding items and take the ones held so far
+   * @param out Receives the held items, oldest first
+   */
+  void resume(std::deque<T> &out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    paused = false;
+    wake   = false;
+    out.swap(held);
+    held.clear();
+  }
+
+  /**
+   * @brief Take the held items, or arm a wake-up if there are none
+   * @param out Receives the held items, oldest first
+   * @return false if nothing was held and the next held item will return Wake
+   */
+  bool takeOrArm(std::deque<T> &out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.clear();
+    if (held.empty()) {
+      wake = true;
+      return false;
+    }
+    out.swap(held);
+    return true;
+  }
+
+  /**
+   * @brief Report the next held item as Wake, e.g. after a wake-up could not be delivered
+   */
+  void armWake() {
+    std::lock_guard<std::mutex> lock(mutex);
+    wake = true;
+  }
+
+  /**
+   * @brief Whether items are being held
+   */
+  bool isPaused() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return paused;
+  }
+
+  /**
+   * @brief Number of items currently held
+   */
+  size_t heldCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return held.size();
+  }
+
+  /**
+   * @brief Items dropped under the overflow policy since the last reset()
+   */
+  uint64_t droppedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dropped;
+  }
+
+  /**
+   * @brief Resume, discard held items and clear the drop count
+   */
+  void reset() {
+    std::deque<T> discarded;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      paused  = false;
+      wake    = false;
+      dropped = 0;
+      discarded.swap(held);
+    }
+  }
+
+private:
+  /** Drop one held item under the policy (caller holds mutex) */
+  void dropLocked() {
+    if (policy == OverflowPolicy::DropOldest) {
+      held.pop_front();
+    } else {
+      held.pop_back();
+    }
+    dropped++;
+  }
+
+  mutable std::mutex mutex;
+  std::deque<T>      held;
+  size_t             capacity = 0;
+  OverflowPolicy     policy   = OverflowPolicy::DropOldest;
+  bool               paused   = false;
+  bool               wake     = false;
+  uint64_t           dropped  = 0;
+};
@@ -0,0 +1,268 @@
+/**
+ * @file deltaframe.cc
+ * @brief Implementation of delta frame encoding, parsing and compositing
+ */
+#include "deltaframe.h"
+#include <algorithm>
+#include <cstring>
+#include "croprect.h"
+#include "jpegcodec.h"
+
+namespace {
+
+constexpr uint8_t  kMagic[4]     = {'C', 'D', 'L', 'T'};
+constexpr uint16_t kVersion      = 1;
+constexpr uint16_t kKeyframeFlag = 1;
+
+void putU16(std::vector<uint8_t> &out, uint16_t value) {
+  out.push_back(static_cast<uint8_t>(value));
+  out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void putU32(std::vector<uint8_t> &out, uint32_t value) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    out.push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+uint16_t getU16(const uint8_t *p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t getU32(const uint8_t *p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+bool tileChanged(
+    const uint8_t *current, int32_t currentBytesPerRow, const uint8_t *previous, int32_t previousBytesPerRow,
+    const MediaCaptureRectC &tile) {
+  const size_t rowBytes = static_cast<size_t>(tile.width) * 4;
+  const size_t offset   = static_cast<size_t>(tile.x) * 4;
+  for (int32_t y = tile.y; y < tile.y + tile.height; y++) {
+    if (memcmp(current + static_cast<size_t>(y) * currentBytesPerRow + offset,
+               previous + static_cast<size_t>(y) * previousBytesPerRow + offset, rowBytes) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+bool parseDeltaFrame(
+    const uint8_t *payload, size_t size, DeltaFrameHeader &header, std::vector<DeltaPatchView> &patches) {
+  patches.clear();
+  if (!payload || size < kDeltaHeaderSize || memcmp(payload, kMagic, sizeof(kMagic)) != 0 ||
+      getU16(payload + 4) != kVersion) {
+    return false;
+  }
+
+  header.keyframe     = (getU16(payload + 6) & kKeyframeFlag) != 0;
+  header.width        = getU32(payload + 8);
+  header.height       = getU32(payload + 12);
+  header.sequence     = getU32(payload + 16);
+  header.baseSequence = getU32(payload + 20);
+  header.patchCount   = getU32(payload + 24);
+
+  size_t offset = kDeltaHeaderSize;
+  patches.reserve(std::min<size_t>(header.patchCount, (size - offset) / kDeltaPatchHeaderSize));
+  for (uint32_t i = 0; i < header.patchCount; i++) {
+    if (size - offset < kDeltaPatchHeaderSize) {
+      return false;
+    }
+    const uint8_t *p = payload + offset;
+    DeltaPatchView patch;
+    patch.rect.x      = static_cast<int32_t>(getU32(p));
+    patch.rect.y      = static_cast<int32_t>(getU32(p + 4));
+    patch.rect.width  = static_cast<int32_t>(getU32(p + 8));
+    patch.rect.height = static_cast<int32_t>(getU32(p + 12));
+    patch.size        = getU32(p + 16);
+    offset += kDeltaPatchHeaderSize;
+    if (size - offset < patch.size) {
+      return false;
+    }
+    patch.data = payload + offset;
+    offset += patch.size;
+    patches.push_back(patch);
+  }
+  return true;
+}
+
+void findDirtyRects(
+    const uint8_t *current, int32_t currentBytesPerRow, const uint8_t *previous, int32_t previousBytesPerRow,
+    int32_t width, int32_t height, int32_t tileSize, std::vector<MediaCaptureRectC> &rects) {
+  rects.clear();
+  if (tileSize <= 0 || width <= 0 || height <= 0) {
+    return;
+  }
+
+  const int32_t        tilesX = (width + tileSize - 1) / tileSize;
+  std::vector<uint8_t> dirty(tilesX);
+  std::vector<size_t>  open; // rects that reached the previous tile row
+  std::vector<size_t>  nextOpen;
+
+  for (int32_t y = 0; y < height; y += tileSize) {
+    const int32_t tileHeight = std::min(tileSize, height - y);
+    for (int32_t tx = 0; tx < tilesX; tx++) {
+      const int32_t x = tx * tileSize;
+      dirty[tx]       = tileChanged(
+          current, currentBytesPerRow, previous, previousBytesPerRow, {x, y, std::min(tileSize, width - x), tileHeight});
+    }
+
+    nextOpen.clear();
+    for (int32_t tx = 0; tx < tilesX;) {
+      if (!dirty[tx]) {
+        tx++;
+        continue;
+      }
+      const int32_t start = tx;
+      while (tx < tilesX && dirty[tx]) {
+        tx++;
+      }
+      const int32_t x        = start * tileSize;
+      const int32_t runWidth = std::min(tx * tileSize, width) - x;
+
+      auto merged = std::find_if(open.begin(), open.end(), [&](size_t index) {
+        return rects[index].x == x && rects[index].width == runWidth;
+      });
+      if (merged != open.end()) {
+        rects[*merged].height += tileHeight;
+        nextOpen.push_back(*merged);
+      } else {
+        rects.push_back({x, y, runWidth, tileHeight});
+        nextOpen.push_back(rects.size() - 1);
+      }
+    }
+    open.swap(nextOpen);
+  }
+}
+
+DeltaFrameEncoder::DeltaFrameEncoder(const DeltaEncoderOptions &options, PatchEncoder encoder) :
+    options(options), patchEncoder(encoder ? std::move(encoder) : PatchEncoder(encodeJPEG)) {
+  if (this->options.tileSize <= 0) {
+    this->options.tileSize = 64;
+  }
+}
+
+bool DeltaFrameEncoder::appendPatch(
+    const uint8_t *bgra, int32_t bytesPerRow, const MediaCaptureRectC &rect, std::vector<uint8_t> &out) {
+  const uint8_t *origin = bgra + static_cast<size_t>(rect.y) * bytesPerRow + static_cast<size_t>(rect.x) * 4;
+  if (!patchEncoder(origin, rect.width, rect.height, bytesPerRow, options.quality, patch)) {
+    return false;
+  }
+
+  putU32(out, static_cast<uint32_t>(rect.x));
+  putU32(out, static_cast<uint32_t>(rect.y));
+  putU32(out, static_cast<uint32_t>(rect.width));
+  putU32(out, static_cast<uint32_t>(rect.height));
+  putU32(out, static_cast<uint32_t>(patch.size()));
+  out.insert(out.end(), patch.begin(), patch.end());
+  return true;
+}
+
+bool DeltaFrameEncoder::encode(
+    const uint8_t *bgra, int32_t width, int32_t height, int32_t bytesPerRow, int64_t timestampMs,
+    std::vector<uint8_t> &out) {
+  out.clear();
+  if (!bgra || width <= 0 || height <= 0 || bytesPerRow < width * 4) {
+    return false;
+  }
+
+  const int32_t referenceBytesPerRow = width * 4;
+  bool          keyframe             = keyframePending || width != referenceWidth || height != referenceHeight ||
+                  timestampMs - lastKeyframeMs >= options.keyframeIntervalMs;
+
+  if (!keyframe) {
+    findDirtyRects(bgra, bytesPerRow, reference.data(), referenceBytesPerRow, width, height, options.tileSize, dirty);
+    if (dirty.empty()) {
+      return true;
+    }
+
+    int64_t dirtyArea = 0;
+    for (const auto &rect : dirty) {
+      dirtyArea += static_cast<int64_t>(rect.width) * rect.height;
+    }
+    keyframe = dirtyArea > options.maxDirtyRatio * static_cast<double>(width) * height;
+  }
+  if (keyframe) {
+    dirty.assign(1, {0, 0, width, height});
+  }
+
+  const uint32_t nextSequence = sequence + 1;
+  out.insert(out.end(), kMagic, kMagic + sizeof(kMagic));
+  putU16(out, kVersion);
+  putU16(out, keyframe ? kKeyframeFlag : 0);
+  putU32(out, static_cast<uint32_t>(width));
+  putU32(out, static_cast<uint32_t>(height));
+  putU32(out, nextSequence);
+  putU32(out, keyframe ? nextSequence : sequence);
+  putU32(out, static_cast<uint32_t>(dirty.size()));
+
+  for (const auto &rect : dirty) {
+    if (!appendPatch(bgra, bytesPerRow, rect, out)) {
+      out.clear();
+      keyframePending = true;
+      return false;
+    }
+  }
+
+  // Only the changed regions need to be carried into the reference frame
+  if (keyframe) {
+    reference.resize(static_cast<size_t>(referenceBytesPerRow) * height);
+    referenceWidth  = width;
+    referenceHeight = height;
+    lastKeyframeMs  = timestampMs;
+    keyframePending = false;
+  }
+  for (const auto &rect : dirty) {
+    uint8_t *dst =
+        reference.data() + static_cast<size_t>(rect.y) * referenceBytesPerRow + static_cast<size_t>(rect.x) * 4;
+    copyFrameRegion(bgra, bytesPerRow, rect, 4, dst, referenceBytesPerRow);
+  }
+
+  sequence = nextSequence;
+  return true;
+}
+
+DeltaCompositor::DeltaCompositor(PatchDecoder decoder) :
+    patchDecoder(decoder ? std::move(decoder) : PatchDecoder(decodeJPEG)) {
+}
+
+DeltaCompositor::Result DeltaCompositor::apply(const uint8_t *payload, size_t size) {
+  DeltaFrameHeader header;
+  if (!parseDeltaFrame(payload, size, header, patches) || header.width == 0 || header.height == 0 ||
+      header.width > 65536 || header.height > 65536) {
+    return Result::Invalid;
+  }
+
+  const int32_t width  = static_cast<int32_t>(header.width);
+  const int32_t height = static_cast<int32_t>(header.height);
+  if (header.keyframe) {
+    canvas.resize(static_cast<size_t>(width) * height * 4);
+    canvasWidth  = width;
+    canvasHeight = height;
+  } else if (!synced || header.baseSequence != currentSequence || width != canvasWidth || height != canvasHeight) {
+    return Result::NeedKeyframe;
+  }
+
+  const int32_t canvasBytesPerRow = canvasWidth * 4;
+  for (const auto &patch : patches) {
+    const MediaCaptureRectC &rect = patch.rect;
+    int32_t                  decodedWidth = 0, decodedHeight = 0;
+    if (rect.x < 0 || rect.y < 0 || rect.width <= 0 || rect.height <= 0 || rect.x > canvasWidth - rect.width ||
+        rect.y > canvasHeight - rect.height ||
+        !patchDecoder(patch.data, patch.size, decoded, decodedWidth, decodedHeight) || decodedWidth != rect.width ||
+        decodedHeight != rect.height) {
+      synced = false;
+      return Result::Invalid;
+    }
+
+    uint8_t *dst = canvas.data() + static_cast<size_t>(rect.y) * canvasBytesPerRow + static_cast<size_t>(rect.x) * 4;
+    copyFrameRegion(decoded.data(), rect.width * 4, {0, 0, rect.width, rect.height}, 4, dst, canvasBytesPerRow);
+  }
+
+  currentSequence = header.sequence;
+  synced          = true;
+  return Result::Applied;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file deltaframe.h
+ * @brief Dirty-tile delta frames and the compositor that reassembles them
+ *
+ * In delta mode a full keyframe is sent periodically and, in between, only the
+ * regions that changed since the previous frame. Each frame is divided into
+ * square tiles; changed tiles are merged into rectangles and every rectangle
+ * is compressed on its own as a JPEG patch.
+ *
+ * Payload layout (all integers little-endian):
+ *
+ *     header  "CDLT"  magic
+ *             u16     version (1)
+ *             u16     flags (bit 0: keyframe)
+ *             u32     frame width, frame height
+ *             u32     sequence, base sequence
+ *             u32     patch count
+ *     patch   u32     x, y, width, height
+ *             u32     byte length, followed by the JPEG bytes
+ *
+ * A delta applies to the frame whose sequence equals its base sequence. A
+ * keyframe carries a single patch covering the whole frame.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "capture/capture.h"
+
+/** Size of the serialized payload header in bytes */
+constexpr size_t kDeltaHeaderSize = 28;
+
+/** Size of each serialized patch header in bytes */
+constexpr size_t kDeltaPatchHeaderSize = 20;
+
+/**
+ * @struct DeltaFrameHeader
+ * @brief Decoded payload header
+ */
+struct DeltaFrameHeader {
+  bool     keyframe     = false; /**< Frame replaces the whole canvas */
+  uint32_t width        = 0;     /**< Full frame width in pixels */
+  uint32_t height       = 0;     /**< Full frame height in pixels */
+  uint32_t sequence     = 0;     /**< Sequence number of this frame */
+  uint32_t baseSequence = 0;     /**< Sequence the patches apply on top of */
+  uint32_t patchCount   = 0;     /**< Number of patches that follow */
+};
+
+/**
+ * @struct DeltaPatchView
+ * @brief One patch inside a payload; data points into the payload buffer
+ */
+struct DeltaPatchView {
+  MediaCaptureRectC rect = {0, 0, 0, 0}; /**< Destination rectangle in the full frame */
+  const uint8_t    *data = nullptr;      /**< JPEG bytes */
+  size_t            size = 0;            /**< Number of JPEG bytes */
+};
+
+/**
+ * @brief Parse a delta payload without copying
+ * @return false if the payload is truncated or not a delta frame
+ */
+bool parseDeltaFrame(
+    const uint8_t *payload, size_t size, DeltaFrameHeader &header, std::vector<DeltaPatchView> &patches);
+
+/**
+ * @brief Find changed tiles and merge them into rectangles
+ *
+ * Tiles along the right and bottom edges are clipped to the frame. Runs of
+ * adjacent dirty tiles in a tile row become one rectangle, and identical runs
+ * in consecutive tile rows are merged vertically.
+ *
+ * @param current Current frame (BGRA)
+ * @param currentBytesPerRow Row stride of the current frame
+ * @param previous Previous frame, same size
+ * @param previousBytesPerRow Row stride of the previous frame
+ * @param width Frame width in pixels
+ * @param height Frame height in pixels
+ * @param tileSize Tile edge length in pixels
+ * @param rects Receives the changed rectangles
+ */
+void findDirtyRects(
+    const uint8_t *current, int32_t currentBytesPerRow, const uint8_t *previous, int32_t previousBytesPerRow,
+    int32_t width, int32_t height, int32_t tileSize, std::vector<MediaCaptureRectC> &rects);
+
+/**
+ * @struct DeltaEncoderOptions
+ * @brief Tunables of DeltaFrameEncoder
+ */
+struct DeltaEncoderOptions {
+  int32_t tileSize           = 64;   /**< Tile edge length in pixels */
+  int64_t keyframeIntervalMs = 5000; /**< Maximum time between keyframes */
+  double  maxDirtyRatio      = 0.5;  /**< Send a keyframe instead once this share of the frame changed */
+  int32_t quality            = 75;   /**< JPEG quality of patches */
+};
+
+/**
+ * @class DeltaFrameEncoder
+ * @brief Produces delta payloads from successive BGRA frames
+ *
+ * Not thread-safe; a capture calls it from its single delivery thread.
+ */
+class DeltaFrameEncoder {
+public:
+  /** Compresses one BGRA region into out; returns false on failure */
+  using PatchEncoder = std::function<bool(
+      const uint8_t *bgra, int32_t width, int32_t height, int32_t bytesPerRow, int32_t quality,
+      std::vector<uint8_t> &out)>;
+
+  /**
+   * @param options Tile size, keyframe policy and quality
+   * @param encoder Patch compressor; defaults to encodeJPEG()
+   */
+  explicit DeltaFrameEncoder(const DeltaEncoderOptions &options = {}, PatchEncoder encoder = nullptr);
+
+  /**
+   * @brief Encode the next frame
+   *
+   * Leaves out empty when nothing changed since the previous frame.
+   *
+   * @param bgra Frame pixels
+   * @param width Width in pixels
+   * @param height Height in pixels
+   * @param bytesPerRow Row stride in bytes
+   * @param timestampMs Capture time, used for the keyframe interval
+   * @param out Receives the payload; existing capacity is reused
+   * @return false if the input is invalid or a patch failed to encode
+   */
+  bool encode(
+      const uint8_t *bgra, int32_t width, int32_t height, int32_t bytesPerRow, int64_t timestampMs,
+      std::vector<uint8_t> &out);
+
+  /**
+   * @brief Make the next frame a keyframe, e.g. after a payload was dropped
+   */
+  void requestKeyframe() {
+    keyframePending = true;
+  }
+
+  /** Change the JPEG quality of subsequent patches */
+  void setQuality(int32_t quality) {
+    options.quality = quality;
+  }
+
+  /** Options in effect */
+  const DeltaEncoderOptions &currentOptions() const {
+    return options;
+  }
+
+private:
+  /** Append one encoded patch to out */
+  bool appendPatch(const uint8_t *bgra, int32_t bytesPerRow, const MediaCaptureRectC &rect, std::vector<uint8_t> &out);
+
+  DeltaEncoderOptions            options;
+  PatchEncoder                   patchEncoder;
+  std::vector<uint8_t>           reference; /**< Last encoded frame, tightly packed */
+  int32_t                        referenceWidth  = 0;
+  int32_t                        referenceHeight = 0;
+  uint32_t                       sequence        = 0;
+  int64_t                        lastKeyframeMs  = 0;
+  bool                           keyframePending = true;
+  std::vector<MediaCaptureRectC> dirty;
+  std::vector<uint8_t>           patch;
+};
+
+/**
+ * @class DeltaCompositor
+ * @brief Rebuilds full BGRA frames from delta payloads
+ */
+class DeltaCompositor {
+public:
+  /** Decompresses one patch into tightly packed BGRA */
+  using PatchDecoder = std::function<bool(
+      const uint8_t *data, size_t size, std::vector<uint8_t> &bgra, int32_t &width, int32_t &height)>;
+
+  /**
+   * @enum Result
+   * @brief Outcome of apply()
+   */
+  enum class Result {
+    Applied,      /**< The canvas now holds the new frame */
+    NeedKeyframe, /**< The delta does not follow the current frame; wait for a keyframe */
+    Invalid       /**< Malformed payload or undecodable patch; the canvas is unchanged or must be resynced */
+  };
+
+  /**
+   * @param decoder Patch decompressor; defaults to decodeJPEG()
+   */
+  explicit DeltaCompositor(PatchDecoder decoder = nullptr);
+
+  /**
+   * @brief Apply a payload produced by DeltaFrameEncoder
+   */
+  Result apply(const uint8_t *payload, size_t size);
+
+  /** Current frame, tightly packed BGRA (empty before the first keyframe) */
+  const std::vector<uint8_t> &frame() const {
+    return canvas;
+  }
+
+  /** Current frame width in pixels */
+  int32_t width() const {
+    return canvasWidth;
+  }
+
+  /** Current frame height in pixels */
+  int32_t height() const {
+    return canvasHeight;
+  }
+
+  /** Sequence number of the current frame */
+  uint32_t sequence() const {
+    return currentSequence;
+  }
+
+private:
+  PatchDecoder                patchDecoder;
+  std::vector<uint8_t>        canvas;
+  int32_t                     canvasWidth     = 0;
+  int32_t                     canvasHeight    = 0;
+  uint32_t                    currentSequence = 0;
+  bool                        synced          = false;
+  std::vector<DeltaPatchView> patches;
+  std::vector<uint8_t>        decoded;
+};
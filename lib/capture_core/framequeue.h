@@ -0,0 +1,144 @@
+/**
+ * @file framequeue.h
+ * @brief Bounded lock-free queue used between capture pipeline stages
+ *
+ * A fixed-capacity ring based on per-cell sequence numbers (Vyukov's bounded
+ * MPMC queue). Neither push nor pop takes a lock, so the capture thread never
+ * waits on a slow consumer. pushDropOldest() evicts the oldest entry when the
+ * ring is full, which keeps only the latest N items queued.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * @class BoundedFrameQueue
+ * @brief Fixed-capacity lock-free FIFO
+ *
+ * @tparam T Element type; must be default constructible and movable
+ */
+template <typename T>
+class BoundedFrameQueue {
+public:
+  /**
+   * @brief Constructor
+   * @param capacity Maximum number of queued elements (at least 1)
+   */
+  explicit BoundedFrameQueue(size_t capacity) :
+      cells(new Cell[capacity > 0 ? capacity : 1]), cellCount(capacity > 0 ? capacity : 1) {
+    for (size_t i = 0; i < cellCount; i++) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedFrameQueue(const BoundedFrameQueue &)            = delete;
+  BoundedFrameQueue &operator=(const BoundedFrameQueue &) = delete;
+
+  /**
+   * @brief Push an element if there is room
+   * @param item Element to push; only moved from on success
+   * @return true if the element was queued, false if the queue is full
+   */
+  bool tryPush(T &&item) {
+    Cell  *cell;
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell          = &cells[pos % cellCount];
+      size_t   seq  = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = std::move(item);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Pop the oldest element if any
+   * @param item Receives the element on success
+   * @return true if an element was popped, false if the queue is empty
+   */
+  bool tryPop(T &item) {
+    Cell  *cell;
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell          = &cells[pos % cellCount];
+      size_t   seq  = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeuePos.load(std::memory_order_relaxed);
+      }
+    }
+    item = std::move(cell->data);
+    cell->sequence.store(pos + cellCount, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Push an element, evicting the oldest one when the queue is full
+   *
+   * Intended for a single producer: once one element has been evicted there is
+   * guaranteed to be room, since consumers only ever remove elements.
+   *
+   * @param item Element to push
+   * @param evicted Receives the evicted element, if any
+   * @return true if an element was evicted to make room
+   */
+  bool pushDropOldest(T &&item, T &evicted) {
+    bool didEvict = false;
+    while (!tryPush(std::move(item))) {
+      if (!didEvict && tryPop(evicted)) {
+        didEvict = true;
+      }
+    }
+    return didEvict;
+  }
+
+  /**
+   * @brief Maximum number of queued elements
+   */
+  size_t capacity() const {
+    return cellCount;
+  }
+
+  /**
+   * @brief Approximate number of queued elements
+   *
+   * Exact when no push or pop is in flight; intended for stats and wakeups.
+   */
+  size_t sizeApprox() const {
+    size_t head = dequeuePos.load(std::memory_order_acquire);
+    size_t tail = enqueuePos.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T                   data;
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  const size_t            cellCount;
+
+  alignas(64) std::atomic<size_t> enqueuePos{0};
+  alignas(64) std::atomic<size_t> dequeuePos{0};
+};
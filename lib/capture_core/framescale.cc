@@ -0,0 +1,42 @@
+/**
+ * @file framescale.cc
+ * @brief Implementation of the BGRA box-filter downscaler
+ */
+#include "framescale.h"
+#include <algorithm>
+#include <cmath>
+
+int32_t scaledDimension(int32_t size, double scale) {
+  return std::max<int32_t>(1, static_cast<int32_t>(std::lround(size * scale)));
+}
+
+void downscaleBGRA(
+    const uint8_t *src, int32_t srcBytesPerRow, int32_t srcWidth, int32_t srcHeight, uint8_t *dst,
+    int32_t dstBytesPerRow, int32_t dstWidth, int32_t dstHeight) {
+  for (int32_t y = 0; y < dstHeight; y++) {
+    const int32_t y0 = static_cast<int32_t>(static_cast<int64_t>(y) * srcHeight / dstHeight);
+    const int32_t y1 = std::max(y0 + 1, static_cast<int32_t>(static_cast<int64_t>(y + 1) * srcHeight / dstHeight));
+    uint8_t      *out = dst + static_cast<size_t>(y) * dstBytesPerRow;
+
+    for (int32_t x = 0; x < dstWidth; x++) {
+      const int32_t x0 = static_cast<int32_t>(static_cast<int64_t>(x) * srcWidth / dstWidth);
+      const int32_t x1 = std::max(x0 + 1, static_cast<int32_t>(static_cast<int64_t>(x + 1) * srcWidth / dstWidth));
+
+      uint32_t sum[4] = {0, 0, 0, 0};
+      for (int32_t sy = y0; sy < y1; sy++) {
+        const uint8_t *p = src + static_cast<size_t>(sy) * srcBytesPerRow + static_cast<size_t>(x0) * 4;
+        for (int32_t sx = x0; sx < x1; sx++, p += 4) {
+          sum[0] += p[0];
+          sum[1] += p[1];
+          sum[2] += p[2];
+          sum[3] += p[3];
+        }
+      }
+
+      const uint32_t count = static_cast<uint32_t>((y1 - y0) * (x1 - x0));
+      for (int c = 0; c < 4; c++) {
+        out[x * 4 + c] = static_cast<uint8_t>((sum[c] + count / 2) / count);
+      }
+    }
+  }
+}
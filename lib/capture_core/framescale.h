@@ -0,0 +1,32 @@
+/**
+ * @file framescale.h
+ * @brief Downscaling of BGRA frames before encoding
+ */
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Size of one dimension after scaling, at least 1
+ */
+int32_t scaledDimension(int32_t size, double scale);
+
+/**
+ * @brief Shrink a BGRA image with an area-averaging (box) filter
+ *
+ * Every destination pixel is the mean of the source pixels it covers, which
+ * avoids the aliasing of nearest-neighbour sampling on text and UI edges.
+ * The destination must not be larger than the source in either dimension.
+ *
+ * @param src First byte of the source image
+ * @param srcBytesPerRow Source row stride in bytes
+ * @param srcWidth Source width in pixels
+ * @param srcHeight Source height in pixels
+ * @param dst First byte of the destination image
+ * @param dstBytesPerRow Destination row stride in bytes
+ * @param dstWidth Destination width in pixels
+ * @param dstHeight Destination height in pixels
+ */
+void downscaleBGRA(
+    const uint8_t *src, int32_t srcBytesPerRow, int32_t srcWidth, int32_t srcHeight, uint8_t *dst,
+    int32_t dstBytesPerRow, int32_t dstWidth, int32_t dstHeight);
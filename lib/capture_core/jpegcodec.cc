@@ -0,0 +1,375 @@
+/**
+ * @file jpegcodec.cc
+ * @brief libjpeg, ImageIO and GDI+ implementations of the JPEG helpers
+ */
+#include "jpegcodec.h"
+
+#if defined(CAPTURE_HAVE_LIBJPEG)
+
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+
+namespace {
+
+/** Error manager that unwinds with longjmp instead of calling exit() */
+struct JpegError {
+  jpeg_error_mgr manager;
+  jmp_buf        jump;
+};
+
+void jpegErrorExit(j_common_ptr cinfo) {
+  longjmp(reinterpret_cast<JpegError *>(cinfo->err)->jump, 1);
+}
+
+void jpegSilentMessage(j_common_ptr) {
+}
+
+/** Destination manager that writes into a std::vector, growing it by doubling */
+struct VectorDestination {
+  jpeg_destination_mgr  manager;
+  std::vector<uint8_t> *out;
+};
+
+void initVectorDestination(j_compress_ptr cinfo) {
+  auto *dest = reinterpret_cast<VectorDestination *>(cinfo->dest);
+  dest->out->resize(dest->out->capacity() > 4096 ? dest->out->capacity() : 4096);
+  dest->manager.next_output_byte = dest->out->data();
+  dest->manager.free_in_buffer   = dest->out->size();
+}
+
+boolean emptyVectorDestination(j_compress_ptr cinfo) {
+  auto        *dest = reinterpret_cast<VectorDestination *>(cinfo->dest);
+  const size_t used = dest->out->size();
+  dest->out->resize(used * 2);
+  dest->manager.next_output_byte = dest->out->data() + used;
+  dest->manager.free_in_buffer   = dest->out->size() - used;
+  return TRUE;
+}
+
+void termVectorDestination(j_compress_ptr cinfo) {
+  auto *dest = reinterpret_cast<VectorDestination *>(cinfo->dest);
+  dest->out->resize(dest->out->size() - dest->manager.free_in_buffer);
+}
+
+} // namespace
+
+bool jpegCodecAvailable() {
+  return true;
+}
+
+bool encodeJPEG(
+    const uint8_t *bgra, int32_t width, int32_t height, int32_t bytesPerRow, int32_t quality,
+    std::vector<uint8_t> &out) {
+  if (!bgra || width <= 0 || height <= 0 || bytesPerRow < width * 4) {
+    return false;
+  }
+
+  jpeg_compress_struct cinfo;
+  JpegError            error;
+  VectorDestination    dest;
+  cinfo.err                        = jpeg_std_error(&error.manager);
+  error.manager.error_exit         = jpegErrorExit;
+  error.manager.output_message     = jpegSilentMessage;
+  dest.manager.init_destination    = initVectorDestination;
+  dest.manager.empty_output_buffer = emptyVectorDestination;
+  dest.manager.term_destination    = termVectorDestination;
+  dest.out                         = &out;
+
+  if (setjmp(error.jump)) {
+    jpeg_destroy_compress(&cinfo);
+    out.clear();
+    return false;
+  }
+
+  jpeg_create_compress(&cinfo);
+  cinfo.dest             = &dest.manager;
+  cinfo.image_width      = static_cast<JDIMENSION>(width);
+  cinfo.image_height     = static_cast<JDIMENSION>(height);
+  cinfo.input_components = 4;
+  cinfo.in_color_space   = JCS_EXT_BGRA;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality < 1 ? 1 : (quality > 100 ? 100 : quality), TRUE);
+  cinfo.dct_method = JDCT_ISLOW;
+
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW row = const_cast<JSAMPROW>(bgra + static_cast<size_t>(cinfo.next_scanline) * bytesPerRow);
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  return true;
+}
+
+bool decodeJPEG(const uint8_t *data, size_t size, std::vector<uint8_t> &bgra, int32_t &width, int32_t &height) {
+  if (!data || size == 0) {
+    return false;
+  }
+
+  jpeg_decompress_struct cinfo;
+  JpegError              error;
+  cinfo.err                    = jpeg_std_error(&error.manager);
+  error.manager.error_exit     = jpegErrorExit;
+  error.manager.output_message = jpegSilentMessage;
+
+  if (setjmp(error.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, const_cast<unsigned char *>(data), static_cast<unsigned long>(size));
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_EXT_BGRA;
+  jpeg_start_decompress(&cinfo);
+
+  width  = static_cast<int32_t>(cinfo.output_width);
+  height = static_cast<int32_t>(cinfo.output_height);
+  bgra.resize(static_cast<size_t>(width) * height * 4);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = bgra.data() + static_cast<size_t>(cinfo.output_scanline) * width * 4;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+#elif defined(__APPLE__)
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreGraphics/CoreGraphics.h>
+#include <ImageIO/ImageIO.h>
+
+bool jpegCodecAvailable() {
+  return true;
+}
+
+bool encodeJPEG(
+    const uint8_t *bgra, int32_t width, int32_t height, int32_t bytesPerRow, int32_t quality,
+    std::vector<uint8_t> &out) {
+  if (!bgra || width <= 0 || height <= 0 || bytesPerRow < width * 4) {
+    return false;
+  }
+
+  CGColorSpaceRef   colorSpace = CGColorSpaceCreateDeviceRGB();
+  CGDataProviderRef provider =
+      CGDataProviderCreateWithData(nullptr, bgra, static_cast<size_t>(bytesPerRow) * height, nullptr);
+  CGImageRef image = CGImageCreate(
+      width, height, 8, 32, bytesPerRow, colorSpace, kCGBitmapByteOrder32Little | kCGImageAlphaNoneSkipFirst,
+      provider, nullptr, false, kCGRenderingIntentDefault);
+
+  CFMutableDataRef      data        = CFDataCreateMutable(nullptr, 0);
+  CGImageDestinationRef destination = CGImageDestinationCreateWithData(data, CFSTR("public.jpeg"), 1, nullptr);
+  const float           level       = static_cast<float>(quality) / 100.0f;
+  CFNumberRef           levelNumber = CFNumberCreate(nullptr, kCFNumberFloatType, &level);
+  const void           *keys[]      = {kCGImageDestinationLossyCompressionQuality};
+  const void           *values[]    = {levelNumber};
+  CFDictionaryRef       properties  = CFDictionaryCreate(
+      nullptr, keys, values, 1, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+
+  bool ok = false;
+  if (image && destination) {
+    CGImageDestinationAddImage(destination, image, properties);
+    ok = CGImageDestinationFinalize(destination);
+  }
+  if (ok) {
+    const UInt8 *bytes = CFDataGetBytePtr(data);
+    out.assign(bytes, bytes + CFDataGetLength(data));
+  }
+
+  CFRelease(properties);
+  CFRelease(levelNumber);
+  if (destination) {
+    CFRelease(destination);
+  }
+  CFRelease(data);
+  if (image) {
+    CGImageRelease(image);
+  }
+  CGDataProviderRelease(provider);
+  CGColorSpaceRelease(colorSpace);
+  return ok;
+}
+
+bool decodeJPEG(const uint8_t *data, size_t size, std::vector<uint8_t> &bgra, int32_t &width, int32_t &height) {
+  if (!data || size == 0) {
+    return false;
+  }
+
+  CFDataRef        bytes  = CFDataCreateWithBytesNoCopy(nullptr, data, static_cast<CFIndex>(size), kCFAllocatorNull);
+  CGImageSourceRef source = CGImageSourceCreateWithData(bytes, nullptr);
+  CGImageRef       image  = source ? CGImageSourceCreateImageAtIndex(source, 0, nullptr) : nullptr;
+  bool             ok     = false;
+
+  if (image) {
+    width  = static_cast<int32_t>(CGImageGetWidth(image));
+    height = static_cast<int32_t>(CGImageGetHeight(image));
+    bgra.resize(static_cast<size_t>(width) * height * 4);
+
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef    context    = CGBitmapContextCreate(
+        bgra.data(), width, height, 8, static_cast<size_t>(width) * 4, colorSpace,
+        kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst);
+    if (context) {
+      CGContextDrawImage(context, CGRectMake(0, 0, width, height), image);
+      CGContextRelease(context);
+      ok = true;
+    }
+    CGColorSpaceRelease(colorSpace);
+    CGImageRelease(image);
+  }
+
+  if (source) {
+    CFRelease(source);
+  }
+  CFRelease(bytes);
+  return ok;
+}
+
+#elif defined(_WIN32)
+
+#include <windows.h>
+#include <objidl.h>
+#include <shlwapi.h>
+#include <gdiplus.h>
+#include <cwchar>
+#include <mutex>
+
+#pragma comment(lib, "gdiplus.lib")
+#pragma comment(lib, "shlwapi.lib")
+
+namespace {
+
+/** Start GDI+ once for the process; it is left running until exit */
+bool ensureGdiplus() {
+  static std::once_flag once;
+  static bool           started = false;
+  std::call_once(once, [] {
+    Gdiplus::GdiplusStartupInput input;
+    ULONG_PTR                    token = 0;
+    started                            = Gdiplus::GdiplusStartup(&token, &input, nullptr) == Gdiplus::Ok;
+  });
+  return started;
+}
+
+bool jpegEncoderClsid(CLSID &clsid) {
+  UINT count = 0, size = 0;
+  Gdiplus::GetImageEncodersSize(&count, &size);
+  if (size == 0) {
+    return false;
+  }
+  std::vector<uint8_t> storage(size);
+  auto                *codecs = reinterpret_cast<Gdiplus::ImageCodecInfo *>(storage.data());
+  Gdiplus::GetImageEncoders(count, size, codecs);
+  for (UINT i = 0; i < count; i++) {
+    if (wcscmp(codecs[i].MimeType, L"image/jpeg") == 0) {
+      clsid = codecs[i].Clsid;
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+bool jpegCodecAvailable() {
+  return ensureGdiplus();
+}
+
+bool encodeJPEG(
+    const uint8_t *bgra, int32_t width, int32_t height, int32_t bytesPerRow, int32_t quality,
+    std::vector<uint8_t> &out) {
+  if (!bgra || width <= 0 || height <= 0 || bytesPerRow < width * 4 || !ensureGdiplus()) {
+    return false;
+  }
+
+  static CLSID clsid;
+  static bool  haveClsid = jpegEncoderClsid(clsid);
+  if (!haveClsid) {
+    return false;
+  }
+
+  Gdiplus::Bitmap bitmap(width, height, bytesPerRow, PixelFormat32bppRGB, const_cast<uint8_t *>(bgra));
+  IStream        *stream = SHCreateMemStream(nullptr, 0);
+  if (!stream) {
+    return false;
+  }
+
+  Gdiplus::EncoderParameters parameters;
+  ULONG                      level       = static_cast<ULONG>(quality);
+  parameters.Count                       = 1;
+  parameters.Parameter[0].Guid           = Gdiplus::EncoderQuality;
+  parameters.Parameter[0].Type           = Gdiplus::EncoderParameterValueTypeLong;
+  parameters.Parameter[0].NumberOfValues = 1;
+  parameters.Parameter[0].Value          = &level;
+
+  bool    ok = bitmap.Save(stream, &clsid, &parameters) == Gdiplus::Ok;
+  STATSTG stat;
+  if (ok && SUCCEEDED(stream->Stat(&stat, STATFLAG_NONAME))) {
+    LARGE_INTEGER zero = {};
+    ULONG         read = 0;
+    out.resize(static_cast<size_t>(stat.cbSize.QuadPart));
+    stream->Seek(zero, STREAM_SEEK_SET, nullptr);
+    ok = SUCCEEDED(stream->Read(out.data(), static_cast<ULONG>(out.size()), &read)) && read == out.size();
+  } else {
+    ok = false;
+  }
+  stream->Release();
+  return ok;
+}
+
+bool decodeJPEG(const uint8_t *data, size_t size, std::vector<uint8_t> &bgra, int32_t &width, int32_t &height) {
+  if (!data || size == 0 || !ensureGdiplus()) {
+    return false;
+  }
+
+  IStream *stream = SHCreateMemStream(data, static_cast<UINT>(size));
+  if (!stream) {
+    return false;
+  }
+
+  bool ok = false;
+  {
+    Gdiplus::Bitmap bitmap(stream);
+    if (bitmap.GetLastStatus() == Gdiplus::Ok) {
+      width  = static_cast<int32_t>(bitmap.GetWidth());
+      height = static_cast<int32_t>(bitmap.GetHeight());
+      bgra.resize(static_cast<size_t>(width) * height * 4);
+
+      // Lock straight into the output buffer; 32bppARGB is B, G, R, A in memory
+      Gdiplus::BitmapData locked = {};
+      locked.Width               = width;
+      locked.Height              = height;
+      locked.Stride              = width * 4;
+      locked.PixelFormat         = PixelFormat32bppARGB;
+      locked.Scan0               = bgra.data();
+      Gdiplus::Rect rect(0, 0, width, height);
+      ok = bitmap.LockBits(
+               &rect, Gdiplus::ImageLockModeRead | Gdiplus::ImageLockModeUserInputBuf, PixelFormat32bppARGB,
+               &locked) == Gdiplus::Ok;
+      if (ok) {
+        bitmap.UnlockBits(&locked);
+      }
+    }
+  }
+  stream->Release();
+  return ok;
+}
+
+#else
+
+bool jpegCodecAvailable() {
+  return false;
+}
+
+bool encodeJPEG(const uint8_t *, int32_t, int32_t, int32_t, int32_t, std::vector<uint8_t> &) {
+  return false;
+}
+
+bool decodeJPEG(const uint8_t *, size_t, std::vector<uint8_t> &, int32_t &, int32_t &) {
+  return false;
+}
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file jpegcodec.h
+ * @brief Platform JPEG encoder and decoder for BGRA images
+ *
+ * Used where the portable code needs to compress or decompress a region on
+ * its own, such as the patches of delta frames. Each platform uses the codec
+ * it already ships: libjpeg(-turbo) on Linux, ImageIO on macOS and GDI+ on
+ * Windows.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Whether this build has a JPEG codec
+ */
+bool jpegCodecAvailable();
+
+/**
+ * @brief Compress a BGRA image
+ * @param bgra First byte of the image; alpha is ignored
+ * @param width Width in pixels
+ * @param height Height in pixels
+ * @param bytesPerRow Row stride in bytes
+ * @param quality JPEG quality (1-100)
+ * @param out Receives the JPEG file bytes; existing capacity is reused
+ * @return false if the input is invalid or no codec is available
+ */
+bool encodeJPEG(
+    const uint8_t *bgra, int32_t width, int32_t height, int32_t bytesPerRow, int32_t quality,
+    std::vector<uint8_t> &out);
+
+/**
+ * @brief Decompress a JPEG into tightly packed BGRA (alpha = 255)
+ * @param data JPEG file bytes
+ * @param size Number of bytes
+ * @param bgra Receives width * height * 4 bytes
+ * @param width Receives the image width
+ * @param height Receives the image height
+ * @return false if the data cannot be decoded or no codec is available
+ */
+bool decodeJPEG(const uint8_t *data, size_t size, std::vector<uint8_t> &bgra, int32_t &width, int32_t &height);
@@ -0,0 +1,207 @@
+/**
+ * @file lookbackbuffer.cc
+ * @brief Implementation of the look-back buffer
+ */
+#include "lookbackbuffer.h"
+#include "recordingsink.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+LookbackBuffer::LookbackBuffer(const LookbackOptions &options)
+    : seconds(std::max(0.0, options.seconds)),
+      audioBudget(options.audioSampleRate > 0 && options.audioChannels > 0
+                      ? std::min<uint64_t>(static_cast<uint64_t>(std::ceil(seconds * options.audioSampleRate)) *
+                                               options.audioChannels * sizeof(float),
+                                           options.maxBytes / 2)
+                      : 0),
+      videoBudget(options.maxBytes - audioBudget) {}
+
+bool LookbackBuffer::writeVideo(const uint8_t *data, size_t size, int32_t width, int32_t height, int32_t bytesPerRow,
+                                bool jpeg, int64_t timestampMs) {
+  if (!data || size == 0) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  if (size > videoBudget) {
+    dropped++;
+    return false;
+  }
+  if (arena.empty()) {
+    arena.resize(static_cast<size_t>(videoBudget));
+  }
+
+  size_t at = videoWrite;
+  if (at + size > arena.size()) {
+    // Frames stored past the write position are the oldest; the end of the arena is left unused
+    while (!frames.empty() && frames.front().offset >= at) {
+      frames.pop_front();
+    }
+    at = 0;
+  }
+  while (!frames.empty() && frames.front().offset < at + size && frames.front().offset + frames.front().size > at) {
+    frames.pop_front();
+  }
+
+  std::memcpy(arena.data() + at, data, size);
+  Frame frame;
+  frame.offset      = at;
+  frame.size        = size;
+  frame.width       = width;
+  frame.height      = height;
+  frame.bytesPerRow = bytesPerRow;
+  frame.jpeg        = jpeg;
+  frame.timestampMs = timestampMs;
+  frames.push_back(frame);
+  videoWrite = at + size;
+  return true;
+}
+
+void LookbackBuffer::writeAudio(const float *samples, uint32_t frameCount, int32_t channels, int32_t sampleRate,
+                                int64_t timestampMs) {
+  if (!samples || frameCount == 0 || channels <= 0 || sampleRate <= 0 || audioBudget == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  if (channels != this->channels || sampleRate != this->sampleRate) {
+    uint64_t wanted = static_cast<uint64_t>(std::ceil(seconds * sampleRate));
+    uint64_t fits   = audioBudget / (static_cast<uint64_t>(channels) * sizeof(float));
+    audioCapacity   = static_cast<uint32_t>(std::min<uint64_t>({wanted, fits, std::numeric_limits<uint32_t>::max()}));
+    audioRing.assign(static_cast<size_t>(audioCapacity) * channels, 0.0f);
+    audioWrite       = 0;
+    audioFill        = 0;
+    this->channels   = channels;
+    this->sampleRate = sampleRate;
+  }
+  audioEndMs = timestampMs + std::llround(frameCount * 1000.0 / sampleRate);
+  if (audioCapacity == 0) {
+    return;
+  }
+
+  // Only the newest audioCapacity frames of an oversized block are kept
+  if (frameCount > audioCapacity) {
+    samples += static_cast<size_t>(frameCount - audioCapacity) * channels;
+    frameCount = audioCapacity;
+  }
+  uint32_t first = std::min(frameCount, audioCapacity - audioWrite);
+  std::memcpy(audioRing.data() + static_cast<size_t>(audioWrite) * channels, samples,
+              static_cast<size_t>(first) * channels * sizeof(float));
+  std::memcpy(audioRing.data(), samples + static_cast<size_t>(first) * channels,
+              static_cast<size_t>(frameCount - first) * channels * sizeof(float));
+  audioWrite = (audioWrite + frameCount) % audioCapacity;
+  audioFill  = std::min(audioCapacity, audioFill + frameCount);
+}
+
+void LookbackBuffer::snapshot(double length, LookbackSnapshot &out) const {
+  out.data.clear();
+  out.frames.clear();
+  out.audioFrames  = 0;
+  out.channels     = 0;
+  out.sampleRate   = 0;
+  out.audioStartMs = 0;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (audioFill == 0 && frames.empty()) {
+    return;
+  }
+  const double span  = std::min(std::max(0.0, length), seconds);
+  int64_t      endMs = std::numeric_limits<int64_t>::min();
+  if (audioFill > 0) {
+    endMs = audioEndMs;
+  }
+  if (!frames.empty()) {
+    endMs = std::max(endMs, frames.back().timestampMs);
+  }
+  const int64_t startMs = endMs - std::llround(span * 1000.0);
+
+  uint32_t audioCount = 0;
+  if (audioFill > 0 && audioEndMs > startMs) {
+    double covered = static_cast<double>(audioEndMs - startMs) * sampleRate / 1000.0;
+    audioCount     = static_cast<uint32_t>(std::min<double>(audioFill, std::llround(covered)));
+  }
+
+  // Start at the frame on screen when the span opens
+  size_t first = 0;
+  while (first + 1 < frames.size() && frames[first + 1].timestampMs <= startMs) {
+    first++;
+  }
+
+  const size_t audioBytes = static_cast<size_t>(audioCount) * channels * sizeof(float);
+  size_t       total      = audioBytes;
+  for (size_t i = first; i < frames.size(); i++) {
+    total += frames[i].size;
+  }
+  out.data.resize(total);
+
+  if (audioCount > 0) {
+    const uint32_t start = (audioWrite + audioCapacity - audioCount) % audioCapacity;
+    const uint32_t head  = std::min(audioCount, audioCapacity - start);
+    std::memcpy(out.data.data(), audioRing.data() + static_cast<size_t>(start) * channels,
+                static_cast<size_t>(head) * channels * sizeof(float));
+    std::memcpy(out.data.data() + static_cast<size_t>(head) * channels * sizeof(float), audioRing.data(),
+                static_cast<size_t>(audioCount - head) * channels * sizeof(float));
+    out.audioFrames  = audioCount;
+    out.channels     = channels;
+    out.sampleRate   = sampleRate;
+    out.audioStartMs = audioEndMs - std::llround(audioCount * 1000.0 / sampleRate);
+  }
+
+  size_t offset = audioBytes;
+  for (size_t i = first; i < frames.size(); i++) {
+    const Frame  &frame = frames[i];
+    LookbackFrame copy;
+    copy.offset      = offset;
+    copy.size        = frame.size;
+    copy.width       = frame.width;
+    copy.height      = frame.height;
+    copy.bytesPerRow = frame.bytesPerRow;
+    copy.jpeg        = frame.jpeg;
+    copy.timestampMs = frame.timestampMs;
+    std::memcpy(out.data.data() + offset, arena.data() + frame.offset, frame.size);
+    out.frames.push_back(copy);
+    offset += frame.size;
+  }
+}
+
+uint64_t LookbackBuffer::memoryBytes() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return audioRing.size() * sizeof(float) + arena.size();
+}
+
+uint64_t LookbackBuffer::droppedFrames() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return dropped;
+}
+
+bool writeLookbackSnapshot(const LookbackSnapshot &snapshot, const std::string &dir, std::string &error) {
+  // Audio goes to the sink in one-second blocks
+  const uint32_t blockFrames = static_cast<uint32_t>(std::max(1, snapshot.sampleRate));
+
+  RecordingOptions options;
+  options.dir   = dir;
+  options.audio = snapshot.audioFrames > 0 ? RecordingAudioFormat::Wav : RecordingAudioFormat::None;
+  options.video = RecordingVideoFormat::None;
+  if (!snapshot.frames.empty()) {
+    bool allJpeg  = std::all_of(snapshot.frames.begin(), snapshot.frames.end(),
+                                [](const LookbackFrame &frame) { return frame.jpeg; });
+    options.video = allJpeg ? RecordingVideoFormat::Mjpeg : RecordingVideoFormat::Frames;
+  }
+  // Everything is queued at once, so the queue must hold all of it rather than drop
+  options.queueDepth = snapshot.frames.size() + (snapshot.audioFrames + blockFrames - 1) / blockFrames + 1;
+
+  RecordingSink sink(options);
+  if (!sink.open(error)) {
+    return false;
+  }
+  for (uint32_t start = 0; start < snapshot.audioFrames; start += blockFrames) {
+    uint32_t count = std::min(blockFrames, snapshot.audioFrames - start);
+    sink.writeAudio(snapshot.audio() + static_cast<size_t>(start) * snapshot.channels, static_cast<int32_t>(count),
+                    snapshot.channels, snapshot.sampleRate);
+  }
+  for (const LookbackFrame &frame : snapshot.frames) {
+    sink.writeVideo(snapshot.data.data() + frame.offset, frame.size, frame.width, frame.height, frame.jpeg,
+                    frame.timestampMs);
+  }
+  return sink.close(error);
+}
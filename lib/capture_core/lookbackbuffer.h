@@ -0,0 +1,169 @@
+/**
+ * @file lookbackbuffer.h
+ * @brief Keeps the last seconds of capture in native memory until asked for them
+ *
+ * A "clip that" button or a trigger needs the audio and video from before
+ * it fired. Instead of streaming everything into JavaScript and buffering it
+ * there, the capture threads write into a LookbackBuffer and nothing crosses
+ * to JavaScript until a snapshot is taken.
+ *
+ * Memory is fixed by LookbackOptions::maxBytes:
+ *  - audio is an interleaved float ring of `seconds` of the expected format,
+ *    given at most half the budget;
+ *  - encoded frames (JPEG or BGRA, as the backend produced them) are stored
+ *    back to back in a byte arena holding the rest. A new frame overwrites
+ *    the oldest ones it needs room for, so at high resolutions the video
+ *    reaches back less far than the audio.
+ * Both are allocated on first use and never grow.
+ */
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @struct LookbackOptions
+ * @brief Span and memory budget of a look-back buffer
+ */
+struct LookbackOptions {
+  double   seconds         = 30;            /**< Longest span a snapshot can cover */
+  uint64_t maxBytes        = 256ull << 20;  /**< Memory for audio and video together */
+  int32_t  audioSampleRate = 48000;         /**< Expected audio format, sizes the audio share; 0 = no audio */
+  int32_t  audioChannels   = 2;
+};
+
+/**
+ * @struct LookbackFrame
+ * @brief A video frame inside a snapshot
+ */
+struct LookbackFrame {
+  size_t  offset      = 0;     /**< Position in LookbackSnapshot::data */
+  size_t  size        = 0;     /**< Number of bytes */
+  int32_t width       = 0;
+  int32_t height      = 0;
+  int32_t bytesPerRow = 0;     /**< Row stride of BGRA frames */
+  bool    jpeg        = false; /**< true for JPEG data, false for BGRA */
+  int64_t timestampMs = 0;     /**< Capture time in milliseconds since the Unix epoch */
+};
+
+/**
+ * @struct LookbackSnapshot
+ * @brief Copy of the buffered media, in one contiguous allocation
+ *
+ * data holds the interleaved float audio first, then each frame's bytes in
+ * capture order.
+ */
+struct LookbackSnapshot {
+  std::vector<uint8_t>       data;
+  uint32_t                   audioFrames  = 0; /**< Sample frames at the start of data */
+  int32_t                    channels     = 0;
+  int32_t                    sampleRate   = 0;
+  int64_t                    audioStartMs = 0; /**< Capture time of the first sample */
+  std::vector<LookbackFrame> frames;
+
+  const float *audio() const {
+    return reinterpret_cast<const float *>(data.data());
+  }
+};
+
+/**
+ * @brief Write a snapshot as a recording: audio-0001.wav plus video-0001.mjpeg and its
+ *        index when every frame is JPEG, per-frame files otherwise (see recordingsink.h)
+ * @param snapshot Media to write
+ * @param dir Directory, created if it does not exist
+ * @param error Receives a description on failure
+ */
+bool writeLookbackSnapshot(const LookbackSnapshot &snapshot, const std::string &dir, std::string &error);
+
+/**
+ * @class LookbackBuffer
+ * @brief Fixed-memory ring of recent audio and video frames
+ *
+ * writeVideo() and writeAudio() may be called from the capture threads while
+ * snapshot() runs on any other; each takes a short lock.
+ */
+class LookbackBuffer {
+public:
+  explicit LookbackBuffer(const LookbackOptions &options);
+
+  /**
+   * @brief Store a video frame, evicting the oldest frames it needs room for
+   * @param data Frame bytes, copied before returning
+   * @param size Number of bytes
+   * @param width Frame width
+   * @param height Frame height
+   * @param bytesPerRow Row stride of BGRA frames
+   * @param jpeg true for JPEG data, false for BGRA
+   * @param timestampMs Capture time in milliseconds since the Unix epoch
+   * @return false if the frame is larger than the whole video share
+   */
+  bool writeVideo(const uint8_t *data, size_t size, int32_t width, int32_t height, int32_t bytesPerRow, bool jpeg,
+                  int64_t timestampMs);
+
+  /**
+   * @brief Append interleaved float audio; a change of format drops the audio held so far
+   * @param samples Samples, copied before returning
+   * @param frameCount Number of sample frames
+   * @param channels Channels per frame
+   * @param sampleRate Sample rate in Hz
+   * @param timestampMs Capture time of the first sample in milliseconds since the Unix epoch
+   */
+  void writeAudio(const float *samples, uint32_t frameCount, int32_t channels, int32_t sampleRate,
+                  int64_t timestampMs);
+
+  /**
+   * @brief Copy the last seconds of media, ending at the newest frame or sample held
+   *
+   * The frame already on screen when the span starts is included too, so a
+   * clip of a static screen still has a picture.
+   *
+   * @param length Seconds to copy, at most LookbackOptions::seconds
+   * @param out Receives the media
+   */
+  void snapshot(double length, LookbackSnapshot &out) const;
+
+  /** Bytes allocated so far; never more than LookbackOptions::maxBytes */
+  uint64_t memoryBytes() const;
+
+  /** Frames that did not fit the video share at all */
+  uint64_t droppedFrames() const;
+
+private:
+  struct Frame {
+    size_t  offset      = 0;
+    size_t  size        = 0;
+    int32_t width       = 0;
+    int32_t height      = 0;
+    int32_t bytesPerRow = 0;
+    bool    jpeg        = false;
+    int64_t timestampMs = 0;
+  };
+
+  const double   seconds;
+  const uint64_t audioBudget;
+  const uint64_t videoBudget;
+
+  mutable std::mutex mutex;
+
+  /** @name Audio ring: audioFill frames ending just before audioWrite */
+  ///@{
+  std::vector<float> audioRing;
+  uint32_t           audioCapacity = 0; /**< Sample frames */
+  uint32_t           audioWrite    = 0;
+  uint32_t           audioFill     = 0;
+  int32_t            channels      = 0;
+  int32_t            sampleRate    = 0;
+  int64_t            audioEndMs    = 0; /**< Capture time just after the newest sample */
+  ///@}
+
+  /** @name Frame arena: frames oldest first, each stored unsplit */
+  ///@{
+  std::vector<uint8_t> arena;
+  std::deque<Frame>    frames;
+  size_t               videoWrite = 0;
+  uint64_t             dropped    = 0;
+  ///@}
+};
@@ -0,0 +1,248 @@
+/**
+ * @file melspectrogram.cc
+ * @brief Implementation of the streaming log-mel spectrogram
+ */
+#include "melspectrogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+/** Slaney scale: 200/3 Hz per mel below 1 kHz, then 27 mels per factor of 6.4 */
+constexpr double kLinearHzPerMel = 200.0 / 3.0;
+constexpr double kLogStartHz     = 1000.0;
+constexpr double kLogStartMel    = kLogStartHz / kLinearHzPerMel;
+const double     kLogStep        = std::log(6.4) / 27.0;
+
+} // namespace
+
+double MelSpectrogram::hzToMel(double hz) {
+  if (hz < kLogStartHz) {
+    return hz / kLinearHzPerMel;
+  }
+  return kLogStartMel + std::log(hz / kLogStartHz) / kLogStep;
+}
+
+double MelSpectrogram::melToHz(double mel) {
+  if (mel < kLogStartMel) {
+    return mel * kLinearHzPerMel;
+  }
+  return kLogStartHz * std::exp(kLogStep * (mel - kLogStartMel));
+}
+
+MelSpectrogram::MelSpectrogram(const MelSpectrogramConfig &config) : settings(config) {
+  MelSpectrogramConfig &s = settings;
+  s.sampleRate            = std::max(1, s.sampleRate);
+  s.nFft                  = std::max(2u, s.nFft);
+  s.winLength             = (s.winLength == 0 || s.winLength > s.nFft) ? s.nFft : s.winLength;
+  s.hop                   = std::min(std::max(1u, s.hop), s.nFft);
+  s.nMels                 = std::max(1u, s.nMels);
+  const float nyquist     = s.sampleRate / 2.0f;
+  s.fmax                  = (s.fmax <= 0.0f || s.fmax > nyquist) ? nyquist : s.fmax;
+  s.fmin                  = std::min(std::max(0.0f, s.fmin), s.fmax);
+  s.logFloor              = std::max(s.logFloor, 1e-30f);
+
+  const uint32_t n    = s.nFft;
+  const uint32_t bins = n / 2 + 1;
+  powerOfTwo          = n >= 4 && (n & (n - 1)) == 0;
+
+  // Periodic Hann, as scipy's get_window('hann', winLength) and torch.hann_window
+  window.assign(n, 0.0f);
+  const uint32_t offset = (n - s.winLength) / 2;
+  for (uint32_t i = 0; i < s.winLength; i++) {
+    window[offset + i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * i / s.winLength));
+  }
+  frameBuffer.resize(n);
+  power.resize(bins);
+
+  if (powerOfTwo) {
+    const uint32_t half = n / 2;
+    fftRe.resize(half);
+    fftIm.resize(half);
+    twiddleRe.resize(half);
+    twiddleIm.resize(half);
+    for (uint32_t k = 0; k < half; k++) {
+      twiddleRe[k] = static_cast<float>(std::cos(2.0 * kPi * k / n));
+      twiddleIm[k] = static_cast<float>(-std::sin(2.0 * kPi * k / n));
+    }
+    uint32_t log2 = 0;
+    while ((1u << log2) < half) {
+      log2++;
+    }
+    bitReverse.resize(half);
+    for (uint32_t i = 0; i < half; i++) {
+      uint32_t reversed = 0;
+      for (uint32_t b = 0; b < log2; b++) {
+        reversed |= ((i >> b) & 1u) << (log2 - 1 - b);
+      }
+      bitReverse[i] = reversed;
+    }
+  } else {
+    cosTable.resize(n);
+    sinTable.resize(n);
+    for (uint32_t j = 0; j < n; j++) {
+      cosTable[j] = static_cast<float>(std::cos(2.0 * kPi * j / n));
+      sinTable[j] = static_cast<float>(std::sin(2.0 * kPi * j / n));
+    }
+  }
+
+  // Triangles between evenly spaced mel edges, each scaled to unit area in Hz
+  const double melMin = hzToMel(s.fmin);
+  const double melMax = hzToMel(s.fmax);
+  edges.resize(s.nMels + 2);
+  for (uint32_t i = 0; i < edges.size(); i++) {
+    edges[i] = melToHz(melMin + (melMax - melMin) * i / (s.nMels + 1));
+  }
+  filterStart.resize(s.nMels);
+  filterLength.resize(s.nMels);
+  filterOffset.resize(s.nMels);
+  for (uint32_t m = 0; m < s.nMels; m++) {
+    const double lowerWidth = edges[m + 1] - edges[m];
+    const double upperWidth = edges[m + 2] - edges[m + 1];
+    const double norm       = 2.0 / (edges[m + 2] - edges[m]);
+    filterStart[m]          = 0;
+    filterLength[m]         = 0;
+    filterOffset[m]         = static_cast<uint32_t>(filterWeights.size());
+    for (uint32_t b = 0; b < bins; b++) {
+      const double hz     = static_cast<double>(b) * s.sampleRate / n;
+      const double lower  = lowerWidth > 0 ? (hz - edges[m]) / lowerWidth : 0.0;
+      const double upper  = upperWidth > 0 ? (edges[m + 2] - hz) / upperWidth : 0.0;
+      const double weight = std::max(0.0, std::min(lower, upper)) * norm;
+      if (weight <= 0.0) {
+        continue;
+      }
+      if (filterLength[m] == 0) {
+        filterStart[m] = b;
+      }
+      // Zero weights inside the span (none for a triangle) keep it contiguous
+      while (filterStart[m] + filterLength[m] < b) {
+        filterWeights.push_back(0.0f);
+        filterLength[m]++;
+      }
+      filterWeights.push_back(static_cast<float>(weight));
+      filterLength[m]++;
+    }
+  }
+}
+
+void MelSpectrogram::complexFft() {
+  const uint32_t half = static_cast<uint32_t>(fftRe.size());
+  const uint32_t n    = settings.nFft;
+  for (uint32_t length = 2; length <= half; length <<= 1) {
+    const uint32_t stride = n / length; // twiddle index step: e^(-2 pi i j / length) = twiddle[j * stride]
+    const uint32_t span   = length / 2;
+    for (uint32_t start = 0; start < half; start += length) {
+      for (uint32_t j = 0; j < span; j++) {
+        const float    wr = twiddleRe[j * stride];
+        const float    wi = twiddleIm[j * stride];
+        const uint32_t a  = start + j;
+        const uint32_t b  = a + span;
+        const float    tr = fftRe[b] * wr - fftIm[b] * wi;
+        const float    ti = fftRe[b] * wi + fftIm[b] * wr;
+        fftRe[b]          = fftRe[a] - tr;
+        fftIm[b]          = fftIm[a] - ti;
+        fftRe[a] += tr;
+        fftIm[a] += ti;
+      }
+    }
+  }
+}
+
+void MelSpectrogram::powerSpectrum() {
+  const uint32_t n = settings.nFft;
+
+  if (!powerOfTwo) {
+    for (uint32_t k = 0; k <= n / 2; k++) {
+      float    re = 0.0f, im = 0.0f;
+      uint32_t j  = 0;
+      for (uint32_t i = 0; i < n; i++) {
+        re += frameBuffer[i] * cosTable[j];
+        im -= frameBuffer[i] * sinTable[j];
+        j += k;
+        if (j >= n) {
+          j -= n;
+        }
+      }
+      power[k] = re * re + im * im;
+    }
+    return;
+  }
+
+  // Even samples as the real part and odd ones as the imaginary part of a half-size transform
+  const uint32_t half = n / 2;
+  for (uint32_t i = 0; i < half; i++) {
+    fftRe[bitReverse[i]] = frameBuffer[2 * i];
+    fftIm[bitReverse[i]] = frameBuffer[2 * i + 1];
+  }
+  complexFft();
+
+  // X[k] = E[k] + e^(-2 pi i k / n) O[k], with E and O split out of Z[k] and conj(Z[half - k])
+  power[0]    = (fftRe[0] + fftIm[0]) * (fftRe[0] + fftIm[0]);
+  power[half] = (fftRe[0] - fftIm[0]) * (fftRe[0] - fftIm[0]);
+  for (uint32_t k = 1; k < half; k++) {
+    const float zr  = fftRe[k], zi = fftIm[k];
+    const float cr  = fftRe[half - k], ci = -fftIm[half - k];
+    const float er  = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+    const float odr = 0.5f * (zi - ci), odi = -0.5f * (zr - cr);
+    const float xr  = er + twiddleRe[k] * odr - twiddleIm[k] * odi;
+    const float xi  = ei + twiddleRe[k] * odi + twiddleIm[k] * odr;
+    power[k]        = xr * xr + xi * xi;
+  }
+}
+
+void MelSpectrogram::computeFrame(const float *samples, float *out) {
+  const uint32_t n = settings.nFft;
+  for (uint32_t i = 0; i < n; i++) {
+    frameBuffer[i] = samples[i] * window[i];
+  }
+  powerSpectrum();
+
+  for (uint32_t m = 0; m < settings.nMels; m++) {
+    const float *weights = filterWeights.data() + filterOffset[m];
+    const float *bins    = power.data() + filterStart[m];
+    float        energy  = 0.0f;
+    for (uint32_t b = 0; b < filterLength[m]; b++) {
+      energy += weights[b] * bins[b];
+    }
+    out[m] = std::log(std::max(energy, settings.logFloor));
+  }
+}
+
+void MelSpectrogram::push(const float *samples, uint32_t count, const SyncStamp &stamp,
+                          const FramesCallback &onFrames) {
+  if (!samples || count == 0) {
+    return;
+  }
+  if (pending.empty()) {
+    pendingStamp = stamp;
+  }
+  pending.insert(pending.end(), samples, samples + count);
+
+  const uint32_t n = settings.nFft;
+  if (pending.size() < n) {
+    return;
+  }
+  const uint32_t frames = static_cast<uint32_t>((pending.size() - n) / settings.hop) + 1;
+  features.resize(static_cast<size_t>(frames) * settings.nMels);
+  for (uint32_t i = 0; i < frames; i++) {
+    computeFrame(pending.data() + static_cast<size_t>(i) * settings.hop, features.data() + i * settings.nMels);
+  }
+  onFrames(features.data(), frames, pendingStamp);
+
+  // The next frame starts frames * hop samples on
+  const uint32_t consumed = frames * settings.hop;
+  pending.erase(pending.begin(), pending.begin() + consumed);
+  if (pendingStamp.valid) {
+    pendingStamp.captureNs += static_cast<int64_t>(static_cast<double>(consumed) * 1e9 / settings.sampleRate);
+  }
+  if (pendingStamp.hasAudio) {
+    pendingStamp.audioPosition += consumed;
+  }
+}
+
+void MelSpectrogram::reset() {
+  pending.clear();
+  pendingStamp = SyncStamp();
+}
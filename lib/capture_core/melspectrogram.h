@@ -0,0 +1,145 @@
+/**
+ * @file melspectrogram.h
+ * @brief Streaming log-mel spectrogram for speech models
+ *
+ * Speech recognizers consume log-mel features rather than PCM: one vector of
+ * nMels values per hop (typically 80 bins every 10 ms). Computing them next
+ * to the capture keeps the heaviest loop out of JavaScript and shrinks what
+ * crosses to it. The features follow librosa's defaults, so models trained
+ * on librosa or Whisper front ends see the same numbers:
+ *
+ * - a periodic Hann window of winLength samples, centred in nFft;
+ * - the power spectrum of a real FFT (power-of-two nFft) or of a direct
+ *   transform over the one-sided bins (any other nFft);
+ * - a Slaney-scale triangular filterbank with Slaney area normalization;
+ * - the natural log, floored at logFloor.
+ *
+ * Frames are not centred: frame i covers samples [i * hop, i * hop + nFft)
+ * of the stream, so no future audio is padded in.
+ */
+#pragma once
+
+#include "avsync.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * @struct MelSpectrogramConfig
+ * @brief Feature extraction parameters
+ */
+struct MelSpectrogramConfig {
+  int32_t  sampleRate = 16000;
+  uint32_t nFft       = 512;    /**< Transform size in samples */
+  uint32_t winLength  = 400;    /**< Hann window length, at most nFft (0 = nFft) */
+  uint32_t hop        = 160;    /**< Samples between frames, 1 to nFft */
+  uint32_t nMels      = 80;     /**< Mel bins per frame */
+  float    fmin       = 0.0f;   /**< Lowest filter edge in Hz */
+  float    fmax       = 0.0f;   /**< Highest filter edge in Hz (0 = sampleRate / 2) */
+  float    logFloor   = 1e-10f; /**< Mel energies are clamped to this before the log */
+};
+
+/**
+ * @class MelSpectrogram
+ * @brief Turns a mono float stream into log-mel feature frames
+ *
+ * Used from one thread at a time.
+ */
+class MelSpectrogram {
+public:
+  /**
+   * @brief Receives the frames completed by one push(); valid only during the call
+   * @param features Row-major matrix, frames rows of nMels values
+   * @param frames Number of feature frames
+   * @param stamp Stamp of the first sample of the first frame
+   */
+  using FramesCallback = std::function<void(const float *features, uint32_t frames, const SyncStamp &stamp)>;
+
+  /**
+   * @brief Constructor; out-of-range values are clamped to the nearest valid ones
+   */
+  explicit MelSpectrogram(const MelSpectrogramConfig &config);
+
+  /**
+   * @brief Parameters in effect after clamping
+   */
+  const MelSpectrogramConfig &config() const {
+    return settings;
+  }
+
+  /**
+   * @brief Compute the features of one frame
+   * @param samples nFft samples
+   * @param out nMels log-mel values
+   */
+  void computeFrame(const float *samples, float *out);
+
+  /**
+   * @brief Append mono samples and pass on the frames they complete
+   * @param samples Mono samples
+   * @param count Number of samples
+   * @param stamp Stamp of the first sample
+   * @param onFrames Called once if at least one frame was completed
+   */
+  void push(const float *samples, uint32_t count, const SyncStamp &stamp, const FramesCallback &onFrames);
+
+  /**
+   * @brief Drop buffered samples; the next push() starts a new stream
+   */
+  void reset();
+
+  /**
+   * @brief Mel frequencies of the filter edges in Hz (nMels + 2 values)
+   */
+  const std::vector<double> &filterEdges() const {
+    return edges;
+  }
+
+  /** @name Slaney mel scale, linear below 1 kHz and logarithmic above */
+  ///@{
+  static double hzToMel(double hz);
+  static double melToHz(double mel);
+  ///@}
+
+private:
+  /** Power spectrum of frameBuffer into power, nFft / 2 + 1 bins */
+  void powerSpectrum();
+
+  /** Radix-2 FFT of fftRe/fftIm in place, size nFft / 2 */
+  void complexFft();
+
+  MelSpectrogramConfig settings;
+  bool                 powerOfTwo = false;
+
+  std::vector<float> window; /**< nFft values, zero outside the centred winLength */
+  std::vector<float> frameBuffer;
+  std::vector<float> power;
+
+  /** @name Real FFT as a complex FFT of half the size */
+  ///@{
+  std::vector<float>    fftRe, fftIm;
+  std::vector<float>    twiddleRe, twiddleIm; /**< e^(-2 pi i k / nFft), k < nFft / 2 */
+  std::vector<uint32_t> bitReverse;
+  ///@}
+
+  /** @name Direct transform for other sizes */
+  ///@{
+  std::vector<float> cosTable, sinTable; /**< cos and sin of 2 pi j / nFft */
+  ///@}
+
+  /** @name Sparse filterbank: filter m spans bins [filterStart[m], +filterLength[m]) */
+  ///@{
+  std::vector<double>   edges;
+  std::vector<uint32_t> filterStart;
+  std::vector<uint32_t> filterLength;
+  std::vector<uint32_t> filterOffset;
+  std::vector<float>    filterWeights;
+  ///@}
+
+  /** @name Streaming state */
+  ///@{
+  std::vector<float> pending;
+  SyncStamp          pendingStamp;
+  std::vector<float> features;
+  ///@}
+};
@@ -0,0 +1,414 @@
+/**
+ * @file multitargetpipeline.cc
+ * @brief Implementation of the shared-thread multi-target video pipeline
+ */
+#include "multitargetpipeline.h"
+#include "capturetrace.h"
+#include <algorithm>
+#include <string>
+
+MultiTargetPipeline::Target::Target(VideoFrameSource &source, VideoFrameEncoder &encoder, size_t queueDepth) :
+    source(source), encoder(encoder), readyQueue(queueDepth), freeQueue(readyQueue.capacity() + 2) {
+  // One frame in the capture stage, one in the encode stage, the rest queued
+  for (size_t i = 0; i < freeQueue.capacity(); i++) {
+    framePool.push_back(std::make_unique<VideoFrame>());
+    freeQueue.tryPush(framePool.back().get());
+  }
+}
+
+MultiTargetPipeline::MultiTargetPipeline(size_t encoderThreads, size_t queueDepth, size_t deliveryDepth) :
+    queueDepth(queueDepth > 0 ? queueDepth : 1),
+    requestedEncoderThreads(encoderThreads),
+    deliveryQueue(deliveryDepth > 0 ? deliveryDepth : 1) {}
+
+MultiTargetPipeline::~MultiTargetPipeline() {
+  stop();
+}
+
+size_t MultiTargetPipeline::addTarget(
+    VideoFrameSource &source, VideoFrameEncoder &encoder, std::shared_ptr<AdaptiveQualityController> controller) {
+  targets.push_back(std::make_unique<Target>(source, encoder, queueDepth));
+  targets.back()->controller = std::move(controller);
+  return targets.size() - 1;
+}
+
+size_t MultiTargetPipeline::encoderThreadCount() const {
+  if (requestedEncoderThreads > 0) {
+    return requestedEncoderThreads;
+  }
+  size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency() / 2);
+  return std::max<size_t>(1, std::min({targets.size(), hardware, kMaxDefaultEncoderThreads}));
+}
+
+bool MultiTargetPipeline::start(
+    float frameRate, MediaCaptureTargetDataCallback videoCallback, MediaCaptureExitCallback exitCallback,
+    void *context) {
+  if (running.load() || targets.empty()) {
+    return false;
+  }
+
+  setFrameRate(frameRate);
+
+  // Every worker holds at most one slot and the delivery thread one more, so a
+  // worker always finds a free slot even when the delivery queue is full
+  size_t workers = encoderThreadCount();
+  size_t slots   = deliveryQueue.capacity() + workers + 1;
+  if (deliveryPool.size() != slots) {
+    deliveryPool.clear();
+    deliveryFree = std::make_unique<BoundedFrameQueue<Delivery *>>(slots);
+    for (size_t i = 0; i < slots; i++) {
+      deliveryPool.push_back(std::make_unique<Delivery>());
+      deliveryFree->tryPush(deliveryPool.back().get());
+    }
+  }
+
+  this->videoCallback = videoCallback;
+  this->exitCallback  = exitCallback;
+  this->context       = context;
+
+  failed.store(false);
+  running.store(true);
+  deliveryThread = std::thread(&MultiTargetPipeline::deliveryThreadProc, this);
+  for (size_t i = 0; i < workers; i++) {
+    encodeThreads.emplace_back(&MultiTargetPipeline::encodeThreadProc, this);
+  }
+  captureThread = std::thread(&MultiTargetPipeline::captureThreadProc, this);
+
+  return true;
+}
+
+void MultiTargetPipeline::setFrameRate(float frameRate) {
+  if (frameRate <= 0) {
+    frameRate = 30.0f; // Default frame rate
+  }
+  for (auto &target : targets) {
+    target->frameIntervalUs.store(static_cast<int64_t>(1000000.0f / frameRate));
+  }
+}
+
+void MultiTargetPipeline::stop() {
+  running.store(false);
+
+  {
+    std::lock_guard<std::mutex> lock(scheduleMutex);
+  }
+  scheduleCV.notify_all();
+  {
+    std::lock_guard<std::mutex> lock(deliveryWakeMutex);
+  }
+  deliveryCV.notify_all();
+
+  if (captureThread.joinable()) {
+    captureThread.join();
+  }
+  for (std::thread &thread : encodeThreads) {
+    thread.join();
+  }
+  encodeThreads.clear();
+  if (deliveryThread.joinable()) {
+    deliveryThread.join();
+  }
+
+  // Return frames that were never encoded or delivered to their free lists
+  for (auto &target : targets) {
+    VideoFrame *frame = nullptr;
+    while (target->readyQueue.tryPop(frame)) {
+      target->freeQueue.tryPush(std::move(frame));
+    }
+    target->busy = false;
+  }
+  Delivery *delivery = nullptr;
+  while (deliveryQueue.tryPop(delivery)) {
+    deliveryFree->tryPush(std::move(delivery));
+  }
+}
+
+void MultiTargetPipeline::notify(std::mutex &mutex, std::condition_variable &cv) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+  cv.notify_one();
+}
+
+void MultiTargetPipeline::fail(const char *message) {
+  fatalError = message ? message : "";
+  failed.store(true);
+  notify(deliveryWakeMutex, deliveryCV);
+}
+
+/**
+ * Capture stage: serves the target whose next frame is due first. Targets that
+ * are due at the same time are served in turn.
+ */
+void MultiTargetPipeline::captureThreadProc() {
+  setTraceThreadName("video-capture");
+
+  const size_t count = targets.size();
+  int64_t      now   = monotonicNowNs();
+  for (auto &target : targets) {
+    target->nextDueNs = now;
+  }
+
+  size_t rotation = 0;
+  while (running.load() && !failed.load()) {
+    size_t next = rotation % count;
+    for (size_t k = 1; k < count; k++) {
+      size_t i = (rotation + k) % count;
+      if (targets[i]->nextDueNs < targets[next]->nextDueNs) {
+        next = i;
+      }
+    }
+    Target &target = *targets[next];
+
+    // Frame rate limiting; short sleeps keep stop() responsive at low rates
+    now = monotonicNowNs();
+    if (target.nextDueNs > now) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(std::min<int64_t>(target.nextDueNs - now, 50000000)));
+      continue;
+    }
+    rotation = next + 1;
+
+    int64_t intervalUs = target.frameIntervalUs.load();
+    target.nextDueNs   = now + intervalUs * 1000;
+
+    VideoFrame *frame = nullptr;
+    if (!target.freeQueue.tryPop(frame)) {
+      continue;
+    }
+
+    // A source that blocks waiting for a new frame must not hold up the other targets
+    int64_t  intervalMs = intervalUs / 1000;
+    uint32_t timeoutMs =
+        static_cast<uint32_t>(std::max<int64_t>(1, std::min<int64_t>(100, intervalMs) / static_cast<int64_t>(count)));
+
+    frame->copyNs              = 0;
+    int64_t       acquireStart = monotonicNowNs();
+    AcquireResult result       = target.source.acquireFrame(*frame, timeoutMs);
+    int64_t       acquireEnd   = monotonicNowNs();
+
+    if (result != AcquireResult::Frame) {
+      target.freeQueue.tryPush(std::move(frame));
+      if (result == AcquireResult::Error) {
+        target.acquireFailures.fetch_add(1, std::memory_order_relaxed);
+      } else if (result == AcquireResult::Fatal) {
+        fail(target.source.lastAcquireError());
+        break;
+      }
+      continue;
+    }
+
+    int64_t copyNs = std::min(frame->copyNs, acquireEnd - acquireStart);
+    acquireTiming.record(static_cast<uint64_t>(acquireEnd - acquireStart - copyNs));
+    if (copyNs > 0) {
+      copyTiming.record(static_cast<uint64_t>(copyNs));
+    }
+    frame->sequence    = nextSequence.fetch_add(1);
+    frame->acquiredNs  = acquireEnd;
+    frame->timestampMs = wallClockNowMs();
+    traceSpan("acquire", frame->sequence, acquireStart, acquireEnd);
+
+    VideoFrame *evicted = nullptr;
+    if (target.readyQueue.pushDropOldest(std::move(frame), evicted)) {
+      target.framesDropped.fetch_add(1, std::memory_order_relaxed);
+      target.freeQueue.tryPush(std::move(evicted));
+    }
+    target.framesCaptured.fetch_add(1, std::memory_order_relaxed);
+
+    notify(scheduleMutex, scheduleCV);
+  }
+}
+
+bool MultiTargetPipeline::claimFrame(size_t &index, VideoFrame *&frame) {
+  const size_t count = targets.size();
+  for (size_t k = 0; k < count; k++) {
+    size_t  i      = (scheduleCursor + k) % count;
+    Target &target = *targets[i];
+    if (!target.busy && target.readyQueue.tryPop(frame)) {
+      target.busy    = true;
+      scheduleCursor = (i + 1) % count;
+      index          = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Encode stage: one of the pool's workers. Encoded frames go to the shared
+ * delivery queue before the target is released, so each target's frames stay
+ * in capture order.
+ */
+void MultiTargetPipeline::encodeThreadProc() {
+  setTraceThreadName("video-encode");
+
+  while (running.load()) {
+    size_t      index = 0;
+    VideoFrame *frame = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(scheduleMutex);
+      if (!claimFrame(index, frame)) {
+        scheduleCV.wait_for(lock, std::chrono::milliseconds(100));
+        continue;
+      }
+    }
+    Target &target = *targets[index];
+
+    Delivery *slot = nullptr;
+    if (!deliveryFree->tryPop(slot)) {
+      // Cannot happen with the pool sized in start(); drop rather than block
+      target.framesDropped.fetch_add(1, std::memory_order_relaxed);
+      target.freeQueue.tryPush(std::move(frame));
+    } else {
+      int64_t encodeStart = monotonicNowNs();
+      queueWaitTiming.record(static_cast<uint64_t>(std::max<int64_t>(0, encodeStart - frame->acquiredNs)));
+
+      bool    encodedOk = target.encoder.encodeFrame(*frame, slot->encoded);
+      int64_t encodeEnd = monotonicNowNs();
+      slot->target      = index;
+      slot->timestampMs = frame->timestampMs;
+      slot->acquiredNs  = frame->acquiredNs;
+      slot->sequence    = frame->sequence;
+      slot->encodedNs   = encodeEnd;
+      traceSpan("encode", slot->sequence, encodeStart, encodeEnd);
+
+      // Hand the buffer back before delivery so capture can reuse it immediately
+      target.freeQueue.tryPush(std::move(frame));
+
+      if (!encodedOk) {
+        target.encodeFailures.fetch_add(1, std::memory_order_relaxed);
+        deliveryFree->tryPush(std::move(slot));
+      } else {
+        encodeTiming.record(static_cast<uint64_t>(encodeEnd - encodeStart));
+
+        if (target.controller) {
+          EncodeSample sample;
+          sample.encodeMs    = static_cast<double>(encodeEnd - encodeStart) / 1e6;
+          sample.bytes       = slot->encoded.data.size();
+          sample.queueDepth  = target.readyQueue.sizeApprox();
+          sample.timestampNs = encodeEnd;
+          if (target.controller->addSample(sample)) {
+            target.frameIntervalUs.store(
+                static_cast<int64_t>(1000000.0 / target.controller->settings().frameRate));
+          }
+        }
+
+        if (slot->encoded.data.empty()) {
+          target.framesEncoded.fetch_add(1, std::memory_order_relaxed);
+          deliveryFree->tryPush(std::move(slot));
+        } else {
+          // Workers push concurrently, and pushDropOldest expects a single producer
+          std::lock_guard<std::mutex> lock(deliveryPushMutex);
+          Delivery                   *evicted = nullptr;
+          if (deliveryQueue.pushDropOldest(std::move(slot), evicted)) {
+            targets[evicted->target]->framesDropped.fetch_add(1, std::memory_order_relaxed);
+            deliveryFree->tryPush(std::move(evicted));
+          }
+        }
+        notify(deliveryWakeMutex, deliveryCV);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(scheduleMutex);
+      target.busy = false;
+    }
+    scheduleCV.notify_one();
+  }
+}
+
+/**
+ * Delivery stage: every frame callback of every target comes from this thread
+ */
+void MultiTargetPipeline::deliveryThreadProc() {
+  setTraceThreadName("video-deliver");
+
+  while (running.load() && !failed.load()) {
+    Delivery *delivery = nullptr;
+    if (!deliveryQueue.tryPop(delivery)) {
+      std::unique_lock<std::mutex> lock(deliveryWakeMutex);
+      deliveryCV.wait_for(lock, std::chrono::milliseconds(100), [this] {
+        return deliveryQueue.sizeApprox() > 0 || !running.load() || failed.load();
+      });
+      continue;
+    }
+
+    Target             &target  = *targets[delivery->target];
+    const EncodedFrame &encoded = delivery->encoded;
+    if (videoCallback && running.load()) {
+      std::string timestampStr = std::to_string(delivery->timestampMs);
+      int64_t     deliverStart = monotonicNowNs();
+      setCurrentTraceSequence(delivery->sequence);
+      setCurrentSyncStamp(syncStampAt(syncClock.get(), delivery->acquiredNs));
+      videoCallback(
+          static_cast<int32_t>(delivery->target), const_cast<uint8_t *>(encoded.data.data()), encoded.width,
+          encoded.height, encoded.bytesPerRow, timestampStr.c_str(), encoded.format.c_str(), encoded.data.size(),
+          context);
+      setCurrentSyncStamp(SyncStamp());
+      setCurrentTraceSequence(kNoTraceSequence);
+      int64_t deliverEnd = monotonicNowNs();
+      deliverTiming.record(static_cast<uint64_t>(deliverEnd - deliverStart));
+      traceSpan("deliver", delivery->sequence, deliverStart, deliverEnd);
+      target.bytesDelivered.fetch_add(encoded.data.size(), std::memory_order_relaxed);
+    }
+    target.framesEncoded.fetch_add(1, std::memory_order_relaxed);
+
+    deliveryFree->tryPush(std::move(delivery));
+  }
+
+  // The exit callback may free the context, so it comes once and last; after stop() nobody is listening
+  if (failed.load() && running.load() && exitCallback) {
+    exitCallback(const_cast<char *>(fatalError.c_str()), context);
+  }
+}
+
+VideoPipelineStats MultiTargetPipeline::targetStats(size_t index) const {
+  VideoPipelineStats stats;
+  if (index >= targets.size()) {
+    return stats;
+  }
+  const Target &target = *targets[index];
+  stats.framesCaptured  = target.framesCaptured.load(std::memory_order_relaxed);
+  stats.framesEncoded   = target.framesEncoded.load(std::memory_order_relaxed);
+  stats.framesDropped   = target.framesDropped.load(std::memory_order_relaxed);
+  stats.encodeFailures  = target.encodeFailures.load(std::memory_order_relaxed);
+  stats.acquireFailures = target.acquireFailures.load(std::memory_order_relaxed);
+  stats.queueDepth      = target.readyQueue.sizeApprox();
+  stats.bytesDelivered  = target.bytesDelivered.load(std::memory_order_relaxed);
+  return stats;
+}
+
+VideoPipelineStats MultiTargetPipeline::stats() const {
+  VideoPipelineStats stats;
+  for (size_t i = 0; i < targets.size(); i++) {
+    VideoPipelineStats target = targetStats(i);
+    stats.framesCaptured += target.framesCaptured;
+    stats.framesEncoded += target.framesEncoded;
+    stats.framesDropped += target.framesDropped;
+    stats.encodeFailures += target.encodeFailures;
+    stats.acquireFailures += target.acquireFailures;
+    stats.queueDepth += target.queueDepth;
+    stats.bytesDelivered += target.bytesDelivered;
+  }
+  stats.acquire   = acquireTiming.snapshot();
+  stats.copy      = copyTiming.snapshot();
+  stats.queueWait = queueWaitTiming.snapshot();
+  stats.encode    = encodeTiming.snapshot();
+  stats.deliver   = deliverTiming.snapshot();
+  return stats;
+}
+
+void MultiTargetPipeline::resetStats() {
+  for (auto &target : targets) {
+    target->framesCaptured.store(0);
+    target->framesEncoded.store(0);
+    target->framesDropped.store(0);
+    target->encodeFailures.store(0);
+    target->acquireFailures.store(0);
+    target->bytesDelivered.store(0);
+  }
+  acquireTiming.reset();
+  copyTiming.reset();
+  queueWaitTiming.reset();
+  encodeTiming.reset();
+  deliverTiming.reset();
+}
@@ -0,0 +1,259 @@
+/**
+ * @file multitargetpipeline.h
+ * @brief Video capture of several targets sharing one set of threads
+ *
+ * Where VideoPipeline gives one target its own capture and encode threads, a
+ * MultiTargetPipeline runs any number of targets on:
+ *
+ * - one capture thread, which acquires from whichever target is due next, so
+ *   platform resources that are not thread-safe (a D3D immediate context, an
+ *   X connection) can be shared by the sources;
+ * - a pool of encoder threads. Each worker takes the next target with a
+ *   queued frame in round-robin order, so a target with an expensive encode
+ *   cannot starve the others. A target is encoded by one worker at a time,
+ *   which keeps its frames in order and its encoder single-threaded;
+ * - one delivery thread that invokes the frame callback, tagged with the
+ *   target index, from a single bounded queue.
+ *
+ * Each target keeps the drop-oldest queue of VideoPipeline, so a slow target
+ * only drops its own frames.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "adaptivequality.h"
+#include "capture/capture.h"
+#include "framequeue.h"
+#include "stagetiming.h"
+#include "videopipeline.h"
+
+/**
+ * @class MultiTargetPipeline
+ * @brief Runs several VideoFrameSource / VideoFrameEncoder pairs on shared threads
+ */
+class MultiTargetPipeline {
+public:
+  /** Default number of frames held per target between capture and encode */
+  static constexpr size_t kDefaultQueueDepth = 2;
+
+  /** Default number of encoded frames held for the delivery thread */
+  static constexpr size_t kDefaultDeliveryDepth = 8;
+
+  /** Upper bound of the default encoder pool size */
+  static constexpr size_t kMaxDefaultEncoderThreads = 4;
+
+  /**
+   * @brief Constructor
+   * @param encoderThreads Size of the encoder pool; 0 picks one per target, up to
+   *                       half the hardware threads and kMaxDefaultEncoderThreads
+   * @param queueDepth Number of frames held per target between the stages
+   * @param deliveryDepth Number of encoded frames waiting for the delivery thread
+   */
+  explicit MultiTargetPipeline(
+      size_t encoderThreads = 0, size_t queueDepth = kDefaultQueueDepth, size_t deliveryDepth = kDefaultDeliveryDepth);
+
+  /**
+   * @brief Destructor - stops the pipeline if it is running
+   */
+  ~MultiTargetPipeline();
+
+  MultiTargetPipeline(const MultiTargetPipeline &)            = delete;
+  MultiTargetPipeline &operator=(const MultiTargetPipeline &) = delete;
+
+  /**
+   * @brief Add a target; only allowed while the pipeline is stopped
+   * @param source Capture stage of the target; must outlive the pipeline
+   * @param encoder Encode stage of the target; must outlive the pipeline
+   * @param controller Optional adaptive quality controller fed with this target's encode cost
+   * @return Index of the target, passed to the frame callback
+   */
+  size_t addTarget(
+      VideoFrameSource &source, VideoFrameEncoder &encoder,
+      std::shared_ptr<AdaptiveQualityController> controller = nullptr);
+
+  /**
+   * @brief Number of targets added
+   */
+  size_t targetCount() const {
+    return targets.size();
+  }
+
+  /**
+   * @brief Number of encoder threads started by start()
+   */
+  size_t encoderThreadCount() const;
+
+  /**
+   * @brief Start the capture, encoder and delivery threads
+   * @param frameRate Target capture rate of every target (<= 0 selects 30)
+   * @param videoCallback Function called with each encoded frame and its target index
+   * @param exitCallback Function called at most once, after the last frame, when the source fails for good;
+   *                     the pipeline stops capturing then. Frames that fail to acquire or encode are only counted.
+   * @param context User data passed to callbacks
+   * @return true if started, false if already running or there are no targets
+   */
+  bool start(
+      float frameRate, MediaCaptureTargetDataCallback videoCallback, MediaCaptureExitCallback exitCallback,
+      void *context);
+
+  /**
+   * @brief Stop all threads and wait for them to exit
+   *
+   * Frames still queued are discarded.
+   */
+  void stop();
+
+  /**
+   * @brief Whether the pipeline threads are running
+   */
+  bool isRunning() const {
+    return running.load();
+  }
+
+  /**
+   * @brief Change the capture rate of every target while running; each target's next frame is paced by it
+   * @param frameRate Frames per second (<= 0 selects 30)
+   */
+  void setFrameRate(float frameRate);
+
+  /**
+   * @brief Stamp each delivered frame with the audio position of its acquisition time
+   *
+   * Must be called before start().
+   */
+  void setSyncClock(std::shared_ptr<AvSyncClock> clock) {
+    syncClock = std::move(clock);
+  }
+
+  /**
+   * @brief Counters and stage timings of all targets together
+   */
+  VideoPipelineStats stats() const;
+
+  /**
+   * @brief Counters of one target; stage timings are only kept for all targets together
+   */
+  VideoPipelineStats targetStats(size_t index) const;
+
+  /**
+   * @brief Reset counters and stage timings
+   */
+  void resetStats();
+
+private:
+  /** One source / encoder pair and its queues */
+  struct Target {
+    Target(VideoFrameSource &source, VideoFrameEncoder &encoder, size_t queueDepth);
+
+    VideoFrameSource                          &source;
+    VideoFrameEncoder                         &encoder;
+    std::shared_ptr<AdaptiveQualityController> controller;
+
+    std::vector<std::unique_ptr<VideoFrame>> framePool;
+    BoundedFrameQueue<VideoFrame *>          readyQueue;
+    BoundedFrameQueue<VideoFrame *>          freeQueue;
+
+    /** Interval between captures of this target in microseconds */
+    std::atomic<int64_t> frameIntervalUs{1000000};
+
+    /** Next capture time on the monotonicNowNs() clock (capture thread only) */
+    int64_t nextDueNs = 0;
+
+    /** Whether a worker is encoding this target (guarded by scheduleMutex) */
+    bool busy = false;
+
+    std::atomic<uint64_t> framesCaptured{0};
+    std::atomic<uint64_t> framesEncoded{0};
+    std::atomic<uint64_t> framesDropped{0};
+    std::atomic<uint64_t> encodeFailures{0};
+    std::atomic<uint64_t> acquireFailures{0};
+    std::atomic<uint64_t> bytesDelivered{0};
+  };
+
+  /** An encoded frame on its way to the delivery thread */
+  struct Delivery {
+    EncodedFrame encoded;
+    size_t       target      = 0;
+    int64_t      timestampMs = 0;
+    int64_t      acquiredNs  = 0;
+    int64_t      encodedNs   = 0;
+    uint64_t     sequence    = 0;
+  };
+
+  /** Capture thread: acquires from the target that is due next */
+  void captureThreadProc();
+
+  /** Encoder worker: encodes frames of whichever target the scheduler hands out */
+  void encodeThreadProc();
+
+  /** Delivery thread: invokes the frame callback in encode completion order */
+  void deliveryThreadProc();
+
+  /**
+   * @brief Claim the next target with a queued frame, round-robin (caller holds scheduleMutex)
+   * @return true if a frame was claimed; the target stays busy until release
+   */
+  bool claimFrame(size_t &target, VideoFrame *&frame);
+
+  /** Record a fatal source error and wake the delivery thread, which reports it */
+  void fail(const char *message);
+
+  /** Wake one waiter of a condition variable without losing the notification */
+  static void notify(std::mutex &mutex, std::condition_variable &cv);
+
+  const size_t queueDepth;
+  const size_t requestedEncoderThreads;
+
+  std::vector<std::unique_ptr<Target>> targets;
+
+  /** @name Encoder scheduling */
+  ///@{
+  std::mutex              scheduleMutex;
+  std::condition_variable scheduleCV;
+  size_t                  scheduleCursor = 0;
+  ///@}
+
+  /** @name Delivery queue */
+  ///@{
+  BoundedFrameQueue<Delivery *> deliveryQueue;
+  std::mutex                    deliveryPushMutex;
+  std::mutex                    deliveryWakeMutex;
+  std::condition_variable       deliveryCV;
+
+  /** Sized on the first start(), when the number of workers is known */
+  std::vector<std::unique_ptr<Delivery>>         deliveryPool;
+  std::unique_ptr<BoundedFrameQueue<Delivery *>> deliveryFree;
+  ///@}
+
+  std::atomic<bool>        running{false};
+  std::thread              captureThread;
+  std::vector<std::thread> encodeThreads;
+  std::thread              deliveryThread;
+
+  /** Set by the capture thread once the source has failed for good; fatalError is written before */
+  std::atomic<bool> failed{false};
+  std::string       fatalError;
+
+  /** Optional clock shared with the audio source */
+  std::shared_ptr<AvSyncClock> syncClock;
+
+  MediaCaptureTargetDataCallback videoCallback = nullptr;
+  MediaCaptureExitCallback       exitCallback  = nullptr;
+  void                          *context       = nullptr;
+
+  /** @name Statistics shared by all targets */
+  ///@{
+  std::atomic<uint64_t> nextSequence{1};
+  StageTiming           acquireTiming;
+  StageTiming           copyTiming;
+  StageTiming           queueWaitTiming;
+  StageTiming           encodeTiming;
+  StageTiming           deliverTiming;
+  ///@}
+};
@@ -0,0 +1,73 @@
+/**
+ * @file rawframe.cc
+ * @brief Implementation of the raw frame conversion helpers
+ */
+#include "rawframe.h"
+#include "colorconvert.h"
+#include "croprect.h"
+
+bool parseImageFormat(const std::string &name, ImageFormat &format) {
+  if (name == "jpeg") {
+    format = ImageFormat::Jpeg;
+  } else if (name == "bgra") {
+    format = ImageFormat::Bgra;
+  } else if (name == "i420") {
+    format = ImageFormat::I420;
+  } else if (name == "nv12") {
+    format = ImageFormat::NV12;
+  } else if (name == "delta") {
+    format = ImageFormat::Delta;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *imageFormatName(ImageFormat format) {
+  switch (format) {
+  case ImageFormat::Jpeg:
+    return "jpeg";
+  case ImageFormat::Bgra:
+    return "bgra";
+  case ImageFormat::I420:
+    return "i420";
+  case ImageFormat::NV12:
+    return "nv12";
+  case ImageFormat::Delta:
+    return "delta";
+  }
+  return "unknown";
+}
+
+bool packRawFrame(
+    FrameBufferPool &pool, ImageFormat format, const uint8_t *bgra, int32_t width, int32_t height, int32_t bytesPerRow,
+    RawFrame &out) {
+  if (!bgra || width <= 0 || height <= 0 || bytesPerRow < width * 4) {
+    return false;
+  }
+
+  out.width  = width;
+  out.height = height;
+
+  switch (format) {
+  case ImageFormat::Bgra:
+    out.bytesPerRow = width * 4;
+    out.buffer      = pool.acquire(static_cast<size_t>(out.bytesPerRow) * height);
+    copyFrameRegion(bgra, bytesPerRow, {0, 0, width, height}, 4, out.buffer->data(), out.bytesPerRow);
+    return true;
+  case ImageFormat::I420:
+    out.bytesPerRow = width;
+    out.buffer      = pool.acquire(yuv420FrameSize(width, height));
+    convertBGRAToI420(bgra, bytesPerRow, width, height, i420Planes(out.buffer->data(), width, height));
+    return true;
+  case ImageFormat::NV12:
+    out.bytesPerRow = width;
+    out.buffer      = pool.acquire(yuv420FrameSize(width, height));
+    convertBGRAToNV12(bgra, bytesPerRow, width, height, nv12Planes(out.buffer->data(), width, height));
+    return true;
+  case ImageFormat::Jpeg:
+  case ImageFormat::Delta:
+    break;
+  }
+  return false;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file rawframe.h
+ * @brief Conversion of captured BGRA frames into the public raw formats
+ *
+ * Backends deliver uncompressed frames as BGRA (imageFormat = 1 in
+ * MediaCaptureConfigC). The addon converts them into the format requested from
+ * JavaScript, writing straight into a pooled buffer.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "bufferpool.h"
+
+/**
+ * @enum ImageFormat
+ * @brief Video frame formats exposed to JavaScript
+ */
+enum class ImageFormat : int32_t {
+  Jpeg  = 0, /**< JPEG encoded by the backend */
+  Bgra  = 1, /**< Packed 8-bit BGRA, rows of width * 4 bytes */
+  I420  = 2, /**< Planar Y, U, V (4:2:0) */
+  NV12  = 3, /**< Planar Y followed by interleaved UV (4:2:0) */
+  Delta = 4  /**< Keyframes and changed-region JPEG patches (see deltaframe.h) */
+};
+
+/**
+ * @brief Parse a format name ("jpeg", "bgra", "i420", "nv12", "delta")
+ * @return false if the name is unknown
+ */
+bool parseImageFormat(const std::string &name, ImageFormat &format);
+
+/**
+ * @brief Lower-case name of a format as used in the JavaScript API
+ */
+const char *imageFormatName(ImageFormat format);
+
+/**
+ * @struct RawFrame
+ * @brief A converted frame held in a pooled buffer
+ */
+struct RawFrame {
+  FrameBufferPool::Buffer buffer;          /**< Frame bytes, tightly packed */
+  int32_t                 width       = 0; /**< Width in pixels */
+  int32_t                 height      = 0; /**< Height in pixels */
+  int32_t                 bytesPerRow = 0; /**< Row stride of the first plane */
+};
+
+/**
+ * @brief Convert a BGRA frame into a raw output format
+ * @param pool Pool providing the destination buffer
+ * @param format Bgra, I420 or NV12
+ * @param bgra First byte of the source frame
+ * @param width Width in pixels
+ * @param height Height in pixels
+ * @param bytesPerRow Source row stride in bytes
+ * @param out Receives the converted frame
+ * @return false if the format is not a raw format or the input is invalid
+ */
+bool packRawFrame(
+    FrameBufferPool &pool, ImageFormat format, const uint8_t *bgra, int32_t width, int32_t height, int32_t bytesPerRow,
+    RawFrame &out);
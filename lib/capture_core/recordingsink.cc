@@ -0,0 +1,463 @@
+/**
+ * @file recordingsink.cc
+ * @brief Implementation of the native recording writer
+ */
+#include "recordingsink.h"
+#include "capturetrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <new>
+
+namespace {
+
+/** Size of the canonical WAV header written in front of the samples */
+constexpr size_t kWavHeaderBytes = 44;
+
+/** RIFF sizes are 32-bit, so a WAV segment is rotated before it reaches 4 GiB */
+constexpr uint64_t kMaxWavBytes = 0xffffffffull - kWavHeaderBytes;
+
+/** Number of idle chunk buffers kept for reuse */
+constexpr size_t kRetainedChunks = 16;
+
+void putLE16(uint8_t *out, uint16_t value) {
+  out[0] = static_cast<uint8_t>(value);
+  out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void putLE32(uint8_t *out, uint32_t value) {
+  putLE16(out, static_cast<uint16_t>(value));
+  putLE16(out + 2, static_cast<uint16_t>(value >> 16));
+}
+
+/** Header of a 32-bit IEEE float WAV file holding dataBytes of samples */
+void makeWavHeader(uint8_t *header, int32_t channels, int32_t sampleRate, uint64_t dataBytes) {
+  uint32_t data = static_cast<uint32_t>(std::min<uint64_t>(dataBytes, kMaxWavBytes));
+  std::memcpy(header, "RIFF", 4);
+  putLE32(header + 4, data + 36);
+  std::memcpy(header + 8, "WAVEfmt ", 8);
+  putLE32(header + 16, 16);
+  putLE16(header + 20, 3); // WAVE_FORMAT_IEEE_FLOAT
+  putLE16(header + 22, static_cast<uint16_t>(channels));
+  putLE32(header + 24, static_cast<uint32_t>(sampleRate));
+  putLE32(header + 28, static_cast<uint32_t>(sampleRate * channels * 4));
+  putLE16(header + 32, static_cast<uint16_t>(channels * 4));
+  putLE16(header + 34, 32);
+  std::memcpy(header + 36, "data", 4);
+  putLE32(header + 40, data);
+}
+
+} // namespace
+
+/**
+ * @class SegmentFile
+ * @brief One output file written through an aligned staging block
+ *
+ * Used only by the writer thread. The stdio stream is unbuffered, so every
+ * fwrite() is one whole staging block going straight to the OS.
+ */
+class SegmentFile {
+public:
+  explicit SegmentFile(std::atomic<uint64_t> &bytesWritten) : bytesWritten(bytesWritten) {}
+
+  ~SegmentFile() {
+    close();
+  }
+
+  bool open(const std::string &path) {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+      return false;
+    }
+    std::setvbuf(file, nullptr, _IONBF, 0);
+    if (!block) {
+      block.reset(static_cast<uint8_t *>(
+          ::operator new(RecordingSink::kWriteBlockBytes, std::align_val_t(RecordingSink::kBlockAlignment))));
+    }
+    used  = 0;
+    bytes = 0;
+    return true;
+  }
+
+  bool isOpen() const {
+    return file != nullptr;
+  }
+
+  /** Bytes appended so far, including those still staged */
+  uint64_t size() const {
+    return bytes;
+  }
+
+  bool append(const void *data, size_t size) {
+    const uint8_t *source = static_cast<const uint8_t *>(data);
+    bytes += size;
+    while (size > 0) {
+      size_t room = RecordingSink::kWriteBlockBytes - used;
+      size_t part = std::min(room, size);
+      std::memcpy(block.get() + used, source, part);
+      used += part;
+      source += part;
+      size -= part;
+      if (used == RecordingSink::kWriteBlockBytes && !flush()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /** Overwrite bytes that were already written, e.g. a header whose sizes are known only at the end */
+  bool patch(long offset, const void *data, size_t size) {
+    if (!flush() || std::fseek(file, offset, SEEK_SET) != 0) {
+      return false;
+    }
+    bool ok = std::fwrite(data, 1, size, file) == size;
+    return std::fseek(file, 0, SEEK_END) == 0 && ok;
+  }
+
+  bool close() {
+    if (!file) {
+      return true;
+    }
+    bool ok = flush();
+    ok      = std::fclose(file) == 0 && ok;
+    file    = nullptr;
+    return ok;
+  }
+
+private:
+  struct AlignedDelete {
+    void operator()(uint8_t *pointer) const {
+      ::operator delete(pointer, std::align_val_t(RecordingSink::kBlockAlignment));
+    }
+  };
+
+  bool flush() {
+    if (used == 0) {
+      return true;
+    }
+    bool ok = std::fwrite(block.get(), 1, used, file) == used;
+    if (ok) {
+      bytesWritten.fetch_add(used, std::memory_order_relaxed);
+    }
+    used = 0;
+    return ok;
+  }
+
+  std::atomic<uint64_t>                  &bytesWritten;
+  std::FILE                              *file = nullptr;
+  std::unique_ptr<uint8_t, AlignedDelete> block;
+  size_t                                  used  = 0;
+  uint64_t                                bytes = 0;
+};
+
+bool parseRecordingAudioFormat(const std::string &name, RecordingAudioFormat &format) {
+  if (name == "wav") {
+    format = RecordingAudioFormat::Wav;
+  } else if (name == "raw") {
+    format = RecordingAudioFormat::Raw;
+  } else if (name == "none") {
+    format = RecordingAudioFormat::None;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool parseRecordingVideoFormat(const std::string &name, RecordingVideoFormat &format) {
+  if (name == "mjpeg") {
+    format = RecordingVideoFormat::Mjpeg;
+  } else if (name == "frames") {
+    format = RecordingVideoFormat::Frames;
+  } else if (name == "none") {
+    format = RecordingVideoFormat::None;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+RecordingSink::RecordingSink(const RecordingOptions &options) :
+    options(options),
+    pool(FrameBufferPool::create(kRetainedChunks)),
+    queue(options.queueDepth > 0 ? options.queueDepth : 1),
+    audioFile(std::make_unique<SegmentFile>(bytesWritten)),
+    videoFile(std::make_unique<SegmentFile>(bytesWritten)),
+    videoIndex(std::make_unique<SegmentFile>(bytesWritten)) {}
+
+RecordingSink::~RecordingSink() {
+  std::string error;
+  close(error);
+}
+
+bool RecordingSink::open(std::string &error) {
+  if (running.load()) {
+    error = "Recording is already running";
+    return false;
+  }
+  if (options.dir.empty()) {
+    error = "Recording needs a directory";
+    return false;
+  }
+  if (options.audio == RecordingAudioFormat::None && options.video == RecordingVideoFormat::None) {
+    error = "Recording needs an audio or a video format";
+    return false;
+  }
+
+  std::error_code       code;
+  std::filesystem::path dir(options.dir);
+  if (options.video == RecordingVideoFormat::Frames) {
+    std::filesystem::create_directories(dir / "frames", code);
+  } else {
+    std::filesystem::create_directories(dir, code);
+  }
+  if (code) {
+    error = "Cannot create recording directory " + options.dir + ": " + code.message();
+    return false;
+  }
+
+  running.store(true);
+  writerThread = std::thread(&RecordingSink::writerThreadProc, this);
+  accepting.store(true);
+  return true;
+}
+
+void RecordingSink::writeVideo(
+    const uint8_t *data, size_t size, int32_t width, int32_t height, bool jpeg, int64_t timestampMs) {
+  if (options.video == RecordingVideoFormat::None || !accepting.load(std::memory_order_relaxed) || size == 0) {
+    return;
+  }
+  Chunk chunk;
+  chunk.data = pool->acquire(size);
+  std::memcpy(chunk.data->data(), data, size);
+  chunk.video       = true;
+  chunk.jpeg        = jpeg;
+  chunk.width       = width;
+  chunk.height      = height;
+  chunk.timestampMs = timestampMs;
+  enqueue(std::move(chunk));
+}
+
+void RecordingSink::writeAudio(const float *samples, int32_t frameCount, int32_t channels, int32_t sampleRate) {
+  if (options.audio == RecordingAudioFormat::None || !accepting.load(std::memory_order_relaxed) || frameCount <= 0 ||
+      channels <= 0 || sampleRate <= 0) {
+    return;
+  }
+  size_t size = static_cast<size_t>(frameCount) * static_cast<size_t>(channels) * sizeof(float);
+  Chunk  chunk;
+  chunk.data = pool->acquire(size);
+  std::memcpy(chunk.data->data(), samples, size);
+  chunk.channels   = channels;
+  chunk.sampleRate = sampleRate;
+  enqueue(std::move(chunk));
+}
+
+void RecordingSink::enqueue(Chunk &&chunk) {
+  if (!queue.tryPush(std::move(chunk))) {
+    droppedChunks.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // Notified without the lock; the writer's timeout bounds a missed wakeup
+  wakeCV.notify_one();
+}
+
+bool RecordingSink::close(std::string &error) {
+  accepting.store(false);
+  if (running.exchange(false)) {
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wakeCV.notify_all();
+  }
+  if (writerThread.joinable()) {
+    writerThread.join();
+  }
+
+  std::lock_guard<std::mutex> lock(errorMutex);
+  error = firstError;
+  return firstError.empty();
+}
+
+RecordingStats RecordingSink::stats() const {
+  RecordingStats stats;
+  stats.videoFrames   = videoFrames.load(std::memory_order_relaxed);
+  stats.audioFrames   = audioFrames.load(std::memory_order_relaxed);
+  stats.bytesWritten  = bytesWritten.load(std::memory_order_relaxed);
+  stats.droppedChunks = droppedChunks.load(std::memory_order_relaxed);
+  stats.segments      = segments.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void RecordingSink::writerThreadProc() {
+  setTraceThreadName("recording-writer");
+
+  // Drain everything queued before stopping, so close() loses nothing that was accepted
+  for (;;) {
+    Chunk chunk;
+    if (queue.tryPop(chunk)) {
+      TraceScope span(chunk.video ? "record-video" : "record-audio");
+      if (chunk.video) {
+        writeVideoChunk(chunk);
+      } else {
+        writeAudioChunk(chunk);
+      }
+      continue;
+    }
+    if (!running.load()) {
+      break;
+    }
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeCV.wait_for(lock, std::chrono::milliseconds(50), [this] {
+      return queue.sizeApprox() > 0 || !running.load();
+    });
+  }
+
+  closeAudioSegment();
+  closeVideoSegment();
+}
+
+bool RecordingSink::openSegment(SegmentFile &file, const char *prefix, uint32_t index, const char *extension) {
+  char name[64];
+  snprintf(name, sizeof(name), "%s-%04u.%s", prefix, index, extension);
+  std::string path = (std::filesystem::path(options.dir) / name).string();
+  if (!file.open(path)) {
+    fail("Cannot create " + path);
+    return false;
+  }
+  return true;
+}
+
+void RecordingSink::writeAudioChunk(const Chunk &chunk) {
+  const bool   wav        = options.audio == RecordingAudioFormat::Wav;
+  const size_t size       = chunk.data->size();
+  const size_t frameBytes = static_cast<size_t>(chunk.channels) * sizeof(float);
+
+  if (audioFile->isOpen()) {
+    uint64_t header  = wav ? kWavHeaderBytes : 0;
+    bool     changed = chunk.channels != audioChannels || chunk.sampleRate != audioSampleRate;
+    bool     full    = options.segmentBytes > 0 && audioFile->size() > header &&
+                    audioFile->size() + size > options.segmentBytes;
+    bool longEnough = options.segmentSeconds > 0 &&
+                      audioSegmentFrames >= static_cast<uint64_t>(options.segmentSeconds * audioSampleRate);
+    if (changed || full || longEnough || (wav && audioFile->size() + size > kMaxWavBytes)) {
+      closeAudioSegment();
+    }
+  }
+
+  if (!audioFile->isOpen()) {
+    audioSegment++;
+    if (!openSegment(*audioFile, "audio", audioSegment, wav ? "wav" : "f32")) {
+      return;
+    }
+    segments.fetch_add(1, std::memory_order_relaxed);
+    audioChannels      = chunk.channels;
+    audioSampleRate    = chunk.sampleRate;
+    audioSegmentFrames = 0;
+    if (wav) {
+      // Sizes are filled in when the segment is closed
+      uint8_t header[kWavHeaderBytes];
+      makeWavHeader(header, audioChannels, audioSampleRate, 0);
+      audioFile->append(header, sizeof(header));
+    }
+  }
+
+  if (!audioFile->append(chunk.data->data(), size)) {
+    fail("Failed to write audio segment " + std::to_string(audioSegment));
+    return;
+  }
+  audioSegmentFrames += size / frameBytes;
+  audioFrames.fetch_add(size / frameBytes, std::memory_order_relaxed);
+}
+
+void RecordingSink::closeAudioSegment() {
+  if (!audioFile->isOpen()) {
+    return;
+  }
+  bool ok = true;
+  if (options.audio == RecordingAudioFormat::Wav) {
+    uint8_t header[kWavHeaderBytes];
+    makeWavHeader(header, audioChannels, audioSampleRate, audioFile->size() - kWavHeaderBytes);
+    ok = audioFile->patch(0, header, sizeof(header));
+  }
+  if (!audioFile->close() || !ok) {
+    fail("Failed to finish audio segment " + std::to_string(audioSegment));
+  }
+}
+
+void RecordingSink::writeVideoChunk(const Chunk &chunk) {
+  const size_t size = chunk.data->size();
+
+  if (options.video == RecordingVideoFormat::Frames) {
+    char name[64];
+    snprintf(name, sizeof(name), "%09llu.%s", static_cast<unsigned long long>(++frameNumber),
+             chunk.jpeg ? "jpg" : "bgra");
+    std::string path = (std::filesystem::path(options.dir) / "frames" / name).string();
+    std::FILE  *file = std::fopen(path.c_str(), "wb");
+    bool        ok   = file && std::fwrite(chunk.data->data(), 1, size, file) == size;
+    ok               = file && std::fclose(file) == 0 && ok;
+    if (!ok) {
+      fail("Failed to write " + path);
+      return;
+    }
+    bytesWritten.fetch_add(size, std::memory_order_relaxed);
+    videoFrames.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  if (!chunk.jpeg) {
+    fail("MJPEG recording needs JPEG frames");
+    return;
+  }
+
+  if (videoFile->isOpen()) {
+    bool full = options.segmentBytes > 0 && videoFile->size() > 0 && videoFile->size() + size > options.segmentBytes;
+    bool longEnough = options.segmentSeconds > 0 &&
+                      chunk.timestampMs - videoSegmentStartMs >= static_cast<int64_t>(options.segmentSeconds * 1000);
+    if (full || longEnough) {
+      closeVideoSegment();
+    }
+  }
+
+  if (!videoFile->isOpen()) {
+    videoSegment++;
+    if (!openSegment(*videoFile, "video", videoSegment, "mjpeg") ||
+        !openSegment(*videoIndex, "video", videoSegment, "csv")) {
+      videoFile->close();
+      return;
+    }
+    segments.fetch_add(1, std::memory_order_relaxed);
+    videoSegmentStartMs = chunk.timestampMs;
+    static const char kIndexHeader[] = "offset,size,width,height,timestampMs\n";
+    videoIndex->append(kIndexHeader, sizeof(kIndexHeader) - 1);
+  }
+
+  char line[128];
+  int  length = snprintf(line, sizeof(line), "%llu,%zu,%d,%d,%lld\n",
+                         static_cast<unsigned long long>(videoFile->size()), size, chunk.width, chunk.height,
+                         static_cast<long long>(chunk.timestampMs));
+  if (!videoFile->append(chunk.data->data(), size) || !videoIndex->append(line, static_cast<size_t>(length))) {
+    fail("Failed to write video segment " + std::to_string(videoSegment));
+    return;
+  }
+  videoFrames.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RecordingSink::closeVideoSegment() {
+  if (!videoFile->isOpen()) {
+    return;
+  }
+  bool ok = videoFile->close();
+  ok      = videoIndex->close() && ok;
+  if (!ok) {
+    fail("Failed to finish video segment " + std::to_string(videoSegment));
+  }
+}
+
+void RecordingSink::fail(const std::string &message) {
+  std::lock_guard<std::mutex> lock(errorMutex);
+  if (firstError.empty()) {
+    firstError = message;
+    fprintf(stderr, "RecordingSink: %s\n", message.c_str());
+  }
+}
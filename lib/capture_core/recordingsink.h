@@ -0,0 +1,196 @@
+/**
+ * @file recordingsink.h
+ * @brief Writes captured audio and video to disk without going through JavaScript
+ *
+ * The capture threads only copy each frame or audio packet into a pooled
+ * buffer and push it onto a lock-free queue; a dedicated writer thread owns
+ * every file. It stages output in kWriteBlockBytes buffers aligned to
+ * kBlockAlignment and hands the OS whole blocks, so a recording costs a
+ * handful of large writes per second no matter how small the packets are.
+ * When the disk falls behind for longer than the queue covers, chunks are
+ * dropped and counted rather than stalling capture.
+ *
+ * Layout of the recording directory:
+ *  - audio-0001.wav / audio-0001.f32: interleaved 32-bit float, WAV or headerless
+ *  - video-0001.mjpeg: concatenated JPEG frames (ffmpeg -f mjpeg), with
+ *    video-0001.csv listing offset, size, width, height and timestamp per frame
+ *  - frames/000000001.jpg (or .bgra): one file per frame
+ * Segments rotate when they reach segmentBytes or span segmentSeconds of media.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "bufferpool.h"
+#include "framequeue.h"
+
+/**
+ * @enum RecordingAudioFormat
+ * @brief Container of the audio track
+ */
+enum class RecordingAudioFormat { None, Wav, Raw };
+
+/**
+ * @enum RecordingVideoFormat
+ * @brief Container of the video track
+ */
+enum class RecordingVideoFormat { None, Mjpeg, Frames };
+
+/**
+ * @struct RecordingOptions
+ * @brief Where and how to record
+ */
+struct RecordingOptions {
+  std::string          dir;                                         /**< Created if it does not exist */
+  RecordingAudioFormat audio          = RecordingAudioFormat::None; /**< Audio container */
+  RecordingVideoFormat video          = RecordingVideoFormat::None; /**< Video container */
+  uint64_t             segmentBytes   = 0;                          /**< Rotate at this size; 0 = no limit */
+  double               segmentSeconds = 0;                          /**< Rotate after this much media; 0 = no limit */
+  size_t               queueDepth     = 256;                        /**< Chunks that may wait for the writer */
+};
+
+/**
+ * @struct RecordingStats
+ * @brief Progress of a recording
+ */
+struct RecordingStats {
+  uint64_t videoFrames   = 0; /**< Frames written */
+  uint64_t audioFrames   = 0; /**< Sample frames written */
+  uint64_t bytesWritten  = 0; /**< Bytes handed to the OS */
+  uint64_t droppedChunks = 0; /**< Frames and packets dropped because the writer fell behind */
+  uint64_t segments      = 0; /**< Segment files opened */
+};
+
+/**
+ * @brief Parse "wav", "raw" or "none"
+ * @return false if the name is not recognized
+ */
+bool parseRecordingAudioFormat(const std::string &name, RecordingAudioFormat &format);
+
+/**
+ * @brief Parse "mjpeg", "frames" or "none"
+ * @return false if the name is not recognized
+ */
+bool parseRecordingVideoFormat(const std::string &name, RecordingVideoFormat &format);
+
+class SegmentFile;
+
+/**
+ * @class RecordingSink
+ * @brief Asynchronous audio and video file writer
+ *
+ * writeVideo() and writeAudio() may be called from any thread, including
+ * concurrently; open() and close() from one controlling thread.
+ */
+class RecordingSink {
+public:
+  /** Size of each write handed to the OS */
+  static constexpr size_t kWriteBlockBytes = 1 << 20;
+
+  /** Alignment of the staging blocks */
+  static constexpr size_t kBlockAlignment = 4096;
+
+  explicit RecordingSink(const RecordingOptions &options);
+
+  /**
+   * @brief Destructor - closes the recording if it is open
+   */
+  ~RecordingSink();
+
+  RecordingSink(const RecordingSink &)            = delete;
+  RecordingSink &operator=(const RecordingSink &) = delete;
+
+  /**
+   * @brief Create the directory and start the writer thread
+   * @param error Receives a description on failure
+   */
+  bool open(std::string &error);
+
+  /**
+   * @brief Queue an encoded video frame
+   * @param data Frame bytes, copied before returning
+   * @param size Number of bytes
+   * @param width Frame width
+   * @param height Frame height
+   * @param jpeg true for JPEG data, false for raw BGRA
+   * @param timestampMs Capture time in milliseconds since the Unix epoch
+   */
+  void writeVideo(const uint8_t *data, size_t size, int32_t width, int32_t height, bool jpeg, int64_t timestampMs);
+
+  /**
+   * @brief Queue interleaved float audio
+   * @param samples Samples, copied before returning
+   * @param frameCount Number of sample frames
+   * @param channels Channels per frame
+   * @param sampleRate Sample rate in Hz
+   */
+  void writeAudio(const float *samples, int32_t frameCount, int32_t channels, int32_t sampleRate);
+
+  /**
+   * @brief Write everything still queued, finalize the files and stop the writer
+   * @param error Receives the first write error, if any occurred during the recording
+   * @return false if any data could not be written
+   */
+  bool close(std::string &error);
+
+  RecordingStats stats() const;
+
+private:
+  struct Chunk {
+    FrameBufferPool::Buffer data;
+    bool                    video       = false;
+    bool                    jpeg        = false;
+    int32_t                 width       = 0;
+    int32_t                 height      = 0;
+    int32_t                 channels    = 0;
+    int32_t                 sampleRate  = 0;
+    int64_t                 timestampMs = 0;
+  };
+
+  void enqueue(Chunk &&chunk);
+  void writerThreadProc();
+  void writeAudioChunk(const Chunk &chunk);
+  void writeVideoChunk(const Chunk &chunk);
+  void closeAudioSegment();
+  void closeVideoSegment();
+  bool openSegment(SegmentFile &file, const char *prefix, uint32_t index, const char *extension);
+  void fail(const std::string &message);
+
+  const RecordingOptions           options;
+  std::shared_ptr<FrameBufferPool> pool;
+  BoundedFrameQueue<Chunk>         queue;
+
+  std::atomic<bool>       accepting{false};
+  std::atomic<bool>       running{false};
+  std::thread             writerThread;
+  std::mutex              wakeMutex;
+  std::condition_variable wakeCV;
+
+  /** @name Writer thread state */
+  ///@{
+  std::unique_ptr<SegmentFile> audioFile;
+  std::unique_ptr<SegmentFile> videoFile;
+  std::unique_ptr<SegmentFile> videoIndex;
+  uint32_t                     audioSegment        = 0;
+  uint32_t                     videoSegment        = 0;
+  int32_t                      audioChannels       = 0;
+  int32_t                      audioSampleRate     = 0;
+  uint64_t                     audioSegmentFrames  = 0;
+  int64_t                      videoSegmentStartMs = 0;
+  uint64_t                     frameNumber         = 0;
+  ///@}
+
+  std::atomic<uint64_t> videoFrames{0};
+  std::atomic<uint64_t> audioFrames{0};
+  std::atomic<uint64_t> bytesWritten{0};
+  std::atomic<uint64_t> droppedChunks{0};
+  std::atomic<uint64_t> segments{0};
+
+  mutable std::mutex errorMutex;
+  std::string        firstError;
+};
@@ -0,0 +1,460 @@
+/**
+ * @file renditionpipeline.cc
+ * @brief Implementation of the shared-acquisition multi-rendition video pipeline
+ */
+#include "renditionpipeline.h"
+#include "capturetrace.h"
+#include "framescale.h"
+#include "jpegcodec.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+void RenditionEncoder::outputSize(
+    const VideoRendition &rendition, int32_t width, int32_t height, int32_t &outWidth, int32_t &outHeight) {
+  double scale = rendition.scale > 0 && rendition.scale < 1.0 ? rendition.scale : 1.0;
+  if (rendition.maxWidth > 0 && width * scale > rendition.maxWidth) {
+    scale = static_cast<double>(rendition.maxWidth) / width;
+  }
+  outWidth  = scale < 1.0 ? scaledDimension(width, scale) : width;
+  outHeight = scale < 1.0 ? scaledDimension(height, scale) : height;
+}
+
+bool RenditionEncoder::encodeFrame(const VideoFrame &frame, EncodedFrame &out) {
+  const uint8_t *pixels = frame.pixels.data();
+  outputSize(rendition, frame.width, frame.height, out.width, out.height);
+  out.bytesPerRow = frame.bytesPerRow;
+
+  if (out.width != frame.width || out.height != frame.height) {
+    out.bytesPerRow = out.width * 4;
+    scaledPixels.resize(static_cast<size_t>(out.bytesPerRow) * out.height);
+    downscaleBGRA(pixels, frame.bytesPerRow, frame.width, frame.height, scaledPixels.data(), out.bytesPerRow,
+                  out.width, out.height);
+    pixels = scaledPixels.data();
+  }
+
+  // Raw output skips JPEG entirely; the addon converts BGRA to the requested layout
+  if (rendition.imageFormat == 1) {
+    out.data.assign(pixels, pixels + static_cast<size_t>(out.bytesPerRow) * out.height);
+    out.format = "bgra";
+    return true;
+  }
+
+  int32_t quality = std::min(100, std::max(1, rendition.quality));
+  if (!encodeJPEG(pixels, out.width, out.height, out.bytesPerRow, quality, out.data)) {
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "Failed to encode %dx%d frame to JPEG", out.width, out.height);
+    return false;
+  }
+  out.format = "jpeg";
+  return true;
+}
+
+RenditionPipeline::RenditionPipeline(
+    VideoFrameSource &source, size_t encoderThreads, size_t queueDepth, size_t deliveryDepth) :
+    source(source),
+    queueDepth(queueDepth > 0 ? queueDepth : 1),
+    requestedEncoderThreads(encoderThreads),
+    deliveryQueue(deliveryDepth > 0 ? deliveryDepth : 1) {}
+
+RenditionPipeline::~RenditionPipeline() {
+  stop();
+}
+
+size_t RenditionPipeline::addRendition(VideoFrameEncoder &encoder, float frameRate) {
+  if (frameRate <= 0) {
+    frameRate = 30.0f; // Default frame rate
+  }
+  renditions.push_back(std::make_unique<Rendition>(encoder, queueDepth));
+  renditions.back()->frameIntervalUs = static_cast<int64_t>(1000000.0f / frameRate);
+  return renditions.size() - 1;
+}
+
+size_t RenditionPipeline::encoderThreadCount() const {
+  if (requestedEncoderThreads > 0) {
+    return requestedEncoderThreads;
+  }
+  size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency() / 2);
+  return std::max<size_t>(1, std::min({renditions.size(), hardware, kMaxDefaultEncoderThreads}));
+}
+
+bool RenditionPipeline::start(
+    MediaCaptureTargetDataCallback videoCallback, MediaCaptureExitCallback exitCallback, void *context) {
+  if (running.load() || renditions.empty()) {
+    return false;
+  }
+
+  // Every rendition holds at most queueDepth queued frames and one being
+  // encoded, so the capture stage always finds a free frame
+  size_t frames = renditions.size() * (queueDepth + 1) + 1;
+  if (framePool.size() != frames) {
+    framePool.clear();
+    freeQueue = std::make_unique<BoundedFrameQueue<SharedFrame *>>(frames);
+    for (size_t i = 0; i < frames; i++) {
+      framePool.push_back(std::make_unique<SharedFrame>());
+      freeQueue->tryPush(framePool.back().get());
+    }
+  }
+
+  // Every worker holds at most one slot and the delivery thread one more
+  size_t workers = encoderThreadCount();
+  size_t slots   = deliveryQueue.capacity() + workers + 1;
+  if (deliveryPool.size() != slots) {
+    deliveryPool.clear();
+    deliveryFree = std::make_unique<BoundedFrameQueue<Delivery *>>(slots);
+    for (size_t i = 0; i < slots; i++) {
+      deliveryPool.push_back(std::make_unique<Delivery>());
+      deliveryFree->tryPush(deliveryPool.back().get());
+    }
+  }
+
+  this->videoCallback = videoCallback;
+  this->exitCallback  = exitCallback;
+  this->context       = context;
+
+  failed.store(false);
+  running.store(true);
+  deliveryThread = std::thread(&RenditionPipeline::deliveryThreadProc, this);
+  for (size_t i = 0; i < workers; i++) {
+    encodeThreads.emplace_back(&RenditionPipeline::encodeThreadProc, this);
+  }
+  captureThread = std::thread(&RenditionPipeline::captureThreadProc, this);
+
+  return true;
+}
+
+void RenditionPipeline::stop() {
+  running.store(false);
+
+  {
+    std::lock_guard<std::mutex> lock(scheduleMutex);
+  }
+  scheduleCV.notify_all();
+  {
+    std::lock_guard<std::mutex> lock(deliveryWakeMutex);
+  }
+  deliveryCV.notify_all();
+
+  if (captureThread.joinable()) {
+    captureThread.join();
+  }
+  for (std::thread &thread : encodeThreads) {
+    thread.join();
+  }
+  encodeThreads.clear();
+  if (deliveryThread.joinable()) {
+    deliveryThread.join();
+  }
+
+  // Return frames that were never encoded or delivered to their free lists
+  for (auto &rendition : renditions) {
+    SharedFrame *frame = nullptr;
+    while (rendition->readyQueue.tryPop(frame)) {
+      release(frame);
+    }
+    rendition->busy = false;
+  }
+  if (deliveryFree) {
+    Delivery *delivery = nullptr;
+    while (deliveryQueue.tryPop(delivery)) {
+      deliveryFree->tryPush(std::move(delivery));
+    }
+  }
+}
+
+void RenditionPipeline::notify(std::mutex &mutex, std::condition_variable &cv) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+  cv.notify_one();
+}
+
+void RenditionPipeline::fail(const char *message) {
+  fatalError = message ? message : "";
+  failed.store(true);
+  notify(deliveryWakeMutex, deliveryCV);
+}
+
+void RenditionPipeline::release(SharedFrame *frame) {
+  if (frame->holders.fetch_sub(1) == 1) {
+    freeQueue->tryPush(std::move(frame));
+  }
+}
+
+/**
+ * Capture stage: acquires once for every rendition that is due. Renditions
+ * advance on their own fixed timeline, so rates that divide each other keep
+ * landing on the same acquisition.
+ */
+void RenditionPipeline::captureThreadProc() {
+  setTraceThreadName("video-capture");
+
+  int64_t now = monotonicNowNs();
+  for (auto &rendition : renditions) {
+    rendition->nextDueNs = now;
+  }
+
+  std::vector<Rendition *> due;
+  while (running.load() && !failed.load()) {
+    int64_t nextDueNs  = renditions.front()->nextDueNs;
+    int64_t intervalUs = renditions.front()->frameIntervalUs;
+    for (auto &rendition : renditions) {
+      nextDueNs  = std::min(nextDueNs, rendition->nextDueNs);
+      intervalUs = std::min(intervalUs, rendition->frameIntervalUs);
+    }
+
+    // Frame rate limiting; short sleeps keep stop() responsive at low rates
+    now = monotonicNowNs();
+    if (nextDueNs > now) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(std::min<int64_t>(nextDueNs - now, 50000000)));
+      continue;
+    }
+
+    due.clear();
+    for (auto &rendition : renditions) {
+      if (rendition->nextDueNs <= now + kShareWindowNs) {
+        due.push_back(rendition.get());
+        // A rendition that fell behind restarts its timeline instead of catching up
+        rendition->nextDueNs += rendition->frameIntervalUs * 1000;
+        if (rendition->nextDueNs <= now) {
+          rendition->nextDueNs = now + rendition->frameIntervalUs * 1000;
+        }
+      }
+    }
+
+    SharedFrame *shared = nullptr;
+    if (!freeQueue->tryPop(shared)) {
+      // Cannot happen with the pool sized in start(); skip this tick rather than block
+      for (Rendition *rendition : due) {
+        rendition->framesDropped.fetch_add(1, std::memory_order_relaxed);
+      }
+      continue;
+    }
+
+    int64_t  intervalMs = intervalUs / 1000;
+    uint32_t timeoutMs  = static_cast<uint32_t>(std::min<int64_t>(500, std::max<int64_t>(100, intervalMs)));
+
+    VideoFrame &frame          = shared->frame;
+    frame.copyNs               = 0;
+    int64_t       acquireStart = monotonicNowNs();
+    AcquireResult result       = source.acquireFrame(frame, timeoutMs);
+    int64_t       acquireEnd   = monotonicNowNs();
+
+    if (result != AcquireResult::Frame) {
+      freeQueue->tryPush(std::move(shared));
+      if (result == AcquireResult::Error) {
+        acquireFailures.fetch_add(1, std::memory_order_relaxed);
+      } else if (result == AcquireResult::Fatal) {
+        fail(source.lastAcquireError());
+        break;
+      }
+      continue;
+    }
+
+    int64_t copyNs = std::min(frame.copyNs, acquireEnd - acquireStart);
+    acquireTiming.record(static_cast<uint64_t>(acquireEnd - acquireStart - copyNs));
+    if (copyNs > 0) {
+      copyTiming.record(static_cast<uint64_t>(copyNs));
+    }
+    frame.sequence    = nextSequence.fetch_add(1);
+    frame.acquiredNs  = acquireEnd;
+    frame.timestampMs = wallClockNowMs();
+    acquisitions.fetch_add(1, std::memory_order_relaxed);
+    traceSpan("acquire", frame.sequence, acquireStart, acquireEnd);
+
+    // Every holder is counted before the first rendition can release the frame
+    shared->holders.store(static_cast<int>(due.size()));
+    for (Rendition *rendition : due) {
+      SharedFrame *queued  = shared;
+      SharedFrame *evicted = nullptr;
+      if (rendition->readyQueue.pushDropOldest(std::move(queued), evicted)) {
+        rendition->framesDropped.fetch_add(1, std::memory_order_relaxed);
+        release(evicted);
+      }
+      rendition->framesCaptured.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    notify(scheduleMutex, scheduleCV);
+  }
+}
+
+bool RenditionPipeline::claimFrame(size_t &index, SharedFrame *&frame) {
+  const size_t count = renditions.size();
+  for (size_t k = 0; k < count; k++) {
+    size_t     i         = (scheduleCursor + k) % count;
+    Rendition &rendition = *renditions[i];
+    if (!rendition.busy && rendition.readyQueue.tryPop(frame)) {
+      rendition.busy = true;
+      scheduleCursor = (i + 1) % count;
+      index          = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Encode stage: one of the pool's workers. Encoded frames go to the shared
+ * delivery queue before the rendition is released, so each rendition's
+ * frames stay in capture order.
+ */
+void RenditionPipeline::encodeThreadProc() {
+  setTraceThreadName("video-encode");
+
+  while (running.load()) {
+    size_t       index  = 0;
+    SharedFrame *shared = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(scheduleMutex);
+      if (!claimFrame(index, shared)) {
+        scheduleCV.wait_for(lock, std::chrono::milliseconds(100));
+        continue;
+      }
+    }
+    Rendition        &rendition = *renditions[index];
+    const VideoFrame &frame     = shared->frame;
+
+    Delivery *slot = nullptr;
+    if (!deliveryFree->tryPop(slot)) {
+      // Cannot happen with the pool sized in start(); drop rather than block
+      rendition.framesDropped.fetch_add(1, std::memory_order_relaxed);
+      release(shared);
+    } else {
+      int64_t encodeStart = monotonicNowNs();
+      queueWaitTiming.record(static_cast<uint64_t>(std::max<int64_t>(0, encodeStart - frame.acquiredNs)));
+
+      bool    encodedOk = rendition.encoder.encodeFrame(frame, slot->encoded);
+      int64_t encodeEnd = monotonicNowNs();
+      slot->rendition   = index;
+      slot->timestampMs = frame.timestampMs;
+      slot->acquiredNs  = frame.acquiredNs;
+      slot->sequence    = frame.sequence;
+      traceSpan("encode", slot->sequence, encodeStart, encodeEnd);
+
+      // The last rendition to finish with the frame hands it back to capture
+      release(shared);
+
+      if (!encodedOk) {
+        rendition.encodeFailures.fetch_add(1, std::memory_order_relaxed);
+        deliveryFree->tryPush(std::move(slot));
+      } else {
+        encodeTiming.record(static_cast<uint64_t>(encodeEnd - encodeStart));
+        if (slot->encoded.data.empty()) {
+          rendition.framesEncoded.fetch_add(1, std::memory_order_relaxed);
+          deliveryFree->tryPush(std::move(slot));
+        } else {
+          // Workers push concurrently, and pushDropOldest expects a single producer
+          std::lock_guard<std::mutex> lock(deliveryPushMutex);
+          Delivery                   *evicted = nullptr;
+          if (deliveryQueue.pushDropOldest(std::move(slot), evicted)) {
+            renditions[evicted->rendition]->framesDropped.fetch_add(1, std::memory_order_relaxed);
+            deliveryFree->tryPush(std::move(evicted));
+          }
+        }
+        notify(deliveryWakeMutex, deliveryCV);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(scheduleMutex);
+      rendition.busy = false;
+    }
+    scheduleCV.notify_one();
+  }
+}
+
+/**
+ * Delivery stage: every frame callback of every rendition comes from this thread
+ */
+void RenditionPipeline::deliveryThreadProc() {
+  setTraceThreadName("video-deliver");
+
+  while (running.load() && !failed.load()) {
+    Delivery *delivery = nullptr;
+    if (!deliveryQueue.tryPop(delivery)) {
+      std::unique_lock<std::mutex> lock(deliveryWakeMutex);
+      deliveryCV.wait_for(lock, std::chrono::milliseconds(100), [this] {
+        return deliveryQueue.sizeApprox() > 0 || !running.load() || failed.load();
+      });
+      continue;
+    }
+
+    Rendition          &rendition = *renditions[delivery->rendition];
+    const EncodedFrame &encoded   = delivery->encoded;
+    if (videoCallback && running.load()) {
+      std::string timestampStr = std::to_string(delivery->timestampMs);
+      int64_t     deliverStart = monotonicNowNs();
+      setCurrentTraceSequence(delivery->sequence);
+      setCurrentSyncStamp(syncStampAt(syncClock.get(), delivery->acquiredNs));
+      videoCallback(
+          static_cast<int32_t>(delivery->rendition), const_cast<uint8_t *>(encoded.data.data()), encoded.width,
+          encoded.height, encoded.bytesPerRow, timestampStr.c_str(), encoded.format.c_str(), encoded.data.size(),
+          context);
+      setCurrentSyncStamp(SyncStamp());
+      setCurrentTraceSequence(kNoTraceSequence);
+      int64_t deliverEnd = monotonicNowNs();
+      deliverTiming.record(static_cast<uint64_t>(deliverEnd - deliverStart));
+      traceSpan("deliver", delivery->sequence, deliverStart, deliverEnd);
+      rendition.bytesDelivered.fetch_add(encoded.data.size(), std::memory_order_relaxed);
+    }
+    rendition.framesEncoded.fetch_add(1, std::memory_order_relaxed);
+
+    deliveryFree->tryPush(std::move(delivery));
+  }
+
+  // The exit callback may free the context, so it comes once and last; after stop() nobody is listening
+  if (failed.load() && running.load() && exitCallback) {
+    exitCallback(const_cast<char *>(fatalError.c_str()), context);
+  }
+}
+
+VideoPipelineStats RenditionPipeline::renditionStats(size_t index) const {
+  VideoPipelineStats stats;
+  if (index >= renditions.size()) {
+    return stats;
+  }
+  const Rendition &rendition = *renditions[index];
+  stats.framesCaptured       = rendition.framesCaptured.load(std::memory_order_relaxed);
+  stats.framesEncoded        = rendition.framesEncoded.load(std::memory_order_relaxed);
+  stats.framesDropped        = rendition.framesDropped.load(std::memory_order_relaxed);
+  stats.encodeFailures       = rendition.encodeFailures.load(std::memory_order_relaxed);
+  stats.queueDepth           = rendition.readyQueue.sizeApprox();
+  stats.bytesDelivered       = rendition.bytesDelivered.load(std::memory_order_relaxed);
+  return stats;
+}
+
+VideoPipelineStats RenditionPipeline::stats() const {
+  VideoPipelineStats stats;
+  for (size_t i = 0; i < renditions.size(); i++) {
+    VideoPipelineStats rendition = renditionStats(i);
+    stats.framesEncoded += rendition.framesEncoded;
+    stats.framesDropped += rendition.framesDropped;
+    stats.encodeFailures += rendition.encodeFailures;
+    stats.queueDepth += rendition.queueDepth;
+    stats.bytesDelivered += rendition.bytesDelivered;
+  }
+  stats.framesCaptured  = acquisitions.load(std::memory_order_relaxed);
+  stats.acquireFailures = acquireFailures.load(std::memory_order_relaxed);
+  stats.acquire         = acquireTiming.snapshot();
+  stats.copy            = copyTiming.snapshot();
+  stats.queueWait       = queueWaitTiming.snapshot();
+  stats.encode          = encodeTiming.snapshot();
+  stats.deliver         = deliverTiming.snapshot();
+  return stats;
+}
+
+void RenditionPipeline::resetStats() {
+  for (auto &rendition : renditions) {
+    rendition->framesCaptured.store(0);
+    rendition->framesEncoded.store(0);
+    rendition->framesDropped.store(0);
+    rendition->encodeFailures.store(0);
+    rendition->bytesDelivered.store(0);
+  }
+  acquisitions.store(0);
+  acquireFailures.store(0);
+  acquireTiming.reset();
+  copyTiming.reset();
+  queueWaitTiming.reset();
+  encodeTiming.reset();
+  deliverTiming.reset();
+}
@@ -0,0 +1,309 @@
+/**
+ * @file renditionpipeline.h
+ * @brief Several output renditions of one video source
+ *
+ * Where MultiTargetPipeline captures several targets, a RenditionPipeline
+ * captures one target and delivers it several times, each rendition with its
+ * own frame rate, size, format and quality (for example a 1 fps full-size
+ * JPEG for archiving next to a 10 fps thumbnail for a live preview):
+ *
+ * - one capture thread acquires only when at least one rendition is due, and
+ *   hands the same CPU copy to every rendition due at that time. Renditions
+ *   are paced on a common timeline, so a 1 fps rendition shares every tenth
+ *   acquisition of a 10 fps one instead of adding its own;
+ * - a pool of encoder threads downscales and encodes. Each worker takes the
+ *   next rendition with a queued frame in round-robin order, and a rendition
+ *   is encoded by one worker at a time, which keeps its frames in order;
+ * - one delivery thread invokes the frame callback, tagged with the
+ *   rendition index, from a single bounded queue.
+ *
+ * A frame returns to the capture stage once every rendition it was handed to
+ * has encoded or dropped it. Each rendition keeps the drop-oldest queue of
+ * VideoPipeline, so a slow full-size encode only drops its own frames.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "capture/capture.h"
+#include "framequeue.h"
+#include "stagetiming.h"
+#include "videopipeline.h"
+
+/**
+ * @struct VideoRendition
+ * @brief Output settings of one rendition
+ */
+struct VideoRendition {
+  float   frameRate   = 0;   /**< Frames per second (<= 0 selects 30) */
+  double  scale       = 1.0; /**< Downscale factor of the source frame (1 = full size) */
+  int32_t maxWidth    = 0;   /**< Largest output width in pixels; the height follows (0 = no limit) */
+  int32_t imageFormat = 0;   /**< 0 = JPEG, 1 = raw BGRA */
+  int32_t quality     = 75;  /**< JPEG quality (1-100) */
+};
+
+/**
+ * @class RenditionEncoder
+ * @brief Downscales and encodes BGRA frames according to a VideoRendition
+ *
+ * Uses the platform JPEG codec of jpegcodec.h, so the same encoder serves
+ * every backend.
+ */
+class RenditionEncoder : public VideoFrameEncoder {
+public:
+  explicit RenditionEncoder(const VideoRendition &rendition) : rendition(rendition) {}
+
+  bool encodeFrame(const VideoFrame &frame, EncodedFrame &out) override;
+
+  const char *lastEncodeError() const override {
+    return errorMsg;
+  }
+
+  /**
+   * @brief Output size of a source frame
+   */
+  static void outputSize(const VideoRendition &rendition, int32_t width, int32_t height, int32_t &outWidth,
+                         int32_t &outHeight);
+
+private:
+  const VideoRendition rendition;
+
+  /** Downscaled pixels, reused between frames */
+  std::vector<uint8_t> scaledPixels;
+
+  char errorMsg[256] = {0};
+};
+
+/**
+ * @class RenditionPipeline
+ * @brief Runs one VideoFrameSource and several VideoFrameEncoders on shared threads
+ */
+class RenditionPipeline {
+public:
+  /** Default number of frames held per rendition between capture and encode */
+  static constexpr size_t kDefaultQueueDepth = 2;
+
+  /** Default number of encoded frames held for the delivery thread */
+  static constexpr size_t kDefaultDeliveryDepth = 8;
+
+  /** Upper bound of the default encoder pool size */
+  static constexpr size_t kMaxDefaultEncoderThreads = 4;
+
+  /** Renditions due within this time of each other share an acquisition */
+  static constexpr int64_t kShareWindowNs = 2000000;
+
+  /**
+   * @brief Constructor
+   * @param source Capture stage; must outlive the pipeline
+   * @param encoderThreads Size of the encoder pool; 0 picks one per rendition, up to
+   *                       half the hardware threads and kMaxDefaultEncoderThreads
+   * @param queueDepth Number of frames held per rendition between the stages
+   * @param deliveryDepth Number of encoded frames waiting for the delivery thread
+   */
+  explicit RenditionPipeline(
+      VideoFrameSource &source, size_t encoderThreads = 0, size_t queueDepth = kDefaultQueueDepth,
+      size_t deliveryDepth = kDefaultDeliveryDepth);
+
+  /**
+   * @brief Destructor - stops the pipeline if it is running
+   */
+  ~RenditionPipeline();
+
+  RenditionPipeline(const RenditionPipeline &)            = delete;
+  RenditionPipeline &operator=(const RenditionPipeline &) = delete;
+
+  /**
+   * @brief Add a rendition; only allowed while the pipeline is stopped
+   * @param encoder Encode stage of the rendition; must outlive the pipeline
+   * @param frameRate Frames per second of the rendition (<= 0 selects 30)
+   * @return Index of the rendition, passed to the frame callback
+   */
+  size_t addRendition(VideoFrameEncoder &encoder, float frameRate);
+
+  /**
+   * @brief Number of renditions added
+   */
+  size_t renditionCount() const {
+    return renditions.size();
+  }
+
+  /**
+   * @brief Number of encoder threads started by start()
+   */
+  size_t encoderThreadCount() const;
+
+  /**
+   * @brief Start the capture, encoder and delivery threads
+   * @param videoCallback Function called with each encoded frame and its rendition index
+   * @param exitCallback Function called at most once, after the last frame, when the source fails for good;
+   *                     the pipeline stops capturing then. Frames that fail to acquire or encode are only counted.
+   * @param context User data passed to callbacks
+   * @return true if started, false if already running or there are no renditions
+   */
+  bool start(MediaCaptureTargetDataCallback videoCallback, MediaCaptureExitCallback exitCallback, void *context);
+
+  /**
+   * @brief Stop all threads and wait for them to exit
+   *
+   * Frames still queued are discarded.
+   */
+  void stop();
+
+  /**
+   * @brief Whether the pipeline threads are running
+   */
+  bool isRunning() const {
+    return running.load();
+  }
+
+  /**
+   * @brief Stamp each delivered frame with the audio position of its acquisition time
+   *
+   * Must be called before start().
+   */
+  void setSyncClock(std::shared_ptr<AvSyncClock> clock) {
+    syncClock = std::move(clock);
+  }
+
+  /**
+   * @brief Counters and stage timings of all renditions together
+   *
+   * framesCaptured and acquireFailures count acquisitions, however many renditions shared them.
+   */
+  VideoPipelineStats stats() const;
+
+  /**
+   * @brief Counters of one rendition; framesCaptured counts the frames handed to it
+   */
+  VideoPipelineStats renditionStats(size_t index) const;
+
+  /**
+   * @brief Reset counters and stage timings
+   */
+  void resetStats();
+
+private:
+  /** A captured frame and the number of renditions still holding it */
+  struct SharedFrame {
+    VideoFrame       frame;
+    std::atomic<int> holders{0};
+  };
+
+  /** One encoder, its pacing and its queue */
+  struct Rendition {
+    Rendition(VideoFrameEncoder &encoder, size_t queueDepth) : encoder(encoder), readyQueue(queueDepth) {}
+
+    VideoFrameEncoder               &encoder;
+    BoundedFrameQueue<SharedFrame *> readyQueue;
+
+    /** Interval between frames of this rendition in microseconds */
+    int64_t frameIntervalUs = 1000000;
+
+    /** Next frame time on the monotonicNowNs() clock (capture thread only) */
+    int64_t nextDueNs = 0;
+
+    /** Whether a worker is encoding this rendition (guarded by scheduleMutex) */
+    bool busy = false;
+
+    std::atomic<uint64_t> framesCaptured{0};
+    std::atomic<uint64_t> framesEncoded{0};
+    std::atomic<uint64_t> framesDropped{0};
+    std::atomic<uint64_t> encodeFailures{0};
+    std::atomic<uint64_t> bytesDelivered{0};
+  };
+
+  /** An encoded frame on its way to the delivery thread */
+  struct Delivery {
+    EncodedFrame encoded;
+    size_t       rendition   = 0;
+    int64_t      timestampMs = 0;
+    int64_t      acquiredNs  = 0;
+    uint64_t     sequence    = 0;
+  };
+
+  /** Capture thread: acquires when a rendition is due and hands the frame to all that are */
+  void captureThreadProc();
+
+  /** Encoder worker: encodes frames of whichever rendition the scheduler hands out */
+  void encodeThreadProc();
+
+  /** Delivery thread: invokes the frame callback in encode completion order */
+  void deliveryThreadProc();
+
+  /**
+   * @brief Claim the next rendition with a queued frame, round-robin (caller holds scheduleMutex)
+   * @return true if a frame was claimed; the rendition stays busy until release
+   */
+  bool claimFrame(size_t &rendition, SharedFrame *&frame);
+
+  /** Drop one holder of a frame; the last one returns it to the capture stage */
+  void release(SharedFrame *frame);
+
+  /** Record a fatal source error and wake the delivery thread, which reports it */
+  void fail(const char *message);
+
+  /** Wake one waiter of a condition variable without losing the notification */
+  static void notify(std::mutex &mutex, std::condition_variable &cv);
+
+  VideoFrameSource &source;
+  const size_t      queueDepth;
+  const size_t      requestedEncoderThreads;
+
+  std::vector<std::unique_ptr<Rendition>> renditions;
+
+  /** @name Shared frames, sized on the first start() */
+  ///@{
+  std::vector<std::unique_ptr<SharedFrame>>         framePool;
+  std::unique_ptr<BoundedFrameQueue<SharedFrame *>> freeQueue;
+  ///@}
+
+  /** @name Encoder scheduling */
+  ///@{
+  std::mutex              scheduleMutex;
+  std::condition_variable scheduleCV;
+  size_t                  scheduleCursor = 0;
+  ///@}
+
+  /** @name Delivery queue */
+  ///@{
+  BoundedFrameQueue<Delivery *>                  deliveryQueue;
+  std::mutex                                     deliveryPushMutex;
+  std::mutex                                     deliveryWakeMutex;
+  std::condition_variable                        deliveryCV;
+  std::vector<std::unique_ptr<Delivery>>         deliveryPool;
+  std::unique_ptr<BoundedFrameQueue<Delivery *>> deliveryFree;
+  ///@}
+
+  std::atomic<bool>        running{false};
+  std::thread              captureThread;
+  std::vector<std::thread> encodeThreads;
+  std::thread              deliveryThread;
+
+  /** Set by the capture thread once the source has failed for good; fatalError is written before */
+  std::atomic<bool> failed{false};
+  std::string       fatalError;
+
+  /** Optional clock shared with the audio source */
+  std::shared_ptr<AvSyncClock> syncClock;
+
+  MediaCaptureTargetDataCallback videoCallback = nullptr;
+  MediaCaptureExitCallback       exitCallback  = nullptr;
+  void                          *context       = nullptr;
+
+  /** @name Statistics shared by all renditions */
+  ///@{
+  std::atomic<uint64_t> nextSequence{1};
+  std::atomic<uint64_t> acquisitions{0};
+  std::atomic<uint64_t> acquireFailures{0};
+  StageTiming           acquireTiming;
+  StageTiming           copyTiming;
+  StageTiming           queueWaitTiming;
+  StageTiming           encodeTiming;
+  StageTiming           deliverTiming;
+  ///@}
+};
@@ -0,0 +1,231 @@
+/**
+ * @file sharedringwriter.cc
+ * @brief Implementation of the shared-memory ring writer
+ */
+#include "sharedringwriter.h"
+#include <cstring>
+#include "videopipeline.h"
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(SharedRingTrackC) == 64, "SharedRingTrackC layout changed");
+static_assert(sizeof(SharedRingHeaderC) == 192, "SharedRingHeaderC layout changed");
+static_assert(sizeof(SharedRingSlotC) == SHARED_RING_SLOT_HEADER_BYTES, "SharedRingSlotC layout changed");
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) && std::atomic<uint64_t>::is_always_lock_free,
+              "Sequence locks in shared memory need lock-free 64-bit atomics");
+
+namespace {
+
+/** Slots and payloads start on cache lines */
+constexpr uint64_t kAlignment = 64;
+
+uint64_t alignUp(uint64_t value) {
+  return (value + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+/** The layout is plain integers so that C readers can map it; the writer still needs atomic stores */
+template <typename T> std::atomic<T> *shared(T &value) {
+  return reinterpret_cast<std::atomic<T> *>(&value);
+}
+
+uint32_t currentProcessId() {
+#if defined(_WIN32)
+  return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+  return static_cast<uint32_t>(getpid());
+#endif
+}
+
+} // namespace
+
+SharedRingWriter::SharedRingWriter(const SharedRingOptions &options) : options(options) {}
+
+SharedRingWriter::~SharedRingWriter() {
+  close();
+}
+
+bool SharedRingWriter::open(std::string &error) {
+  if (mapped) {
+    error = "Shared memory ring is already open";
+    return false;
+  }
+  char osName[SHARED_RING_MAX_NAME + 16];
+  if (!sharedRingOsName(options.name.c_str(), osName, sizeof(osName))) {
+    error = "Shared memory name must be 1-" + std::to_string(SHARED_RING_MAX_NAME) +
+            " characters without '/' or '\\'";
+    return false;
+  }
+
+  const uint64_t videoStride = alignUp(SHARED_RING_SLOT_HEADER_BYTES + options.videoSlotBytes);
+  const uint64_t audioStride = alignUp(SHARED_RING_SLOT_HEADER_BYTES + options.audioSlotBytes);
+  const uint64_t videoOffset = alignUp(sizeof(SharedRingHeaderC));
+  const uint64_t audioOffset = videoOffset + videoStride * options.videoSlots;
+  const uint64_t totalBytes  = audioOffset + audioStride * options.audioSlots;
+  if (options.videoSlots == 0 && options.audioSlots == 0) {
+    error = "Shared memory ring needs video or audio slots";
+    return false;
+  }
+  if ((options.videoSlots > 0 && options.videoSlotBytes == 0) ||
+      (options.audioSlots > 0 && options.audioSlotBytes == 0) || totalBytes > (1ull << 36)) {
+    error = "Shared memory ring dimensions are out of range";
+    return false;
+  }
+
+#if defined(_WIN32)
+  HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                      static_cast<DWORD>(totalBytes >> 32), static_cast<DWORD>(totalBytes), osName);
+  if (!mapping) {
+    error = "Failed to create shared memory " + options.name + ": error " + std::to_string(GetLastError());
+    return false;
+  }
+  if (GetLastError() == ERROR_ALREADY_EXISTS) {
+    CloseHandle(mapping);
+    error = "Shared memory " + options.name + " is already in use";
+    return false;
+  }
+  void *view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(totalBytes));
+  if (!view) {
+    error = "Failed to map shared memory " + options.name + ": error " + std::to_string(GetLastError());
+    CloseHandle(mapping);
+    return false;
+  }
+  handle = mapping;
+#else
+  int fd = shm_open(osName, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    error = errno == EEXIST ? "Shared memory " + options.name + " is already in use"
+                            : "Failed to create shared memory " + options.name + ": " + std::strerror(errno);
+    return false;
+  }
+  void *view = MAP_FAILED;
+  if (ftruncate(fd, static_cast<off_t>(totalBytes)) == 0) {
+    view = mmap(nullptr, static_cast<size_t>(totalBytes), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (view == MAP_FAILED) {
+    error = "Failed to map shared memory " + options.name + ": " + std::strerror(errno);
+    ::close(fd);
+    shm_unlink(osName);
+    return false;
+  }
+  ::close(fd);
+#endif
+
+  base = static_cast<uint8_t *>(view);
+  size = static_cast<size_t>(totalBytes);
+
+  // New mappings are zero-filled, so every slot starts at sequence 0 ("nothing written")
+  SharedRingHeaderC *header = reinterpret_cast<SharedRingHeaderC *>(base);
+  header->version           = SHARED_RING_VERSION;
+  header->totalBytes        = totalBytes;
+  header->writerPid         = currentProcessId();
+  header->tracks[SHARED_RING_VIDEO].offset    = videoOffset;
+  header->tracks[SHARED_RING_VIDEO].slotBytes = videoStride;
+  header->tracks[SHARED_RING_VIDEO].slotCount = options.videoSlots;
+  header->tracks[SHARED_RING_AUDIO].offset    = audioOffset;
+  header->tracks[SHARED_RING_AUDIO].slotBytes = audioStride;
+  header->tracks[SHARED_RING_AUDIO].slotCount = options.audioSlots;
+  shared(header->magic)->store(SHARED_RING_MAGIC, std::memory_order_release);
+
+  std::lock_guard<std::mutex> videoLock(trackMutex[SHARED_RING_VIDEO]);
+  std::lock_guard<std::mutex> audioLock(trackMutex[SHARED_RING_AUDIO]);
+  mapped = true;
+  return true;
+}
+
+bool SharedRingWriter::writeVideo(const uint8_t *data, size_t size, int32_t width, int32_t height,
+                                  int32_t bytesPerRow, bool jpeg, int64_t timestampMs) {
+  SharedRingSlotC fields = {};
+  fields.format          = jpeg ? SHARED_RING_JPEG : SHARED_RING_BGRA;
+  fields.width           = width;
+  fields.height          = height;
+  fields.bytesPerRow     = bytesPerRow;
+  fields.timestampMs     = timestampMs;
+  return publish(SHARED_RING_VIDEO, fields, data, size);
+}
+
+bool SharedRingWriter::writeAudio(const float *samples, int32_t frameCount, int32_t channels, int32_t sampleRate) {
+  if (frameCount <= 0 || channels <= 0) {
+    return false;
+  }
+  SharedRingSlotC fields = {};
+  fields.format          = SHARED_RING_FLOAT32;
+  fields.channels        = channels;
+  fields.sampleRate      = sampleRate;
+  fields.frameCount      = frameCount;
+  fields.timestampMs     = wallClockNowMs();
+  return publish(SHARED_RING_AUDIO, fields, samples,
+                 static_cast<size_t>(frameCount) * static_cast<size_t>(channels) * sizeof(float));
+}
+
+bool SharedRingWriter::publish(int track, const SharedRingSlotC &fields, const void *payload, size_t payloadSize) {
+  std::lock_guard<std::mutex> lock(trackMutex[track]);
+  if (!mapped) {
+    return false;
+  }
+
+  SharedRingTrackC &ring = reinterpret_cast<SharedRingHeaderC *>(base)->tracks[track];
+  if (ring.slotCount == 0) {
+    return false;
+  }
+  if (payloadSize > ring.slotBytes - SHARED_RING_SLOT_HEADER_BYTES || payloadSize > UINT32_MAX) {
+    oversizedItems.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  const uint64_t   index = shared(ring.writeIndex)->load(std::memory_order_relaxed);
+  uint8_t         *slotBase = base + ring.offset + (index % ring.slotCount) * ring.slotBytes;
+  SharedRingSlotC *slot     = reinterpret_cast<SharedRingSlotC *>(slotBase);
+
+  // Odd while the slot is inconsistent; the fence keeps the payload stores after it
+  shared(slot->sequence)->store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot->format      = fields.format;
+  slot->size        = static_cast<uint32_t>(payloadSize);
+  slot->width       = fields.width;
+  slot->height      = fields.height;
+  slot->bytesPerRow = fields.bytesPerRow;
+  slot->channels    = fields.channels;
+  slot->sampleRate  = fields.sampleRate;
+  slot->frameCount  = fields.frameCount;
+  slot->timestampMs = fields.timestampMs;
+  std::memcpy(slotBase + SHARED_RING_SLOT_HEADER_BYTES, payload, payloadSize);
+
+  shared(slot->sequence)->store(2 * index + 2, std::memory_order_release);
+  shared(ring.writeIndex)->store(index + 1, std::memory_order_release);
+  return true;
+}
+
+void SharedRingWriter::close() {
+  std::lock_guard<std::mutex> videoLock(trackMutex[SHARED_RING_VIDEO]);
+  std::lock_guard<std::mutex> audioLock(trackMutex[SHARED_RING_AUDIO]);
+  if (!mapped) {
+    return;
+  }
+  mapped = false;
+
+  SharedRingHeaderC *header = reinterpret_cast<SharedRingHeaderC *>(base);
+  shared(header->closed)->store(1, std::memory_order_release);
+
+#if defined(_WIN32)
+  // The mapping lives on while readers hold handles to it
+  UnmapViewOfFile(base);
+  CloseHandle(static_cast<HANDLE>(handle));
+  handle = nullptr;
+#else
+  // Readers keep their mappings; the name is freed for the next capture
+  munmap(base, size);
+  char osName[SHARED_RING_MAX_NAME + 16];
+  if (sharedRingOsName(options.name.c_str(), osName, sizeof(osName))) {
+    shm_unlink(osName);
+  }
+#endif
+  base = nullptr;
+  size = 0;
+}
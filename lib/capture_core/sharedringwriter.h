@@ -0,0 +1,105 @@
+/**
+ * @file sharedringwriter.h
+ * @brief Publishes captured frames and audio into a named shared-memory ring
+ *
+ * The writer side of include/capture/sharedring.h. The capture threads copy
+ * each frame or packet straight into the next slot of the mapping, so other
+ * processes receive it without any serialization or IPC round trip. Slots are
+ * reused in order; a reader that falls more than a ring behind loses the
+ * oldest items but never delays the writer.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "capture/sharedring.h"
+
+/**
+ * @struct SharedRingOptions
+ * @brief Name and dimensions of a ring
+ */
+struct SharedRingOptions {
+  std::string name;                         /**< Readers open the ring by this name */
+  uint32_t    videoSlots     = 4;           /**< Video frames kept; 0 = no video track */
+  uint64_t    videoSlotBytes = 8ull << 20;  /**< Largest video frame; bigger ones are skipped */
+  uint32_t    audioSlots     = 64;          /**< Audio packets kept; 0 = no audio track */
+  uint64_t    audioSlotBytes = 64ull << 10; /**< Largest audio packet; bigger ones are skipped */
+};
+
+/**
+ * @class SharedRingWriter
+ * @brief Creates a ring and writes into it
+ *
+ * writeVideo() and writeAudio() may be called from any thread; items of one
+ * track are published in the order the calls complete. open() and close()
+ * from one controlling thread.
+ */
+class SharedRingWriter {
+public:
+  explicit SharedRingWriter(const SharedRingOptions &options);
+
+  /**
+   * @brief Destructor - closes the ring if it is open
+   */
+  ~SharedRingWriter();
+
+  SharedRingWriter(const SharedRingWriter &)            = delete;
+  SharedRingWriter &operator=(const SharedRingWriter &) = delete;
+
+  /**
+   * @brief Create and map the segment
+   * @param error Receives a description on failure, including when the name is already in use
+   */
+  bool open(std::string &error);
+
+  /**
+   * @brief Publish a video frame
+   * @param data Frame bytes
+   * @param size Number of bytes
+   * @param width Frame width
+   * @param height Frame height
+   * @param bytesPerRow Row stride of BGRA frames
+   * @param jpeg true for JPEG data, false for BGRA
+   * @param timestampMs Capture time in milliseconds since the Unix epoch
+   * @return false if the ring is closed or the frame does not fit a slot
+   */
+  bool writeVideo(const uint8_t *data, size_t size, int32_t width, int32_t height, int32_t bytesPerRow, bool jpeg,
+                  int64_t timestampMs);
+
+  /**
+   * @brief Publish interleaved float audio, stamped with the current wall-clock time
+   * @param samples Samples
+   * @param frameCount Number of sample frames
+   * @param channels Channels per frame
+   * @param sampleRate Sample rate in Hz
+   * @return false if the ring is closed or the packet does not fit a slot
+   */
+  bool writeAudio(const float *samples, int32_t frameCount, int32_t channels, int32_t sampleRate);
+
+  /**
+   * @brief Tell readers that nothing more will be published, then unmap and remove the name
+   *
+   * Readers that already mapped the ring can keep reading what it holds.
+   */
+  void close();
+
+  /** Items skipped because they were larger than a slot */
+  uint64_t oversized() const { return oversizedItems.load(std::memory_order_relaxed); }
+
+private:
+  /** Copy an item into the next slot of a track under the sequence lock */
+  bool publish(int track, const SharedRingSlotC &fields, const void *payload, size_t size);
+
+  const SharedRingOptions options;
+
+  /** Held while a track is written; close() takes both before unmapping */
+  std::mutex trackMutex[SHARED_RING_TRACKS];
+
+  uint8_t              *base   = nullptr;
+  size_t                size   = 0;
+  void                 *handle = nullptr;
+  bool                  mapped = false;
+  std::atomic<uint64_t> oversizedItems{0};
+};
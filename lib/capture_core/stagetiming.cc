@@ -0,0 +1,105 @@
+/**
+ * @file stagetiming.cc
+ * @brief Implementation of the stage latency histograms
+ */
+#include "stagetiming.h"
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+/** Position of the highest set bit; value must be non-zero */
+int highestBit(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return static_cast<int>(index);
+#else
+  return 63 - __builtin_clzll(value);
+#endif
+}
+
+} // namespace
+
+size_t StageTiming::bucketIndex(uint64_t ns) {
+  if (ns < static_cast<uint64_t>(kSubBuckets)) {
+    return static_cast<size_t>(ns);
+  }
+  int exponent = highestBit(ns);
+  if (exponent >= kMaxExponent) {
+    return kBucketCount - 1;
+  }
+
+  // Top kSubBucketBits bits below the leading one select the sub-bucket
+  int    shift     = exponent - kSubBucketBits;
+  size_t subBucket = static_cast<size_t>((ns >> shift) - kSubBuckets);
+  return static_cast<size_t>(shift + 1) * kSubBuckets + subBucket;
+}
+
+uint64_t StageTiming::bucketLowerBound(size_t index) {
+  if (index < static_cast<size_t>(kSubBuckets)) {
+    return index;
+  }
+  size_t shift     = index / kSubBuckets - 1;
+  size_t subBucket = index % kSubBuckets;
+  return static_cast<uint64_t>(kSubBuckets + subBucket) << shift;
+}
+
+void StageTiming::record(uint64_t ns) {
+  count.fetch_add(1, std::memory_order_relaxed);
+  totalNs.fetch_add(ns, std::memory_order_relaxed);
+  buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+
+  uint64_t currentMax = maxNs.load(std::memory_order_relaxed);
+  while (ns > currentMax && !maxNs.compare_exchange_weak(currentMax, ns, std::memory_order_relaxed)) {
+  }
+}
+
+void StageTiming::reset() {
+  count.store(0, std::memory_order_relaxed);
+  totalNs.store(0, std::memory_order_relaxed);
+  maxNs.store(0, std::memory_order_relaxed);
+  for (auto &bucket : buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+StageTimingSnapshot StageTiming::snapshot() const {
+  // Percentiles come from the bucket counts rather than `count`, which writers may have bumped since
+  uint64_t counts[kBucketCount];
+  uint64_t total = 0;
+  for (size_t i = 0; i < kBucketCount; i++) {
+    counts[i] = buckets[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+
+  StageTimingSnapshot snapshot;
+  snapshot.count = count.load(std::memory_order_relaxed);
+  uint64_t max   = maxNs.load(std::memory_order_relaxed);
+  snapshot.maxMs = static_cast<double>(max) / 1e6;
+  if (snapshot.count > 0) {
+    snapshot.meanMs = static_cast<double>(totalNs.load(std::memory_order_relaxed)) / snapshot.count / 1e6;
+  }
+  if (total == 0) {
+    return snapshot;
+  }
+
+  // Report the middle of the bucket holding each percentile, never above the recorded maximum
+  const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  double      *results[]   = {&snapshot.p50Ms, &snapshot.p90Ms, &snapshot.p99Ms, &snapshot.p999Ms};
+  uint64_t     seen        = 0;
+  size_t       q           = 0;
+  for (size_t i = 0; i < kBucketCount && q < 4; i++) {
+    seen += counts[i];
+    while (q < 4 && seen > 0 && static_cast<double>(seen) >= quantiles[q] * static_cast<double>(total)) {
+      uint64_t lower = bucketLowerBound(i);
+      uint64_t upper = i + 1 < kBucketCount ? bucketLowerBound(i + 1) : lower;
+      double   value = std::min(static_cast<double>(lower + upper) / 2.0, static_cast<double>(max));
+      *results[q]    = value / 1e6;
+      q++;
+    }
+  }
+  return snapshot;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file stagetiming.h
+ * @brief Lock-free latency histograms for the stages of the capture pipelines
+ *
+ * Each StageTiming is an HDR-style histogram: values are bucketed by their
+ * power of two and then linearly into kSubBuckets sub-buckets, so every
+ * bucket is at most 1/kSubBuckets of its value wide and percentiles are
+ * accurate to a few percent from 1 ns up to about 18 minutes. record() is a
+ * handful of relaxed atomic increments and may be called from any thread;
+ * snapshot() reads the buckets without stopping writers, so a snapshot taken
+ * during capture may be off by the samples recorded while it was read.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @struct StageTimingSnapshot
+ * @brief Point-in-time summary of a StageTiming
+ */
+struct StageTimingSnapshot {
+  uint64_t count  = 0; /**< Number of recorded samples */
+  double   meanMs = 0; /**< Mean duration in milliseconds */
+  double   maxMs  = 0; /**< Longest duration in milliseconds */
+  double   p50Ms  = 0; /**< Median in milliseconds */
+  double   p90Ms  = 0; /**< 90th percentile in milliseconds */
+  double   p99Ms  = 0; /**< 99th percentile in milliseconds */
+  double   p999Ms = 0; /**< 99.9th percentile in milliseconds */
+};
+
+/**
+ * @struct StageTiming
+ * @brief Lock-free histogram of per-stage durations
+ */
+struct StageTiming {
+  /** log2 of the number of linear sub-buckets per power of two */
+  static constexpr int kSubBucketBits = 4;
+  static constexpr int kSubBuckets    = 1 << kSubBucketBits;
+
+  /** Durations at or above 2^kMaxExponent ns land in the last bucket */
+  static constexpr int kMaxExponent = 40;
+
+  static constexpr size_t kBucketCount = static_cast<size_t>(kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+  std::atomic<uint64_t> count{0};   /**< Number of recorded samples */
+  std::atomic<uint64_t> totalNs{0}; /**< Sum of recorded durations */
+  std::atomic<uint64_t> maxNs{0};   /**< Longest recorded duration */
+  std::atomic<uint64_t> buckets[kBucketCount] = {};
+
+  /**
+   * @brief Record one duration
+   * @param ns Duration in nanoseconds
+   */
+  void record(uint64_t ns);
+
+  /**
+   * @brief Reset all accumulators to zero
+   */
+  void reset();
+
+  /**
+   * @brief Summarize the recorded durations
+   */
+  StageTimingSnapshot snapshot() const;
+
+  /**
+   * @brief Bucket holding a duration
+   */
+  static size_t bucketIndex(uint64_t ns);
+
+  /**
+   * @brief Smallest duration that falls into a bucket
+   */
+  static uint64_t bucketLowerBound(size_t index);
+};
@@ -0,0 +1,248 @@
+/**
+ * @file targetregistry.cc
+ * @brief Implementation of the cached capture-target registry
+ */
+#include "targetregistry.h"
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+
+namespace {
+
+bool containsIgnoringCase(const std::string &text, const std::string &part) {
+  auto found = std::search(text.begin(), text.end(), part.begin(), part.end(), [](char a, char b) {
+    return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+  });
+  return found != text.end();
+}
+
+} // namespace
+
+uint64_t CaptureTarget::key() const {
+  // Displays and windows have separate ID spaces
+  return (static_cast<uint64_t>(isDisplay) << 33) | (static_cast<uint64_t>(isWindow) << 32) |
+         (isDisplay ? displayID : windowID);
+}
+
+bool CaptureTarget::operator==(const CaptureTarget &other) const {
+  return isDisplay == other.isDisplay && isWindow == other.isWindow && displayID == other.displayID &&
+         windowID == other.windowID && width == other.width && height == other.height && title == other.title &&
+         appName == other.appName;
+}
+
+bool TargetFilter::matches(const CaptureTarget &target) const {
+  if (target.width < minWidth || target.height < minHeight) {
+    return false;
+  }
+  if (!appName.empty() && !containsIgnoringCase(target.appName, appName)) {
+    return false;
+  }
+  if (displayID != 0 && target.isDisplay && target.displayID != displayID) {
+    return false;
+  }
+  return true;
+}
+
+std::vector<CaptureTarget> filterTargets(const std::vector<CaptureTarget> &targets, const TargetFilter &filter) {
+  std::vector<CaptureTarget> matching;
+  for (const CaptureTarget &target : targets) {
+    if (filter.matches(target)) {
+      matching.push_back(target);
+    }
+  }
+  return matching;
+}
+
+void diffTargets(const std::vector<CaptureTarget> &before, const std::vector<CaptureTarget> &after,
+                 TargetChanges &changes) {
+  changes = TargetChanges();
+
+  std::unordered_map<uint64_t, const CaptureTarget *> previous;
+  previous.reserve(before.size());
+  for (const CaptureTarget &target : before) {
+    previous.emplace(target.key(), &target);
+  }
+
+  std::unordered_map<uint64_t, bool> current;
+  current.reserve(after.size());
+  for (const CaptureTarget &target : after) {
+    current.emplace(target.key(), true);
+    auto found = previous.find(target.key());
+    if (found == previous.end()) {
+      changes.added.push_back(target);
+    } else if (*found->second != target) {
+      changes.updated.push_back(target);
+    }
+  }
+  for (const CaptureTarget &target : before) {
+    if (current.find(target.key()) == current.end()) {
+      changes.removed.push_back(target);
+    }
+  }
+}
+
+TargetRegistry::TargetRegistry(EnumerateFn enumerate) : enumerate(std::move(enumerate)) {}
+
+TargetRegistry::~TargetRegistry() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    subscribers.clear();
+  }
+  wakeup.notify_all();
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+bool TargetRegistry::refresh(int32_t type, std::string &error) {
+  std::lock_guard<std::mutex> serialize(enumerateMutex);
+
+  std::vector<CaptureTarget> fresh;
+  if (!enumerate(type, fresh, error)) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  Snapshot                   &snapshot = cache[type];
+  snapshot.targets                     = std::move(fresh);
+  snapshot.taken                       = std::chrono::steady_clock::now();
+  return true;
+}
+
+bool TargetRegistry::targets(const TargetFilter &filter, int64_t maxAgeMs, std::vector<CaptureTarget> &targets,
+                             std::string &error) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        found = cache.find(filter.type);
+    if (maxAgeMs > 0 && found != cache.end() &&
+        std::chrono::steady_clock::now() - found->second.taken <= std::chrono::milliseconds(maxAgeMs)) {
+      targets = filterTargets(found->second.targets, filter);
+      return true;
+    }
+  }
+
+  if (!refresh(filter.type, error)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  targets = filterTargets(cache[filter.type].targets, filter);
+  return true;
+}
+
+int64_t TargetRegistry::cacheLifetimeMs() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return subscribers.empty() ? 0 : pollIntervalLocked();
+}
+
+int64_t TargetRegistry::pollIntervalLocked() const {
+  if (subscribers.empty()) {
+    return kDefaultPollMs;
+  }
+  int64_t interval = subscribers.begin()->second.intervalMs;
+  for (const auto &entry : subscribers) {
+    interval = std::min(interval, entry.second.intervalMs);
+  }
+  return std::max(interval, kMinPollMs);
+}
+
+uint64_t TargetRegistry::subscribe(const TargetFilter &filter, int64_t intervalMs, ChangeFn onChange) {
+  // The baseline is what an enumeration right now would return
+  std::vector<CaptureTarget> baseline;
+  std::string                error;
+  targets(filter, std::max(intervalMs, kMinPollMs), baseline, error);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  uint64_t                    id = nextID++;
+  Subscriber                 &subscriber = subscribers[id];
+  subscriber.filter                      = filter;
+  subscriber.intervalMs                  = intervalMs > 0 ? intervalMs : kDefaultPollMs;
+  subscriber.onChange                    = std::move(onChange);
+  subscriber.seen                        = std::move(baseline);
+
+  if (!running && !stopping) {
+    // A previous thread may have just seen the last subscriber leave
+    if (thread.joinable()) {
+      thread.join();
+    }
+    running = true;
+    thread  = std::thread(&TargetRegistry::run, this);
+  } else {
+    wakeup.notify_all();
+  }
+  return id;
+}
+
+void TargetRegistry::unsubscribe(uint64_t id) {
+  std::lock_guard<std::mutex> deliver(deliverMutex);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    subscribers.erase(id);
+  }
+  wakeup.notify_all();
+}
+
+bool TargetRegistry::pollOnce() {
+  std::vector<int32_t> types;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &entry : subscribers) {
+      if (std::find(types.begin(), types.end(), entry.second.filter.type) == types.end()) {
+        types.push_back(entry.second.filter.type);
+      }
+    }
+  }
+
+  bool                 ok = true;
+  std::vector<int32_t> refreshed;
+  for (int32_t type : types) {
+    std::string error;
+    if (refresh(type, error)) {
+      refreshed.push_back(type);
+    } else {
+      ok = false;
+    }
+  }
+
+  std::lock_guard<std::mutex>                     deliver(deliverMutex);
+  std::vector<std::pair<ChangeFn, TargetChanges>> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry : subscribers) {
+      Subscriber &subscriber = entry.second;
+      if (std::find(refreshed.begin(), refreshed.end(), subscriber.filter.type) == refreshed.end()) {
+        continue;
+      }
+      std::vector<CaptureTarget> now = filterTargets(cache[subscriber.filter.type].targets, subscriber.filter);
+      TargetChanges              changes;
+      diffTargets(subscriber.seen, now, changes);
+      if (!changes.empty()) {
+        subscriber.seen = std::move(now);
+        pending.emplace_back(subscriber.onChange, std::move(changes));
+      }
+    }
+  }
+  for (auto &change : pending) {
+    change.first(change.second);
+  }
+  return ok;
+}
+
+void TargetRegistry::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!subscribers.empty() && !stopping) {
+    // Woken early when subscribers come or go, so a shorter interval takes effect
+    auto start    = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::milliseconds(pollIntervalLocked());
+    while (!subscribers.empty() && !stopping && wakeup.wait_until(lock, deadline) == std::cv_status::no_timeout) {
+      deadline = std::min(deadline, start + std::chrono::milliseconds(pollIntervalLocked()));
+    }
+    if (subscribers.empty() || stopping) {
+      break;
+    }
+    lock.unlock();
+    pollOnce();
+    lock.lock();
+  }
+  running = false;
+}
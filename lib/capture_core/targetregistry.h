@@ -0,0 +1,193 @@
+/**
+ * @file targetregistry.h
+ * @brief Cached capture-target enumeration with change notifications
+ *
+ * Enumerating targets asks the OS for every display and window and copies
+ * all their titles. Pickers that refresh their lists every second repeat
+ * that work in every process that shows one. A TargetRegistry keeps the last
+ * enumeration of each target type and, while anyone subscribes, refreshes it
+ * from one polling thread and tells each subscriber only what changed among
+ * the targets its filter selects.
+ *
+ * Backends have no portable change notification for windows, so changes are
+ * found by diffing consecutive polls.
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @struct CaptureTarget
+ * @brief Owned copy of a MediaCaptureTargetC
+ */
+struct CaptureTarget {
+  bool        isDisplay = false;
+  bool        isWindow  = false;
+  uint32_t    displayID = 0;
+  uint32_t    windowID  = 0;
+  int32_t     width     = 0;
+  int32_t     height    = 0;
+  std::string title;
+  std::string appName;
+
+  /** Identity of the display or window, stable while it exists */
+  uint64_t key() const;
+
+  bool operator==(const CaptureTarget &other) const;
+  bool operator!=(const CaptureTarget &other) const { return !(*this == other); }
+};
+
+/**
+ * @struct TargetFilter
+ * @brief Selects targets natively so only the interesting ones reach JavaScript
+ */
+struct TargetFilter {
+  int32_t     type = 0;      /**< Enumeration type passed to the backend (0=all, 1=displays, 2=windows) */
+  std::string appName;       /**< Case-insensitive substring of the application name; empty matches all */
+  int32_t     minWidth  = 0; /**< Smallest width in pixels */
+  int32_t     minHeight = 0; /**< Smallest height in pixels */
+  uint32_t    displayID = 0; /**< Only this display among display targets; windows do not say which display they are on */
+
+  bool matches(const CaptureTarget &target) const;
+};
+
+/**
+ * @struct TargetChanges
+ * @brief Difference between two enumerations
+ */
+struct TargetChanges {
+  std::vector<CaptureTarget> added;   /**< New targets, in enumeration order */
+  std::vector<CaptureTarget> removed; /**< Targets that went away, as last seen */
+  std::vector<CaptureTarget> updated; /**< Targets whose title, application or size changed, as they are now */
+
+  bool empty() const { return added.empty() && removed.empty() && updated.empty(); }
+};
+
+/**
+ * @brief Targets that match a filter, in their original order
+ */
+std::vector<CaptureTarget> filterTargets(const std::vector<CaptureTarget> &targets, const TargetFilter &filter);
+
+/**
+ * @brief Compare two enumerations by target identity
+ */
+void diffTargets(const std::vector<CaptureTarget> &before, const std::vector<CaptureTarget> &after,
+                 TargetChanges &changes);
+
+/**
+ * @class TargetRegistry
+ * @brief Caches enumerations per target type and notifies subscribers of changes
+ *
+ * All methods are thread-safe. Change callbacks run on the polling thread and
+ * must not call back into the registry.
+ */
+class TargetRegistry {
+public:
+  /** Default time between polls while anyone subscribes */
+  static constexpr int64_t kDefaultPollMs = 1000;
+
+  /** Polls are never closer together than this */
+  static constexpr int64_t kMinPollMs = 100;
+
+  /**
+   * @brief Enumerates targets of one type from the backend
+   * @return false with error set if the backend failed
+   */
+  using EnumerateFn = std::function<bool(int32_t type, std::vector<CaptureTarget> &targets, std::string &error)>;
+
+  /** Receives the changes among the targets a subscriber's filter selects */
+  using ChangeFn = std::function<void(const TargetChanges &changes)>;
+
+  explicit TargetRegistry(EnumerateFn enumerate);
+
+  /**
+   * @brief Stops the polling thread
+   */
+  ~TargetRegistry();
+
+  TargetRegistry(const TargetRegistry &)            = delete;
+  TargetRegistry &operator=(const TargetRegistry &) = delete;
+
+  /**
+   * @brief Targets matching a filter
+   * @param filter Selection; its type picks the cached enumeration
+   * @param maxAgeMs Reuse the cached enumeration if it is at most this old; 0 always enumerates
+   * @param targets Receives the matching targets
+   * @param error Set if the backend failed
+   * @return false if an enumeration was needed and failed
+   */
+  bool targets(const TargetFilter &filter, int64_t maxAgeMs, std::vector<CaptureTarget> &targets, std::string &error);
+
+  /**
+   * @brief How old a cached enumeration can be while still current: the poll interval while polling, else 0
+   */
+  int64_t cacheLifetimeMs() const;
+
+  /**
+   * @brief Start receiving changes relative to the targets matching now
+   * @param filter Selection of the targets to report
+   * @param intervalMs Requested poll interval; the registry polls at the shortest one requested
+   * @param onChange Called on the polling thread with each non-empty change
+   * @return Subscription ID for unsubscribe()
+   */
+  uint64_t subscribe(const TargetFilter &filter, int64_t intervalMs, ChangeFn onChange);
+
+  /**
+   * @brief Stop a subscription; its callback is not running and will not run once this returns
+   */
+  void unsubscribe(uint64_t id);
+
+  /**
+   * @brief Enumerate the types subscribers use and deliver their changes
+   * @return false if an enumeration failed; subscribers of that type get nothing this time
+   */
+  bool pollOnce();
+
+private:
+  struct Snapshot {
+    std::vector<CaptureTarget>            targets;
+    std::chrono::steady_clock::time_point taken;
+  };
+
+  struct Subscriber {
+    TargetFilter               filter;
+    int64_t                    intervalMs = kDefaultPollMs;
+    ChangeFn                   onChange;
+    std::vector<CaptureTarget> seen;
+  };
+
+  /** Enumerate one type into the cache */
+  bool refresh(int32_t type, std::string &error);
+
+  /** Shortest interval requested by a subscriber (caller holds mutex) */
+  int64_t pollIntervalLocked() const;
+
+  /** Polling thread body */
+  void run();
+
+  EnumerateFn enumerate;
+
+  /** Serializes backend enumerations */
+  std::mutex enumerateMutex;
+
+  /** Held while change callbacks run, so unsubscribe() can wait for them */
+  std::mutex deliverMutex;
+
+  /** Guards everything below */
+  mutable std::mutex             mutex;
+  std::condition_variable        wakeup;
+  std::map<int32_t, Snapshot>    cache;
+  std::map<uint64_t, Subscriber> subscribers;
+  uint64_t                       nextID   = 1;
+  bool                           running  = false;
+  bool                           stopping = false;
+  std::thread                    thread;
+};
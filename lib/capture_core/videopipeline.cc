@@ -0,0 +1,271 @@
+/**
+ * @file videopipeline.cc
+ * @brief Implementation of the two-stage video capture pipeline
+ */
+#include "videopipeline.h"
+#include "capturetrace.h"
+#include <algorithm>
+
+int64_t monotonicNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int64_t wallClockNowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+VideoPipeline::VideoPipeline(VideoFrameSource &source, VideoFrameEncoder &encoder, size_t queueDepth) :
+    source(source),
+    encoder(encoder),
+    readyQueue(queueDepth > 0 ? queueDepth : 1),
+    freeQueue(readyQueue.capacity() + 2) {
+  // One frame in the capture stage, one in the encode stage, the rest queued
+  for (size_t i = 0; i < freeQueue.capacity(); i++) {
+    framePool.push_back(std::make_unique<VideoFrame>());
+    freeQueue.tryPush(framePool.back().get());
+  }
+}
+
+VideoPipeline::~VideoPipeline() {
+  stop();
+}
+
+bool VideoPipeline::start(
+    float frameRate, MediaCaptureDataCallback videoCallback, MediaCaptureExitCallback exitCallback, void *context) {
+  if (running.load()) {
+    return false;
+  }
+
+  setFrameRate(frameRate);
+
+  this->videoCallback = videoCallback;
+  this->exitCallback  = exitCallback;
+  this->context       = context;
+
+  failed.store(false);
+  running.store(true);
+  encodeThread  = std::thread(&VideoPipeline::encodeThreadProc, this);
+  captureThread = std::thread(&VideoPipeline::captureThreadProc, this);
+
+  return true;
+}
+
+void VideoPipeline::setFrameRate(float frameRate) {
+  if (frameRate <= 0) {
+    frameRate = 30.0f; // Default frame rate
+  }
+  frameIntervalUs.store(static_cast<int64_t>(1000000.0f / frameRate));
+}
+
+void VideoPipeline::stop() {
+  running.store(false);
+
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+  }
+  wakeCV.notify_all();
+
+  if (captureThread.joinable()) {
+    captureThread.join();
+  }
+  if (encodeThread.joinable()) {
+    encodeThread.join();
+  }
+
+  // Return frames that were never encoded to the free list
+  VideoFrame *frame = nullptr;
+  while (readyQueue.tryPop(frame)) {
+    freeQueue.tryPush(std::move(frame));
+  }
+}
+
+void VideoPipeline::fail(const char *message) {
+  fatalError = message ? message : "";
+  failed.store(true);
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+  }
+  wakeCV.notify_all();
+}
+
+/**
+ * Capture stage: paces acquisition to the frame rate and hands frames to the
+ * encode stage without ever waiting for it
+ */
+void VideoPipeline::captureThreadProc() {
+  setTraceThreadName("video-capture");
+  auto lastFrameTime = std::chrono::steady_clock::now();
+
+  while (running.load() && !failed.load()) {
+    auto interval    = std::chrono::microseconds(frameIntervalUs.load());
+    auto currentTime = std::chrono::steady_clock::now();
+    auto elapsed     = currentTime - lastFrameTime;
+
+    // Frame rate limiting
+    if (elapsed < interval) {
+      std::this_thread::sleep_for(interval - elapsed);
+      currentTime = std::chrono::steady_clock::now();
+    }
+
+    lastFrameTime = currentTime;
+
+    if (!running.load()) {
+      break;
+    }
+
+    VideoFrame *frame = nullptr;
+    if (!freeQueue.tryPop(frame)) {
+      continue;
+    }
+
+    auto     intervalMs = std::chrono::duration_cast<std::chrono::milliseconds>(interval).count();
+    uint32_t timeoutMs  = static_cast<uint32_t>(std::min<int64_t>(500, std::max<int64_t>(100, intervalMs)));
+
+    frame->copyNs              = 0;
+    int64_t       acquireStart = monotonicNowNs();
+    AcquireResult result       = source.acquireFrame(*frame, timeoutMs);
+    int64_t       acquireEnd   = monotonicNowNs();
+
+    if (result != AcquireResult::Frame) {
+      freeQueue.tryPush(std::move(frame));
+      if (result == AcquireResult::Error) {
+        acquireFailures.fetch_add(1, std::memory_order_relaxed);
+      } else if (result == AcquireResult::Fatal) {
+        fail(source.lastAcquireError());
+        break;
+      }
+      continue;
+    }
+
+    int64_t copyNs = std::min(frame->copyNs, acquireEnd - acquireStart);
+    acquireTiming.record(static_cast<uint64_t>(acquireEnd - acquireStart - copyNs));
+    if (copyNs > 0) {
+      copyTiming.record(static_cast<uint64_t>(copyNs));
+    }
+    frame->sequence    = nextSequence.fetch_add(1);
+    frame->acquiredNs  = acquireEnd;
+    frame->timestampMs = wallClockNowMs();
+    traceSpan("acquire", frame->sequence, acquireStart, acquireEnd);
+
+    VideoFrame *evicted = nullptr;
+    if (readyQueue.pushDropOldest(std::move(frame), evicted)) {
+      framesDropped.fetch_add(1, std::memory_order_relaxed);
+      freeQueue.tryPush(std::move(evicted));
+    }
+    framesCaptured.fetch_add(1, std::memory_order_relaxed);
+
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wakeCV.notify_one();
+  }
+}
+
+/**
+ * Encode stage: encodes the oldest queued frame and delivers it. A fatal
+ * source error is reported from here, so no frame callback can follow it.
+ */
+void VideoPipeline::encodeThreadProc() {
+  setTraceThreadName("video-encode");
+  EncodedFrame encoded;
+
+  while (running.load() && !failed.load()) {
+    VideoFrame *frame = nullptr;
+    if (!readyQueue.tryPop(frame)) {
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      wakeCV.wait_for(lock, std::chrono::milliseconds(100), [this] {
+        return readyQueue.sizeApprox() > 0 || !running.load() || failed.load();
+      });
+      continue;
+    }
+
+    int64_t encodeStart = monotonicNowNs();
+    queueWaitTiming.record(static_cast<uint64_t>(std::max<int64_t>(0, encodeStart - frame->acquiredNs)));
+
+    bool     encodedOk   = encoder.encodeFrame(*frame, encoded);
+    int64_t  encodeEnd   = monotonicNowNs();
+    int64_t  timestampMs = frame->timestampMs;
+    int64_t  acquiredNs  = frame->acquiredNs;
+    uint64_t sequence    = frame->sequence;
+    traceSpan("encode", sequence, encodeStart, encodeEnd);
+
+    // Hand the buffer back before delivery so capture can reuse it immediately
+    freeQueue.tryPush(std::move(frame));
+
+    if (!encodedOk) {
+      encodeFailures.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    encodeTiming.record(static_cast<uint64_t>(encodeEnd - encodeStart));
+
+    if (qualityController) {
+      EncodeSample sample;
+      sample.encodeMs    = static_cast<double>(encodeEnd - encodeStart) / 1e6;
+      sample.bytes       = encoded.data.size();
+      sample.queueDepth  = readyQueue.sizeApprox();
+      sample.timestampNs = encodeEnd;
+      if (qualityController->addSample(sample)) {
+        frameIntervalUs.store(static_cast<int64_t>(1000000.0 / qualityController->settings().frameRate));
+      }
+    }
+
+    if (!running.load()) {
+      break;
+    }
+
+    if (videoCallback && !encoded.data.empty()) {
+      std::string timestampStr = std::to_string(timestampMs);
+      setCurrentTraceSequence(sequence);
+      // Looked up at delivery, when the audio captured alongside the frame has usually been reported
+      setCurrentSyncStamp(syncStampAt(syncClock.get(), acquiredNs));
+      videoCallback(
+          encoded.data.data(), encoded.width, encoded.height, encoded.bytesPerRow, timestampStr.c_str(),
+          encoded.format.c_str(), encoded.data.size(), context);
+      setCurrentSyncStamp(SyncStamp());
+      setCurrentTraceSequence(kNoTraceSequence);
+      int64_t deliverEnd = monotonicNowNs();
+      deliverTiming.record(static_cast<uint64_t>(deliverEnd - encodeEnd));
+      traceSpan("deliver", sequence, encodeEnd, deliverEnd);
+      bytesDelivered.fetch_add(encoded.data.size(), std::memory_order_relaxed);
+    }
+    framesEncoded.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // The exit callback may free the context, so it comes once and last; after stop() nobody is listening
+  if (failed.load() && running.load() && exitCallback) {
+    exitCallback(const_cast<char *>(fatalError.c_str()), context);
+  }
+}
+
+VideoPipelineStats VideoPipeline::stats() const {
+  VideoPipelineStats stats;
+  stats.framesCaptured  = framesCaptured.load(std::memory_order_relaxed);
+  stats.framesEncoded   = framesEncoded.load(std::memory_order_relaxed);
+  stats.framesDropped   = framesDropped.load(std::memory_order_relaxed);
+  stats.encodeFailures  = encodeFailures.load(std::memory_order_relaxed);
+  stats.acquireFailures = acquireFailures.load(std::memory_order_relaxed);
+  stats.queueDepth      = readyQueue.sizeApprox();
+  stats.bytesDelivered  = bytesDelivered.load(std::memory_order_relaxed);
+  stats.acquire         = acquireTiming.snapshot();
+  stats.copy            = copyTiming.snapshot();
+  stats.queueWait       = queueWaitTiming.snapshot();
+  stats.encode          = encodeTiming.snapshot();
+  stats.deliver         = deliverTiming.snapshot();
+  return stats;
+}
+
+void VideoPipeline::resetStats() {
+  framesCaptured.store(0);
+  framesEncoded.store(0);
+  framesDropped.store(0);
+  encodeFailures.store(0);
+  acquireFailures.store(0);
+  bytesDelivered.store(0);
+  acquireTiming.reset();
+  copyTiming.reset();
+  queueWaitTiming.reset();
+  encodeTiming.reset();
+  deliverTiming.reset();
+}
@@ -0,0 +1,314 @@
+/**
+ * @file videopipeline.h
+ * @brief Platform-independent two-stage video capture pipeline
+ *
+ * Splits video capture into a capture stage (acquire + CPU copy) and an encode
+ * stage (encode + callback delivery), each on its own thread, connected by a
+ * bounded lock-free queue with a drop-oldest policy. A slow encode therefore
+ * never delays the next acquisition; it only causes older frames to be dropped.
+ *
+ * The platform backends provide a VideoFrameSource and a VideoFrameEncoder;
+ * tests drive the same pipeline with synthetic implementations.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "adaptivequality.h"
+#include "avsync.h"
+#include "capture/capture.h"
+#include "framequeue.h"
+#include "stagetiming.h"
+
+/**
+ * @struct VideoFrame
+ * @brief A raw BGRA frame travelling from the capture stage to the encode stage
+ */
+struct VideoFrame {
+  std::vector<uint8_t> pixels;          /**< Pixel data, bytesPerRow * height bytes */
+  int32_t              width       = 0; /**< Frame width in pixels */
+  int32_t              height      = 0; /**< Frame height in pixels */
+  int32_t              bytesPerRow = 0; /**< Row stride in bytes */
+  int64_t              timestampMs = 0; /**< Wall-clock acquisition time, ms since Unix epoch */
+  int64_t              acquiredNs  = 0; /**< Monotonic acquisition time in nanoseconds */
+  int64_t              copyNs      = 0; /**< Part of the acquisition spent copying pixels, if the source measures it */
+  uint64_t             sequence    = 0; /**< Capture sequence number, starting at 1 */
+};
+
+/**
+ * @struct EncodedFrame
+ * @brief Output of the encode stage handed to the video callback
+ */
+struct EncodedFrame {
+  std::vector<uint8_t> data;            /**< Encoded bytes */
+  int32_t              width       = 0; /**< Frame width in pixels */
+  int32_t              height      = 0; /**< Frame height in pixels */
+  int32_t              bytesPerRow = 0; /**< Row stride of the source frame in bytes */
+  std::string          format;          /**< Format string passed to the callback (e.g. "jpeg") */
+};
+
+/**
+ * @enum AcquireResult
+ * @brief Outcome of a single VideoFrameSource::acquireFrame call
+ */
+enum class AcquireResult {
+  Frame,   /**< A frame was written to the output */
+  Timeout, /**< No new frame was available; try again on the next tick */
+  Error,   /**< This acquisition failed; it is counted and the next tick tries again */
+  Fatal    /**< The source is gone; the pipeline reports lastAcquireError() through the exit callback and stops */
+};
+
+/**
+ * @class VideoFrameSource
+ * @brief Capture stage interface implemented by each platform backend
+ *
+ * Only ever called from the pipeline's capture thread, except targetSize().
+ */
+class VideoFrameSource {
+public:
+  virtual ~VideoFrameSource() = default;
+
+  /**
+   * @brief Acquire the next frame and copy it into CPU memory
+   * @param frame Frame to fill; its pixel buffer is reused between calls
+   * @param timeoutMs Maximum time to wait for a new frame
+   * @return Result of the acquisition
+   */
+  virtual AcquireResult acquireFrame(VideoFrame &frame, uint32_t timeoutMs) = 0;
+
+  /**
+   * @brief Message describing the last AcquireResult::Error or AcquireResult::Fatal
+   */
+  virtual const char *lastAcquireError() const = 0;
+
+  /**
+   * @brief Current size of the whole target, which crop rectangles are resolved against; any thread
+   * @return false if the source does not know it
+   */
+  virtual bool targetSize(int32_t & /*width*/, int32_t & /*height*/) const {
+    return false;
+  }
+};
+
+/**
+ * @class VideoFrameEncoder
+ * @brief Encode stage interface implemented by each platform backend
+ *
+ * Only ever called from the pipeline's encode thread.
+ */
+class VideoFrameEncoder {
+public:
+  virtual ~VideoFrameEncoder() = default;
+
+  /**
+   * @brief Encode a raw frame
+   * @param frame Frame produced by the capture stage
+   * @param out Encoded output; its buffer is reused between calls
+   * @return true if successful, false otherwise
+   */
+  virtual bool encodeFrame(const VideoFrame &frame, EncodedFrame &out) = 0;
+
+  /**
+   * @brief Message describing the last encode failure
+   */
+  virtual const char *lastEncodeError() const = 0;
+};
+
+/**
+ * @struct VideoPipelineStats
+ * @brief Counters and per-stage timings of a VideoPipeline
+ */
+struct VideoPipelineStats {
+  uint64_t            framesCaptured  = 0; /**< Frames produced by the capture stage */
+  uint64_t            framesEncoded   = 0; /**< Frames successfully encoded and delivered */
+  uint64_t            framesDropped   = 0; /**< Frames evicted from the queue before encoding */
+  uint64_t            encodeFailures  = 0; /**< Frames the encoder failed on */
+  uint64_t            acquireFailures = 0; /**< Acquisitions that failed with AcquireResult::Error */
+  uint64_t            queueDepth      = 0; /**< Frames currently waiting for the encoder */
+  uint64_t            bytesDelivered  = 0; /**< Encoded bytes handed to the video callback */
+  StageTimingSnapshot acquire;             /**< Acquire, excluding the pixel copy when the source measures it */
+  StageTimingSnapshot copy;                /**< Pixel copy out of the system buffer (empty if not measured) */
+  StageTimingSnapshot queueWait;           /**< Time a frame spent queued before encoding */
+  StageTimingSnapshot encode;              /**< Encoding */
+  StageTimingSnapshot deliver;             /**< Video callback invocation */
+};
+
+/**
+ * @class VideoPipeline
+ * @brief Runs a VideoFrameSource and a VideoFrameEncoder on separate threads
+ *
+ * The pipeline owns queueDepth + 2 frame buffers: up to queueDepth queued, one
+ * being filled by the capture stage and one being encoded. Buffers circulate
+ * through a free list, so steady-state capture performs no allocations.
+ */
+class VideoPipeline {
+public:
+  /** Default number of frames held between the stages */
+  static constexpr size_t kDefaultQueueDepth = 2;
+
+  /**
+   * @brief Constructor
+   * @param source Capture stage implementation; must outlive the pipeline
+   * @param encoder Encode stage implementation; must outlive the pipeline
+   * @param queueDepth Number of frames held between the stages
+   */
+  VideoPipeline(VideoFrameSource &source, VideoFrameEncoder &encoder, size_t queueDepth = kDefaultQueueDepth);
+
+  /**
+   * @brief Destructor - stops the pipeline if it is running
+   */
+  ~VideoPipeline();
+
+  VideoPipeline(const VideoPipeline &)            = delete;
+  VideoPipeline &operator=(const VideoPipeline &) = delete;
+
+  /**
+   * @brief Start the capture and encode threads
+   * @param frameRate Target capture rate in frames per second (<= 0 selects 30)
+   * @param videoCallback Function called with each encoded frame
+   * @param exitCallback Function called at most once, after the last frame, when the source fails for good;
+   *                     the pipeline stops capturing then. Frames that fail to acquire or encode are only counted.
+   * @param context User data passed to callbacks
+   * @return true if started, false if already running
+   */
+  bool start(
+      float frameRate, MediaCaptureDataCallback videoCallback, MediaCaptureExitCallback exitCallback, void *context);
+
+  /**
+   * @brief Stop both threads and wait for them to exit
+   *
+   * Frames still queued are discarded.
+   */
+  void stop();
+
+  /**
+   * @brief Whether the pipeline threads are running
+   */
+  bool isRunning() const {
+    return running.load();
+  }
+
+  /**
+   * @brief Change the capture rate while running; the next frame is paced by it
+   * @param frameRate Frames per second (<= 0 selects 30)
+   */
+  void setFrameRate(float frameRate);
+
+  /**
+   * @brief Current frame interval of the capture stage
+   */
+  std::chrono::microseconds frameInterval() const {
+    return std::chrono::microseconds(frameIntervalUs.load());
+  }
+
+  /**
+   * @brief Feed per-frame encode cost to an adaptive quality controller
+   *
+   * Must be called before start(). The pipeline applies the controller's
+   * frame rate itself; the encoder reads quality and downscale from the same
+   * controller.
+   */
+  void setQualityController(std::shared_ptr<AdaptiveQualityController> controller) {
+    qualityController = std::move(controller);
+  }
+
+  /**
+   * @brief Stamp each delivered frame with the audio position of its acquisition time
+   *
+   * Must be called before start(). Without a clock, frames are stamped with
+   * their acquisition time only.
+   */
+  void setSyncClock(std::shared_ptr<AvSyncClock> clock) {
+    syncClock = std::move(clock);
+  }
+
+  /**
+   * @brief Take a snapshot of counters and stage timings
+   */
+  VideoPipelineStats stats() const;
+
+  /**
+   * @brief Reset counters and stage timings
+   */
+  void resetStats();
+
+private:
+  /** Capture thread: paces, acquires and enqueues frames */
+  void captureThreadProc();
+
+  /** Encode thread: dequeues, encodes and delivers frames */
+  void encodeThreadProc();
+
+  /** Record a fatal source error and wake the encode thread, which reports it */
+  void fail(const char *message);
+
+  VideoFrameSource  &source;
+  VideoFrameEncoder &encoder;
+
+  /** Storage for all frame buffers owned by the pipeline */
+  std::vector<std::unique_ptr<VideoFrame>> framePool;
+
+  /** Frames ready for encoding, oldest first */
+  BoundedFrameQueue<VideoFrame *> readyQueue;
+
+  /** Frames available to the capture stage */
+  BoundedFrameQueue<VideoFrame *> freeQueue;
+
+  /** Target interval between captures in microseconds */
+  std::atomic<int64_t> frameIntervalUs{1000000};
+
+  std::atomic<bool> running{false};
+  std::thread       captureThread;
+  std::thread       encodeThread;
+
+  /** Set by the capture thread once the source has failed for good; fatalError is written before */
+  std::atomic<bool> failed{false};
+  std::string       fatalError;
+
+  /** Used only to park the encode thread while the queue is empty */
+  std::mutex              wakeMutex;
+  std::condition_variable wakeCV;
+
+  /** Optional closed-loop controller fed from the encode thread */
+  std::shared_ptr<AdaptiveQualityController> qualityController;
+
+  /** Optional clock shared with the audio source */
+  std::shared_ptr<AvSyncClock> syncClock;
+
+  MediaCaptureDataCallback videoCallback = nullptr;
+  MediaCaptureExitCallback exitCallback  = nullptr;
+  void                    *context       = nullptr;
+
+  /** @name Statistics */
+  ///@{
+  std::atomic<uint64_t> nextSequence{1};
+  std::atomic<uint64_t> framesCaptured{0};
+  std::atomic<uint64_t> framesEncoded{0};
+  std::atomic<uint64_t> framesDropped{0};
+  std::atomic<uint64_t> encodeFailures{0};
+  std::atomic<uint64_t> acquireFailures{0};
+  std::atomic<uint64_t> bytesDelivered{0};
+  StageTiming           acquireTiming;
+  StageTiming           copyTiming;
+  StageTiming           queueWaitTiming;
+  StageTiming           encodeTiming;
+  StageTiming           deliverTiming;
+  ///@}
+};
+
+/**
+ * @brief Current monotonic time in nanoseconds
+ */
+int64_t monotonicNowNs();
+
+/**
+ * @brief Current wall-clock time in milliseconds since the Unix epoch
+ */
+int64_t wallClockNowMs();
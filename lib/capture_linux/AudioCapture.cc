@@ -0,0 +1,68 @@
+#include "capture/capture.h"
+#include "mediacaptureclient.h"
+#include "syntheticconfig.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * Legacy audio-only C API for Linux
+ *
+ * The deprecated AudioCapture entry points run on the same MediaCaptureClient
+ * as startMediaCapture, with video disabled.
+ */
+
+extern "C" {
+
+void enumerateDesktopWindows(EnumerateDesktopWindowsCallback cb, void *ctx) {
+  SyntheticConfig synthetic = syntheticConfigFromEnvironment();
+
+  std::vector<DisplayInfo> displays;
+  for (size_t i = 0; i < synthetic.displays.size(); i++) {
+    displays.push_back({static_cast<uint32_t>(i + 1)});
+  }
+
+  std::vector<std::string> windowTitleStrings;
+  std::vector<WindowInfo>  windows;
+  windowTitleStrings.reserve(synthetic.windows.size());
+  for (size_t i = 0; i < synthetic.windows.size(); i++) {
+    windowTitleStrings.push_back("Synthetic Window " + std::to_string(i + 1));
+    windows.push_back({static_cast<uint32_t>(i + 1), const_cast<char *>(windowTitleStrings.back().c_str())});
+  }
+
+  cb(displays.data(), static_cast<int32_t>(displays.size()), windows.data(), static_cast<int32_t>(windows.size()),
+     nullptr, ctx);
+}
+
+void *createCapture(void) {
+  return new MediaCaptureClient();
+}
+
+void destroyCapture(void *client) {
+  delete static_cast<MediaCaptureClient *>(client);
+}
+
+void startCapture(
+    void *client, CaptureConfig cc, StartCaptureDataCallback dataCallback, StartCaptureExitCallback exitCallback,
+    void *context) {
+  MediaCaptureConfigC config;
+  std::memset(&config, 0, sizeof(config));
+  config.audioSampleRate = cc.sampleRate;
+  config.audioChannels   = cc.channels;
+
+  // The callback types are identical; displayID and windowID only select the audio source on other platforms
+  static_cast<MediaCaptureClient *>(client)->startCapture(config, nullptr, dataCallback, exitCallback, context);
+}
+
+void stopCapture(void *client, StopCaptureCallback stopCallback, void *context) {
+  static_cast<MediaCaptureClient *>(client)->stopCapture(stopCallback, context);
+}
+
+int32_t getCaptureStats(void *client, MediaCaptureStatsC *stats) {
+  if (!client || !stats) {
+    return 0;
+  }
+  return static_cast<MediaCaptureClient *>(client)->getStats(*stats) ? 1 : 0;
+}
+
+} // extern "C"
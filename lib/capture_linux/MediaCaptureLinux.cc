@@ -0,0 +1,174 @@
+#include "capture/capture.h"
+#include "mediacaptureclient.h"
+
+/**
+ * C API implementation for MediaCaptureLinux
+ *
+ * This file implements the C interface defined in capture.h
+ * and delegates to the C++ MediaCaptureClient class
+ */
+
+extern "C" {
+
+/**
+ * Create a media capture instance
+ */
+void *createMediaCapture(void) {
+  return new MediaCaptureClient();
+}
+
+/**
+ * Destroy a media capture instance
+ */
+void destroyMediaCapture(void *capture) {
+  delete static_cast<MediaCaptureClient *>(capture);
+}
+
+/**
+ * Enumerate available media capture targets
+ */
+void enumerateMediaCaptureTargets(int32_t targetType, EnumerateMediaCaptureTargetsCallback callback, void *context) {
+  MediaCaptureClient::enumerateTargets(targetType, callback, context);
+}
+
+/**
+ * Open capture resources for the next start; the callback runs before this returns
+ */
+void prepareMediaCapture(void *capture, MediaCaptureConfigC config, MediaCaptureExitCallback callback, void *context) {
+  std::string error = capture ? "" : "Invalid media capture instance";
+  if (capture) {
+    static_cast<MediaCaptureClient *>(capture)->prepare(config, error);
+  }
+  if (callback) {
+    callback(error.empty() ? nullptr : const_cast<char *>(error.c_str()), context);
+  }
+}
+
+/**
+ * Start media capture
+ *
+ * Failures are reported through exitCallback by MediaCaptureClient itself.
+ */
+void startMediaCapture(
+    void *capture, MediaCaptureConfigC config, MediaCaptureDataCallback videoCallback,
+    MediaCaptureAudioDataCallback audioCallback, MediaCaptureExitCallback exitCallback, void *context) {
+  if (!capture) {
+    if (exitCallback) {
+      exitCallback(const_cast<char *>("Invalid media capture instance"), context);
+    }
+    return;
+  }
+
+  MediaCaptureClient *client = static_cast<MediaCaptureClient *>(capture);
+  client->startCapture(config, videoCallback, audioCallback, exitCallback, context);
+}
+
+/**
+ * Start media capture of several targets on shared threads
+ *
+ * Failures are reported through exitCallback by MediaCaptureClient itself.
+ */
+void startMultiTargetMediaCapture(
+    void *capture, MediaCaptureConfigC config, const MediaCaptureTargetRefC *targets, int32_t targetCount,
+    MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback, void *context) {
+  if (!capture) {
+    if (exitCallback) {
+      exitCallback(const_cast<char *>("Invalid media capture instance"), context);
+    }
+    return;
+  }
+
+  MediaCaptureClient *client = static_cast<MediaCaptureClient *>(capture);
+  client->startMultiTargetCapture(config, targets, targetCount, videoCallback, audioCallback, exitCallback, context);
+}
+
+/**
+ * Start media capture of one target in several renditions on shared threads
+ *
+ * Failures are reported through exitCallback by MediaCaptureClient itself.
+ */
+void startMultiRenditionMediaCapture(
+    void *capture, MediaCaptureConfigC config, const MediaCaptureRenditionC *renditions, int32_t renditionCount,
+    MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback, void *context) {
+  if (!capture) {
+    if (exitCallback) {
+      exitCallback(const_cast<char *>("Invalid media capture instance"), context);
+    }
+    return;
+  }
+
+  MediaCaptureClient *client = static_cast<MediaCaptureClient *>(capture);
+  client->startMultiRenditionCapture(
+      config, renditions, renditionCount, videoCallback, audioCallback, exitCallback, context);
+}
+
+/**
+ * Stop media capture
+ */
+void stopMediaCapture(void *capture, StopCaptureCallback stopCallback, void *context) {
+  if (!capture) {
+    if (stopCallback) {
+      stopCallback(context);
+    }
+    return;
+  }
+
+  MediaCaptureClient *client = static_cast<MediaCaptureClient *>(capture);
+  client->stopCapture(stopCallback, context);
+}
+
+/**
+ * Update the region of interest of a running media capture; the callback runs before this returns
+ */
+void setMediaCaptureCropRect(
+    void *capture, MediaCaptureRectC cropRect, MediaCaptureExitCallback callback, void *context) {
+  std::string error = capture ? "" : "Invalid media capture instance";
+  if (capture) {
+    static_cast<MediaCaptureClient *>(capture)->setCropRect(cropRect, error);
+  }
+  if (callback) {
+    callback(error.empty() ? nullptr : const_cast<char *>(error.c_str()), context);
+  }
+}
+
+/**
+ * Apply a new configuration to a running media capture; the callback runs before this returns
+ */
+void reconfigureMediaCapture(
+    void *capture, MediaCaptureConfigC config, MediaCaptureExitCallback callback, void *context) {
+  std::string error = capture ? "" : "Invalid media capture instance";
+  if (capture) {
+    static_cast<MediaCaptureClient *>(capture)->reconfigure(config, error);
+  }
+  if (callback) {
+    callback(error.empty() ? nullptr : const_cast<char *>(error.c_str()), context);
+  }
+}
+
+/**
+ * Read the adaptive quality controller of a running media capture
+ */
+int32_t getMediaCaptureQualityStats(void *capture, MediaCaptureQualityStatsC *stats) {
+  if (!capture || !stats) {
+    return 0;
+  }
+
+  MediaCaptureClient *client = static_cast<MediaCaptureClient *>(capture);
+  return client->getQualityStats(*stats) ? 1 : 0;
+}
+
+/**
+ * Read the counters and stage latencies of a media capture
+ */
+int32_t getMediaCaptureStats(void *capture, MediaCaptureStatsC *stats) {
+  if (!capture || !stats) {
+    return 0;
+  }
+
+  MediaCaptureClient *client = static_cast<MediaCaptureClient *>(capture);
+  return client->getStats(*stats) ? 1 : 0;
+}
+
+} // extern "C"
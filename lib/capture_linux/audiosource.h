@@ -0,0 +1,99 @@
+/**
+ * @file audiosource.h
+ * @brief Audio capture interface implemented by the Linux audio backends
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include "avsync.h"
+#include "capture/capture.h"
+#include "capturestats.h"
+
+/**
+ * @class AudioSource
+ * @brief Delivers interleaved float audio to a MediaCaptureAudioDataCallback
+ *
+ * Each implementation owns its delivery thread. start() and stop() are called
+ * from the thread that owns the capture, never concurrently. Every callback
+ * runs with a SyncStamp set (see currentSyncStamp()).
+ */
+class AudioSource {
+public:
+  virtual ~AudioSource() = default;
+
+  /**
+   * @brief Open the audio device ahead of start() without delivering anything
+   *
+   * A following start() with the same format reuses what this opened. The
+   * default does nothing, for sources with nothing worth opening early.
+   *
+   * @param sampleRate Requested sample rate in Hz
+   * @param channels Requested number of interleaved channels
+   * @return false if the device could not be opened; lastError() describes why
+   */
+  virtual bool prepare(int32_t sampleRate, int32_t channels) {
+    (void)sampleRate;
+    (void)channels;
+    return true;
+  }
+
+  /**
+   * @brief Start delivering audio
+   * @param sampleRate Requested sample rate in Hz
+   * @param channels Requested number of interleaved channels
+   * @param audioCallback Function called with each block of samples
+   * @param exitCallback Function called if delivery fails after starting
+   * @param context User data passed to callbacks
+   * @return false if the source could not be started; lastError() describes why
+   */
+  virtual bool start(
+      int32_t sampleRate, int32_t channels, MediaCaptureAudioDataCallback audioCallback,
+      MediaCaptureExitCallback exitCallback, void *context) = 0;
+
+  /**
+   * @brief Change the delivered sample rate and channel count while running, between two blocks
+   *
+   * The default cannot; the caller then restarts the source in the new format.
+   *
+   * @return false if the source has to be restarted for the change
+   */
+  virtual bool setFormat(int32_t sampleRate, int32_t channels) {
+    (void)sampleRate;
+    (void)channels;
+    return false;
+  }
+
+  /**
+   * @brief Stop delivery and wait for the delivery thread to exit
+   *
+   * No callback is invoked after stop() returns.
+   */
+  virtual void stop() = 0;
+
+  /**
+   * @brief Message describing the last failure
+   */
+  virtual const char *lastError() const = 0;
+
+  /**
+   * @brief Report delivered blocks to a clock shared with the video pipeline; call before start()
+   */
+  void setSyncClock(std::shared_ptr<AvSyncClock> clock) {
+    syncClock = std::move(clock);
+  }
+
+  /**
+   * @brief Counters and stage timings since the source was created
+   */
+  AudioStatsSnapshot stats() const {
+    return audioStats.snapshot();
+  }
+
+protected:
+  /** Updated by the implementation's threads */
+  AudioStats audioStats;
+
+  /** Optional clock fed with the capture time of every block */
+  std::shared_ptr<AvSyncClock> syncClock;
+};
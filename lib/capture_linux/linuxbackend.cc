@@ -0,0 +1,64 @@
+/**
+ * @file linuxbackend.cc
+ * @brief Implementation of the Linux backend selection
+ */
+#include "linuxbackend.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef CAPTURE_HAVE_PULSE
+#include "pulseaudiosource.h"
+#endif
+#ifdef CAPTURE_HAVE_X11
+#include "x11capture.h"
+#endif
+
+VideoBackend videoBackendFromEnvironment() {
+  const char *name = std::getenv("DESKTOP_CAPTURE_VIDEO_BACKEND");
+  if (name && std::strcmp(name, "synthetic") == 0) {
+    return VideoBackend::Synthetic;
+  }
+  if (name && std::strcmp(name, "x11") == 0) {
+#ifdef CAPTURE_HAVE_X11
+    return VideoBackend::X11;
+#else
+    std::fprintf(stderr, "DESKTOP_CAPTURE_VIDEO_BACKEND=x11 ignored: built without X11\n");
+    return VideoBackend::Synthetic;
+#endif
+  }
+  if (name && *name && std::strcmp(name, "auto") != 0) {
+    std::fprintf(stderr, "DESKTOP_CAPTURE_VIDEO_BACKEND=%s ignored: expected x11, synthetic or auto\n", name);
+  }
+
+#ifdef CAPTURE_HAVE_X11
+  if (!std::getenv("DESKTOP_CAPTURE_SYNTHETIC") && x11DisplayAvailable()) {
+    return VideoBackend::X11;
+  }
+#endif
+  return VideoBackend::Synthetic;
+}
+
+AudioBackend audioBackendFromEnvironment() {
+  const char *name = std::getenv("DESKTOP_CAPTURE_AUDIO_BACKEND");
+  if (name && std::strcmp(name, "synthetic") == 0) {
+    return AudioBackend::Synthetic;
+  }
+  if (name && std::strcmp(name, "pulse") == 0) {
+#ifdef CAPTURE_HAVE_PULSE
+    return AudioBackend::Pulse;
+#else
+    std::fprintf(stderr, "DESKTOP_CAPTURE_AUDIO_BACKEND=pulse ignored: built without libpulse\n");
+    return AudioBackend::Synthetic;
+#endif
+  }
+  if (name && *name && std::strcmp(name, "auto") != 0) {
+    std::fprintf(stderr, "DESKTOP_CAPTURE_AUDIO_BACKEND=%s ignored: expected pulse, synthetic or auto\n", name);
+  }
+
+#ifdef CAPTURE_HAVE_PULSE
+  if (!std::getenv("DESKTOP_CAPTURE_SYNTHETIC") && pulseServerAvailable()) {
+    return AudioBackend::Pulse;
+  }
+#endif
+  return AudioBackend::Synthetic;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file linuxbackend.h
+ * @brief Selection between the Linux capture backends
+ *
+ * DESKTOP_CAPTURE_VIDEO_BACKEND selects where frames and video targets come
+ * from: "x11" or "synthetic". When it is unset (or "auto") X11 is used if the
+ * module was built with it, $DISPLAY is reachable and no synthetic
+ * configuration has been given in DESKTOP_CAPTURE_SYNTHETIC.
+ *
+ * DESKTOP_CAPTURE_AUDIO_BACKEND does the same for audio with "pulse" or
+ * "synthetic"; auto picks PulseAudio (or PipeWire through pipewire-pulse) when
+ * the module was built with libpulse and a server socket is present.
+ */
+#pragma once
+
+/**
+ * @enum VideoBackend
+ * @brief Source of video targets and frames
+ */
+enum class VideoBackend {
+  Synthetic, /**< Test patterns, see syntheticconfig.h */
+  X11        /**< MIT-SHM screen and window capture, see x11capture.h */
+};
+
+/**
+ * @brief Video backend selected by the environment
+ */
+VideoBackend videoBackendFromEnvironment();
+
+/**
+ * @enum AudioBackend
+ * @brief Source of audio samples
+ */
+enum class AudioBackend {
+  Synthetic, /**< Generated signal, see syntheticaudio.h */
+  Pulse      /**< PulseAudio or PipeWire monitor/microphone, see pulseaudiosource.h */
+};
+
+/**
+ * @brief Audio backend selected by the environment
+ */
+AudioBackend audioBackendFromEnvironment();
@@ -0,0 +1,668 @@
+/**
+ * @file mediacaptureclient.cc
+ * @brief Linux implementation of media (audio and video) capture functionality
+ */
+#include "mediacaptureclient.h"
+#include "jpegcodec.h"
+#include "linuxbackend.h"
+#include "multitargetpipeline.h"
+#include "renditionpipeline.h"
+#include "syntheticaudio.h"
+#include "syntheticconfig.h"
+#include "videocaptureimpl.h"
+#include <string>
+#include <vector>
+#ifdef CAPTURE_HAVE_PULSE
+#include "pulseaudiosource.h"
+#endif
+#ifdef CAPTURE_HAVE_X11
+#include "x11capture.h"
+#endif
+
+namespace {
+
+bool isAudioTarget(uint32_t windowID) {
+  return windowID == MediaCaptureClient::kSystemAudioTargetID || windowID == MediaCaptureClient::kMicrophoneTargetID;
+}
+
+/** Lists system audio and microphone first, like the Windows backend, when audio comes from a sound server */
+void appendAudioTargets(int32_t targetType, std::vector<MediaCaptureTargetC> &targets) {
+  if (targetType != 0 || audioBackendFromEnvironment() != AudioBackend::Pulse) {
+    return;
+  }
+
+  MediaCaptureTargetC output = {};
+  output.isWindow            = 1;
+  output.windowID            = MediaCaptureClient::kSystemAudioTargetID;
+  output.title               = const_cast<char *>("System Audio Output");
+  output.appName             = const_cast<char *>("Desktop Audio");
+  targets.push_back(output);
+
+  MediaCaptureTargetC microphone = {};
+  microphone.isWindow            = 1;
+  microphone.windowID            = MediaCaptureClient::kMicrophoneTargetID;
+  microphone.title               = const_cast<char *>("Microphone Input");
+  microphone.appName             = const_cast<char *>("Microphone");
+  targets.push_back(microphone);
+}
+
+} // namespace
+
+MediaCaptureClient::MediaCaptureClient() = default;
+
+MediaCaptureClient::~MediaCaptureClient() {
+  if (isCapturing.load()) {
+    stopCapture(nullptr, nullptr);
+  }
+}
+
+bool MediaCaptureClient::prepare(const MediaCaptureConfigC &config, std::string &error) {
+  std::lock_guard<std::mutex> lock(captureMutex);
+
+  if (isCapturing.load()) {
+    error = "Capture already in progress";
+    return false;
+  }
+  releasePrepared();
+
+  if (!isAudioTarget(config.windowID) && (config.displayID > 0 || config.windowID > 0)) {
+    preparedVideo = std::make_unique<VideoCaptureImpl>();
+    if (!preparedVideo->open(config)) {
+      error = preparedVideo->lastEncodeError();
+      releasePrepared();
+      return false;
+    }
+  }
+
+  preparedAudio = createAudioSource(config);
+  if (!preparedAudio->prepare(config.audioSampleRate, config.audioChannels)) {
+    error = preparedAudio->lastError();
+    releasePrepared();
+    return false;
+  }
+
+  preparedConfig          = config;
+  preparedConfig.bundleID = nullptr;
+  return true;
+}
+
+bool MediaCaptureClient::startCapture(
+    const MediaCaptureConfigC &config, MediaCaptureDataCallback videoCallback,
+    MediaCaptureAudioDataCallback audioCallback, MediaCaptureExitCallback exitCallback, void *context) {
+  std::lock_guard<std::mutex> lock(captureMutex);
+
+  if (isCapturing.load()) {
+    if (exitCallback) {
+      exitCallback(const_cast<char *>("Capture already in progress"), context);
+    }
+    return false;
+  }
+
+  std::string error;
+  bool        started = beginCapture(config, videoCallback, audioCallback, exitCallback, context, error);
+
+  // Whatever was prepared and not used would only hold the device
+  releasePrepared();
+
+  // The exit callback is the last callback the caller sees
+  if (!started) {
+    if (exitCallback) {
+      exitCallback(const_cast<char *>(error.c_str()), context);
+    }
+    return false;
+  }
+
+  isCapturing.store(true);
+  return true;
+}
+
+bool MediaCaptureClient::startMultiTargetCapture(
+    const MediaCaptureConfigC &config, const MediaCaptureTargetRefC *targets, int32_t targetCount,
+    MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback, void *context) {
+  std::lock_guard<std::mutex> lock(captureMutex);
+
+  if (isCapturing.load()) {
+    if (exitCallback) {
+      exitCallback(const_cast<char *>("Capture already in progress"), context);
+    }
+    return false;
+  }
+
+  std::string error;
+  bool        started =
+      beginMultiTargetCapture(config, targets, targetCount, videoCallback, audioCallback, exitCallback, context, error);
+  releasePrepared();
+
+  if (!started) {
+    if (exitCallback) {
+      exitCallback(const_cast<char *>(error.c_str()), context);
+    }
+    return false;
+  }
+
+  isCapturing.store(true);
+  return true;
+}
+
+bool MediaCaptureClient::startMultiRenditionCapture(
+    const MediaCaptureConfigC &config, const MediaCaptureRenditionC *renditions, int32_t renditionCount,
+    MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback, void *context) {
+  std::lock_guard<std::mutex> lock(captureMutex);
+
+  if (isCapturing.load()) {
+    if (exitCallback) {
+      exitCallback(const_cast<char *>("Capture already in progress"), context);
+    }
+    return false;
+  }
+
+  std::string error;
+  bool        started = beginRenditionCapture(
+      config, renditions, renditionCount, videoCallback, audioCallback, exitCallback, context, error);
+  releasePrepared();
+
+  if (!started) {
+    if (exitCallback) {
+      exitCallback(const_cast<char *>(error.c_str()), context);
+    }
+    return false;
+  }
+
+  isCapturing.store(true);
+  return true;
+}
+
+bool MediaCaptureClient::reconfigure(const MediaCaptureConfigC &config, std::string &error) {
+  std::lock_guard<std::mutex> lock(captureMutex);
+
+  if (!isCapturing.load()) {
+    error = "No capture in progress";
+    return false;
+  }
+
+  MediaCaptureConfigC next = config;
+  next.bundleID            = nullptr;
+
+  // Another display, window or audio device is a new capture; so is a controller a shared pipeline cannot gain
+  bool restart   = next.displayID != active.config.displayID || next.windowID != active.config.windowID;
+  bool addBudget = next.maxEncodeMsPerFrame > 0 || next.maxBytesPerSecond > 0;
+  for (auto &target : targetImpls) {
+    restart = restart || (addBudget && !target->adaptiveQuality());
+  }
+  // Renditions take their unset frame rate and quality from the configuration when they start
+  bool newDefaults = next.frameRate != active.config.frameRate || next.quality != active.config.quality ||
+                     next.qualityValue != active.config.qualityValue;
+  restart = restart || (renditionPipeline && newDefaults);
+  if (restart) {
+    return restartCapture(next, error);
+  }
+
+  // Encoder and pacer settings change between two frames
+  if (videoImpl && !videoImpl->reconfigure(next)) {
+    error = videoImpl->lastEncodeError();
+    return false;
+  }
+  for (size_t i = 0; i < targetImpls.size(); i++) {
+    MediaCaptureConfigC targetConfig = next;
+    targetConfig.displayID           = active.targets[i].displayID;
+    targetConfig.windowID            = active.targets[i].windowID;
+    targetConfig.cropRect            = active.targets[i].cropRect;
+    if (!targetImpls[i]->reconfigure(targetConfig)) {
+      error = "Target " + std::to_string(i) + ": " + targetImpls[i]->lastEncodeError();
+      return false;
+    }
+  }
+  if (targetPipeline) {
+    targetPipeline->setFrameRate(next.frameRate);
+  }
+  if (renditionSource) {
+    renditionSource->setCropRect(next.cropRect);
+  }
+
+  // The audio format changes between two blocks, or the source alone restarts on the same clock
+  bool newFormat =
+      next.audioSampleRate != active.config.audioSampleRate || next.audioChannels != active.config.audioChannels;
+  if (audioImpl && newFormat && !audioImpl->setFormat(next.audioSampleRate, next.audioChannels)) {
+    audioImpl->stop();
+    if (!startAudio(next, active.audioCallback, active.exitCallback, active.context, syncClock, error)) {
+      // Like a device failure while running, this ends the capture
+      releaseAll();
+      isCapturing.store(false);
+      if (active.exitCallback) {
+        active.exitCallback(const_cast<char *>(error.c_str()), active.context);
+      }
+      return false;
+    }
+  }
+
+  active.config = next;
+  return true;
+}
+
+bool MediaCaptureClient::restartCapture(const MediaCaptureConfigC &config, std::string &error) {
+  releaseAll();
+
+  // begin*() record the new session in active, so they get copies
+  ActiveCapture previous = active;
+  bool          started  = false;
+  if (!previous.renditions.empty()) {
+    started = beginRenditionCapture(
+        config, previous.renditions.data(), static_cast<int32_t>(previous.renditions.size()), previous.targetCallback,
+        previous.audioCallback, previous.exitCallback, previous.context, error);
+  } else if (!previous.targets.empty()) {
+    started = beginMultiTargetCapture(
+        config, previous.targets.data(), static_cast<int32_t>(previous.targets.size()), previous.targetCallback,
+        previous.audioCallback, previous.exitCallback, previous.context, error);
+  } else {
+    started = beginCapture(config, previous.videoCallback, previous.audioCallback, previous.exitCallback,
+                           previous.context, error);
+  }
+  if (!started) {
+    isCapturing.store(false);
+    if (previous.exitCallback) {
+      previous.exitCallback(const_cast<char *>(error.c_str()), previous.context);
+    }
+    return false;
+  }
+  return true;
+}
+
+bool MediaCaptureClient::beginCapture(
+    const MediaCaptureConfigC &config, MediaCaptureDataCallback videoCallback,
+    MediaCaptureAudioDataCallback audioCallback, MediaCaptureExitCallback exitCallback, void *context,
+    std::string &error) {
+  bool audioOnly = isAudioTarget(config.windowID);
+  bool wantVideo = videoCallback && !audioOnly && (config.displayID > 0 || config.windowID > 0);
+
+  if (!audioCallback && !wantVideo) {
+    error = "Nothing to capture: no audio callback and no video target";
+  }
+
+  // One clock per session relates the audio sample positions to the video acquisition times
+  syncClock = std::make_shared<AvSyncClock>();
+
+  if (error.empty() && audioCallback) {
+    startAudio(config, audioCallback, exitCallback, context, syncClock, error);
+  }
+
+  if (error.empty() && wantVideo) {
+    bool samePrepared = preparedVideo && preparedConfig.displayID == config.displayID &&
+                        preparedConfig.windowID == config.windowID;
+    videoImpl = samePrepared ? std::move(preparedVideo) : std::make_unique<VideoCaptureImpl>();
+    if (!videoImpl->start(config, videoCallback, exitCallback, context, syncClock)) {
+      error = videoImpl->lastEncodeError();
+    }
+  }
+
+  // A partial start is rolled back
+  if (!error.empty()) {
+    releaseAll();
+    return false;
+  }
+
+  active                 = ActiveCapture();
+  active.config          = config;
+  active.config.bundleID = nullptr;
+  active.videoCallback   = videoCallback;
+  active.audioCallback   = audioCallback;
+  active.exitCallback    = exitCallback;
+  active.context         = context;
+  return true;
+}
+
+bool MediaCaptureClient::beginMultiTargetCapture(
+    const MediaCaptureConfigC &config, const MediaCaptureTargetRefC *targets, int32_t targetCount,
+    MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback, void *context, std::string &error) {
+  if (!targets || targetCount < 1 || !videoCallback) {
+    error = "Nothing to capture: no video targets";
+  }
+
+  // Every target is opened before any thread starts, so a bad target fails the whole start
+  if (error.empty()) {
+    targetPipeline = std::make_unique<MultiTargetPipeline>();
+    for (int32_t i = 0; i < targetCount; i++) {
+      MediaCaptureConfigC targetConfig = config;
+      targetConfig.displayID           = targets[i].displayID;
+      targetConfig.windowID            = targets[i].windowID;
+      targetConfig.cropRect            = targets[i].cropRect;
+      if (isAudioTarget(targetConfig.windowID) || (targetConfig.displayID == 0 && targetConfig.windowID == 0)) {
+        error = "Target " + std::to_string(i) + " is not a display or window";
+        break;
+      }
+
+      auto target = std::make_unique<VideoCaptureImpl>();
+      if (!target->open(targetConfig)) {
+        error = "Target " + std::to_string(i) + ": " + target->lastEncodeError();
+        break;
+      }
+      targetPipeline->addTarget(target->frameSource(), *target, target->adaptiveQuality());
+      targetImpls.push_back(std::move(target));
+    }
+  }
+
+  syncClock = std::make_shared<AvSyncClock>();
+  if (error.empty() && audioCallback) {
+    startAudio(config, audioCallback, exitCallback, context, syncClock, error);
+  }
+
+  if (!error.empty()) {
+    releaseAll();
+    return false;
+  }
+
+  targetPipeline->setSyncClock(syncClock);
+  targetPipeline->start(config.frameRate, videoCallback, exitCallback, context);
+
+  active                 = ActiveCapture();
+  active.config          = config;
+  active.config.bundleID = nullptr;
+  active.targets.assign(targets, targets + targetCount);
+  active.targetCallback = videoCallback;
+  active.audioCallback  = audioCallback;
+  active.exitCallback   = exitCallback;
+  active.context        = context;
+  return true;
+}
+
+bool MediaCaptureClient::beginRenditionCapture(
+    const MediaCaptureConfigC &config, const MediaCaptureRenditionC *renditions, int32_t renditionCount,
+    MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback, void *context, std::string &error) {
+  if (!renditions || renditionCount < 1 || !videoCallback) {
+    error = "Nothing to capture: no video renditions";
+  } else if (isAudioTarget(config.windowID) || (config.displayID == 0 && config.windowID == 0)) {
+    error = "Renditions need a display or window target";
+  }
+  for (int32_t i = 0; error.empty() && i < renditionCount; i++) {
+    if (renditions[i].imageFormat != 1 && !jpegCodecAvailable()) {
+      error = "JPEG output is unavailable: built without libjpeg";
+    }
+  }
+
+  // The source only delivers BGRA; each rendition scales and encodes its own copy
+  if (error.empty()) {
+    MediaCaptureConfigC sourceConfig = config;
+    sourceConfig.imageFormat         = 1;
+    sourceConfig.maxEncodeMsPerFrame = 0;
+    sourceConfig.maxBytesPerSecond   = 0;
+
+    bool samePrepared = preparedVideo && preparedConfig.displayID == config.displayID &&
+                        preparedConfig.windowID == config.windowID;
+    renditionSource   = samePrepared ? std::move(preparedVideo) : std::make_unique<VideoCaptureImpl>();
+    if (!(samePrepared ? renditionSource->reconfigure(sourceConfig) : renditionSource->open(sourceConfig))) {
+      error = renditionSource->lastEncodeError();
+    }
+  }
+
+  if (error.empty()) {
+    renditionPipeline = std::make_unique<RenditionPipeline>(renditionSource->frameSource());
+    for (int32_t i = 0; i < renditionCount; i++) {
+      VideoRendition settings = VideoCaptureImpl::renditionFor(config, renditions[i]);
+      renditionEncoders.push_back(std::make_unique<RenditionEncoder>(settings));
+      renditionPipeline->addRendition(*renditionEncoders.back(), settings.frameRate);
+    }
+  }
+
+  syncClock = std::make_shared<AvSyncClock>();
+  if (error.empty() && audioCallback) {
+    startAudio(config, audioCallback, exitCallback, context, syncClock, error);
+  }
+
+  if (!error.empty()) {
+    releaseAll();
+    return false;
+  }
+
+  renditionPipeline->setSyncClock(syncClock);
+  renditionPipeline->start(videoCallback, exitCallback, context);
+
+  active                 = ActiveCapture();
+  active.config          = config;
+  active.config.bundleID = nullptr;
+  active.renditions.assign(renditions, renditions + renditionCount);
+  active.targetCallback = videoCallback;
+  active.audioCallback  = audioCallback;
+  active.exitCallback   = exitCallback;
+  active.context        = context;
+  return true;
+}
+
+bool MediaCaptureClient::startAudio(
+    const MediaCaptureConfigC &config, MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback, void *context, std::shared_ptr<AvSyncClock> syncClock, std::string &error) {
+  // A prepared stream is reused if it records the same device in the same format
+  bool samePrepared = preparedAudio && preparedConfig.audioSampleRate == config.audioSampleRate &&
+                      preparedConfig.audioChannels == config.audioChannels &&
+                      (preparedConfig.windowID == kMicrophoneTargetID) == (config.windowID == kMicrophoneTargetID);
+  audioImpl = samePrepared ? std::move(preparedAudio) : createAudioSource(config);
+  audioImpl->setSyncClock(std::move(syncClock));
+  if (!audioImpl->start(config.audioSampleRate, config.audioChannels, audioCallback, exitCallback, context)) {
+    error = audioImpl->lastError();
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<AudioSource> MediaCaptureClient::createAudioSource(const MediaCaptureConfigC &config) const {
+#ifdef CAPTURE_HAVE_PULSE
+  if (audioBackendFromEnvironment() == AudioBackend::Pulse) {
+    return std::make_unique<PulseAudioSource>(config.windowID == kMicrophoneTargetID);
+  }
+#else
+  (void)config;
+#endif
+  return std::make_unique<SyntheticAudioSource>(syntheticConfigFromEnvironment());
+}
+
+void MediaCaptureClient::releaseAll() {
+  // Each stop joins its threads, so no data callback runs after this point
+  if (audioImpl) {
+    audioImpl->stop();
+    audioImpl.reset();
+  }
+  if (videoImpl) {
+    videoImpl->stop();
+    videoImpl.reset();
+  }
+  if (targetPipeline) {
+    targetPipeline->stop();
+    targetPipeline.reset();
+  }
+  targetImpls.clear();
+  if (renditionPipeline) {
+    renditionPipeline->stop();
+    renditionPipeline.reset();
+  }
+  renditionEncoders.clear();
+  if (renditionSource) {
+    renditionSource->stop();
+    renditionSource.reset();
+  }
+}
+
+void MediaCaptureClient::releasePrepared() {
+  if (preparedAudio) {
+    preparedAudio->stop();
+    preparedAudio.reset();
+  }
+  if (preparedVideo) {
+    preparedVideo->stop();
+    preparedVideo.reset();
+  }
+}
+
+void MediaCaptureClient::stopCapture(StopCaptureCallback stopCallback, void *context) {
+  std::lock_guard<std::mutex> lock(captureMutex);
+
+  if (isCapturing.load()) {
+    isCapturing.store(false);
+    releaseAll();
+  }
+  releasePrepared();
+
+  if (stopCallback) {
+    stopCallback(context);
+  }
+}
+
+bool MediaCaptureClient::setCropRect(const MediaCaptureRectC &cropRect, std::string &error) {
+  std::lock_guard<std::mutex> lock(captureMutex);
+
+  // Every target is checked first, so a crop outside any of them keeps the old crop everywhere
+  if (videoImpl && !videoImpl->checkCropRect(cropRect, error)) {
+    return false;
+  }
+  for (size_t i = 0; i < targetImpls.size(); i++) {
+    if (!targetImpls[i]->checkCropRect(cropRect, error)) {
+      error = "Target " + std::to_string(i) + ": " + error;
+      return false;
+    }
+  }
+  if (renditionSource && !renditionSource->checkCropRect(cropRect, error)) {
+    return false;
+  }
+
+  if (videoImpl) {
+    videoImpl->setCropRect(cropRect);
+    active.config.cropRect = cropRect;
+  }
+  for (size_t i = 0; i < targetImpls.size(); i++) {
+    targetImpls[i]->setCropRect(cropRect);
+    active.targets[i].cropRect = cropRect;
+  }
+  if (renditionSource) {
+    renditionSource->setCropRect(cropRect);
+    active.config.cropRect = cropRect;
+  }
+  return true;
+}
+
+bool MediaCaptureClient::getQualityStats(MediaCaptureQualityStatsC &stats) {
+  std::lock_guard<std::mutex> lock(captureMutex);
+
+  // A multi-target capture reports the controller of its first target
+  VideoCaptureImpl    *video = videoImpl ? videoImpl.get() : targetImpls.empty() ? nullptr : targetImpls.front().get();
+  AdaptiveQualityStats quality;
+  if (!video || !video->qualityStats(quality)) {
+    return false;
+  }
+
+  stats.quality        = quality.settings.quality;
+  stats.scale          = static_cast<float>(quality.settings.scale);
+  stats.frameRate      = static_cast<float>(quality.settings.frameRate);
+  stats.encodeMs       = static_cast<float>(quality.encodeMs);
+  stats.bytesPerSecond = static_cast<float>(quality.bytesPerSecond);
+  stats.queueDepth     = static_cast<float>(quality.queueDepth);
+  stats.downgrades     = quality.downgrades;
+  stats.upgrades       = quality.upgrades;
+  stats.lastAdjustment = static_cast<int32_t>(quality.lastAdjustment);
+  stats.lastPressure   = static_cast<int32_t>(quality.lastPressure);
+  return true;
+}
+
+bool MediaCaptureClient::getStats(MediaCaptureStatsC &stats) {
+  std::lock_guard<std::mutex> lock(captureMutex);
+
+  if (!isCapturing.load()) {
+    return false;
+  }
+
+  VideoPipelineStats video;
+  AudioStatsSnapshot audio;
+  if (videoImpl) {
+    video = videoImpl->stats();
+  } else if (targetPipeline) {
+    video = targetPipeline->stats();
+  } else if (renditionPipeline) {
+    video = renditionPipeline->stats();
+  }
+  if (audioImpl) {
+    audio = audioImpl->stats();
+  }
+  exportCaptureStats(
+      videoImpl || targetPipeline || renditionPipeline ? &video : nullptr, audioImpl ? &audio : nullptr, stats);
+  return true;
+}
+
+void MediaCaptureClient::enumerateTargets(
+    int32_t targetType, EnumerateMediaCaptureTargetsCallback callback, void *context) {
+  if (!callback) {
+    return;
+  }
+
+#ifdef CAPTURE_HAVE_X11
+  if (videoBackendFromEnvironment() == VideoBackend::X11) {
+    std::vector<X11Target>           found;
+    std::vector<MediaCaptureTargetC> targets;
+    std::string                      error;
+    if (!enumerateX11Targets(targetType, found, error)) {
+      callback(nullptr, 0, const_cast<char *>(error.c_str()), context);
+      return;
+    }
+    appendAudioTargets(targetType, targets);
+    for (const X11Target &x11 : found) {
+      MediaCaptureTargetC target = {};
+      target.isDisplay           = x11.isDisplay ? 1 : 0;
+      target.isWindow            = x11.isDisplay ? 0 : 1;
+      target.displayID           = x11.isDisplay ? x11.id : 0;
+      target.windowID            = x11.isDisplay ? 0 : x11.id;
+      target.width               = x11.width;
+      target.height              = x11.height;
+      target.title               = const_cast<char *>(x11.title.c_str());
+      target.appName             = const_cast<char *>(x11.appName.c_str());
+      targets.push_back(target);
+    }
+    callback(targets.empty() ? nullptr : targets.data(), static_cast<int32_t>(targets.size()), nullptr, context);
+    return;
+  }
+#endif
+
+  SyntheticConfig synthetic = syntheticConfigFromEnvironment();
+
+  // Target types: 0=all, 1=screens only, 2=windows only
+  bool includeScreens = (targetType == 0 || targetType == 1);
+  bool includeWindows = (targetType == 0 || targetType == 2);
+
+  // Strings must stay alive until the callback returns
+  std::vector<std::string>         titles;
+  std::vector<std::string>         appNames;
+  std::vector<MediaCaptureTargetC> targets;
+  titles.reserve(synthetic.displays.size() + synthetic.windows.size());
+  appNames.reserve(titles.capacity());
+  appendAudioTargets(targetType, targets);
+
+  if (includeScreens) {
+    for (size_t i = 0; i < synthetic.displays.size(); i++) {
+      MediaCaptureTargetC target = {};
+      target.isDisplay           = 1;
+      target.displayID           = static_cast<uint32_t>(i + 1);
+      target.width               = synthetic.displays[i].width;
+      target.height              = synthetic.displays[i].height;
+      titles.push_back("Synthetic Display " + std::to_string(i + 1));
+      appNames.push_back("Screen");
+      target.title   = const_cast<char *>(titles.back().c_str());
+      target.appName = const_cast<char *>(appNames.back().c_str());
+      targets.push_back(target);
+    }
+  }
+
+  if (includeWindows) {
+    for (size_t i = 0; i < synthetic.windows.size(); i++) {
+      MediaCaptureTargetC target = {};
+      target.isWindow            = 1;
+      target.windowID            = static_cast<uint32_t>(i + 1);
+      target.width               = synthetic.windows[i].width;
+      target.height              = synthetic.windows[i].height;
+      titles.push_back("Synthetic Window " + std::to_string(i + 1));
+      appNames.push_back("Synthetic");
+      target.title   = const_cast<char *>(titles.back().c_str());
+      target.appName = const_cast<char *>(appNames.back().c_str());
+      targets.push_back(target);
+    }
+  }
+
+  callback(targets.empty() ? nullptr : targets.data(), static_cast<int32_t>(targets.size()), nullptr, context);
+}
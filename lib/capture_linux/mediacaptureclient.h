@@ -0,0 +1,270 @@
+/**
+ * @file mediacaptureclient.h
+ * @brief Media capture client implementation for Linux
+ *
+ * Coordinates the Linux audio and video capture implementations behind the
+ * C API in capture.h. linuxbackend.h decides whether targets, frames and
+ * audio come from the desktop or from the synthetic source described in
+ * syntheticconfig.h.
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "capture/capture.h"
+
+class AudioSource;
+class AvSyncClock;
+class MultiTargetPipeline;
+class RenditionEncoder;
+class RenditionPipeline;
+class VideoCaptureImpl;
+
+/**
+ * @class MediaCaptureClient
+ * @brief High-level client for audio and video capture on Linux
+ */
+class MediaCaptureClient {
+public:
+  /** Audio-only targets, same IDs as on Windows; only listed with the PulseAudio backend */
+  static constexpr uint32_t kSystemAudioTargetID = 100;
+  static constexpr uint32_t kMicrophoneTargetID  = 101;
+
+  MediaCaptureClient();
+
+  /**
+   * @brief Destructor - ensures capture is stopped
+   */
+  ~MediaCaptureClient();
+
+  /**
+   * @brief Open the video target and audio stream of a coming startCapture
+   *
+   * startCapture reuses them if its displayID, windowID and audio format
+   * match; otherwise, and on stopCapture, they are released.
+   *
+   * @param config Capture configuration of the coming start
+   * @param error Set if a target or device could not be opened
+   * @return false if capture is running or opening failed; nothing stays prepared then
+   */
+  bool prepare(const MediaCaptureConfigC &config, std::string &error);
+
+  /**
+   * @brief Start combined audio and video capture
+   *
+   * Either part can be omitted by passing NULL for its callback; video also
+   * requires a displayID or windowID.
+   *
+   * @param config Capture configuration
+   * @param videoCallback Function to receive video frames
+   * @param audioCallback Function to receive audio data
+   * @param exitCallback Function called when capture exits or errors occur
+   * @param context User data pointer passed to callbacks
+   * @return true if at least one capture type started, false otherwise (exitCallback has been called)
+   */
+  bool startCapture(
+      const MediaCaptureConfigC &config, MediaCaptureDataCallback videoCallback,
+      MediaCaptureAudioDataCallback audioCallback, MediaCaptureExitCallback exitCallback, void *context);
+
+  /**
+   * @brief Start audio capture and video capture of several targets on shared threads
+   *
+   * The video fields of config apply to every target; its displayID and
+   * windowID only select the audio source.
+   *
+   * @param config Capture configuration
+   * @param targets Video targets
+   * @param targetCount Number of targets
+   * @param videoCallback Function to receive video frames tagged with their target index
+   * @param audioCallback Function to receive audio data (can be NULL)
+   * @param exitCallback Function called when capture exits or errors occur
+   * @param context User data pointer passed to callbacks
+   * @return true if capture started, false otherwise (exitCallback has been called)
+   */
+  bool startMultiTargetCapture(
+      const MediaCaptureConfigC &config, const MediaCaptureTargetRefC *targets, int32_t targetCount,
+      MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+      MediaCaptureExitCallback exitCallback, void *context);
+
+  /**
+   * @brief Start audio capture and video capture of one target in several renditions
+   *
+   * config selects the target, crop and audio; each rendition has its own
+   * frame rate, size, format and quality.
+   *
+   * @param config Capture configuration
+   * @param renditions Output renditions
+   * @param renditionCount Number of renditions
+   * @param videoCallback Function to receive video frames tagged with their rendition index
+   * @param audioCallback Function to receive audio data (can be NULL)
+   * @param exitCallback Function called when capture exits or errors occur
+   * @param context User data pointer passed to callbacks
+   * @return true if capture started, false otherwise (exitCallback has been called)
+   */
+  bool startMultiRenditionCapture(
+      const MediaCaptureConfigC &config, const MediaCaptureRenditionC *renditions, int32_t renditionCount,
+      MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+      MediaCaptureExitCallback exitCallback, void *context);
+
+  /**
+   * @brief Apply a new configuration to the running capture without stopping it
+   *
+   * Frame rate, JPEG quality, output format, crop and adaptive quality change
+   * between two frames, and the audio format between two blocks; a source
+   * that cannot change its format in place is restarted alone. Only another
+   * displayID or windowID (or enabling adaptive quality for several targets,
+   * or new rendition defaults) restarts the whole capture with the callbacks
+   * it was started with.
+   *
+   * @param config Complete new configuration; the targets and renditions of a multi-target or
+   *               multi-rendition capture stay
+   * @param error Set if the change could not be applied
+   * @return false if nothing is captured or the change failed; if a restart failed, the exit callback has been called
+   */
+  bool reconfigure(const MediaCaptureConfigC &config, std::string &error);
+
+  /**
+   * @brief Stop all active capture and wait for the delivery threads to exit
+   * @param stopCallback Function called once capture has stopped
+   * @param context User data pointer passed to callback
+   */
+  void stopCapture(StopCaptureCallback stopCallback, void *context);
+
+  /**
+   * @brief Change the region of interest of the running video capture
+   * @param cropRect Crop rectangle in target pixels (zero size = full target)
+   * @param error Receives why the crop was rejected
+   * @return false if the crop lies outside a captured target; the previous crop stays in effect
+   */
+  bool setCropRect(const MediaCaptureRectC &cropRect, std::string &error);
+
+  /**
+   * @brief Read the adaptive quality controller of the running video capture
+   * @param stats Receives the controller state
+   * @return true if video capture is running with adaptive quality enabled
+   */
+  bool getQualityStats(MediaCaptureQualityStatsC &stats);
+
+  /**
+   * @brief Read the counters and stage latencies of the running capture
+   * @param stats Receives the statistics; parts that are not running are zeroed
+   * @return true if capture is running
+   */
+  bool getStats(MediaCaptureStatsC &stats);
+
+  /**
+   * @brief Enumerate available capture targets
+   * @param targetType 0=all, 1=displays only, 2=windows only
+   * @param callback Function to receive enumeration results
+   * @param context User data pointer passed to callback
+   */
+  static void enumerateTargets(int32_t targetType, EnumerateMediaCaptureTargetsCallback callback, void *context);
+
+private:
+  /** What the running capture was started with, to apply changes to it and restart it */
+  struct ActiveCapture {
+    MediaCaptureConfigC                 config = {};
+    std::vector<MediaCaptureTargetRefC> targets;    /**< Empty unless several targets are captured */
+    std::vector<MediaCaptureRenditionC> renditions; /**< Empty unless several renditions are delivered */
+    MediaCaptureDataCallback            videoCallback  = nullptr;
+    MediaCaptureTargetDataCallback      targetCallback = nullptr;
+    MediaCaptureAudioDataCallback       audioCallback  = nullptr;
+    MediaCaptureExitCallback            exitCallback   = nullptr;
+    void                               *context        = nullptr;
+  };
+
+  /**
+   * @brief Start single-target capture and record it in active (caller holds captureMutex)
+   * @return false if nothing could start; everything started is rolled back and error describes why
+   */
+  bool beginCapture(
+      const MediaCaptureConfigC &config, MediaCaptureDataCallback videoCallback,
+      MediaCaptureAudioDataCallback audioCallback, MediaCaptureExitCallback exitCallback, void *context,
+      std::string &error);
+
+  /**
+   * @brief Start multi-target capture and record it in active (caller holds captureMutex)
+   * @return false if nothing could start; everything started is rolled back and error describes why
+   */
+  bool beginMultiTargetCapture(
+      const MediaCaptureConfigC &config, const MediaCaptureTargetRefC *targets, int32_t targetCount,
+      MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+      MediaCaptureExitCallback exitCallback, void *context, std::string &error);
+
+  /**
+   * @brief Start multi-rendition capture and record it in active (caller holds captureMutex)
+   * @return false if nothing could start; everything started is rolled back and error describes why
+   */
+  bool beginRenditionCapture(
+      const MediaCaptureConfigC &config, const MediaCaptureRenditionC *renditions, int32_t renditionCount,
+      MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+      MediaCaptureExitCallback exitCallback, void *context, std::string &error);
+
+  /**
+   * @brief Stop the running capture and start it again with config (caller holds captureMutex)
+   */
+  bool restartCapture(const MediaCaptureConfigC &config, std::string &error);
+
+  /**
+   * @brief Start the audio source selected by config (caller holds captureMutex)
+   * @param syncClock Clock the source reports its blocks to, shared with the video pipeline
+   * @return false if it could not start; error describes why
+   */
+  bool startAudio(
+      const MediaCaptureConfigC &config, MediaCaptureAudioDataCallback audioCallback,
+      MediaCaptureExitCallback exitCallback, void *context, std::shared_ptr<AvSyncClock> syncClock,
+      std::string &error);
+
+  /**
+   * @brief Create the audio source selected by config and the environment, unstarted
+   */
+  std::unique_ptr<AudioSource> createAudioSource(const MediaCaptureConfigC &config) const;
+
+  /**
+   * @brief Stop and release audio and video of either kind (caller holds captureMutex)
+   */
+  void releaseAll();
+
+  /**
+   * @brief Release whatever prepare() opened and no start used (caller holds captureMutex)
+   */
+  void releasePrepared();
+
+  std::unique_ptr<AudioSource>      audioImpl;
+  std::unique_ptr<VideoCaptureImpl> videoImpl;
+
+  /** @name Multi-target video; the pipeline is declared last so it stops before the targets go away */
+  ///@{
+  std::vector<std::unique_ptr<VideoCaptureImpl>> targetImpls;
+  std::unique_ptr<MultiTargetPipeline>           targetPipeline;
+  ///@}
+
+  /** @name Multi-rendition video; the pipeline is declared last so it stops before its source and encoders */
+  ///@{
+  std::unique_ptr<VideoCaptureImpl>              renditionSource;
+  std::vector<std::unique_ptr<RenditionEncoder>> renditionEncoders;
+  std::unique_ptr<RenditionPipeline>             renditionPipeline;
+  ///@}
+
+  /** @name Opened by prepare() for the next start */
+  ///@{
+  MediaCaptureConfigC               preparedConfig = {};
+  std::unique_ptr<AudioSource>      preparedAudio;
+  std::unique_ptr<VideoCaptureImpl> preparedVideo;
+  ///@}
+
+  /** The running capture, valid while isCapturing */
+  ActiveCapture active;
+
+  /** Clock of the running capture, shared by its audio source and video pipeline */
+  std::shared_ptr<AvSyncClock> syncClock;
+
+  /** Flag indicating if capture is currently active */
+  std::atomic<bool> isCapturing{false};
+
+  /** Serializes start, stop and queries */
+  std::mutex captureMutex;
+};
@@ -0,0 +1,231 @@
+/**
+ * @file pulseaudiosource.cc
+ * @brief Implementation of PulseAudio / PipeWire audio capture
+ */
+#include "pulseaudiosource.h"
+#include "capturetrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <pulse/error.h>
+#include <pulse/simple.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+namespace {
+
+/** Priority requested for the reader thread; fails silently without CAP_SYS_NICE or an rtprio limit */
+constexpr int kReaderPriority = 10;
+
+void raiseToRealtimePriority() {
+  sched_param param;
+  std::memset(&param, 0, sizeof(param));
+  param.sched_priority = kReaderPriority;
+  if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+    static std::atomic<bool> warned{false};
+    if (!warned.exchange(true)) {
+      std::fprintf(stderr, "PulseAudioSource: real-time priority unavailable, reading at normal priority\n");
+    }
+  }
+}
+
+} // namespace
+
+bool pulseServerAvailable() {
+  const char *server = std::getenv("PULSE_SERVER");
+  if (server && *server) {
+    return true;
+  }
+  const char *runtimeDir = std::getenv("XDG_RUNTIME_DIR");
+  if (!runtimeDir || !*runtimeDir) {
+    return false;
+  }
+  std::string socketPath = std::string(runtimeDir) + "/pulse/native";
+  struct stat info;
+  return stat(socketPath.c_str(), &info) == 0;
+}
+
+PulseAudioSource::PulseAudioSource(bool microphone) : microphone(microphone) {
+  std::memset(errorMsg, 0, sizeof(errorMsg));
+}
+
+PulseAudioSource::~PulseAudioSource() {
+  stop();
+}
+
+bool PulseAudioSource::prepare(int32_t sampleRate, int32_t channels) {
+  if (running.load()) {
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "PulseAudio capture is already running");
+    return false;
+  }
+  if (sampleRate <= 0 || channels <= 0 || channels > PA_CHANNELS_MAX) {
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "Unsupported audio format: %d Hz, %d channels", sampleRate, channels);
+    return false;
+  }
+  if (stream && sampleRate == this->sampleRate && channels == this->channels) {
+    return true;
+  }
+  if (stream) {
+    pa_simple_free(static_cast<pa_simple *>(stream));
+    stream = nullptr;
+  }
+
+  pa_sample_spec spec;
+  spec.format   = PA_SAMPLE_FLOAT32NE;
+  spec.rate     = static_cast<uint32_t>(sampleRate);
+  spec.channels = static_cast<uint8_t>(channels);
+
+  // Small fragments keep latency low; the server buffers the rest
+  pa_buffer_attr attributes;
+  attributes.maxlength = static_cast<uint32_t>(-1);
+  attributes.tlength   = static_cast<uint32_t>(-1);
+  attributes.prebuf    = static_cast<uint32_t>(-1);
+  attributes.minreq    = static_cast<uint32_t>(-1);
+  attributes.fragsize  = static_cast<uint32_t>(pa_usec_to_bytes(kFragmentMs * 1000, &spec));
+
+  const char *device = microphone ? "@DEFAULT_SOURCE@" : "@DEFAULT_MONITOR@";
+  int         error  = 0;
+  pa_simple  *simple = pa_simple_new(nullptr, "desktop-media-capture", PA_STREAM_RECORD, device,
+                                     microphone ? "Microphone" : "System Audio", &spec, nullptr, &attributes, &error);
+  if (!simple) {
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "Failed to record from %s: %s", device, pa_strerror(error));
+    return false;
+  }
+
+  this->stream     = simple;
+  this->sampleRate = sampleRate;
+  this->channels   = channels;
+
+  // Everything the threads touch is allocated here, once
+  size_t framesPerFragment = static_cast<size_t>(std::max(1, sampleRate * kFragmentMs / 1000));
+  size_t framesPerBlock    = static_cast<size_t>(std::max(1, sampleRate * kBlockMs / 1000));
+  fragment.assign(framesPerFragment * channels, 0.0f);
+  block.assign(framesPerBlock * channels, 0.0f);
+  ring = std::make_unique<AudioRingBuffer>(static_cast<size_t>(sampleRate) * kRingMs / 1000 * channels);
+  return true;
+}
+
+bool PulseAudioSource::start(
+    int32_t sampleRate, int32_t channels, MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback, void *context) {
+  bool wasPrepared = stream && sampleRate == this->sampleRate && channels == this->channels;
+  if (!prepare(sampleRate, channels)) {
+    return false;
+  }
+
+  // A prepared stream has been recording since prepare(); the first block should be current
+  if (wasPrepared) {
+    int error = 0;
+    pa_simple_flush(static_cast<pa_simple *>(stream), &error);
+  }
+
+  this->audioCallback = audioCallback;
+  this->exitCallback  = exitCallback;
+  this->context       = context;
+
+  readFailed.store(false);
+  running.store(true);
+  deliveryThread = std::thread(&PulseAudioSource::deliveryThreadProc, this);
+  readerThread   = std::thread(&PulseAudioSource::readerThreadProc, this);
+  return true;
+}
+
+void PulseAudioSource::stop() {
+  running.store(false);
+  wakeCV.notify_all();
+
+  // pa_simple_read returns after at most one fragment, so the reader notices promptly
+  if (readerThread.joinable()) {
+    readerThread.join();
+  }
+  if (deliveryThread.joinable()) {
+    deliveryThread.join();
+  }
+  if (stream) {
+    pa_simple_free(static_cast<pa_simple *>(stream));
+    stream = nullptr;
+  }
+}
+
+void PulseAudioSource::readerThreadProc() {
+  raiseToRealtimePriority();
+  setTraceThreadName("audio-read");
+
+  pa_simple   *simple = static_cast<pa_simple *>(stream);
+  const size_t bytes  = fragment.size() * sizeof(float);
+
+  while (running.load(std::memory_order_relaxed)) {
+    int error = 0;
+    if (pa_simple_read(simple, fragment.data(), bytes, &error) < 0) {
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "PulseAudio read failed: %s", pa_strerror(error));
+      readFailed.store(true);
+      wakeCV.notify_one();
+      return;
+    }
+    int64_t readEnd = monotonicNowNs();
+    size_t  written = ring->write(fragment.data(), fragment.size());
+    if (written < fragment.size()) {
+      audioStats.dropped.fetch_add((fragment.size() - written) / channels, std::memory_order_relaxed);
+    }
+    // The read returns once the fragment is full, so its first sample was recorded a fragment earlier
+    if (syncClock && written > 0) {
+      int64_t fragmentNs = static_cast<int64_t>(fragment.size() / channels) * 1000000000 / sampleRate;
+      syncClock->addAudio(readEnd - fragmentNs, static_cast<uint32_t>(written / channels), sampleRate);
+    }
+    int64_t writeEnd = monotonicNowNs();
+    audioStats.acquire.record(static_cast<uint64_t>(writeEnd - readEnd));
+    traceSpan("audio-acquire", kNoTraceSequence, readEnd, writeEnd);
+    wakeCV.notify_one();
+  }
+}
+
+void PulseAudioSource::deliveryThreadProc() {
+  const int32_t framesPerBlock = static_cast<int32_t>(block.size() / channels);
+  int64_t       position       = 0;
+  setTraceThreadName("audio-deliver");
+
+  while (running.load()) {
+    if (readFailed.load()) {
+      // The exit callback is the last callback the caller sees from this source
+      if (exitCallback) {
+        exitCallback(errorMsg, context);
+      }
+      return;
+    }
+
+    if (ring->available() < block.size()) {
+      // The reader notifies without the lock, so a wakeup can be missed; the timeout bounds that to one block
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      wakeCV.wait_for(lock, std::chrono::milliseconds(kBlockMs), [this] {
+        return ring->available() >= block.size() || readFailed.load() || !running.load();
+      });
+      continue;
+    }
+
+    ring->read(block.data(), block.size());
+    if (audioCallback) {
+      uint64_t  packet       = audioStats.packets.load(std::memory_order_relaxed);
+      int64_t   deliverStart = monotonicNowNs();
+      SyncStamp stamp;
+      if (syncClock) {
+        stamp = syncClock->stampForAudio(position);
+      } else {
+        stamp.valid         = true;
+        stamp.captureNs     = deliverStart - static_cast<int64_t>(framesPerBlock) * 1000000000 / sampleRate;
+        stamp.hasAudio      = true;
+        stamp.audioPosition = position;
+      }
+      setCurrentSyncStamp(stamp);
+      audioCallback(channels, sampleRate, block.data(), framesPerBlock, context);
+      setCurrentSyncStamp(SyncStamp());
+      int64_t deliverEnd = monotonicNowNs();
+      audioStats.deliver.record(static_cast<uint64_t>(deliverEnd - deliverStart));
+      audioStats.addPacket(framesPerBlock);
+      traceSpan("audio-deliver", packet, deliverStart, deliverEnd);
+    }
+    position += framesPerBlock;
+  }
+}
@@ -0,0 +1,117 @@
+/**
+ * @file pulseaudiosource.h
+ * @brief System audio and microphone capture through the PulseAudio protocol
+ *
+ * Records the default sink's monitor source (everything being played) or the
+ * default source (microphone). PipeWire serves the same protocol through
+ * pipewire-pulse, so both sound servers are covered. The server converts to
+ * the requested sample rate and channel count.
+ *
+ * Two threads are involved:
+ *  - a reader at real-time priority (when permitted) that only reads small
+ *    fragments from the server into a preallocated AudioRingBuffer;
+ *  - a delivery thread that cuts the ring into fixed 10 ms blocks for the
+ *    audio callback, so a slow callback can never make the reader miss data.
+ *
+ * Only compiled when CAPTURE_HAVE_PULSE is defined.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "audioring.h"
+#include "audiosource.h"
+
+/**
+ * @brief Whether a PulseAudio-compatible server appears to be running
+ *
+ * Checks $PULSE_SERVER and the per-user socket; does not connect.
+ */
+bool pulseServerAvailable();
+
+/**
+ * @class PulseAudioSource
+ * @brief AudioSource reading a PulseAudio or PipeWire source
+ */
+class PulseAudioSource : public AudioSource {
+public:
+  /** Server fragment size; bounds the capture latency */
+  static constexpr int32_t kFragmentMs = 5;
+
+  /** Length of each delivered block */
+  static constexpr int32_t kBlockMs = 10;
+
+  /** Ring length; how long the delivery thread may stall before data is dropped */
+  static constexpr int32_t kRingMs = 500;
+
+  /**
+   * @brief Constructor
+   * @param microphone true to record the default source instead of the default sink's monitor
+   */
+  explicit PulseAudioSource(bool microphone);
+
+  /**
+   * @brief Destructor - stops capture if it is running
+   */
+  ~PulseAudioSource() override;
+
+  /**
+   * @brief Connect the record stream; start() then only flushes what it buffered and starts the threads
+   */
+  bool prepare(int32_t sampleRate, int32_t channels) override;
+
+  bool start(
+      int32_t sampleRate, int32_t channels, MediaCaptureAudioDataCallback audioCallback,
+      MediaCaptureExitCallback exitCallback, void *context) override;
+
+  void stop() override;
+
+  const char *lastError() const override {
+    return errorMsg;
+  }
+
+  /**
+   * @brief Number of samples dropped because the delivery thread fell behind
+   */
+  uint64_t overruns() const {
+    return ring ? ring->overruns() : 0;
+  }
+
+private:
+  /** Reader thread: server -> ring */
+  void readerThreadProc();
+
+  /** Delivery thread: ring -> callback in fixed blocks */
+  void deliveryThreadProc();
+
+  bool microphone;
+
+  /** pa_simple connection; opaque here to keep libpulse out of this header */
+  void *stream = nullptr;
+
+  int32_t                       sampleRate    = 0;
+  int32_t                       channels      = 0;
+  MediaCaptureAudioDataCallback audioCallback = nullptr;
+  MediaCaptureExitCallback      exitCallback  = nullptr;
+  void                         *context       = nullptr;
+
+  std::unique_ptr<AudioRingBuffer> ring;
+  std::vector<float>               fragment; /**< Reader thread buffer */
+  std::vector<float>               block;    /**< Delivery thread buffer */
+
+  std::atomic<bool> running{false};
+  std::atomic<bool> readFailed{false};
+  std::thread       readerThread;
+  std::thread       deliveryThread;
+
+  /** Wakes the delivery thread; the reader notifies without taking the mutex */
+  std::mutex              wakeMutex;
+  std::condition_variable wakeCV;
+
+  char errorMsg[256];
+};
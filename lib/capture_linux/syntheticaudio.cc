@@ -0,0 +1,149 @@
+/**
+ * @file syntheticaudio.cc
+ * @brief Implementation of the tone and noise generator
+ */
+#include "syntheticaudio.h"
+#include "capturetrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+void generateAudioBlock(
+    AudioSignal signal, double frequency, float amplitude, int32_t sampleRate, int32_t channels, int32_t frameCount,
+    double &phase, uint32_t &noiseState, float *out) {
+  const double kTwoPi = 6.283185307179586;
+  const double step   = frequency / sampleRate;
+
+  for (int32_t i = 0; i < frameCount; i++) {
+    float sample = 0.0f;
+    switch (signal) {
+    case AudioSignal::Tone:
+      sample = amplitude * static_cast<float>(std::sin(kTwoPi * phase));
+      phase += step;
+      phase -= std::floor(phase);
+      break;
+    case AudioSignal::Noise:
+      noiseState ^= noiseState << 13;
+      noiseState ^= noiseState >> 17;
+      noiseState ^= noiseState << 5;
+      sample = amplitude * (static_cast<float>(noiseState) / 2147483648.0f - 1.0f);
+      break;
+    case AudioSignal::Silence:
+      break;
+    }
+    for (int32_t c = 0; c < channels; c++) {
+      out[i * channels + c] = sample;
+    }
+  }
+}
+
+SyntheticAudioSource::SyntheticAudioSource(const SyntheticConfig &config) :
+    signal(config.signal),
+    frequency(config.frequency),
+    amplitude(config.amplitude),
+    seed(config.seed) {
+  std::memset(errorMsg, 0, sizeof(errorMsg));
+}
+
+SyntheticAudioSource::~SyntheticAudioSource() {
+  stop();
+}
+
+bool SyntheticAudioSource::start(
+    int32_t sampleRate, int32_t channels, MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback /*exitCallback*/, void *context) {
+  if (running.load()) {
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "Synthetic audio is already running");
+    return false;
+  }
+  if (sampleRate <= 0 || channels <= 0 || channels > 32) {
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "Unsupported audio format: %d Hz, %d channels", sampleRate, channels);
+    return false;
+  }
+
+  this->sampleRate    = sampleRate;
+  this->channels      = channels;
+  this->audioCallback = audioCallback;
+  this->context       = context;
+  framesPerBlock      = std::max<int32_t>(1, sampleRate * kBlockMs / 1000);
+  block.assign(static_cast<size_t>(framesPerBlock) * channels, 0.0f);
+
+  running.store(true);
+  thread = std::thread(&SyntheticAudioSource::threadProc, this);
+  return true;
+}
+
+bool SyntheticAudioSource::setFormat(int32_t sampleRate, int32_t channels) {
+  if (!running.load() || sampleRate <= 0 || channels <= 0 || channels > 32) {
+    return false;
+  }
+  pendingFormat.store((static_cast<uint64_t>(sampleRate) << 32) | static_cast<uint32_t>(channels));
+  return true;
+}
+
+void SyntheticAudioSource::stop() {
+  running.store(false);
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+void SyntheticAudioSource::threadProc() {
+  double   phase      = 0.0;
+  uint32_t noiseState = seed | 1u;
+  uint64_t delivered  = 0;
+  uint64_t paced      = 0;
+  auto     startTime  = std::chrono::steady_clock::now();
+  setTraceThreadName("audio-capture");
+
+  while (running.load()) {
+    // A new format takes effect at a block boundary and restarts the pacing at the new rate
+    uint64_t format = pendingFormat.exchange(0);
+    if (format != 0) {
+      sampleRate     = static_cast<int32_t>(format >> 32);
+      channels       = static_cast<int32_t>(format & 0xffffffffu);
+      framesPerBlock = std::max<int32_t>(1, sampleRate * kBlockMs / 1000);
+      block.assign(static_cast<size_t>(framesPerBlock) * channels, 0.0f);
+      paced     = 0;
+      startTime = std::chrono::steady_clock::now();
+    }
+
+    uint64_t packet        = audioStats.packets.load(std::memory_order_relaxed);
+    int64_t  generateStart = monotonicNowNs();
+    generateAudioBlock(signal, frequency, amplitude, sampleRate, channels, framesPerBlock, phase, noiseState,
+                       block.data());
+    int64_t generateEnd = monotonicNowNs();
+    audioStats.acquire.record(static_cast<uint64_t>(generateEnd - generateStart));
+    traceSpan("audio-acquire", packet, generateStart, generateEnd);
+
+    // Like a device, a block is handed over once its last sample has been recorded
+    int64_t   firstSampleNs = generateStart - static_cast<int64_t>(framesPerBlock) * 1000000000 / sampleRate;
+    SyncStamp stamp;
+    if (syncClock) {
+      stamp = syncClock->stampForAudio(syncClock->addAudio(firstSampleNs, framesPerBlock, sampleRate));
+    } else {
+      stamp.valid         = true;
+      stamp.captureNs     = firstSampleNs;
+      stamp.hasAudio      = true;
+      stamp.audioPosition = static_cast<int64_t>(delivered);
+    }
+
+    if (audioCallback) {
+      setCurrentSyncStamp(stamp);
+      audioCallback(channels, sampleRate, block.data(), framesPerBlock, context);
+      setCurrentSyncStamp(SyncStamp());
+      int64_t deliverEnd = monotonicNowNs();
+      audioStats.deliver.record(static_cast<uint64_t>(deliverEnd - generateEnd));
+      audioStats.addPacket(framesPerBlock);
+      traceSpan("audio-deliver", packet, generateEnd, deliverEnd);
+    }
+    delivered += static_cast<uint64_t>(framesPerBlock);
+    paced += static_cast<uint64_t>(framesPerBlock);
+
+    // Sleep until the next block is due rather than for a fixed period, so callback time does not accumulate as drift
+    auto due = startTime + std::chrono::microseconds(paced * 1000000 / static_cast<uint64_t>(sampleRate));
+    std::this_thread::sleep_until(due);
+  }
+}
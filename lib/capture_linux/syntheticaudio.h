@@ -0,0 +1,91 @@
+/**
+ * @file syntheticaudio.h
+ * @brief Tone and noise generator for the Linux backend
+ */
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "audiosource.h"
+#include "syntheticconfig.h"
+
+/**
+ * @brief Fill a block of interleaved samples
+ * @param signal Signal to generate
+ * @param frequency Tone frequency in Hz
+ * @param amplitude Peak sample value
+ * @param sampleRate Sample rate in Hz
+ * @param channels Number of interleaved channels; every channel carries the same signal
+ * @param frameCount Number of frames to generate
+ * @param phase Tone phase in cycles, advanced by the block
+ * @param noiseState Noise generator state, advanced by the block
+ * @param out Receives channels * frameCount samples
+ */
+void generateAudioBlock(
+    AudioSignal signal, double frequency, float amplitude, int32_t sampleRate, int32_t channels, int32_t frameCount,
+    double &phase, uint32_t &noiseState, float *out);
+
+/**
+ * @class SyntheticAudioSource
+ * @brief AudioSource that generates a signal in real time instead of reading a sound server
+ *
+ * Delivers 10 ms blocks on a dedicated thread paced against the monotonic
+ * clock, so the long-term delivery rate matches the sample rate exactly.
+ * The block buffer is allocated in start() and again only when setFormat()
+ * changes the block size.
+ */
+class SyntheticAudioSource : public AudioSource {
+public:
+  /** Length of each delivered block */
+  static constexpr int32_t kBlockMs = 10;
+
+  /**
+   * @brief Constructor
+   * @param config Signal, frequency, amplitude and seed to generate
+   */
+  explicit SyntheticAudioSource(const SyntheticConfig &config);
+
+  /**
+   * @brief Destructor - stops delivery if it is running
+   */
+  ~SyntheticAudioSource() override;
+
+  bool start(
+      int32_t sampleRate, int32_t channels, MediaCaptureAudioDataCallback audioCallback,
+      MediaCaptureExitCallback exitCallback, void *context) override;
+
+  bool setFormat(int32_t sampleRate, int32_t channels) override;
+
+  void stop() override;
+
+  const char *lastError() const override {
+    return errorMsg;
+  }
+
+private:
+  /** Delivery thread: generates and delivers one block per period */
+  void threadProc();
+
+  AudioSignal signal;
+  double      frequency;
+  float       amplitude;
+  uint32_t    seed;
+
+  int32_t                       sampleRate     = 0;
+  int32_t                       channels       = 0;
+  int32_t                       framesPerBlock = 0;
+  MediaCaptureAudioDataCallback audioCallback  = nullptr;
+  void                         *context        = nullptr;
+
+  /** Interleaved block handed to the callback */
+  std::vector<float> block;
+
+  /** Format requested by setFormat() as sampleRate << 32 | channels; 0 if none is pending */
+  std::atomic<uint64_t> pendingFormat{0};
+
+  std::atomic<bool> running{false};
+  std::thread       thread;
+
+  char errorMsg[256];
+};
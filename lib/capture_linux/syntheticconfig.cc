@@ -0,0 +1,158 @@
+/**
+ * @file syntheticconfig.cc
+ * @brief Parsing of the synthetic capture source configuration
+ */
+#include "syntheticconfig.h"
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+bool parseSize(const std::string &text, SyntheticTargetSize &size) {
+  int  width = 0, height = 0;
+  char separator = 0, trailing = 0;
+  if (std::sscanf(text.c_str(), "%d%c%d%c", &width, &separator, &height, &trailing) != 3 || separator != 'x') {
+    return false;
+  }
+  // Bound the size so a typo cannot ask for gigabytes per frame
+  if (width <= 0 || height <= 0 || width > 16384 || height > 16384) {
+    return false;
+  }
+  size.width  = width;
+  size.height = height;
+  return true;
+}
+
+bool parseSizeList(const std::string &text, std::vector<SyntheticTargetSize> &sizes) {
+  std::vector<SyntheticTargetSize> parsed;
+  std::stringstream                stream(text);
+  std::string                      item;
+  while (std::getline(stream, item, ',')) {
+    if (item.empty()) {
+      continue;
+    }
+    SyntheticTargetSize size;
+    if (!parseSize(item, size)) {
+      return false;
+    }
+    parsed.push_back(size);
+  }
+  sizes = std::move(parsed);
+  return true;
+}
+
+bool parseNumber(const std::string &text, double &value) {
+  char *end = nullptr;
+  value     = std::strtod(text.c_str(), &end);
+  return !text.empty() && end && *end == '\0';
+}
+
+} // namespace
+
+bool parseSyntheticConfig(const std::string &text, SyntheticConfig &config, std::string &error) {
+  SyntheticConfig   parsed = config;
+  std::stringstream stream(text);
+  std::string       entry;
+
+  while (std::getline(stream, entry, ';')) {
+    if (entry.empty()) {
+      continue;
+    }
+    size_t equals = entry.find('=');
+    if (equals == std::string::npos) {
+      error = "expected key=value, got '" + entry + "'";
+      return false;
+    }
+    std::string key   = entry.substr(0, equals);
+    std::string value = entry.substr(equals + 1);
+    double      number;
+
+    if (key == "displays") {
+      if (!parseSizeList(value, parsed.displays)) {
+        error = "invalid display list '" + value + "'";
+        return false;
+      }
+    } else if (key == "windows") {
+      if (!parseSizeList(value, parsed.windows)) {
+        error = "invalid window list '" + value + "'";
+        return false;
+      }
+    } else if (key == "pattern") {
+      if (value == "bars") {
+        parsed.pattern = TestPattern::Bars;
+      } else if (value == "gradient") {
+        parsed.pattern = TestPattern::Gradient;
+      } else if (value == "noise") {
+        parsed.pattern = TestPattern::Noise;
+      } else if (value == "static") {
+        parsed.pattern = TestPattern::Static;
+      } else {
+        error = "unknown pattern '" + value + "'";
+        return false;
+      }
+    } else if (key == "audio") {
+      if (value == "tone") {
+        parsed.signal = AudioSignal::Tone;
+      } else if (value == "noise") {
+        parsed.signal = AudioSignal::Noise;
+      } else if (value == "silence") {
+        parsed.signal = AudioSignal::Silence;
+      } else {
+        error = "unknown audio signal '" + value + "'";
+        return false;
+      }
+    } else if (key == "frequency") {
+      if (!parseNumber(value, number) || number <= 0) {
+        error = "invalid frequency '" + value + "'";
+        return false;
+      }
+      parsed.frequency = number;
+    } else if (key == "amplitude") {
+      if (!parseNumber(value, number) || number < 0 || number > 1) {
+        error = "invalid amplitude '" + value + "'";
+        return false;
+      }
+      parsed.amplitude = static_cast<float>(number);
+    } else if (key == "seed") {
+      if (!parseNumber(value, number) || number < 0) {
+        error = "invalid seed '" + value + "'";
+        return false;
+      }
+      parsed.seed = static_cast<uint32_t>(number);
+    } else {
+      error = "unknown key '" + key + "'";
+      return false;
+    }
+  }
+
+  config = std::move(parsed);
+  return true;
+}
+
+SyntheticConfig syntheticConfigFromEnvironment() {
+  SyntheticConfig config;
+  const char     *text = std::getenv("DESKTOP_CAPTURE_SYNTHETIC");
+  if (text) {
+    std::string error;
+    if (!parseSyntheticConfig(text, config, error)) {
+      std::fprintf(stderr, "DESKTOP_CAPTURE_SYNTHETIC ignored: %s\n", error.c_str());
+    }
+  }
+  return config;
+}
+
+bool findSyntheticTarget(const SyntheticConfig &config, uint32_t displayID, uint32_t windowID, SyntheticTargetSize &size) {
+  if (windowID > 0) {
+    if (windowID > config.windows.size()) {
+      return false;
+    }
+    size = config.windows[windowID - 1];
+    return true;
+  }
+  if (displayID > 0 && displayID <= config.displays.size()) {
+    size = config.displays[displayID - 1];
+    return true;
+  }
+  return false;
+}
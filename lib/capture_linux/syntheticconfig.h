@@ -0,0 +1,90 @@
+/**
+ * @file syntheticconfig.h
+ * @brief Configuration of the synthetic capture source used on Linux
+ *
+ * The synthetic source stands in for a real display server and sound server:
+ * it produces test-pattern frames at any resolution and frame rate and tones
+ * or noise at any sample rate and channel count. It is configured from the
+ * DESKTOP_CAPTURE_SYNTHETIC environment variable, a list of key=value pairs
+ * separated by semicolons:
+ *
+ *   displays=1920x1080,3840x2160;windows=1280x720;pattern=noise;audio=tone;frequency=440;amplitude=0.25;seed=7
+ *
+ * Unset keys keep their defaults.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @enum TestPattern
+ * @brief Content of synthetic video frames
+ */
+enum class TestPattern {
+  Bars,     /**< Colour bars with a moving box; mostly static, like a desktop */
+  Gradient, /**< Smooth gradient whose blue channel changes every frame */
+  Noise,    /**< Fresh random pixels every frame; the worst case for any encoder */
+  Static    /**< Colour bars without motion; every frame is identical */
+};
+
+/**
+ * @enum AudioSignal
+ * @brief Content of synthetic audio buffers
+ */
+enum class AudioSignal {
+  Tone,   /**< Sine wave at the configured frequency */
+  Noise,  /**< Uniform white noise */
+  Silence /**< All zero samples */
+};
+
+/**
+ * @struct SyntheticTargetSize
+ * @brief Dimensions of one synthetic display or window
+ */
+struct SyntheticTargetSize {
+  int32_t width  = 0; /**< Width in pixels */
+  int32_t height = 0; /**< Height in pixels */
+};
+
+/**
+ * @struct SyntheticConfig
+ * @brief Everything the synthetic source generates
+ */
+struct SyntheticConfig {
+  std::vector<SyntheticTargetSize> displays{{1920, 1080}}; /**< Displays, numbered from 1 */
+  std::vector<SyntheticTargetSize> windows{{1280, 720}};   /**< Windows, numbered from 1 */
+  TestPattern                      pattern   = TestPattern::Bars;
+  AudioSignal                      signal    = AudioSignal::Tone;
+  double                           frequency = 440.0; /**< Tone frequency in Hz */
+  float                            amplitude = 0.25f; /**< Peak sample value (0-1) */
+  uint32_t                         seed      = 1;     /**< Seed of the noise generators */
+};
+
+/**
+ * @brief Parse a configuration string on top of the defaults
+ * @param text key=value pairs separated by semicolons
+ * @param config Receives the parsed configuration
+ * @param error Receives a description of the first invalid entry
+ * @return false if any entry is invalid; config is then left unchanged
+ */
+bool parseSyntheticConfig(const std::string &text, SyntheticConfig &config, std::string &error);
+
+/**
+ * @brief Configuration taken from DESKTOP_CAPTURE_SYNTHETIC
+ *
+ * Read on every call so tests and benchmarks can change it between captures.
+ * An invalid value is reported on stderr and the defaults are used instead.
+ */
+SyntheticConfig syntheticConfigFromEnvironment();
+
+/**
+ * @brief Look up a synthetic display or window
+ * @param config Synthetic configuration
+ * @param displayID Display number (1-based), or 0
+ * @param windowID Window number (1-based), or 0 when capturing a display
+ * @param size Receives the target dimensions
+ * @return false if the target does not exist
+ */
+bool findSyntheticTarget(const SyntheticConfig &config, uint32_t displayID, uint32_t windowID, SyntheticTargetSize &size);
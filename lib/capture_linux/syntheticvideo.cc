@@ -0,0 +1,129 @@
+/**
+ * @file syntheticvideo.cc
+ * @brief Implementation of the test-pattern video source
+ */
+#include "syntheticvideo.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+/** 75% colour bars, BGRA, left to right */
+const uint8_t kBarColours[8][4] = {
+    {191, 191, 191, 255},
+    {0,   191, 191, 255},
+    {191, 191, 0,   255},
+    {0,   191, 0,   255},
+    {191, 0,   191, 255},
+    {0,   0,   191, 255},
+    {191, 0,   0,   255},
+    {16,  16,  16,  255},
+};
+
+void renderBars(uint8_t *dst, int32_t bytesPerRow, int32_t width, int32_t height) {
+  // Every row is identical, so build the first and replicate it
+  for (int32_t x = 0; x < width; x++) {
+    std::memcpy(dst + x * 4, kBarColours[static_cast<int64_t>(x) * 8 / width], 4);
+  }
+  for (int32_t y = 1; y < height; y++) {
+    std::memcpy(dst + static_cast<size_t>(y) * bytesPerRow, dst, static_cast<size_t>(width) * 4);
+  }
+}
+
+void renderMovingBox(uint64_t frameIndex, uint8_t *dst, int32_t bytesPerRow, int32_t width, int32_t height) {
+  const int32_t box = std::max<int32_t>(1, std::min(width, height) / 8);
+  const int32_t x0  = static_cast<int32_t>((frameIndex * 8) % static_cast<uint64_t>(std::max(1, width - box + 1)));
+  const int32_t y0  = (height - box) / 2;
+  for (int32_t y = y0; y < y0 + box; y++) {
+    std::memset(dst + static_cast<size_t>(y) * bytesPerRow + static_cast<size_t>(x0) * 4, 0xff,
+                static_cast<size_t>(box) * 4);
+  }
+}
+
+void renderGradient(uint64_t frameIndex, uint8_t *dst, int32_t bytesPerRow, int32_t width, int32_t height) {
+  const uint8_t blue = static_cast<uint8_t>(frameIndex * 3);
+  for (int32_t y = 0; y < height; y++) {
+    uint8_t      *row   = dst + static_cast<size_t>(y) * bytesPerRow;
+    const uint8_t green = static_cast<uint8_t>(static_cast<int64_t>(y) * 255 / std::max(1, height - 1));
+    for (int32_t x = 0; x < width; x++) {
+      row[x * 4 + 0] = blue;
+      row[x * 4 + 1] = green;
+      row[x * 4 + 2] = static_cast<uint8_t>(static_cast<int64_t>(x) * 255 / std::max(1, width - 1));
+      row[x * 4 + 3] = 255;
+    }
+  }
+}
+
+void renderNoise(uint64_t frameIndex, uint32_t seed, uint8_t *dst, int32_t bytesPerRow, int32_t width, int32_t height) {
+  // xorshift32: cheap enough that rendering never dominates the encoder being measured
+  uint32_t state = (seed ^ static_cast<uint32_t>(frameIndex * 0x9E3779B9u)) | 1u;
+  for (int32_t y = 0; y < height; y++) {
+    uint8_t *row = dst + static_cast<size_t>(y) * bytesPerRow;
+    for (int32_t x = 0; x < width; x++) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      uint32_t pixel = state | 0xff000000u;
+      std::memcpy(row + x * 4, &pixel, 4);
+    }
+  }
+}
+
+} // namespace
+
+void renderTestPattern(
+    TestPattern pattern, uint64_t frameIndex, uint32_t seed, uint8_t *dst, int32_t bytesPerRow, int32_t width,
+    int32_t height) {
+  switch (pattern) {
+  case TestPattern::Bars:
+    renderBars(dst, bytesPerRow, width, height);
+    renderMovingBox(frameIndex, dst, bytesPerRow, width, height);
+    break;
+  case TestPattern::Static:
+    renderBars(dst, bytesPerRow, width, height);
+    break;
+  case TestPattern::Gradient:
+    renderGradient(frameIndex, dst, bytesPerRow, width, height);
+    break;
+  case TestPattern::Noise:
+    renderNoise(frameIndex, seed, dst, bytesPerRow, width, height);
+    break;
+  }
+}
+
+SyntheticVideoSource::SyntheticVideoSource(
+    int32_t width, int32_t height, TestPattern pattern, uint32_t seed, const SharedCropRect &cropRect) :
+    width(width),
+    height(height),
+    pattern(pattern),
+    seed(seed),
+    cropRect(cropRect),
+    canvas(static_cast<size_t>(width) * height * 4) {
+  std::memset(errorMsg, 0, sizeof(errorMsg));
+}
+
+AcquireResult SyntheticVideoSource::acquireFrame(VideoFrame &frame, uint32_t /*timeoutMs*/) {
+  MediaCaptureRectC region;
+  if (!resolveCropRect(cropRect.get(), width, height, region)) {
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "Crop rectangle is outside the %dx%d synthetic target", width, height);
+    return AcquireResult::Error;
+  }
+
+  renderTestPattern(pattern, frameIndex++, seed, canvas.data(), width * 4, width, height);
+
+  // The frame buffer is recycled by the pipeline, so this only allocates when the region grows
+  int32_t bytesPerRow = region.width * 4;
+  size_t  bufferSize  = static_cast<size_t>(bytesPerRow) * region.height;
+  if (frame.pixels.size() != bufferSize) {
+    frame.pixels.resize(bufferSize);
+  }
+  int64_t copyStart = monotonicNowNs();
+  copyFrameRegion(canvas.data(), width * 4, region, 4, frame.pixels.data(), bytesPerRow);
+  frame.copyNs = monotonicNowNs() - copyStart;
+
+  frame.width       = region.width;
+  frame.height      = region.height;
+  frame.bytesPerRow = bytesPerRow;
+  return AcquireResult::Frame;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file syntheticvideo.h
+ * @brief Test-pattern video source for the Linux backend
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "croprect.h"
+#include "syntheticconfig.h"
+#include "videopipeline.h"
+
+/**
+ * @brief Render one frame of a test pattern
+ * @param pattern Pattern to draw
+ * @param frameIndex Animation step; patterns with motion advance with it
+ * @param seed Seed of the noise pattern
+ * @param dst First byte of a BGRA frame
+ * @param bytesPerRow Row stride of dst in bytes
+ * @param width Frame width in pixels
+ * @param height Frame height in pixels
+ */
+void renderTestPattern(
+    TestPattern pattern, uint64_t frameIndex, uint32_t seed, uint8_t *dst, int32_t bytesPerRow, int32_t width,
+    int32_t height);
+
+/**
+ * @class SyntheticVideoSource
+ * @brief VideoFrameSource that renders a test pattern instead of reading a display
+ *
+ * Each acquisition renders the next frame of the pattern onto a full-size
+ * canvas and copies the region of interest out of it, the same way the
+ * hardware backends copy out of a mapped surface.
+ */
+class SyntheticVideoSource : public VideoFrameSource {
+public:
+  /**
+   * @brief Constructor
+   * @param width Canvas width in pixels
+   * @param height Canvas height in pixels
+   * @param pattern Pattern to render
+   * @param seed Seed of the noise pattern
+   * @param cropRect Region of interest, read once per frame; must outlive the source
+   */
+  SyntheticVideoSource(int32_t width, int32_t height, TestPattern pattern, uint32_t seed, const SharedCropRect &cropRect);
+
+  AcquireResult acquireFrame(VideoFrame &frame, uint32_t timeoutMs) override;
+
+  const char *lastAcquireError() const override {
+    return errorMsg;
+  }
+
+  bool targetSize(int32_t &targetWidth, int32_t &targetHeight) const override {
+    targetWidth  = width;
+    targetHeight = height;
+    return true;
+  }
+
+private:
+  int32_t               width;
+  int32_t               height;
+  TestPattern           pattern;
+  uint32_t              seed;
+  const SharedCropRect &cropRect;
+
+  /** Full-size frame the region of interest is copied from */
+  std::vector<uint8_t> canvas;
+
+  /** Number of frames rendered so far */
+  uint64_t frameIndex = 0;
+
+  char errorMsg[256];
+};
@@ -0,0 +1,277 @@
+/**
+ * @file videocaptureimpl.cc
+ * @brief Linux implementation of video capture on top of the shared pipeline
+ */
+#include "videocaptureimpl.h"
+#include "framescale.h"
+#include "jpegcodec.h"
+#include "linuxbackend.h"
+#include "syntheticvideo.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#ifdef CAPTURE_HAVE_X11
+#include "x11capture.h"
+#endif
+
+namespace {
+
+/** Same mapping as macOS and Windows: high=90, medium=75, low=50, or the precise value */
+int32_t jpegQualityFor(const MediaCaptureConfigC &config) {
+  if (config.qualityValue > 0 && config.qualityValue <= 100) {
+    return config.qualityValue;
+  }
+  if (config.quality == 0) {
+    return 90;
+  }
+  return config.quality == 2 ? 50 : 75;
+}
+
+bool hasQualityBudget(const MediaCaptureConfigC &config) {
+  return config.maxEncodeMsPerFrame > 0 || config.maxBytesPerSecond > 0;
+}
+
+/** Budget, bounds and starting point of the adaptive quality controller */
+void qualityLimitsFor(
+    const MediaCaptureConfigC &config, QualityBudget &budget, QualityBounds &bounds, QualitySettings &initial) {
+  budget.maxEncodeMsPerFrame = config.maxEncodeMsPerFrame;
+  budget.maxBytesPerSecond   = config.maxBytesPerSecond;
+
+  if (config.minQualityValue > 0) {
+    bounds.minQuality = config.minQualityValue;
+  }
+  if (config.minScale > 0) {
+    bounds.minScale = config.minScale;
+  }
+  if (config.minFrameRate > 0) {
+    bounds.minFrameRate = config.minFrameRate;
+  }
+
+  initial.quality   = jpegQualityFor(config);
+  initial.scale     = 1.0;
+  initial.frameRate = config.frameRate > 0 ? config.frameRate : 30.0f; // Default frame rate
+}
+
+} // namespace
+
+VideoCaptureImpl::VideoCaptureImpl() {
+  std::memset(&config, 0, sizeof(config));
+  std::memset(errorMsg, 0, sizeof(errorMsg));
+}
+
+VideoCaptureImpl::~VideoCaptureImpl() {
+  stop();
+}
+
+bool VideoCaptureImpl::start(
+    const MediaCaptureConfigC &config, MediaCaptureDataCallback videoCallback, MediaCaptureExitCallback exitCallback,
+    void *context, std::shared_ptr<AvSyncClock> syncClock) {
+  // A source opened ahead of time for the same target only needs the new settings
+  bool reuse = source && !pipeline && this->config.displayID == config.displayID &&
+               this->config.windowID == config.windowID;
+  if (reuse ? !configure(config) : !open(config)) {
+    return false;
+  }
+
+  this->videoCallback = videoCallback;
+  this->exitCallback  = exitCallback;
+  this->context       = context;
+  this->syncClock     = std::move(syncClock);
+
+  pipeline = std::make_unique<VideoPipeline>(*source, *this);
+  pipeline->setQualityController(qualityController);
+  pipeline->setSyncClock(this->syncClock);
+  pipeline->start(config.frameRate, videoCallback, exitCallback, context);
+  return true;
+}
+
+bool VideoCaptureImpl::open(const MediaCaptureConfigC &config) {
+  source.reset();
+  if (!configure(config)) {
+    return false;
+  }
+
+#ifdef CAPTURE_HAVE_X11
+  if (videoBackendFromEnvironment() == VideoBackend::X11) {
+    std::string error;
+    source = createX11VideoSource(config.displayID, config.windowID, cropRect, error);
+    if (!source) {
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "%s", error.c_str());
+      return false;
+    }
+  }
+#endif
+  if (!source) {
+    SyntheticConfig     synthetic = syntheticConfigFromEnvironment();
+    SyntheticTargetSize size;
+    if (!findSyntheticTarget(synthetic, config.displayID, config.windowID, size)) {
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "No synthetic target with displayID=%u windowID=%u", config.displayID,
+               config.windowID);
+      return false;
+    }
+    source =
+        std::make_unique<SyntheticVideoSource>(size.width, size.height, synthetic.pattern, synthetic.seed, cropRect);
+  }
+  return true;
+}
+
+VideoRendition VideoCaptureImpl::renditionFor(
+    const MediaCaptureConfigC &config, const MediaCaptureRenditionC &rendition) {
+  VideoRendition settings;
+  settings.frameRate   = rendition.frameRate > 0 ? rendition.frameRate : config.frameRate;
+  settings.scale       = rendition.scale > 0 ? rendition.scale : 1.0;
+  settings.maxWidth    = rendition.maxWidth;
+  settings.imageFormat = rendition.imageFormat;
+  settings.quality     = rendition.quality > 0 ? rendition.quality : jpegQualityFor(config);
+  return settings;
+}
+
+bool VideoCaptureImpl::configure(const MediaCaptureConfigC &config) {
+  if (config.imageFormat != 1 && !jpegCodecAvailable()) {
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "JPEG output is unavailable: built without libjpeg");
+    return false;
+  }
+
+  this->config = config;
+  cropRect.set(config.cropRect);
+  {
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    jpegQuality = jpegQualityFor(config);
+    imageFormat = config.imageFormat;
+  }
+
+  // Optional closed loop over quality, downscale and frame rate
+  qualityController.reset();
+  if (hasQualityBudget(config)) {
+    QualityBudget   budget;
+    QualityBounds   bounds;
+    QualitySettings initial;
+    qualityLimitsFor(config, budget, bounds, initial);
+    qualityController = std::make_shared<AdaptiveQualityController>(budget, bounds, initial);
+  }
+  return true;
+}
+
+bool VideoCaptureImpl::reconfigure(const MediaCaptureConfigC &config) {
+  if (config.imageFormat != 1 && !jpegCodecAvailable()) {
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "JPEG output is unavailable: built without libjpeg");
+    return false;
+  }
+
+  // The encode thread of a shared pipeline reads the controller pointer at any time
+  bool addController = hasQualityBudget(config) && !qualityController;
+  if (addController && !pipeline) {
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "Adaptive quality can only be enabled when capture starts");
+    return false;
+  }
+
+  this->config = config;
+  cropRect.set(config.cropRect);
+  {
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    jpegQuality = jpegQualityFor(config);
+    imageFormat = config.imageFormat;
+  }
+
+  QualityBudget   budget;
+  QualityBounds   bounds;
+  QualitySettings initial;
+  qualityLimitsFor(config, budget, bounds, initial);
+  if (qualityController) {
+    // Without a budget the controller stays, disabled, and hands out the configured settings
+    qualityController->reconfigure(budget, bounds, initial);
+  } else if (addController) {
+    // Only the threads restart; the source and its connection stay open
+    pipeline->stop();
+    qualityController = std::make_shared<AdaptiveQualityController>(budget, bounds, initial);
+    pipeline          = std::make_unique<VideoPipeline>(*source, *this);
+    pipeline->setQualityController(qualityController);
+    pipeline->setSyncClock(syncClock);
+    pipeline->start(config.frameRate, videoCallback, exitCallback, context);
+    return true;
+  }
+
+  if (pipeline) {
+    pipeline->setFrameRate(config.frameRate);
+  }
+  return true;
+}
+
+void VideoCaptureImpl::stop() {
+  if (pipeline) {
+    pipeline->stop();
+  }
+  pipeline.reset();
+  source.reset();
+}
+
+bool VideoCaptureImpl::encodeFrame(const VideoFrame &frame, EncodedFrame &out) {
+  const uint8_t *pixels = frame.pixels.data();
+  int32_t        quality;
+  int32_t        format;
+  {
+    // One consistent set of settings per frame, even while reconfigure() runs
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    quality = jpegQuality;
+    format  = imageFormat;
+  }
+  out.width              = frame.width;
+  out.height             = frame.height;
+  out.bytesPerRow        = frame.bytesPerRow;
+
+  // The adaptive controller may ask for a smaller image and a lower quality
+  if (qualityController) {
+    QualitySettings settings = qualityController->settings();
+    quality                  = settings.quality;
+    if (settings.scale < 1.0) {
+      out.width       = scaledDimension(frame.width, settings.scale);
+      out.height      = scaledDimension(frame.height, settings.scale);
+      out.bytesPerRow = out.width * 4;
+      scaledPixels.resize(static_cast<size_t>(out.bytesPerRow) * out.height);
+      downscaleBGRA(pixels, frame.bytesPerRow, frame.width, frame.height, scaledPixels.data(), out.bytesPerRow,
+                    out.width, out.height);
+      pixels = scaledPixels.data();
+    }
+  }
+
+  // Raw output skips JPEG entirely; the addon converts BGRA to the requested layout
+  if (format == 1) {
+    out.data.assign(pixels, pixels + static_cast<size_t>(out.bytesPerRow) * out.height);
+    out.format = "bgra";
+    return true;
+  }
+
+  if (!encodeJPEG(pixels, out.width, out.height, out.bytesPerRow, quality, out.data)) {
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "Failed to encode %dx%d frame to JPEG", out.width, out.height);
+    return false;
+  }
+  out.format = "jpeg";
+  return true;
+}
+
+void VideoCaptureImpl::setCropRect(const MediaCaptureRectC &rect) {
+  cropRect.set(rect);
+}
+
+bool VideoCaptureImpl::checkCropRect(const MediaCaptureRectC &rect, std::string &error) const {
+  int32_t           width  = 0;
+  int32_t           height = 0;
+  MediaCaptureRectC region;
+  if (source && source->targetSize(width, height) && !resolveCropRect(rect, width, height, region)) {
+    error = "Crop rectangle is outside the " + std::to_string(width) + "x" + std::to_string(height) + " target";
+    return false;
+  }
+  return true;
+}
+
+VideoPipelineStats VideoCaptureImpl::stats() const {
+  return pipeline ? pipeline->stats() : VideoPipelineStats{};
+}
+
+bool VideoCaptureImpl::qualityStats(AdaptiveQualityStats &stats) const {
+  if (!qualityController || !qualityController->enabled()) {
+    return false;
+  }
+  stats = qualityController->stats();
+  return true;
+}
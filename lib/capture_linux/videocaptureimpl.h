@@ -0,0 +1,175 @@
+/**
+ * @file videocaptureimpl.h
+ * @brief Linux video capture: a frame source feeding the shared pipeline and encoder
+ */
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "adaptivequality.h"
+#include "capture/capture.h"
+#include "croprect.h"
+#include "renditionpipeline.h"
+#include "videopipeline.h"
+
+/**
+ * @class VideoCaptureImpl
+ * @brief Linux implementation of display and window video capture
+ *
+ * Owns the VideoFrameSource for the selected target (X11 or synthetic, see
+ * linuxbackend.h) and implements the encode stage: JPEG through the
+ * capture_core codec, or BGRA pass-through for raw output, with the same
+ * adaptive quality handling as the other platforms.
+ */
+class VideoCaptureImpl : public VideoFrameEncoder {
+public:
+  VideoCaptureImpl();
+
+  /**
+   * @brief Destructor - stops the pipeline if it is running
+   */
+  ~VideoCaptureImpl() override;
+
+  /**
+   * @brief Open the target and prepare the encoder without starting any thread
+   *
+   * On its own, this prepares one target of a MultiTargetPipeline, which then
+   * drives frameSource() and this encoder.
+   *
+   * @param config Media capture configuration
+   * @return false if the target does not exist or the format cannot be produced; lastEncodeError() describes why
+   */
+  bool open(const MediaCaptureConfigC &config);
+
+  /**
+   * @brief Frame source of the opened target
+   */
+  VideoFrameSource &frameSource() {
+    return *source;
+  }
+
+  /**
+   * @brief Settings of one output rendition; an unset frame rate or quality is taken from config
+   */
+  static VideoRendition renditionFor(const MediaCaptureConfigC &config, const MediaCaptureRenditionC &rendition);
+
+  /**
+   * @brief Adaptive quality controller of the opened target, or null if no budget was configured
+   */
+  std::shared_ptr<AdaptiveQualityController> adaptiveQuality() const {
+    return qualityController;
+  }
+
+  /**
+   * @brief Start video capture
+   *
+   * A target already opened with open() for the same displayID and windowID
+   * is reused; only the other settings of config are applied.
+   *
+   * @param config Media capture configuration
+   * @param videoCallback Function called with each encoded frame
+   * @param exitCallback Function called when an error occurs
+   * @param context User data passed to callbacks
+   * @param syncClock Clock shared with the audio source, used to stamp frames; may be null
+   * @return false if the target does not exist or the format cannot be produced; lastEncodeError() describes why
+   */
+  bool start(
+      const MediaCaptureConfigC &config, MediaCaptureDataCallback videoCallback, MediaCaptureExitCallback exitCallback,
+      void *context, std::shared_ptr<AvSyncClock> syncClock = nullptr);
+
+  /**
+   * @brief Apply new settings to the opened target without closing it
+   *
+   * Frame rate, JPEG quality, output format, crop and the adaptive quality
+   * budget change between two frames. Enabling adaptive quality restarts a
+   * pipeline started by start() on the same source; a target driven by a
+   * MultiTargetPipeline cannot gain a controller this way.
+   *
+   * @param config New configuration for the same displayID and windowID
+   * @return false if the format cannot be produced or a controller would have to be added to a
+   *         MultiTargetPipeline target; nothing changed then and lastEncodeError() describes why
+   */
+  bool reconfigure(const MediaCaptureConfigC &config);
+
+  /**
+   * @brief Stop the pipeline, if started, and release the source
+   */
+  void stop();
+
+  /**
+   * @brief Change the region of interest; takes effect from the next captured frame
+   * @param rect Crop rectangle in target pixels (zero size = full target)
+   */
+  void setCropRect(const MediaCaptureRectC &rect);
+
+  /**
+   * @brief Check a crop rectangle against the current size of the target, without applying it
+   * @param error Receives why the rectangle cannot be used
+   * @return false if it lies entirely outside the target
+   */
+  bool checkCropRect(const MediaCaptureRectC &rect, std::string &error) const;
+
+  /**
+   * @brief Snapshot of pipeline counters and per-stage timings
+   */
+  VideoPipelineStats stats() const;
+
+  /**
+   * @brief Snapshot of the adaptive quality controller
+   * @param stats Receives the controller state
+   * @return false if no budget was configured for this capture
+   */
+  bool qualityStats(AdaptiveQualityStats &stats) const;
+
+  /**
+   * @brief Encode a captured frame to JPEG, or pass BGRA through for raw output (encode thread)
+   */
+  bool encodeFrame(const VideoFrame &frame, EncodedFrame &out) override;
+
+  const char *lastEncodeError() const override {
+    return errorMsg;
+  }
+
+private:
+  /**
+   * @brief Apply the encoder settings of config without touching the source
+   * @return false if the format cannot be produced
+   */
+  bool configure(const MediaCaptureConfigC &config);
+
+  /** Current capture configuration */
+  MediaCaptureConfigC config;
+
+  /** Region of interest read by the source once per frame */
+  SharedCropRect cropRect;
+
+  /** Frame source for the selected target; created in open() */
+  std::unique_ptr<VideoFrameSource> source;
+
+  /** Capture and encode stages; created in start() */
+  std::unique_ptr<VideoPipeline> pipeline;
+
+  /** Callbacks and clock of start(), kept to restart the pipeline on the same source */
+  MediaCaptureDataCallback     videoCallback = nullptr;
+  MediaCaptureExitCallback     exitCallback  = nullptr;
+  void                        *context       = nullptr;
+  std::shared_ptr<AvSyncClock> syncClock;
+
+  /** @name Encoder settings, copied once per frame by the encode thread */
+  ///@{
+  std::mutex settingsMutex;
+  int32_t    jpegQuality = 75; /**< JPEG quality (0-100) derived from the configuration */
+  int32_t    imageFormat = 0;  /**< 0=JPEG, 1=raw BGRA */
+  ///@}
+
+  /** Closed-loop quality control; null unless a budget is configured */
+  std::shared_ptr<AdaptiveQualityController> qualityController;
+
+  /** Downscaled copy of the frame being encoded (encode thread only) */
+  std::vector<uint8_t> scaledPixels;
+
+  /** Buffer for error messages from start() and the encode stage */
+  char errorMsg[256];
+};
@@ -0,0 +1,508 @@
+/**
+ * @file x11capture.cc
+ * @brief Implementation of MIT-SHM screen and window capture
+ */
+#include "x11capture.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#ifdef CAPTURE_HAVE_XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+
+namespace {
+
+/**
+ * @name Error trapping
+ * Xlib reports protocol errors through a process-wide handler whose default
+ * terminates the process. Errors on connections opened here are recorded for
+ * the calling thread instead; all others are forwarded to the handler that was
+ * installed before, so an embedding application keeps its own behaviour.
+ */
+///@{
+std::mutex             trapMutex;
+std::vector<Display *> trappedDisplays;
+XErrorHandler          previousHandler  = nullptr;
+bool                   handlerInstalled = false;
+thread_local int       trappedError     = 0;
+
+int trapErrorHandler(Display *display, XErrorEvent *event) {
+  bool ours;
+  {
+    std::lock_guard<std::mutex> lock(trapMutex);
+    ours = std::find(trappedDisplays.begin(), trappedDisplays.end(), display) != trappedDisplays.end();
+  }
+  if (ours) {
+    trappedError = event->error_code;
+    return 0;
+  }
+  return previousHandler ? previousHandler(display, event) : 0;
+}
+
+Display *openDisplay() {
+  Display *display = XOpenDisplay(nullptr);
+  if (!display) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(trapMutex);
+  if (!handlerInstalled) {
+    previousHandler  = XSetErrorHandler(trapErrorHandler);
+    handlerInstalled = true;
+  }
+  trappedDisplays.push_back(display);
+  return display;
+}
+
+void closeDisplay(Display *display) {
+  if (!display) {
+    return;
+  }
+  XCloseDisplay(display);
+  std::lock_guard<std::mutex> lock(trapMutex);
+  trappedDisplays.erase(std::remove(trappedDisplays.begin(), trappedDisplays.end(), display), trappedDisplays.end());
+}
+///@}
+
+/** Frames are re-read at least this often even when XDamage reports no change */
+constexpr auto kKeepAliveInterval = std::chrono::seconds(1);
+
+std::string windowTitle(Display *display, ::Window window) {
+  Atom           netWmName = XInternAtom(display, "_NET_WM_NAME", False);
+  Atom           utf8      = XInternAtom(display, "UTF8_STRING", False);
+  Atom           type;
+  int            format;
+  unsigned long  count, after;
+  unsigned char *data = nullptr;
+  std::string    title;
+
+  if (XGetWindowProperty(display, window, netWmName, 0, 1024, False, utf8, &type, &format, &count, &after, &data) ==
+          Success &&
+      data) {
+    title.assign(reinterpret_cast<char *>(data), count);
+    XFree(data);
+  }
+  if (title.empty()) {
+    char *name = nullptr;
+    if (XFetchName(display, window, &name) && name) {
+      title = name;
+      XFree(name);
+    }
+  }
+  return title;
+}
+
+std::string windowClass(Display *display, ::Window window) {
+  XClassHint  hint = {nullptr, nullptr};
+  std::string appName;
+  if (XGetClassHint(display, window, &hint)) {
+    if (hint.res_class) {
+      appName = hint.res_class;
+    }
+    XFree(hint.res_name);
+    XFree(hint.res_class);
+  }
+  return appName;
+}
+
+/** Managed top-level windows, from _NET_CLIENT_LIST or, without a window manager, the root's children */
+std::vector<::Window> topLevelWindows(Display *display, ::Window root) {
+  std::vector<::Window> windows;
+  Atom                  clientList = XInternAtom(display, "_NET_CLIENT_LIST", True);
+  Atom                  type;
+  int                   format;
+  unsigned long         count, after;
+  unsigned char        *data = nullptr;
+
+  if (clientList != None &&
+      XGetWindowProperty(display, root, clientList, 0, 4096, False, XA_WINDOW, &type, &format, &count, &after,
+                         &data) == Success &&
+      data) {
+    // Format 32 properties are returned as arrays of long
+    const ::Window *list = reinterpret_cast<const ::Window *>(data);
+    windows.assign(list, list + count);
+    XFree(data);
+    return windows;
+  }
+
+  ::Window     rootReturn, parent;
+  ::Window    *children = nullptr;
+  unsigned int childCount = 0;
+  if (XQueryTree(display, root, &rootReturn, &parent, &children, &childCount) && children) {
+    windows.assign(children, children + childCount);
+    XFree(children);
+  }
+  return windows;
+}
+
+/**
+ * @class X11VideoSource
+ * @brief VideoFrameSource reading a screen or window with XShmGetImage
+ */
+class X11VideoSource : public VideoFrameSource {
+public:
+  explicit X11VideoSource(const SharedCropRect &cropRect) : cropRect(cropRect) {
+    std::memset(&shmInfo, 0, sizeof(shmInfo));
+    shmInfo.shmid = -1;
+    std::memset(errorMsg, 0, sizeof(errorMsg));
+  }
+
+  ~X11VideoSource() override {
+    releaseImage();
+#ifdef CAPTURE_HAVE_XDAMAGE
+    if (damage) {
+      XDamageDestroy(display, damage);
+    }
+#endif
+    closeDisplay(display);
+  }
+
+  bool open(uint32_t displayID, uint32_t windowID, std::string &error) {
+    display = openDisplay();
+    if (!display) {
+      error = "Cannot open X display";
+      return false;
+    }
+    if (!XShmQueryExtension(display)) {
+      error = "The X server does not support MIT-SHM";
+      return false;
+    }
+
+    if (windowID > 0) {
+      isWindow = true;
+      drawable = static_cast<::Window>(windowID);
+    } else {
+      int screen = static_cast<int>(displayID) - 1;
+      if (screen < 0 || screen >= ScreenCount(display)) {
+        error = "No X screen for displayID=" + std::to_string(displayID);
+        return false;
+      }
+      drawable = RootWindow(display, screen);
+    }
+
+    if (refreshGeometry() != AcquireResult::Frame) {
+      error = errorMsg;
+      return false;
+    }
+
+#ifdef CAPTURE_HAVE_XDAMAGE
+    int damageErrorBase;
+    if (XDamageQueryExtension(display, &damageEventBase, &damageErrorBase)) {
+      trappedError = 0;
+      damage       = XDamageCreate(display, drawable, XDamageReportNonEmpty);
+      XSync(display, False);
+      if (trappedError) {
+        damage = 0;
+      }
+    }
+#endif
+    return true;
+  }
+
+  AcquireResult acquireFrame(VideoFrame &frame, uint32_t /*timeoutMs*/) override {
+    if (isWindow) {
+      AcquireResult geometry = refreshGeometry();
+      if (geometry != AcquireResult::Frame) {
+        return geometry;
+      }
+    }
+
+    // Skip the read entirely while XDamage reports no change
+    auto now = std::chrono::steady_clock::now();
+    if (damage && !takeDamage() && delivered && now - lastFrameTime < kKeepAliveInterval) {
+      return AcquireResult::Timeout;
+    }
+
+    MediaCaptureRectC region;
+    if (!resolveCropRect(cropRect.get(), width, height, region)) {
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "Crop rectangle is outside the %dx%d target", width, height);
+      return AcquireResult::Error;
+    }
+
+    // The shared segment only changes when the region size does
+    if (!image || image->width != region.width || image->height != region.height) {
+      releaseImage();
+      if (!createImage(region.width, region.height)) {
+        return AcquireResult::Error;
+      }
+    }
+
+    trappedError = 0;
+    if (!XShmGetImage(display, drawable, image, region.x, region.y, AllPlanes) || trappedError) {
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "XShmGetImage failed (X error %d)", trappedError);
+      return AcquireResult::Error;
+    }
+
+    // Copy out of the segment into the recycled frame buffer; X leaves the alpha byte undefined
+    int32_t bytesPerRow = region.width * 4;
+    size_t  bufferSize  = static_cast<size_t>(bytesPerRow) * region.height;
+    if (frame.pixels.size() != bufferSize) {
+      frame.pixels.resize(bufferSize);
+    }
+    int64_t copyStart = monotonicNowNs();
+    for (int32_t y = 0; y < region.height; y++) {
+      const uint32_t *src = reinterpret_cast<const uint32_t *>(image->data + static_cast<size_t>(y) * image->bytes_per_line);
+      uint32_t       *dst = reinterpret_cast<uint32_t *>(frame.pixels.data() + static_cast<size_t>(y) * bytesPerRow);
+      for (int32_t x = 0; x < region.width; x++) {
+        dst[x] = src[x] | 0xff000000u;
+      }
+    }
+    frame.copyNs = monotonicNowNs() - copyStart;
+
+    frame.width       = region.width;
+    frame.height      = region.height;
+    frame.bytesPerRow = bytesPerRow;
+    delivered         = true;
+    lastFrameTime     = now;
+    return AcquireResult::Frame;
+  }
+
+  const char *lastAcquireError() const override {
+    return errorMsg;
+  }
+
+  bool targetSize(int32_t &targetWidth, int32_t &targetHeight) const override {
+    targetWidth  = sharedWidth.load();
+    targetHeight = sharedHeight.load();
+    return targetWidth > 0 && targetHeight > 0;
+  }
+
+private:
+  /**
+   * Read the size, visual and depth of the target
+   * @return Frame when read, Error while the window is unmapped (minimized), Fatal once it is destroyed
+   */
+  AcquireResult refreshGeometry() {
+    XWindowAttributes attributes;
+    trappedError = 0;
+    if (!XGetWindowAttributes(display, drawable, &attributes) || trappedError) {
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "Window 0x%lx no longer exists", static_cast<unsigned long>(drawable));
+      return AcquireResult::Fatal;
+    }
+    if (isWindow && attributes.map_state != IsViewable) {
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "Window 0x%lx is not viewable", static_cast<unsigned long>(drawable));
+      return AcquireResult::Error;
+    }
+    width  = attributes.width;
+    height = attributes.height;
+    visual = attributes.visual;
+    depth  = attributes.depth;
+    sharedWidth.store(width);
+    sharedHeight.store(height);
+    return AcquireResult::Frame;
+  }
+
+  bool createImage(int32_t imageWidth, int32_t imageHeight) {
+    image = XShmCreateImage(display, visual, static_cast<unsigned int>(depth), ZPixmap, nullptr, &shmInfo,
+                            static_cast<unsigned int>(imageWidth), static_cast<unsigned int>(imageHeight));
+    if (!image) {
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "XShmCreateImage failed for %dx%d", imageWidth, imageHeight);
+      return false;
+    }
+    if (image->bits_per_pixel != 32 || image->red_mask != 0xff0000 || image->green_mask != 0xff00 ||
+        image->blue_mask != 0xff || image->byte_order != LSBFirst) {
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "Unsupported X visual: %d bits per pixel, depth %d",
+               image->bits_per_pixel, depth);
+      releaseImage();
+      return false;
+    }
+
+    shmInfo.shmid = shmget(IPC_PRIVATE, static_cast<size_t>(image->bytes_per_line) * image->height, IPC_CREAT | 0600);
+    if (shmInfo.shmid < 0) {
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "shmget failed for %dx%d", imageWidth, imageHeight);
+      releaseImage();
+      return false;
+    }
+    shmInfo.shmaddr  = static_cast<char *>(shmat(shmInfo.shmid, nullptr, 0));
+    shmInfo.readOnly = False;
+    image->data      = shmInfo.shmaddr;
+    if (shmInfo.shmaddr == reinterpret_cast<char *>(-1)) {
+      shmInfo.shmaddr = nullptr;
+      image->data     = nullptr;
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "shmat failed");
+      releaseImage();
+      return false;
+    }
+
+    trappedError = 0;
+    shmAttached  = XShmAttach(display, &shmInfo) && (XSync(display, False), trappedError == 0);
+
+    // Marked for removal now so the segment cannot leak if the process dies; it lives until both sides detach
+    shmctl(shmInfo.shmid, IPC_RMID, nullptr);
+    if (!shmAttached) {
+      snprintf(errorMsg, sizeof(errorMsg) - 1, "XShmAttach failed; MIT-SHM needs a local X server");
+      releaseImage();
+      return false;
+    }
+    return true;
+  }
+
+  void releaseImage() {
+    if (shmAttached) {
+      XShmDetach(display, &shmInfo);
+      XSync(display, False);
+      shmAttached = false;
+    }
+    if (image) {
+      image->data = nullptr;
+      XDestroyImage(image);
+      image = nullptr;
+    }
+    if (shmInfo.shmaddr) {
+      shmdt(shmInfo.shmaddr);
+      shmInfo.shmaddr = nullptr;
+    }
+    if (shmInfo.shmid >= 0) {
+      shmctl(shmInfo.shmid, IPC_RMID, nullptr);
+      shmInfo.shmid = -1;
+    }
+  }
+
+  /** Drain pending events and report whether the target changed; clears the damage */
+  bool takeDamage() {
+#ifdef CAPTURE_HAVE_XDAMAGE
+    bool changed = false;
+    while (XPending(display) > 0) {
+      XEvent event;
+      XNextEvent(display, &event);
+      if (event.type == damageEventBase + XDamageNotify) {
+        changed = true;
+      }
+    }
+    if (changed) {
+      // Subtract before the read so changes made during it raise a new notification
+      XDamageSubtract(display, damage, None, None);
+    }
+    return changed;
+#else
+    return true;
+#endif
+  }
+
+  const SharedCropRect &cropRect;
+
+  Display  *display  = nullptr;
+  ::Window  drawable = 0;
+  bool      isWindow = false;
+  Visual   *visual   = nullptr;
+  int       depth    = 0;
+  int32_t   width    = 0;
+  int32_t   height   = 0;
+
+  /** width and height for targetSize(), which runs outside the capture thread */
+  std::atomic<int32_t> sharedWidth{0};
+  std::atomic<int32_t> sharedHeight{0};
+
+  /** Image backed by the shared segment; sized to the current region of interest */
+  XImage         *image = nullptr;
+  XShmSegmentInfo shmInfo;
+  bool            shmAttached = false;
+
+  /** @name Change tracking (XDamage) */
+  ///@{
+#ifdef CAPTURE_HAVE_XDAMAGE
+  Damage damage = 0;
+#else
+  unsigned long damage = 0;
+#endif
+  int                                   damageEventBase = 0;
+  bool                                  delivered       = false;
+  std::chrono::steady_clock::time_point lastFrameTime;
+  ///@}
+
+  char errorMsg[256];
+};
+
+} // namespace
+
+bool x11DisplayAvailable() {
+  const char *name = std::getenv("DISPLAY");
+  if (!name || !*name) {
+    return false;
+  }
+  Display *display = XOpenDisplay(nullptr);
+  if (!display) {
+    return false;
+  }
+  XCloseDisplay(display);
+  return true;
+}
+
+bool enumerateX11Targets(int32_t targetType, std::vector<X11Target> &targets, std::string &error) {
+  Display *display = openDisplay();
+  if (!display) {
+    error = "Cannot open X display";
+    return false;
+  }
+
+  // Target types: 0=all, 1=screens only, 2=windows only
+  bool includeScreens = (targetType == 0 || targetType == 1);
+  bool includeWindows = (targetType == 0 || targetType == 2);
+
+  for (int screen = 0; screen < ScreenCount(display); screen++) {
+    if (includeScreens) {
+      X11Target target;
+      target.isDisplay = true;
+      target.id        = static_cast<uint32_t>(screen + 1);
+      target.width     = DisplayWidth(display, screen);
+      target.height    = DisplayHeight(display, screen);
+      target.title     = "Display " + std::to_string(screen + 1);
+      if (screen == DefaultScreen(display)) {
+        target.title += " (Primary)";
+      }
+      target.appName = "Screen";
+      targets.push_back(target);
+    }
+
+    if (includeWindows) {
+      for (::Window window : topLevelWindows(display, RootWindow(display, screen))) {
+        XWindowAttributes attributes;
+        trappedError = 0;
+        if (!XGetWindowAttributes(display, window, &attributes) || trappedError) {
+          continue; // Destroyed while enumerating
+        }
+
+        // Skip unmapped, override-redirect (menus, tooltips) and very small windows
+        if (attributes.map_state != IsViewable || attributes.override_redirect || attributes.width < 50 ||
+            attributes.height < 50) {
+          continue;
+        }
+
+        X11Target target;
+        target.id     = static_cast<uint32_t>(window);
+        target.width  = attributes.width;
+        target.height = attributes.height;
+        target.title  = windowTitle(display, window);
+        if (target.title.empty()) {
+          continue;
+        }
+        target.appName = windowClass(display, window);
+        if (target.appName.empty()) {
+          target.appName = "Unknown";
+        }
+        targets.push_back(target);
+      }
+    }
+  }
+
+  closeDisplay(display);
+  return true;
+}
+
+std::unique_ptr<VideoFrameSource>
+createX11VideoSource(uint32_t displayID, uint32_t windowID, const SharedCropRect &cropRect, std::string &error) {
+  auto source = std::make_unique<X11VideoSource>(cropRect);
+  if (!source->open(displayID, windowID, error)) {
+    return nullptr;
+  }
+  return source;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file x11capture.h
+ * @brief X11 screen and window capture through MIT-SHM
+ *
+ * Frames are read with XShmGetImage into a shared memory segment that is
+ * created once per capture size and copied straight into the pipeline's
+ * recycled frame buffer, so steady-state capture performs no allocations.
+ * When the server supports XDamage, frames are only read after the target
+ * has changed (plus one keep-alive frame per second).
+ *
+ * Only compiled when CAPTURE_HAVE_X11 is defined. Xlib headers are kept out
+ * of this interface.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "croprect.h"
+#include "videopipeline.h"
+
+/**
+ * @struct X11Target
+ * @brief A screen or top-level window found by enumerateX11Targets()
+ */
+struct X11Target {
+  bool        isDisplay = false; /**< true for a screen, false for a window */
+  uint32_t    id        = 0;     /**< Screen number + 1, or the X window ID */
+  int32_t     width     = 0;     /**< Width in pixels */
+  int32_t     height    = 0;     /**< Height in pixels */
+  std::string title;             /**< Screen name or window title */
+  std::string appName;           /**< "Screen", or the window's WM_CLASS class */
+};
+
+/**
+ * @brief Whether an X server can be reached through $DISPLAY
+ */
+bool x11DisplayAvailable();
+
+/**
+ * @brief List screens and top-level windows
+ * @param targetType 0=all, 1=screens only, 2=windows only
+ * @param targets Receives the targets
+ * @param error Receives a description if the server cannot be reached
+ * @return false if the server cannot be reached
+ */
+bool enumerateX11Targets(int32_t targetType, std::vector<X11Target> &targets, std::string &error);
+
+/**
+ * @brief Open a capture source for a screen or window
+ * @param displayID Screen number + 1; ignored when windowID is set
+ * @param windowID X window ID, or 0 to capture a screen
+ * @param cropRect Region of interest, read once per frame; must outlive the source
+ * @param error Receives a description on failure
+ * @return The source, or null on failure
+ */
+std::unique_ptr<VideoFrameSource>
+createX11VideoSource(uint32_t displayID, uint32_t windowID, const SharedCropRect &cropRect, std::string &error);
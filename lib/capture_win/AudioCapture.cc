@@ -59,4 +59,11 @@ void  startCapture(void *client, CaptureConfig cc, StartCaptureDataCallback data
 
 void  stopCapture(void *client, StopCaptureCallback stopCallback, void *context) {
     ((AudioCaptureClient*)client)->stopCapture(stopCallback, context);
+}
+
+int32_t getCaptureStats(void *client, MediaCaptureStatsC *stats) {
+    if (!client || !stats) {
+        return 0;
+    }
+    return ((AudioCaptureClient*)client)->getStats(*stats) ? 1 : 0;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "capture/capture.h"
 #include "mediacaptureclient.h"
 #include <memory>
+#include <string>
 
 /**
  * C API implementation for MediaCaptureWin
@@ -38,6 +39,19 @@ void enumerateMediaCaptureTargets(int32_t targetType, EnumerateMediaCaptureTarge
   MediaCaptureClient::enumerateTargets(targetType, callback, context);
 }
 
+/**
+ * Open the display and audio client for the next start; the callback runs before this returns
+ */
+void prepareMediaCapture(void *capture, MediaCaptureConfigC config, MediaCaptureExitCallback callback, void *context) {
+  std::string error = capture ? "" : "Invalid media capture instance";
+  if (capture) {
+    static_cast<MediaCaptureClient *>(capture)->prepare(config, error);
+  }
+  if (callback) {
+    callback(error.empty() ? nullptr : const_cast<char *>(error.c_str()), context);
+  }
+}
+
 /**
  * Start media capture
  */
@@ -64,6 +78,45 @@ void startMediaCapture(
   }
 }
 
+/**
+ * Start capturing several displays in one session
+ */
+void startMultiTargetMediaCapture(
+    void *capture, MediaCaptureConfigC config, const MediaCaptureTargetRefC *targets, int32_t targetCount,
+    MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback, void *context) {
+  if (!capture) {
+    if (exitCallback) {
+      exitCallback("Invalid media capture instance", context);
+    }
+    return;
+  }
+
+  // startMultiTargetCapture reports its own failures through exitCallback
+  MediaCaptureClient *client = static_cast<MediaCaptureClient *>(capture);
+  client->startMultiTargetCapture(config, targets, targetCount, videoCallback, audioCallback, exitCallback, context);
+}
+
+/**
+ * Start capturing one display in several renditions in one session
+ */
+void startMultiRenditionMediaCapture(
+    void *capture, MediaCaptureConfigC config, const MediaCaptureRenditionC *renditions, int32_t renditionCount,
+    MediaCaptureTargetDataCallback videoCallback, MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback, void *context) {
+  if (!capture) {
+    if (exitCallback) {
+      exitCallback("Invalid media capture instance", context);
+    }
+    return;
+  }
+
+  // startMultiRenditionCapture reports its own failures through exitCallback
+  MediaCaptureClient *client = static_cast<MediaCaptureClient *>(capture);
+  client->startMultiRenditionCapture(
+      config, renditions, renditionCount, videoCallback, audioCallback, exitCallback, context);
+}
+
 /**
  * Stop media capture
  */
@@ -79,4 +132,56 @@ void stopMediaCapture(void *capture, StopCaptureCallback stopCallback, void *con
   client->stopCapture(stopCallback, context);
 }
 
+/**
+ * Update the region of interest of a running media capture; the callback runs before this returns
+ */
+void setMediaCaptureCropRect(
+    void *capture, MediaCaptureRectC cropRect, MediaCaptureExitCallback callback, void *context) {
+  std::string error = capture ? "" : "Invalid media capture instance";
+  if (capture) {
+    static_cast<MediaCaptureClient *>(capture)->setCropRect(cropRect, error);
+  }
+  if (callback) {
+    callback(error.empty() ? nullptr : const_cast<char *>(error.c_str()), context);
+  }
+}
+
+/**
+ * Apply a new configuration to a running media capture; the callback runs before this returns
+ */
+void reconfigureMediaCapture(
+    void *capture, MediaCaptureConfigC config, MediaCaptureExitCallback callback, void *context) {
+  std::string error = capture ? "" : "Invalid media capture instance";
+  if (capture) {
+    static_cast<MediaCaptureClient *>(capture)->reconfigure(config, error);
+  }
+  if (callback) {
+    callback(error.empty() ? nullptr : const_cast<char *>(error.c_str()), context);
+  }
+}
+
+/**
+ * Read the adaptive quality controller of a running media capture
+ */
+int32_t getMediaCaptureQualityStats(void *capture, MediaCaptureQualityStatsC *stats) {
+  if (!capture || !stats) {
+    return 0;
+  }
+
+  MediaCaptureClient *client = static_cast<MediaCaptureClient *>(capture);
+  return client->getQualityStats(*stats) ? 1 : 0;
+}
+
+/**
+ * Read the counters and stage latencies of a media capture
+ */
+int32_t getMediaCaptureStats(void *capture, MediaCaptureStatsC *stats) {
+  if (!capture || !stats) {
+    return 0;
+  }
+
+  MediaCaptureClient *client = static_cast<MediaCaptureClient *>(capture);
+  return client->getStats(*stats) ? 1 : 0;
+}
+
 } // extern "C"
\ No newline at end of file
@@ -3,6 +3,8 @@
  * @brief Windows implementation of audio capture functionality
  */
 #include "audiocaptureimpl.h"
+#include "audioconvert.h"
+#include "capturetrace.h"
 #include <cstring>
 
 AudioCaptureImpl::AudioCaptureImpl() :
@@ -24,41 +26,39 @@ AudioCaptureImpl::AudioCaptureImpl() :
 }
 
 AudioCaptureImpl::~AudioCaptureImpl() {
-    if (isCapturing.load()) {
+    if (isCapturing.load() || audioClient) {
         stop(nullptr, nullptr);
     }
 }
 
+bool AudioCaptureImpl::isPreparedFor(const MediaCaptureConfigC& config) const {
+    return captureClient && !isCapturing.load() &&
+           this->config.audioSampleRate == config.audioSampleRate &&
+           this->config.audioChannels == config.audioChannels &&
+           (this->config.windowID == 101) == (config.windowID == 101);
+}
+
 /**
- * Starts audio capture with specified configuration
+ * Opens and initializes the audio client without starting it
  * 
  * @param config Media capture configuration
- * @param audioCallback Callback for audio data
- * @param exitCallback Callback for error handling
- * @param context User data passed to callbacks
- * @return True if capture starts successfully, false otherwise
+ * @return True if the client is ready to start, false otherwise (errorMsg describes why)
  */
-bool AudioCaptureImpl::start(
-    const MediaCaptureConfigC& config,
-    MediaCaptureAudioDataCallback audioCallback,
-    MediaCaptureExitCallback exitCallback,
-    void* context
-) {
+bool AudioCaptureImpl::prepare(const MediaCaptureConfigC& config) {
+    // A previous preparation for another format is replaced
+    if (audioClient || sampleRateConverter) {
+        stop(nullptr, nullptr);
+    }
+
     this->config = config;
     
     if (config.audioChannels <= 0 || config.audioChannels > 2) {
         snprintf(errorMsg, sizeof(errorMsg)-1, "Unsupported value %d for audioChannels, only 1-2 channels supported", config.audioChannels);
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         return false;
     }
 
     if (config.audioSampleRate <= 0) {
         snprintf(errorMsg, sizeof(errorMsg)-1, "Invalid sample rate: %d", config.audioSampleRate);
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         return false;
     }
 
@@ -71,9 +71,6 @@ bool AudioCaptureImpl::start(
         hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
         if (hr != S_OK && hr != S_FALSE && hr != RPC_E_CHANGED_MODE) {
             snprintf(errorMsg, sizeof(errorMsg)-1, "Failed to initialize COM: 0x%lx", hr);
-            if (exitCallback) {
-                exitCallback(errorMsg, context);
-            }
             return false;
         }
         
@@ -92,9 +89,6 @@ bool AudioCaptureImpl::start(
     sampleRateConverter = src_new(SRC_SINC_BEST_QUALITY, config.audioChannels, &error);
     if (!sampleRateConverter) {
         snprintf(errorMsg, sizeof(errorMsg)-1, "Could not create sample rate converter, error code: %d", error);
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         return false;
     }
 
@@ -109,9 +103,6 @@ bool AudioCaptureImpl::start(
 
     if (FAILED(hr)) {
         snprintf(errorMsg, sizeof(errorMsg)-1, "Error initializing audio capture: CoCreateInstance failed with 0x%lx", hr);
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         return false;
     }
 
@@ -124,9 +115,6 @@ bool AudioCaptureImpl::start(
 
     if (FAILED(hr)) {
         snprintf(errorMsg, sizeof(errorMsg)-1, "Error getting audio endpoint: 0x%lx", hr);
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         return false;
     }
 
@@ -143,9 +131,6 @@ bool AudioCaptureImpl::start(
     
     if (FAILED(hr)) {
         snprintf(errorMsg, sizeof(errorMsg)-1, "Error activating audio client: 0x%lx", hr);
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         return false;
     }
 
@@ -153,9 +138,6 @@ bool AudioCaptureImpl::start(
     hr = audioClient->GetMixFormat(&format);
     if (FAILED(hr)) {
         snprintf(errorMsg, sizeof(errorMsg)-1, "Error getting audio format: 0x%lx", hr);
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         return false;
     }
 
@@ -169,9 +151,6 @@ bool AudioCaptureImpl::start(
         snprintf(errorMsg, sizeof(errorMsg)-1, 
                 "Unsupported audio format: wFormatTag=%d, wBitsPerSample=%d",
                 format->wFormatTag, format->wBitsPerSample);
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         return false;
     }
 
@@ -179,9 +158,6 @@ bool AudioCaptureImpl::start(
     hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
     if (hEvent == NULL) {
         snprintf(errorMsg, sizeof(errorMsg)-1, "Failed to create audio event");
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         return false;
     }
 
@@ -206,9 +182,6 @@ bool AudioCaptureImpl::start(
 
     if (FAILED(hr)) {
         snprintf(errorMsg, sizeof(errorMsg)-1, "Error initializing audio client: 0x%lx", hr);
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         return false;
     }
 
@@ -216,9 +189,6 @@ bool AudioCaptureImpl::start(
     hr = audioClient->SetEventHandle(hEvent);
     if (FAILED(hr)) {
         snprintf(errorMsg, sizeof(errorMsg)-1, "Error setting audio event handle: 0x%lx", hr);
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         return false;
     }
 
@@ -229,11 +199,35 @@ bool AudioCaptureImpl::start(
     );
     if (FAILED(hr)) {
         snprintf(errorMsg, sizeof(errorMsg)-1, "Error getting audio capture client: 0x%lx", hr);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Starts audio capture with specified configuration
+ * 
+ * @param config Media capture configuration
+ * @param audioCallback Callback for audio data
+ * @param exitCallback Callback for error handling
+ * @param context User data passed to callbacks
+ * @return True if capture starts successfully, false otherwise
+ */
+bool AudioCaptureImpl::start(
+    const MediaCaptureConfigC& config,
+    MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback,
+    void* context
+) {
+    // A client prepared for the same device and format only has to be started
+    if (!isPreparedFor(config) && !prepare(config)) {
         if (exitCallback) {
             exitCallback(errorMsg, context);
         }
         return false;
     }
+    this->config = config;
 
     // Start audio capture
     hr = audioClient->Start();
@@ -246,6 +240,7 @@ bool AudioCaptureImpl::start(
     }
 
     // Start capture thread
+    deliveredFrames = 0;
     isCapturing.store(true);
     captureThread = new std::thread(
         &AudioCaptureImpl::captureThreadProc,
@@ -264,6 +259,8 @@ void AudioCaptureImpl::captureThreadProc(
     MediaCaptureExitCallback exitCallback,
     void* context
 ) {
+    setTraceThreadName("audio-capture");
+    UINT64 qpcPosition = 0;
     while (isCapturing.load()) {
         DWORD waitResult = WaitForSingleObject(hEvent, INFINITE);
         if (waitResult != WAIT_OBJECT_0) {
@@ -286,13 +283,22 @@ void AudioCaptureImpl::captureThreadProc(
         }
         
         while (packetSize > 0) {
+            if (!applyPendingFormat()) {
+                if (isCapturing.load() && exitCallback) {
+                    exitCallback(errorMsg, context);
+                }
+                break;
+            }
+
             // Get audio buffer
+            uint64_t packet = audioStats.packets.load(std::memory_order_relaxed);
+            int64_t acquireStart = monotonicNowNs();
             hr = captureClient->GetBuffer(
                 &buffer,
                 &numFramesInPacket,
                 &flags,
                 NULL,
-                NULL
+                &qpcPosition
             );
             
             if (FAILED(hr)) {
@@ -311,17 +317,27 @@ void AudioCaptureImpl::captureThreadProc(
                 // Copy original data
                 audioBufferOriginal.resize(numSamples);
                 std::memcpy(audioBufferOriginal.data(), audioData, numSamples * sizeof(float));
+                int64_t acquireEnd = monotonicNowNs();
+                audioStats.acquire.record(static_cast<uint64_t>(acquireEnd - acquireStart));
+                traceSpan("audio-acquire", packet, acquireStart, acquireEnd);
+
+                // The device position is in 100 ns units of the performance counter that
+                // steady_clock (monotonicNowNs) reads, so it is the first sample's capture time
+                int64_t firstSampleNs = static_cast<int64_t>(qpcPosition) * 100;
+                if ((flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR) != 0 || qpcPosition == 0) {
+                    firstSampleNs = acquireStart -
+                        static_cast<int64_t>(numFramesInPacket) * 1000000000 / static_cast<int64_t>(format->nSamplesPerSec);
+                }
                 
                 // Channel conversion (stereo to mono if needed)
                 if (format->nChannels > 1 && config.audioChannels == 1) {
+                    int64_t downmixStart = monotonicNowNs();
                     audioBufferConverted.resize(numFramesInPacket);
-                    for (UINT32 i = 0; i < numFramesInPacket; ++i) {
-                        float sum = 0.0f;
-                        for (UINT16 ch = 0; ch < format->nChannels; ++ch) {
-                            sum += audioBufferOriginal[i * format->nChannels + ch];
-                        }
-                        audioBufferConverted[i] = sum / format->nChannels;
-                    }
+                    downmixToMono(audioBufferOriginal.data(), format->nChannels, numFramesInPacket,
+                                  audioBufferConverted.data());
+                    int64_t downmixEnd = monotonicNowNs();
+                    audioStats.downmix.record(static_cast<uint64_t>(downmixEnd - downmixStart));
+                    traceSpan("downmix", packet, downmixStart, downmixEnd);
                 } else {
                     audioBufferConverted = audioBufferOriginal;
                 }
@@ -340,13 +356,20 @@ void AudioCaptureImpl::captureThreadProc(
                     srcData.output_frames = outputFrames;
                     srcData.end_of_input = 0;
                     
+                    int64_t resampleStart = monotonicNowNs();
                     int error = src_process(sampleRateConverter, &srcData);
+                    int64_t resampleEnd = monotonicNowNs();
+                    audioStats.resample.record(static_cast<uint64_t>(resampleEnd - resampleStart));
+                    traceSpan("resample", packet, resampleStart, resampleEnd);
                     if (error != 0) {
                         if (isCapturing.load() && exitCallback) {
                             snprintf(errorMsg, sizeof(errorMsg)-1, "Error resampling audio: %s", src_strerror(error));
                             exitCallback(errorMsg, context);
                         }
                     } else if (audioCallback && srcData.output_frames_gen > 0) {
+                        int64_t deliverStart = monotonicNowNs();
+                        setCurrentSyncStamp(stampPacket(
+                            firstSampleNs, static_cast<uint32_t>(srcData.output_frames_gen), config.audioSampleRate));
                         audioCallback(
                             config.audioChannels,
                             config.audioSampleRate,
@@ -354,8 +377,16 @@ void AudioCaptureImpl::captureThreadProc(
                             srcData.output_frames_gen,
                             context
                         );
+                        setCurrentSyncStamp(SyncStamp());
+                        int64_t deliverEnd = monotonicNowNs();
+                        audioStats.deliver.record(static_cast<uint64_t>(deliverEnd - deliverStart));
+                        audioStats.addPacket(static_cast<int32_t>(srcData.output_frames_gen));
+                        traceSpan("audio-deliver", packet, deliverStart, deliverEnd);
                     }
                 } else if (audioCallback) {
+                    int64_t deliverStart = monotonicNowNs();
+                    setCurrentSyncStamp(stampPacket(
+                        firstSampleNs, numFramesInPacket, static_cast<int32_t>(format->nSamplesPerSec)));
                     audioCallback(
                         config.audioChannels,
                         format->nSamplesPerSec,
@@ -363,6 +394,11 @@ void AudioCaptureImpl::captureThreadProc(
                         numFramesInPacket,
                         context
                     );
+                    setCurrentSyncStamp(SyncStamp());
+                    int64_t deliverEnd = monotonicNowNs();
+                    audioStats.deliver.record(static_cast<uint64_t>(deliverEnd - deliverStart));
+                    audioStats.addPacket(static_cast<int32_t>(numFramesInPacket));
+                    traceSpan("audio-deliver", packet, deliverStart, deliverEnd);
                 }
             }
             
@@ -389,6 +425,70 @@ void AudioCaptureImpl::captureThreadProc(
     }
 }
 
+/**
+ * Stamp a packet for its callback; the sync clock smooths the device timestamps
+ */
+/**
+ * Queue a new output format for the capture thread
+ */
+bool AudioCaptureImpl::setFormat(int32_t sampleRate, int32_t channels) {
+    if (!isSupportedFormat(sampleRate, channels)) {
+        return false;
+    }
+    pendingFormat.store((static_cast<uint64_t>(sampleRate) << 32) | static_cast<uint32_t>(channels));
+    return true;
+}
+
+/**
+ * Output formats the resampler can deliver
+ */
+bool AudioCaptureImpl::isSupportedFormat(int32_t sampleRate, int32_t channels) {
+    return sampleRate > 0 && channels > 0 && channels <= 2;
+}
+
+/**
+ * Apply a queued output format between two packets
+ */
+bool AudioCaptureImpl::applyPendingFormat() {
+    uint64_t pending = pendingFormat.exchange(0);
+    if (pending == 0) {
+        return true;
+    }
+
+    int32_t sampleRate = static_cast<int32_t>(pending >> 32);
+    int32_t channels = static_cast<int32_t>(pending & 0xffffffff);
+    if (channels != config.audioChannels) {
+        // The converter's channel count is fixed when it is created
+        int error = 0;
+        SRC_STATE* converter = src_new(SRC_SINC_BEST_QUALITY, channels, &error);
+        if (!converter) {
+            snprintf(errorMsg, sizeof(errorMsg)-1, "Could not create sample rate converter, error code: %d", error);
+            return false;
+        }
+        src_delete(sampleRateConverter);
+        sampleRateConverter = converter;
+    } else {
+        src_reset(sampleRateConverter);
+    }
+    config.audioSampleRate = sampleRate;
+    config.audioChannels = channels;
+    return true;
+}
+
+SyncStamp AudioCaptureImpl::stampPacket(int64_t firstSampleNs, uint32_t frames, int32_t sampleRate) {
+    if (syncClock) {
+        return syncClock->stampForAudio(syncClock->addAudio(firstSampleNs, frames, sampleRate));
+    }
+
+    SyncStamp stamp;
+    stamp.valid = true;
+    stamp.captureNs = firstSampleNs;
+    stamp.hasAudio = true;
+    stamp.audioPosition = deliveredFrames;
+    deliveredFrames += frames;
+    return stamp;
+}
+
 /**
  * Stops audio capture and cleans up resources
  * 
@@ -14,8 +14,11 @@
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <memory>
 #include <samplerate.h>
+#include "avsync.h"
 #include "capture/capture.h"
+#include "capturestats.h"
 
 /**
  * @class AudioCaptureImpl
@@ -36,6 +39,29 @@ public:
      */
     ~AudioCaptureImpl();
 
+    /**
+     * @brief Open and initialize the audio client without starting it
+     * 
+     * A following start() for the same device, sample rate and channel count
+     * only starts the client and the capture thread. stop() releases it.
+     * 
+     * @param config Media capture configuration including sample rate, channels, etc.
+     * @return true if the client is ready; otherwise lastError() describes why
+     */
+    bool prepare(const MediaCaptureConfigC& config);
+
+    /**
+     * @brief Whether prepare() opened a client that start() can use for config
+     */
+    bool isPreparedFor(const MediaCaptureConfigC& config) const;
+
+    /**
+     * @brief Message describing the last failure
+     */
+    const char* lastError() const {
+        return errorMsg;
+    }
+
     /**
      * @brief Start audio capture with specified configuration
      * 
@@ -63,6 +89,37 @@ public:
         void* context
     );
 
+    /**
+     * @brief Change the delivered sample rate and channel count while capturing
+     * 
+     * The capture thread applies the format before the next packet; the
+     * resampler is reset so no samples of the old format leak into it.
+     * 
+     * @param sampleRate New sample rate in Hz
+     * @param channels New channel count (1-2)
+     * @return false if the format is unsupported; the current one stays then
+     */
+    bool setFormat(int32_t sampleRate, int32_t channels);
+
+    /**
+     * @brief Whether setFormat() accepts a format
+     */
+    static bool isSupportedFormat(int32_t sampleRate, int32_t channels);
+
+    /**
+     * @brief Report delivered packets to a clock shared with video capture; call before start()
+     */
+    void setSyncClock(std::shared_ptr<AvSyncClock> clock) {
+        syncClock = std::move(clock);
+    }
+
+    /**
+     * @brief Counters and stage timings since capture started
+     */
+    AudioStatsSnapshot stats() const {
+        return audioStats.snapshot();
+    }
+
 private:
     /** HRESULT status code for COM operations */
     HRESULT hr;
@@ -118,6 +175,32 @@ private:
     /** Buffer for error messages */
     char errorMsg[1024];
 
+    /** Counters and stage timings, updated by the capture thread */
+    AudioStats audioStats;
+
+    /** Optional clock fed with the device timestamp of every packet */
+    std::shared_ptr<AvSyncClock> syncClock;
+
+    /**
+     * @brief Stamp a packet about to be delivered and report it to the sync clock
+     * @param firstSampleNs Capture time of the packet's first sample on the monotonicNowNs() clock
+     * @param frames Samples per channel delivered
+     * @param sampleRate Sample rate of the delivered samples
+     */
+    SyncStamp stampPacket(int64_t firstSampleNs, uint32_t frames, int32_t sampleRate);
+
+    /** Samples per channel delivered so far, when there is no sync clock */
+    int64_t deliveredFrames = 0;
+
+    /** Format set by setFormat() and not yet applied, as rate << 32 | channels; 0 = none */
+    std::atomic<uint64_t> pendingFormat{0};
+
+    /**
+     * @brief Switch to the pending format, if any (capture thread, between packets)
+     * @return false if a new resampler could not be created; errorMsg describes why
+     */
+    bool applyPendingFormat();
+
     /**
      * @brief Audio capture thread worker function
      * 
@@ -41,6 +41,7 @@ void AudioCaptureClient::audioRetrievalThreadWorker(
   while(captureInProgress) {
     DWORD retval = WaitForSingleObject(hEvent, INFINITE);
     retrieveAndResampleAllPendingOriginalAudio();
+    int64_t deliverStart = monotonicNowNs();
 
     // dataCallback(config.channels, config.sampleRate, UnsafePointer(floatData[0]), Int32(outputBuffer.frameLength), context)
 
@@ -50,6 +51,8 @@ void AudioCaptureClient::audioRetrievalThreadWorker(
     // therefore, there is no need to use a C++ mutex to protect threaded access
     // to the data buffer.
     dataCallback(this->cc.channels, this->cc.sampleRate, &resampledMonoAudio[0], resampledMonoAudio.size(), context);
+    audioStats.deliver.record(static_cast<uint64_t>(monotonicNowNs() - deliverStart));
+    audioStats.addPacket(static_cast<int32_t>(resampledMonoAudio.size()));
   }
 }
 
@@ -266,6 +269,7 @@ void AudioCaptureClient::resampleAllPendingOriginalAudio() {
         originalMonoAudioAwaitingResampling.resize(originalStereoAudioAwaitingResampling.size() / 2);
     }
 
+    int64_t downmixStart = monotonicNowNs();
     int iFrame;
     for (iFrame = 0; iFrame < numAvailableFrames; iFrame++) {
         float monoSample =
@@ -277,6 +281,7 @@ void AudioCaptureClient::resampleAllPendingOriginalAudio() {
         originalMonoAudioAwaitingResampling[iFrame] = monoSample;
     }
     originalStereoAudioAwaitingResampling.clear();
+    audioStats.downmix.record(static_cast<uint64_t>(monotonicNowNs() - downmixStart));
 
 
     SRC_DATA data = {
@@ -290,7 +295,9 @@ void AudioCaptureClient::resampleAllPendingOriginalAudio() {
         (double)sampleRatio
     };
 
+    int64_t resampleStart = monotonicNowNs();
     src_process(sampleRateConverter, &data);
+    audioStats.resample.record(static_cast<uint64_t>(monotonicNowNs() - resampleStart));
     if (data.output_frames_gen != requiredResampledFrames) {
         resampledMonoAudio.resize(data.output_frames_gen);
         //std::cerr << "NLIN: ERR: done resampling, used " << data.input_frames_used << " of "
@@ -302,11 +309,22 @@ void AudioCaptureClient::resampleAllPendingOriginalAudio() {
 
 
 UINT32 AudioCaptureClient::retrieveAndResampleAllPendingOriginalAudio() {
+    int64_t acquireStart = monotonicNowNs();
     retrieveAllPendingOriginalAudio();
+    audioStats.acquire.record(static_cast<uint64_t>(monotonicNowNs() - acquireStart));
     resampleAllPendingOriginalAudio();
     return resampledMonoAudio.size();
 }
 
+bool AudioCaptureClient::getStats(MediaCaptureStatsC& stats) {
+    if (!captureInProgress) {
+        return false;
+    }
+    AudioStatsSnapshot audio = audioStats.snapshot();
+    exportCaptureStats(nullptr, &audio, stats);
+    return true;
+}
+
 void AudioCaptureClient::stopCapture(StopCaptureCallback stopCaptureCallback, void* context) {
     // signal to the worker thread to stop
     captureInProgress = false;
@@ -13,6 +13,7 @@ extern "C" {
 #include <vector>
 #include <thread>
 #include "capture/capture.h"
+#include "capturestats.h"
 
 class AudioCaptureClient {
 private:
@@ -42,10 +43,12 @@ private:
     HANDLE hEvent = NULL;
     CaptureConfig cc;
     char errorMessage[1024];
+    AudioStats audioStats;
 
 public:
     void initializeCom();
     void uninitializeCom();
     void startCapture(CaptureConfig cc, StartCaptureDataCallback dataCallback, StartCaptureExitCallback exitCallback, void* context);
     void stopCapture(StopCaptureCallback stopCallback, void* context);
+    bool getStats(MediaCaptureStatsC& stats);
 };
\ No newline at end of file
@@ -13,6 +13,10 @@
 #include <psapi.h>
 #include "mediacaptureclient.h"
 #include "audiocaptureimpl.h"
+#include "avsync.h"
+#include "jpegcodec.h"
+#include "multitargetpipeline.h"
+#include "renditionpipeline.h"
 #include "videocaptureimpl.h"
 #include <iostream>
 #include <sstream>
@@ -55,6 +59,50 @@ void MediaCaptureClient::uninitializeCom() {
     CoUninitialize();
 }
 
+/**
+ * Open the display and audio client ahead of the next start
+ */
+bool MediaCaptureClient::prepare(const MediaCaptureConfigC& config, std::string& error) {
+    std::lock_guard<std::mutex> lock(captureMutex);
+
+    if (isCapturing.load()) {
+        error = "Capture already in progress";
+        return false;
+    }
+    releasePrepared();
+
+    if (config.displayID > 0) {
+        preparedVideo = std::make_unique<VideoCaptureImpl>();
+        if (!preparedVideo->open(config, nullptr)) {
+            error = preparedVideo->lastAcquireError();
+            releasePrepared();
+            return false;
+        }
+    }
+
+    preparedAudio = std::make_unique<AudioCaptureImpl>();
+    if (!preparedAudio->prepare(config)) {
+        error = preparedAudio->lastError();
+        releasePrepared();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Release prepared resources that no start has taken over
+ */
+void MediaCaptureClient::releasePrepared() {
+    if (preparedAudio) {
+        preparedAudio->stop(nullptr, nullptr);
+        preparedAudio.reset();
+    }
+    if (preparedVideo) {
+        preparedVideo->stop(nullptr, nullptr);
+        preparedVideo.reset();
+    }
+}
+
 /**
  * Start capturing audio and/or video based on configuration
  */
@@ -76,13 +124,38 @@ bool MediaCaptureClient::startCapture(
         return false;
     }
 
+    bool started = beginCapture(config, videoCallback, audioCallback, exitCallback, context);
+    releasePrepared();
+
+    // Consider capture started if either audio or video succeeded
+    if (started) {
+        isCapturing.store(true);
+    }
+    return started;
+}
+
+/**
+ * Start single-target capture and record it as the active session
+ */
+bool MediaCaptureClient::beginCapture(
+    const MediaCaptureConfigC& config,
+    MediaCaptureDataCallback videoCallback,
+    MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback,
+    void* context
+) {
     bool audioResult = true;
     bool videoResult = true;
 
+    // One clock per session relates audio sample positions to video acquisition times
+    syncClock = std::make_shared<AvSyncClock>();
+
     // Initialize audio capture if callback provided
     if (audioCallback) {
         fprintf(stderr, "DEBUG: Starting audio capture\n");
-        audioImpl = std::make_unique<AudioCaptureImpl>();
+        bool samePrepared = preparedAudio && preparedAudio->isPreparedFor(config);
+        audioImpl = samePrepared ? std::move(preparedAudio) : std::make_unique<AudioCaptureImpl>();
+        audioImpl->setSyncClock(syncClock);
         audioResult = audioImpl->start(config, audioCallback, exitCallback, context);
         fprintf(stderr, "DEBUG: Audio capture start result: %s\n", audioResult ? "success" : "failed");
     }
@@ -92,8 +165,10 @@ bool MediaCaptureClient::startCapture(
         fprintf(stderr, "DEBUG: Starting video capture (displayID=%d, windowID=%d)\n", 
                 config.displayID, config.windowID);
         try {
-            videoImpl = std::make_unique<VideoCaptureImpl>();
-            videoResult = videoImpl->start(config, videoCallback, exitCallback, context);
+            // The prepared display is only used by a start for the same display
+            bool samePrepared = preparedVideo && config.displayID > 0 && preparedVideo->isOpenFor(config.displayID);
+            videoImpl = samePrepared ? std::move(preparedVideo) : std::make_unique<VideoCaptureImpl>();
+            videoResult = videoImpl->start(config, videoCallback, exitCallback, context, syncClock);
             fprintf(stderr, "DEBUG: Video capture start result: %s\n", videoResult ? "success" : "failed");
         }
         catch (const std::exception& e) {
@@ -114,13 +189,381 @@ bool MediaCaptureClient::startCapture(
         }
     }
 
-    // Consider capture started if either audio or video succeeded
-    if (audioResult || videoResult) {
+    if (!audioResult && !videoResult) {
+        return false;
+    }
+
+    active = ActiveCapture();
+    active.config = config;
+    active.config.bundleID = nullptr;
+    active.videoCallback = videoCallback;
+    active.audioCallback = audioCallback;
+    active.exitCallback = exitCallback;
+    active.context = context;
+    return true;
+}
+
+/**
+ * Start capturing several displays on one device and one set of threads
+ */
+bool MediaCaptureClient::startMultiTargetCapture(
+    const MediaCaptureConfigC& config,
+    const MediaCaptureTargetRefC* targets,
+    int32_t targetCount,
+    MediaCaptureTargetDataCallback videoCallback,
+    MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback,
+    void* context
+) {
+    std::lock_guard<std::mutex> lock(captureMutex);
+
+    if (isCapturing.load()) {
+        if (exitCallback) {
+            exitCallback("Capture already in progress", context);
+        }
+        return false;
+    }
+
+    bool started = beginMultiTargetCapture(
+        config, targets, targetCount, videoCallback, audioCallback, exitCallback, context);
+    releasePrepared();
+    if (started) {
         isCapturing.store(true);
-        return true;
+    }
+    return started;
+}
+
+/**
+ * Start multi-target capture and record it as the active session
+ */
+bool MediaCaptureClient::beginMultiTargetCapture(
+    const MediaCaptureConfigC& config,
+    const MediaCaptureTargetRefC* targets,
+    int32_t targetCount,
+    MediaCaptureTargetDataCallback videoCallback,
+    MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback,
+    void* context
+) {
+    std::string error;
+    if (!targets || targetCount < 1 || !videoCallback) {
+        error = "Nothing to capture: no video targets";
+    }
+
+    // Every display is opened before any thread starts, so a bad target fails the whole start
+    if (error.empty()) {
+        targetPipeline = std::make_unique<MultiTargetPipeline>();
+        for (int32_t i = 0; i < targetCount; i++) {
+            if (targets[i].displayID == 0) {
+                error = "Target " + std::to_string(i) + ": only displays can be captured together on Windows";
+                break;
+            }
+
+            MediaCaptureConfigC targetConfig = config;
+            targetConfig.displayID = targets[i].displayID;
+            targetConfig.windowID = 0;
+            targetConfig.cropRect = targets[i].cropRect;
+
+            auto target = std::make_unique<VideoCaptureImpl>();
+            VideoCaptureImpl* shared = targetImpls.empty() ? nullptr : targetImpls.front().get();
+            if (!target->open(targetConfig, shared)) {
+                error = "Target " + std::to_string(i) + ": " + target->lastAcquireError();
+                target->stop(nullptr, nullptr);
+                break;
+            }
+            targetPipeline->addTarget(*target, *target, target->adaptiveQuality());
+            targetImpls.push_back(std::move(target));
+        }
+    }
+
+    syncClock = std::make_shared<AvSyncClock>();
+    if (error.empty() && audioCallback) {
+        bool samePrepared = preparedAudio && preparedAudio->isPreparedFor(config);
+        audioImpl = samePrepared ? std::move(preparedAudio) : std::make_unique<AudioCaptureImpl>();
+        audioImpl->setSyncClock(syncClock);
+        if (!audioImpl->start(config, audioCallback, exitCallback, context)) {
+            // AudioCaptureImpl has already reported the failure
+            audioImpl.reset();
+        }
+    }
+
+    if (!error.empty()) {
+        targetPipeline.reset();
+        for (auto& target : targetImpls) {
+            target->stop(nullptr, nullptr);
+        }
+        targetImpls.clear();
+        if (exitCallback) {
+            exitCallback(const_cast<char*>(error.c_str()), context);
+        }
+        return false;
+    }
+
+    targetPipeline->setSyncClock(syncClock);
+    targetPipeline->start(config.frameRate, videoCallback, exitCallback, context);
+
+    active = ActiveCapture();
+    active.config = config;
+    active.config.bundleID = nullptr;
+    active.targets.assign(targets, targets + targetCount);
+    active.targetCallback = videoCallback;
+    active.audioCallback = audioCallback;
+    active.exitCallback = exitCallback;
+    active.context = context;
+    return true;
+}
+
+/**
+ * Start capturing one display in several renditions on one set of threads
+ */
+bool MediaCaptureClient::startMultiRenditionCapture(
+    const MediaCaptureConfigC& config,
+    const MediaCaptureRenditionC* renditions,
+    int32_t renditionCount,
+    MediaCaptureTargetDataCallback videoCallback,
+    MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback,
+    void* context
+) {
+    std::lock_guard<std::mutex> lock(captureMutex);
+
+    if (isCapturing.load()) {
+        if (exitCallback) {
+            exitCallback("Capture already in progress", context);
+        }
+        return false;
+    }
+
+    bool started = beginRenditionCapture(
+        config, renditions, renditionCount, videoCallback, audioCallback, exitCallback, context);
+    releasePrepared();
+    if (started) {
+        isCapturing.store(true);
+    }
+    return started;
+}
+
+/**
+ * Start multi-rendition capture and record it as the active session
+ */
+bool MediaCaptureClient::beginRenditionCapture(
+    const MediaCaptureConfigC& config,
+    const MediaCaptureRenditionC* renditions,
+    int32_t renditionCount,
+    MediaCaptureTargetDataCallback videoCallback,
+    MediaCaptureAudioDataCallback audioCallback,
+    MediaCaptureExitCallback exitCallback,
+    void* context
+) {
+    std::string error;
+    if (!renditions || renditionCount < 1 || !videoCallback) {
+        error = "Nothing to capture: no video renditions";
+    } else if (config.displayID == 0) {
+        error = "Renditions need a display target on Windows";
+    }
+    for (int32_t i = 0; error.empty() && i < renditionCount; i++) {
+        if (renditions[i].imageFormat != 1 && !jpegCodecAvailable()) {
+            error = "JPEG output is unavailable";
+        }
+    }
+
+    // The display only delivers BGRA; each rendition scales and encodes its own copy
+    if (error.empty()) {
+        MediaCaptureConfigC sourceConfig = config;
+        sourceConfig.windowID = 0;
+        sourceConfig.imageFormat = 1;
+        sourceConfig.maxEncodeMsPerFrame = 0;
+        sourceConfig.maxBytesPerSecond = 0;
+
+        bool samePrepared = preparedVideo && preparedVideo->isOpenFor(config.displayID);
+        renditionSource = samePrepared ? std::move(preparedVideo) : std::make_unique<VideoCaptureImpl>();
+        bool opened = samePrepared ? renditionSource->reconfigure(sourceConfig)
+                                   : renditionSource->open(sourceConfig, nullptr);
+        if (!opened) {
+            error = samePrepared ? renditionSource->lastEncodeError() : renditionSource->lastAcquireError();
+            renditionSource->stop(nullptr, nullptr);
+            renditionSource.reset();
+        }
+    }
+
+    if (error.empty()) {
+        renditionPipeline = std::make_unique<RenditionPipeline>(*renditionSource);
+        for (int32_t i = 0; i < renditionCount; i++) {
+            VideoRendition settings = VideoCaptureImpl::renditionFor(config, renditions[i]);
+            renditionEncoders.push_back(std::make_unique<RenditionEncoder>(settings));
+            renditionPipeline->addRendition(*renditionEncoders.back(), settings.frameRate);
+        }
+    }
+
+    syncClock = std::make_shared<AvSyncClock>();
+    if (error.empty() && audioCallback) {
+        bool samePrepared = preparedAudio && preparedAudio->isPreparedFor(config);
+        audioImpl = samePrepared ? std::move(preparedAudio) : std::make_unique<AudioCaptureImpl>();
+        audioImpl->setSyncClock(syncClock);
+        if (!audioImpl->start(config, audioCallback, exitCallback, context)) {
+            // AudioCaptureImpl has already reported the failure
+            audioImpl.reset();
+        }
+    }
+
+    if (!error.empty()) {
+        if (exitCallback) {
+            exitCallback(const_cast<char*>(error.c_str()), context);
+        }
+        return false;
+    }
+
+    renditionPipeline->setSyncClock(syncClock);
+    renditionPipeline->start(videoCallback, exitCallback, context);
+
+    active = ActiveCapture();
+    active.config = config;
+    active.config.bundleID = nullptr;
+    active.renditions.assign(renditions, renditions + renditionCount);
+    active.targetCallback = videoCallback;
+    active.audioCallback = audioCallback;
+    active.exitCallback = exitCallback;
+    active.context = context;
+    return true;
+}
+
+/**
+ * Apply a new configuration to the running capture
+ */
+bool MediaCaptureClient::reconfigure(const MediaCaptureConfigC& config, std::string& error) {
+    std::lock_guard<std::mutex> lock(captureMutex);
+
+    if (!isCapturing.load()) {
+        error = "No capture in progress";
+        return false;
+    }
+
+    MediaCaptureConfigC next = config;
+    next.bundleID = nullptr;
+
+    // Another display, window or audio device is a new capture; so is a controller a shared pipeline cannot gain
+    bool restart = next.displayID != active.config.displayID || next.windowID != active.config.windowID;
+    bool addBudget = next.maxEncodeMsPerFrame > 0 || next.maxBytesPerSecond > 0;
+    for (auto& target : targetImpls) {
+        restart = restart || (addBudget && !target->adaptiveQuality());
+    }
+    // Renditions take their unset frame rate and quality from the configuration when they start
+    bool newDefaults = next.frameRate != active.config.frameRate || next.quality != active.config.quality ||
+                       next.qualityValue != active.config.qualityValue;
+    restart = restart || (renditionPipeline && newDefaults);
+    if (restart) {
+        return restartCapture(next, error);
+    }
+
+    // Check every part before changing any, so a rejected change leaves the capture and active.config as they were
+    if (videoImpl && !videoImpl->canReconfigure(next)) {
+        error = videoImpl->lastEncodeError();
+        return false;
+    }
+    std::vector<MediaCaptureConfigC> targetConfigs(targetImpls.size(), next);
+    for (size_t i = 0; i < targetImpls.size(); i++) {
+        targetConfigs[i].displayID = active.targets[i].displayID;
+        targetConfigs[i].windowID = 0;
+        targetConfigs[i].cropRect = active.targets[i].cropRect;
+        if (!targetImpls[i]->canReconfigure(targetConfigs[i])) {
+            error = "Target " + std::to_string(i) + ": " + targetImpls[i]->lastEncodeError();
+            return false;
+        }
+    }
+    bool newFormat = next.audioSampleRate != active.config.audioSampleRate ||
+                     next.audioChannels != active.config.audioChannels;
+    if (audioImpl && newFormat && !AudioCaptureImpl::isSupportedFormat(next.audioSampleRate, next.audioChannels)) {
+        error = "Unsupported audio format: " + std::to_string(next.audioSampleRate) + " Hz, " +
+                std::to_string(next.audioChannels) + " channels";
+        return false;
+    }
+
+    // Encoder and pacer settings change between two frames; the duplication stays open
+    if (videoImpl) {
+        videoImpl->reconfigure(next);
+    }
+    for (size_t i = 0; i < targetImpls.size(); i++) {
+        targetImpls[i]->reconfigure(targetConfigs[i]);
+    }
+    if (targetPipeline) {
+        targetPipeline->setFrameRate(next.frameRate);
+    }
+    if (renditionSource) {
+        renditionSource->setCropRect(next.cropRect);
+    }
+
+    // The capture thread switches the resampler between two packets
+    if (audioImpl && newFormat) {
+        audioImpl->setFormat(next.audioSampleRate, next.audioChannels);
+    }
+
+    active.config = next;
+    return true;
+}
+
+/**
+ * Stop the running capture and start it again with the callbacks it was started with
+ */
+bool MediaCaptureClient::restartCapture(const MediaCaptureConfigC& config, std::string& error) {
+    releaseAll();
+
+    // begin*() record the new session in active, so they get copies
+    ActiveCapture previous = active;
+    bool started = false;
+    if (!previous.renditions.empty()) {
+        started = beginRenditionCapture(config, previous.renditions.data(),
+                                        static_cast<int32_t>(previous.renditions.size()), previous.targetCallback,
+                                        previous.audioCallback, previous.exitCallback, previous.context);
+    } else if (!previous.targets.empty()) {
+        started = beginMultiTargetCapture(config, previous.targets.data(),
+                                          static_cast<int32_t>(previous.targets.size()), previous.targetCallback,
+                                          previous.audioCallback, previous.exitCallback, previous.context);
+    } else {
+        started = beginCapture(config, previous.videoCallback, previous.audioCallback, previous.exitCallback,
+                               previous.context);
+    }
+    if (!started) {
+        // The failing start has already reported through the exit callback
+        isCapturing.store(false);
+        error = "Capture could not be restarted with the new configuration";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Stop and release audio capture, video capture and the targets of a multi-target capture
+ */
+void MediaCaptureClient::releaseAll() {
+    if (audioImpl) {
+        audioImpl->stop(nullptr, nullptr);
+        audioImpl.reset();
     }
     
-    return false;
+    if (videoImpl) {
+        videoImpl->stop(nullptr, nullptr);
+        videoImpl.reset();
+    }
+
+    // Join the shared threads before the displays they read from are released
+    if (targetPipeline) {
+        targetPipeline->stop();
+        targetPipeline.reset();
+    }
+    for (auto& target : targetImpls) {
+        target->stop(nullptr, nullptr);
+    }
+    targetImpls.clear();
+
+    if (renditionPipeline) {
+        renditionPipeline->stop();
+        renditionPipeline.reset();
+    }
+    renditionEncoders.clear();
+    if (renditionSource) {
+        renditionSource->stop(nullptr, nullptr);
+        renditionSource.reset();
+    }
 }
 
 /**
@@ -128,6 +571,7 @@ bool MediaCaptureClient::startCapture(
  */
 void MediaCaptureClient::stopCapture(StopCaptureCallback stopCallback, void* context) {
     std::lock_guard<std::mutex> lock(captureMutex);
+    releasePrepared();
     
     if (!isCapturing.load()) {
         if (stopCallback) {
@@ -137,20 +581,93 @@ void MediaCaptureClient::stopCapture(StopCaptureCallback stopCallback, void* con
     }
 
     isCapturing.store(false);
+    releaseAll();
     
-    if (audioImpl) {
-        audioImpl->stop(nullptr, nullptr);
-        audioImpl.reset();
+    if (stopCallback) {
+        stopCallback(context);
     }
+}
+
+/**
+ * Forward a new region of interest to the running video capture
+ */
+bool MediaCaptureClient::setCropRect(const MediaCaptureRectC& cropRect, std::string& error) {
+    std::lock_guard<std::mutex> lock(captureMutex);
     
+    // Every display is checked first, so a crop outside any of them keeps the old crop everywhere
+    if (videoImpl && !videoImpl->checkCropRect(cropRect, error)) {
+        return false;
+    }
+    for (size_t i = 0; i < targetImpls.size(); i++) {
+        if (!targetImpls[i]->checkCropRect(cropRect, error)) {
+            error = "Target " + std::to_string(i) + ": " + error;
+            return false;
+        }
+    }
+    if (renditionSource && !renditionSource->checkCropRect(cropRect, error)) {
+        return false;
+    }
+
     if (videoImpl) {
-        videoImpl->stop(nullptr, nullptr);
-        videoImpl.reset();
+        videoImpl->setCropRect(cropRect);
+        active.config.cropRect = cropRect;
     }
+    for (size_t i = 0; i < targetImpls.size(); i++) {
+        targetImpls[i]->setCropRect(cropRect);
+        active.targets[i].cropRect = cropRect;
+    }
+    if (renditionSource) {
+        renditionSource->setCropRect(cropRect);
+        active.config.cropRect = cropRect;
+    }
+    return true;
+}
+
+bool MediaCaptureClient::getQualityStats(MediaCaptureQualityStatsC& stats) {
+    std::lock_guard<std::mutex> lock(captureMutex);
     
-    if (stopCallback) {
-        stopCallback(context);
+    // A multi-target capture reports the controller of its first display
+    VideoCaptureImpl* video = videoImpl ? videoImpl.get() : targetImpls.empty() ? nullptr : targetImpls.front().get();
+    AdaptiveQualityStats quality;
+    if (!video || !video->qualityStats(quality)) {
+        return false;
+    }
+    
+    stats.quality = quality.settings.quality;
+    stats.scale = static_cast<float>(quality.settings.scale);
+    stats.frameRate = static_cast<float>(quality.settings.frameRate);
+    stats.encodeMs = static_cast<float>(quality.encodeMs);
+    stats.bytesPerSecond = static_cast<float>(quality.bytesPerSecond);
+    stats.queueDepth = static_cast<float>(quality.queueDepth);
+    stats.downgrades = quality.downgrades;
+    stats.upgrades = quality.upgrades;
+    stats.lastAdjustment = static_cast<int32_t>(quality.lastAdjustment);
+    stats.lastPressure = static_cast<int32_t>(quality.lastPressure);
+    return true;
+}
+
+bool MediaCaptureClient::getStats(MediaCaptureStatsC& stats) {
+    std::lock_guard<std::mutex> lock(captureMutex);
+    
+    if (!isCapturing.load()) {
+        return false;
+    }
+    
+    VideoPipelineStats video;
+    AudioStatsSnapshot audio;
+    if (videoImpl) {
+        video = videoImpl->stats();
+    } else if (targetPipeline) {
+        video = targetPipeline->stats();
+    } else if (renditionPipeline) {
+        video = renditionPipeline->stats();
+    }
+    if (audioImpl) {
+        audio = audioImpl->stats();
     }
+    exportCaptureStats(videoImpl || targetPipeline || renditionPipeline ? &video : nullptr,
+                       audioImpl ? &audio : nullptr, stats);
+    return true;
 }
 
 /**
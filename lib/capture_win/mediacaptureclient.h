@@ -12,10 +12,15 @@
 #include <atomic>
 #include <mutex>
 #include <string>
+#include <vector>
 #include "capture/capture.h"
 
 // Forward declarations
 class AudioCaptureImpl;
+class AvSyncClock;
+class MultiTargetPipeline;
+class RenditionEncoder;
+class RenditionPipeline;
 class VideoCaptureImpl;
 
 /**
@@ -56,6 +61,20 @@ public:
      */
     void uninitializeCom();
 
+    /**
+     * @brief Open the display and audio client of a coming startCapture
+     * 
+     * Creates the D3D device and output duplication and initializes the WASAPI
+     * client without starting either. startCapture uses them if its
+     * displayID and audio format match; otherwise, and on stopCapture, they
+     * are released.
+     * 
+     * @param config Capture configuration of the coming start
+     * @param error Set if the display or audio device could not be opened
+     * @return false if capture is running or opening failed; nothing stays prepared then
+     */
+    bool prepare(const MediaCaptureConfigC& config, std::string& error);
+
     /**
      * @brief Start audio-only capture
      * 
@@ -95,6 +114,75 @@ public:
         void* context
     );
 
+    /**
+     * @brief Start audio capture and video capture of several displays on shared threads
+     * 
+     * All displays share one D3D device, one capture thread, one encoder pool
+     * and one delivery thread. The video fields of config apply to every
+     * display; its displayID and windowID only select the audio source.
+     * 
+     * @param config Capture configuration
+     * @param targets Displays to capture
+     * @param targetCount Number of targets
+     * @param videoCallback Function to receive video frames tagged with their target index
+     * @param audioCallback Function to receive audio data (can be NULL)
+     * @param exitCallback Function called when capture exits or errors occur
+     * @param context User data pointer passed to callbacks
+     * @return true if capture started, false otherwise (exitCallback has been called)
+     */
+    bool startMultiTargetCapture(
+        const MediaCaptureConfigC& config,
+        const MediaCaptureTargetRefC* targets,
+        int32_t targetCount,
+        MediaCaptureTargetDataCallback videoCallback,
+        MediaCaptureAudioDataCallback audioCallback,
+        MediaCaptureExitCallback exitCallback,
+        void* context
+    );
+
+    /**
+     * @brief Start audio capture and video capture of one display in several renditions
+     * 
+     * The display is duplicated once; each rendition has its own frame rate,
+     * size, format and quality, and all of them share one capture thread,
+     * one encoder pool and one delivery thread.
+     * 
+     * @param config Capture configuration; selects the display, crop and audio
+     * @param renditions Output renditions
+     * @param renditionCount Number of renditions
+     * @param videoCallback Function to receive video frames tagged with their rendition index
+     * @param audioCallback Function to receive audio data (can be NULL)
+     * @param exitCallback Function called when capture exits or errors occur
+     * @param context User data pointer passed to callbacks
+     * @return true if capture started, false otherwise (exitCallback has been called)
+     */
+    bool startMultiRenditionCapture(
+        const MediaCaptureConfigC& config,
+        const MediaCaptureRenditionC* renditions,
+        int32_t renditionCount,
+        MediaCaptureTargetDataCallback videoCallback,
+        MediaCaptureAudioDataCallback audioCallback,
+        MediaCaptureExitCallback exitCallback,
+        void* context
+    );
+
+    /**
+     * @brief Apply a new configuration to the running capture without stopping it
+     * 
+     * Frame rate, JPEG quality, output format, crop and adaptive quality
+     * change between two frames on the open duplication, and the audio
+     * format between two packets. Only another displayID or windowID (or
+     * enabling adaptive quality for several displays, or new rendition
+     * defaults) restarts the whole capture with the callbacks it was started with.
+     * 
+     * @param config Complete new configuration; the displays and renditions of a multi-target or
+     *               multi-rendition capture stay
+     * @param error Set if the change could not be applied
+     * @return false if nothing is captured or the change failed; if a restart failed,
+     *         capture has stopped and the exit callback has been called
+     */
+    bool reconfigure(const MediaCaptureConfigC& config, std::string& error);
+
     /**
      * @brief Stop all active capture operations
      * 
@@ -108,6 +196,31 @@ public:
         void* context
     );
 
+    /**
+     * @brief Change the region of interest of the running video capture
+     * 
+     * @param cropRect Crop rectangle in desktop pixels (zero size = full desktop)
+     * @param error Receives why the crop was rejected
+     * @return false if the crop lies outside a captured display; the previous crop stays in effect
+     */
+    bool setCropRect(const MediaCaptureRectC& cropRect, std::string& error);
+
+    /**
+     * @brief Read the adaptive quality controller of the running video capture
+     * 
+     * @param stats Receives the controller state
+     * @return true if video capture is running with adaptive quality enabled
+     */
+    bool getQualityStats(MediaCaptureQualityStatsC& stats);
+
+    /**
+     * @brief Read the counters and stage latencies of the running capture
+     * 
+     * @param stats Receives the statistics; parts that are not running are zeroed
+     * @return true if capture is running
+     */
+    bool getStats(MediaCaptureStatsC& stats);
+
     /**
      * @brief Enumerate available capture targets
      * 
@@ -126,6 +239,68 @@ public:
     );
 
 private:
+    /** What the running capture was started with, to apply changes to it and restart it */
+    struct ActiveCapture {
+        MediaCaptureConfigC config = {};
+        std::vector<MediaCaptureTargetRefC> targets; /**< Empty unless several displays are captured */
+        std::vector<MediaCaptureRenditionC> renditions; /**< Empty unless several renditions are delivered */
+        MediaCaptureDataCallback videoCallback = nullptr;
+        MediaCaptureTargetDataCallback targetCallback = nullptr;
+        MediaCaptureAudioDataCallback audioCallback = nullptr;
+        MediaCaptureExitCallback exitCallback = nullptr;
+        void* context = nullptr;
+    };
+
+    /**
+     * @brief Start single-target capture and record it in active (caller holds captureMutex)
+     * @return false if neither audio nor video started; the exit callback has been called then
+     */
+    bool beginCapture(
+        const MediaCaptureConfigC& config,
+        MediaCaptureDataCallback videoCallback,
+        MediaCaptureAudioDataCallback audioCallback,
+        MediaCaptureExitCallback exitCallback,
+        void* context
+    );
+
+    /**
+     * @brief Start multi-target capture and record it in active (caller holds captureMutex)
+     * @return false if a display could not be opened; the exit callback has been called then
+     */
+    bool beginMultiTargetCapture(
+        const MediaCaptureConfigC& config,
+        const MediaCaptureTargetRefC* targets,
+        int32_t targetCount,
+        MediaCaptureTargetDataCallback videoCallback,
+        MediaCaptureAudioDataCallback audioCallback,
+        MediaCaptureExitCallback exitCallback,
+        void* context
+    );
+
+    /**
+     * @brief Start multi-rendition capture and record it in active (caller holds captureMutex)
+     * @return false if the display could not be opened; the exit callback has been called then
+     */
+    bool beginRenditionCapture(
+        const MediaCaptureConfigC& config,
+        const MediaCaptureRenditionC* renditions,
+        int32_t renditionCount,
+        MediaCaptureTargetDataCallback videoCallback,
+        MediaCaptureAudioDataCallback audioCallback,
+        MediaCaptureExitCallback exitCallback,
+        void* context
+    );
+
+    /**
+     * @brief Stop the running capture and start it again with config (caller holds captureMutex)
+     */
+    bool restartCapture(const MediaCaptureConfigC& config, std::string& error);
+
+    /**
+     * @brief Stop and release everything started (caller holds captureMutex)
+     */
+    void releaseAll();
+
     /**
      * @name Implementation Components
      * @{
@@ -135,7 +310,39 @@ private:
     
     /** Video capture implementation */
     std::unique_ptr<VideoCaptureImpl> videoImpl;
+
+    /** Displays of a multi-target capture, sharing the first one's D3D device */
+    std::vector<std::unique_ptr<VideoCaptureImpl>> targetImpls;
+
+    /** Threads of a multi-target capture; declared last so it stops before the targets go away */
+    std::unique_ptr<MultiTargetPipeline> targetPipeline;
+
+    /** Display of a multi-rendition capture, acquired once for all renditions */
+    std::unique_ptr<VideoCaptureImpl> renditionSource;
+
+    /** Downscale and encode stage of each rendition */
+    std::vector<std::unique_ptr<RenditionEncoder>> renditionEncoders;
+
+    /** Threads of a multi-rendition capture; declared last so it stops before its source and encoders */
+    std::unique_ptr<RenditionPipeline> renditionPipeline;
+
+    /** Audio client opened by prepare() for the next start */
+    std::unique_ptr<AudioCaptureImpl> preparedAudio;
+
+    /** Display opened by prepare() for the next start */
+    std::unique_ptr<VideoCaptureImpl> preparedVideo;
     /**@}*/
+
+    /** The running capture, valid while isCapturing */
+    ActiveCapture active;
+
+    /** Clock of the running capture, shared by audio capture and the video pipeline */
+    std::shared_ptr<AvSyncClock> syncClock;
+
+    /**
+     * @brief Release whatever prepare() opened and no start used (caller holds captureMutex)
+     */
+    void releasePrepared();
     
     /**
      * @name State Management
@@ -3,6 +3,8 @@
  * @brief Windows implementation of desktop video capture using DXGI Desktop Duplication API
  */
 #include "videocaptureimpl.h"
+#include "framescale.h"
+#include <algorithm>
 #include <cstring>
 #include <string>
 
@@ -11,6 +13,51 @@
 #pragma comment(lib, "gdiplus.lib")
 #pragma comment(lib, "ole32.lib")
 
+namespace {
+
+/**
+ * Use quality range from 0-100 similar to macOS implementation
+ * macOS: high=0.9 (90%), medium=0.75 (75%), low=0.5 (50%)
+ */
+int jpegQualityFor(const MediaCaptureConfigC &config) {
+    // If quality is between 0-100, use it directly (allows fine-grained control)
+    if (config.qualityValue > 0 && config.qualityValue <= 100) {
+        return config.qualityValue;
+    }
+    // Otherwise use the enum-based quality levels
+    switch (config.quality) {
+    case 0: // High quality
+        return 90; // Match macOS high quality (0.9)
+    case 2: // Low quality
+        return 50; // Match macOS low quality (0.5)
+    default: // Medium quality
+        return 75; // Match macOS medium quality (0.75)
+    }
+}
+
+bool hasQualityBudget(const MediaCaptureConfigC &config) {
+    return config.maxEncodeMsPerFrame > 0 || config.maxBytesPerSecond > 0;
+}
+
+/**
+ * Budget, bounds and starting point of the adaptive quality controller
+ */
+void qualityLimitsFor(const MediaCaptureConfigC &config, float frameRate, QualityBudget &budget,
+                      QualityBounds &bounds, QualitySettings &initial) {
+    budget.maxEncodeMsPerFrame = config.maxEncodeMsPerFrame;
+    budget.maxBytesPerSecond = config.maxBytesPerSecond;
+
+    if (config.minQualityValue > 0) bounds.minQuality = config.minQualityValue;
+    if (config.minScale > 0) bounds.minScale = config.minScale;
+    if (config.minFrameRate > 0) bounds.minFrameRate = config.minFrameRate;
+
+    initial.quality = jpegQualityFor(config);
+    initial.scale = 1.0;
+    initial.frameRate = frameRate;
+}
+
+} // namespace
+
 VideoCaptureImpl::VideoCaptureImpl() :
     device(nullptr),
     context(nullptr),
@@ -20,12 +67,16 @@ VideoCaptureImpl::VideoCaptureImpl() :
     gdiplusToken(0),
     desktopWidth(0),
     desktopHeight(0),
-    captureThread(nullptr),
-    isCapturing(false),
-    frameInterval(1000), // Default 1 FPS
+    frameIntervalMs(1000), // Default 1 FPS
+    videoCallback(nullptr),
+    exitCallback(nullptr),
+    callbackContext(nullptr),
+    jpegQuality(75),
+    imageFormat(0),
     comInitialized(false)
 {
     memset(errorMsg, 0, sizeof(errorMsg));
+    memset(encodeErrorMsg, 0, sizeof(encodeErrorMsg));
     memset(&outputDesc, 0, sizeof(outputDesc));
     
     // Initialize GDI+
@@ -37,7 +88,7 @@ VideoCaptureImpl::VideoCaptureImpl() :
 }
 
 VideoCaptureImpl::~VideoCaptureImpl() {
-    if (isCapturing.load()) {
+    if (pipeline && pipeline->isRunning()) {
         stop(nullptr, nullptr);
     }
     
@@ -104,17 +155,51 @@ void VideoCaptureImpl::uninitializeCom() {
  */
 bool VideoCaptureImpl::start(
     const MediaCaptureConfigC &config, MediaCaptureDataCallback videoCallback, MediaCaptureExitCallback exitCallback,
-    void *context) {
-    this->config = config;
+    void *context, std::shared_ptr<AvSyncClock> syncClock) {
+    // Duplication opened ahead of time for the same display only needs the new settings
+    bool reuse = isOpenFor(config.displayID);
+    if (reuse ? !configure(config) : !open(config, nullptr)) {
+        if (exitCallback) {
+            exitCallback(errorMsg, context);
+        }
+        return false;
+    }
 
-    fprintf(stderr, "DEBUG: VideoCaptureImpl starting with isElectron=%d\n", config.isElectron);
+    this->videoCallback = videoCallback;
+    this->exitCallback = exitCallback;
+    this->callbackContext = context;
+    this->syncClock = std::move(syncClock);
 
-    float frameRate = config.frameRate;
-    if (frameRate <= 0) {
-        frameRate = 30.0f; // Default frame rate
-    }
+    // Capture and encode run on separate threads connected by a drop-oldest queue
+    pipeline = std::make_unique<VideoPipeline>(*this, *this);
+    pipeline->setQualityController(qualityController);
+    pipeline->setSyncClock(this->syncClock);
+    pipeline->start(config.frameRate, videoCallback, exitCallback, context);
 
-    frameInterval = std::chrono::milliseconds(static_cast<int>(1000.0f / frameRate));
+    return true;
+}
+
+/**
+ * Settings of one output rendition; an unset frame rate or quality is taken from config
+ */
+VideoRendition VideoCaptureImpl::renditionFor(const MediaCaptureConfigC &config,
+                                              const MediaCaptureRenditionC &rendition) {
+    VideoRendition settings;
+    settings.frameRate = rendition.frameRate > 0 ? rendition.frameRate : config.frameRate;
+    settings.scale = rendition.scale > 0 ? rendition.scale : 1.0;
+    settings.maxWidth = rendition.maxWidth;
+    settings.imageFormat = rendition.imageFormat;
+    settings.quality = rendition.quality > 0 ? rendition.quality : jpegQualityFor(config);
+    return settings;
+}
+
+/**
+ * Open the display and prepare the encoder without starting the pipeline
+ */
+bool VideoCaptureImpl::open(const MediaCaptureConfigC &config, VideoCaptureImpl *shareDeviceWith) {
+    if (!configure(config)) {
+        return false;
+    }
 
     // Handle COM initialization based on environment
     if (config.isElectron == 1) {
@@ -122,31 +207,115 @@ bool VideoCaptureImpl::start(
     } else {
         if (!initializeCom()) {
             fprintf(stderr, "DEBUG: COM initialization failed: %s\n", errorMsg);
-            if (exitCallback) {
-                exitCallback(errorMsg, context);
-            }
             return false;
         }
     }
 
-    if (!setupD3D11(config.displayID)) {
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
+    if (shareDeviceWith && shareDeviceWith->device) {
+        // All outputs are acquired on the one capture thread, so they can share the immediate context
+        device = shareDeviceWith->device;
+        device->AddRef();
+        context = shareDeviceWith->context;
+        context->AddRef();
+    } else if (!setupD3D11(config.displayID)) {
         return false;
     }
 
     if (!setupDuplication(config.displayID)) {
-        if (exitCallback) {
-            exitCallback(errorMsg, context);
-        }
         cleanup();
         return false;
     }
 
-    isCapturing.store(true);
-    captureThread = new std::thread(&VideoCaptureImpl::captureThreadProc, this, videoCallback, exitCallback, context);
+    return true;
+}
+
+/**
+ * Apply frame rate, quality and budget settings without touching the display
+ */
+bool VideoCaptureImpl::configure(const MediaCaptureConfigC &config) {
+    this->config = config;
+    this->config.bundleID = nullptr; // The caller's string
+    cropRect.set(config.cropRect);
+
+    fprintf(stderr, "DEBUG: VideoCaptureImpl starting with isElectron=%d\n", config.isElectron);
+
+    float frameRate = config.frameRate;
+    if (frameRate <= 0) {
+        frameRate = 30.0f; // Default frame rate
+    }
+
+    frameIntervalMs = static_cast<int64_t>(1000.0f / frameRate);
+    {
+        std::lock_guard<std::mutex> lock(settingsMutex);
+        jpegQuality = jpegQualityFor(config);
+        imageFormat = config.imageFormat;
+    }
+
+    // Optional closed loop over quality, downscale and frame rate
+    qualityController.reset();
+    if (hasQualityBudget(config)) {
+        QualityBudget budget;
+        QualityBounds bounds;
+        QualitySettings initial;
+        qualityLimitsFor(config, frameRate, budget, bounds, initial);
+        qualityController = std::make_shared<AdaptiveQualityController>(budget, bounds, initial);
+    }
+
+    return true;
+}
+
+/**
+ * Check the settings reconfigure() cannot apply to a running capture
+ */
+bool VideoCaptureImpl::canReconfigure(const MediaCaptureConfigC &config) {
+    // The encode thread of a shared pipeline reads the controller pointer at any time
+    if (hasQualityBudget(config) && !qualityController && !pipeline) {
+        snprintf(encodeErrorMsg, sizeof(encodeErrorMsg) - 1, "Adaptive quality can only be enabled when capture starts");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Apply new settings between two frames, keeping the device and the duplication
+ */
+bool VideoCaptureImpl::reconfigure(const MediaCaptureConfigC &config) {
+    if (!canReconfigure(config)) {
+        return false;
+    }
+    bool addController = hasQualityBudget(config) && !qualityController;
+
+    // The capture threads keep reading this->config; only the settings below change, each under its own guard
+    float frameRate = config.frameRate > 0 ? config.frameRate : 30.0f; // Default frame rate
+    cropRect.set(config.cropRect);
+    frameIntervalMs = static_cast<int64_t>(1000.0f / frameRate);
+    {
+        std::lock_guard<std::mutex> lock(settingsMutex);
+        jpegQuality = jpegQualityFor(config);
+        imageFormat = config.imageFormat;
+    }
+
+    QualityBudget budget;
+    QualityBounds bounds;
+    QualitySettings initial;
+    qualityLimitsFor(config, frameRate, budget, bounds, initial);
+    if (qualityController) {
+        // Without a budget the controller stays, disabled, and hands out the configured settings
+        qualityController->reconfigure(budget, bounds, initial);
+    } else if (addController) {
+        // Only the threads restart; the D3D device and the duplication stay open
+        pipeline->stop();
+        qualityController = std::make_shared<AdaptiveQualityController>(budget, bounds, initial);
+        pipeline = std::make_unique<VideoPipeline>(*this, *this);
+        pipeline->setQualityController(qualityController);
+        pipeline->setSyncClock(syncClock);
+        pipeline->start(config.frameRate, videoCallback, exitCallback, callbackContext);
+        return true;
+    }
 
+    if (pipeline) {
+        pipeline->setFrameRate(config.frameRate);
+    }
     return true;
 }
 
@@ -298,100 +467,97 @@ bool VideoCaptureImpl::setupDuplication(UINT displayID) {
 }
 
 /**
- * Main capture thread procedure
+ * Capture stage: acquire the next desktop frame and copy it to CPU memory
  */
-void VideoCaptureImpl::captureThreadProc(
-    MediaCaptureDataCallback videoCallback, MediaCaptureExitCallback exitCallback, void *context) {
-  lastFrameTime = std::chrono::high_resolution_clock::now();
+AcquireResult VideoCaptureImpl::acquireFrame(VideoFrame &frame, uint32_t timeoutMs) {
+  if (!captureFrame(timeoutMs)) {
+    return AcquireResult::Timeout;
+  }
 
-  while (isCapturing.load()) {
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastFrameTime);
+  if (!processFrame(frame)) {
+    return AcquireResult::Error;
+  }
+
+  return AcquireResult::Frame;
+}
 
-    // Frame rate limiting
-    if (elapsed < frameInterval) {
-      std::this_thread::sleep_for(frameInterval - elapsed);
-      currentTime = std::chrono::high_resolution_clock::now();
+/**
+ * Encode stage: encode a captured frame to JPEG with the configured quality
+ */
+bool VideoCaptureImpl::encodeFrame(const VideoFrame &frame, EncodedFrame &out) {
+  const uint8_t *pixels = frame.pixels.data();
+  int quality;
+  int format;
+  {
+    // One consistent set of settings per frame, even while reconfigure() runs
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    quality = jpegQuality;
+    format = imageFormat;
+  }
+  out.width = frame.width;
+  out.height = frame.height;
+  out.bytesPerRow = frame.bytesPerRow;
+
+  // The adaptive controller may ask for a smaller image and a lower quality
+  if (qualityController) {
+    QualitySettings settings = qualityController->settings();
+    quality = settings.quality;
+    if (settings.scale < 1.0) {
+      out.width = scaledDimension(frame.width, settings.scale);
+      out.height = scaledDimension(frame.height, settings.scale);
+      out.bytesPerRow = out.width * 4;
+      scaledPixels.resize(static_cast<size_t>(out.bytesPerRow) * out.height);
+      downscaleBGRA(pixels, frame.bytesPerRow, frame.width, frame.height, scaledPixels.data(), out.bytesPerRow,
+                    out.width, out.height);
+      pixels = scaledPixels.data();
     }
+  }
 
-    lastFrameTime = currentTime;
+  // Raw output skips JPEG entirely; the addon converts BGRA to the requested layout
+  if (format == 1) {
+    out.data.assign(pixels, pixels + static_cast<size_t>(out.bytesPerRow) * out.height);
+    out.format = "bgra";
+    return true;
+  }
 
-    if (!captureFrame()) {
-      continue;
-    }
+  out.data.clear();
+  if (!encodeFrameToJPEG(pixels, out.width, out.height, out.bytesPerRow, out.data, quality)) {
+    return false;
+  }
+  out.format = "jpeg";
+  return true;
+}
 
-    uint8_t *frameData = nullptr;
-    int width = 0;
-    int height = 0;
-    int bytesPerRow = 0;
+void VideoCaptureImpl::setCropRect(const MediaCaptureRectC &rect) {
+  cropRect.set(rect);
+}
 
-    if (!processFrame(&frameData, &width, &height, &bytesPerRow)) {
-      if (isCapturing.load() && exitCallback) {
-        exitCallback(errorMsg, context);
-      }
-      continue;
-    }
+bool VideoCaptureImpl::checkCropRect(const MediaCaptureRectC &rect, std::string &error) const {
+  MediaCaptureRectC region;
+  if (!resolveCropRect(rect, desktopWidth, desktopHeight, region)) {
+    error = "Crop rectangle is outside the " + std::to_string(desktopWidth) + "x" + std::to_string(desktopHeight) +
+            " desktop";
+    return false;
+  }
+  return true;
+}
 
-    // Encode frame to JPEG with appropriate quality
-    std::vector<uint8_t> jpegData;
-    
-    // Use quality range from 0-100 similar to macOS implementation
-    // macOS: high=0.9 (90%), medium=0.75 (75%), low=0.5 (50%)
-    int quality = 75; // Default (medium quality)
-    
-    // If quality is between 0-100, use it directly (allows fine-grained control)
-    if (config.qualityValue > 0 && config.qualityValue <= 100) {
-        quality = config.qualityValue;
-    } else {
-        // Otherwise use the enum-based quality levels
-        switch (config.quality) {
-        case 0: // High quality
-            quality = 90; // Match macOS high quality (0.9)
-            break;
-        case 1: // Medium quality
-            quality = 75; // Match macOS medium quality (0.75)
-            break;
-        case 2: // Low quality
-            quality = 50; // Match macOS low quality (0.5)
-            break;
-        }
-    }
+VideoPipelineStats VideoCaptureImpl::stats() const {
+  return pipeline ? pipeline->stats() : VideoPipelineStats{};
+}
 
-    if (!encodeFrameToJPEG(frameData, width, height, bytesPerRow, jpegData, quality)) {
-      if (isCapturing.load() && exitCallback) {
-        exitCallback(errorMsg, context);
-      }
-      continue;
-    }
-
-    if (videoCallback && !jpegData.empty()) {
-        // Get current time in milliseconds since epoch using Windows API
-        FILETIME ft;
-        GetSystemTimeAsFileTime(&ft);
-        LARGE_INTEGER li;
-        li.LowPart = ft.dwLowDateTime;
-        li.HighPart = ft.dwHighDateTime;
-        // Convert Windows file time (100-nanosecond intervals since January 1, 1601) 
-        // to Unix epoch time (milliseconds since January 1, 1970)
-        int64_t currentTimeMs = (li.QuadPart / 10000) - 11644473600000LL;
-        
-        // Convert timestamp to string
-        std::string timestampStr = std::to_string(currentTimeMs);
-        
-        // Always use JPEG format on Windows - we only support JPEG encoding
-        // But respect the qualityValue and quality settings
-        videoCallback(
-            jpegData.data(), width, height, bytesPerRow,
-            timestampStr.c_str(),  // Pass timestamp as C string
-            "jpeg", jpegData.size(), context);
-    }
+bool VideoCaptureImpl::qualityStats(AdaptiveQualityStats &stats) const {
+  if (!qualityController || !qualityController->enabled()) {
+    return false;
   }
+  stats = qualityController->stats();
+  return true;
 }
 
 /**
  * Capture a single frame using Desktop Duplication API
  */
-bool VideoCaptureImpl::captureFrame() {
+bool VideoCaptureImpl::captureFrame(UINT timeoutMs) {
     if (!duplication) {
         return false;
     }
@@ -399,8 +565,7 @@ bool VideoCaptureImpl::captureFrame() {
     IDXGIResource *desktopResource = nullptr;
     DXGI_OUTDUPL_FRAME_INFO frameInfo;
     
-    float frameRate = 1000.0f / std::chrono::duration_cast<std::chrono::milliseconds>(frameInterval).count();
-    UINT timeoutMs = (std::min)(500U, (std::max)(100U, static_cast<UINT>(1000.0f / frameRate)));
+    float frameRate = 1000.0f / static_cast<float>(std::max<int64_t>(1, frameIntervalMs.load()));
 
     HRESULT hr = duplication->AcquireNextFrame(timeoutMs, &frameInfo, &desktopResource);
     
@@ -442,7 +607,7 @@ bool VideoCaptureImpl::captureFrame() {
 /**
  * Process captured frame and make it accessible to CPU
  */
-bool VideoCaptureImpl::processFrame(uint8_t **buffer, int *width, int *height, int *bytesPerRow) {
+bool VideoCaptureImpl::processFrame(VideoFrame &frame) {
   D3D11_MAPPED_SUBRESOURCE mappedResource;
   HRESULT hr = context->Map(stagingTexture, 0, D3D11_MAP_READ, 0, &mappedResource);
   if (FAILED(hr)) {
@@ -450,24 +615,32 @@ bool VideoCaptureImpl::processFrame(uint8_t **buffer, int *width, int *height, i
     return false;
   }
 
-  UINT pitch = mappedResource.RowPitch;
-  UINT bufferSize = pitch * desktopHeight;
-
-  if (frameBuffer.size() != bufferSize) {
-    frameBuffer.resize(bufferSize);
+  MediaCaptureRectC region;
+  if (!resolveCropRect(cropRect.get(), desktopWidth, desktopHeight, region)) {
+    context->Unmap(stagingTexture, 0);
+    snprintf(errorMsg, sizeof(errorMsg) - 1, "Crop rectangle is outside the %ux%u desktop", desktopWidth, desktopHeight);
+    return false;
   }
 
-  uint8_t *mappedData = static_cast<uint8_t *>(mappedResource.pData);
-  for (UINT row = 0; row < desktopHeight; row++) {
-    memcpy(frameBuffer.data() + row * pitch, mappedData + row * pitch, pitch);
+  // Only the rows and columns inside the region are read from the mapped texture
+  int32_t bytesPerRow = region.width * 4;
+  size_t bufferSize = static_cast<size_t>(bytesPerRow) * region.height;
+
+  // The frame buffer is recycled by the pipeline, so this only allocates when the region grows
+  if (frame.pixels.size() != bufferSize) {
+    frame.pixels.resize(bufferSize);
   }
 
+  int64_t copyStart = monotonicNowNs();
+  copyFrameRegion(static_cast<const uint8_t *>(mappedResource.pData), mappedResource.RowPitch, region, 4,
+                  frame.pixels.data(), bytesPerRow);
+  frame.copyNs = monotonicNowNs() - copyStart;
+
   context->Unmap(stagingTexture, 0);
 
-  *buffer = frameBuffer.data();
-  *width = desktopWidth;
-  *height = desktopHeight;
-  *bytesPerRow = pitch;
+  frame.width = region.width;
+  frame.height = region.height;
+  frame.bytesPerRow = bytesPerRow;
 
   return true;
 }
@@ -485,14 +658,14 @@ bool VideoCaptureImpl::encodeFrameToJPEG(
     IStream* stream = NULL;
     HRESULT hr = CreateStreamOnHGlobal(NULL, TRUE, &stream);
     if (FAILED(hr)) {
-        snprintf(errorMsg, sizeof(errorMsg) - 1, "Failed to create stream: 0x%lx", hr);
+        snprintf(encodeErrorMsg, sizeof(encodeErrorMsg) - 1, "Failed to create stream: 0x%lx", hr);
         return false;
     }
     
     CLSID jpegClsid;
     int result = GetEncoderClsid(L"image/jpeg", &jpegClsid);
     if (result == -1) {
-        snprintf(errorMsg, sizeof(errorMsg) - 1, "JPEG encoder not found");
+        snprintf(encodeErrorMsg, sizeof(encodeErrorMsg) - 1, "JPEG encoder not found");
         stream->Release();
         return false;
     }
@@ -507,7 +680,7 @@ bool VideoCaptureImpl::encodeFrameToJPEG(
     
     Gdiplus::Status status = bitmap.Save(stream, &jpegClsid, &encoderParams);
     if (status != Gdiplus::Ok) {
-        snprintf(errorMsg, sizeof(errorMsg) - 1, "Failed to save bitmap: %d", status);
+        snprintf(encodeErrorMsg, sizeof(encodeErrorMsg) - 1, "Failed to save bitmap: %d", status);
         stream->Release();
         return false;
     }
@@ -515,7 +688,7 @@ bool VideoCaptureImpl::encodeFrameToJPEG(
     HGLOBAL hg = NULL;
     hr = GetHGlobalFromStream(stream, &hg);
     if (FAILED(hr)) {
-        snprintf(errorMsg, sizeof(errorMsg) - 1, "Failed to get data from stream: 0x%lx", hr);
+        snprintf(encodeErrorMsg, sizeof(encodeErrorMsg) - 1, "Failed to get data from stream: 0x%lx", hr);
         stream->Release();
         return false;
     }
@@ -563,12 +736,8 @@ int VideoCaptureImpl::GetEncoderClsid(const WCHAR* format, CLSID* pClsid) {
  * Stop capture and clean up resources
  */
 void VideoCaptureImpl::stop(StopCaptureCallback stopCallback, void *context) {
-    isCapturing.store(false);
-
-    if (captureThread && captureThread->joinable()) {
-        captureThread->join();
-        delete captureThread;
-        captureThread = nullptr;
+    if (pipeline) {
+        pipeline->stop();
     }
 
     cleanup();
@@ -610,6 +779,4 @@ void VideoCaptureImpl::cleanup() {
         device->Release();
         device = nullptr;
     }
-
-    frameBuffer.clear();
 }
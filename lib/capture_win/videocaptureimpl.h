@@ -13,13 +13,16 @@
 #include <dxgi1_2.h>
 #include <objidl.h> // For IStream
 #include <gdiplus.h> // For GDI+
-#include <chrono>
-#include <vector>
-#include <thread>
 #include <atomic>
+#include <chrono>
 #include <mutex>
-#include <condition_variable>
+#include <string>
+#include <vector>
+#include <memory>
 #include "capture/capture.h"
+#include "croprect.h"
+#include "renditionpipeline.h"
+#include "videopipeline.h"
 
 /**
  * @class VideoCaptureImpl
@@ -27,8 +30,10 @@
  * 
  * Handles the low-level video capture functionality for Windows using DXGI Desktop Duplication API.
  * Supports display capture with configurable frame rate and compression quality.
+ * Acquisition and JPEG encoding run as separate stages of a VideoPipeline, so a
+ * slow encode never delays the next AcquireNextFrame call.
  */
-class VideoCaptureImpl {
+class VideoCaptureImpl : public VideoFrameSource, public VideoFrameEncoder {
 public:
     /**
      * @brief Constructor - initializes resources to default values
@@ -43,19 +48,53 @@ public:
     /**
      * @brief Start video capture with specified configuration
      * 
+     * A display already opened with open() is reused if it is the same
+     * displayID; only the other settings of config are applied.
+     * 
      * @param config Media capture configuration including frame rate and quality settings
      * @param videoCallback Function called when video frame is available
      * @param exitCallback Function called when an error occurs
      * @param context User data passed to callbacks
+     * @param syncClock Clock shared with audio capture, used to stamp frames; may be null
      * @return true if capture started successfully, false otherwise
      */
     bool start(
         const MediaCaptureConfigC& config,
         MediaCaptureDataCallback videoCallback,
         MediaCaptureExitCallback exitCallback,
-        void* context
+        void* context,
+        std::shared_ptr<AvSyncClock> syncClock = nullptr
     );
 
+    /**
+     * @brief Open the display and prepare the encoder without starting the pipeline
+     * 
+     * On its own, this prepares one target of a MultiTargetPipeline, which then
+     * drives this object as both source and encoder.
+     * 
+     * @param config Media capture configuration
+     * @param shareDeviceWith Opened capture whose D3D device and context to reuse, or nullptr to create them
+     * @return true if the display is ready to capture; otherwise lastAcquireError() describes why
+     */
+    bool open(const MediaCaptureConfigC& config, VideoCaptureImpl* shareDeviceWith);
+
+    /**
+     * @brief Whether open() has duplicated this display and no pipeline runs yet
+     */
+    bool isOpenFor(uint32_t displayID) const {
+        return duplication && !pipeline && config.displayID == displayID;
+    }
+
+    /**
+     * @brief Settings of one output rendition; an unset frame rate or quality is taken from config
+     */
+    static VideoRendition renditionFor(const MediaCaptureConfigC& config, const MediaCaptureRenditionC& rendition);
+
+    /**
+     * @brief Adaptive quality controller of the opened display, or null if no budget was configured
+     */
+    std::shared_ptr<AdaptiveQualityController> adaptiveQuality() const { return qualityController; }
+
     /**
      * @brief Stop video capture and release resources
      * 
@@ -67,6 +106,71 @@ public:
         void* context
     );
 
+    /**
+     * @brief Apply new settings to the duplicated display without closing it
+     * 
+     * Frame rate, JPEG quality, output format, crop and the adaptive quality
+     * budget change between two frames; the D3D device and the duplication
+     * stay. Enabling adaptive quality restarts a pipeline started by start()
+     * on the same duplication; a target driven by a MultiTargetPipeline cannot
+     * gain a controller this way.
+     * 
+     * @param config New configuration for the same displayID
+     * @return false if a controller would have to be added to a MultiTargetPipeline
+     *         target; nothing changed then and lastEncodeError() describes why
+     */
+    bool reconfigure(const MediaCaptureConfigC& config);
+
+    /**
+     * @brief Check whether reconfigure() would accept a configuration, without applying it
+     * @return false if reconfigure() would fail; lastEncodeError() describes why
+     */
+    bool canReconfigure(const MediaCaptureConfigC& config);
+
+    /**
+     * @brief Change the region of interest; takes effect from the next captured frame
+     * @param rect Crop rectangle in desktop pixels (zero size = full desktop)
+     */
+    void setCropRect(const MediaCaptureRectC& rect);
+
+    /**
+     * @brief Check a crop rectangle against the desktop, without applying it
+     * @param error Receives why the rectangle cannot be used
+     * @return false if it lies entirely outside the desktop
+     */
+    bool checkCropRect(const MediaCaptureRectC& rect, std::string& error) const;
+
+    /**
+     * @brief Snapshot of pipeline counters and per-stage timings
+     */
+    VideoPipelineStats stats() const;
+
+    /**
+     * @brief Snapshot of the adaptive quality controller
+     * @param stats Receives the controller state
+     * @return false if no budget was configured for this capture
+     */
+    bool qualityStats(AdaptiveQualityStats& stats) const;
+
+    /**
+     * @name Pipeline Stages
+     * VideoFrameSource / VideoFrameEncoder implementation
+     */
+    ///@{
+    /**
+     * @brief Acquire a desktop frame and copy it from the staging texture (capture thread)
+     */
+    AcquireResult acquireFrame(VideoFrame& frame, uint32_t timeoutMs) override;
+
+    /**
+     * @brief Encode a captured frame to JPEG, or pass BGRA through for raw output (encode thread)
+     */
+    bool encodeFrame(const VideoFrame& frame, EncodedFrame& out) override;
+
+    const char* lastAcquireError() const override { return errorMsg; }
+    const char* lastEncodeError() const override { return encodeErrorMsg; }
+    ///@}
+
 private:
     /**
      * @name Direct3D and DXGI Resources
@@ -107,47 +211,58 @@ private:
     DXGI_OUTPUT_DESC outputDesc;
     ///@}
     
-    /** Buffer for storing processed frame data */
-    std::vector<uint8_t> frameBuffer;
-    
     /**
      * @name Timing Management
      * Resources for controlling frame rate and timing
      */
     ///@{
-    /** Timestamp of the last frame capture attempt */
-    std::chrono::high_resolution_clock::time_point lastFrameTime;
-    
     /** Timestamp of the last successful frame capture */
     std::chrono::high_resolution_clock::time_point lastSuccessfulFrameTime;
     
-    /** Target interval between frames (based on frameRate setting) */
-    std::chrono::milliseconds frameInterval;
+    /** Target interval between frames in ms (based on frameRate setting), read by the capture thread */
+    std::atomic<int64_t> frameIntervalMs;
     ///@}
     
+    /** Capture and encode stages; created in start() */
+    std::unique_ptr<VideoPipeline> pipeline;
+    
+    /** Configuration of start(), read by the capture threads; reconfigure() leaves it alone, bundleID is null */
+    MediaCaptureConfigC config;
+
+    /** Region of interest copied out of the staging texture */
+    SharedCropRect cropRect;
+
+    /** Callbacks and clock of start(), kept to restart the pipeline on the same duplication */
+    MediaCaptureDataCallback videoCallback;
+    MediaCaptureExitCallback exitCallback;
+    void* callbackContext;
+    std::shared_ptr<AvSyncClock> syncClock;
+
     /**
-     * @name Thread Management
-     * Resources for controlling the background capture thread
+     * @name Encoder Settings
+     * Copied once per frame by the encode thread, guarded by settingsMutex
      */
     ///@{
-    /** Background thread for capture operations */
-    std::thread* captureThread;
-    
-    /** Flag controlling capture thread execution */
-    std::atomic<bool> isCapturing;
-    
-    /** Mutex for thread synchronization */
-    std::mutex captureMutex;
-    
-    /** Condition variable for signaling between threads */
-    std::condition_variable captureCV;
+    std::mutex settingsMutex;
+
+    /** JPEG quality (0-100) derived from the configuration */
+    int jpegQuality;
+
+    /** 0=JPEG, 1=raw BGRA */
+    int imageFormat;
     ///@}
+
+    /** Closed-loop quality control; null unless a budget is configured */
+    std::shared_ptr<AdaptiveQualityController> qualityController;
+
+    /** Downscaled copy of the frame being encoded (encode thread only) */
+    std::vector<uint8_t> scaledPixels;
     
-    /** Current capture configuration */
-    MediaCaptureConfigC config;
-    
-    /** Buffer for error messages */
+    /** Buffer for error messages from the capture stage */
     char errorMsg[1024];
+
+    /** Buffer for error messages from the encode stage */
+    char encodeErrorMsg[1024];
     
     /** Flag indicating if COM has been initialized */
     bool comInitialized;
@@ -157,6 +272,12 @@ private:
      * Functions for setting up capture infrastructure
      */
     ///@{
+    /**
+     * @brief Apply frame rate, quality and budget settings without touching the display
+     * @return true if the settings can be produced
+     */
+    bool configure(const MediaCaptureConfigC& config);
+
     /**
      * @brief Initialize COM library for the current thread
      * @return true if successful, false otherwise
@@ -190,19 +311,17 @@ private:
     ///@{
     /**
      * @brief Capture the next desktop frame
+     * @param timeoutMs Maximum time to wait in AcquireNextFrame
      * @return true if frame was successfully captured, false otherwise
      */
-    bool captureFrame();
+    bool captureFrame(UINT timeoutMs);
     
     /**
-     * @brief Process the captured frame for callback delivery
-     * @param buffer Pointer that will receive the frame data
-     * @param width Will be set to frame width
-     * @param height Will be set to frame height
-     * @param bytesPerRow Will be set to row stride in bytes
+     * @brief Copy the region of interest from the staging texture into CPU memory
+     * @param frame Frame that receives the pixel data and dimensions
      * @return true if successful, false otherwise
      */
-    bool processFrame(uint8_t** buffer, int* width, int* height, int* bytesPerRow);
+    bool processFrame(VideoFrame& frame);
     
     /**
      * @brief Encode raw pixel data to JPEG format
@@ -217,18 +336,6 @@ private:
     bool encodeFrameToJPEG(const uint8_t* rawData, int width, int height, int bytesPerRow, 
                          std::vector<uint8_t>& jpegData, int quality);
     
-    /**
-     * @brief Background thread procedure for video capture
-     * @param videoCallback Function to call with captured video data
-     * @param exitCallback Function to call if an error occurs
-     * @param context User data passed to callbacks
-     */
-    void captureThreadProc(
-        MediaCaptureDataCallback videoCallback,
-        MediaCaptureExitCallback exitCallback,
-        void* context
-    );
-    
     /**
      * @brief Clean up all resources
      */
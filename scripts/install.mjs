@@ -34,6 +34,8 @@ switch (process.platform) {
       "--arch=x64"
     );
     break;
+  case "linux":
+    break;
   default:
     console.error(`unsupported platform ${process.platform}`);
     exit(1);
@@ -1,11 +1,44 @@
+#include "addondata.h"
 #include "audiocapture.h"
 #include "mediacapture.h"
+#include "sharedframereader.h"
 #include <napi.h>
+#include <vector>
+
+// Runs when the environment shuts down, before the wrapped objects are finalized.
+// Stopping here joins the capture threads while the thread-safe functions they call are still valid.
+static void CleanupEnvironment(void *arg) {
+  auto data = static_cast<AddonData *>(arg);
+
+  // Shutdown may unregister instances, so iterate over copies
+  std::vector<MediaCapture *> mediaCaptures(data->mediaCaptures.begin(), data->mediaCaptures.end());
+  for (MediaCapture *capture : mediaCaptures) {
+    capture->SafeShutdown();
+  }
+  std::vector<AudioCapture *> audioCaptures(data->audioCaptures.begin(), data->audioCaptures.end());
+  for (AudioCapture *capture : audioCaptures) {
+    capture->Shutdown();
+  }
+
+  // A snapshot worker must be done with its thread-safe function before the environment frees it;
+  // the function's finalizer still deletes the context afterwards
+  for (SnapshotContext *snapshot : data->snapshots) {
+    if (snapshot->worker.joinable()) {
+      snapshot->worker.join();
+    }
+  }
+}
 
 Napi::Object InitAll(Napi::Env env, Napi::Object exports) {
+  // Owned by the environment, deleted after all of its objects are finalized
+  auto data = new AddonData();
+  env.SetInstanceData(data);
+  napi_add_env_cleanup_hook(env, CleanupEnvironment, data);
+
   exports = AudioCapture::Init(env, exports);
   exports = MediaCapture::Init(env, exports);
+  exports = SharedFrameReader::Init(env, exports);
   return exports;
 }
 
-NODE_API_MODULE(addon, InitAll)
\ No newline at end of file
+NODE_API_MODULE(addon, InitAll)
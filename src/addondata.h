@@ -0,0 +1,45 @@
+/**
+ * @file addondata.h
+ * @brief Per-environment state of the addon
+ *
+ * The addon may be loaded by the main thread and by any number of worker
+ * threads at the same time. Each of them is a separate Node environment with
+ * its own AddonData, stored as the environment's instance data, so nothing
+ * JavaScript-facing is shared between environments. When an environment shuts
+ * down (a worker is terminated, or the process exits), its cleanup hook stops
+ * every capture it still owns before the environment's handles go away.
+ */
+#ifndef _ADDON_DATA_H_
+#define _ADDON_DATA_H_
+
+#include <napi.h>
+#include <set>
+
+class AudioCapture;
+class MediaCapture;
+struct SnapshotContext;
+
+struct AddonData {
+  /** @name Class constructors of this environment */
+  ///@{
+  Napi::FunctionReference audioCapture;
+  Napi::FunctionReference mediaCapture;
+  Napi::FunctionReference sharedFrameReader;
+  ///@}
+
+  /** @name Live instances, stopped by the cleanup hook; touched only on the environment's thread */
+  ///@{
+  std::set<AudioCapture *>    audioCaptures;
+  std::set<MediaCapture *>    mediaCaptures;
+  std::set<SnapshotContext *> snapshots; /**< snapshot() calls whose worker may still use its tsfn */
+  ///@}
+
+  /**
+   * @brief The AddonData of an environment, created by the module initializer
+   */
+  static AddonData *Get(Napi::Env env) {
+    return env.GetInstanceData<AddonData>();
+  }
+};
+
+#endif // _ADDON_DATA_H_
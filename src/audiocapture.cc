@@ -1,16 +1,16 @@
 #include "audiocapture.h"
-
-Napi::FunctionReference AudioCapture::_constructor;
+#include "addondata.h"
+#include "mediacapture.h"
 
 Napi::Object AudioCapture::Init(Napi::Env env, Napi::Object exports) {
   Napi::Function func = DefineClass(
       env, "AudioCapture",
       {StaticMethod("enumerateDesktopWindows", &AudioCapture::EnumerateDesktopWindows),
        InstanceMethod("startCapture", &AudioCapture::StartCapture),
-       InstanceMethod("stopCapture", &AudioCapture::StopCapture)});
+       InstanceMethod("stopCapture", &AudioCapture::StopCapture),
+       InstanceMethod("getStats", &AudioCapture::GetStats)});
 
-  _constructor = Napi::Persistent(func);
-  _constructor.SuppressDestruct();
+  AddonData::Get(env)->audioCapture = Napi::Persistent(func);
 
   exports.Set("AudioCapture", func);
 
@@ -19,9 +19,11 @@ Napi::Object AudioCapture::Init(Napi::Env env, Napi::Object exports) {
 
 AudioCapture::AudioCapture(const Napi::CallbackInfo &info) : Napi::ObjectWrap<AudioCapture>(info) {
   _capturePtr = createCapture();
+  AddonData::Get(info.Env())->audioCaptures.insert(this);
 }
 
 void AudioCapture::Finalize(Napi::Env env) {
+  AddonData::Get(env)->audioCaptures.erase(this);
   if (_capturePtr != nullptr) {
     destroyCapture(_capturePtr);
     _capturePtr = nullptr;
@@ -143,10 +145,12 @@ Napi::Value AudioCapture::StartCapture(const Napi::CallbackInfo &info) {
 
   Napi::Function emit = info.This().As<Napi::Object>().Get("emit").As<Napi::Function>();
 
+  _deliveryStats->reset();
   auto ctx = new StartCaptureContext(
       Napi::ThreadSafeFunction::New(env, emit, "StartCaptureCallback", 0, 1),
-      Napi::Persistent(info.This().As<Napi::Object>()));
+      Napi::Persistent(info.This().As<Napi::Object>()), _deliveryStats);
   CaptureConfig cc = {channels, sampleRate, displayId, windowId};
+  _isCapturing = true;
   startCapture(_capturePtr, cc, AudioCapture::StartCaptureDataCallback, AudioCapture::StartCaptureExitCallback, ctx);
 
   return env.Undefined();
@@ -161,8 +165,9 @@ void AudioCapture::StartCaptureDataCallback(
   auto length = samples * channels;
   auto data   = new AudioCapture::StartCaptureCallbackData{};
   // TODO: メモリープールを用意する
-  data->data   = new float[length];
-  data->length = length;
+  data->data          = new float[length];
+  data->length        = length;
+  data->callbackStart = monotonicNowNs();
   std::copy(pcm, pcm + length, data->data); // make copy of *pcm data for use from different thread
 
   auto callback = [ctx](Napi::Env env, Napi::Function jsCallback, StartCaptureCallbackData *data) {
@@ -170,6 +175,9 @@ void AudioCapture::StartCaptureDataCallback(
     // therefore we must not access the original data in *pcm (because it is not thread safe),
     // and instead only access our copy of the data in data->data.
 
+    ctx->delivery->audioDispatch.record(static_cast<uint64_t>(monotonicNowNs() - data->callbackStart));
+    ctx->delivery->audioDelivered.fetch_add(1, std::memory_order_relaxed);
+
     auto buffer = Napi::ArrayBuffer::New(env, data->length * sizeof(float));
     auto array  = Napi::Float32Array::New(env, data->length, buffer, 0);
     std::copy(data->data, data->data + data->length, array.Data());
@@ -183,6 +191,7 @@ void AudioCapture::StartCaptureDataCallback(
   napi_status status = ctx->callback.BlockingCall(data, callback);
   if (status != napi_ok) {
     // TODO: handle error
+    ctx->delivery->audioDropped.fetch_add(1, std::memory_order_relaxed);
   }
 }
 
@@ -216,11 +225,46 @@ Napi::Value AudioCapture::StopCapture(const Napi::CallbackInfo &info) {
           env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}), "StopCaptureCallback", 0, 1),
       deferred);
 
+  _isCapturing = false;
   stopCapture(_capturePtr, AudioCapture::StopCaptureCallback, ctx);
 
   return deferred.Promise();
 }
 
+void AudioCapture::Shutdown() {
+  if (_isCapturing && _capturePtr != nullptr) {
+    _isCapturing = false;
+    // The environment is going away, so there is no promise to settle
+    stopCapture(_capturePtr, [](void *) {}, nullptr);
+  }
+}
+
+Napi::Value AudioCapture::GetStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  MediaCaptureStatsC stats;
+  std::memset(&stats, 0, sizeof(stats));
+  if (_capturePtr != nullptr) {
+    getCaptureStats(_capturePtr, &stats);
+  }
+
+  Napi::Object stages = Napi::Object::New(env);
+  stages.Set("acquire", StageStatsObject(env, stats.audioAcquire));
+  stages.Set("downmix", StageStatsObject(env, stats.downmix));
+  stages.Set("resample", StageStatsObject(env, stats.resample));
+  stages.Set("deliver", StageStatsObject(env, stats.audioDeliver));
+  stages.Set("jsDispatch", StageStatsObject(env, _deliveryStats->audioDispatch));
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("packets", Napi::Number::New(env, static_cast<double>(stats.audioPackets)));
+  result.Set("frames", Napi::Number::New(env, static_cast<double>(stats.audioFrames)));
+  result.Set("dropped", Napi::Number::New(env, static_cast<double>(stats.audioDropped)));
+  result.Set("jsDelivered", Napi::Number::New(env, static_cast<double>(_deliveryStats->audioDelivered.load())));
+  result.Set("jsDropped", Napi::Number::New(env, static_cast<double>(_deliveryStats->audioDropped.load())));
+  result.Set("stages", stages);
+  return result;
+}
+
 void AudioCapture::StopCaptureCallback(void *context) {
   auto ctx = reinterpret_cast<StopCaptureContext *>(context);
 
@@ -2,10 +2,12 @@
 #define _AUDIO_CAPTURE_H_
 
 #include <fstream>
+#include <memory>
 #include <napi.h>
 #include <vector>
 
 #include "capture/capture.h"
+#include "capturestats.h"
 
 class ThreadSafeContext {
 public:
@@ -24,6 +26,14 @@ public:
   AudioCapture(const Napi::CallbackInfo &info);
   void Finalize(Napi::Env env) override;
 
+  /**
+   * @brief Stop a running capture without settling any promise
+   *
+   * Called when the instance's environment shuts down, e.g. when the worker
+   * thread that owns it is terminated.
+   */
+  void Shutdown();
+
 private:
   class EnumerateDesktopWindowsContext : public ThreadSafeContext {
   public:
@@ -39,18 +49,22 @@ private:
   typedef struct {
     float  *data;
     int32_t length;
+    int64_t callbackStart;
   } StartCaptureCallbackData;
 
   class StartCaptureContext : public ThreadSafeContext {
   public:
-    StartCaptureContext(Napi::ThreadSafeFunction callback, Napi::ObjectReference refThis) :
+    StartCaptureContext(
+        Napi::ThreadSafeFunction callback, Napi::ObjectReference refThis, std::shared_ptr<DeliveryStats> delivery) :
         ThreadSafeContext(callback),
-        refThis(std::move(refThis)) {}
+        refThis(std::move(refThis)),
+        delivery(std::move(delivery)) {}
     ~StartCaptureContext() {
       refThis.Reset();
     }
 
-    Napi::ObjectReference refThis;
+    Napi::ObjectReference          refThis;
+    std::shared_ptr<DeliveryStats> delivery;
   };
 
   class StopCaptureContext : public ThreadSafeContext {
@@ -65,6 +79,7 @@ private:
   static Napi::Value EnumerateDesktopWindows(const Napi::CallbackInfo &info);
   Napi::Value        StartCapture(const Napi::CallbackInfo &info);
   Napi::Value        StopCapture(const Napi::CallbackInfo &info);
+  Napi::Value        GetStats(const Napi::CallbackInfo &info);
 
   static void EnumerateDesktopWindowsCallback(
       DisplayInfo *displayInfo, int32_t displayCount, WindowInfo *windowInfo, int32_t windowCount, char *error,
@@ -74,8 +89,9 @@ private:
   static void StartCaptureExitCallback(char *error, void *context);
   static void StopCaptureCallback(void *context);
 
-  static Napi::FunctionReference _constructor;
-  void                          *_capturePtr = nullptr;
+  void                          *_capturePtr  = nullptr;
+  bool                           _isCapturing = false;
+  std::shared_ptr<DeliveryStats> _deliveryStats = std::make_shared<DeliveryStats>();
 };
 
 #endif
@@ -1,7 +1,13 @@
 #include "mediacapture.h"
+#include "addondata.h"
+#include "jpegcodec.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <string>
+#include <type_traits>
 
 Napi::Object MediaCapture::Init(Napi::Env env, Napi::Object exports) {
   Napi::HandleScope scope(env);
@@ -9,15 +15,27 @@ Napi::Object MediaCapture::Init(Napi::Env env, Napi::Object exports) {
   Napi::Function func = DefineClass(
       env, "MediaCapture",
       {
+          InstanceMethod("prepare", &MediaCapture::Prepare),
           InstanceMethod("startCapture", &MediaCapture::StartCapture),
           InstanceMethod("stopCapture", &MediaCapture::StopCapture),
+          InstanceMethod("startRecording", &MediaCapture::StartRecording),
+          InstanceMethod("snapshot", &MediaCapture::Snapshot),
+          InstanceMethod("reconfigure", &MediaCapture::Reconfigure),
+          InstanceMethod("setCropRect", &MediaCapture::SetCropRect),
+          InstanceMethod("getQualityStats", &MediaCapture::GetQualityStats),
+          InstanceMethod("getStats", &MediaCapture::GetStats),
+          InstanceMethod("dumpTrace", &MediaCapture::DumpTrace),
+          InstanceMethod("pauseDelivery", &MediaCapture::PauseDelivery),
+          InstanceMethod("resumeDelivery", &MediaCapture::ResumeDelivery),
+          InstanceMethod("openPull", &MediaCapture::OpenPull),
+          InstanceMethod("pull", &MediaCapture::Pull),
+          InstanceMethod("closePull", &MediaCapture::ClosePull),
+          InstanceMethod("watchTargets", &MediaCapture::WatchTargets),
+          InstanceMethod("unwatchTargets", &MediaCapture::UnwatchTargets),
           StaticMethod("enumerateMediaCaptureTargets", &MediaCapture::EnumerateTargets),
       });
 
-  Napi::FunctionReference *constructor = new Napi::FunctionReference();
-  *constructor                         = Napi::Persistent(func);
-
-  env.SetInstanceData(constructor);
+  AddonData::Get(env)->mediaCapture = Napi::Persistent(func);
 
   exports.Set("MediaCapture", func);
   return exports;
@@ -26,15 +44,27 @@ Napi::Object MediaCapture::Init(Napi::Env env, Napi::Object exports) {
 MediaCapture::MediaCapture(const Napi::CallbackInfo &info) :
     Napi::ObjectWrap<MediaCapture>(info),
     isCapturing_(false),
-    captureHandle_(nullptr) {
+    captureHandle_(nullptr),
+    framePool_(FrameBufferPool::create()),
+    deliveryStats_(std::make_shared<DeliveryStats>()),
+    videoGate_(std::make_shared<DeliveryGate<PendingVideoFrame>>()),
+    audioGate_(std::make_shared<DeliveryGate<PendingAudio>>()),
+    videoPull_(std::make_shared<PullConsumer>()),
+    audioPull_(std::make_shared<PullConsumer>()) {
   Napi::Env         env = info.Env();
   Napi::HandleScope scope(env);
 
   captureHandle_ = createMediaCapture();
+  AddonData::Get(env)->mediaCaptures.insert(this);
 }
 
 void MediaCapture::SafeShutdown() {
   bool was_capturing = isCapturing_.exchange(false);
+  StopWatchingTargets();
+  if (tracing_) {
+    setCaptureTraceEnabled(false);
+    tracing_ = false;
+  }
 
   try {
     if (tsfn_video_) {
@@ -66,10 +96,17 @@ void MediaCapture::SafeShutdown() {
       fprintf(stderr, "DEBUG: Error stopping media capture\n");
     }
   }
+  FinishRecording();
+  CloseSharedRing();
 }
 
 MediaCapture::~MediaCapture() {
   SafeShutdown();
+  AddonData::Get(Env())->mediaCaptures.erase(this);
+
+  // Queued wake-ups may still hold the consumers, so drop the references while on the JavaScript thread
+  videoPull_->onItems.Reset();
+  audioPull_->onItems.Reset();
 
   if (captureHandle_) {
     destroyMediaCapture(captureHandle_);
@@ -77,231 +114,1605 @@ MediaCapture::~MediaCapture() {
   }
 }
 
+/**
+ * Copy one enumeration out of the backend.
+ * Every backend calls back before enumerateMediaCaptureTargets() returns.
+ */
+static bool EnumerateNativeTargets(int32_t type, std::vector<CaptureTarget> &targets, std::string &error) {
+  struct Result {
+    bool                        called = false;
+    bool                        ok     = false;
+    std::vector<CaptureTarget> *targets;
+    std::string                *error;
+  };
+  Result result;
+  result.targets = &targets;
+  result.error   = &error;
+
+  auto callback = [](MediaCaptureTargetC *found, int32_t count, char *message, void *ctx) {
+    auto result    = static_cast<Result *>(ctx);
+    result->called = true;
+    if (message) {
+      *result->error = message;
+      return;
+    }
+    result->targets->clear();
+    for (int32_t i = 0; found && i < count; i++) {
+      CaptureTarget target;
+      target.isDisplay = found[i].isDisplay == 1;
+      target.isWindow  = found[i].isWindow == 1;
+      target.displayID = found[i].displayID;
+      target.windowID  = found[i].windowID;
+      target.width     = found[i].width;
+      target.height    = found[i].height;
+      target.title     = found[i].title ? found[i].title : "";
+      target.appName   = found[i].appName ? found[i].appName : "";
+      result->targets->push_back(std::move(target));
+    }
+    result->ok = true;
+  };
+  enumerateMediaCaptureTargets(type, callback, &result);
+
+  if (!result.called) {
+    error = "Target enumeration did not complete";
+    return false;
+  }
+  return result.ok;
+}
+
+/**
+ * The registry shared by every instance and worker thread.
+ * Deliberately never destroyed, so no thread is joined during process exit.
+ */
+static TargetRegistry &Targets() {
+  static TargetRegistry *registry = new TargetRegistry(EnumerateNativeTargets);
+  return *registry;
+}
+
+/**
+ * Read {type, appName, minWidth, minHeight, displayId} into a TargetFilter.
+ * Missing fields select everything.
+ */
+static void ReadTargetFilter(const Napi::Object &options, TargetFilter &filter) {
+  if (options.Has("type") && options.Get("type").IsNumber()) {
+    filter.type = options.Get("type").As<Napi::Number>().Int32Value();
+  }
+  if (options.Has("appName") && options.Get("appName").IsString()) {
+    filter.appName = options.Get("appName").As<Napi::String>().Utf8Value();
+  }
+  if (options.Has("minWidth") && options.Get("minWidth").IsNumber()) {
+    filter.minWidth = options.Get("minWidth").As<Napi::Number>().Int32Value();
+  }
+  if (options.Has("minHeight") && options.Get("minHeight").IsNumber()) {
+    filter.minHeight = options.Get("minHeight").As<Napi::Number>().Int32Value();
+  }
+  if (options.Has("displayId") && options.Get("displayId").IsNumber()) {
+    filter.displayID = options.Get("displayId").As<Napi::Number>().Uint32Value();
+  }
+}
+
+static Napi::Object TargetObject(Napi::Env env, const CaptureTarget &target) {
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("isDisplay", Napi::Boolean::New(env, target.isDisplay));
+  obj.Set("isWindow", Napi::Boolean::New(env, target.isWindow));
+  obj.Set("displayId", Napi::Number::New(env, target.displayID));
+  obj.Set("windowId", Napi::Number::New(env, target.windowID));
+  obj.Set("width", Napi::Number::New(env, target.width));
+  obj.Set("height", Napi::Number::New(env, target.height));
+  if (!target.title.empty()) {
+    obj.Set("title", Napi::String::New(env, target.title));
+  }
+  if (!target.appName.empty()) {
+    obj.Set("applicationName", Napi::String::New(env, target.appName));
+  }
+
+  Napi::Object frame = Napi::Object::New(env);
+  frame.Set("width", Napi::Number::New(env, target.width));
+  frame.Set("height", Napi::Number::New(env, target.height));
+  obj.Set("frame", frame);
+  return obj;
+}
+
+static Napi::Array TargetArray(Napi::Env env, const std::vector<CaptureTarget> &targets) {
+  Napi::Array result = Napi::Array::New(env, targets.size());
+  for (size_t i = 0; i < targets.size(); i++) {
+    result[i] = TargetObject(env, targets[i]);
+  }
+  return result;
+}
+
 Napi::Value MediaCapture::EnumerateTargets(const Napi::CallbackInfo &info) {
   Napi::Env               env      = info.Env();
   Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
 
-  int32_t targetType = 0;
+  TargetFilter filter;
   if (info.Length() > 0 && info[0].IsNumber()) {
-    targetType = info[0].As<Napi::Number>().Int32Value();
+    filter.type = info[0].As<Napi::Number>().Int32Value();
   }
 
-  // Create thread-safe context
-  struct EnumerateContext {
-    Napi::Promise::Deferred  deferred;
-    Napi::ThreadSafeFunction tsfn;
+  // While anyone watches, the polling thread keeps the cache as current as a fresh enumeration
+  int64_t maxAgeMs = Targets().cacheLifetimeMs();
+  if (info.Length() > 1 && info[1].IsObject()) {
+    Napi::Object options = info[1].As<Napi::Object>();
+    ReadTargetFilter(options, filter);
+    if (options.Has("maxAgeMs") && options.Get("maxAgeMs").IsNumber()) {
+      maxAgeMs = options.Get("maxAgeMs").As<Napi::Number>().Int64Value();
+    }
+  }
 
-    ~EnumerateContext() {
-      // Ensure Abort is called in destructor
-      if (tsfn) {
-        tsfn.Abort();
+  std::vector<CaptureTarget> targets;
+  std::string                error;
+  if (Targets().targets(filter, maxAgeMs, targets, error)) {
+    deferred.Resolve(TargetArray(env, targets));
+  } else {
+    deferred.Reject(Napi::Error::New(env, error).Value());
+  }
+  return deferred.Promise();
+}
+
+Napi::Value MediaCapture::WatchTargets(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  TargetFilter filter;
+  int64_t      intervalMs = TargetRegistry::kDefaultPollMs;
+  if (info.Length() > 0 && info[0].IsObject()) {
+    Napi::Object options = info[0].As<Napi::Object>();
+    ReadTargetFilter(options, filter);
+    if (options.Has("intervalMs") && options.Get("intervalMs").IsNumber()) {
+      intervalMs = options.Get("intervalMs").As<Napi::Number>().Int64Value();
+    }
+  }
+
+  // A second call replaces the filter
+  StopWatchingTargets();
+
+  tsfn_targets_ = Napi::ThreadSafeFunction::New(
+      env, info.This().As<Napi::Object>().Get("emit").As<Napi::Function>(), "TargetsEmitter", 0, 1);
+
+  Napi::ThreadSafeFunction tsfn = tsfn_targets_;
+  targetWatch_ = Targets().subscribe(filter, intervalMs, [tsfn](const TargetChanges &changes) {
+    tsfn.NonBlockingCall([changes](Napi::Env env, Napi::Function emit) {
+      Napi::HandleScope scope(env);
+      Napi::Object      event = Napi::Object::New(env);
+      event.Set("added", TargetArray(env, changes.added));
+      event.Set("removed", TargetArray(env, changes.removed));
+      event.Set("updated", TargetArray(env, changes.updated));
+      if (emit.IsFunction()) {
+        emit.Call({Napi::String::New(env, "targets-changed"), event});
       }
+    });
+  });
+  return env.Undefined();
+}
+
+Napi::Value MediaCapture::UnwatchTargets(const Napi::CallbackInfo &info) {
+  StopWatchingTargets();
+  return info.Env().Undefined();
+}
+
+void MediaCapture::StopWatchingTargets() {
+  if (targetWatch_ != 0) {
+    // No change callback runs once this returns, so the function can be released
+    Targets().unsubscribe(targetWatch_);
+    targetWatch_ = 0;
+  }
+  if (tsfn_targets_) {
+    tsfn_targets_.Release();
+    tsfn_targets_ = Napi::ThreadSafeFunction();
+  }
+}
+
+/**
+ * Read a {x, y, width, height} object into a MediaCaptureRectC.
+ * null/undefined clear the crop; returns false for any other non-object.
+ */
+static bool ReadCropRect(const Napi::Value &value, MediaCaptureRectC &rect) {
+  rect = {0, 0, 0, 0};
+  if (value.IsNull() || value.IsUndefined()) {
+    return true;
+  }
+  if (!value.IsObject()) {
+    return false;
+  }
+
+  Napi::Object object = value.As<Napi::Object>();
+  auto         field  = [&object](const char *name) -> int32_t {
+    Napi::Value v = object.Get(name);
+    return v.IsNumber() ? v.As<Napi::Number>().Int32Value() : 0;
+  };
+  rect.x      = field("x");
+  rect.y      = field("y");
+  rect.width  = field("width");
+  rect.height = field("height");
+  return rect.width >= 0 && rect.height >= 0;
+}
+
+/**
+ * Read an audioTaps array of {sampleRate, channels, format, chunkMs} objects; 'logmel' taps
+ * also take nFft, winLength, hop, nMels, fmin and fmax, and default to 16 kHz.
+ * undefined yields no taps; anything else that is not a non-empty array of valid taps fails.
+ */
+static bool ReadAudioTaps(const Napi::Value &value, std::vector<AudioTapConfig> &taps, std::string &error) {
+  taps.clear();
+  if (value.IsUndefined()) {
+    return true;
+  }
+  error = "audioTaps must be a non-empty array of {sampleRate, channels (1 or 2), format ('f32', 's16' or "
+          "'logmel'), chunkMs} objects; logmel taps take nFft (16-8192), winLength (up to nFft), hop (1 to nFft), "
+          "nMels (1-512), fmin and fmax";
+  if (!value.IsArray() || value.As<Napi::Array>().Length() == 0) {
+    return false;
+  }
+  Napi::Array array = value.As<Napi::Array>();
+  for (uint32_t i = 0; i < array.Length(); i++) {
+    if (!array.Get(i).IsObject()) {
+      return false;
+    }
+    Napi::Object   object = array.Get(i).As<Napi::Object>();
+    AudioTapConfig tap;
+    if (object.Get("sampleRate").IsNumber()) {
+      tap.sampleRate = object.Get("sampleRate").As<Napi::Number>().Int32Value();
+      if (tap.sampleRate < 0 || tap.sampleRate > 384000) {
+        return false;
+      }
+    }
+    if (object.Get("channels").IsNumber()) {
+      tap.channels = object.Get("channels").As<Napi::Number>().Int32Value();
+      if (tap.channels != 1 && tap.channels != 2) {
+        return false;
+      }
+    }
+    Napi::Value format = object.Get("format");
+    if (!format.IsUndefined()) {
+      std::string name = format.IsString() ? format.As<Napi::String>().Utf8Value() : "";
+      if (name == "s16") {
+        tap.format = AudioSampleFormat::Int16;
+      } else if (name == "logmel") {
+        tap.format = AudioSampleFormat::LogMel;
+      } else if (name != "f32") {
+        return false;
+      }
+    }
+    if (tap.format == AudioSampleFormat::LogMel) {
+      // Speech models are trained on 16 kHz features
+      if (tap.sampleRate == 0) {
+        tap.sampleRate = 16000;
+      }
+      auto readCount = [&object](const char *name, uint32_t &target, uint32_t lowest, uint32_t highest) {
+        Napi::Value v = object.Get(name);
+        if (v.IsUndefined()) {
+          return true;
+        }
+        double number = v.IsNumber() ? v.As<Napi::Number>().DoubleValue() : -1;
+        if (!(number >= lowest && number <= highest)) {
+          return false;
+        }
+        target = static_cast<uint32_t>(number);
+        return true;
+      };
+      MelSpectrogramConfig &mel = tap.mel;
+      if (!readCount("nFft", mel.nFft, 16, 8192)) {
+        return false;
+      }
+      // The default 400-sample window belongs to the default 512-point transform; with another
+      // nFft the window spans the transform unless winLength is given
+      if (!object.Get("nFft").IsUndefined()) {
+        mel.winLength = 0;
+      }
+      if (!readCount("winLength", mel.winLength, 1, mel.nFft) || !readCount("hop", mel.hop, 1, mel.nFft) ||
+          !readCount("nMels", mel.nMels, 1, 512) || mel.winLength > mel.nFft) {
+        return false;
+      }
+      auto readHz = [&object](const char *name, float &target) {
+        Napi::Value v = object.Get(name);
+        if (v.IsUndefined()) {
+          return true;
+        }
+        if (!v.IsNumber() || v.As<Napi::Number>().DoubleValue() < 0) {
+          return false;
+        }
+        target = v.As<Napi::Number>().FloatValue();
+        return true;
+      };
+      if (!readHz("fmin", mel.fmin) || !readHz("fmax", mel.fmax)) {
+        return false;
+      }
+    }
+    if (object.Get("chunkMs").IsNumber()) {
+      double ms = object.Get("chunkMs").As<Napi::Number>().DoubleValue();
+      if (!(ms >= 0 && ms <= 60000)) {
+        return false;
+      }
+      tap.chunkMs = static_cast<uint32_t>(ms);
+    }
+    taps.push_back(tap);
+  }
+  error.clear();
+  return true;
+}
+
+/**
+ * Read the fields of a capture configuration that startCapture() and prepare() share.
+ * Options only startCapture() understands (delta, sharedMemory, lookback, targets, renditions) are left to it.
+ */
+static bool ReadCaptureConfig(Napi::Env env, const Napi::Object &config, MediaCaptureConfigC &captureConfig,
+                              ImageFormat &imageFormat, std::string &bundleId, std::string &error) {
+  captureConfig = {};
+
+  // Default configuration
+  captureConfig.frameRate       = 1.0f;
+  captureConfig.quality         = 1;            // Medium quality
+  captureConfig.audioSampleRate = 16000;
+  captureConfig.audioChannels   = 1;
+  captureConfig.isElectron      = 0;
+  captureConfig.qualityValue    = 0;            // Use enum-based quality by default
+  captureConfig.imageFormat     = 0;            // JPEG by default
+
+  if (config.Has("frameRate") && config.Get("frameRate").IsNumber()) {
+    captureConfig.frameRate = config.Get("frameRate").As<Napi::Number>().FloatValue();
+  }
+
+  if (config.Has("quality") && config.Get("quality").IsNumber()) {
+    captureConfig.quality = config.Get("quality").As<Napi::Number>().Int32Value();
+  }
+
+  // Support for precise quality value (0-100)
+  if (config.Has("qualityValue") && config.Get("qualityValue").IsNumber()) {
+    int32_t qualityValue = config.Get("qualityValue").As<Napi::Number>().Int32Value();
+    // Ensure value is in range 0-100
+    if (qualityValue >= 0 && qualityValue <= 100) {
+      captureConfig.qualityValue = qualityValue;
+    }
+  }
+
+  // Backends produce JPEG or BGRA; BGRA is converted to the requested raw layout on delivery
+  imageFormat = ImageFormat::Jpeg;
+  if (config.Has("imageFormat") && !config.Get("imageFormat").IsUndefined()) {
+    Napi::Value value = config.Get("imageFormat");
+    if (!value.IsString() || !parseImageFormat(value.As<Napi::String>().Utf8Value(), imageFormat)) {
+      error = "imageFormat must be one of 'jpeg', 'bgra', 'i420', 'nv12' or 'delta'";
+      return false;
+    }
+  }
+  captureConfig.imageFormat = (imageFormat == ImageFormat::Jpeg) ? 0 : 1;
+
+  if (config.Has("audioSampleRate") && config.Get("audioSampleRate").IsNumber()) {
+    captureConfig.audioSampleRate = config.Get("audioSampleRate").As<Napi::Number>().Int32Value();
+  }
+
+  if (config.Has("audioChannels") && config.Get("audioChannels").IsNumber()) {
+    captureConfig.audioChannels = config.Get("audioChannels").As<Napi::Number>().Int32Value();
+  }
+
+  // Audio taps share one capture; unless the format is given, it is the highest any tap asks for
+  std::vector<AudioTapConfig> audioTaps;
+  if (config.Has("audioTaps") && !ReadAudioTaps(config.Get("audioTaps"), audioTaps, error)) {
+    return false;
+  }
+  if (!audioTaps.empty()) {
+    AudioTapSet taps;
+    for (const AudioTapConfig &tap : audioTaps) {
+      taps.addTap(tap);
+    }
+    int32_t sampleRate = captureConfig.audioSampleRate;
+    int32_t channels   = captureConfig.audioChannels;
+    taps.preferredCaptureFormat(sampleRate, channels);
+    if (!config.Has("audioSampleRate")) {
+      captureConfig.audioSampleRate = sampleRate;
+    }
+    if (!config.Has("audioChannels")) {
+      captureConfig.audioChannels = channels;
+    }
+  }
+
+  if (config.Has("displayId") && config.Get("displayId").IsNumber()) {
+    captureConfig.displayID = config.Get("displayId").As<Napi::Number>().Uint32Value();
+  }
+
+  if (config.Has("windowId") && config.Get("windowId").IsNumber()) {
+    captureConfig.windowID = config.Get("windowId").As<Napi::Number>().Uint32Value();
+  }
+
+  // Adaptive quality budgets and the bounds the controller may move within
+  auto readFloat = [&config](const char *name, float &target) {
+    if (config.Has(name) && config.Get(name).IsNumber()) {
+      target = std::max(0.0f, config.Get(name).As<Napi::Number>().FloatValue());
     }
   };
+  readFloat("maxEncodeMsPerFrame", captureConfig.maxEncodeMsPerFrame);
+  readFloat("maxBytesPerSecond", captureConfig.maxBytesPerSecond);
+  readFloat("minScale", captureConfig.minScale);
+  readFloat("minFrameRate", captureConfig.minFrameRate);
+  if (config.Has("minQualityValue") && config.Get("minQualityValue").IsNumber()) {
+    captureConfig.minQualityValue =
+        std::min(100, std::max(0, config.Get("minQualityValue").As<Napi::Number>().Int32Value()));
+  }
 
-  auto context = new EnumerateContext{
-      deferred,
-      // Create ThreadSafeFunction to coordinate with Node.js main thread
-      Napi::ThreadSafeFunction::New(
-          env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}), "EnumerateTargetsCallback", 0, 1,
-          [](Napi::Env) {})};
-
-  // Thread-safe callback
-  auto callback = [](MediaCaptureTargetC *targets, int32_t count, char *error, void *ctx) {
-    auto context = static_cast<EnumerateContext *>(ctx);
-
-    if (error) {
-      // Handle error
-      std::string errorMessage(error);
-      context->tsfn.BlockingCall([errorMessage, context](Napi::Env env, Napi::Function) {
-        Napi::HandleScope scope(env);
-        Napi::Error       err = Napi::Error::New(env, errorMessage);
-        context->deferred.Reject(err.Value());
-        delete context;
-      });
+  if (config.Has("cropRect") && !ReadCropRect(config.Get("cropRect"), captureConfig.cropRect)) {
+    error = "cropRect must be an object with x, y, width and height";
+    return false;
+  }
+
+  // The caller points captureConfig.bundleID at bundleId, which outlives the native call
+  if (config.Has("bundleId") && config.Get("bundleId").IsString()) {
+    bundleId = config.Get("bundleId").As<Napi::String>().Utf8Value();
+  }
+
+  if (config.Has("isElectron") && config.Get("isElectron").IsBoolean()) {
+    captureConfig.isElectron = config.Get("isElectron").As<Napi::Boolean>().Value() ? 1 : 0;
+    fprintf(stderr, "DEBUG: isElectron explicitly set to %d\n", captureConfig.isElectron);
+  } else {
+    bool autoDetectedElectron = false;
+    if (env.Global().Has("process")) {
+      Napi::Object process = env.Global().Get("process").ToObject();
+      if (process.Has("versions")) {
+        Napi::Object versions = process.Get("versions").ToObject();
+        autoDetectedElectron = versions.Has("electron");
+      }
+    }
+    captureConfig.isElectron = autoDetectedElectron ? 1 : 0;
+    fprintf(stderr, "DEBUG: isElectron auto-detected as %d\n", captureConfig.isElectron);
+  }
+  return true;
+}
+
+/**
+ * Copy the own properties of a configuration object, so later changes to
+ * the caller's object do not change the stored one.
+ */
+static Napi::Object CopyConfig(Napi::Env env, const Napi::Object &from) {
+  Napi::Object copy = Napi::Object::New(env);
+  Napi::Array  keys = from.GetPropertyNames();
+  for (uint32_t i = 0; i < keys.Length(); i++) {
+    Napi::Value key = keys.Get(i);
+    copy.Set(key, from.Get(key));
+  }
+  return copy;
+}
+
+Napi::Value MediaCapture::Prepare(const Napi::CallbackInfo &info) {
+  Napi::Env               env      = info.Env();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+  if (isCapturing_) {
+    deferred.Reject(Napi::Error::New(env, "Capture already in progress").Value());
+    return deferred.Promise();
+  }
+
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    deferred.Reject(Napi::Error::New(env, "Configuration object required").Value());
+    return deferred.Promise();
+  }
+
+  MediaCaptureConfigC captureConfig;
+  ImageFormat         imageFormat;
+  std::string         bundleId;
+  std::string         configError;
+  if (!ReadCaptureConfig(env, info[0].As<Napi::Object>(), captureConfig, imageFormat, bundleId, configError)) {
+    deferred.Reject(Napi::Error::New(env, configError).Value());
+    return deferred.Promise();
+  }
+  captureConfig.bundleID = bundleId.empty() ? nullptr : const_cast<char *>(bundleId.c_str());
+
+  if (captureConfig.displayID == 0 && captureConfig.windowID == 0 && captureConfig.bundleID == nullptr) {
+    deferred.Reject(
+        Napi::Error::New(env, "No valid capture target specified. Please provide displayId, windowId or bundleId")
+            .Value());
+    return deferred.Promise();
+  }
+
+  auto context       = new PrepareContext(this, deferred);
+  context->self      = Napi::Persistent(info.This().As<Napi::Object>());
+  context->displayID = captureConfig.displayID;
+  context->windowID  = captureConfig.windowID;
+  context->tsfn      = Napi::ThreadSafeFunction::New(
+      env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}), "PrepareCallback", 0, 1);
+
+  prepareMediaCapture(captureHandle_, captureConfig, &MediaCapture::PrepareCallback, context);
+  return deferred.Promise();
+}
+
+void MediaCapture::PrepareCallback(char *error, void *ctx) {
+  auto        context = static_cast<PrepareContext *>(ctx);
+  std::string message = error ? error : "";
+
+  context->tsfn.NonBlockingCall([context, message](Napi::Env env, Napi::Function) {
+    if (message.empty()) {
+      context->instance->startup_.prepared(context->displayID, context->windowID);
+      context->deferred.Resolve(env.Undefined());
     } else {
-      // Success - copy target data
-      std::vector<MediaCaptureTargetC> targetsCopy;
-      for (int i = 0; i < count; i++) {
-        MediaCaptureTargetC target = targets[i];
-
-        // Copy string title and name
-        if (target.title) {
-          target.title = strdup(target.title);
-        }
-        if (target.appName) {
-          target.appName = strdup(target.appName);
+      context->deferred.Reject(Napi::Error::New(env, message).Value());
+    }
+    context->self.Reset();
+    context->tsfn.Release();
+    delete context;
+  });
+}
+
+Napi::Value MediaCapture::StartCapture(const Napi::CallbackInfo &info) {
+  Napi::Env               env      = info.Env();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+  if (isCapturing_) {
+    deferred.Reject(Napi::Error::New(env, "Capture already in progress").Value());
+    return deferred.Promise();
+  }
+
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    deferred.Reject(Napi::Error::New(env, "Configuration object required").Value());
+    return deferred.Promise();
+  }
+
+  Napi::Object config = info[0].As<Napi::Object>();
+
+  MediaCaptureConfigC captureConfig;
+  ImageFormat         imageFormat;
+  std::string         bundleId;
+  std::string         configError;
+  if (!ReadCaptureConfig(env, config, captureConfig, imageFormat, bundleId, configError)) {
+    deferred.Reject(Napi::Error::New(env, configError).Value());
+    return deferred.Promise();
+  }
+  captureConfig.bundleID = bundleId.empty() ? nullptr : const_cast<char *>(bundleId.c_str());
+
+  // Delta frames diff BGRA frames here and compress only the changed tiles
+  std::shared_ptr<DeltaFrameEncoder> deltaEncoder;
+  if (imageFormat == ImageFormat::Delta) {
+    if (!jpegCodecAvailable()) {
+      deferred.Reject(Napi::Error::New(env, "imageFormat 'delta' is not supported on this platform").Value());
+      return deferred.Promise();
+    }
+
+    DeltaEncoderOptions deltaOptions;
+    if (config.Has("keyframeIntervalMs") && config.Get("keyframeIntervalMs").IsNumber()) {
+      deltaOptions.keyframeIntervalMs = config.Get("keyframeIntervalMs").As<Napi::Number>().Int64Value();
+    }
+    if (config.Has("deltaTileSize") && config.Get("deltaTileSize").IsNumber()) {
+      int32_t tileSize = config.Get("deltaTileSize").As<Napi::Number>().Int32Value();
+      if (tileSize >= 16 && tileSize <= 512) {
+        deltaOptions.tileSize = tileSize;
+      }
+    }
+    // Same mapping as the backends: High=90, Medium=75, Low=50 unless qualityValue is set
+    static const int32_t kQualityLevels[] = {90, 75, 50};
+    deltaOptions.quality = captureConfig.qualityValue > 0 ? captureConfig.qualityValue
+                           : (captureConfig.quality >= 0 && captureConfig.quality <= 2)
+                               ? kQualityLevels[captureConfig.quality]
+                               : 75;
+    deltaEncoder = std::make_shared<DeltaFrameEncoder>(deltaOptions);
+  }
+
+  // Published for other processes to map (see include/capture/sharedring.h)
+  std::shared_ptr<SharedRingWriter> sharedRing;
+  if (config.Has("sharedMemory") && !config.Get("sharedMemory").IsUndefined()) {
+    Napi::Value value = config.Get("sharedMemory");
+    if (!value.IsObject() || !value.As<Napi::Object>().Get("name").IsString()) {
+      deferred.Reject(Napi::Error::New(env, "sharedMemory must be an object with a name").Value());
+      return deferred.Promise();
+    }
+    Napi::Object      shm = value.As<Napi::Object>();
+    SharedRingOptions ringOptions;
+    ringOptions.name = shm.Get("name").As<Napi::String>().Utf8Value();
+    auto readCount   = [&shm](const char *name, auto &target) {
+      if (shm.Has(name) && shm.Get(name).IsNumber()) {
+        double count = shm.Get(name).As<Napi::Number>().DoubleValue();
+        target       = static_cast<std::remove_reference_t<decltype(target)>>(std::max(0.0, count));
+      }
+    };
+    readCount("videoSlots", ringOptions.videoSlots);
+    readCount("videoSlotBytes", ringOptions.videoSlotBytes);
+    readCount("audioSlots", ringOptions.audioSlots);
+    readCount("audioSlotBytes", ringOptions.audioSlotBytes);
+
+    sharedRing = std::make_shared<SharedRingWriter>(ringOptions);
+    std::string error;
+    if (!sharedRing->open(error)) {
+      deferred.Reject(Napi::Error::New(env, error).Value());
+      return deferred.Promise();
+    }
+  }
+
+  // Kept natively for snapshot() instead of delivered; the audio share is sized for the configured format
+  std::shared_ptr<LookbackBuffer> lookback;
+  if (config.Has("lookback") && !config.Get("lookback").IsUndefined()) {
+    Napi::Value value = config.Get("lookback");
+    if (!value.IsObject()) {
+      deferred.Reject(Napi::Error::New(env, "lookback must be an object {seconds, maxBytes}").Value());
+      return deferred.Promise();
+    }
+    Napi::Object    object = value.As<Napi::Object>();
+    LookbackOptions lookbackOptions;
+    if (object.Get("seconds").IsNumber()) {
+      lookbackOptions.seconds = std::max(0.0, object.Get("seconds").As<Napi::Number>().DoubleValue());
+    }
+    if (object.Get("maxBytes").IsNumber()) {
+      lookbackOptions.maxBytes =
+          static_cast<uint64_t>(std::max(0.0, object.Get("maxBytes").As<Napi::Number>().DoubleValue()));
+    }
+    lookbackOptions.audioSampleRate = captureConfig.audioSampleRate;
+    lookbackOptions.audioChannels   = captureConfig.audioChannels;
+    lookback                        = std::make_shared<LookbackBuffer>(lookbackOptions);
+  }
+
+  // Several displays or windows captured together; displayId/windowId then only pick the audio source
+  std::vector<MediaCaptureTargetRefC> captureTargets;
+  if (config.Has("targets") && !config.Get("targets").IsUndefined()) {
+    const char *targetsError =
+        "targets must be a non-empty array of {displayId, windowId, cropRect} objects naming a display or window";
+    Napi::Value value = config.Get("targets");
+    if (!value.IsArray() || value.As<Napi::Array>().Length() == 0) {
+      deferred.Reject(Napi::Error::New(env, targetsError).Value());
+      return deferred.Promise();
+    }
+    Napi::Array array = value.As<Napi::Array>();
+    for (uint32_t i = 0; i < array.Length(); i++) {
+      Napi::Value            item   = array.Get(i);
+      MediaCaptureTargetRefC target = {};
+      if (!item.IsObject()) {
+        deferred.Reject(Napi::Error::New(env, targetsError).Value());
+        return deferred.Promise();
+      }
+      Napi::Object object = item.As<Napi::Object>();
+      if (object.Get("displayId").IsNumber()) {
+        target.displayID = object.Get("displayId").As<Napi::Number>().Uint32Value();
+      }
+      if (object.Get("windowId").IsNumber()) {
+        target.windowID = object.Get("windowId").As<Napi::Number>().Uint32Value();
+      }
+      if ((target.displayID == 0 && target.windowID == 0) || !ReadCropRect(object.Get("cropRect"), target.cropRect)) {
+        deferred.Reject(Napi::Error::New(env, targetsError).Value());
+        return deferred.Promise();
+      }
+      captureTargets.push_back(target);
+    }
+    // These consume one frame stream and cannot tell targets apart
+    if (imageFormat == ImageFormat::Delta || sharedRing || lookback || std::atomic_load(&recorder_)) {
+      deferred.Reject(Napi::Error::New(env, "targets cannot be combined with imageFormat 'delta', sharedMemory, "
+                                            "lookback or recording")
+                          .Value());
+      return deferred.Promise();
+    }
+  }
+
+  // One target delivered several times, each rendition with its own rate, size, format and quality
+  std::vector<MediaCaptureRenditionC> captureRenditions;
+  std::vector<ImageFormat>            renditionFormats;
+  if (config.Has("renditions") && !config.Get("renditions").IsUndefined()) {
+    const char *renditionsError = "renditions must be a non-empty array of {frameRate, scale, maxWidth, imageFormat, "
+                                  "quality} objects; imageFormat cannot be 'delta'";
+    Napi::Value value = config.Get("renditions");
+    if (!value.IsArray() || value.As<Napi::Array>().Length() == 0) {
+      deferred.Reject(Napi::Error::New(env, renditionsError).Value());
+      return deferred.Promise();
+    }
+    Napi::Array array = value.As<Napi::Array>();
+    for (uint32_t i = 0; i < array.Length(); i++) {
+      Napi::Value            item      = array.Get(i);
+      MediaCaptureRenditionC rendition = {};
+      ImageFormat            format    = imageFormat; // Renditions default to the session's format
+      if (!item.IsObject()) {
+        deferred.Reject(Napi::Error::New(env, renditionsError).Value());
+        return deferred.Promise();
+      }
+      Napi::Object object = item.As<Napi::Object>();
+      if (object.Get("frameRate").IsNumber()) {
+        rendition.frameRate = std::max(0.0f, object.Get("frameRate").As<Napi::Number>().FloatValue());
+      }
+      if (object.Get("scale").IsNumber()) {
+        rendition.scale = std::min(1.0f, std::max(0.0f, object.Get("scale").As<Napi::Number>().FloatValue()));
+      }
+      if (object.Get("maxWidth").IsNumber()) {
+        rendition.maxWidth = std::max(0, object.Get("maxWidth").As<Napi::Number>().Int32Value());
+      }
+      if (object.Get("quality").IsNumber()) {
+        rendition.quality = std::min(100, std::max(0, object.Get("quality").As<Napi::Number>().Int32Value()));
+      }
+      Napi::Value formatValue = object.Get("imageFormat");
+      if (!formatValue.IsUndefined() &&
+          (!formatValue.IsString() || !parseImageFormat(formatValue.As<Napi::String>().Utf8Value(), format) ||
+           format == ImageFormat::Delta)) {
+        deferred.Reject(Napi::Error::New(env, renditionsError).Value());
+        return deferred.Promise();
+      }
+      rendition.imageFormat = format == ImageFormat::Jpeg ? 0 : 1;
+      captureRenditions.push_back(rendition);
+      renditionFormats.push_back(format);
+    }
+    // Each rendition is a frame stream of its own, unlike what these expect
+    if (!captureTargets.empty() || imageFormat == ImageFormat::Delta || sharedRing || lookback ||
+        std::atomic_load(&recorder_)) {
+      deferred.Reject(Napi::Error::New(env, "renditions cannot be combined with targets, imageFormat 'delta', "
+                                            "sharedMemory, lookback or recording")
+                          .Value());
+      return deferred.Promise();
+    }
+  }
+
+  // Several audio formats from one capture; ReadCaptureConfig has validated them
+  std::shared_ptr<AudioTapSet> audioTaps;
+  std::vector<AudioTapConfig>  tapConfigs;
+  if (config.Has("audioTaps") && ReadAudioTaps(config.Get("audioTaps"), tapConfigs, configError) &&
+      !tapConfigs.empty()) {
+    audioTaps = std::make_shared<AudioTapSet>();
+    for (const AudioTapConfig &tap : tapConfigs) {
+      audioTaps->addTap(tap);
+    }
+  }
+
+  if (captureConfig.displayID == 0 && captureConfig.windowID == 0 && captureConfig.bundleID == nullptr &&
+      captureTargets.empty()) {
+    deferred.Reject(
+        Napi::Error::New(
+            env, "No valid capture target specified. Please provide displayId, windowId, bundleId or targets")
+            .Value());
+    return deferred.Promise();
+  }
+
+  auto context = new CaptureContext{this, deferred};
+
+  this->tsfn_video_ = Napi::ThreadSafeFunction::New(
+      env, info.This().As<Napi::Object>().Get("emit").As<Napi::Function>(), "VideoFrameCallback", 8, 1, this,
+      [](Napi::Env env, void *finalizeData, MediaCapture *context) {
+        fprintf(stderr, "DEBUG: Video TSFN finalized\n");
+      },
+      context);
+
+  this->tsfn_audio_ = Napi::ThreadSafeFunction::New(
+      env, info.This().As<Napi::Object>().Get("emit").As<Napi::Function>(), "AudioEmitter", 0, 1,
+      [this](Napi::Env) { this->tsfn_audio_ = nullptr; });
+
+  this->tsfn_error_ = Napi::ThreadSafeFunction::New(
+      env, info.This().As<Napi::Object>().Get("emit").As<Napi::Function>(), "ErrorEmitter", 0, 1,
+      [this](Napi::Env) { this->tsfn_error_ = nullptr; });
+
+  imageFormat_ = imageFormat;
+  deliveryStats_->reset();
+  // An iterator opened before the capture keeps its gate
+  if (!videoPull_->open) {
+    videoGate_->reset();
+  }
+  if (!audioPull_->open) {
+    audioGate_->reset();
+  }
+  if (config.Has("trace") && config.Get("trace").IsBoolean() && config.Get("trace").As<Napi::Boolean>().Value()) {
+    setCaptureTraceEnabled(true);
+    tracing_ = true;
+  }
+  std::atomic_store(&deltaEncoder_, deltaEncoder);
+  std::atomic_store(&sharedRing_, sharedRing);
+  std::atomic_store(&lookback_, lookback);
+  std::atomic_store(&audioTaps_, audioTaps);
+  captureTargets_        = std::move(captureTargets);
+  captureConfig_         = Napi::Persistent(CopyConfig(env, config));
+  parsedConfig_          = captureConfig;
+  parsedConfig_.bundleID = nullptr;
+  bundleId_              = bundleId;
+  startup_.begin(captureConfig.displayID, captureConfig.windowID);
+  isCapturing_    = true;
+
+  context->renditionFormats = std::move(renditionFormats);
+  if (!captureTargets_.empty()) {
+    startMultiTargetMediaCapture(
+        captureHandle_, captureConfig, captureTargets_.data(), static_cast<int32_t>(captureTargets_.size()),
+        &MediaCapture::TargetVideoFrameCallback, &MediaCapture::AudioDataCallback, &MediaCapture::ExitCallback,
+        context);
+  } else if (!captureRenditions.empty()) {
+    startMultiRenditionMediaCapture(
+        captureHandle_, captureConfig, captureRenditions.data(), static_cast<int32_t>(captureRenditions.size()),
+        &MediaCapture::RenditionVideoFrameCallback, &MediaCapture::AudioDataCallback, &MediaCapture::ExitCallback,
+        context);
+  } else {
+    startMediaCapture(
+        captureHandle_, captureConfig, &MediaCapture::VideoFrameCallback, &MediaCapture::AudioDataCallback,
+        &MediaCapture::ExitCallback, context);
+  }
+
+  deferred.Resolve(env.Undefined());
+  return deferred.Promise();
+}
+
+Napi::Value MediaCapture::StartRecording(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  auto reject = [&](const std::string &message) {
+    deferred.Reject(Napi::Error::New(env, message).Value());
+    return deferred.Promise();
+  };
+
+  if (isCapturing_) {
+    return reject("Capture already in progress");
+  }
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    return reject("Recording options object required");
+  }
+
+  Napi::Object     options = info[0].As<Napi::Object>();
+  RecordingOptions recordingOptions;
+
+  if (!options.Has("dir") || !options.Get("dir").IsString()) {
+    return reject("dir must be the directory to record into");
+  }
+  recordingOptions.dir = options.Get("dir").As<Napi::String>().Utf8Value();
+
+  if (options.Has("audio") && !options.Get("audio").IsUndefined()) {
+    Napi::Value value = options.Get("audio");
+    if (!value.IsString() || !parseRecordingAudioFormat(value.As<Napi::String>().Utf8Value(), recordingOptions.audio)) {
+      return reject("audio must be one of 'wav', 'raw' or 'none'");
+    }
+  }
+  if (options.Has("video") && !options.Get("video").IsUndefined()) {
+    Napi::Value value = options.Get("video");
+    if (!value.IsString() || !parseRecordingVideoFormat(value.As<Napi::String>().Utf8Value(), recordingOptions.video)) {
+      return reject("video must be one of 'mjpeg', 'frames' or 'none'");
+    }
+  }
+  if (options.Has("segmentBytes") && options.Get("segmentBytes").IsNumber()) {
+    recordingOptions.segmentBytes =
+        static_cast<uint64_t>(std::max(0.0, options.Get("segmentBytes").As<Napi::Number>().DoubleValue()));
+  }
+  if (options.Has("segmentSeconds") && options.Get("segmentSeconds").IsNumber()) {
+    recordingOptions.segmentSeconds = std::max(0.0, options.Get("segmentSeconds").As<Napi::Number>().DoubleValue());
+  }
+
+  // The sink stores what the backend produces: MJPEG needs JPEG frames, 'frames' also takes BGRA
+  if (options.Has("imageFormat") && !options.Get("imageFormat").IsUndefined()) {
+    Napi::Value value  = options.Get("imageFormat");
+    std::string format = value.IsString() ? value.As<Napi::String>().Utf8Value() : "";
+    bool        bgraOk = recordingOptions.video != RecordingVideoFormat::Mjpeg;
+    if (format != "jpeg" && !(format == "bgra" && bgraOk)) {
+      return reject(bgraOk ? "imageFormat must be 'jpeg' or 'bgra' when recording"
+                           : "imageFormat must be 'jpeg' when recording video as 'mjpeg'");
+    }
+  }
+
+  auto        recorder = std::make_shared<RecordingSink>(recordingOptions);
+  std::string error;
+  if (!recorder->open(error)) {
+    return reject(error);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lastRecordingStats_ = RecordingStats();
+    hasRecorded_        = true;
+    recordingError_.clear();
+  }
+  std::atomic_store(&recorder_, recorder);
+
+  Napi::Value result = StartCapture(info);
+  if (!isCapturing_.load()) {
+    // StartCapture rejected the configuration; leave no half-open recording behind
+    std::atomic_store(&recorder_, std::shared_ptr<RecordingSink>());
+    recorder->close(error);
+  }
+  return result;
+}
+
+void MediaCapture::FinishRecording() {
+  std::shared_ptr<RecordingSink> recorder = std::atomic_exchange(&recorder_, std::shared_ptr<RecordingSink>());
+  if (!recorder) {
+    return;
+  }
+
+  std::string error;
+  bool        closed = recorder->close(error);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  lastRecordingStats_ = recorder->stats();
+  if (!closed) {
+    recordingError_ = error;
+  }
+}
+
+/**
+ * Snapshot media in one ArrayBuffer (external buffers are disabled, so it is copied once more here),
+ * with the audio and each frame as views into it.
+ */
+static Napi::Object SnapshotObject(Napi::Env env, const LookbackSnapshot &snapshot) {
+  Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, snapshot.data.size());
+  if (!snapshot.data.empty()) {
+    std::memcpy(buffer.Data(), snapshot.data.data(), snapshot.data.size());
+  }
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("buffer", buffer);
+  if (snapshot.audioFrames > 0) {
+    size_t       samples = static_cast<size_t>(snapshot.audioFrames) * snapshot.channels;
+    Napi::Object audio   = Napi::Object::New(env);
+    audio.Set("data", Napi::Float32Array::New(env, samples, buffer, 0));
+    audio.Set("sampleRate", Napi::Number::New(env, snapshot.sampleRate));
+    audio.Set("channels", Napi::Number::New(env, snapshot.channels));
+    audio.Set("timestamp", Napi::Number::New(env, static_cast<double>(snapshot.audioStartMs)));
+    result.Set("audio", audio);
+  } else {
+    result.Set("audio", env.Null());
+  }
+
+  Napi::Array frames = Napi::Array::New(env, snapshot.frames.size());
+  for (size_t i = 0; i < snapshot.frames.size(); i++) {
+    const LookbackFrame &frame  = snapshot.frames[i];
+    Napi::Object         object = Napi::Object::New(env);
+    object.Set("data", Napi::Uint8Array::New(env, frame.size, buffer, frame.offset));
+    object.Set("width", Napi::Number::New(env, frame.width));
+    object.Set("height", Napi::Number::New(env, frame.height));
+    object.Set("bytesPerRow", Napi::Number::New(env, frame.bytesPerRow));
+    object.Set("timestamp", Napi::Number::New(env, static_cast<double>(frame.timestampMs)));
+    object.Set("format", Napi::String::New(env, frame.jpeg ? "jpeg" : "bgra"));
+    frames[i] = object;
+  }
+  result.Set("frames", frames);
+  return result;
+}
+
+Napi::Value MediaCapture::Snapshot(const Napi::CallbackInfo &info) {
+  Napi::Env               env      = info.Env();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  auto                    reject   = [&](const std::string &message) {
+    deferred.Reject(Napi::Error::New(env, message).Value());
+    return deferred.Promise();
+  };
+
+  std::shared_ptr<LookbackBuffer> lookback = std::atomic_load(&lookback_);
+  if (!lookback) {
+    return reject("No look-back buffer; start the capture with the lookback option");
+  }
+
+  // Everything the buffer holds unless seconds says otherwise
+  double      seconds = std::numeric_limits<double>::infinity();
+  std::string dir;
+  if (info.Length() > 0 && info[0].IsObject()) {
+    Napi::Object options = info[0].As<Napi::Object>();
+    Napi::Value  value   = options.Get("seconds");
+    if (!value.IsUndefined()) {
+      if (!value.IsNumber() || value.As<Napi::Number>().DoubleValue() < 0) {
+        return reject("seconds must be a non-negative number");
+      }
+      seconds = value.As<Napi::Number>().DoubleValue();
+    }
+    value = options.Get("dir");
+    if (!value.IsUndefined()) {
+      if (!value.IsString() || value.As<Napi::String>().Utf8Value().empty()) {
+        return reject("dir must be the directory to write the snapshot into");
+      }
+      dir = value.As<Napi::String>().Utf8Value();
+    }
+  }
+
+  auto context      = new SnapshotContext(this, deferred);
+  context->lookback = lookback;
+  context->seconds  = seconds;
+  context->dir      = dir;
+  context->tsfn     = Napi::ThreadSafeFunction::New(
+      env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}), "SnapshotCallback", 0, 1,
+      [context](Napi::Env env) {
+        // Runs once the worker is done with the function, or when the environment shuts down
+        AddonData::Get(env)->snapshots.erase(context);
+        if (context->worker.joinable()) {
+          context->worker.join();
         }
+        delete context;
+      });
+  AddonData::Get(env)->snapshots.insert(context);
+
+  // Copying a large buffer and writing it out would stall the JavaScript thread
+  context->worker = std::thread([context]() {
+    context->lookback->snapshot(context->seconds, context->snapshot);
+    if (!context->dir.empty() && !writeLookbackSnapshot(context->snapshot, context->dir, context->error) &&
+        context->error.empty()) {
+      context->error = "Failed to write the snapshot to " + context->dir;
+    }
+
+    napi_status status = context->tsfn.NonBlockingCall([context](Napi::Env env, Napi::Function) {
+      if (!context->error.empty()) {
+        context->deferred.Reject(Napi::Error::New(env, context->error).Value());
+      } else if (!context->dir.empty()) {
+        context->deferred.Resolve(Napi::String::New(env, context->dir));
+      } else {
+        context->deferred.Resolve(SnapshotObject(env, context->snapshot));
+      }
+    });
+    // A function that is closing refuses the call and drops this thread by itself
+    if (status == napi_ok) {
+      context->tsfn.Release();
+    }
+  });
+  return deferred.Promise();
+}
+
+void MediaCapture::CloseSharedRing() {
+  std::shared_ptr<SharedRingWriter> sharedRing =
+      std::atomic_exchange(&sharedRing_, std::shared_ptr<SharedRingWriter>());
+  if (sharedRing) {
+    sharedRing->close();
+  }
+}
+
+Napi::Value MediaCapture::Reconfigure(const Napi::CallbackInfo &info) {
+  Napi::Env               env      = info.Env();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  auto                    reject   = [&](const std::string &message) {
+    deferred.Reject(Napi::Error::New(env, message).Value());
+    return deferred.Promise();
+  };
+
+  if (!isCapturing_ || captureConfig_.IsEmpty()) {
+    return reject("No capture in progress");
+  }
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    return reject("Configuration object required");
+  }
+
+  // These set up delivery paths at start; changing them needs a new capture
+  Napi::Object changes = info[0].As<Napi::Object>();
+  for (const char *key : {"targets", "renditions", "audioTaps", "sharedMemory", "lookback", "trace",
+                          "keyframeIntervalMs", "deltaTileSize"}) {
+    if (changes.Has(key)) {
+      return reject(std::string(key) + " cannot be changed while capturing; stop and start again");
+    }
+  }
+
+  Napi::Object merged = CopyConfig(env, captureConfig_.Value());
+  Napi::Array  keys   = changes.GetPropertyNames();
+  for (uint32_t i = 0; i < keys.Length(); i++) {
+    Napi::Value key = keys.Get(i);
+    merged.Set(key, changes.Get(key));
+  }
 
-        targetsCopy.push_back(target);
+  MediaCaptureConfigC captureConfig;
+  ImageFormat         imageFormat;
+  std::string         bundleId;
+  std::string         configError;
+  if (!ReadCaptureConfig(env, merged, captureConfig, imageFormat, bundleId, configError)) {
+    return reject(configError);
+  }
+  captureConfig.bundleID = bundleId.empty() ? nullptr : const_cast<char *>(bundleId.c_str());
+
+  // The delta encoder is created with the capture, and a recording keeps the format it opened with
+  if ((imageFormat == ImageFormat::Delta) != (imageFormat_.load() == ImageFormat::Delta)) {
+    return reject("imageFormat cannot be changed to or from 'delta' while capturing");
+  }
+  if (std::atomic_load(&recorder_) && imageFormat != imageFormat_.load()) {
+    return reject("imageFormat cannot be changed while recording");
+  }
+
+  auto context             = new ReconfigureContext(this, deferred);
+  context->self            = Napi::Persistent(info.This().As<Napi::Object>());
+  context->config          = Napi::Persistent(merged);
+  context->parsed          = captureConfig;
+  context->parsed.bundleID = nullptr;
+  context->bundleId        = bundleId;
+  context->imageFormat     = imageFormat;
+  context->targetChanged   = captureConfig.displayID != parsedConfig_.displayID ||
+                             captureConfig.windowID != parsedConfig_.windowID || bundleId != bundleId_;
+  context->displayID       = captureConfig.displayID;
+  context->windowID        = captureConfig.windowID;
+  context->tsfn            = Napi::ThreadSafeFunction::New(
+      env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}), "ReconfigureCallback", 0, 1);
+
+  reconfigureMediaCapture(captureHandle_, captureConfig, &MediaCapture::ReconfigureCallback, context);
+  return deferred.Promise();
+}
+
+void MediaCapture::ReconfigureCallback(char *error, void *ctx) {
+  auto        context = static_cast<ReconfigureContext *>(ctx);
+  std::string message = error ? error : "";
+
+  context->tsfn.NonBlockingCall([context, message](Napi::Env env, Napi::Function) {
+    MediaCapture *instance = context->instance;
+    if (message.empty()) {
+      instance->captureConfig_ = Napi::Persistent(context->config.Value());
+      instance->parsedConfig_  = context->parsed;
+      instance->bundleId_      = context->bundleId;
+      instance->imageFormat_   = context->imageFormat;
+      if (context->targetChanged) {
+        instance->startup_.begin(context->displayID, context->windowID);
       }
+      context->deferred.Resolve(env.Undefined());
+    } else {
+      context->deferred.Reject(Napi::Error::New(env, message).Value());
+    }
+    context->config.Reset();
+    context->self.Reset();
+    context->tsfn.Release();
+    delete context;
+  });
+}
+
+Napi::Value MediaCapture::SetCropRect(const Napi::CallbackInfo &info) {
+  Napi::Env               env      = info.Env();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+  MediaCaptureRectC cropRect;
+  if (!ReadCropRect(info.Length() > 0 ? info[0] : env.Undefined(), cropRect)) {
+    deferred.Reject(
+        Napi::TypeError::New(env, "cropRect must be an object with x, y, width and height, or null").Value());
+    return deferred.Promise();
+  }
+
+  Napi::Value value = info.Length() > 0 && info[0].IsObject() ? info[0] : env.Null();
+  if (!captureHandle_) {
+    RememberCropRect(cropRect, value);
+    deferred.Resolve(env.Undefined());
+    return deferred.Promise();
+  }
+
+  auto context      = new CropRectContext(this, deferred);
+  context->self     = Napi::Persistent(info.This().As<Napi::Object>());
+  context->cropRect = cropRect;
+  if (value.IsObject()) {
+    context->value = Napi::Persistent(value.As<Napi::Object>());
+  }
+  context->tsfn = Napi::ThreadSafeFunction::New(
+      env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}), "CropRectCallback", 0, 1);
+
+  setMediaCaptureCropRect(captureHandle_, cropRect, &MediaCapture::CropRectCallback, context);
+  return deferred.Promise();
+}
+
+void MediaCapture::CropRectCallback(char *error, void *ctx) {
+  auto        context = static_cast<CropRectContext *>(ctx);
+  std::string message = error ? error : "";
+
+  context->tsfn.NonBlockingCall([context, message](Napi::Env env, Napi::Function) {
+    if (message.empty()) {
+      context->instance->RememberCropRect(
+          context->cropRect, context->value.IsEmpty() ? env.Null() : context->value.Value());
+      context->deferred.Resolve(env.Undefined());
+    } else {
+      context->deferred.Reject(Napi::Error::New(env, message).Value());
+    }
+    context->value.Reset();
+    context->self.Reset();
+    context->tsfn.Release();
+    delete context;
+  });
+}
+
+void MediaCapture::RememberCropRect(const MediaCaptureRectC &cropRect, Napi::Value value) {
+  // A later reconfigure() keeps this crop unless it changes it
+  if (!captureConfig_.IsEmpty()) {
+    captureConfig_.Value().Set("cropRect", value);
+    parsedConfig_.cropRect = cropRect;
+  }
+}
 
-      context->tsfn.BlockingCall([targetsCopy, context](Napi::Env env, Napi::Function) {
-        Napi::HandleScope scope(env);
+static const char *QualityAdjustmentName(int32_t adjustment) {
+  static const char *const names[] = {
+      "none", "lower-quality", "lower-scale", "lower-frame-rate", "raise-quality", "raise-scale", "raise-frame-rate"};
+  return (adjustment >= 0 && adjustment < 7) ? names[adjustment] : "none";
+}
 
-        Napi::Array result = Napi::Array::New(env, targetsCopy.size());
+static const char *QualityPressureName(int32_t pressure) {
+  static const char *const names[] = {"none", "encode-time", "bandwidth", "backlog"};
+  return (pressure >= 0 && pressure < 4) ? names[pressure] : "none";
+}
 
-        for (size_t i = 0; i < targetsCopy.size(); i++) {
-          const auto &target = targetsCopy[i];
+Napi::Value MediaCapture::GetQualityStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
 
-          Napi::Object obj = Napi::Object::New(env);
-          obj.Set("isDisplay", Napi::Boolean::New(env, target.isDisplay == 1));
-          obj.Set("isWindow", Napi::Boolean::New(env, target.isWindow == 1));
-          obj.Set("displayId", Napi::Number::New(env, target.displayID));
-          obj.Set("windowId", Napi::Number::New(env, target.windowID));
-          obj.Set("width", Napi::Number::New(env, target.width));
-          obj.Set("height", Napi::Number::New(env, target.height));
+  MediaCaptureQualityStatsC stats = {};
+  if (!captureHandle_ || !isCapturing_.load() || getMediaCaptureQualityStats(captureHandle_, &stats) == 0) {
+    return env.Null();
+  }
 
-          if (target.title) {
-            obj.Set("title", Napi::String::New(env, target.title));
-            free(target.title);
-          }
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("quality", Napi::Number::New(env, stats.quality));
+  result.Set("scale", Napi::Number::New(env, stats.scale));
+  result.Set("frameRate", Napi::Number::New(env, stats.frameRate));
+  result.Set("encodeMs", Napi::Number::New(env, stats.encodeMs));
+  result.Set("bytesPerSecond", Napi::Number::New(env, stats.bytesPerSecond));
+  result.Set("queueDepth", Napi::Number::New(env, stats.queueDepth));
+  result.Set("downgrades", Napi::Number::New(env, static_cast<double>(stats.downgrades)));
+  result.Set("upgrades", Napi::Number::New(env, static_cast<double>(stats.upgrades)));
+  result.Set("lastAdjustment", Napi::String::New(env, QualityAdjustmentName(stats.lastAdjustment)));
+  result.Set("lastPressure", Napi::String::New(env, QualityPressureName(stats.lastPressure)));
+  return result;
+}
 
-          if (target.appName) {
-            obj.Set("applicationName", Napi::String::New(env, target.appName));
-            free(target.appName);
-          }
+Napi::Object StageStatsObject(Napi::Env env, const MediaCaptureStageStatsC &stage) {
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("count", Napi::Number::New(env, static_cast<double>(stage.count)));
+  result.Set("meanMs", Napi::Number::New(env, stage.meanMs));
+  result.Set("maxMs", Napi::Number::New(env, stage.maxMs));
+  result.Set("p50Ms", Napi::Number::New(env, stage.p50Ms));
+  result.Set("p90Ms", Napi::Number::New(env, stage.p90Ms));
+  result.Set("p99Ms", Napi::Number::New(env, stage.p99Ms));
+  result.Set("p999Ms", Napi::Number::New(env, stage.p999Ms));
+  return result;
+}
 
-          Napi::Object frame = Napi::Object::New(env);
-          frame.Set("width", Napi::Number::New(env, target.width));
-          frame.Set("height", Napi::Number::New(env, target.height));
-          obj.Set("frame", frame);
+Napi::Object StageStatsObject(Napi::Env env, const StageTiming &timing) {
+  MediaCaptureStageStatsC stage;
+  exportStageStats(timing.snapshot(), stage);
+  return StageStatsObject(env, stage);
+}
 
-          result[i] = obj;
-        }
+Napi::Value MediaCapture::GetStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
 
-        context->deferred.Resolve(result);
-        delete context;
-      });
+  MediaCaptureStatsC stats;
+  std::memset(&stats, 0, sizeof(stats));
+  if (captureHandle_ && isCapturing_.load()) {
+    getMediaCaptureStats(captureHandle_, &stats);
+  }
+  const DeliveryStats &delivery = *deliveryStats_;
+
+  auto count = [&env](uint64_t value) { return Napi::Number::New(env, static_cast<double>(value)); };
+
+  Napi::Object videoStages = Napi::Object::New(env);
+  videoStages.Set("acquire", StageStatsObject(env, stats.acquire));
+  videoStages.Set("copy", StageStatsObject(env, stats.copy));
+  videoStages.Set("queueWait", StageStatsObject(env, stats.queueWait));
+  videoStages.Set("encode", StageStatsObject(env, stats.encode));
+  videoStages.Set("deliver", StageStatsObject(env, stats.videoDeliver));
+  videoStages.Set("jsDispatch", StageStatsObject(env, delivery.videoDispatch));
+  videoStages.Set("captureToJs", StageStatsObject(env, delivery.captureToJs));
+
+  Napi::Object video = Napi::Object::New(env);
+  video.Set("framesCaptured", count(stats.framesCaptured));
+  video.Set("framesDelivered", count(stats.framesDelivered));
+  video.Set("framesDropped", count(stats.framesDropped));
+  video.Set("encodeFailures", count(stats.encodeFailures));
+  video.Set("acquireFailures", count(stats.acquireFailures));
+  video.Set("bytes", count(stats.videoBytes));
+  video.Set("queueDepth", Napi::Number::New(env, stats.queueDepth));
+  video.Set("jsDelivered", count(delivery.videoDelivered.load()));
+  video.Set("jsDropped", count(delivery.videoDropped.load()));
+  video.Set("stages", videoStages);
+
+  Napi::Object audioStages = Napi::Object::New(env);
+  audioStages.Set("acquire", StageStatsObject(env, stats.audioAcquire));
+  audioStages.Set("downmix", StageStatsObject(env, stats.downmix));
+  audioStages.Set("resample", StageStatsObject(env, stats.resample));
+  audioStages.Set("deliver", StageStatsObject(env, stats.audioDeliver));
+  audioStages.Set("jsDispatch", StageStatsObject(env, delivery.audioDispatch));
+
+  Napi::Object audio = Napi::Object::New(env);
+  audio.Set("packets", count(stats.audioPackets));
+  audio.Set("frames", count(stats.audioFrames));
+  audio.Set("dropped", count(stats.audioDropped));
+  audio.Set("jsDelivered", count(delivery.audioDelivered.load()));
+  audio.Set("jsDropped", count(delivery.audioDropped.load()));
+  audio.Set("stages", audioStages);
+
+  // The last recording stays visible after it stops; null if this instance never recorded
+  Napi::Value recording = env.Null();
+  {
+    std::shared_ptr<RecordingSink> recorder = std::atomic_load(&recorder_);
+    std::lock_guard<std::mutex>    lock(mutex_);
+    if (recorder) {
+      lastRecordingStats_ = recorder->stats();
     }
-  };
-
-  // Call native enumerate function
-  enumerateMediaCaptureTargets(targetType, callback, context);
+    if (hasRecorded_) {
+      Napi::Object recordingStats = Napi::Object::New(env);
+      recordingStats.Set("videoFrames", count(lastRecordingStats_.videoFrames));
+      recordingStats.Set("audioFrames", count(lastRecordingStats_.audioFrames));
+      recordingStats.Set("bytesWritten", count(lastRecordingStats_.bytesWritten));
+      recordingStats.Set("droppedChunks", count(lastRecordingStats_.droppedChunks));
+      recordingStats.Set("segments", count(lastRecordingStats_.segments));
+      recording = recordingStats;
+    }
+  }
 
-  return deferred.Promise();
+  // Times of the last start; null until its first frame or audio block arrives
+  StartupSnapshot startupTiming = startup_.snapshot();
+  auto            milliseconds  = [&env](double value) -> Napi::Value {
+    return value >= 0 ? Napi::Number::New(env, value) : env.Null();
+  };
+  Napi::Object startup = Napi::Object::New(env);
+  startup.Set("prepared", Napi::Boolean::New(env, startupTiming.prepared));
+  startup.Set("firstFrameMs", milliseconds(startupTiming.firstFrameMs));
+  startup.Set("firstAudioMs", milliseconds(startupTiming.firstAudioMs));
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("video", video);
+  result.Set("audio", audio);
+  result.Set("recording", recording);
+  result.Set("startup", startup);
+  return result;
 }
 
-Napi::Value MediaCapture::StartCapture(const Napi::CallbackInfo &info) {
-  Napi::Env               env      = info.Env();
-  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+Napi::Value MediaCapture::DumpTrace(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
 
-  if (isCapturing_) {
-    deferred.Reject(Napi::Error::New(env, "Capture already in progress").Value());
-    return deferred.Promise();
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "dumpTrace expects a file path").ThrowAsJavaScriptException();
+    return env.Undefined();
   }
 
-  if (info.Length() < 1 || !info[0].IsObject()) {
-    deferred.Reject(Napi::Error::New(env, "Configuration object required").Value());
-    return deferred.Promise();
+  std::string path = info[0].As<Napi::String>().Utf8Value();
+  std::string error;
+  if (!writeCaptureTraceFile(path.c_str(), error)) {
+    Napi::Error::New(env, error).ThrowAsJavaScriptException();
   }
+  return env.Undefined();
+}
 
-  Napi::Object config = info[0].As<Napi::Object>();
+/**
+ * @brief Read the track argument of pauseDelivery/resumeDelivery; throws and returns false if it is invalid
+ */
+static bool ParseDeliveryTrack(const Napi::CallbackInfo &info, const char *method, bool &video) {
+  std::string track = info.Length() > 0 && info[0].IsString() ? info[0].As<Napi::String>().Utf8Value() : "";
+  if (track != "video" && track != "audio") {
+    Napi::TypeError::New(info.Env(), std::string(method) + " expects \"video\" or \"audio\"")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+  video = track == "video";
+  return true;
+}
 
-  MediaCaptureConfigC captureConfig = {};
+/**
+ * @brief Run a drain after the calls already queued on a thread-safe function
+ *
+ * Falls back to draining immediately when nothing can be queued (capture
+ * stopped, or the bounded video queue is full).
+ */
+template <typename Drain>
+static void DrainAfterQueued(const Napi::CallbackInfo &info, Napi::ThreadSafeFunction &tsfn, Drain drain) {
+  if (tsfn && tsfn.NonBlockingCall(drain) == napi_ok) {
+    return;
+  }
+  drain(info.Env(), info.This().As<Napi::Object>().Get("emit").As<Napi::Function>());
+}
 
-  // Default configuration
-  captureConfig.frameRate       = 1.0f;
-  captureConfig.quality         = 1;            // Medium quality
-  captureConfig.audioSampleRate = 16000;
-  captureConfig.audioChannels   = 1;
-  captureConfig.isElectron      = 0;
-  captureConfig.qualityValue    = 0;            // Use enum-based quality by default
-  captureConfig.imageFormat     = 0;            // JPEG by default
+/**
+ * @brief Read {buffer, overflow} for pauseDelivery/openPull; throws and returns false if they are invalid
+ */
+static bool ParseDeliveryOptions(const Napi::CallbackInfo &info, bool video, size_t &capacity,
+                                 OverflowPolicy &policy) {
+  // Live video keeps the latest frames and gapless audio keeps the earliest samples by default
+  capacity = video ? 4 : 64;
+  policy   = video ? OverflowPolicy::DropOldest : OverflowPolicy::DropNewest;
+  if (info.Length() < 2 || !info[1].IsObject()) {
+    return true;
+  }
 
-  if (config.Has("frameRate") && config.Get("frameRate").IsNumber()) {
-    captureConfig.frameRate = config.Get("frameRate").As<Napi::Number>().FloatValue();
+  Napi::Env    env     = info.Env();
+  Napi::Object options = info[1].As<Napi::Object>();
+  if (options.Has("buffer") && options.Get("buffer").IsNumber()) {
+    int64_t buffer = options.Get("buffer").As<Napi::Number>().Int64Value();
+    if (buffer < 0) {
+      Napi::RangeError::New(env, "buffer must not be negative").ThrowAsJavaScriptException();
+      return false;
+    }
+    capacity = static_cast<size_t>(buffer);
   }
+  if (options.Has("overflow") && options.Get("overflow").IsString() &&
+      !parseOverflowPolicy(options.Get("overflow").As<Napi::String>().Utf8Value(), policy)) {
+    Napi::TypeError::New(env, "overflow must be \"drop-oldest\" or \"drop-newest\"").ThrowAsJavaScriptException();
+    return false;
+  }
+  return true;
+}
 
-  if (config.Has("quality") && config.Get("quality").IsNumber()) {
-    captureConfig.quality = config.Get("quality").As<Napi::Number>().Int32Value();
+/**
+ * @brief Take the items held for an iterator as a JavaScript array, or arm a wake-up and return null
+ */
+template <typename T, typename ToObject>
+static Napi::Value TakeForPull(Napi::Env env, DeliveryGate<T> &gate, ToObject toObject) {
+  std::deque<T> held;
+  if (!gate.takeOrArm(held)) {
+    return env.Null();
   }
+  Napi::Array items = Napi::Array::New(env, held.size());
+  for (size_t i = 0; i < held.size(); i++) {
+    items[i] = toObject(held[i]);
+  }
+  return items;
+}
 
-  // Support for precise quality value (0-100)
-  if (config.Has("qualityValue") && config.Get("qualityValue").IsNumber()) {
-    int32_t qualityValue = config.Get("qualityValue").As<Napi::Number>().Int32Value();
-    // Ensure value is in range 0-100
-    if (qualityValue >= 0 && qualityValue <= 100) {
-      captureConfig.qualityValue = qualityValue;
+/**
+ * @brief Pass the items held for a waiting iterator to it; run by the wake-up queued on the capture thread
+ */
+template <typename T, typename ToObject>
+static void WakePull(Napi::Env env, DeliveryGate<T> &gate, PullConsumer &pull, ToObject toObject) {
+  try {
+    Napi::HandleScope scope(env);
+    setTraceThreadName("node-main");
+    TraceScope wakeSpan("js-pull");
+
+    // Closed since the wake-up was queued
+    if (!pull.open || pull.onItems.IsEmpty()) {
+      return;
+    }
+    Napi::Value items = TakeForPull(env, gate, toObject);
+    if (!items.IsNull()) {
+      pull.onItems.Call({items});
     }
+  } catch (const std::exception &e) {
+    fprintf(stderr, "ERROR: Exception in pull wake-up: %s\n", e.what());
   }
+}
 
-  // Image format is always JPEG in the public API
-  captureConfig.imageFormat = 0; // JPEG
+/**
+ * @brief Copy audio from the backend's buffer so it can outlive the callback
+ */
+static PendingAudio CopyAudio(const float *samples, int32_t channels, int32_t sampleRate, uint32_t frames,
+                              const SyncStamp &sync, int64_t callbackStart) {
+  PendingAudio pending;
+  pending.numSamples = static_cast<size_t>(channels) * frames;
+  pending.samples    = std::shared_ptr<float[]>(new float[pending.numSamples], std::default_delete<float[]>());
+  std::memcpy(pending.samples.get(), samples, pending.numSamples * sizeof(float));
+  pending.channels      = channels;
+  pending.sampleRate    = sampleRate;
+  pending.callbackStart = callbackStart;
+  pending.sync          = sync;
+  return pending;
+}
 
-  if (config.Has("audioSampleRate") && config.Get("audioSampleRate").IsNumber()) {
-    captureConfig.audioSampleRate = config.Get("audioSampleRate").As<Napi::Number>().Int32Value();
+/**
+ * @brief Copy a tap chunk, in the tap's sample format, so it can outlive the callback
+ */
+static PendingAudio CopyTapChunk(const AudioTapChunk &chunk, int64_t callbackStart) {
+  PendingAudio pending;
+  if (chunk.pcm16) {
+    pending.numSamples = static_cast<size_t>(chunk.channels) * chunk.frames;
+    pending.pcm16      = std::shared_ptr<int16_t[]>(new int16_t[pending.numSamples], std::default_delete<int16_t[]>());
+    std::memcpy(pending.pcm16.get(), chunk.pcm16, pending.numSamples * sizeof(int16_t));
+    pending.channels      = chunk.channels;
+    pending.sampleRate    = chunk.sampleRate;
+    pending.callbackStart = callbackStart;
+    pending.sync          = chunk.stamp;
+  } else if (chunk.features) {
+    // The feature matrix travels in place of the samples, one row per frame
+    pending = CopyAudio(chunk.features, chunk.melBins, chunk.sampleRate, chunk.featureFrames, chunk.stamp,
+                        callbackStart);
+    pending.channels = chunk.channels;
+    pending.melBins  = chunk.melBins;
+  } else {
+    pending = CopyAudio(chunk.samples, chunk.channels, chunk.sampleRate, chunk.frames, chunk.stamp, callbackStart);
   }
+  pending.tap = static_cast<int32_t>(chunk.tap);
+  return pending;
+}
 
-  if (config.Has("audioChannels") && config.Get("audioChannels").IsNumber()) {
-    captureConfig.audioChannels = config.Get("audioChannels").As<Napi::Number>().Int32Value();
+Napi::Value MediaCapture::PauseDelivery(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  bool           video = false;
+  size_t         capacity;
+  OverflowPolicy policy;
+  if (!ParseDeliveryTrack(info, "pauseDelivery", video) || !ParseDeliveryOptions(info, video, capacity, policy)) {
+    return env.Undefined();
   }
 
-  if (config.Has("displayId") && config.Get("displayId").IsNumber()) {
-    captureConfig.displayID = config.Get("displayId").As<Napi::Number>().Uint32Value();
+  // An open iterator owns the gate
+  if (video && !videoPull_->open) {
+    videoGate_->configure(capacity, policy);
+    videoGate_->pause();
+  } else if (!video && !audioPull_->open) {
+    audioGate_->configure(capacity, policy);
+    audioGate_->pause();
   }
+  return env.Undefined();
+}
 
-  if (config.Has("windowId") && config.Get("windowId").IsNumber()) {
-    captureConfig.windowID = config.Get("windowId").As<Napi::Number>().Uint32Value();
+Napi::Value MediaCapture::ResumeDelivery(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  bool video = false;
+  if (!ParseDeliveryTrack(info, "resumeDelivery", video) || (video ? videoPull_ : audioPull_)->open) {
+    return env.Undefined();
   }
 
-  if (config.Has("bundleId") && config.Get("bundleId").IsString()) {
-    std::string bundleId   = config.Get("bundleId").As<Napi::String>().Utf8Value();
-    captureConfig.bundleID = strdup(bundleId.c_str());
+  // Items captured until the drain runs are held too, so nothing overtakes what is already queued
+  std::shared_ptr<DeliveryStats> delivery = deliveryStats_;
+  if (video) {
+    std::shared_ptr<DeliveryGate<PendingVideoFrame>> gate = videoGate_;
+    DrainAfterQueued(info, tsfn_video_, [gate, delivery](Napi::Env env, Napi::Function emit) {
+      std::deque<PendingVideoFrame> held;
+      gate->resume(held);
+      for (PendingVideoFrame &frame : held) {
+        EmitVideoFrame(env, emit, frame, *delivery);
+      }
+    });
+  } else {
+    std::shared_ptr<DeliveryGate<PendingAudio>> gate = audioGate_;
+    DrainAfterQueued(info, tsfn_audio_, [gate, delivery](Napi::Env env, Napi::Function emit) {
+      std::deque<PendingAudio> held;
+      gate->resume(held);
+      for (const PendingAudio &block : held) {
+        EmitAudio(env, emit, block, *delivery);
+      }
+    });
   }
+  return env.Undefined();
+}
 
-  if (captureConfig.displayID == 0 && captureConfig.windowID == 0 && captureConfig.bundleID == nullptr) {
-    deferred.Reject(
-        Napi::Error::New(env, "No valid capture target specified. Please provide displayId, windowId, or bundleId")
-            .Value());
-    return deferred.Promise();
+Napi::Value MediaCapture::OpenPull(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  bool           video = false;
+  size_t         capacity;
+  OverflowPolicy policy;
+  if (!ParseDeliveryTrack(info, "openPull", video) || !ParseDeliveryOptions(info, video, capacity, policy)) {
+    return env.Undefined();
+  }
+  if (info.Length() < 3 || !info[2].IsFunction()) {
+    Napi::TypeError::New(env, "openPull expects a function").ThrowAsJavaScriptException();
+    return env.Undefined();
   }
 
-  if (config.Has("isElectron") && config.Get("isElectron").IsBoolean()) {
-    captureConfig.isElectron = config.Get("isElectron").As<Napi::Boolean>().Value() ? 1 : 0;
-    fprintf(stderr, "DEBUG: isElectron explicitly set to %d\n", captureConfig.isElectron);
-  } else {
-    bool autoDetectedElectron = false;
-    if (env.Global().Has("process")) {
-      Napi::Object process = env.Global().Get("process").ToObject();
-      if (process.Has("versions")) {
-        Napi::Object versions = process.Get("versions").ToObject();
-        autoDetectedElectron = versions.Has("electron");
+  PullConsumer &pull = video ? *videoPull_ : *audioPull_;
+  if (pull.open) {
+    Napi::Error::New(env, "An iterator is already open on this track").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  uint32_t chunkMs = 0;
+  if (!video && info[1].IsObject()) {
+    Napi::Value value = info[1].As<Napi::Object>().Get("chunkMs");
+    if (value.IsNumber()) {
+      double ms = value.As<Napi::Number>().DoubleValue();
+      if (!(ms >= 0 && ms <= 60000)) {
+        Napi::RangeError::New(env, "chunkMs must be between 0 and 60000").ThrowAsJavaScriptException();
+        return env.Undefined();
       }
+      chunkMs = static_cast<uint32_t>(ms);
     }
-    captureConfig.isElectron = autoDetectedElectron ? 1 : 0;
-    fprintf(stderr, "DEBUG: isElectron auto-detected as %d\n", captureConfig.isElectron);
   }
 
-  auto context = new CaptureContext{this, deferred};
-
-  this->tsfn_video_ = Napi::ThreadSafeFunction::New(
-      env, info.This().As<Napi::Object>().Get("emit").As<Napi::Function>(), "VideoFrameCallback", 8, 1, this,
-      [](Napi::Env env, void *finalizeData, MediaCapture *context) {
-        fprintf(stderr, "DEBUG: Video TSFN finalized\n");
-      },
-      context);
+  // Everything is held until the iterator asks for it, so at least one item must fit
+  capacity = std::max<size_t>(capacity, 1);
+  if (video) {
+    videoGate_->configure(capacity, policy);
+    videoGate_->pause();
+  } else {
+    std::atomic_store(&audioChunker_, chunkMs > 0 ? std::make_shared<AudioChunker>(chunkMs) : nullptr);
+    audioGate_->configure(capacity, policy);
+    audioGate_->pause();
+  }
+  pull.open    = true;
+  pull.onItems = Napi::Persistent(info[2].As<Napi::Function>());
+  return env.Undefined();
+}
 
-  this->tsfn_audio_ = Napi::ThreadSafeFunction::New(
-      env, info.This().As<Napi::Object>().Get("emit").As<Napi::Function>(), "AudioEmitter", 0, 1,
-      [this](Napi::Env) { this->tsfn_audio_ = nullptr; });
+Napi::Value MediaCapture::Pull(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
 
-  this->tsfn_error_ = Napi::ThreadSafeFunction::New(
-      env, info.This().As<Napi::Object>().Get("emit").As<Napi::Function>(), "ErrorEmitter", 0, 1,
-      [this](Napi::Env) { this->tsfn_error_ = nullptr; });
+  bool video = false;
+  if (!ParseDeliveryTrack(info, "pull", video)) {
+    return env.Undefined();
+  }
 
-  isCapturing_ = true;
+  std::shared_ptr<DeliveryStats> delivery = deliveryStats_;
+  if (video) {
+    if (!videoPull_->open) {
+      return env.Null();
+    }
+    return TakeForPull(env, *videoGate_,
+                       [&](PendingVideoFrame &frame) { return VideoFrameObject(env, frame, *delivery); });
+  }
+  if (!audioPull_->open) {
+    return env.Null();
+  }
+  return TakeForPull(env, *audioGate_, [&](PendingAudio &block) { return AudioObject(env, block, *delivery); });
+}
 
-  startMediaCapture(
-      captureHandle_, captureConfig, &MediaCapture::VideoFrameCallback, &MediaCapture::AudioDataCallback,
-      &MediaCapture::ExitCallback, context);
+Napi::Value MediaCapture::ClosePull(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
 
-  if (captureConfig.bundleID) {
-    free(captureConfig.bundleID);
+  bool video = false;
+  if (!ParseDeliveryTrack(info, "closePull", video)) {
+    return env.Undefined();
   }
 
-  deferred.Resolve(env.Undefined());
-  return deferred.Promise();
+  // Whatever the iterator did not take is discarded, and the track is emitted again
+  PullConsumer &pull = video ? *videoPull_ : *audioPull_;
+  if (pull.open) {
+    pull.open = false;
+    pull.onItems.Reset();
+    if (video) {
+      std::deque<PendingVideoFrame> discarded;
+      videoGate_->resume(discarded);
+    } else {
+      std::atomic_store(&audioChunker_, std::shared_ptr<AudioChunker>());
+      std::deque<PendingAudio> discarded;
+      audioGate_->resume(discarded);
+    }
+  }
+  return env.Undefined();
 }
 
 static void StopMediaCaptureTrampoline(void *ctx) {
@@ -312,6 +1723,7 @@ static void StopMediaCaptureTrampoline(void *ctx) {
   MediaCapture *instance = context->instance; // Use direct pointer
 
   if (instance) {
+    instance->FinishRecording();
     instance->RequestStopFromBackgroundThread(context);
   } else {
     fprintf(stderr, "DEBUG: StopMediaCaptureTrampoline - instance already destroyed\n");
@@ -332,6 +1744,15 @@ Napi::Value MediaCapture::StopCapture(const Napi::CallbackInfo &info) {
 
   isCapturing_.store(false);
 
+  // The spans stay available to dumpTrace() after the capture has stopped
+  if (tracing_) {
+    setCaptureTraceEnabled(false);
+    tracing_ = false;
+  }
+
+  // Closed right away so that readers see the end and the name can be reused by the next capture
+  CloseSharedRing();
+
   auto context = new StopMediaCaptureContext(this, deferred);
 
   stopMediaCapture(captureHandle_, StopMediaCaptureTrampoline, context);
@@ -343,6 +1764,25 @@ void MediaCapture::VideoFrameCallback(
     uint8_t *data, int32_t width, int32_t height, int32_t bytesPerRow, 
     const char *timestamp, const char *format,
     size_t actualBufferSize, void *ctx) {
+  DeliverVideoFrame(-1, -1, data, width, height, bytesPerRow, timestamp, format, actualBufferSize, ctx);
+}
+
+void MediaCapture::TargetVideoFrameCallback(
+    int32_t targetIndex, uint8_t *data, int32_t width, int32_t height, int32_t bytesPerRow,
+    const char *timestamp, const char *format, size_t actualBufferSize, void *ctx) {
+  DeliverVideoFrame(targetIndex, -1, data, width, height, bytesPerRow, timestamp, format, actualBufferSize, ctx);
+}
+
+void MediaCapture::RenditionVideoFrameCallback(
+    int32_t rendition, uint8_t *data, int32_t width, int32_t height, int32_t bytesPerRow,
+    const char *timestamp, const char *format, size_t actualBufferSize, void *ctx) {
+  DeliverVideoFrame(-1, rendition, data, width, height, bytesPerRow, timestamp, format, actualBufferSize, ctx);
+}
+
+void MediaCapture::DeliverVideoFrame(
+    int32_t targetIndex, int32_t rendition, uint8_t *data, int32_t width, int32_t height, int32_t bytesPerRow,
+    const char *timestamp, const char *format, size_t actualBufferSize, void *ctx) {
+  const int64_t callbackStart = monotonicNowNs();
   bool tsfn_acquired = false;
 
   try {
@@ -362,6 +1802,33 @@ void MediaCapture::VideoFrameCallback(
       fprintf(stderr, "DEBUG: Ignoring video frame - capture is inactive\n");
       return;
     }
+    instance->startup_.firstVideo();
+
+    // The formats belong to this capture, so a later startCapture() cannot change them under this thread
+    if (rendition >= 0 && static_cast<size_t>(rendition) >= context->renditionFormats.size()) {
+      rendition = -1;
+    }
+
+    std::shared_ptr<SharedRingWriter> sharedRing = std::atomic_load(&instance->sharedRing_);
+    std::shared_ptr<RecordingSink>    recorder   = std::atomic_load(&instance->recorder_);
+    std::shared_ptr<LookbackBuffer>   lookback   = std::atomic_load(&instance->lookback_);
+    if (sharedRing || recorder || lookback) {
+      const bool    isJpeg      = (format && strcmp(format, "jpeg") == 0);
+      const int64_t timestampMs = timestamp ? std::strtoll(timestamp, nullptr, 10) : 0;
+      if (sharedRing) {
+        sharedRing->writeVideo(data, actualBufferSize, width, height, bytesPerRow, isJpeg, timestampMs);
+      }
+      if (lookback) {
+        lookback->writeVideo(data, actualBufferSize, width, height, bytesPerRow, isJpeg, timestampMs);
+      }
+      // While recording or looking back, frames stay native and never reach the JavaScript thread
+      if (recorder || lookback) {
+        if (recorder) {
+          recorder->writeVideo(data, actualBufferSize, width, height, isJpeg, timestampMs);
+        }
+        return;
+      }
+    }
 
     auto tsfn = instance->tsfn_video_;
     if (!tsfn) {
@@ -369,6 +1836,9 @@ void MediaCapture::VideoFrameCallback(
       return;
     }
 
+    const uint64_t sequence = currentTraceSequence();
+    TraceScope     enqueueSpan("js-enqueue", sequence);
+
     napi_status status = tsfn.Acquire();
     if (status != napi_ok) {
       fprintf(stderr, "DEBUG: Failed to acquire TSFN\n");
@@ -376,29 +1846,59 @@ void MediaCapture::VideoFrameCallback(
     }
     tsfn_acquired = true;
 
+    std::string timestampStr = timestamp ? timestamp : "0";
+    double timestampValue = 0.0;
+    try {
+      int64_t timestampMs = std::stoll(timestampStr);
+      timestampValue = static_cast<double>(timestampMs);
+    } catch (const std::exception& e) {
+      fprintf(stderr, "ERROR: Invalid timestamp format: %s\n", timestampStr.c_str());
+      timestampValue = 0.0;
+    }
+
     const bool isJpeg = (format && strcmp(format, "jpeg") == 0);
 
-    std::shared_ptr<uint8_t[]> dataCopy;
-    size_t                     dataSize = 0;
+    // Frames are staged in pooled buffers so steady-state delivery does not allocate
+    std::shared_ptr<FrameBufferPool>   pool = instance->framePool_;
+    std::shared_ptr<DeltaFrameEncoder> deltaEncoder;
+    RawFrame                           frame;
+    ImageFormat                        frameFormat;
 
     if (isJpeg) {
-      dataSize = actualBufferSize;
-      dataCopy = std::shared_ptr<uint8_t[]>(new uint8_t[dataSize]);
-      memcpy(dataCopy.get(), data, dataSize);
+      frameFormat       = ImageFormat::Jpeg;
+      frame.buffer      = pool->acquire(actualBufferSize);
+      frame.width       = width;
+      frame.height      = height;
+      frame.bytesPerRow = bytesPerRow;
+      memcpy(frame.buffer->data(), data, actualBufferSize);
     } else {
-      dataSize = static_cast<size_t>(height) * static_cast<size_t>(bytesPerRow);
-      dataCopy = std::shared_ptr<uint8_t[]>(new uint8_t[dataSize]);
-
-      const size_t rowBytes =
-          std::min(static_cast<size_t>(bytesPerRow), actualBufferSize / static_cast<size_t>(height));
-
-      for (int32_t y = 0; y < height; y++) {
-        const size_t srcOffset  = y * bytesPerRow;
-        const size_t destOffset = y * bytesPerRow;
-
-        if (srcOffset + rowBytes > actualBufferSize || destOffset + rowBytes > dataSize)
-          break;
-        memcpy(dataCopy.get() + destOffset, data + srcOffset, rowBytes);
+      // Raw frames arrive as BGRA; packRawFrame converts on this (capture) thread
+      frameFormat = rendition >= 0 ? context->renditionFormats[rendition] : instance->imageFormat_.load();
+      if (frameFormat == ImageFormat::Jpeg) {
+        frameFormat = ImageFormat::Bgra;
+      }
+      bool packed = static_cast<size_t>(height) * static_cast<size_t>(bytesPerRow) <= actualBufferSize;
+      if (packed && frameFormat == ImageFormat::Delta) {
+        deltaEncoder = std::atomic_load(&instance->deltaEncoder_);
+        frame.buffer = pool->acquire(0);
+        frame.width  = width;
+        frame.height = height;
+        packed       = deltaEncoder && deltaEncoder->encode(data, width, height, bytesPerRow,
+                                                            static_cast<int64_t>(timestampValue), *frame.buffer);
+      } else if (packed) {
+        packed = packRawFrame(*pool, frameFormat, data, width, height, bytesPerRow, frame);
+      }
+      if (!packed) {
+        fprintf(stderr, "ERROR: Invalid raw video frame %dx%d (bytesPerRow=%d)\n", width, height, bytesPerRow);
+        tsfn.Release();
+        tsfn_acquired = false;
+        return;
+      }
+      // Nothing changed since the previous delta frame
+      if (frameFormat == ImageFormat::Delta && frame.buffer->empty()) {
+        tsfn.Release();
+        tsfn_acquired = false;
+        return;
       }
     }
 
@@ -410,52 +1910,64 @@ void MediaCapture::VideoFrameCallback(
       return;
     }
 
-    // Call callback with copied data
-    auto dataCopy_shared = dataCopy;
-
-    std::string timestampStr = timestamp ? timestamp : "0";
-    double timestampValue = 0.0;
-    try {
-      int64_t timestampMs = std::stoll(timestampStr);
-      timestampValue = static_cast<double>(timestampMs);
-    } catch (const std::exception& e) {
-      fprintf(stderr, "ERROR: Invalid timestamp format: %s\n", timestampStr.c_str());
-      timestampValue = 0.0;
+    // Frames of a multi-target capture say which target they came from
+    MediaCaptureTargetRefC target = {};
+    if (targetIndex >= 0 && static_cast<size_t>(targetIndex) < instance->captureTargets_.size()) {
+      target = instance->captureTargets_[targetIndex];
     }
 
-    tsfn.NonBlockingCall([dataCopy_shared, width, height, bytesPerRow, timestampValue, dataSize,
-                          isJpeg](Napi::Env env, Napi::Function jsCallback) {
-      try {
-        Napi::HandleScope scope(env);
-
-        // Convert data to ArrayBuffer
-        Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, dataSize);
-        memcpy(buffer.Data(), dataCopy_shared.get(), dataSize);
-
-        // Create frame info object
-        Napi::Object frame = Napi::Object::New(env);
-        frame.Set("width", Napi::Number::New(env, width));
-        frame.Set("height", Napi::Number::New(env, height));
-        frame.Set("bytesPerRow", Napi::Number::New(env, bytesPerRow));
-        frame.Set("timestamp", Napi::Number::New(env, timestampValue)); // 数値に変換したタイムスタンプを使用
-        frame.Set("isJpeg", Napi::Boolean::New(env, isJpeg));
-
-        // Set data as Uint8Array
-        frame.Set("data", Napi::Uint8Array::New(env, dataSize, buffer, 0));
-
-        // Call callback function
-        if (jsCallback.IsFunction()) {
-          jsCallback.Call({Napi::String::New(env, "video-frame"), frame});
-        } else {
-          fprintf(stderr, "ERROR: Invalid JS callback for video frame\n");
+    // Set by the native pipeline for this callback; invalid on backends without a shared clock
+    const SyncStamp syncStamp = currentSyncStamp();
+
+    PendingVideoFrame pending;
+    pending.frame         = std::move(frame);
+    pending.format        = frameFormat;
+    pending.timestamp     = timestampValue;
+    pending.callbackStart = callbackStart;
+    pending.sequence      = sequence;
+    pending.targetIndex   = targetIndex;
+    pending.target        = target;
+    pending.rendition     = rendition;
+    pending.sync          = syncStamp;
+
+    // While a stream has paused delivery, frames wait in native memory instead of the queue
+    std::shared_ptr<DeliveryStats> delivery = instance->deliveryStats_;
+    const GateResult               gated    = instance->videoGate_->admit(pending);
+    if (gated == GateResult::Wake) {
+      std::shared_ptr<DeliveryGate<PendingVideoFrame>> gate = instance->videoGate_;
+      std::shared_ptr<PullConsumer>                    pull = instance->videoPull_;
+      status = tsfn.NonBlockingCall([gate, pull, delivery](Napi::Env env, Napi::Function) {
+        WakePull(env, *gate, *pull, [&](PendingVideoFrame &frame) { return VideoFrameObject(env, frame, *delivery); });
+      });
+      if (status != napi_ok) {
+        gate->armWake();
+      }
+    }
+    if (gated != GateResult::Deliver) {
+      if (gated == GateResult::Dropped) {
+        delivery->videoDropped.fetch_add(1, std::memory_order_relaxed);
+        if (deltaEncoder) {
+          deltaEncoder->requestKeyframe();
         }
-      } catch (const std::exception &e) {
-        fprintf(stderr, "ERROR: Exception in video frame JS callback: %s\n", e.what());
-      } catch (...) {
-        fprintf(stderr, "ERROR: Unknown exception in video frame JS callback\n");
       }
+      tsfn.Release();
+      tsfn_acquired = false;
+      return;
+    }
+
+    status = tsfn.NonBlockingCall([pending, delivery](Napi::Env env, Napi::Function jsCallback) mutable {
+      EmitVideoFrame(env, jsCallback, pending, *delivery);
     });
 
+    if (status != napi_ok) {
+      delivery->videoDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // A dropped delta breaks the chain for the consumer, so resynchronize with a keyframe
+    if (status != napi_ok && deltaEncoder) {
+      deltaEncoder->requestKeyframe();
+    }
+
     tsfn.Release();
     tsfn_acquired = false;
   } catch (const std::bad_alloc &e) {
@@ -463,7 +1975,7 @@ void MediaCapture::VideoFrameCallback(
   } catch (const std::exception &e) {
     fprintf(stderr, "ERROR: Exception in video frame copy: %s\n", e.what());
   } catch (...) {
-    fprintf(stderr, "ERROR: Unknown exception in VideoFrameCallback\n");
+    fprintf(stderr, "ERROR: Unknown exception in DeliverVideoFrame\n");
   }
 
   // Always release TSFN
@@ -478,8 +1990,95 @@ void MediaCapture::VideoFrameCallback(
   }
 }
 
+Napi::Object MediaCapture::VideoFrameObject(Napi::Env env, PendingVideoFrame &pending, DeliveryStats &delivery) {
+  delivery.videoDispatch.record(static_cast<uint64_t>(monotonicNowNs() - pending.callbackStart));
+  double sinceCapture = static_cast<double>(wallClockNowMs()) - pending.timestamp;
+  delivery.captureToJs.record(static_cast<uint64_t>(std::max(0.0, sinceCapture) * 1e6));
+  delivery.videoDelivered.fetch_add(1, std::memory_order_relaxed);
+
+  // Copy into a JS-owned ArrayBuffer (external buffers are disabled), then recycle the pooled one
+  const size_t      dataSize = pending.frame.buffer->size();
+  Napi::ArrayBuffer buffer   = Napi::ArrayBuffer::New(env, dataSize);
+  memcpy(buffer.Data(), pending.frame.buffer->data(), dataSize);
+  pending.frame.buffer.reset();
+
+  Napi::Object frameObject = Napi::Object::New(env);
+
+  // Patches are exposed as views into the same ArrayBuffer
+  if (pending.format == ImageFormat::Delta) {
+    const uint8_t              *payload = static_cast<const uint8_t *>(buffer.Data());
+    DeltaFrameHeader            header;
+    std::vector<DeltaPatchView> patches;
+    parseDeltaFrame(payload, dataSize, header, patches);
+
+    Napi::Array patchArray = Napi::Array::New(env, patches.size());
+    for (size_t i = 0; i < patches.size(); i++) {
+      Napi::Object patch = Napi::Object::New(env);
+      patch.Set("x", Napi::Number::New(env, patches[i].rect.x));
+      patch.Set("y", Napi::Number::New(env, patches[i].rect.y));
+      patch.Set("width", Napi::Number::New(env, patches[i].rect.width));
+      patch.Set("height", Napi::Number::New(env, patches[i].rect.height));
+      patch.Set("data", Napi::Uint8Array::New(env, patches[i].size, buffer, patches[i].data - payload));
+      patchArray[i] = patch;
+    }
+    frameObject.Set("isKeyframe", Napi::Boolean::New(env, header.keyframe));
+    frameObject.Set("sequence", Napi::Number::New(env, header.sequence));
+    frameObject.Set("baseSequence", Napi::Number::New(env, header.baseSequence));
+    frameObject.Set("patches", patchArray);
+  }
+
+  // Create frame info object
+  frameObject.Set("width", Napi::Number::New(env, pending.frame.width));
+  frameObject.Set("height", Napi::Number::New(env, pending.frame.height));
+  frameObject.Set("bytesPerRow", Napi::Number::New(env, pending.frame.bytesPerRow));
+  frameObject.Set("timestamp", Napi::Number::New(env, pending.timestamp)); // 数値に変換したタイムスタンプを使用
+  frameObject.Set("format", Napi::String::New(env, imageFormatName(pending.format)));
+  frameObject.Set("isJpeg", Napi::Boolean::New(env, pending.format == ImageFormat::Jpeg));
+  if (pending.sync.valid) {
+    frameObject.Set("captureTime", Napi::Number::New(env, static_cast<double>(pending.sync.captureNs) / 1e6));
+  }
+  if (pending.sync.hasAudio) {
+    frameObject.Set("audioPosition", Napi::Number::New(env, static_cast<double>(pending.sync.audioPosition)));
+  }
+  if (pending.targetIndex >= 0) {
+    frameObject.Set("targetIndex", Napi::Number::New(env, pending.targetIndex));
+    frameObject.Set("displayId", Napi::Number::New(env, pending.target.displayID));
+    frameObject.Set("windowId", Napi::Number::New(env, pending.target.windowID));
+  }
+  if (pending.rendition >= 0) {
+    frameObject.Set("rendition", Napi::Number::New(env, pending.rendition));
+  }
+
+  // Set data as Uint8Array
+  frameObject.Set("data", Napi::Uint8Array::New(env, dataSize, buffer, 0));
+  return frameObject;
+}
+
+void MediaCapture::EmitVideoFrame(Napi::Env env, Napi::Function emit, PendingVideoFrame &pending,
+                                  DeliveryStats &delivery) {
+  try {
+    Napi::HandleScope scope(env);
+    setTraceThreadName("node-main");
+    TraceScope listenerSpan("js-video-frame", pending.sequence);
+
+    Napi::Object frameObject = VideoFrameObject(env, pending, delivery);
+
+    // Call callback function
+    if (emit.IsFunction()) {
+      emit.Call({Napi::String::New(env, "video-frame"), frameObject});
+    } else {
+      fprintf(stderr, "ERROR: Invalid JS callback for video frame\n");
+    }
+  } catch (const std::exception &e) {
+    fprintf(stderr, "ERROR: Exception in video frame JS callback: %s\n", e.what());
+  } catch (...) {
+    fprintf(stderr, "ERROR: Unknown exception in video frame JS callback\n");
+  }
+}
+
 void MediaCapture::AudioDataCallback(
     int32_t channels, int32_t sampleRate, float *buffer, int32_t frameCount, void *ctx) {
+  const int64_t callbackStart = monotonicNowNs();
   bool tsfn_acquired = false;
 
   try {
@@ -499,6 +2098,27 @@ void MediaCapture::AudioDataCallback(
       fprintf(stderr, "DEBUG: Ignoring audio data - capture is inactive\n");
       return;
     }
+    instance->startup_.firstAudio();
+
+    std::shared_ptr<SharedRingWriter> sharedRing = std::atomic_load(&instance->sharedRing_);
+    if (sharedRing && buffer) {
+      sharedRing->writeAudio(buffer, frameCount, channels, sampleRate);
+    }
+
+    std::shared_ptr<LookbackBuffer> lookback = std::atomic_load(&instance->lookback_);
+    if (lookback && buffer && frameCount > 0 && sampleRate > 0) {
+      // The block ends about now; its first sample is stamped on the same wall clock as the frames
+      lookback->writeAudio(buffer, static_cast<uint32_t>(frameCount), channels, sampleRate,
+                           wallClockNowMs() - static_cast<int64_t>(frameCount) * 1000 / sampleRate);
+    }
+
+    std::shared_ptr<RecordingSink> recorder = std::atomic_load(&instance->recorder_);
+    if (recorder || lookback) {
+      if (recorder && buffer) {
+        recorder->writeAudio(buffer, frameCount, channels, sampleRate);
+      }
+      return;
+    }
 
     auto tsfn = instance->tsfn_audio_;
     if (!tsfn) {
@@ -525,10 +2145,6 @@ void MediaCapture::AudioDataCallback(
     }
     tsfn_acquired = true;
 
-    // Safely handle exceptions
-    std::shared_ptr<float[]> audioCopy(new float[numSamples], std::default_delete<float[]>());
-    std::memcpy(audioCopy.get(), buffer, numSamples * sizeof(float));
-
     // Check instance is valid again
     if (!instance || !instance->isCapturing_.load()) {
       fprintf(stderr, "DEBUG: Skipping audio callback - capture was stopped or instance destroyed\n");
@@ -537,26 +2153,28 @@ void MediaCapture::AudioDataCallback(
       return;
     }
 
-    // Execute callback
-    tsfn.NonBlockingCall(
-        [audioCopy, channels, sampleRate, frameCount, numSamples](Napi::Env env, Napi::Function jsCallback) {
-          try {
-            Napi::HandleScope scope(env);
-
-            Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, numSamples * sizeof(float));
-            std::memcpy(buffer.Data(), audioCopy.get(), numSamples * sizeof(float));
-
-            Napi::Float32Array audioData = Napi::Float32Array::New(env, numSamples, buffer, 0);
-
-            if (jsCallback.IsFunction()) {
-              jsCallback.Call(
-                  {Napi::String::New(env, "audio-data"), audioData, Napi::Number::New(env, sampleRate),
-                   Napi::Number::New(env, channels)});
-            }
-          } catch (const std::exception &e) {
-            fprintf(stderr, "ERROR: Exception in audio data processing: %s\n", e.what());
-          }
-        });
+    // Audio taps replace the plain stream, each chunk tagged with its tap
+    std::shared_ptr<AudioTapSet>  taps    = std::atomic_load(&instance->audioTaps_);
+    std::shared_ptr<AudioChunker> chunker = std::atomic_load(&instance->audioChunker_);
+    if (taps) {
+      taps->push(buffer, static_cast<uint32_t>(frameCount), channels, sampleRate, currentSyncStamp(),
+                 [&](const AudioTapChunk &chunk) {
+                   PendingAudio pending = CopyTapChunk(chunk, callbackStart);
+                   QueueAudio(instance, tsfn, pending);
+                 });
+    } else if (chunker) {
+      // An iterator opened with chunkMs gets fixed-length chunks instead of the backend's blocks
+      chunker->push(buffer, static_cast<uint32_t>(frameCount), channels, sampleRate, currentSyncStamp(),
+                    [&](const float *samples, uint32_t frames, const SyncStamp &stamp) {
+                      PendingAudio chunk = CopyAudio(samples, chunker->channels(), chunker->sampleRate(), frames,
+                                                     stamp, callbackStart);
+                      QueueAudio(instance, tsfn, chunk);
+                    });
+    } else {
+      PendingAudio pending = CopyAudio(buffer, channels, sampleRate, static_cast<uint32_t>(frameCount),
+                                       currentSyncStamp(), callbackStart);
+      QueueAudio(instance, tsfn, pending);
+    }
 
     // Always release TSFN
     tsfn.Release();
@@ -581,6 +2199,85 @@ void MediaCapture::AudioDataCallback(
   }
 }
 
+void MediaCapture::QueueAudio(MediaCapture *instance, Napi::ThreadSafeFunction &tsfn, PendingAudio &pending) {
+  std::shared_ptr<DeliveryStats> delivery = instance->deliveryStats_;
+  const GateResult               gated    = instance->audioGate_->admit(pending);
+
+  napi_status status = napi_ok;
+  if (gated == GateResult::Deliver) {
+    status = tsfn.NonBlockingCall([pending, delivery](Napi::Env env, Napi::Function jsCallback) {
+      EmitAudio(env, jsCallback, pending, *delivery);
+    });
+    if (status != napi_ok) {
+      delivery->audioDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  } else if (gated == GateResult::Wake) {
+    std::shared_ptr<DeliveryGate<PendingAudio>> gate = instance->audioGate_;
+    std::shared_ptr<PullConsumer>               pull = instance->audioPull_;
+    status = tsfn.NonBlockingCall([gate, pull, delivery](Napi::Env env, Napi::Function) {
+      WakePull(env, *gate, *pull, [&](PendingAudio &block) { return AudioObject(env, block, *delivery); });
+    });
+    if (status != napi_ok) {
+      gate->armWake();
+    }
+  } else if (gated == GateResult::Dropped) {
+    delivery->audioDropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+Napi::Object MediaCapture::AudioObject(Napi::Env env, const PendingAudio &pending, DeliveryStats &delivery) {
+  delivery.audioDispatch.record(static_cast<uint64_t>(monotonicNowNs() - pending.callbackStart));
+  delivery.audioDelivered.fetch_add(1, std::memory_order_relaxed);
+
+  Napi::Object audio = Napi::Object::New(env);
+  if (pending.pcm16) {
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, pending.numSamples * sizeof(int16_t));
+    std::memcpy(buffer.Data(), pending.pcm16.get(), pending.numSamples * sizeof(int16_t));
+    audio.Set("data", Napi::Int16Array::New(env, pending.numSamples, buffer, 0));
+  } else {
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, pending.numSamples * sizeof(float));
+    std::memcpy(buffer.Data(), pending.samples.get(), pending.numSamples * sizeof(float));
+    audio.Set("data", Napi::Float32Array::New(env, pending.numSamples, buffer, 0));
+  }
+  audio.Set("sampleRate", Napi::Number::New(env, pending.sampleRate));
+  audio.Set("channels", Napi::Number::New(env, pending.channels));
+  if (pending.tap >= 0) {
+    audio.Set("tap", Napi::Number::New(env, pending.tap));
+  }
+  if (pending.melBins > 0) {
+    Napi::Object features = Napi::Object::New(env);
+    features.Set("frames", Napi::Number::New(env, static_cast<double>(pending.numSamples / pending.melBins)));
+    features.Set("melBins", Napi::Number::New(env, pending.melBins));
+    audio.Set("features", features);
+  }
+
+  // Capture time and stream position of the first sample, on the clock video frames use
+  if (pending.sync.valid) {
+    Napi::Object info = Napi::Object::New(env);
+    info.Set("captureTime", Napi::Number::New(env, static_cast<double>(pending.sync.captureNs) / 1e6));
+    info.Set("position", Napi::Number::New(env, static_cast<double>(pending.sync.audioPosition)));
+    audio.Set("sync", info);
+  }
+  return audio;
+}
+
+void MediaCapture::EmitAudio(Napi::Env env, Napi::Function emit, const PendingAudio &pending,
+                             DeliveryStats &delivery) {
+  try {
+    Napi::HandleScope scope(env);
+    setTraceThreadName("node-main");
+    TraceScope listenerSpan("js-audio-data");
+
+    Napi::Object audio = AudioObject(env, pending, delivery);
+    if (emit.IsFunction()) {
+      emit.Call({Napi::String::New(env, "audio-data"), audio.Get("data"), audio.Get("sampleRate"),
+                 audio.Get("channels"), audio.Get("sync"), audio.Get("tap"), audio.Get("features")});
+    }
+  } catch (const std::exception &e) {
+    fprintf(stderr, "ERROR: Exception in audio data processing: %s\n", e.what());
+  }
+}
+
 void MediaCapture::ExitCallback(char *error, void *ctx) {
   if (!ctx) {
     fprintf(stderr, "ERROR: ExitCallback received null context\n");
@@ -658,11 +2355,17 @@ void MediaCapture::ProcessStopMediaCaptureRequest() {
   // Copy context and transfer ownership
   auto context             = std::unique_ptr<StopMediaCaptureContext>(pendingMediaStopContext_);
   pendingMediaStopContext_ = nullptr;
+  std::string recordingError;
+  recordingError.swap(recordingError_);
   lock.unlock(); // Release lock early
 
   try {
     Napi::HandleScope scope(context->deferred.Env());
     this->AbortAllThreadSafeFunctions();
+    if (!recordingError.empty()) {
+      context->deferred.Reject(Napi::Error::New(context->deferred.Env(), recordingError).Value());
+      return;
+    }
     context->deferred.Resolve(context->deferred.Env().Undefined());
   } catch (const std::exception &e) {
     fprintf(stderr, "ERROR: Exception in ProcessStopMediaCaptureRequest: %s\n", e.what());
@@ -18,9 +18,79 @@
 #include <cstring>
 #include <stdexcept>
 #include "../include/capture/capture.h"
+#include "audiochunker.h"
+#include "audiotaps.h"
+#include "avsync.h"
+#include "bufferpool.h"
+#include "capturestats.h"
+#include "capturetrace.h"
+#include "deliverygate.h"
+#include "deltaframe.h"
+#include "lookbackbuffer.h"
+#include "rawframe.h"
+#include "recordingsink.h"
+#include "sharedringwriter.h"
+#include "targetregistry.h"
 
 class MediaCapture;
 
+/**
+ * @struct PendingVideoFrame
+ * @brief A video frame on its way to the JavaScript thread
+ *
+ * Queued in a thread-safe function call, or held by the video DeliveryGate
+ * while a stream has paused delivery.
+ */
+struct PendingVideoFrame {
+  RawFrame               frame;
+  ImageFormat            format        = ImageFormat::Jpeg;
+  double                 timestamp     = 0.0;
+  int64_t                callbackStart = 0;
+  uint64_t               sequence      = 0;
+  int32_t                targetIndex   = -1;
+  MediaCaptureTargetRefC target        = {};
+  int32_t                rendition     = -1;
+  SyncStamp              sync;
+};
+
+/**
+ * @struct PendingAudio
+ * @brief An audio block on its way to the JavaScript thread
+ */
+struct PendingAudio {
+  std::shared_ptr<float[]>   samples;
+  std::shared_ptr<int16_t[]> pcm16;          /**< Set instead of samples for an s16 audio tap */
+  int32_t                    channels      = 0;
+  int32_t                    sampleRate    = 0;
+  size_t                     numSamples    = 0;
+  int64_t                    callbackStart = 0;
+  int32_t                    tap           = -1; /**< Index into audioTaps, -1 for the plain stream */
+  int32_t                    melBins       = 0;  /**< Columns of the log-mel matrix in samples (logmel taps) */
+  SyncStamp                  sync;
+};
+
+/**
+ * @struct PullConsumer
+ * @brief Async iterator reading one track; touched on the JavaScript thread only
+ */
+struct PullConsumer {
+  /** Whether an iterator is open; its track is held for it instead of being emitted */
+  bool open = false;
+  
+  /** Receives the items a wake-up took from the gate */
+  Napi::FunctionReference onItems;
+};
+
+/**
+ * @brief Convert one stage of getStats() to {count, meanMs, maxMs, p50Ms, p90Ms, p99Ms, p999Ms}
+ */
+Napi::Object StageStatsObject(Napi::Env env, const MediaCaptureStageStatsC& stage);
+
+/**
+ * @brief Same as above for a histogram kept by the addon
+ */
+Napi::Object StageStatsObject(Napi::Env env, const StageTiming& timing);
+
 /**
  * @struct ContextBase
  * @brief Base context structure for callback operations
@@ -55,6 +125,9 @@ struct CaptureContext : public ContextBase {
   /** Promise deferred to resolve/reject when operation completes */
   Napi::Promise::Deferred deferred;
   
+  /** Delivered layout of each rendition of a multi-rendition capture; fixed once the capture starts */
+  std::vector<ImageFormat> renditionFormats;
+  
   /**
    * @brief Constructor
    * @param inst Pointer to MediaCapture instance
@@ -64,6 +137,153 @@ struct CaptureContext : public ContextBase {
     : ContextBase(inst), deferred(std::move(def)) {}
 };
 
+/**
+ * @struct PrepareContext
+ * @brief Context for prepare operations
+ *
+ * The backend may report from another thread, so the promise is settled
+ * through a thread-safe function on the JavaScript thread. The instance is
+ * kept alive until then.
+ */
+struct PrepareContext : public ContextBase {
+  /** Promise deferred to resolve/reject when the resources are ready */
+  Napi::Promise::Deferred deferred;
+  
+  /** Reference to the JavaScript object of instance */
+  Napi::ObjectReference self;
+  
+  /** Reaches the JavaScript thread from the backend callback */
+  Napi::ThreadSafeFunction tsfn;
+  
+  /** Target being prepared, for the startup statistics */
+  uint32_t displayID = 0;
+  uint32_t windowID  = 0;
+  
+  /**
+   * @brief Constructor
+   * @param inst Pointer to MediaCapture instance
+   * @param def Promise deferred object for async resolution
+   */
+  PrepareContext(MediaCapture* inst, Napi::Promise::Deferred def) 
+    : ContextBase(inst), deferred(std::move(def)) {}
+};
+
+/**
+ * @struct ReconfigureContext
+ * @brief Context for reconfigure operations
+ *
+ * Like PrepareContext, the promise is settled on the JavaScript thread; the
+ * merged configuration replaces the stored one only once the backend has
+ * applied it.
+ */
+struct ReconfigureContext : public ContextBase {
+  /** Promise deferred to resolve/reject when the change has been applied */
+  Napi::Promise::Deferred deferred;
+  
+  /** Reference to the JavaScript object of instance */
+  Napi::ObjectReference self;
+  
+  /** Start configuration with the changed keys applied */
+  Napi::ObjectReference config;
+  
+  /** config as parsed, and its bundle ID; replace the instance's copies once applied */
+  MediaCaptureConfigC parsed = {};
+  std::string         bundleId;
+  
+  /** Reaches the JavaScript thread from the backend callback */
+  Napi::ThreadSafeFunction tsfn;
+  
+  /** Format delivered to JavaScript from then on */
+  ImageFormat imageFormat = ImageFormat::Jpeg;
+  
+  /** New target, when it changed, for the startup statistics */
+  bool     targetChanged = false;
+  uint32_t displayID     = 0;
+  uint32_t windowID      = 0;
+  
+  /**
+   * @brief Constructor
+   * @param inst Pointer to MediaCapture instance
+   * @param def Promise deferred object for async resolution
+   */
+  ReconfigureContext(MediaCapture* inst, Napi::Promise::Deferred def) 
+    : ContextBase(inst), deferred(std::move(def)) {}
+};
+
+/**
+ * @struct CropRectContext
+ * @brief Context for setCropRect() operations
+ *
+ * Like ReconfigureContext, the promise is settled on the JavaScript thread
+ * once the backend has applied the crop or failed to.
+ */
+struct CropRectContext : public ContextBase {
+  /** Promise deferred to resolve/reject when the crop has been applied */
+  Napi::Promise::Deferred deferred;
+  
+  /** Reference to the JavaScript object of instance */
+  Napi::ObjectReference self;
+  
+  /** Crop as parsed, and as given (empty for null); replace the start configuration's once applied */
+  MediaCaptureRectC     cropRect = {};
+  Napi::ObjectReference value;
+  
+  /** Reaches the JavaScript thread from the backend callback */
+  Napi::ThreadSafeFunction tsfn;
+  
+  /**
+   * @brief Constructor
+   * @param inst Pointer to MediaCapture instance
+   * @param def Promise deferred object for async resolution
+   */
+  CropRectContext(MediaCapture* inst, Napi::Promise::Deferred def) 
+    : ContextBase(inst), deferred(std::move(def)) {}
+};
+
+/**
+ * @struct SnapshotContext
+ * @brief Context for snapshot operations
+ *
+ * The look-back buffer is copied, and written to disk when a directory is
+ * given, on a worker thread; the promise is settled through a thread-safe
+ * function on the JavaScript thread. The function's finalizer owns the
+ * context: it joins the worker and deletes it, also when the environment
+ * shuts down before the promise could be settled.
+ */
+struct SnapshotContext : public ContextBase {
+  /** Promise deferred to resolve/reject with the snapshot */
+  Napi::Promise::Deferred deferred;
+  
+  /** Reaches the JavaScript thread from the worker */
+  Napi::ThreadSafeFunction tsfn;
+  
+  /** Copies the buffer; joined by the environment cleanup hook or the tsfn finalizer */
+  std::thread worker;
+  
+  /** Buffer to copy from; kept alive by the worker */
+  std::shared_ptr<LookbackBuffer> lookback;
+  
+  /** Seconds to copy */
+  double seconds = 0;
+  
+  /** Directory to write the snapshot into; empty to resolve with the media */
+  std::string dir;
+  
+  /** Copied media */
+  LookbackSnapshot snapshot;
+  
+  /** Failure to write the snapshot, if any */
+  std::string error;
+  
+  /**
+   * @brief Constructor
+   * @param inst Pointer to MediaCapture instance
+   * @param def Promise deferred object for async resolution
+   */
+  SnapshotContext(MediaCapture* inst, Napi::Promise::Deferred def) 
+    : ContextBase(inst), deferred(std::move(def)) {}
+};
+
 /**
  * @struct StopContext
  * @brief Context for basic capture stop operations
@@ -167,15 +387,63 @@ class MediaCapture : public Napi::ObjectWrap<MediaCapture> {
    * Resolves the pending promise and cleans up the context.
    */
   void ProcessStopRequest();
+  
+  /**
+   * @brief Finish the active recording, if any, and keep its error for stopCapture()
+   * 
+   * Called on the native thread once capture has stopped, so the files are
+   * complete before the stop promise settles.
+   */
+  void FinishRecording();
+  
+  /**
+   * @brief Stop publishing to shared memory, if enabled, and tell readers the capture has ended
+   */
+  void CloseSharedRing();
+  
+  /**
+   * @brief Perform safe shutdown, stopping capture and cleaning up resources
+   *
+   * Also called when the instance's environment shuts down, e.g. when the
+   * worker thread that owns it is terminated.
+   */
+  void SafeShutdown();
 
  private:
   /**
    * @brief JavaScript method to enumerate available capture targets
-   * @param info JavaScript call information
-   * @return Promise that resolves with available targets
+   * @param info JavaScript call information with the target type and optional
+   *        filter {appName, minWidth, minHeight, displayId, maxAgeMs}
+   * @return Promise that resolves with the matching targets; served from the cache
+   *         while it is no older than maxAgeMs
    */
   static Napi::Value EnumerateTargets(const Napi::CallbackInfo& info);
   
+  /**
+   * @brief JavaScript method to emit "targets-changed" when matching targets come, go or change
+   * @param info JavaScript call information with options
+   *        {type, appName, minWidth, minHeight, displayId, intervalMs}
+   * @return undefined; a second call replaces the options
+   */
+  Napi::Value WatchTargets(const Napi::CallbackInfo& info);
+  
+  /**
+   * @brief JavaScript method to stop emitting "targets-changed"
+   * @param info JavaScript call information
+   * @return undefined
+   */
+  Napi::Value UnwatchTargets(const Napi::CallbackInfo& info);
+  
+  /** Unsubscribe from the target registry and release its thread-safe function */
+  void StopWatchingTargets();
+  
+  /**
+   * @brief JavaScript method to open the capture resources of a coming startCapture()
+   * @param info JavaScript call information with the capture configuration of the coming start
+   * @return Promise that resolves once the target and audio device are open
+   */
+  Napi::Value Prepare(const Napi::CallbackInfo& info);
+  
   /**
    * @brief JavaScript method to start capture
    * @param info JavaScript call information with capture configuration
@@ -191,9 +459,136 @@ class MediaCapture : public Napi::ObjectWrap<MediaCapture> {
   Napi::Value StopCapture(const Napi::CallbackInfo& info);
   
   /**
-   * @brief Perform safe shutdown, stopping capture and cleaning up resources
+   * @brief JavaScript method to start capture straight to disk
+   * @param info JavaScript call information with the capture configuration plus dir, audio and video
+   * @return Promise that resolves once the recording files are open and capture has started
    */
-  void SafeShutdown();
+  Napi::Value StartRecording(const Napi::CallbackInfo& info);
+  
+  /**
+   * @brief JavaScript method to copy the last seconds held by the look-back buffer
+   * @param info JavaScript call information with {seconds, dir}
+   * @return Promise that resolves with {buffer, audio, frames}, or with the directory once the
+   *         snapshot has been written into it
+   */
+  Napi::Value Snapshot(const Napi::CallbackInfo& info);
+  
+  /**
+   * @brief JavaScript method to change settings of the running capture without stopping it
+   * @param info JavaScript call information with the configuration keys to change
+   * @return Promise that resolves once the backend has applied the change
+   */
+  Napi::Value Reconfigure(const Napi::CallbackInfo& info);
+  
+  /**
+   * @brief JavaScript method to change the region of interest while capturing
+   * @param info JavaScript call information with a {x, y, width, height} object or null
+   * @return Promise that resolves once the backend has applied the crop
+   */
+  Napi::Value SetCropRect(const Napi::CallbackInfo& info);
+  
+  /** Record an applied crop in the start configuration that reconfigure() merges into */
+  void RememberCropRect(const MediaCaptureRectC& cropRect, Napi::Value value);
+  
+  /**
+   * @brief JavaScript method to read the adaptive quality controller
+   * @param info JavaScript call information
+   * @return Current settings and decisions, or null when no budget is active
+   */
+  Napi::Value GetQualityStats(const Napi::CallbackInfo& info);
+  
+  /**
+   * @brief JavaScript method to read per-stage counters and latency histograms
+   * @param info JavaScript call information
+   * @return {video, audio, recording, startup} statistics; native counters are zero while not capturing
+   */
+  Napi::Value GetStats(const Napi::CallbackInfo& info);
+  
+  /**
+   * @brief JavaScript method to write the recorded trace spans as Chrome Trace Event JSON
+   * @param info JavaScript call information with the destination path
+   * @return undefined; throws if the file cannot be written
+   */
+  Napi::Value DumpTrace(const Napi::CallbackInfo& info);
+  
+  /**
+   * @brief JavaScript method to hold a track's frames in native memory instead of queuing them
+   * @param info JavaScript call information with the track ("video" or "audio") and optional
+   *        {buffer, overflow} (held item count and "drop-oldest" or "drop-newest")
+   * @return undefined; throws on an unknown track or policy
+   */
+  Napi::Value PauseDelivery(const Napi::CallbackInfo& info);
+  
+  /**
+   * @brief JavaScript method to deliver a track's held items and queue new ones again
+   *
+   * Held items are emitted after the calls already queued for the track, so
+   * listeners see them in capture order.
+   *
+   * @param info JavaScript call information with the track ("video" or "audio")
+   * @return undefined; throws on an unknown track
+   */
+  Napi::Value ResumeDelivery(const Napi::CallbackInfo& info);
+
+  /**
+   * @brief JavaScript method to hold a track for an async iterator instead of emitting it
+   * @param info JavaScript call information with the track, options {buffer, overflow, chunkMs}
+   *        and the function that receives arrays of items after pull() returned null
+   * @return undefined; throws if an iterator is already open on the track
+   */
+  Napi::Value OpenPull(const Napi::CallbackInfo& info);
+  
+  /**
+   * @brief JavaScript method to take the items held for the iterator
+   * @param info JavaScript call information with the track
+   * @return Array of frames or audio chunks, or null if none are held; the next one is then
+   *         passed to the function given to openPull()
+   */
+  Napi::Value Pull(const Napi::CallbackInfo& info);
+  
+  /**
+   * @brief JavaScript method to close the iterator of a track and emit it again
+   * @param info JavaScript call information with the track
+   * @return undefined
+   */
+  Napi::Value ClosePull(const Napi::CallbackInfo& info);
+
+  /**
+   * @brief Build the object "video-frame" emits, on the JavaScript thread
+   * @param env Node.js environment
+   * @param pending Frame to convert; its pooled buffer is recycled
+   * @param delivery Statistics to update
+   */
+  static Napi::Object VideoFrameObject(Napi::Env env, PendingVideoFrame& pending, DeliveryStats& delivery);
+  
+  /**
+   * @brief Build {data, sampleRate, channels, sync} for an audio block, on the JavaScript thread
+   * @see VideoFrameObject
+   */
+  static Napi::Object AudioObject(Napi::Env env, const PendingAudio& pending, DeliveryStats& delivery);
+
+  /**
+   * @brief Hand an audio block or chunk to the gate and queue it for the JavaScript thread (capture thread)
+   * @param instance Capturing instance
+   * @param tsfn Acquired audio thread-safe function
+   * @param pending Block to deliver
+   */
+  static void QueueAudio(MediaCapture* instance, Napi::ThreadSafeFunction& tsfn, PendingAudio& pending);
+
+  /**
+   * @brief Emit a "video-frame" event on the JavaScript thread
+   * @param env Node.js environment
+   * @param emit The instance's emit function
+   * @param pending Frame to emit; its pooled buffer is recycled
+   * @param delivery Statistics to update
+   */
+  static void EmitVideoFrame(Napi::Env env, Napi::Function emit, PendingVideoFrame& pending, DeliveryStats& delivery);
+  
+  /**
+   * @brief Emit an "audio-data" event on the JavaScript thread
+   * @see EmitVideoFrame
+   */
+  static void EmitAudio(Napi::Env env, Napi::Function emit, const PendingAudio& pending, DeliveryStats& delivery);
 
   /** Handle to native capture implementation */
   void* captureHandle_;
@@ -201,6 +596,70 @@ class MediaCapture : public Napi::ObjectWrap<MediaCapture> {
   /** Flag indicating if capture is currently active */
   std::atomic<bool> isCapturing_{false};
   
+  /** Whether this instance turned tracing on and should turn it off when it stops */
+  bool tracing_{false};
+  
+  /** Format delivered to JavaScript; raw formats are converted from BGRA */
+  std::atomic<ImageFormat> imageFormat_{ImageFormat::Jpeg};
+  
+  /** Recycled buffers for frames on their way to the JavaScript thread */
+  std::shared_ptr<FrameBufferPool> framePool_;
+  
+  /** Delta frame state for imageFormat "delta"; accessed with std::atomic_load/store */
+  std::shared_ptr<DeltaFrameEncoder> deltaEncoder_;
+  
+  /** Delivery into JavaScript; shared with queued calls that may outlive a capture */
+  std::shared_ptr<DeliveryStats> deliveryStats_;
+  
+  /** Active recording; frames go here instead of to JavaScript. Accessed with std::atomic_load/store */
+  std::shared_ptr<RecordingSink> recorder_;
+  
+  /** Last seconds of capture for snapshot(), filled instead of delivering; accessed with std::atomic_load/store */
+  std::shared_ptr<LookbackBuffer> lookback_;
+  
+  /** Frames and audio published for other processes; accessed with std::atomic_load/store */
+  std::shared_ptr<SharedRingWriter> sharedRing_;
+  
+  /** Video frames held while a stream has paused delivery; shared with queued drain calls */
+  std::shared_ptr<DeliveryGate<PendingVideoFrame>> videoGate_;
+  
+  /** Audio blocks held while a stream has paused delivery; shared with queued drain calls */
+  std::shared_ptr<DeliveryGate<PendingAudio>> audioGate_;
+  
+  /** Async iterators of the video and audio tracks */
+  std::shared_ptr<PullConsumer> videoPull_;
+  std::shared_ptr<PullConsumer> audioPull_;
+  
+  /** Regroups audio for an iterator opened with chunkMs; accessed with std::atomic_load/store */
+  std::shared_ptr<AudioChunker> audioChunker_;
+  
+  /** Tap streams derived from the captured audio; accessed with std::atomic_load/store */
+  std::shared_ptr<AudioTapSet> audioTaps_;
+  
+  /** Targets of a multi-target capture, indexed by the native target index; set before capture starts */
+  std::vector<MediaCaptureTargetRefC> captureTargets_;
+  
+  /** Configuration of the running capture, with the changes reconfigure() has applied */
+  Napi::ObjectReference captureConfig_;
+  
+  /** captureConfig_ as parsed, so reconfigure() need not read it again; bundleID is left null */
+  MediaCaptureConfigC parsedConfig_ = {};
+  
+  /** Bundle ID of captureConfig_ */
+  std::string bundleId_;
+  
+  /** Time from the last startCapture() to its first video frame and audio block */
+  StartupTiming startup_;
+  
+  /** Progress of the last recording, kept for getStats() after it stops; guarded by mutex_ */
+  RecordingStats lastRecordingStats_;
+  
+  /** Whether lastRecordingStats_ describes a recording */
+  bool hasRecorded_{false};
+  
+  /** First write error of the last recording, reported by stopCapture(); guarded by mutex_ */
+  std::string recordingError_;
+  
   /** Thread-safe function for video frame callbacks */
   Napi::ThreadSafeFunction tsfn_video_;
   
@@ -210,6 +669,12 @@ class MediaCapture : public Napi::ObjectWrap<MediaCapture> {
   /** Thread-safe function for error callbacks */
   Napi::ThreadSafeFunction tsfn_error_;
   
+  /** Thread-safe function for "targets-changed" */
+  Napi::ThreadSafeFunction tsfn_targets_;
+  
+  /** Target registry subscription, 0 while not watching */
+  uint64_t targetWatch_{0};
+  
   /**
    * @name Native Callbacks
    * Static callback functions for the native capture implementation
@@ -231,6 +696,34 @@ class MediaCapture : public Napi::ObjectWrap<MediaCapture> {
                                int32_t bytesPerRow, const char* timestamp,
                                const char* format, size_t actualBufferSize, void* ctx);
   
+  /**
+   * @brief Callback for video frames of a multi-target capture
+   * @param targetIndex Index into captureTargets_
+   * @see VideoFrameCallback for the remaining parameters
+   */
+  static void TargetVideoFrameCallback(int32_t targetIndex, uint8_t* data, int32_t width, int32_t height,
+                                     int32_t bytesPerRow, const char* timestamp,
+                                     const char* format, size_t actualBufferSize, void* ctx);
+  
+  /**
+   * @brief Callback for video frames of a multi-rendition capture
+   * @param rendition Index into the CaptureContext's renditionFormats
+   * @see VideoFrameCallback for the remaining parameters
+   */
+  static void RenditionVideoFrameCallback(int32_t rendition, uint8_t* data, int32_t width, int32_t height,
+                                        int32_t bytesPerRow, const char* timestamp,
+                                        const char* format, size_t actualBufferSize, void* ctx);
+  
+  /**
+   * @brief Deliver a video frame from any of the frame callbacks
+   * @param targetIndex Index into captureTargets_, or -1
+   * @param rendition Index into the CaptureContext's renditionFormats, or -1
+   * @see VideoFrameCallback for the remaining parameters
+   */
+  static void DeliverVideoFrame(int32_t targetIndex, int32_t rendition, uint8_t* data, int32_t width, int32_t height,
+                                int32_t bytesPerRow, const char* timestamp,
+                                const char* format, size_t actualBufferSize, void* ctx);
+  
   /**
    * @brief Callback for audio data
    * @param channels Number of audio channels
@@ -249,6 +742,27 @@ class MediaCapture : public Napi::ObjectWrap<MediaCapture> {
    */
   static void ExitCallback(char* error, void* ctx);
   
+  /**
+   * @brief Callback when prepareMediaCapture() has finished
+   * @param error Error message, or null when the resources are ready
+   * @param ctx User context pointer (PrepareContext*)
+   */
+  static void PrepareCallback(char* error, void* ctx);
+  
+  /**
+   * @brief Callback when reconfigureMediaCapture() has finished
+   * @param error Error message, or null when the change has been applied
+   * @param ctx User context pointer (ReconfigureContext*)
+   */
+  static void ReconfigureCallback(char* error, void* ctx);
+  
+  /**
+   * @brief Callback when setMediaCaptureCropRect() has finished
+   * @param error Error message, or null when the crop has been applied
+   * @param ctx User context pointer (CropRectContext*)
+   */
+  static void CropRectCallback(char* error, void* ctx);
+  
   /**
    * @brief Callback when capture has been stopped
    * @param ctx User context pointer (ContextBase*)
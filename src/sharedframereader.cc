@@ -0,0 +1,120 @@
+#include "sharedframereader.h"
+#include "addondata.h"
+#include <cstring>
+#include <string>
+
+Napi::Object SharedFrameReader::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function func = DefineClass(
+      env, "SharedFrameReader",
+      {InstanceMethod("read", &SharedFrameReader::Read),
+       InstanceMethod("close", &SharedFrameReader::Close),
+       InstanceAccessor("closed", &SharedFrameReader::IsClosed, nullptr)});
+
+  AddonData::Get(env)->sharedFrameReader = Napi::Persistent(func);
+
+  exports.Set("SharedFrameReader", func);
+  return exports;
+}
+
+SharedFrameReader::SharedFrameReader(const Napi::CallbackInfo &info) : Napi::ObjectWrap<SharedFrameReader>(info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "SharedFrameReader expects the sharedMemory name").ThrowAsJavaScriptException();
+    return;
+  }
+
+  std::string name   = info[0].As<Napi::String>().Utf8Value();
+  int         status = sharedRingOpen(name.c_str(), &reader_);
+  if (status != SHARED_RING_OK) {
+    std::string message = status == SHARED_RING_NOT_FOUND ? "No capture is publishing shared memory " + name
+                                                          : "Shared memory " + name + " is not a compatible frame ring";
+    Napi::Error::New(env, message).ThrowAsJavaScriptException();
+    return;
+  }
+
+  for (int track = 0; track < SHARED_RING_TRACKS; track++) {
+    next_[track] = sharedRingWriteIndex(&reader_, track);
+  }
+}
+
+SharedFrameReader::~SharedFrameReader() {
+  sharedRingClose(&reader_);
+}
+
+Napi::Value SharedFrameReader::Read(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  int track = SHARED_RING_VIDEO;
+  if (info.Length() > 0 && !info[0].IsUndefined()) {
+    std::string name = info[0].IsString() ? info[0].As<Napi::String>().Utf8Value() : "";
+    if (name == "audio") {
+      track = SHARED_RING_AUDIO;
+    } else if (name != "video") {
+      Napi::TypeError::New(env, "track must be 'video' or 'audio'").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
+  if (!reader_.base) {
+    return env.Null();
+  }
+
+  uint64_t &next    = next_[track];
+  uint64_t  skipped = 0;
+  for (;;) {
+    SharedRingFrameC frame;
+    int              status = sharedRingBeginRead(&reader_, track, next, &frame);
+    if (status == SHARED_RING_NOT_READY) {
+      return env.Null();
+    }
+    if (status == SHARED_RING_OVERWRITTEN) {
+      uint64_t oldest = sharedRingOldest(&reader_, track);
+      skipped += oldest > next ? oldest - next : 1;
+      next = oldest > next ? oldest : next + 1;
+      continue;
+    }
+    if (status != SHARED_RING_OK) {
+      Napi::Error::New(env, "Shared memory frame ring is corrupt").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+
+    // External buffers are not allowed (Electron), so the payload is copied once and then validated
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, frame.size);
+    std::memcpy(buffer.Data(), frame.data, frame.size);
+    if (!sharedRingEndRead(&reader_, &frame)) {
+      skipped++;
+      next++;
+      continue;
+    }
+    next++;
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("index", Napi::Number::New(env, static_cast<double>(frame.index)));
+    result.Set("skipped", Napi::Number::New(env, static_cast<double>(skipped)));
+    result.Set("timestamp", Napi::Number::New(env, static_cast<double>(frame.timestampMs)));
+    if (track == SHARED_RING_AUDIO) {
+      result.Set("data", Napi::Float32Array::New(env, frame.size / sizeof(float), buffer, 0));
+      result.Set("sampleRate", Napi::Number::New(env, frame.sampleRate));
+      result.Set("channels", Napi::Number::New(env, frame.channels));
+      result.Set("frameCount", Napi::Number::New(env, frame.frameCount));
+    } else {
+      const bool isJpeg = frame.format == SHARED_RING_JPEG;
+      result.Set("data", Napi::Uint8Array::New(env, frame.size, buffer, 0));
+      result.Set("width", Napi::Number::New(env, frame.width));
+      result.Set("height", Napi::Number::New(env, frame.height));
+      result.Set("bytesPerRow", Napi::Number::New(env, frame.bytesPerRow));
+      result.Set("format", Napi::String::New(env, isJpeg ? "jpeg" : "bgra"));
+      result.Set("isJpeg", Napi::Boolean::New(env, isJpeg));
+    }
+    return result;
+  }
+}
+
+Napi::Value SharedFrameReader::IsClosed(const Napi::CallbackInfo &info) {
+  return Napi::Boolean::New(info.Env(), !reader_.base || sharedRingClosed(&reader_));
+}
+
+Napi::Value SharedFrameReader::Close(const Napi::CallbackInfo &info) {
+  sharedRingClose(&reader_);
+  return info.Env().Undefined();
+}
@@ -0,0 +1,49 @@
+/**
+ * @file sharedframereader.h
+ * @brief Node.js binding that reads a shared-memory frame ring from another process
+ *
+ * The reader side of the `sharedMemory` capture option for processes that run
+ * JavaScript (a worker, a utility process, a separate Node service). Native
+ * consumers should use include/capture/sharedring.h directly.
+ */
+#ifndef _SHARED_FRAME_READER_H_
+#define _SHARED_FRAME_READER_H_
+
+#include <napi.h>
+#include <cstdint>
+
+#include "capture/sharedring.h"
+
+class SharedFrameReader : public Napi::ObjectWrap<SharedFrameReader> {
+public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+  /**
+   * @brief Map the ring published under info[0]; throws if there is none
+   *
+   * Reading starts with the next item published after the reader was created.
+   */
+  SharedFrameReader(const Napi::CallbackInfo &info);
+  ~SharedFrameReader();
+
+private:
+  /**
+   * @brief Next item of a track ("video" by default, or "audio"), or null if none is ready
+   *
+   * The payload is copied out of the ring and checked against the sequence
+   * lock, so the returned data is always a consistent frame. `skipped` counts
+   * items the writer overwrote before they could be read.
+   */
+  Napi::Value Read(const Napi::CallbackInfo &info);
+
+  /** @brief Whether the capture has stopped publishing */
+  Napi::Value IsClosed(const Napi::CallbackInfo &info);
+
+  /** @brief Unmap the ring; read() returns null afterwards */
+  Napi::Value Close(const Napi::CallbackInfo &info);
+
+  SharedRingReaderC reader_ = {};
+  uint64_t          next_[SHARED_RING_TRACKS] = {};
+};
+
+#endif // _SHARED_FRAME_READER_H_
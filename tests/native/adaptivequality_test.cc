@@ -0,0 +1,235 @@
+#include "adaptivequality.h"
+#include "framescale.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+/**
+ * Simulated JPEG encoder: cost grows with the number of pixels and (mildly)
+ * with quality; size grows with pixels and steeply with quality. Frames that
+ * take longer than the frame interval back up in the queue.
+ */
+struct SimulatedEncoder {
+  double  msPerMegapixel = 10;
+  double  bytesPerPixel  = 0.3;
+  int32_t width          = 1920;
+  int32_t height         = 1080;
+  int64_t nowNs          = 0;
+
+  EncodeSample encode(const QualitySettings &settings) {
+    const double pixels   = static_cast<double>(width) * height * settings.scale * settings.scale;
+    const double interval = 1000.0 / settings.frameRate;
+
+    EncodeSample sample;
+    sample.encodeMs   = msPerMegapixel * pixels / 1e6 * (0.6 + 0.4 * settings.quality / 100.0);
+    sample.bytes      = static_cast<size_t>(pixels * bytesPerPixel * std::pow(settings.quality / 75.0, 2.0));
+    sample.queueDepth = sample.encodeMs > interval ? 2 : 0;
+    nowNs += static_cast<int64_t>(std::max(interval, sample.encodeMs) * 1e6);
+    sample.timestampNs = nowNs;
+    return sample;
+  }
+
+  /** Run the closed loop for a number of frames */
+  void run(AdaptiveQualityController &controller, int frames) {
+    for (int i = 0; i < frames; i++) {
+      controller.addSample(encode(controller.settings()));
+    }
+  }
+};
+
+QualitySettings configured() {
+  QualitySettings settings;
+  settings.quality   = 90;
+  settings.scale     = 1.0;
+  settings.frameRate = 30;
+  return settings;
+}
+
+} // namespace
+
+TEST(AdaptiveQuality, DisabledWithoutBudget) {
+  AdaptiveQualityController controller({}, {}, configured());
+  SimulatedEncoder          encoder;
+  encoder.msPerMegapixel = 1000;
+
+  EXPECT_FALSE(controller.enabled());
+  encoder.run(controller, 200);
+  EXPECT_EQ(controller.stats().downgrades, 0u);
+  EXPECT_EQ(controller.settings().scale, 1.0);
+  // Measurements are still reported
+  EXPECT_GT(controller.stats().encodeMs, 100);
+}
+
+TEST(AdaptiveQuality, EncodeTimeBudgetDownscalesFirst) {
+  QualityBudget budget;
+  budget.maxEncodeMsPerFrame = 8;
+  AdaptiveQualityController controller(budget, {}, configured());
+  SimulatedEncoder          encoder; // ~19 ms per 1080p frame at quality 90
+
+  encoder.run(controller, 300);
+
+  AdaptiveQualityStats stats = controller.stats();
+  EXPECT_LT(stats.settings.scale, 1.0);
+  EXPECT_EQ(stats.settings.quality, 90);
+  EXPECT_EQ(stats.settings.frameRate, 30);
+  EXPECT_EQ(stats.lastPressure, QualityPressure::EncodeTime);
+  EXPECT_LE(stats.encodeMs, budget.maxEncodeMsPerFrame);
+}
+
+TEST(AdaptiveQuality, BandwidthBudgetLowersQualityFirst) {
+  QualityBudget budget;
+  budget.maxBytesPerSecond = 15e6; // ~27 MB/s at quality 90
+  AdaptiveQualityController controller(budget, {}, configured());
+  SimulatedEncoder          encoder;
+
+  encoder.run(controller, 300);
+
+  AdaptiveQualityStats stats = controller.stats();
+  EXPECT_LT(stats.settings.quality, 90);
+  EXPECT_EQ(stats.settings.scale, 1.0);
+  EXPECT_EQ(stats.lastPressure, QualityPressure::Bandwidth);
+  EXPECT_LE(stats.bytesPerSecond, budget.maxBytesPerSecond);
+}
+
+TEST(AdaptiveQuality, StaysWithinBounds) {
+  QualityBudget budget;
+  budget.maxEncodeMsPerFrame = 0.01; // unreachable
+  budget.maxBytesPerSecond   = 1;
+  QualityBounds bounds;
+  bounds.minQuality   = 40;
+  bounds.minScale     = 0.5;
+  bounds.minFrameRate = 5;
+  AdaptiveQualityController controller(budget, bounds, configured());
+  SimulatedEncoder          encoder;
+
+  encoder.run(controller, 1000);
+
+  QualitySettings settings = controller.settings();
+  EXPECT_EQ(settings.quality, 40);
+  EXPECT_DOUBLE_EQ(settings.scale, 0.5);
+  EXPECT_DOUBLE_EQ(settings.frameRate, 5);
+}
+
+TEST(AdaptiveQuality, RecoversWhenLoadDrops) {
+  QualityBudget budget;
+  budget.maxEncodeMsPerFrame = 8;
+  AdaptiveQualityController controller(budget, {}, configured());
+  SimulatedEncoder          encoder;
+  encoder.msPerMegapixel = 40; // e.g. video playing full screen
+
+  encoder.run(controller, 300);
+  QualitySettings loaded = controller.settings();
+  EXPECT_LT(loaded.scale, 0.5);
+
+  encoder.msPerMegapixel = 2; // screen went idle
+  encoder.run(controller, 1000);
+
+  AdaptiveQualityStats stats = controller.stats();
+  EXPECT_GT(stats.upgrades, 0u);
+  EXPECT_DOUBLE_EQ(stats.settings.scale, 1.0);
+  EXPECT_DOUBLE_EQ(stats.settings.frameRate, 30);
+  EXPECT_EQ(stats.settings.quality, 90);
+}
+
+TEST(AdaptiveQuality, NoOscillationAtSteadyLoad) {
+  QualityBudget budget;
+  budget.maxEncodeMsPerFrame = 8;
+  AdaptiveQualityController controller(budget, {}, configured());
+  SimulatedEncoder          encoder;
+
+  encoder.run(controller, 300);
+  AdaptiveQualityStats before = controller.stats();
+  encoder.run(controller, 1000);
+  AdaptiveQualityStats after = controller.stats();
+
+  // A step up would overshoot the budget and immediately be undone
+  EXPECT_LE(after.downgrades + after.upgrades - before.downgrades - before.upgrades, 2u);
+}
+
+TEST(AdaptiveQuality, BacklogLowersLoad) {
+  QualityBudget budget;
+  budget.maxEncodeMsPerFrame = 1000;
+  AdaptiveQualityController controller(budget, {}, configured());
+
+  EncodeSample sample;
+  sample.encodeMs   = 5;
+  sample.bytes      = 1000;
+  sample.queueDepth = 2;
+  for (int i = 0; i < 20; i++) {
+    sample.timestampNs += 33000000;
+    controller.addSample(sample);
+  }
+
+  AdaptiveQualityStats stats = controller.stats();
+  EXPECT_EQ(stats.lastPressure, QualityPressure::Backlog);
+  EXPECT_EQ(stats.lastAdjustment, QualityAdjustment::LowerScale);
+}
+
+TEST(AdaptiveQuality, ReconfigureRestartsFromNewSettings) {
+  QualityBudget budget;
+  budget.maxEncodeMsPerFrame = 8;
+  AdaptiveQualityController controller(budget, {}, configured());
+  SimulatedEncoder          encoder;
+  encoder.msPerMegapixel = 40;
+
+  encoder.run(controller, 300);
+  EXPECT_LT(controller.settings().scale, 1.0);
+
+  // New settings apply at once; dropping the budget stops further adjustments
+  QualitySettings lower = configured();
+  lower.quality         = 60;
+  lower.frameRate       = 10;
+  controller.reconfigure({}, {}, lower);
+  EXPECT_FALSE(controller.enabled());
+  encoder.run(controller, 300);
+
+  QualitySettings settings = controller.settings();
+  EXPECT_EQ(settings.quality, 60);
+  EXPECT_DOUBLE_EQ(settings.scale, 1.0);
+  EXPECT_DOUBLE_EQ(settings.frameRate, 10);
+}
+
+TEST(FrameScale, ScaledDimension) {
+  EXPECT_EQ(scaledDimension(1920, 0.5), 960);
+  EXPECT_EQ(scaledDimension(1080, 0.75), 810);
+  EXPECT_EQ(scaledDimension(3, 0.01), 1);
+}
+
+TEST(FrameScale, BoxFilterAveragesCoveredPixels) {
+  // 4x2 source: two 2x2 blocks
+  const uint8_t src[2][16] = {
+      {0,  0,  0,  255, 4,  8,  12, 255, 100, 100, 100, 255, 200, 200, 200, 255},
+      {8,  16, 24, 255, 12, 24, 36, 255, 100, 100, 100, 255, 200, 200, 200, 255},
+  };
+  uint8_t dst[8];
+  downscaleBGRA(&src[0][0], 16, 4, 2, dst, 8, 2, 1);
+
+  const uint8_t expected[8] = {6, 12, 18, 255, 150, 150, 150, 255};
+  for (int i = 0; i < 8; i++) {
+    EXPECT_EQ(dst[i], expected[i]) << "byte " << i;
+  }
+}
+
+TEST(FrameScale, NonIntegerRatioKeepsUniformColour) {
+  const int32_t        srcWidth = 37, srcHeight = 23, srcStride = srcWidth * 4 + 8;
+  std::vector<uint8_t> src(static_cast<size_t>(srcStride) * srcHeight);
+  for (int32_t y = 0; y < srcHeight; y++) {
+    for (int32_t x = 0; x < srcWidth; x++) {
+      uint8_t *p = &src[y * srcStride + x * 4];
+      p[0] = 10, p[1] = 20, p[2] = 30, p[3] = 255;
+    }
+  }
+
+  const int32_t        dstWidth = scaledDimension(srcWidth, 0.7), dstHeight = scaledDimension(srcHeight, 0.7);
+  std::vector<uint8_t> dst(static_cast<size_t>(dstWidth) * dstHeight * 4);
+  downscaleBGRA(src.data(), srcStride, srcWidth, srcHeight, dst.data(), dstWidth * 4, dstWidth, dstHeight);
+
+  for (size_t i = 0; i < dst.size(); i += 4) {
+    ASSERT_EQ(dst[i], 10);
+    ASSERT_EQ(dst[i + 1], 20);
+    ASSERT_EQ(dst[i + 2], 30);
+    ASSERT_EQ(dst[i + 3], 255);
+  }
+}
@@ -0,0 +1,90 @@
+#include "audiochunker.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+struct Chunk {
+  std::vector<float> samples;
+  SyncStamp          stamp;
+};
+
+/** Blocks of a running counter, so chunk contents show where they came from */
+std::vector<float> counterBlock(uint32_t frames, int32_t channels, float &next) {
+  std::vector<float> block(static_cast<size_t>(frames) * channels);
+  for (float &sample : block) {
+    sample = next++;
+  }
+  return block;
+}
+
+} // namespace
+
+TEST(AudioChunker, RegroupsBlocksIntoFixedChunks) {
+  AudioChunker       chunker(10); // 480 frames at 48 kHz
+  std::vector<Chunk> chunks;
+  auto               collect = [&](const float *samples, uint32_t frames, const SyncStamp &stamp) {
+    chunks.push_back({std::vector<float>(samples, samples + frames * 2), stamp});
+  };
+
+  float   next = 0;
+  int64_t position = 0;
+  for (uint32_t frames : {300u, 300u, 1200u, 100u}) {
+    SyncStamp stamp;
+    stamp.valid         = true;
+    stamp.captureNs     = position * 1000000000 / 48000;
+    stamp.hasAudio      = true;
+    stamp.audioPosition = position;
+    std::vector<float> block = counterBlock(frames, 2, next);
+    chunker.push(block.data(), frames, 2, 48000, stamp, collect);
+    position += frames;
+  }
+
+  // 1900 frames make three whole chunks and leave 460 pending
+  ASSERT_EQ(chunks.size(), 3u);
+  for (size_t i = 0; i < chunks.size(); i++) {
+    ASSERT_EQ(chunks[i].samples.size(), 960u);
+    EXPECT_EQ(chunks[i].samples.front(), static_cast<float>(i * 960));
+    EXPECT_EQ(chunks[i].samples.back(), static_cast<float>(i * 960 + 959));
+    EXPECT_EQ(chunks[i].stamp.audioPosition, static_cast<int64_t>(i * 480));
+    EXPECT_NEAR(static_cast<double>(chunks[i].stamp.captureNs), i * 10e6, 1e3);
+  }
+
+  chunker.flush(collect);
+  ASSERT_EQ(chunks.size(), 4u);
+  EXPECT_EQ(chunks[3].samples.size(), 920u);
+  EXPECT_EQ(chunks[3].stamp.audioPosition, 1440);
+}
+
+TEST(AudioChunker, FormatChangePassesOnThePartialChunk) {
+  AudioChunker          chunker(20);
+  std::vector<uint32_t> sizes;
+  std::vector<int32_t>  rates;
+  auto                  collect = [&](const float *, uint32_t frames, const SyncStamp &) {
+    sizes.push_back(frames);
+    rates.push_back(chunker.sampleRate());
+  };
+
+  float              next  = 0;
+  std::vector<float> block = counterBlock(500, 1, next);
+  chunker.push(block.data(), 500, 1, 48000, SyncStamp(), collect);
+  chunker.push(block.data(), 500, 1, 16000, SyncStamp(), collect);
+
+  // 20 ms is 960 frames at 48 kHz and 320 at 16 kHz
+  EXPECT_EQ(sizes, (std::vector<uint32_t>{500, 320}));
+  EXPECT_EQ(rates, (std::vector<int32_t>{48000, 16000}));
+}
+
+TEST(AudioChunker, ZeroDurationPassesBlocksThrough) {
+  AudioChunker          chunker(0);
+  std::vector<uint32_t> sizes;
+  float                 next  = 0;
+  std::vector<float>    block = counterBlock(123, 2, next);
+  chunker.push(block.data(), 123, 2, 44100, SyncStamp(),
+               [&](const float *samples, uint32_t frames, const SyncStamp &) {
+                 EXPECT_EQ(samples, block.data());
+                 sizes.push_back(frames);
+               });
+  EXPECT_EQ(sizes, (std::vector<uint32_t>{123}));
+}
@@ -0,0 +1,38 @@
+#include "audioconvert.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(AudioConvert, DownmixAveragesChannels) {
+  const std::vector<float> stereo = {1.0f, 0.0f, 0.5f, 0.5f, -1.0f, 1.0f};
+  std::vector<float>       mono(3);
+  downmixToMono(stereo.data(), 2, 3, mono.data());
+  EXPECT_FLOAT_EQ(mono[0], 0.5f);
+  EXPECT_FLOAT_EQ(mono[1], 0.5f);
+  EXPECT_FLOAT_EQ(mono[2], 0.0f);
+
+  const std::vector<float> surround = {0.3f, 0.3f, 0.3f, 0.3f, 0.3f, 0.3f};
+  std::vector<float>       single(1);
+  downmixToMono(surround.data(), 6, 1, single.data());
+  EXPECT_FLOAT_EQ(single[0], 0.3f);
+}
+
+TEST(AudioConvert, DownmixOfMonoCopies) {
+  const std::vector<float> mono = {0.1f, -0.2f};
+  std::vector<float>       out(2);
+  downmixToMono(mono.data(), 1, 2, out.data());
+  EXPECT_EQ(out, mono);
+}
+
+TEST(AudioConvert, FloatToInt16RoundsAndClamps) {
+  const std::vector<float> in = {0.0f, 1.0f, -1.0f, 2.0f, -2.0f, 0.5f, -0.5f, 1.0f / 32767.0f * 0.4f};
+  std::vector<int16_t>     out(in.size());
+  convertFloatToInt16(in.data(), in.size(), out.data());
+  EXPECT_EQ(out[0], 0);
+  EXPECT_EQ(out[1], 32767);
+  EXPECT_EQ(out[2], -32767);
+  EXPECT_EQ(out[3], 32767);
+  EXPECT_EQ(out[4], -32767);
+  EXPECT_EQ(out[5], 16384);
+  EXPECT_EQ(out[6], -16384);
+  EXPECT_EQ(out[7], 0);
+}
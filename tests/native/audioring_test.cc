@@ -0,0 +1,64 @@
+#include "audioring.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+TEST(AudioRingBuffer, WrapsAroundTheEnd) {
+  AudioRingBuffer ring(8);
+  float           in[6] = {1, 2, 3, 4, 5, 6};
+  float           out[6];
+
+  ASSERT_EQ(ring.write(in, 6), 6u);
+  ASSERT_EQ(ring.read(out, 4), 4u);
+  ASSERT_EQ(ring.write(in, 6), 6u); // Spans the end of the storage
+  EXPECT_EQ(ring.available(), 8u);
+
+  ASSERT_EQ(ring.read(out, 2), 2u);
+  EXPECT_EQ(out[0], 5);
+  EXPECT_EQ(out[1], 6);
+  ASSERT_EQ(ring.read(out, 6), 6u);
+  for (int i = 0; i < 6; i++) {
+    EXPECT_EQ(out[i], in[i]);
+  }
+  EXPECT_EQ(ring.read(out, 1), 0u);
+}
+
+TEST(AudioRingBuffer, DropsNewestSamplesWhenFull) {
+  AudioRingBuffer ring(4);
+  float           in[6] = {1, 2, 3, 4, 5, 6};
+  float           out[4];
+
+  EXPECT_EQ(ring.write(in, 6), 4u);
+  EXPECT_EQ(ring.overruns(), 2u);
+  ASSERT_EQ(ring.read(out, 4), 4u);
+  EXPECT_EQ(out[3], 4);
+}
+
+TEST(AudioRingBuffer, ConcurrentProducerConsumer) {
+  AudioRingBuffer ring(1000);
+  const int       total = 200000;
+
+  std::thread producer([&] {
+    float block[37];
+    int   next = 0;
+    while (next < total) {
+      int count = std::min(37, total - next);
+      for (int i = 0; i < count; i++) {
+        block[i] = static_cast<float>(next + i);
+      }
+      next += static_cast<int>(ring.write(block, count));
+    }
+  });
+
+  std::vector<float> received;
+  float              block[53];
+  while (static_cast<int>(received.size()) < total) {
+    size_t got = ring.read(block, 53);
+    received.insert(received.end(), block, block + got);
+  }
+  producer.join();
+
+  for (int i = 0; i < total; i++) {
+    ASSERT_EQ(received[i], static_cast<float>(i));
+  }
+}
@@ -0,0 +1,250 @@
+#include "audioconvert.h"
+#include "audiotaps.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+std::vector<float> tone(double frequency, int32_t sampleRate, uint32_t frames, int32_t channels = 1) {
+  std::vector<float> samples(static_cast<size_t>(frames) * channels);
+  for (uint32_t i = 0; i < frames; i++) {
+    float value = static_cast<float>(0.5 * std::sin(2.0 * kPi * frequency * i / sampleRate));
+    for (int32_t ch = 0; ch < channels; ch++) {
+      samples[static_cast<size_t>(i) * channels + ch] = ch == 0 ? value : -value;
+    }
+  }
+  return samples;
+}
+
+/** Resample in blocks of the given sizes, cycling through them */
+std::vector<float> resample(AudioResampler &resampler, const std::vector<float> &input, int32_t channels,
+                            const std::vector<uint32_t> &blocks) {
+  std::vector<float> output, block;
+  size_t             frames = input.size() / channels;
+  size_t             offset = 0;
+  for (size_t i = 0; offset < frames; i++) {
+    uint32_t count = static_cast<uint32_t>(std::min<size_t>(blocks[i % blocks.size()], frames - offset));
+    resampler.process(input.data() + offset * channels, count, block);
+    output.insert(output.end(), block.begin(), block.end());
+    offset += count;
+  }
+  return output;
+}
+
+struct TapChunk {
+  size_t               tap;
+  std::vector<float>   samples;
+  std::vector<int16_t> pcm16;
+  uint32_t             frames;
+  int32_t              channels;
+  int32_t              sampleRate;
+  SyncStamp            stamp;
+};
+
+} // namespace
+
+TEST(AudioResampler, KeepsToneLevelAndTiming) {
+  // 48000 -> 16001 has no small common ratio and takes the interpolated kernel
+  const int32_t pairs[][2] = {{48000, 16000}, {44100, 48000}, {16000, 48000}, {48000, 16001}};
+  for (const auto &pair : pairs) {
+    AudioResampler resampler;
+    resampler.configure(pair[0], pair[1], 1);
+    std::vector<float> output = resample(resampler, tone(1000, pair[0], pair[0]), 1, {480});
+
+    // Output frame k is the input at time k / outputRate, so it matches the tone at the new rate.
+    // The kernel still overlaps the silence before the tone for the first halfWidth input frames.
+    ASSERT_GT(output.size(), static_cast<size_t>(pair[1]) * 9 / 10) << pair[0] << " -> " << pair[1];
+    size_t settled  = static_cast<size_t>(resampler.halfWidth()) * pair[1] / pair[0] + 1;
+    double maxError = 0;
+    for (size_t k = settled; k < output.size(); k++) {
+      double expected = 0.5 * std::sin(2.0 * kPi * 1000 * k / pair[1]);
+      maxError        = std::max(maxError, std::fabs(output[k] - expected));
+    }
+    EXPECT_LT(maxError, 0.01) << pair[0] << " -> " << pair[1];
+  }
+}
+
+TEST(AudioResampler, RejectsFrequenciesAboveTheNewNyquist) {
+  AudioResampler resampler;
+  resampler.configure(48000, 16000, 1);
+  std::vector<float> output = resample(resampler, tone(12000, 48000, 48000), 1, {512});
+
+  // Without filtering, 12 kHz would fold to 4 kHz at full level
+  double energy = 0;
+  size_t skip   = resampler.halfWidth();
+  for (size_t k = skip; k < output.size(); k++) {
+    energy += output[k] * output[k];
+  }
+  double rms = std::sqrt(energy / (output.size() - skip));
+  EXPECT_LT(rms, 0.5 / std::sqrt(2.0) * 0.01); // -40 dB
+}
+
+TEST(AudioResampler, OutputDoesNotDependOnBlockSizes) {
+  std::vector<float> input = tone(440, 44100, 22050, 2);
+
+  AudioResampler whole, split;
+  whole.configure(44100, 16000, 2);
+  split.configure(44100, 16000, 2);
+  std::vector<float> reference = resample(whole, input, 2, {22050});
+  std::vector<float> chunked   = resample(split, input, 2, {1, 7, 441, 13, 1024});
+
+  ASSERT_EQ(reference.size(), chunked.size());
+  for (size_t i = 0; i < reference.size(); i++) {
+    ASSERT_FLOAT_EQ(reference[i], chunked[i]) << i;
+  }
+}
+
+TEST(AudioTapSet, DerivesEachTapFromOneCapture) {
+  AudioTapSet taps;
+  EXPECT_EQ(taps.addTap({0, 0, AudioSampleFormat::Float32, 10}), 0u);
+  EXPECT_EQ(taps.addTap({16000, 1, AudioSampleFormat::Int16, 20}), 1u);
+  EXPECT_EQ(taps.addTap({48000, 1, AudioSampleFormat::Float32, 0}), 2u);
+
+  int32_t rate = 16000, channels = 1;
+  taps.preferredCaptureFormat(rate, channels);
+  EXPECT_EQ(rate, 48000);
+  EXPECT_EQ(channels, 1);
+
+  std::vector<TapChunk> chunks;
+  auto                  collect = [&](const AudioTapChunk &chunk) {
+    size_t   count = static_cast<size_t>(chunk.frames) * chunk.channels;
+    TapChunk copy{chunk.tap, std::vector<float>(chunk.samples, chunk.samples + count), {}, chunk.frames,
+                  chunk.channels, chunk.sampleRate, chunk.stamp};
+    if (chunk.pcm16) {
+      copy.pcm16.assign(chunk.pcm16, chunk.pcm16 + count);
+    }
+    chunks.push_back(std::move(copy));
+  };
+
+  std::vector<float> capture = tone(1000, 48000, 48000, 2);
+  for (uint32_t offset = 0; offset < 48000; offset += 441) {
+    uint32_t  frames = std::min(441u, 48000 - offset);
+    SyncStamp stamp;
+    stamp.valid         = true;
+    stamp.captureNs     = static_cast<int64_t>(offset) * 1000000000 / 48000;
+    stamp.hasAudio      = true;
+    stamp.audioPosition = offset;
+    taps.push(capture.data() + static_cast<size_t>(offset) * 2, frames, 2, 48000, stamp, collect);
+  }
+
+  size_t counts[3] = {0, 0, 0};
+  for (const TapChunk &chunk : chunks) {
+    counts[chunk.tap]++;
+    if (chunk.tap == 0) {
+      // Full-rate stereo float, regrouped into 10 ms
+      EXPECT_EQ(chunk.frames, 480u);
+      EXPECT_EQ(chunk.channels, 2);
+      EXPECT_EQ(chunk.sampleRate, 48000);
+      EXPECT_TRUE(chunk.pcm16.empty());
+    } else if (chunk.tap == 1) {
+      // 16 kHz mono PCM in 20 ms chunks, stamped on the 16 kHz clock
+      size_t index = counts[1] - 1;
+      EXPECT_EQ(chunk.frames, 320u);
+      EXPECT_EQ(chunk.channels, 1);
+      EXPECT_EQ(chunk.sampleRate, 16000);
+      EXPECT_EQ(chunk.stamp.audioPosition, static_cast<int64_t>(index * 320));
+      EXPECT_NEAR(static_cast<double>(chunk.stamp.captureNs), index * 20e6, 1e3);
+      std::vector<int16_t> expected(chunk.frames);
+      convertFloatToInt16(chunk.samples.data(), chunk.frames, expected.data());
+      EXPECT_EQ(chunk.pcm16, expected);
+    } else {
+      // The shared downmix of an antiphase pair is silence
+      EXPECT_EQ(chunk.channels, 1);
+      for (float sample : chunk.samples) {
+        ASSERT_EQ(sample, 0.0f);
+      }
+    }
+  }
+  EXPECT_EQ(counts[0], 100u);
+  EXPECT_GE(counts[1], 49u);
+  EXPECT_EQ(counts[2], (48000 + 440) / 441);
+
+  size_t before = chunks.size();
+  taps.flush(collect);
+  EXPECT_EQ(chunks.size(), before + 1); // only the 16 kHz tap had a partial chunk pending
+}
+
+TEST(AudioTapSet, FormatChangeRestartsTheTaps) {
+  AudioTapSet taps;
+  taps.addTap({16000, 1, AudioSampleFormat::Float32, 0});
+
+  std::vector<TapChunk> chunks;
+  auto                  collect = [&](const AudioTapChunk &chunk) {
+    chunks.push_back({chunk.tap, {}, {}, chunk.frames, chunk.channels, chunk.sampleRate, chunk.stamp});
+  };
+
+  std::vector<float> stereo = tone(1000, 48000, 4800, 2);
+  taps.push(stereo.data(), 4800, 2, 48000, SyncStamp(), collect);
+  std::vector<float> mono = tone(1000, 32000, 3200, 1);
+  taps.push(mono.data(), 3200, 1, 32000, SyncStamp(), collect);
+
+  // Both blocks come out at the tap format
+  ASSERT_EQ(chunks.size(), 2u);
+  for (const TapChunk &chunk : chunks) {
+    EXPECT_EQ(chunk.channels, 1);
+    EXPECT_EQ(chunk.sampleRate, 16000);
+    EXPECT_GT(chunk.frames, 1500u);
+    EXPECT_LE(chunk.frames, 1600u);
+  }
+}
+
+TEST(AudioTapSet, LogMelTapEmitsFeatureFrames) {
+  AudioTapSet    taps;
+  AudioTapConfig features;
+  features.sampleRate = 16000;
+  features.format     = AudioSampleFormat::LogMel;
+  features.chunkMs    = 100;
+  taps.addTap(features);
+
+  std::vector<TapChunk> chunks;
+  std::vector<float>    matrix;
+  auto                  collect = [&](const AudioTapChunk &chunk) {
+    ASSERT_NE(chunk.features, nullptr);
+    EXPECT_EQ(chunk.melBins, 80);
+    EXPECT_EQ(chunk.channels, 1);
+    EXPECT_EQ(chunk.sampleRate, 16000);
+    matrix.insert(matrix.end(), chunk.features, chunk.features + chunk.featureFrames * chunk.melBins);
+    chunks.push_back({chunk.tap, {}, {}, chunk.featureFrames, chunk.channels, chunk.sampleRate, chunk.stamp});
+  };
+
+  // The same tone on both channels, downmixed and resampled to 16 kHz before the features
+  std::vector<float> mono = tone(1000, 48000, 48000);
+  std::vector<float> block(480 * 2);
+  for (uint32_t offset = 0; offset < 48000; offset += 480) {
+    SyncStamp stamp;
+    stamp.valid         = true;
+    stamp.captureNs     = static_cast<int64_t>(offset) * 1000000000 / 48000;
+    stamp.hasAudio      = true;
+    stamp.audioPosition = offset;
+    for (uint32_t i = 0; i < 480; i++) {
+      block[2 * i] = block[2 * i + 1] = mono[offset + i];
+    }
+    taps.push(block.data(), 480, 2, 48000, stamp, collect);
+  }
+
+  // Each 100 ms chunk of 16 kHz audio completes about ten 10 ms frames, stamped on the 16 kHz clock
+  ASSERT_GE(chunks.size(), 8u);
+  int64_t expected = 0;
+  for (const TapChunk &chunk : chunks) {
+    EXPECT_EQ(chunk.stamp.audioPosition, expected);
+    EXPECT_NEAR(static_cast<double>(chunk.stamp.captureNs), expected * 1e9 / 16000, 1e5);
+    expected += static_cast<int64_t>(chunk.frames) * 160;
+  }
+
+  // The 1 kHz tone dominates every frame
+  MelSpectrogram reference(features.mel);
+  size_t         toneBin = 0;
+  while (reference.filterEdges()[toneBin + 2] < 1000.0) {
+    toneBin++;
+  }
+  for (size_t row = 0; row < matrix.size() / 80; row++) {
+    const float *frame = matrix.data() + row * 80;
+    size_t       peak  = std::max_element(frame, frame + 80) - frame;
+    EXPECT_LE(peak > toneBin ? peak - toneBin : toneBin - peak, 1u) << row;
+  }
+}
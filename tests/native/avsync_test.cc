@@ -0,0 +1,105 @@
+#include "avsync.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <thread>
+
+namespace {
+
+constexpr int32_t  kRate      = 48000;
+constexpr uint32_t kBlock     = 480; // 10 ms
+constexpr int64_t  kBlockNs   = 10000000;
+constexpr int64_t  kStartNs   = 5000000000;
+constexpr int64_t  kOneSample = 1000000000 / kRate;
+
+/** Deterministic lateness of 0-5 ms, like a delivery thread woken at irregular times */
+int64_t lateness(uint32_t &state) {
+  state = state * 1664525u + 1013904223u;
+  return static_cast<int64_t>(state >> 8) % 5000000;
+}
+
+} // namespace
+
+TEST(AvSyncClock, StampsWithoutAudioHaveNoPosition) {
+  AvSyncClock clock;
+  SyncStamp   stamp = clock.stampAt(kStartNs);
+  EXPECT_TRUE(stamp.valid);
+  EXPECT_EQ(stamp.captureNs, kStartNs);
+  EXPECT_FALSE(stamp.hasAudio);
+
+  SyncStamp unclocked = syncStampAt(nullptr, kStartNs);
+  EXPECT_TRUE(unclocked.valid);
+  EXPECT_FALSE(unclocked.hasAudio);
+}
+
+TEST(AvSyncClock, FiltersLateReports) {
+  AvSyncClock clock;
+  uint32_t    state = 7;
+  for (int64_t block = 0; block < 300; block++) {
+    int64_t position = clock.addAudio(kStartNs + block * kBlockNs + lateness(state), kBlock, kRate);
+    EXPECT_EQ(position, block * kBlock);
+  }
+  EXPECT_EQ(clock.audioFrames(), 300 * static_cast<int64_t>(kBlock));
+
+  // A frame captured 2.5 s in matches sample 120000, within the filtered jitter
+  SyncStamp stamp = clock.stampAt(kStartNs + 2500000000);
+  ASSERT_TRUE(stamp.hasAudio);
+  EXPECT_NEAR(static_cast<double>(stamp.audioPosition), 120000.0, 48.0);
+
+  // Audio blocks get the same smoothed time back
+  SyncStamp audio = clock.stampForAudio(120000);
+  EXPECT_NEAR(static_cast<double>(audio.captureNs), static_cast<double>(kStartNs + 2500000000), 1000000.0);
+
+  // Video captured before the first sample has a negative position
+  EXPECT_LT(clock.stampAt(kStartNs - 100000000).audioPosition, 0);
+}
+
+TEST(AvSyncClock, FollowsDriftBetweenDeviceAndSystemClock) {
+  for (double ratio : {1.001, 0.999}) {
+    AvSyncClock clock;
+    int64_t     lastNs = 0;
+    for (int64_t block = 0; block < 2000; block++) {
+      // The device produces 48000 samples per ratio seconds of system time
+      lastNs = kStartNs + static_cast<int64_t>(static_cast<double>(block * kBlockNs) * ratio);
+      clock.addAudio(lastNs, kBlock, kRate);
+    }
+    SyncStamp stamp = clock.stampAt(lastNs);
+    ASSERT_TRUE(stamp.hasAudio);
+    // Within 2 ms after 20 s, where a fixed origin would be 20 ms off
+    EXPECT_NEAR(static_cast<double>(stamp.audioPosition), 1999.0 * kBlock, 96.0) << ratio;
+  }
+}
+
+TEST(AvSyncClock, StartsOverAfterAGapInTheAudio) {
+  AvSyncClock clock;
+  for (int64_t block = 0; block < 50; block++) {
+    clock.addAudio(kStartNs + block * kBlockNs, kBlock, kRate);
+  }
+  // Half a second without audio, then the stream resumes with the next position
+  int64_t resumeNs = kStartNs + 50 * kBlockNs + 500000000;
+  int64_t resumed  = clock.addAudio(resumeNs, kBlock, kRate);
+  EXPECT_EQ(resumed, 50 * static_cast<int64_t>(kBlock));
+
+  SyncStamp stamp = clock.stampAt(resumeNs);
+  EXPECT_NEAR(static_cast<double>(stamp.audioPosition), static_cast<double>(resumed), 1.0);
+  EXPECT_NEAR(static_cast<double>(clock.stampForAudio(resumed).captureNs), static_cast<double>(resumeNs),
+              static_cast<double>(kOneSample));
+
+  clock.reset();
+  EXPECT_FALSE(clock.stampAt(resumeNs).hasAudio);
+  EXPECT_EQ(clock.audioFrames(), 0);
+}
+
+TEST(AvSyncClock, CurrentStampIsPerThread) {
+  SyncStamp stamp;
+  stamp.valid     = true;
+  stamp.captureNs = 42;
+  setCurrentSyncStamp(stamp);
+
+  bool otherThreadSawStamp = true;
+  std::thread([&] { otherThreadSawStamp = currentSyncStamp().valid; }).join();
+  EXPECT_FALSE(otherThreadSawStamp);
+  EXPECT_EQ(currentSyncStamp().captureNs, 42);
+
+  setCurrentSyncStamp(SyncStamp());
+  EXPECT_FALSE(currentSyncStamp().valid);
+}
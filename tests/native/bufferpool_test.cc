@@ -0,0 +1,81 @@
+#include "bufferpool.h"
+#include "colorconvert.h"
+#include "rawframe.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+TEST(FrameBufferPool, ReusesReleasedBuffers) {
+  auto pool = FrameBufferPool::create(2);
+
+  const uint8_t *first = nullptr;
+  {
+    FrameBufferPool::Buffer buffer = pool->acquire(3 * 1024 * 1024);
+    first                          = buffer->data();
+  }
+  EXPECT_EQ(pool->idleCount(), 1u);
+
+  for (int i = 0; i < 100; i++) {
+    FrameBufferPool::Buffer buffer = pool->acquire(3 * 1024 * 1024);
+    EXPECT_EQ(buffer->data(), first);
+  }
+  EXPECT_EQ(pool->allocationCount(), 1u);
+}
+
+TEST(FrameBufferPool, RetainsAtMostMaxBuffers) {
+  auto pool = FrameBufferPool::create(2);
+  {
+    auto a = pool->acquire(16);
+    auto b = pool->acquire(16);
+    auto c = pool->acquire(16);
+  }
+  EXPECT_EQ(pool->idleCount(), 2u);
+}
+
+TEST(FrameBufferPool, BufferMayOutlivePool) {
+  auto                    pool   = FrameBufferPool::create();
+  FrameBufferPool::Buffer buffer = pool->acquire(64);
+  pool.reset();
+  buffer->at(63) = 1;
+  buffer.reset();
+}
+
+TEST(FrameBufferPool, ReleaseFromAnotherThread) {
+  auto                    pool   = FrameBufferPool::create();
+  FrameBufferPool::Buffer buffer = pool->acquire(64);
+  std::thread([moved = std::move(buffer)]() mutable { moved.reset(); }).join();
+  EXPECT_EQ(pool->idleCount(), 1u);
+}
+
+TEST(RawFrame, ParsesFormatNames) {
+  ImageFormat format;
+  ASSERT_TRUE(parseImageFormat("nv12", format));
+  EXPECT_EQ(format, ImageFormat::NV12);
+  EXPECT_STREQ(imageFormatName(format), "nv12");
+  EXPECT_FALSE(parseImageFormat("png", format));
+}
+
+TEST(RawFrame, PacksBGRAWithoutRowPadding) {
+  auto                 pool   = FrameBufferPool::create();
+  const int32_t        width  = 5, height = 3, stride = 32;
+  std::vector<uint8_t> src(stride * height);
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = static_cast<uint8_t>(i);
+  }
+
+  RawFrame frame;
+  ASSERT_TRUE(packRawFrame(*pool, ImageFormat::Bgra, src.data(), width, height, stride, frame));
+  EXPECT_EQ(frame.bytesPerRow, width * 4);
+  ASSERT_EQ(frame.buffer->size(), static_cast<size_t>(width * 4 * height));
+  EXPECT_EQ((*frame.buffer)[width * 4], src[stride]);
+}
+
+TEST(RawFrame, ConvertsToI420InPooledBuffer) {
+  auto                 pool = FrameBufferPool::create();
+  std::vector<uint8_t> src(64 * 32 * 4, 0x80);
+
+  RawFrame frame;
+  ASSERT_TRUE(packRawFrame(*pool, ImageFormat::I420, src.data(), 64, 32, 64 * 4, frame));
+  EXPECT_EQ(frame.bytesPerRow, 64);
+  EXPECT_EQ(frame.buffer->size(), yuv420FrameSize(64, 32));
+  EXPECT_FALSE(packRawFrame(*pool, ImageFormat::Jpeg, src.data(), 64, 32, 64 * 4, frame));
+}
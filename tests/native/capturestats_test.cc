@@ -0,0 +1,54 @@
+#include "capturestats.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+
+TEST(StartupTiming, EmptyUntilAStart) {
+  StartupTiming   timing;
+  StartupSnapshot snapshot = timing.snapshot();
+  EXPECT_FALSE(snapshot.prepared);
+  EXPECT_EQ(snapshot.firstFrameMs, -1);
+  EXPECT_EQ(snapshot.firstAudioMs, -1);
+
+  // Callbacks before any start are not timed
+  timing.firstVideo();
+  EXPECT_EQ(timing.snapshot().firstFrameMs, -1);
+}
+
+TEST(StartupTiming, RecordsOnlyTheFirstCallbacks) {
+  StartupTiming timing;
+  timing.begin(1, 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  timing.firstVideo();
+  double first = timing.snapshot().firstFrameMs;
+  EXPECT_GE(first, 5);
+  EXPECT_EQ(timing.snapshot().firstAudioMs, -1);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  timing.firstVideo();
+  timing.firstAudio();
+  StartupSnapshot snapshot = timing.snapshot();
+  EXPECT_EQ(snapshot.firstFrameMs, first);
+  EXPECT_GE(snapshot.firstAudioMs, first);
+
+  // A new start times again from scratch
+  timing.begin(1, 0);
+  EXPECT_EQ(timing.snapshot().firstFrameMs, -1);
+}
+
+TEST(StartupTiming, PreparedOnlyForTheSameTarget) {
+  StartupTiming timing;
+  timing.prepared(0, 42);
+  timing.begin(0, 42);
+  EXPECT_TRUE(timing.snapshot().prepared);
+
+  // The preparation was used up by the first start
+  timing.begin(0, 42);
+  EXPECT_FALSE(timing.snapshot().prepared);
+
+  timing.prepared(1, 0);
+  timing.begin(2, 0);
+  EXPECT_FALSE(timing.snapshot().prepared);
+  timing.begin(1, 0);
+  EXPECT_FALSE(timing.snapshot().prepared);
+}
@@ -0,0 +1,120 @@
+#include "capturetrace.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+/** Tracing is process-wide; every test starts a fresh session and leaves it off */
+class CaptureTrace : public ::testing::Test {
+protected:
+  void SetUp() override {
+    setCaptureTraceEnabled(true);
+  }
+  void TearDown() override {
+    setCaptureTraceEnabled(false);
+  }
+};
+
+} // namespace
+
+TEST_F(CaptureTrace, RecordsNothingWhileDisabled) {
+  setCaptureTraceEnabled(false);
+  traceSpan("ignored", 1, 100, 200);
+  { TraceScope scope("ignored"); }
+  EXPECT_TRUE(collectTraceSpans().empty());
+}
+
+TEST_F(CaptureTrace, KeepsSpansOfEachThread) {
+  auto worker = [](const char *name, int count) {
+    setTraceThreadName(name);
+    for (int i = 0; i < count; i++) {
+      traceSpan(name, static_cast<uint64_t>(i), 1000 * i, 1000 * i + 500);
+    }
+  };
+  std::thread first(worker, "first", 3);
+  std::thread second(worker, "second", 5);
+  first.join();
+  second.join();
+
+  std::vector<TraceSpan> spans = collectTraceSpans();
+  ASSERT_EQ(spans.size(), 8u);
+
+  std::set<uint32_t> threads;
+  int                secondCount = 0;
+  for (const TraceSpan &span : spans) {
+    threads.insert(span.threadId);
+    if (std::string(span.name) == "second") {
+      EXPECT_EQ(span.sequence, static_cast<uint64_t>(secondCount));
+      EXPECT_EQ(span.endNs - span.beginNs, 500);
+      secondCount++;
+    }
+  }
+  EXPECT_EQ(secondCount, 5);
+  EXPECT_EQ(threads.size(), 2u);
+}
+
+TEST_F(CaptureTrace, RingKeepsTheMostRecentSpans) {
+  std::thread writer([] {
+    for (uint64_t i = 0; i < kTraceEventsPerThread + 100; i++) {
+      traceSpan("span", i, 0, 1);
+    }
+  });
+  writer.join();
+
+  // The slot a running writer could be overwriting is never copied, so a full ring yields one span less
+  std::vector<TraceSpan> spans = collectTraceSpans();
+  ASSERT_EQ(spans.size(), kTraceEventsPerThread - 1);
+  EXPECT_EQ(spans.front().sequence, 101u);
+  EXPECT_EQ(spans.back().sequence, kTraceEventsPerThread + 99);
+}
+
+TEST_F(CaptureTrace, EnablingStartsANewSession) {
+  traceSpan("old", 1, 0, 1);
+  setCaptureTraceEnabled(false);
+  traceSpan("dropped", 2, 0, 1);
+  EXPECT_EQ(collectTraceSpans().size(), 1u); // Kept after disabling
+
+  setCaptureTraceEnabled(true);
+  traceSpan("new", 3, 0, 1);
+  std::vector<TraceSpan> spans = collectTraceSpans();
+  ASSERT_EQ(spans.size(), 1u);
+  EXPECT_STREQ(spans[0].name, "new");
+}
+
+TEST_F(CaptureTrace, WritesChromeTraceJSON) {
+  std::thread named([] {
+    setTraceThreadName("encoder \"0\"");
+    traceSpan("encode", 7, 2000000, 2500000);
+    { TraceScope scope("idle"); }
+  });
+  named.join();
+
+  std::string path = ::testing::TempDir() + "capturetrace_test.json";
+  std::string error;
+  ASSERT_TRUE(writeCaptureTraceFile(path.c_str(), error)) << error;
+
+  std::ifstream     file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  std::remove(path.c_str());
+  std::string json = contents.str();
+
+  EXPECT_EQ(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0u);
+  EXPECT_NE(json.find("\"name\":\"thread_name\""), std::string::npos);
+  EXPECT_NE(json.find("\"args\":{\"name\":\"encoder \\\"0\\\"\"}"), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"encode\",\"pid\":"), std::string::npos);
+  EXPECT_NE(json.find("\"ts\":2000.000,\"dur\":500.000,\"args\":{\"seq\":7}"), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"idle\""), std::string::npos);
+  EXPECT_EQ(json.substr(json.size() - 3), "]}\n");
+}
+
+TEST_F(CaptureTrace, ReportsUnwritablePath) {
+  std::string error;
+  EXPECT_FALSE(writeCaptureTraceFile("/nonexistent-directory/trace.json", error));
+  EXPECT_NE(error.find("/nonexistent-directory/trace.json"), std::string::npos);
+}
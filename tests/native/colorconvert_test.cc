@@ -0,0 +1,119 @@
+#include "colorconvert.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> randomFrame(int32_t height, int32_t stride, uint32_t seed) {
+  std::mt19937         rng(seed);
+  std::vector<uint8_t> frame(static_cast<size_t>(height) * stride);
+  for (auto &byte : frame) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  return frame;
+}
+
+/** Runs the vectorized and scalar converters and requires identical output */
+void expectMatchesReference(int32_t width, int32_t height, int32_t stridePadding, bool nv12) {
+  const int32_t        stride = width * 4 + stridePadding;
+  std::vector<uint8_t> src    = randomFrame(height, stride, static_cast<uint32_t>(width * 131 + height));
+
+  std::vector<uint8_t> fast(yuv420FrameSize(width, height), 0);
+  std::vector<uint8_t> reference(fast.size(), 0);
+  if (nv12) {
+    convertBGRAToNV12(src.data(), stride, width, height, nv12Planes(fast.data(), width, height));
+    convertBGRAToNV12Scalar(src.data(), stride, width, height, nv12Planes(reference.data(), width, height));
+  } else {
+    convertBGRAToI420(src.data(), stride, width, height, i420Planes(fast.data(), width, height));
+    convertBGRAToI420Scalar(src.data(), stride, width, height, i420Planes(reference.data(), width, height));
+  }
+
+  ASSERT_EQ(fast, reference) << (nv12 ? "nv12 " : "i420 ") << width << "x" << height << " (" << colorConvertBackend()
+                             << ")";
+}
+
+} // namespace
+
+TEST(ColorConvert, FrameSizeRoundsChromaUp) {
+  EXPECT_EQ(yuv420FrameSize(1920, 1080), 1920u * 1080 * 3 / 2);
+  EXPECT_EQ(yuv420FrameSize(3, 3), 9u + 2 * 2 * 2);
+}
+
+TEST(ColorConvert, KnownColours) {
+  // White, black, pure red, pure blue as BGRA 2x2 blocks
+  const uint8_t colours[4][4] = {
+      {255, 255, 255, 255},
+      {0,   0,   0,   255},
+      {0,   0,   255, 255},
+      {255, 0,   0,   255},
+  };
+  const uint8_t expected[4][3] = {
+      {235, 128, 128},
+      {16,  128, 128},
+      {82,  90,  240},
+      {41,  240, 110},
+  };
+
+  for (int c = 0; c < 4; c++) {
+    std::vector<uint8_t> src(2 * 2 * 4);
+    for (int p = 0; p < 4; p++) {
+      std::copy(colours[c], colours[c] + 4, src.begin() + p * 4);
+    }
+    std::vector<uint8_t> out(yuv420FrameSize(2, 2));
+    convertBGRAToI420Scalar(src.data(), 8, 2, 2, i420Planes(out.data(), 2, 2));
+    EXPECT_EQ(out[0], expected[c][0]) << "colour " << c;
+    EXPECT_EQ(out[4], expected[c][1]) << "colour " << c;
+    EXPECT_EQ(out[5], expected[c][2]) << "colour " << c;
+  }
+}
+
+TEST(ColorConvert, I420MatchesScalarReference) {
+  const int32_t sizes[][2] = {
+      {16,   2   },
+      {64,   48  },
+      {33,   17  },
+      {1,    1   },
+      {15,   7   },
+      {1920, 1080},
+  };
+  for (const auto &size : sizes) {
+    expectMatchesReference(size[0], size[1], 0, false);
+    expectMatchesReference(size[0], size[1], 12, false);
+  }
+}
+
+TEST(ColorConvert, NV12MatchesScalarReference) {
+  const int32_t sizes[][2] = {
+      {16,   2   },
+      {64,   48  },
+      {33,   17  },
+      {1,    1   },
+      {15,   7   },
+      {1920, 1080},
+  };
+  for (const auto &size : sizes) {
+    expectMatchesReference(size[0], size[1], 0, true);
+    expectMatchesReference(size[0], size[1], 12, true);
+  }
+}
+
+TEST(ColorConvert, NV12InterleavesI420Chroma) {
+  const int32_t        width = 37, height = 21, stride = width * 4;
+  std::vector<uint8_t> src = randomFrame(height, stride, 7);
+
+  std::vector<uint8_t> i420(yuv420FrameSize(width, height));
+  std::vector<uint8_t> nv12(i420.size());
+  YUVPlanes            planar      = i420Planes(i420.data(), width, height);
+  YUVPlanes            interleaved = nv12Planes(nv12.data(), width, height);
+  convertBGRAToI420(src.data(), stride, width, height, planar);
+  convertBGRAToNV12(src.data(), stride, width, height, interleaved);
+
+  ASSERT_TRUE(std::equal(i420.begin(), i420.begin() + width * height, nv12.begin()));
+  for (int32_t cy = 0; cy < (height + 1) / 2; cy++) {
+    for (int32_t cx = 0; cx < (width + 1) / 2; cx++) {
+      ASSERT_EQ(interleaved.u[cy * interleaved.uStride + cx * 2], planar.u[cy * planar.uStride + cx]);
+      ASSERT_EQ(interleaved.u[cy * interleaved.uStride + cx * 2 + 1], planar.v[cy * planar.vStride + cx]);
+    }
+  }
+}
@@ -0,0 +1,90 @@
+#include "croprect.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace {
+
+/** Builds a BGRA frame whose pixel (x, y) is {x, y, 0, 255} */
+std::vector<uint8_t> makeFrame(int32_t width, int32_t height, int32_t bytesPerRow) {
+  std::vector<uint8_t> frame(static_cast<size_t>(bytesPerRow) * height, 0xEE);
+  for (int32_t y = 0; y < height; y++) {
+    for (int32_t x = 0; x < width; x++) {
+      uint8_t *pixel = frame.data() + y * bytesPerRow + x * 4;
+      pixel[0]       = static_cast<uint8_t>(x);
+      pixel[1]       = static_cast<uint8_t>(y);
+      pixel[2]       = 0;
+      pixel[3]       = 255;
+    }
+  }
+  return frame;
+}
+
+} // namespace
+
+TEST(CropRect, ZeroSizeSelectsFullFrame) {
+  MediaCaptureRectC out;
+  ASSERT_TRUE(resolveCropRect({10, 10, 0, 0}, 640, 480, out));
+  EXPECT_EQ(out.x, 0);
+  EXPECT_EQ(out.y, 0);
+  EXPECT_EQ(out.width, 640);
+  EXPECT_EQ(out.height, 480);
+}
+
+TEST(CropRect, ClampsToFrameBounds) {
+  MediaCaptureRectC out;
+  ASSERT_TRUE(resolveCropRect({-10, 400, 100, 200}, 640, 480, out));
+  EXPECT_EQ(out.x, 0);
+  EXPECT_EQ(out.y, 400);
+  EXPECT_EQ(out.width, 90);
+  EXPECT_EQ(out.height, 80);
+}
+
+TEST(CropRect, RejectsRectOutsideFrame) {
+  MediaCaptureRectC out;
+  EXPECT_FALSE(resolveCropRect({700, 0, 100, 100}, 640, 480, out));
+  EXPECT_FALSE(resolveCropRect({0, 0x7fffffff, 100, 0x7fffffff}, 640, 480, out));
+}
+
+TEST(CropRect, CopiesOnlyRegionPixels) {
+  const int32_t        width = 40, height = 30, stride = 44 * 4;
+  std::vector<uint8_t> frame = makeFrame(width, height, stride);
+
+  MediaCaptureRectC rect;
+  ASSERT_TRUE(resolveCropRect({5, 7, 12, 9}, width, height, rect));
+
+  std::vector<uint8_t> out(rect.width * 4 * rect.height);
+  copyFrameRegion(frame.data(), stride, rect, 4, out.data(), rect.width * 4);
+
+  for (int32_t y = 0; y < rect.height; y++) {
+    for (int32_t x = 0; x < rect.width; x++) {
+      const uint8_t *pixel = out.data() + (y * rect.width + x) * 4;
+      ASSERT_EQ(pixel[0], 5 + x);
+      ASSERT_EQ(pixel[1], 7 + y);
+      ASSERT_EQ(pixel[3], 255);
+    }
+  }
+}
+
+TEST(CropRect, FullFrameCopyPreservesStride) {
+  const int32_t        width = 16, height = 8, stride = width * 4;
+  std::vector<uint8_t> frame = makeFrame(width, height, stride);
+
+  MediaCaptureRectC rect;
+  ASSERT_TRUE(resolveCropRect({0, 0, 0, 0}, width, height, rect));
+
+  std::vector<uint8_t> out(frame.size());
+  copyFrameRegion(frame.data(), stride, rect, 4, out.data(), stride);
+  EXPECT_EQ(out, frame);
+}
+
+TEST(CropRect, SharedRectRoundTrips) {
+  SharedCropRect shared;
+  EXPECT_EQ(shared.get().width, 0);
+
+  shared.set({1, 2, 3, 4});
+  MediaCaptureRectC rect = shared.get();
+  EXPECT_EQ(rect.x, 1);
+  EXPECT_EQ(rect.y, 2);
+  EXPECT_EQ(rect.width, 3);
+  EXPECT_EQ(rect.height, 4);
+}
@@ -0,0 +1,150 @@
+#include "deliverygate.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST(DeliveryGate, PassesItemsThroughUntilPaused) {
+  DeliveryGate<int> gate;
+  gate.configure(2, OverflowPolicy::DropOldest);
+
+  int item = 1;
+  EXPECT_EQ(gate.admit(item), GateResult::Deliver);
+  EXPECT_FALSE(gate.isPaused());
+
+  gate.pause();
+  EXPECT_EQ(gate.admit(item), GateResult::Held);
+  EXPECT_EQ(gate.heldCount(), 1u);
+
+  std::deque<int> held;
+  gate.resume(held);
+  ASSERT_EQ(held.size(), 1u);
+  EXPECT_EQ(held[0], 1);
+  EXPECT_EQ(gate.admit(item), GateResult::Deliver);
+}
+
+TEST(DeliveryGate, DropOldestKeepsTheLatestItems) {
+  DeliveryGate<int> gate;
+  gate.configure(3, OverflowPolicy::DropOldest);
+  gate.pause();
+
+  for (int i = 0; i < 5; i++) {
+    int item = i;
+    EXPECT_EQ(gate.admit(item), i < 3 ? GateResult::Held : GateResult::Dropped);
+  }
+  EXPECT_EQ(gate.droppedCount(), 2u);
+
+  std::deque<int> held;
+  gate.resume(held);
+  EXPECT_EQ(std::vector<int>(held.begin(), held.end()), (std::vector<int>{2, 3, 4}));
+}
+
+TEST(DeliveryGate, DropNewestKeepsTheEarliestItems) {
+  DeliveryGate<int> gate;
+  gate.configure(3, OverflowPolicy::DropNewest);
+  gate.pause();
+
+  for (int i = 0; i < 5; i++) {
+    int item = i;
+    gate.admit(item);
+  }
+  EXPECT_EQ(gate.droppedCount(), 2u);
+
+  std::deque<int> held;
+  gate.resume(held);
+  EXPECT_EQ(std::vector<int>(held.begin(), held.end()), (std::vector<int>{0, 1, 2}));
+}
+
+TEST(DeliveryGate, ZeroCapacityDropsWhilePaused) {
+  DeliveryGate<std::unique_ptr<int>> gate;
+  gate.pause();
+
+  auto item = std::make_unique<int>(7);
+  EXPECT_EQ(gate.admit(item), GateResult::Dropped);
+  // Nothing was held, so the caller still owns the item
+  ASSERT_TRUE(item);
+  EXPECT_EQ(gate.droppedCount(), 1u);
+
+  gate.reset();
+  EXPECT_FALSE(gate.isPaused());
+  EXPECT_EQ(gate.droppedCount(), 0u);
+}
+
+TEST(DeliveryGate, ShrinkingTheBufferAppliesThePolicy) {
+  DeliveryGate<int> gate;
+  gate.configure(4, OverflowPolicy::DropNewest);
+  gate.pause();
+  for (int i = 0; i < 4; i++) {
+    int item = i;
+    gate.admit(item);
+  }
+  gate.configure(2, OverflowPolicy::DropNewest);
+
+  std::deque<int> held;
+  gate.resume(held);
+  EXPECT_EQ(std::vector<int>(held.begin(), held.end()), (std::vector<int>{0, 1}));
+  EXPECT_EQ(gate.droppedCount(), 2u);
+}
+
+TEST(DeliveryGate, EveryItemIsDeliveredHeldOrDroppedExactlyOnce) {
+  DeliveryGate<int> gate;
+  gate.configure(16, OverflowPolicy::DropOldest);
+
+  constexpr int     kItems = 20000;
+  std::atomic<bool> done{false};
+  std::atomic<int>  delivered{0};
+  int               resumed = 0;
+
+  std::thread producer([&] {
+    for (int i = 0; i < kItems; i++) {
+      int item = i;
+      if (gate.admit(item) == GateResult::Deliver) {
+        delivered.fetch_add(1);
+      }
+    }
+    done.store(true);
+  });
+
+  // The consumer keeps pausing and resuming, like a stream whose buffer fills and drains
+  std::deque<int> held;
+  while (!done.load()) {
+    gate.pause();
+    std::this_thread::yield();
+    gate.resume(held);
+    resumed += static_cast<int>(held.size());
+  }
+  producer.join();
+  gate.resume(held);
+  resumed += static_cast<int>(held.size());
+
+  EXPECT_EQ(delivered.load() + resumed + static_cast<int>(gate.droppedCount()), kItems);
+}
+
+TEST(DeliveryGate, PullingConsumerIsWokenOncePerWait) {
+  DeliveryGate<int> gate;
+  gate.configure(8, OverflowPolicy::DropOldest);
+  gate.pause();
+
+  std::deque<int> taken;
+  EXPECT_FALSE(gate.takeOrArm(taken));
+
+  // Only the first item after arming wakes the consumer; the rest join it
+  int item = 1;
+  EXPECT_EQ(gate.admit(item), GateResult::Wake);
+  item = 2;
+  EXPECT_EQ(gate.admit(item), GateResult::Held);
+
+  EXPECT_TRUE(gate.takeOrArm(taken));
+  EXPECT_EQ(std::vector<int>(taken.begin(), taken.end()), (std::vector<int>{1, 2}));
+
+  // A wake-up that could not be delivered is re-armed for the next item
+  gate.armWake();
+  item = 3;
+  EXPECT_EQ(gate.admit(item), GateResult::Wake);
+
+  gate.resume(taken);
+  gate.pause();
+  item = 4;
+  EXPECT_EQ(gate.admit(item), GateResult::Held);
+}
@@ -0,0 +1,244 @@
+#include "deltaframe.h"
+#include "jpegcodec.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kWidth  = 200;
+constexpr int32_t kHeight = 130;
+
+/** Stores the region verbatim so round trips can be checked bit-exactly */
+bool copyPatch(
+    const uint8_t *bgra, int32_t width, int32_t height, int32_t bytesPerRow, int32_t, std::vector<uint8_t> &out) {
+  out.resize(8 + static_cast<size_t>(width) * height * 4);
+  memcpy(out.data(), &width, 4);
+  memcpy(out.data() + 4, &height, 4);
+  for (int32_t y = 0; y < height; y++) {
+    memcpy(out.data() + 8 + static_cast<size_t>(y) * width * 4, bgra + static_cast<size_t>(y) * bytesPerRow, width * 4);
+  }
+  return true;
+}
+
+bool uncopyPatch(const uint8_t *data, size_t size, std::vector<uint8_t> &bgra, int32_t &width, int32_t &height) {
+  if (size < 8) {
+    return false;
+  }
+  memcpy(&width, data, 4);
+  memcpy(&height, data + 4, 4);
+  bgra.assign(data + 8, data + size);
+  return bgra.size() == static_cast<size_t>(width) * height * 4;
+}
+
+std::vector<uint8_t> randomFrame(int32_t width, int32_t height, uint32_t seed) {
+  std::mt19937         rng(seed);
+  std::vector<uint8_t> frame(static_cast<size_t>(width) * height * 4);
+  for (auto &byte : frame) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  return frame;
+}
+
+void paint(std::vector<uint8_t> &frame, int32_t width, const MediaCaptureRectC &rect, uint8_t value) {
+  for (int32_t y = rect.y; y < rect.y + rect.height; y++) {
+    memset(frame.data() + (static_cast<size_t>(y) * width + rect.x) * 4, value, static_cast<size_t>(rect.width) * 4);
+  }
+}
+
+DeltaEncoderOptions testOptions() {
+  DeltaEncoderOptions options;
+  options.tileSize           = 32;
+  options.keyframeIntervalMs = 1000000;
+  return options;
+}
+
+} // namespace
+
+TEST(DeltaFrame, FindsAndMergesDirtyTiles) {
+  std::vector<uint8_t> previous = randomFrame(kWidth, kHeight, 1);
+  std::vector<uint8_t> current  = previous;
+  std::vector<MediaCaptureRectC> rects;
+
+  findDirtyRects(current.data(), kWidth * 4, previous.data(), kWidth * 4, kWidth, kHeight, 32, rects);
+  EXPECT_TRUE(rects.empty());
+
+  // Two horizontally adjacent tiles over two tile rows merge into one 64x64 rect
+  current[(40 * kWidth + 40) * 4] ^= 1;
+  current[(70 * kWidth + 80) * 4] ^= 1;
+  current[(40 * kWidth + 80) * 4] ^= 1;
+  current[(70 * kWidth + 40) * 4] ^= 1;
+  // A change in the clipped bottom-right tile
+  current[((kHeight - 1) * kWidth + kWidth - 1) * 4] ^= 1;
+
+  findDirtyRects(current.data(), kWidth * 4, previous.data(), kWidth * 4, kWidth, kHeight, 32, rects);
+  ASSERT_EQ(rects.size(), 2u);
+  EXPECT_EQ(rects[0].x, 32);
+  EXPECT_EQ(rects[0].y, 32);
+  EXPECT_EQ(rects[0].width, 64);
+  EXPECT_EQ(rects[0].height, 64);
+  EXPECT_EQ(rects[1].x, 192);
+  EXPECT_EQ(rects[1].y, 128);
+  EXPECT_EQ(rects[1].width, 8);
+  EXPECT_EQ(rects[1].height, 2);
+}
+
+TEST(DeltaFrame, LosslessRoundTrip) {
+  DeltaFrameEncoder    encoder(testOptions(), copyPatch);
+  DeltaCompositor      compositor(uncopyPatch);
+  std::vector<uint8_t> frame = randomFrame(kWidth, kHeight, 2);
+  std::vector<uint8_t> payload;
+
+  ASSERT_TRUE(encoder.encode(frame.data(), kWidth, kHeight, kWidth * 4, 0, payload));
+  DeltaFrameHeader            header;
+  std::vector<DeltaPatchView> patches;
+  ASSERT_TRUE(parseDeltaFrame(payload.data(), payload.size(), header, patches));
+  EXPECT_TRUE(header.keyframe);
+  ASSERT_EQ(patches.size(), 1u);
+  ASSERT_EQ(compositor.apply(payload.data(), payload.size()), DeltaCompositor::Result::Applied);
+  EXPECT_EQ(compositor.frame(), frame);
+
+  for (int i = 1; i <= 20; i++) {
+    paint(frame, kWidth, {(i * 17) % (kWidth - 20), (i * 11) % (kHeight - 10), 20, 10}, static_cast<uint8_t>(i));
+    ASSERT_TRUE(encoder.encode(frame.data(), kWidth, kHeight, kWidth * 4, i * 33, payload));
+    ASSERT_TRUE(parseDeltaFrame(payload.data(), payload.size(), header, patches));
+    EXPECT_FALSE(header.keyframe);
+    EXPECT_EQ(header.baseSequence + 1, header.sequence);
+    ASSERT_EQ(compositor.apply(payload.data(), payload.size()), DeltaCompositor::Result::Applied);
+    ASSERT_EQ(compositor.frame(), frame) << "frame " << i;
+  }
+}
+
+TEST(DeltaFrame, UnchangedFrameProducesNoPayload) {
+  DeltaFrameEncoder    encoder(testOptions(), copyPatch);
+  std::vector<uint8_t> frame = randomFrame(kWidth, kHeight, 3);
+  std::vector<uint8_t> payload;
+
+  ASSERT_TRUE(encoder.encode(frame.data(), kWidth, kHeight, kWidth * 4, 0, payload));
+  ASSERT_TRUE(encoder.encode(frame.data(), kWidth, kHeight, kWidth * 4, 33, payload));
+  EXPECT_TRUE(payload.empty());
+}
+
+TEST(DeltaFrame, HandlesPaddedSourceRows) {
+  const int32_t        stride = kWidth * 4 + 24;
+  DeltaFrameEncoder    encoder(testOptions(), copyPatch);
+  DeltaCompositor      compositor(uncopyPatch);
+  std::vector<uint8_t> padded = randomFrame(stride / 4, kHeight, 4);
+  std::vector<uint8_t> payload;
+
+  ASSERT_TRUE(encoder.encode(padded.data(), kWidth, kHeight, stride, 0, payload));
+  ASSERT_EQ(compositor.apply(payload.data(), payload.size()), DeltaCompositor::Result::Applied);
+
+  padded[50 * stride + 10 * 4] ^= 0xff;
+  // Padding bytes are not part of the image
+  padded[60 * stride + kWidth * 4 + 3] ^= 0xff;
+  ASSERT_TRUE(encoder.encode(padded.data(), kWidth, kHeight, stride, 33, payload));
+  ASSERT_EQ(compositor.apply(payload.data(), payload.size()), DeltaCompositor::Result::Applied);
+
+  DeltaFrameHeader            header;
+  std::vector<DeltaPatchView> patches;
+  ASSERT_TRUE(parseDeltaFrame(payload.data(), payload.size(), header, patches));
+  EXPECT_EQ(patches.size(), 1u);
+  for (int32_t y = 0; y < kHeight; y++) {
+    ASSERT_EQ(memcmp(compositor.frame().data() + y * kWidth * 4, padded.data() + y * stride, kWidth * 4), 0);
+  }
+}
+
+TEST(DeltaFrame, KeyframePolicy) {
+  DeltaEncoderOptions options = testOptions();
+  options.keyframeIntervalMs  = 1000;
+  DeltaFrameEncoder    encoder(options, copyPatch);
+  std::vector<uint8_t> frame = randomFrame(kWidth, kHeight, 5);
+  std::vector<uint8_t> payload;
+  DeltaFrameHeader            header;
+  std::vector<DeltaPatchView> patches;
+
+  auto encodeAt = [&](int64_t timestampMs) {
+    frame[0] ^= 1;
+    EXPECT_TRUE(encoder.encode(frame.data(), kWidth, kHeight, kWidth * 4, timestampMs, payload));
+    EXPECT_TRUE(parseDeltaFrame(payload.data(), payload.size(), header, patches));
+    return header.keyframe;
+  };
+
+  EXPECT_TRUE(encodeAt(0));
+  EXPECT_FALSE(encodeAt(500));
+  EXPECT_TRUE(encodeAt(1000));
+
+  encoder.requestKeyframe();
+  EXPECT_TRUE(encodeAt(1100));
+
+  // Changing most of the frame is cheaper as a keyframe
+  paint(frame, kWidth, {0, 0, kWidth, kHeight - 20}, 9);
+  EXPECT_TRUE(encodeAt(1200));
+
+  // So is a resolution change
+  frame.resize(static_cast<size_t>(kWidth) * (kHeight + 10) * 4);
+  EXPECT_TRUE(encoder.encode(frame.data(), kWidth, kHeight + 10, kWidth * 4, 1300, payload));
+  ASSERT_TRUE(parseDeltaFrame(payload.data(), payload.size(), header, patches));
+  EXPECT_TRUE(header.keyframe);
+  EXPECT_EQ(header.height, static_cast<uint32_t>(kHeight + 10));
+}
+
+TEST(DeltaFrame, CompositorRequiresContiguousSequence) {
+  DeltaFrameEncoder    encoder(testOptions(), copyPatch);
+  DeltaCompositor      compositor(uncopyPatch);
+  std::vector<uint8_t> frame = randomFrame(kWidth, kHeight, 6);
+  std::vector<uint8_t> keyframe, first, second;
+
+  ASSERT_TRUE(encoder.encode(frame.data(), kWidth, kHeight, kWidth * 4, 0, keyframe));
+  frame[0] ^= 1;
+  ASSERT_TRUE(encoder.encode(frame.data(), kWidth, kHeight, kWidth * 4, 1, first));
+  frame[0] ^= 1;
+  ASSERT_TRUE(encoder.encode(frame.data(), kWidth, kHeight, kWidth * 4, 2, second));
+
+  EXPECT_EQ(compositor.apply(first.data(), first.size()), DeltaCompositor::Result::NeedKeyframe);
+  ASSERT_EQ(compositor.apply(keyframe.data(), keyframe.size()), DeltaCompositor::Result::Applied);
+  // first was lost
+  EXPECT_EQ(compositor.apply(second.data(), second.size()), DeltaCompositor::Result::NeedKeyframe);
+
+  std::vector<uint8_t> truncated(first.begin(), first.end() - 1);
+  EXPECT_EQ(compositor.apply(truncated.data(), truncated.size()), DeltaCompositor::Result::Invalid);
+}
+
+TEST(DeltaFrame, JpegRoundTrip) {
+  if (!jpegCodecAvailable()) {
+    GTEST_SKIP() << "no JPEG codec in this build";
+  }
+
+  // Smooth gradient so JPEG error stays small
+  std::vector<uint8_t> frame(static_cast<size_t>(kWidth) * kHeight * 4);
+  for (int32_t y = 0; y < kHeight; y++) {
+    for (int32_t x = 0; x < kWidth; x++) {
+      uint8_t *p = &frame[(static_cast<size_t>(y) * kWidth + x) * 4];
+      p[0]       = static_cast<uint8_t>(x);
+      p[1]       = static_cast<uint8_t>(y * 2);
+      p[2]       = static_cast<uint8_t>(x + y);
+      p[3]       = 255;
+    }
+  }
+
+  DeltaEncoderOptions options = testOptions();
+  options.quality             = 90;
+  DeltaFrameEncoder    encoder(options);
+  DeltaCompositor      compositor;
+  std::vector<uint8_t> payload;
+
+  ASSERT_TRUE(encoder.encode(frame.data(), kWidth, kHeight, kWidth * 4, 0, payload));
+  ASSERT_EQ(compositor.apply(payload.data(), payload.size()), DeltaCompositor::Result::Applied);
+  paint(frame, kWidth, {64, 32, 40, 40}, 200);
+  ASSERT_TRUE(encoder.encode(frame.data(), kWidth, kHeight, kWidth * 4, 33, payload));
+  EXPECT_LT(payload.size(), kWidth * kHeight / 4u);
+  ASSERT_EQ(compositor.apply(payload.data(), payload.size()), DeltaCompositor::Result::Applied);
+
+  ASSERT_EQ(compositor.frame().size(), frame.size());
+  double squaredError = 0;
+  for (size_t i = 0; i < frame.size(); i++) {
+    if (i % 4 != 3) {
+      const double diff = static_cast<double>(compositor.frame()[i]) - frame[i];
+      squaredError += diff * diff;
+    }
+  }
+  const double psnr = 10.0 * std::log10(255.0 * 255.0 / (squaredError / (frame.size() * 3 / 4)));
+  EXPECT_GT(psnr, 30.0);
+}
@@ -0,0 +1,62 @@
+#include "framequeue.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+TEST(BoundedFrameQueue, PushPopInOrder) {
+  BoundedFrameQueue<int> queue(3);
+  EXPECT_TRUE(queue.tryPush(1));
+  EXPECT_TRUE(queue.tryPush(2));
+  EXPECT_TRUE(queue.tryPush(3));
+  EXPECT_FALSE(queue.tryPush(4));
+  EXPECT_EQ(queue.sizeApprox(), 3u);
+
+  int value = 0;
+  for (int expected = 1; expected <= 3; expected++) {
+    ASSERT_TRUE(queue.tryPop(value));
+    EXPECT_EQ(value, expected);
+  }
+  EXPECT_FALSE(queue.tryPop(value));
+}
+
+TEST(BoundedFrameQueue, DropOldestKeepsLatest) {
+  BoundedFrameQueue<int> queue(2);
+  int                    evicted = 0;
+  EXPECT_FALSE(queue.pushDropOldest(1, evicted));
+  EXPECT_FALSE(queue.pushDropOldest(2, evicted));
+  EXPECT_TRUE(queue.pushDropOldest(3, evicted));
+  EXPECT_EQ(evicted, 1);
+  EXPECT_TRUE(queue.pushDropOldest(4, evicted));
+  EXPECT_EQ(evicted, 2);
+
+  int value = 0;
+  ASSERT_TRUE(queue.tryPop(value));
+  EXPECT_EQ(value, 3);
+  ASSERT_TRUE(queue.tryPop(value));
+  EXPECT_EQ(value, 4);
+}
+
+TEST(BoundedFrameQueue, ConcurrentProducerConsumer) {
+  const int              count = 20000;
+  BoundedFrameQueue<int> queue(8);
+
+  std::thread producer([&] {
+    for (int i = 0; i < count; i++) {
+      while (!queue.tryPush(int(i))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  int next = 0;
+  while (next < count) {
+    int value = -1;
+    if (queue.tryPop(value)) {
+      ASSERT_EQ(value, next);
+      next++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+}
@@ -0,0 +1,674 @@
+#include "avsync.h"
+#include "capture/capture.h"
+#include "jpegcodec.h"
+#include "syntheticaudio.h"
+#include "syntheticconfig.h"
+#include "videopipeline.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/** Everything the C API delivered to one capture */
+struct Recorder {
+  std::mutex               mutex;
+  std::condition_variable  cv;
+  int                      frames      = 0;
+  int32_t                  lastWidth   = 0;
+  int32_t                  lastHeight  = 0;
+  std::string              lastFormat;
+  size_t                   lastSize    = 0;
+  int64_t                  audioFrames = 0;
+  int32_t                  channels    = 0;
+  int32_t                  sampleRate  = 0;
+  std::vector<std::string> errors;
+  bool                     stopped = false;
+
+  template <typename Predicate> bool waitFor(Predicate predicate) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cv.wait_for(lock, std::chrono::seconds(5), predicate);
+  }
+};
+
+void onVideo(uint8_t *, int32_t width, int32_t height, int32_t, const char *, const char *format, size_t size, void *ctx) {
+  auto *recorder = static_cast<Recorder *>(ctx);
+  {
+    std::lock_guard<std::mutex> lock(recorder->mutex);
+    recorder->frames++;
+    recorder->lastWidth  = width;
+    recorder->lastHeight = height;
+    recorder->lastFormat = format;
+    recorder->lastSize   = size;
+  }
+  recorder->cv.notify_all();
+}
+
+void onAudio(int32_t channels, int32_t sampleRate, float *, int32_t frameCount, void *ctx) {
+  auto *recorder = static_cast<Recorder *>(ctx);
+  {
+    std::lock_guard<std::mutex> lock(recorder->mutex);
+    recorder->audioFrames += frameCount;
+    recorder->channels   = channels;
+    recorder->sampleRate = sampleRate;
+  }
+  recorder->cv.notify_all();
+}
+
+void onExit(char *error, void *ctx) {
+  auto                       *recorder = static_cast<Recorder *>(ctx);
+  std::lock_guard<std::mutex> lock(recorder->mutex);
+  recorder->errors.push_back(error ? error : "");
+}
+
+void onStop(void *ctx) {
+  auto                       *recorder = static_cast<Recorder *>(ctx);
+  std::lock_guard<std::mutex> lock(recorder->mutex);
+  recorder->stopped = true;
+}
+
+/** Stamps seen by the callbacks, and when each callback ran */
+struct SyncRecorder {
+  struct Entry {
+    SyncStamp stamp;
+    int64_t   callbackNs = 0;
+    int32_t   frames     = 0;
+  };
+  std::mutex         mutex;
+  std::vector<Entry> video;
+  std::vector<Entry> audio;
+};
+
+void onSyncedVideo(uint8_t *, int32_t, int32_t, int32_t, const char *, const char *, size_t, void *ctx) {
+  auto                       *recorder = static_cast<SyncRecorder *>(ctx);
+  std::lock_guard<std::mutex> lock(recorder->mutex);
+  recorder->video.push_back({currentSyncStamp(), monotonicNowNs(), 0});
+}
+
+void onSyncedAudio(int32_t, int32_t, float *, int32_t frameCount, void *ctx) {
+  auto                       *recorder = static_cast<SyncRecorder *>(ctx);
+  std::lock_guard<std::mutex> lock(recorder->mutex);
+  recorder->audio.push_back({currentSyncStamp(), monotonicNowNs(), frameCount});
+}
+
+MediaCaptureConfigC defaultConfig() {
+  MediaCaptureConfigC config;
+  std::memset(&config, 0, sizeof(config));
+  config.frameRate       = 60.0f;
+  config.quality         = 1;
+  config.audioSampleRate = 48000;
+  config.audioChannels   = 2;
+  config.displayID       = 1;
+  config.imageFormat     = 1;
+  return config;
+}
+
+/** Points the backend at a known synthetic configuration for the duration of a test */
+class LinuxBackend : public ::testing::Test {
+protected:
+  void SetUp() override {
+    setenv("DESKTOP_CAPTURE_SYNTHETIC", "displays=640x480,320x200;windows=200x100;pattern=bars", 1);
+  }
+  void TearDown() override {
+    unsetenv("DESKTOP_CAPTURE_SYNTHETIC");
+  }
+};
+
+} // namespace
+
+TEST(SyntheticConfig, ParsesAllKeys) {
+  SyntheticConfig config;
+  std::string     error;
+  ASSERT_TRUE(parseSyntheticConfig(
+      "displays=3840x2160,800x600;windows=;pattern=noise;audio=silence;frequency=1000;amplitude=0.5;seed=9", config,
+      error))
+      << error;
+  ASSERT_EQ(config.displays.size(), 2u);
+  EXPECT_EQ(config.displays[0].width, 3840);
+  EXPECT_EQ(config.displays[1].height, 600);
+  EXPECT_TRUE(config.windows.empty());
+  EXPECT_EQ(config.pattern, TestPattern::Noise);
+  EXPECT_EQ(config.signal, AudioSignal::Silence);
+  EXPECT_DOUBLE_EQ(config.frequency, 1000.0);
+  EXPECT_FLOAT_EQ(config.amplitude, 0.5f);
+  EXPECT_EQ(config.seed, 9u);
+}
+
+TEST(SyntheticConfig, RejectsInvalidEntriesWithoutChangingConfig) {
+  SyntheticConfig config;
+  std::string     error;
+  EXPECT_FALSE(parseSyntheticConfig("pattern=noise;displays=640by480", config, error));
+  EXPECT_NE(error.find("640by480"), std::string::npos);
+  EXPECT_EQ(config.pattern, TestPattern::Bars);
+  EXPECT_FALSE(parseSyntheticConfig("colour=red", config, error));
+  EXPECT_FALSE(parseSyntheticConfig("amplitude=2", config, error));
+  EXPECT_FALSE(parseSyntheticConfig("displays=0x10", config, error));
+}
+
+TEST(SyntheticAudio, ToneHasRequestedFrequencyAndLevel) {
+  const int32_t      rate = 48000, channels = 2;
+  std::vector<float> samples(static_cast<size_t>(rate) * channels);
+  double             phase = 0;
+  uint32_t           noise = 1;
+  generateAudioBlock(AudioSignal::Tone, 1000.0, 0.5f, rate, channels, rate, phase, noise, samples.data());
+
+  int    crossings = 0;
+  double energy    = 0;
+  for (int32_t i = 1; i < rate; i++) {
+    float previous = samples[(i - 1) * channels], current = samples[i * channels];
+    crossings += (previous < 0) != (current < 0);
+    energy += current * current;
+    ASSERT_EQ(samples[i * channels], samples[i * channels + 1]);
+  }
+  EXPECT_NEAR(crossings, 2000, 2);
+  EXPECT_NEAR(std::sqrt(energy / rate), 0.5 / std::sqrt(2.0), 0.005);
+}
+
+TEST_F(LinuxBackend, EnumeratesConfiguredTargets) {
+  struct Result {
+    std::vector<MediaCaptureTargetC> targets;
+    std::vector<std::string>         titles;
+  } result;
+  enumerateMediaCaptureTargets(
+      0,
+      [](MediaCaptureTargetC *targets, int32_t count, char *error, void *ctx) {
+        auto *result = static_cast<Result *>(ctx);
+        EXPECT_EQ(error, nullptr);
+        for (int32_t i = 0; i < count; i++) {
+          result->targets.push_back(targets[i]);
+          result->titles.push_back(targets[i].title);
+        }
+      },
+      &result);
+
+  ASSERT_EQ(result.targets.size(), 3u);
+  EXPECT_EQ(result.targets[1].isDisplay, 1);
+  EXPECT_EQ(result.targets[1].displayID, 2u);
+  EXPECT_EQ(result.targets[1].width, 320);
+  EXPECT_EQ(result.targets[2].isWindow, 1);
+  EXPECT_EQ(result.targets[2].height, 100);
+  EXPECT_EQ(result.titles[2], "Synthetic Window 1");
+}
+
+TEST_F(LinuxBackend, DeliversFramesAndAudio) {
+  Recorder recorder;
+  void    *capture = createMediaCapture();
+  startMediaCapture(capture, defaultConfig(), onVideo, onAudio, onExit, &recorder);
+
+  EXPECT_TRUE(recorder.waitFor([&] { return recorder.frames >= 5 && recorder.audioFrames >= 4800; }));
+  stopMediaCapture(capture, onStop, &recorder);
+
+  int     frames;
+  int64_t audioFrames;
+  {
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    EXPECT_TRUE(recorder.errors.empty());
+    EXPECT_TRUE(recorder.stopped);
+    EXPECT_EQ(recorder.lastWidth, 640);
+    EXPECT_EQ(recorder.lastHeight, 480);
+    EXPECT_EQ(recorder.lastFormat, "bgra");
+    EXPECT_EQ(recorder.lastSize, 640u * 480 * 4);
+    EXPECT_EQ(recorder.channels, 2);
+    EXPECT_EQ(recorder.sampleRate, 48000);
+    frames      = recorder.frames;
+    audioFrames = recorder.audioFrames;
+  }
+
+  // Nothing is delivered once stop has returned
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(recorder.frames, frames);
+  EXPECT_EQ(recorder.audioFrames, audioFrames);
+  destroyMediaCapture(capture);
+}
+
+TEST_F(LinuxBackend, ReportsStatsWhileRunning) {
+  Recorder recorder;
+  void    *capture = createMediaCapture();
+
+  MediaCaptureStatsC stats;
+  EXPECT_EQ(getMediaCaptureStats(capture, &stats), 0);
+
+  startMediaCapture(capture, defaultConfig(), onVideo, onAudio, onExit, &recorder);
+  ASSERT_TRUE(recorder.waitFor([&] { return recorder.frames >= 5 && recorder.audioFrames >= 4800; }));
+  ASSERT_EQ(getMediaCaptureStats(capture, &stats), 1);
+  stopMediaCapture(capture, nullptr, nullptr);
+  destroyMediaCapture(capture);
+
+  // Counters are updated after each callback returns, so they may trail the recorder by one
+  EXPECT_GE(stats.framesDelivered, 4u);
+  EXPECT_GE(stats.framesCaptured, stats.framesDelivered);
+  EXPECT_GE(stats.videoBytes, 4u * 640 * 480 * 4);
+  EXPECT_GT(stats.acquire.count, 0u);
+  EXPECT_GT(stats.copy.count, 0u);
+  EXPECT_GT(stats.encode.count, 0u);
+  EXPECT_LE(stats.encode.p50Ms, stats.encode.maxMs);
+  EXPECT_GT(stats.audioPackets, 0u);
+  EXPECT_EQ(stats.audioFrames % stats.audioPackets, 0u);
+  EXPECT_GE(stats.audioDeliver.count, stats.audioPackets - 1);
+}
+
+TEST_F(LinuxBackend, StampsAudioAndVideoOnOneClock) {
+  SyncRecorder recorder;
+  void        *capture = createMediaCapture();
+  startMediaCapture(capture, defaultConfig(), onSyncedVideo, onSyncedAudio, onExit, &recorder);
+  std::this_thread::sleep_for(std::chrono::milliseconds(400));
+  stopMediaCapture(capture, onStop, &recorder);
+  destroyMediaCapture(capture);
+
+  std::lock_guard<std::mutex> lock(recorder.mutex);
+  ASSERT_GT(recorder.audio.size(), 10u);
+  ASSERT_GT(recorder.video.size(), 5u);
+
+  // Audio blocks carry contiguous sample positions and a capture time before their delivery
+  int64_t expected = 0;
+  for (const SyncRecorder::Entry &entry : recorder.audio) {
+    ASSERT_TRUE(entry.stamp.valid);
+    ASSERT_TRUE(entry.stamp.hasAudio);
+    EXPECT_EQ(entry.stamp.audioPosition, expected);
+    EXPECT_LE(entry.stamp.captureNs, entry.callbackNs);
+    expected += entry.frames;
+  }
+
+  // Each frame's audio position is the sample captured at the frame's acquisition time
+  const SyncRecorder::Entry &lastAudio = recorder.audio.back();
+  size_t                     checked   = 0;
+  for (const SyncRecorder::Entry &entry : recorder.video) {
+    ASSERT_TRUE(entry.stamp.valid);
+    EXPECT_LE(entry.stamp.captureNs, entry.callbackNs);
+    if (!entry.stamp.hasAudio) {
+      continue;
+    }
+    double sampleNs = static_cast<double>(lastAudio.stamp.captureNs) +
+                      static_cast<double>(entry.stamp.audioPosition - lastAudio.stamp.audioPosition) * 1e9 / 48000;
+    EXPECT_NEAR(sampleNs, static_cast<double>(entry.stamp.captureNs), 1e6);
+    checked++;
+  }
+  EXPECT_GT(checked, 0u);
+}
+
+TEST_F(LinuxBackend, TracesCaptureThreads) {
+  Recorder recorder;
+  void    *capture = createMediaCapture();
+  setCaptureTracing(1);
+  startMediaCapture(capture, defaultConfig(), onVideo, onAudio, onExit, &recorder);
+  ASSERT_TRUE(recorder.waitFor([&] { return recorder.frames >= 3 && recorder.audioFrames >= 960; }));
+  stopMediaCapture(capture, nullptr, nullptr);
+  destroyMediaCapture(capture);
+  setCaptureTracing(0);
+
+  std::string path = ::testing::TempDir() + "linuxbackend_trace.json";
+  ASSERT_EQ(writeCaptureTrace(path.c_str()), 1);
+  std::FILE  *file = std::fopen(path.c_str(), "rb");
+  ASSERT_NE(file, nullptr);
+  std::string json;
+  char        chunk[4096];
+  for (size_t got; (got = std::fread(chunk, 1, sizeof(chunk), file)) > 0;) {
+    json.append(chunk, got);
+  }
+  std::fclose(file);
+  std::remove(path.c_str());
+
+  for (const char *expected : {"\"video-capture\"", "\"video-encode\"", "\"audio-capture\"", "\"name\":\"acquire\"",
+                               "\"name\":\"encode\"", "\"name\":\"deliver\"", "\"name\":\"audio-deliver\""}) {
+    EXPECT_NE(json.find(expected), std::string::npos) << expected;
+  }
+}
+
+TEST_F(LinuxBackend, AppliesCropRectWhileRunning) {
+  Recorder recorder;
+  void    *capture = createMediaCapture();
+  startMediaCapture(capture, defaultConfig(), onVideo, nullptr, onExit, &recorder);
+  ASSERT_TRUE(recorder.waitFor([&] { return recorder.frames >= 1; }));
+
+  Recorder applied;
+  setMediaCaptureCropRect(capture, {100, 50, 128, 64}, onExit, &applied);
+  ASSERT_EQ(applied.errors.size(), 1u);
+  EXPECT_EQ(applied.errors[0], "");
+  EXPECT_TRUE(recorder.waitFor([&] { return recorder.lastWidth == 128 && recorder.lastHeight == 64; }));
+
+  stopMediaCapture(capture, nullptr, nullptr);
+  destroyMediaCapture(capture);
+}
+
+TEST_F(LinuxBackend, RejectsCropRectOutsideTheTarget) {
+  Recorder recorder;
+  void    *capture = createMediaCapture();
+  startMediaCapture(capture, defaultConfig(), onVideo, nullptr, onExit, &recorder);
+  ASSERT_TRUE(recorder.waitFor([&] { return recorder.frames >= 1; }));
+
+  Recorder applied;
+  setMediaCaptureCropRect(capture, {100, 50, 128, 64}, onExit, &applied);
+  ASSERT_TRUE(recorder.waitFor([&] { return recorder.lastWidth == 128 && recorder.lastHeight == 64; }));
+
+  Recorder rejected;
+  setMediaCaptureCropRect(capture, {700, 500, 64, 64}, onExit, &rejected);
+  ASSERT_EQ(rejected.errors.size(), 1u);
+  EXPECT_EQ(rejected.errors[0], "Crop rectangle is outside the 640x480 target");
+
+  // The previous crop stays in effect
+  int frames = 0;
+  {
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    frames = recorder.frames;
+  }
+  ASSERT_TRUE(recorder.waitFor([&] { return recorder.frames >= frames + 2; }));
+  stopMediaCapture(capture, nullptr, nullptr);
+  destroyMediaCapture(capture);
+
+  EXPECT_EQ(recorder.lastWidth, 128);
+  EXPECT_EQ(recorder.lastHeight, 64);
+}
+
+TEST_F(LinuxBackend, EncodesJPEGWhenAvailable) {
+  if (!jpegCodecAvailable()) {
+    GTEST_SKIP() << "built without libjpeg";
+  }
+  Recorder            recorder;
+  MediaCaptureConfigC config = defaultConfig();
+  config.imageFormat         = 0;
+  config.windowID            = 1;
+  void *capture              = createMediaCapture();
+  startMediaCapture(capture, config, onVideo, nullptr, onExit, &recorder);
+  EXPECT_TRUE(recorder.waitFor([&] { return recorder.frames >= 2; }));
+  stopMediaCapture(capture, nullptr, nullptr);
+  destroyMediaCapture(capture);
+
+  EXPECT_EQ(recorder.lastFormat, "jpeg");
+  EXPECT_EQ(recorder.lastWidth, 200);
+  EXPECT_LT(recorder.lastSize, 200u * 100 * 4);
+}
+
+TEST_F(LinuxBackend, ReportsUnknownTarget) {
+  Recorder            recorder;
+  MediaCaptureConfigC config = defaultConfig();
+  config.displayID           = 7;
+  void *capture              = createMediaCapture();
+  startMediaCapture(capture, config, onVideo, onAudio, onExit, &recorder);
+  stopMediaCapture(capture, onStop, &recorder);
+  destroyMediaCapture(capture);
+
+  ASSERT_EQ(recorder.errors.size(), 1u);
+  EXPECT_NE(recorder.errors[0].find("displayID=7"), std::string::npos);
+  EXPECT_EQ(recorder.frames, 0);
+  EXPECT_TRUE(recorder.stopped);
+}
+
+TEST_F(LinuxBackend, StartReusesPreparedTarget) {
+  Recorder prepared;
+  Recorder recorder;
+  void    *capture = createMediaCapture();
+  prepareMediaCapture(capture, defaultConfig(), onExit, &prepared);
+  ASSERT_EQ(prepared.errors.size(), 1u);
+  EXPECT_EQ(prepared.errors[0], "");
+
+  // The display is gone, so only the source opened by prepare can deliver it
+  setenv("DESKTOP_CAPTURE_SYNTHETIC", "displays=;windows=200x100", 1);
+  MediaCaptureConfigC config = defaultConfig();
+  config.frameRate           = 30.0f;
+  startMediaCapture(capture, config, onVideo, onAudio, onExit, &recorder);
+  EXPECT_TRUE(recorder.waitFor([&] { return recorder.frames >= 2 && recorder.audioFrames >= 960; }));
+  stopMediaCapture(capture, onStop, &recorder);
+
+  // Stop released the preparation, so the next start opens the target afresh and fails
+  Recorder again;
+  startMediaCapture(capture, config, onVideo, onAudio, onExit, &again);
+  destroyMediaCapture(capture);
+
+  std::lock_guard<std::mutex> lock(recorder.mutex);
+  EXPECT_TRUE(recorder.errors.empty());
+  EXPECT_EQ(recorder.lastWidth, 640);
+  EXPECT_EQ(again.errors.size(), 1u);
+}
+
+TEST_F(LinuxBackend, StartIgnoresPreparationForAnotherTarget) {
+  Recorder prepared;
+  Recorder recorder;
+  void    *capture = createMediaCapture();
+  prepareMediaCapture(capture, defaultConfig(), onExit, &prepared);
+
+  MediaCaptureConfigC config = defaultConfig();
+  config.displayID           = 2;
+  startMediaCapture(capture, config, onVideo, onAudio, onExit, &recorder);
+  EXPECT_TRUE(recorder.waitFor([&] { return recorder.frames >= 2; }));
+  stopMediaCapture(capture, onStop, &recorder);
+  destroyMediaCapture(capture);
+
+  std::lock_guard<std::mutex> lock(recorder.mutex);
+  EXPECT_TRUE(recorder.errors.empty());
+  EXPECT_EQ(recorder.lastWidth, 320);
+  EXPECT_EQ(recorder.lastHeight, 200);
+}
+
+TEST_F(LinuxBackend, PrepareReportsUnknownTarget) {
+  Recorder            prepared;
+  MediaCaptureConfigC config = defaultConfig();
+  config.displayID           = 7;
+  void *capture              = createMediaCapture();
+  prepareMediaCapture(capture, config, onExit, &prepared);
+  destroyMediaCapture(capture);
+
+  ASSERT_EQ(prepared.errors.size(), 1u);
+  EXPECT_NE(prepared.errors[0].find("displayID=7"), std::string::npos);
+}
+
+TEST_F(LinuxBackend, ReconfiguresWithoutReopeningTheTarget) {
+  Recorder recorder;
+  void    *capture = createMediaCapture();
+  startMediaCapture(capture, defaultConfig(), onVideo, onAudio, onExit, &recorder);
+  ASSERT_TRUE(recorder.waitFor([&] { return recorder.frames >= 2 && recorder.audioFrames > 0; }));
+
+  // The display is gone, so the change only works on the source that is already open
+  setenv("DESKTOP_CAPTURE_SYNTHETIC", "displays=;windows=200x100", 1);
+  MediaCaptureConfigC config = defaultConfig();
+  config.frameRate           = 30.0f;
+  config.audioSampleRate     = 16000;
+  config.audioChannels       = 1;
+  Recorder applied;
+  reconfigureMediaCapture(capture, config, onExit, &applied);
+  ASSERT_EQ(applied.errors.size(), 1u);
+  EXPECT_EQ(applied.errors[0], "");
+
+  int framesBefore = 0;
+  {
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    framesBefore = recorder.frames;
+  }
+  EXPECT_TRUE(recorder.waitFor([&] {
+    return recorder.sampleRate == 16000 && recorder.channels == 1 && recorder.frames >= framesBefore + 2;
+  }));
+  stopMediaCapture(capture, onStop, &recorder);
+  destroyMediaCapture(capture);
+
+  std::lock_guard<std::mutex> lock(recorder.mutex);
+  EXPECT_TRUE(recorder.errors.empty());
+  EXPECT_EQ(recorder.lastWidth, 640);
+}
+
+TEST_F(LinuxBackend, ReconfigureRestartsForAnotherTarget) {
+  Recorder recorder;
+  void    *capture = createMediaCapture();
+  startMediaCapture(capture, defaultConfig(), onVideo, onAudio, onExit, &recorder);
+  ASSERT_TRUE(recorder.waitFor([&] { return recorder.frames >= 1; }));
+
+  MediaCaptureConfigC config = defaultConfig();
+  config.displayID           = 2;
+  Recorder applied;
+  reconfigureMediaCapture(capture, config, onExit, &applied);
+  EXPECT_TRUE(recorder.waitFor([&] { return recorder.lastWidth == 320 && recorder.lastHeight == 200; }));
+  stopMediaCapture(capture, onStop, &recorder);
+
+  // Without a running capture there is nothing to change
+  Recorder idle;
+  reconfigureMediaCapture(capture, config, onExit, &idle);
+  destroyMediaCapture(capture);
+
+  ASSERT_EQ(applied.errors.size(), 1u);
+  EXPECT_EQ(applied.errors[0], "");
+  EXPECT_TRUE(recorder.errors.empty());
+  ASSERT_EQ(idle.errors.size(), 1u);
+  EXPECT_NE(idle.errors[0], "");
+}
+
+TEST_F(LinuxBackend, CapturesSeveralTargetsInOneSession) {
+  struct TargetRecorder {
+    Recorder recorder;
+    int      frames[3] = {0, 0, 0};
+    int32_t  widths[3] = {0, 0, 0};
+  } targets;
+
+  MediaCaptureTargetRefC refs[3] = {};
+  refs[0].displayID              = 1;
+  refs[1].displayID              = 2;
+  refs[2].windowID               = 1;
+  refs[2].cropRect               = {0, 0, 50, 40};
+
+  void *capture = createMediaCapture();
+  startMultiTargetMediaCapture(
+      capture, defaultConfig(), refs, 3,
+      [](int32_t target, uint8_t *, int32_t width, int32_t, int32_t, const char *, const char *, size_t, void *ctx) {
+        auto *targets = static_cast<TargetRecorder *>(ctx);
+        {
+          std::lock_guard<std::mutex> lock(targets->recorder.mutex);
+          targets->frames[target]++;
+          targets->widths[target] = width;
+        }
+        targets->recorder.cv.notify_all();
+      },
+      onAudio, onExit, &targets);
+
+  EXPECT_TRUE(targets.recorder.waitFor([&] {
+    return targets.frames[0] >= 3 && targets.frames[1] >= 3 && targets.frames[2] >= 3 &&
+           targets.recorder.audioFrames >= 4800;
+  }));
+  MediaCaptureStatsC stats;
+  ASSERT_EQ(getMediaCaptureStats(capture, &stats), 1);
+  stopMediaCapture(capture, onStop, &targets.recorder);
+  destroyMediaCapture(capture);
+
+  std::lock_guard<std::mutex> lock(targets.recorder.mutex);
+  EXPECT_TRUE(targets.recorder.errors.empty());
+  EXPECT_EQ(targets.widths[0], 640);
+  EXPECT_EQ(targets.widths[1], 320);
+  EXPECT_EQ(targets.widths[2], 50);
+  EXPECT_GE(stats.framesDelivered, 8u);
+}
+
+TEST_F(LinuxBackend, MultiTargetStartFailsOnUnknownTarget) {
+  Recorder               recorder;
+  MediaCaptureTargetRefC refs[2] = {};
+  refs[0].displayID              = 1;
+  refs[1].displayID              = 7;
+
+  void *capture = createMediaCapture();
+  startMultiTargetMediaCapture(
+      capture, defaultConfig(), refs, 2,
+      [](int32_t, uint8_t *, int32_t, int32_t, int32_t, const char *, const char *, size_t, void *ctx) {
+        static_cast<Recorder *>(ctx)->frames++;
+      },
+      onAudio, onExit, &recorder);
+  stopMediaCapture(capture, onStop, &recorder);
+  destroyMediaCapture(capture);
+
+  ASSERT_EQ(recorder.errors.size(), 1u);
+  EXPECT_NE(recorder.errors[0].find("Target 1"), std::string::npos);
+  EXPECT_EQ(recorder.frames, 0);
+  EXPECT_EQ(recorder.audioFrames, 0);
+}
+
+TEST_F(LinuxBackend, DeliversSeveralRenditionsOfOneTarget) {
+  struct RenditionRecorder {
+    Recorder recorder;
+    int      frames[2]  = {0, 0};
+    int32_t  widths[2]  = {0, 0};
+    int32_t  heights[2] = {0, 0};
+  } renditions;
+
+  // Full size at the configured rate next to a 15 fps thumbnail
+  MediaCaptureRenditionC refs[2] = {};
+  refs[0].imageFormat            = 1;
+  refs[1].frameRate              = 15.0f;
+  refs[1].maxWidth               = 160;
+  refs[1].imageFormat            = 1;
+
+  void *capture = createMediaCapture();
+  startMultiRenditionMediaCapture(
+      capture, defaultConfig(), refs, 2,
+      [](int32_t rendition, uint8_t *, int32_t width, int32_t height, int32_t, const char *, const char *, size_t,
+         void *ctx) {
+        auto *renditions = static_cast<RenditionRecorder *>(ctx);
+        {
+          std::lock_guard<std::mutex> lock(renditions->recorder.mutex);
+          renditions->frames[rendition]++;
+          renditions->widths[rendition]  = width;
+          renditions->heights[rendition] = height;
+        }
+        renditions->recorder.cv.notify_all();
+      },
+      onAudio, onExit, &renditions);
+
+  EXPECT_TRUE(renditions.recorder.waitFor([&] { return renditions.frames[1] >= 3; }));
+  MediaCaptureStatsC stats;
+  ASSERT_EQ(getMediaCaptureStats(capture, &stats), 1);
+  stopMediaCapture(capture, onStop, &renditions.recorder);
+  destroyMediaCapture(capture);
+
+  std::lock_guard<std::mutex> lock(renditions.recorder.mutex);
+  EXPECT_TRUE(renditions.recorder.errors.empty());
+  EXPECT_EQ(renditions.widths[0], 640);
+  EXPECT_EQ(renditions.heights[0], 480);
+  EXPECT_EQ(renditions.widths[1], 160);
+  EXPECT_EQ(renditions.heights[1], 120);
+  EXPECT_GT(renditions.frames[0], renditions.frames[1] * 2);
+
+  // The thumbnail rides on acquisitions of the full-size rendition
+  EXPECT_LE(stats.framesCaptured, static_cast<uint64_t>(renditions.frames[0]) + 4);
+}
+
+TEST_F(LinuxBackend, LegacyAudioCapture) {
+  int counts[2] = {0, 0};
+  enumerateDesktopWindows(
+      [](DisplayInfo *, int32_t displayCount, WindowInfo *windows, int32_t windowCount, char *error, void *ctx) {
+        auto *counts = static_cast<int *>(ctx);
+        counts[0]    = displayCount;
+        counts[1]    = windowCount;
+        EXPECT_EQ(error, nullptr);
+        EXPECT_STREQ(windows[0].title, "Synthetic Window 1");
+      },
+      counts);
+  EXPECT_EQ(counts[0], 2);
+  EXPECT_EQ(counts[1], 1);
+
+  Recorder recorder;
+  void    *capture = createCapture();
+  startCapture(capture, {1, 16000, 1, 0}, onAudio, onExit, &recorder);
+  EXPECT_TRUE(recorder.waitFor([&] { return recorder.audioFrames >= 1600; }));
+  stopCapture(capture, onStop, &recorder);
+  destroyCapture(capture);
+
+  EXPECT_EQ(recorder.channels, 1);
+  EXPECT_EQ(recorder.sampleRate, 16000);
+  EXPECT_TRUE(recorder.stopped);
+  EXPECT_TRUE(recorder.errors.empty());
+}
+
+TEST_F(LinuxBackend, AudioTargetCapturesAudioOnly) {
+  Recorder            recorder;
+  MediaCaptureConfigC config = defaultConfig();
+  config.displayID           = 0;
+  config.windowID            = 101; // Microphone, as on Windows
+  void *capture              = createMediaCapture();
+  startMediaCapture(capture, config, onVideo, onAudio, onExit, &recorder);
+  EXPECT_TRUE(recorder.waitFor([&] { return recorder.audioFrames >= 4800; }));
+  stopMediaCapture(capture, onStop, &recorder);
+  destroyMediaCapture(capture);
+
+  EXPECT_EQ(recorder.frames, 0);
+  EXPECT_TRUE(recorder.errors.empty());
+}
@@ -0,0 +1,192 @@
+#include "lookbackbuffer.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+/** A frame whose bytes all hold its index, so copies can be told apart */
+std::vector<uint8_t> frameBytes(size_t size, uint32_t index) {
+  return std::vector<uint8_t>(size, static_cast<uint8_t>(index));
+}
+
+/** Push mono audio whose sample values count up from start, in 10 ms blocks from timestampMs */
+void pushRamp(LookbackBuffer &buffer, int32_t sampleRate, uint32_t start, uint32_t frames, int64_t timestampMs) {
+  const uint32_t     block = static_cast<uint32_t>(sampleRate / 100);
+  std::vector<float> samples(block);
+  for (uint32_t offset = 0; offset < frames; offset += block) {
+    for (uint32_t i = 0; i < block; i++) {
+      samples[i] = static_cast<float>(start + offset + i);
+    }
+    buffer.writeAudio(samples.data(), block, 1, sampleRate, timestampMs + offset * 1000 / sampleRate);
+  }
+}
+
+} // namespace
+
+TEST(LookbackBuffer, KeepsTheLastSecondsOfAudio) {
+  LookbackOptions options;
+  options.seconds         = 2;
+  options.audioSampleRate = 16000;
+  options.audioChannels   = 1;
+  LookbackBuffer buffer(options);
+
+  // Five seconds in, only the last two are held
+  pushRamp(buffer, 16000, 0, 80000, 1000000);
+  LookbackSnapshot snapshot;
+  buffer.snapshot(10, snapshot);
+  ASSERT_EQ(snapshot.audioFrames, 32000u);
+  EXPECT_EQ(snapshot.channels, 1);
+  EXPECT_EQ(snapshot.sampleRate, 16000);
+  EXPECT_EQ(snapshot.audioStartMs, 1003000);
+  for (uint32_t i = 0; i < snapshot.audioFrames; i++) {
+    ASSERT_EQ(snapshot.audio()[i], static_cast<float>(48000 + i)) << i;
+  }
+
+  // A shorter span is the newest part of it
+  buffer.snapshot(0.5, snapshot);
+  ASSERT_EQ(snapshot.audioFrames, 8000u);
+  EXPECT_EQ(snapshot.audio()[0], 72000.0f);
+  EXPECT_EQ(snapshot.audioStartMs, 1004500);
+  EXPECT_EQ(snapshot.data.size(), 8000u * sizeof(float));
+}
+
+TEST(LookbackBuffer, FramesFollowTheSpanAndTheBudget) {
+  LookbackOptions options;
+  options.seconds         = 10;
+  options.maxBytes        = 10000;
+  options.audioSampleRate = 0;
+  LookbackBuffer buffer(options);
+
+  // 30 frames of 1000 bytes, 100 ms apart: the 10000-byte arena holds the last 10
+  for (uint32_t i = 0; i < 30; i++) {
+    std::vector<uint8_t> bytes = frameBytes(1000, i);
+    EXPECT_TRUE(buffer.writeVideo(bytes.data(), bytes.size(), 64, 48, 256, true, 5000 + i * 100));
+  }
+  EXPECT_EQ(buffer.memoryBytes(), 10000u);
+
+  LookbackSnapshot snapshot;
+  buffer.snapshot(10, snapshot);
+  ASSERT_EQ(snapshot.frames.size(), 10u);
+  EXPECT_EQ(snapshot.audioFrames, 0u);
+  EXPECT_EQ(snapshot.data.size(), 10000u);
+  for (size_t i = 0; i < snapshot.frames.size(); i++) {
+    const LookbackFrame &frame = snapshot.frames[i];
+    EXPECT_EQ(frame.timestampMs, static_cast<int64_t>(5000 + (20 + i) * 100));
+    EXPECT_EQ(frame.offset, i * 1000);
+    EXPECT_EQ(frame.width, 64);
+    EXPECT_TRUE(frame.jpeg);
+    EXPECT_EQ(snapshot.data[frame.offset], static_cast<uint8_t>(20 + i));
+    EXPECT_EQ(snapshot.data[frame.offset + frame.size - 1], static_cast<uint8_t>(20 + i));
+  }
+
+  // Half a second back starts at the frame shown then: 7400 ms
+  buffer.snapshot(0.5, snapshot);
+  ASSERT_EQ(snapshot.frames.size(), 6u);
+  EXPECT_EQ(snapshot.frames.front().timestampMs, 7400);
+
+  // A frame larger than the arena is refused and leaves the others alone
+  std::vector<uint8_t> huge = frameBytes(20000, 99);
+  EXPECT_FALSE(buffer.writeVideo(huge.data(), huge.size(), 64, 48, 256, true, 8000));
+  EXPECT_EQ(buffer.droppedFrames(), 1u);
+  buffer.snapshot(10, snapshot);
+  EXPECT_EQ(snapshot.frames.size(), 10u);
+}
+
+TEST(LookbackBuffer, VariableFrameSizesWrapWithoutCorruption) {
+  LookbackOptions options;
+  options.maxBytes        = 4096;
+  options.audioSampleRate = 0;
+  LookbackBuffer buffer(options);
+
+  // Sizes that leave unused space at the end of the arena when they wrap
+  const size_t sizes[] = {700, 1300, 450, 999, 1600, 10, 2048, 333};
+  for (uint32_t i = 0; i < 200; i++) {
+    std::vector<uint8_t> bytes = frameBytes(sizes[i % 8], i);
+    ASSERT_TRUE(buffer.writeVideo(bytes.data(), bytes.size(), 1, 1, 4, false, i));
+
+    LookbackSnapshot snapshot;
+    buffer.snapshot(30, snapshot);
+    ASSERT_FALSE(snapshot.frames.empty());
+    EXPECT_EQ(snapshot.frames.back().timestampMs, i);
+    size_t total = 0;
+    for (const LookbackFrame &frame : snapshot.frames) {
+      uint8_t tag = static_cast<uint8_t>(frame.timestampMs);
+      ASSERT_EQ(frame.size, sizes[frame.timestampMs % 8]);
+      for (size_t b = 0; b < frame.size; b++) {
+        ASSERT_EQ(snapshot.data[frame.offset + b], tag) << "frame " << frame.timestampMs << " after " << i;
+      }
+      total += frame.size;
+    }
+    EXPECT_LE(total, 4096u);
+  }
+}
+
+TEST(LookbackBuffer, SplitsTheBudgetBetweenAudioAndVideo) {
+  LookbackOptions options;
+  options.seconds         = 60;
+  options.maxBytes        = 1 << 20;
+  options.audioSampleRate = 48000;
+  options.audioChannels   = 2;
+  LookbackBuffer buffer(options);
+
+  // A minute of 48 kHz stereo needs 23 MB; audio gets half the budget instead and video the rest
+  pushRamp(buffer, 48000, 0, 48000, 0);
+  std::vector<uint8_t> bytes = frameBytes(1000, 1);
+  buffer.writeVideo(bytes.data(), bytes.size(), 1, 1, 4, true, 500);
+  EXPECT_LE(buffer.memoryBytes(), options.maxBytes);
+
+  // The capture delivers mono, whose ring is sized from the same share
+  LookbackSnapshot snapshot;
+  buffer.snapshot(60, snapshot);
+  EXPECT_EQ(snapshot.audioFrames, 48000u);
+  EXPECT_EQ(snapshot.frames.size(), 1u);
+  EXPECT_EQ(snapshot.data.size(), 48000u * sizeof(float) + 1000u);
+}
+
+TEST(LookbackBuffer, EmptyBufferGivesAnEmptySnapshot) {
+  LookbackBuffer   buffer{LookbackOptions()};
+  LookbackSnapshot snapshot;
+  snapshot.data.resize(10);
+  buffer.snapshot(5, snapshot);
+  EXPECT_TRUE(snapshot.data.empty());
+  EXPECT_TRUE(snapshot.frames.empty());
+  EXPECT_EQ(snapshot.audioFrames, 0u);
+}
+
+TEST(LookbackBuffer, WritesSnapshotAsRecording) {
+  fs::path dir = fs::temp_directory_path() / "lookbackbuffer-WritesSnapshotAsRecording";
+  fs::remove_all(dir);
+
+  LookbackOptions options;
+  options.audioSampleRate = 16000;
+  options.audioChannels   = 1;
+  LookbackBuffer buffer(options);
+  pushRamp(buffer, 16000, 0, 16000, 1000);
+  const uint8_t jpeg[] = {0xFF, 0xD8, 0x01, 0x02, 0xFF, 0xD9};
+  for (int64_t t = 1000; t < 2000; t += 250) {
+    buffer.writeVideo(jpeg, sizeof(jpeg), 8, 8, 32, true, t);
+  }
+
+  LookbackSnapshot snapshot;
+  buffer.snapshot(1, snapshot);
+  std::string error;
+  ASSERT_TRUE(writeLookbackSnapshot(snapshot, dir.string(), error)) << error;
+
+  // 44-byte WAV header plus one second of mono float; four frames back to back
+  EXPECT_EQ(fs::file_size(dir / "audio-0001.wav"), 44u + 16000u * sizeof(float));
+  EXPECT_EQ(fs::file_size(dir / "video-0001.mjpeg"), 4 * sizeof(jpeg));
+  std::ifstream      index(dir / "video-0001.csv");
+  std::ostringstream lines;
+  lines << index.rdbuf();
+  EXPECT_NE(lines.str().find("1750"), std::string::npos);
+
+  std::error_code code;
+  fs::remove_all(dir, code);
+}
@@ -0,0 +1,166 @@
+#include "melspectrogram.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+/**
+ * Straightforward double-precision log-mel frame, written the way librosa computes
+ * melspectrogram(center=False, power=2) followed by a natural log: a direct DFT
+ * instead of an FFT and a dense filterbank built from the mel ramps.
+ */
+std::vector<double> referenceFrame(const MelSpectrogramConfig &config, const float *samples) {
+  const uint32_t n    = config.nFft;
+  const uint32_t win  = config.winLength ? config.winLength : n;
+  const uint32_t bins = n / 2 + 1;
+
+  std::vector<double> frame(n, 0.0);
+  for (uint32_t i = 0; i < win; i++) {
+    uint32_t at = (n - win) / 2 + i;
+    frame[at]   = samples[at] * (0.5 - 0.5 * std::cos(2.0 * kPi * i / win));
+  }
+  std::vector<double> power(bins);
+  for (uint32_t k = 0; k < bins; k++) {
+    double re = 0, im = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      re += frame[i] * std::cos(2.0 * kPi * k * i / n);
+      im -= frame[i] * std::sin(2.0 * kPi * k * i / n);
+    }
+    power[k] = re * re + im * im;
+  }
+
+  auto hzToMel = [](double hz) {
+    return hz < 1000.0 ? hz * 3.0 / 200.0 : 15.0 + std::log(hz / 1000.0) * 27.0 / std::log(6.4);
+  };
+  auto melToHz = [](double mel) {
+    return mel < 15.0 ? mel * 200.0 / 3.0 : 1000.0 * std::exp((mel - 15.0) * std::log(6.4) / 27.0);
+  };
+  double              fmax = config.fmax > 0 ? config.fmax : config.sampleRate / 2.0;
+  std::vector<double> melF(config.nMels + 2);
+  for (uint32_t i = 0; i < melF.size(); i++) {
+    double lo = hzToMel(config.fmin), hi = hzToMel(fmax);
+    melF[i]   = melToHz(lo + (hi - lo) * i / (config.nMels + 1));
+  }
+
+  std::vector<double> out(config.nMels);
+  for (uint32_t m = 0; m < config.nMels; m++) {
+    double energy = 0;
+    for (uint32_t k = 0; k < bins; k++) {
+      double hz     = static_cast<double>(k) * config.sampleRate / n;
+      double lower  = (hz - melF[m]) / (melF[m + 1] - melF[m]);
+      double upper  = (melF[m + 2] - hz) / (melF[m + 2] - melF[m + 1]);
+      double weight = std::max(0.0, std::min(lower, upper)) * 2.0 / (melF[m + 2] - melF[m]);
+      energy += weight * power[k];
+    }
+    out[m] = std::log(std::max(energy, static_cast<double>(config.logFloor)));
+  }
+  return out;
+}
+
+/** Speech-like test signal: a few harmonics over broadband noise */
+std::vector<float> testSignal(int32_t sampleRate, uint32_t count) {
+  std::mt19937                    rng(7);
+  std::normal_distribution<float> noise(0.0f, 0.05f);
+  std::vector<float>              signal(count);
+  for (uint32_t i = 0; i < count; i++) {
+    double t  = static_cast<double>(i) / sampleRate;
+    signal[i] = static_cast<float>(0.3 * std::sin(2 * kPi * 220 * t) + 0.2 * std::sin(2 * kPi * 660 * t) +
+                                   0.1 * std::sin(2 * kPi * 2500 * t)) +
+                noise(rng);
+  }
+  return signal;
+}
+
+} // namespace
+
+TEST(MelSpectrogram, SlaneyMelScale) {
+  EXPECT_DOUBLE_EQ(MelSpectrogram::hzToMel(0), 0.0);
+  EXPECT_NEAR(MelSpectrogram::hzToMel(440), 6.6, 1e-9);
+  EXPECT_NEAR(MelSpectrogram::hzToMel(1000), 15.0, 1e-9);
+  EXPECT_NEAR(MelSpectrogram::hzToMel(8000), 45.2456405, 1e-6);
+  for (double hz : {0.0, 123.0, 999.0, 1000.0, 4321.0, 24000.0}) {
+    EXPECT_NEAR(MelSpectrogram::melToHz(MelSpectrogram::hzToMel(hz)), hz, 1e-6 * (1 + hz));
+  }
+}
+
+TEST(MelSpectrogram, MatchesReferenceImplementation) {
+  // A power-of-two transform with a shorter window (FFT path) and Whisper's 400-point one (direct path)
+  MelSpectrogramConfig fft;
+  MelSpectrogramConfig whisper;
+  whisper.nFft      = 400;
+  whisper.winLength = 0;
+  MelSpectrogramConfig narrow;
+  narrow.nFft  = 1024;
+  narrow.nMels = 40;
+  narrow.fmin  = 125;
+  narrow.fmax  = 7600;
+
+  std::vector<float> signal = testSignal(16000, 16000);
+  for (const MelSpectrogramConfig &config : {fft, whisper, narrow}) {
+    MelSpectrogram     mel(config);
+    std::vector<float> frame(config.nMels);
+    for (uint32_t start = 0; start + config.nFft <= signal.size(); start += 1597) {
+      mel.computeFrame(signal.data() + start, frame.data());
+      std::vector<double> reference = referenceFrame(mel.config(), signal.data() + start);
+      for (uint32_t m = 0; m < config.nMels; m++) {
+        ASSERT_NEAR(frame[m], reference[m], 1e-3) << "nFft " << config.nFft << " frame at " << start << " bin " << m;
+      }
+    }
+  }
+}
+
+TEST(MelSpectrogram, ToneLandsInItsBin) {
+  MelSpectrogramConfig config;
+  MelSpectrogram       mel(config);
+  std::vector<float>   tone(config.nFft);
+  for (uint32_t i = 0; i < tone.size(); i++) {
+    tone[i] = static_cast<float>(0.5 * std::sin(2 * kPi * 1000 * i / 16000.0));
+  }
+  std::vector<float> frame(config.nMels);
+  mel.computeFrame(tone.data(), frame.data());
+
+  size_t peak = std::max_element(frame.begin(), frame.end()) - frame.begin();
+  EXPECT_LT(mel.filterEdges()[peak], 1000.0);
+  EXPECT_GT(mel.filterEdges()[peak + 2], 1000.0);
+}
+
+TEST(MelSpectrogram, StreamsFramesAtEachHop) {
+  MelSpectrogramConfig config;
+  MelSpectrogram       streaming(config);
+  MelSpectrogram       batch(config);
+  std::vector<float>   signal = testSignal(16000, 8000);
+
+  std::vector<float>   streamed;
+  std::vector<int64_t> positions;
+  uint32_t             offset = 0;
+  for (uint32_t block : {100u, 37u, 1000u, 3u, 2000u, 4860u}) {
+    SyncStamp stamp;
+    stamp.hasAudio      = true;
+    stamp.audioPosition = offset;
+    streaming.push(signal.data() + offset, block, stamp,
+                   [&](const float *features, uint32_t frames, const SyncStamp &first) {
+                     streamed.insert(streamed.end(), features, features + frames * config.nMels);
+                     for (uint32_t i = 0; i < frames; i++) {
+                       positions.push_back(first.audioPosition + i * config.hop);
+                     }
+                   });
+    offset += block;
+  }
+
+  // (8000 - 512) / 160 + 1 frames, each the frame computed on its own
+  ASSERT_EQ(positions.size(), 47u);
+  std::vector<float> frame(config.nMels);
+  for (size_t i = 0; i < positions.size(); i++) {
+    EXPECT_EQ(positions[i], static_cast<int64_t>(i * config.hop));
+    batch.computeFrame(signal.data() + i * config.hop, frame.data());
+    for (uint32_t m = 0; m < config.nMels; m++) {
+      ASSERT_FLOAT_EQ(streamed[i * config.nMels + m], frame[m]) << i;
+    }
+  }
+}
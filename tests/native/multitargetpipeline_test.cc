@@ -0,0 +1,221 @@
+#include "multitargetpipeline.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/** Produces solid frames whose first byte carries the target's frame count */
+class CountingSource : public VideoFrameSource {
+public:
+  explicit CountingSource(int32_t width) : width(width) {}
+
+  AcquireResult acquireFrame(VideoFrame &frame, uint32_t) override {
+    frame.width       = width;
+    frame.height      = 8;
+    frame.bytesPerRow = width * 4;
+    frame.pixels.resize(frame.bytesPerRow * frame.height);
+    std::memset(frame.pixels.data(), static_cast<int>(produced & 0xff), frame.pixels.size());
+    produced++;
+    return AcquireResult::Frame;
+  }
+  const char *lastAcquireError() const override {
+    return "";
+  }
+
+  const int32_t         width;
+  std::atomic<uint64_t> produced{0};
+};
+
+/** A target that disappears after its first frames */
+class VanishingSource : public CountingSource {
+public:
+  VanishingSource(int32_t width, uint64_t frames) : CountingSource(width), frames(frames) {}
+
+  AcquireResult acquireFrame(VideoFrame &frame, uint32_t timeoutMs) override {
+    return produced >= frames ? AcquireResult::Fatal : CountingSource::acquireFrame(frame, timeoutMs);
+  }
+  const char *lastAcquireError() const override {
+    return "target gone";
+  }
+
+  const uint64_t frames;
+};
+
+/** Copies the first bytes and sleeps; fails if two workers ever encode it at once */
+class CheckedEncoder : public VideoFrameEncoder {
+public:
+  explicit CheckedEncoder(std::chrono::milliseconds cost) : cost(cost) {}
+
+  bool encodeFrame(const VideoFrame &frame, EncodedFrame &out) override {
+    EXPECT_EQ(active.fetch_add(1), 0) << "encoder used by two workers at once";
+    std::this_thread::sleep_for(cost);
+    out.data.assign(frame.pixels.begin(), frame.pixels.begin() + 4);
+    out.width       = frame.width;
+    out.height      = frame.height;
+    out.bytesPerRow = frame.bytesPerRow;
+    out.format      = "test";
+    active.fetch_sub(1);
+    return true;
+  }
+  const char *lastEncodeError() const override {
+    return "";
+  }
+
+  std::chrono::milliseconds cost;
+  std::atomic<int>          active{0};
+};
+
+struct Delivered {
+  std::mutex                        mutex;
+  std::vector<std::vector<uint8_t>> firstBytes{8};
+  std::vector<int32_t>              widths{std::vector<int32_t>(8, 0)};
+  std::set<std::thread::id>         threads;
+  std::vector<std::string>          exits;
+  size_t                            framesAfterExit = 0;
+};
+
+void onVideoFrame(
+    int32_t target, uint8_t *data, int32_t width, int32_t, int32_t, const char *, const char *format, size_t,
+    void *ctx) {
+  auto                       *delivered = static_cast<Delivered *>(ctx);
+  std::lock_guard<std::mutex> lock(delivered->mutex);
+  ASSERT_GE(target, 0);
+  ASSERT_LT(target, 8);
+  delivered->firstBytes[target].push_back(data[0]);
+  delivered->widths[target] = width;
+  delivered->threads.insert(std::this_thread::get_id());
+  delivered->framesAfterExit += delivered->exits.size();
+  EXPECT_STREQ(format, "test");
+}
+
+void onExit(char *error, void *ctx) {
+  auto                       *delivered = static_cast<Delivered *>(ctx);
+  std::lock_guard<std::mutex> lock(delivered->mutex);
+  delivered->exits.push_back(error ? error : "");
+}
+
+} // namespace
+
+TEST(MultiTargetPipeline, TagsFramesWithTheirTarget) {
+  CountingSource      first(16), second(32), third(48);
+  CheckedEncoder      encoders[3] = {CheckedEncoder(std::chrono::milliseconds(0)),
+                                     CheckedEncoder(std::chrono::milliseconds(0)),
+                                     CheckedEncoder(std::chrono::milliseconds(0))};
+  MultiTargetPipeline pipeline(2);
+  Delivered           delivered;
+
+  EXPECT_EQ(pipeline.addTarget(first, encoders[0]), 0u);
+  EXPECT_EQ(pipeline.addTarget(second, encoders[1]), 1u);
+  EXPECT_EQ(pipeline.addTarget(third, encoders[2]), 2u);
+  EXPECT_EQ(pipeline.encoderThreadCount(), 2u);
+
+  ASSERT_TRUE(pipeline.start(100.0f, onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  pipeline.stop();
+
+  std::lock_guard<std::mutex> lock(delivered.mutex);
+  EXPECT_EQ(delivered.widths[0], 16);
+  EXPECT_EQ(delivered.widths[1], 32);
+  EXPECT_EQ(delivered.widths[2], 48);
+  // Every callback comes from the one delivery thread
+  EXPECT_EQ(delivered.threads.size(), 1u);
+
+  // Each target's frames arrive complete and in capture order
+  for (size_t target = 0; target < 3; target++) {
+    const std::vector<uint8_t> &bytes = delivered.firstBytes[target];
+    ASSERT_GT(bytes.size(), 10u) << target;
+    for (size_t i = 1; i < bytes.size(); i++) {
+      EXPECT_EQ(static_cast<uint8_t>(bytes[i] - bytes[i - 1]), 1) << target;
+    }
+    VideoPipelineStats stats = pipeline.targetStats(target);
+    EXPECT_EQ(stats.framesEncoded, bytes.size());
+    EXPECT_EQ(stats.framesDropped, 0u);
+  }
+
+  VideoPipelineStats total = pipeline.stats();
+  EXPECT_EQ(total.framesEncoded,
+            delivered.firstBytes[0].size() + delivered.firstBytes[1].size() + delivered.firstBytes[2].size());
+  EXPECT_GT(total.encode.count, 0u);
+  EXPECT_GT(total.deliver.count, 0u);
+}
+
+TEST(MultiTargetPipeline, SlowTargetDoesNotStarveTheOthers) {
+  CountingSource      slowSource(16), fastSource(32);
+  CheckedEncoder      slowEncoder(std::chrono::milliseconds(30));
+  CheckedEncoder      fastEncoder(std::chrono::milliseconds(1));
+  MultiTargetPipeline pipeline(1);
+  Delivered           delivered;
+
+  pipeline.addTarget(slowSource, slowEncoder);
+  pipeline.addTarget(fastSource, fastEncoder);
+
+  // One worker for both: round-robin gives the fast target a turn after every slow encode
+  ASSERT_TRUE(pipeline.start(50.0f, onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  pipeline.stop();
+
+  VideoPipelineStats slow = pipeline.targetStats(0);
+  VideoPipelineStats fast = pipeline.targetStats(1);
+  // The worker alternates, so both targets get the same number of turns
+  EXPECT_GT(slow.framesEncoded, 5u);
+  EXPECT_GE(fast.framesEncoded + 2, slow.framesEncoded);
+  EXPECT_LE(fast.framesEncoded, slow.framesEncoded + 2);
+  EXPECT_GT(fast.framesCaptured, 20u);
+}
+
+TEST(MultiTargetPipeline, RestartAfterStop) {
+  CountingSource      source(16);
+  CheckedEncoder      encoder(std::chrono::milliseconds(1));
+  MultiTargetPipeline pipeline;
+  Delivered           delivered;
+
+  EXPECT_FALSE(pipeline.start(100.0f, onVideoFrame, nullptr, &delivered));
+  pipeline.addTarget(source, encoder);
+  EXPECT_EQ(pipeline.encoderThreadCount(), 1u);
+
+  ASSERT_TRUE(pipeline.start(100.0f, onVideoFrame, nullptr, &delivered));
+  EXPECT_FALSE(pipeline.start(100.0f, onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  pipeline.stop();
+  EXPECT_FALSE(pipeline.isRunning());
+
+  size_t firstRun;
+  {
+    std::lock_guard<std::mutex> lock(delivered.mutex);
+    firstRun = delivered.firstBytes[0].size();
+  }
+  ASSERT_TRUE(pipeline.start(100.0f, onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  pipeline.stop();
+
+  std::lock_guard<std::mutex> lock(delivered.mutex);
+  EXPECT_GT(delivered.firstBytes[0].size(), firstRun);
+}
+
+TEST(MultiTargetPipeline, ReportsAVanishedTargetOnce) {
+  CountingSource      steady(16);
+  VanishingSource     vanishing(32, 3);
+  CheckedEncoder      steadyEncoder(std::chrono::milliseconds(0));
+  CheckedEncoder      vanishingEncoder(std::chrono::milliseconds(0));
+  MultiTargetPipeline pipeline;
+  Delivered           delivered;
+  pipeline.addTarget(steady, steadyEncoder);
+  pipeline.addTarget(vanishing, vanishingEncoder);
+
+  ASSERT_TRUE(pipeline.start(100.0f, onVideoFrame, onExit, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  uint64_t produced = steady.produced.load();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  pipeline.stop();
+
+  ASSERT_EQ(delivered.exits.size(), 1u);
+  EXPECT_EQ(delivered.exits[0], "target gone");
+  EXPECT_EQ(delivered.framesAfterExit, 0u);
+  // One target failing for good stops the whole capture
+  EXPECT_EQ(steady.produced.load(), produced);
+}
@@ -0,0 +1,76 @@
+#ifdef CAPTURE_HAVE_PULSE
+
+#include "pulseaudiosource.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Blocks {
+  std::mutex               mutex;
+  std::condition_variable  cv;
+  int                      count      = 0;
+  int32_t                  frameCount = 0;
+  int32_t                  channels   = 0;
+  int32_t                  sampleRate = 0;
+  std::vector<std::string> errors;
+};
+
+void onAudio(int32_t channels, int32_t sampleRate, float *, int32_t frameCount, void *ctx) {
+  auto *blocks = static_cast<Blocks *>(ctx);
+  {
+    std::lock_guard<std::mutex> lock(blocks->mutex);
+    blocks->count++;
+    blocks->frameCount = frameCount;
+    blocks->channels   = channels;
+    blocks->sampleRate = sampleRate;
+  }
+  blocks->cv.notify_all();
+}
+
+void onExit(char *error, void *ctx) {
+  auto                       *blocks = static_cast<Blocks *>(ctx);
+  std::lock_guard<std::mutex> lock(blocks->mutex);
+  blocks->errors.push_back(error ? error : "");
+}
+
+class PulseAudio : public ::testing::Test {
+protected:
+  void SetUp() override {
+    if (!pulseServerAvailable()) {
+      GTEST_SKIP() << "no PulseAudio or PipeWire server";
+    }
+  }
+};
+
+} // namespace
+
+TEST_F(PulseAudio, DeliversFixedBlocksFromMonitor) {
+  Blocks           blocks;
+  PulseAudioSource source(false);
+  ASSERT_TRUE(source.start(48000, 2, onAudio, onExit, &blocks)) << source.lastError();
+  {
+    // A monitor of an idle sink still produces silence at the nominal rate
+    std::unique_lock<std::mutex> lock(blocks.mutex);
+    EXPECT_TRUE(blocks.cv.wait_for(lock, std::chrono::seconds(5), [&] { return blocks.count >= 20; }));
+  }
+  source.stop();
+
+  EXPECT_TRUE(blocks.errors.empty());
+  EXPECT_EQ(blocks.frameCount, 480);
+  EXPECT_EQ(blocks.channels, 2);
+  EXPECT_EQ(blocks.sampleRate, 48000);
+}
+
+TEST_F(PulseAudio, RejectsInvalidFormat) {
+  Blocks           blocks;
+  PulseAudioSource source(false);
+  EXPECT_FALSE(source.start(48000, 0, onAudio, onExit, &blocks));
+  EXPECT_NE(std::string(source.lastError()).find("Unsupported"), std::string::npos);
+}
+
+#endif // CAPTURE_HAVE_PULSE
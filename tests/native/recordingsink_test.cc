@@ -0,0 +1,265 @@
+#include "recordingsink.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+/** Each test records into its own empty directory */
+class RecordingSinkTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    dir = fs::temp_directory_path() /
+          ("recordingsink-" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()));
+    fs::remove_all(dir);
+  }
+  void TearDown() override {
+    std::error_code code;
+    fs::remove_all(dir, code);
+  }
+
+  RecordingOptions options(RecordingAudioFormat audio, RecordingVideoFormat video) const {
+    RecordingOptions result;
+    result.dir   = dir.string();
+    result.audio = audio;
+    result.video = video;
+    return result;
+  }
+
+  std::string read(const std::string &name) const {
+    std::ifstream      file(dir / name, std::ios::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+  }
+
+  fs::path dir;
+};
+
+uint32_t readLE32(const std::string &bytes, size_t offset) {
+  uint32_t value = 0;
+  std::memcpy(&value, bytes.data() + offset, sizeof(value));
+  return value;
+}
+
+uint16_t readLE16(const std::string &bytes, size_t offset) {
+  uint16_t value = 0;
+  std::memcpy(&value, bytes.data() + offset, sizeof(value));
+  return value;
+}
+
+} // namespace
+
+TEST(RecordingFormat, ParsesNames) {
+  RecordingAudioFormat audio = RecordingAudioFormat::None;
+  EXPECT_TRUE(parseRecordingAudioFormat("wav", audio));
+  EXPECT_EQ(audio, RecordingAudioFormat::Wav);
+  EXPECT_TRUE(parseRecordingAudioFormat("raw", audio));
+  EXPECT_EQ(audio, RecordingAudioFormat::Raw);
+  EXPECT_FALSE(parseRecordingAudioFormat("mp3", audio));
+
+  RecordingVideoFormat video = RecordingVideoFormat::None;
+  EXPECT_TRUE(parseRecordingVideoFormat("mjpeg", video));
+  EXPECT_EQ(video, RecordingVideoFormat::Mjpeg);
+  EXPECT_TRUE(parseRecordingVideoFormat("frames", video));
+  EXPECT_EQ(video, RecordingVideoFormat::Frames);
+  EXPECT_FALSE(parseRecordingVideoFormat("h264", video));
+}
+
+TEST_F(RecordingSinkTest, RejectsIncompleteOptions) {
+  std::string error;
+  RecordingSink noFormat(options(RecordingAudioFormat::None, RecordingVideoFormat::None));
+  EXPECT_FALSE(noFormat.open(error));
+  EXPECT_FALSE(error.empty());
+
+  RecordingOptions noDir = options(RecordingAudioFormat::Wav, RecordingVideoFormat::None);
+  noDir.dir.clear();
+  RecordingSink withoutDir(noDir);
+  EXPECT_FALSE(withoutDir.open(error));
+}
+
+TEST_F(RecordingSinkTest, WritesWavWithFinalSizes) {
+  RecordingSink sink(options(RecordingAudioFormat::Wav, RecordingVideoFormat::None));
+  std::string   error;
+  ASSERT_TRUE(sink.open(error)) << error;
+
+  std::vector<float> packet(480 * 2);
+  for (size_t i = 0; i < packet.size(); i++) {
+    packet[i] = static_cast<float>(i) / packet.size();
+  }
+  for (int i = 0; i < 10; i++) {
+    sink.writeAudio(packet.data(), 480, 2, 48000);
+  }
+  ASSERT_TRUE(sink.close(error)) << error;
+
+  std::string wav = read("audio-0001.wav");
+  ASSERT_EQ(wav.size(), 44u + 10 * packet.size() * sizeof(float));
+  EXPECT_EQ(wav.compare(0, 4, "RIFF"), 0);
+  EXPECT_EQ(wav.compare(8, 4, "WAVE"), 0);
+  EXPECT_EQ(readLE32(wav, 4), wav.size() - 8);
+  EXPECT_EQ(readLE16(wav, 20), 3);  // IEEE float
+  EXPECT_EQ(readLE16(wav, 22), 2);  // Channels
+  EXPECT_EQ(readLE32(wav, 24), 48000u);
+  EXPECT_EQ(readLE16(wav, 34), 32); // Bits per sample
+  EXPECT_EQ(wav.compare(36, 4, "data"), 0);
+  EXPECT_EQ(readLE32(wav, 40), wav.size() - 44);
+  EXPECT_EQ(std::memcmp(wav.data() + 44, packet.data(), packet.size() * sizeof(float)), 0);
+
+  RecordingStats stats = sink.stats();
+  EXPECT_EQ(stats.audioFrames, 4800u);
+  EXPECT_EQ(stats.segments, 1u);
+  EXPECT_EQ(stats.bytesWritten, wav.size());
+  EXPECT_EQ(stats.droppedChunks, 0u);
+}
+
+TEST_F(RecordingSinkTest, WritesRawFloats) {
+  RecordingSink sink(options(RecordingAudioFormat::Raw, RecordingVideoFormat::None));
+  std::string   error;
+  ASSERT_TRUE(sink.open(error)) << error;
+
+  const float samples[] = {0.25f, -0.5f, 1.0f};
+  sink.writeAudio(samples, 3, 1, 16000);
+  ASSERT_TRUE(sink.close(error)) << error;
+
+  std::string raw = read("audio-0001.f32");
+  ASSERT_EQ(raw.size(), sizeof(samples));
+  EXPECT_EQ(std::memcmp(raw.data(), samples, sizeof(samples)), 0);
+}
+
+TEST_F(RecordingSinkTest, RotatesAudioBySizeAndDuration) {
+  std::vector<float> packet(1600); // 100 ms of 16 kHz mono, 6400 bytes
+  {
+    RecordingOptions bySize = options(RecordingAudioFormat::Raw, RecordingVideoFormat::None);
+    bySize.segmentBytes     = 3 * packet.size() * sizeof(float);
+    RecordingSink sink(bySize);
+    std::string   error;
+    ASSERT_TRUE(sink.open(error)) << error;
+    for (int i = 0; i < 7; i++) {
+      sink.writeAudio(packet.data(), 1600, 1, 16000);
+    }
+    ASSERT_TRUE(sink.close(error)) << error;
+    EXPECT_EQ(sink.stats().segments, 3u);
+    EXPECT_EQ(read("audio-0001.f32").size(), 3 * packet.size() * sizeof(float));
+    EXPECT_EQ(read("audio-0003.f32").size(), packet.size() * sizeof(float));
+  }
+  fs::remove_all(dir);
+  {
+    RecordingOptions byTime = options(RecordingAudioFormat::Wav, RecordingVideoFormat::None);
+    byTime.segmentSeconds   = 0.5;
+    RecordingSink sink(byTime);
+    std::string   error;
+    ASSERT_TRUE(sink.open(error)) << error;
+    for (int i = 0; i < 12; i++) {
+      sink.writeAudio(packet.data(), 1600, 1, 16000);
+    }
+    ASSERT_TRUE(sink.close(error)) << error;
+    EXPECT_EQ(sink.stats().segments, 3u);
+    EXPECT_EQ(read("audio-0002.wav").size(), 44 + 5 * packet.size() * sizeof(float));
+    EXPECT_EQ(readLE32(read("audio-0003.wav"), 40), 2 * packet.size() * sizeof(float));
+  }
+}
+
+TEST_F(RecordingSinkTest, StartsNewWavWhenFormatChanges) {
+  RecordingSink sink(options(RecordingAudioFormat::Wav, RecordingVideoFormat::None));
+  std::string   error;
+  ASSERT_TRUE(sink.open(error)) << error;
+
+  std::vector<float> packet(960);
+  sink.writeAudio(packet.data(), 960, 1, 48000);
+  sink.writeAudio(packet.data(), 480, 2, 48000);
+  ASSERT_TRUE(sink.close(error)) << error;
+
+  EXPECT_EQ(readLE16(read("audio-0001.wav"), 22), 1);
+  EXPECT_EQ(readLE16(read("audio-0002.wav"), 22), 2);
+}
+
+TEST_F(RecordingSinkTest, WritesMjpegWithIndex) {
+  RecordingOptions mjpeg = options(RecordingAudioFormat::None, RecordingVideoFormat::Mjpeg);
+  mjpeg.segmentSeconds   = 1.0;
+  RecordingSink sink(mjpeg);
+  std::string   error;
+  ASSERT_TRUE(sink.open(error)) << error;
+
+  const std::string first  = "\xff\xd8 first frame \xff\xd9";
+  const std::string second = "\xff\xd8 second \xff\xd9";
+  const std::string third  = "\xff\xd8 third \xff\xd9";
+  sink.writeVideo(reinterpret_cast<const uint8_t *>(first.data()), first.size(), 640, 480, true, 1000);
+  sink.writeVideo(reinterpret_cast<const uint8_t *>(second.data()), second.size(), 640, 480, true, 1500);
+  sink.writeVideo(reinterpret_cast<const uint8_t *>(third.data()), third.size(), 320, 240, true, 2000);
+  ASSERT_TRUE(sink.close(error)) << error;
+
+  EXPECT_EQ(read("video-0001.mjpeg"), first + second);
+  EXPECT_EQ(read("video-0001.csv"), "offset,size,width,height,timestampMs\n"
+                                    "0," + std::to_string(first.size()) + ",640,480,1000\n" +
+                                        std::to_string(first.size()) + "," + std::to_string(second.size()) +
+                                        ",640,480,1500\n");
+  EXPECT_EQ(read("video-0002.mjpeg"), third);
+  EXPECT_EQ(sink.stats().videoFrames, 3u);
+  EXPECT_EQ(sink.stats().segments, 2u);
+}
+
+TEST_F(RecordingSinkTest, MjpegRejectsRawFrames) {
+  RecordingSink sink(options(RecordingAudioFormat::None, RecordingVideoFormat::Mjpeg));
+  std::string   error;
+  ASSERT_TRUE(sink.open(error)) << error;
+
+  std::vector<uint8_t> bgra(4 * 4 * 4);
+  sink.writeVideo(bgra.data(), bgra.size(), 4, 4, false, 0);
+  EXPECT_FALSE(sink.close(error));
+  EXPECT_FALSE(error.empty());
+}
+
+TEST_F(RecordingSinkTest, WritesOneFilePerFrame) {
+  RecordingSink sink(options(RecordingAudioFormat::None, RecordingVideoFormat::Frames));
+  std::string   error;
+  ASSERT_TRUE(sink.open(error)) << error;
+
+  const std::string    jpeg = "\xff\xd8 jpeg \xff\xd9";
+  std::vector<uint8_t> bgra(2 * 2 * 4, 0x7f);
+  sink.writeVideo(reinterpret_cast<const uint8_t *>(jpeg.data()), jpeg.size(), 2, 2, true, 10);
+  sink.writeVideo(bgra.data(), bgra.size(), 2, 2, false, 20);
+  ASSERT_TRUE(sink.close(error)) << error;
+
+  EXPECT_EQ(read("frames/000000001.jpg"), jpeg);
+  EXPECT_EQ(read("frames/000000002.bgra"), std::string(bgra.begin(), bgra.end()));
+  EXPECT_EQ(sink.stats().videoFrames, 2u);
+}
+
+TEST_F(RecordingSinkTest, AccountsForEveryChunkWhenTheWriterFallsBehind) {
+  RecordingOptions tiny = options(RecordingAudioFormat::None, RecordingVideoFormat::Mjpeg);
+  tiny.queueDepth       = 2;
+  RecordingSink sink(tiny);
+  std::string   error;
+  ASSERT_TRUE(sink.open(error)) << error;
+
+  std::vector<uint8_t> frame(256 * 1024, 0x55);
+  frame[0]                  = 0xff;
+  frame[1]                  = 0xd8;
+  constexpr uint64_t kCount = 200;
+  for (uint64_t i = 0; i < kCount; i++) {
+    sink.writeVideo(frame.data(), frame.size(), 64, 64, true, static_cast<int64_t>(i));
+  }
+  ASSERT_TRUE(sink.close(error)) << error;
+
+  RecordingStats stats = sink.stats();
+  EXPECT_EQ(stats.videoFrames + stats.droppedChunks, kCount);
+  EXPECT_EQ(fs::file_size(dir / "video-0001.mjpeg"), stats.videoFrames * frame.size());
+}
+
+TEST_F(RecordingSinkTest, IgnoresWritesAfterClose) {
+  RecordingSink sink(options(RecordingAudioFormat::Raw, RecordingVideoFormat::None));
+  std::string   error;
+  ASSERT_TRUE(sink.open(error)) << error;
+  ASSERT_TRUE(sink.close(error)) << error;
+
+  const float sample = 1.0f;
+  sink.writeAudio(&sample, 1, 1, 16000);
+  EXPECT_EQ(sink.stats().audioFrames, 0u);
+  EXPECT_FALSE(fs::exists(dir / "audio-0001.f32"));
+}
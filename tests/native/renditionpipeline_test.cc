@@ -0,0 +1,196 @@
+#include "jpegcodec.h"
+#include "renditionpipeline.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/** Produces solid frames whose first byte carries the acquisition count */
+class CountingSource : public VideoFrameSource {
+public:
+  AcquireResult acquireFrame(VideoFrame &frame, uint32_t) override {
+    frame.width       = 64;
+    frame.height      = 8;
+    frame.bytesPerRow = frame.width * 4;
+    frame.pixels.resize(frame.bytesPerRow * frame.height);
+    std::memset(frame.pixels.data(), static_cast<int>(produced & 0xff), frame.pixels.size());
+    produced++;
+    return AcquireResult::Frame;
+  }
+  const char *lastAcquireError() const override {
+    return "";
+  }
+
+  std::atomic<uint64_t> produced{0};
+};
+
+/** Copies the first byte after a fixed cost; fails if two workers ever encode it at once */
+class SlowEncoder : public VideoFrameEncoder {
+public:
+  explicit SlowEncoder(std::chrono::milliseconds cost) : cost(cost) {}
+
+  bool encodeFrame(const VideoFrame &frame, EncodedFrame &out) override {
+    EXPECT_EQ(active.fetch_add(1), 0) << "encoder used by two workers at once";
+    std::this_thread::sleep_for(cost);
+    out.data.assign(frame.pixels.begin(), frame.pixels.begin() + 1);
+    out.width       = frame.width;
+    out.height      = frame.height;
+    out.bytesPerRow = frame.bytesPerRow;
+    out.format      = "test";
+    active.fetch_sub(1);
+    return true;
+  }
+  const char *lastEncodeError() const override {
+    return "";
+  }
+
+  std::chrono::milliseconds cost;
+  std::atomic<int>          active{0};
+};
+
+struct Delivered {
+  std::mutex                        mutex;
+  std::vector<std::vector<uint8_t>> firstBytes{4};
+  std::set<std::thread::id>         threads;
+};
+
+void onVideoFrame(
+    int32_t rendition, uint8_t *data, int32_t, int32_t, int32_t, const char *, const char *, size_t, void *ctx) {
+  auto                       *delivered = static_cast<Delivered *>(ctx);
+  std::lock_guard<std::mutex> lock(delivered->mutex);
+  ASSERT_GE(rendition, 0);
+  ASSERT_LT(rendition, 4);
+  delivered->firstBytes[rendition].push_back(data[0]);
+  delivered->threads.insert(std::this_thread::get_id());
+}
+
+VideoFrame gradientFrame(int32_t width, int32_t height) {
+  VideoFrame frame;
+  frame.width       = width;
+  frame.height      = height;
+  frame.bytesPerRow = width * 4;
+  frame.pixels.resize(static_cast<size_t>(frame.bytesPerRow) * height);
+  for (size_t i = 0; i < frame.pixels.size(); i++) {
+    frame.pixels[i] = static_cast<uint8_t>(i * 7);
+  }
+  return frame;
+}
+
+} // namespace
+
+TEST(RenditionEncoder, ScalesToTheRendition) {
+  VideoFrame   frame = gradientFrame(1280, 720);
+  EncodedFrame out;
+
+  VideoRendition thumbnail;
+  thumbnail.maxWidth    = 320;
+  thumbnail.imageFormat = 1;
+  RenditionEncoder thumbnailEncoder(thumbnail);
+  ASSERT_TRUE(thumbnailEncoder.encodeFrame(frame, out));
+  EXPECT_EQ(out.width, 320);
+  EXPECT_EQ(out.height, 180);
+  EXPECT_EQ(out.bytesPerRow, 320 * 4);
+  EXPECT_EQ(out.data.size(), 320u * 4 * 180);
+  EXPECT_EQ(out.format, "bgra");
+
+  // maxWidth only ever shrinks, and the stronger of scale and maxWidth wins
+  VideoRendition half;
+  half.scale       = 0.5;
+  half.maxWidth    = 1920;
+  half.imageFormat = 1;
+  int32_t width, height;
+  RenditionEncoder::outputSize(half, 1280, 720, width, height);
+  EXPECT_EQ(width, 640);
+  EXPECT_EQ(height, 360);
+
+  VideoRendition full;
+  full.imageFormat = 1;
+  RenditionEncoder fullEncoder(full);
+  ASSERT_TRUE(fullEncoder.encodeFrame(frame, out));
+  EXPECT_EQ(out.width, 1280);
+  EXPECT_TRUE(std::equal(out.data.begin(), out.data.end(), frame.pixels.begin()));
+
+  if (jpegCodecAvailable()) {
+    VideoRendition jpeg;
+    jpeg.quality = 40;
+    RenditionEncoder jpegEncoder(jpeg);
+    ASSERT_TRUE(jpegEncoder.encodeFrame(frame, out));
+    EXPECT_EQ(out.format, "jpeg");
+    ASSERT_GT(out.data.size(), 2u);
+    EXPECT_EQ(out.data[0], 0xFF);
+    EXPECT_EQ(out.data[1], 0xD8);
+  }
+}
+
+TEST(RenditionPipeline, SharesAcquisitionsBetweenRenditions) {
+  CountingSource    source;
+  SlowEncoder       fastEncoder(std::chrono::milliseconds(0));
+  SlowEncoder       slowEncoder(std::chrono::milliseconds(0));
+  RenditionPipeline pipeline(source, 2);
+  Delivered         delivered;
+
+  EXPECT_EQ(pipeline.addRendition(fastEncoder, 50.0f), 0u);
+  EXPECT_EQ(pipeline.addRendition(slowEncoder, 10.0f), 1u);
+  ASSERT_TRUE(pipeline.start(onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  pipeline.stop();
+
+  VideoPipelineStats fast  = pipeline.renditionStats(0);
+  VideoPipelineStats slow  = pipeline.renditionStats(1);
+  VideoPipelineStats total = pipeline.stats();
+
+  // The 10 fps rendition rides on every fifth acquisition of the 50 fps one
+  EXPECT_EQ(total.framesCaptured, source.produced.load());
+  EXPECT_EQ(fast.framesCaptured, total.framesCaptured);
+  EXPECT_GT(slow.framesCaptured, 2u);
+  EXPECT_LT(slow.framesCaptured * 3, fast.framesCaptured);
+
+  std::lock_guard<std::mutex> lock(delivered.mutex);
+  EXPECT_EQ(delivered.threads.size(), 1u);
+  std::set<uint8_t> fastFrames(delivered.firstBytes[0].begin(), delivered.firstBytes[0].end());
+  for (uint8_t frame : delivered.firstBytes[1]) {
+    EXPECT_TRUE(fastFrames.count(frame)) << "frame " << int(frame) << " was acquired for one rendition only";
+  }
+}
+
+TEST(RenditionPipeline, SlowRenditionOnlyDropsItsOwnFrames) {
+  CountingSource    source;
+  SlowEncoder       fullSize(std::chrono::milliseconds(60));
+  SlowEncoder       thumbnail(std::chrono::milliseconds(1));
+  RenditionPipeline pipeline(source, 2);
+  Delivered         delivered;
+
+  pipeline.addRendition(fullSize, 50.0f);
+  pipeline.addRendition(thumbnail, 50.0f);
+  ASSERT_TRUE(pipeline.start(onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  pipeline.stop();
+
+  VideoPipelineStats slow = pipeline.renditionStats(0);
+  VideoPipelineStats fast = pipeline.renditionStats(1);
+  EXPECT_GT(slow.framesDropped, 0u);
+  EXPECT_LE(fast.framesDropped, 1u);
+  EXPECT_GT(fast.framesEncoded, slow.framesEncoded * 2);
+
+  // Each rendition's frames arrive in capture order
+  {
+    std::lock_guard<std::mutex> lock(delivered.mutex);
+    for (size_t rendition = 0; rendition < 2; rendition++) {
+      const std::vector<uint8_t> &bytes = delivered.firstBytes[rendition];
+      for (size_t i = 1; i < bytes.size(); i++) {
+        EXPECT_NE(bytes[i], bytes[i - 1]) << rendition;
+      }
+    }
+  }
+
+  // Every shared frame went back to the capture stage
+  ASSERT_TRUE(pipeline.start(onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  pipeline.stop();
+  EXPECT_GT(pipeline.renditionStats(1).framesEncoded, fast.framesEncoded);
+}
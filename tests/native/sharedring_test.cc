@@ -0,0 +1,231 @@
+#include "sharedringwriter.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/** Names are system-wide; include the PID so parallel test runs do not collide */
+std::string uniqueName(const char *test) {
+  return std::string("sharedring-test-") + test + "-" + std::to_string(getpid());
+}
+
+SharedRingOptions smallRing(const std::string &name) {
+  SharedRingOptions options;
+  options.name           = name;
+  options.videoSlots     = 4;
+  options.videoSlotBytes = 4096;
+  options.audioSlots     = 8;
+  options.audioSlotBytes = 1024;
+  return options;
+}
+
+/** Frame n is filled with n + row so a reader can check it without talking to the writer */
+std::vector<uint8_t> testFrame(uint64_t n, int32_t width, int32_t height) {
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+  for (int32_t y = 0; y < height; y++) {
+    std::fill_n(pixels.begin() + static_cast<size_t>(y) * width * 4, width * 4, static_cast<uint8_t>(n + y));
+  }
+  return pixels;
+}
+
+bool matchesTestFrame(const SharedRingFrameC &frame) {
+  for (int32_t y = 0; y < frame.height; y++) {
+    const uint8_t *row = frame.data + static_cast<size_t>(y) * frame.bytesPerRow;
+    for (int32_t x = 0; x < frame.width * 4; x++) {
+      if (row[x] != static_cast<uint8_t>(frame.index + y)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+TEST(SharedRing, PublishesVideoAndAudio) {
+  SharedRingWriter writer(smallRing(uniqueName("roundtrip")));
+  std::string      error;
+  ASSERT_TRUE(writer.open(error)) << error;
+
+  SharedRingReaderC reader;
+  ASSERT_EQ(sharedRingOpen(uniqueName("roundtrip").c_str(), &reader), SHARED_RING_OK);
+  EXPECT_EQ(sharedRingHeader(&reader)->writerPid, static_cast<uint32_t>(getpid()));
+  EXPECT_EQ(sharedRingWriteIndex(&reader, SHARED_RING_VIDEO), 0u);
+
+  SharedRingFrameC frame{};
+  EXPECT_EQ(sharedRingBeginRead(&reader, SHARED_RING_VIDEO, 0, &frame), SHARED_RING_NOT_READY);
+
+  std::vector<uint8_t> pixels = testFrame(0, 8, 4);
+  ASSERT_TRUE(writer.writeVideo(pixels.data(), pixels.size(), 8, 4, 32, false, 1234));
+  ASSERT_EQ(sharedRingBeginRead(&reader, SHARED_RING_VIDEO, 0, &frame), SHARED_RING_OK);
+  EXPECT_EQ(frame.format, static_cast<uint32_t>(SHARED_RING_BGRA));
+  EXPECT_EQ(frame.size, pixels.size());
+  EXPECT_EQ(frame.width, 8);
+  EXPECT_EQ(frame.height, 4);
+  EXPECT_EQ(frame.timestampMs, 1234);
+  EXPECT_TRUE(matchesTestFrame(frame));
+  EXPECT_TRUE(sharedRingEndRead(&reader, &frame));
+
+  const float samples[] = {0.5f, -0.5f, 0.25f, -0.25f};
+  ASSERT_TRUE(writer.writeAudio(samples, 2, 2, 48000));
+  ASSERT_EQ(sharedRingBeginRead(&reader, SHARED_RING_AUDIO, 0, &frame), SHARED_RING_OK);
+  EXPECT_EQ(frame.format, static_cast<uint32_t>(SHARED_RING_FLOAT32));
+  EXPECT_EQ(frame.channels, 2);
+  EXPECT_EQ(frame.sampleRate, 48000);
+  EXPECT_EQ(frame.frameCount, 2);
+  ASSERT_EQ(frame.size, sizeof(samples));
+  EXPECT_EQ(std::memcmp(frame.data, samples, sizeof(samples)), 0);
+  EXPECT_GT(frame.timestampMs, 0);
+
+  sharedRingClose(&reader);
+}
+
+TEST(SharedRing, ReportsOverwrittenItems) {
+  SharedRingWriter writer(smallRing(uniqueName("lapped")));
+  std::string      error;
+  ASSERT_TRUE(writer.open(error)) << error;
+  SharedRingReaderC reader;
+  ASSERT_EQ(sharedRingOpen(uniqueName("lapped").c_str(), &reader), SHARED_RING_OK);
+
+  for (uint64_t n = 0; n < 6; n++) {
+    std::vector<uint8_t> pixels = testFrame(n, 4, 4);
+    ASSERT_TRUE(writer.writeVideo(pixels.data(), pixels.size(), 4, 4, 16, false, 0));
+  }
+
+  SharedRingFrameC frame{};
+  EXPECT_EQ(sharedRingBeginRead(&reader, SHARED_RING_VIDEO, 0, &frame), SHARED_RING_OVERWRITTEN);
+  EXPECT_EQ(sharedRingBeginRead(&reader, SHARED_RING_VIDEO, 1, &frame), SHARED_RING_OVERWRITTEN);
+  EXPECT_EQ(sharedRingOldest(&reader, SHARED_RING_VIDEO), 3u);
+  ASSERT_EQ(sharedRingBeginRead(&reader, SHARED_RING_VIDEO, 3, &frame), SHARED_RING_OK);
+  EXPECT_TRUE(matchesTestFrame(frame));
+
+  // The writer laps the reader while it holds item 3
+  for (uint64_t n = 6; n < 10; n++) {
+    std::vector<uint8_t> pixels = testFrame(n, 4, 4);
+    ASSERT_TRUE(writer.writeVideo(pixels.data(), pixels.size(), 4, 4, 16, false, 0));
+  }
+  EXPECT_FALSE(sharedRingEndRead(&reader, &frame));
+  sharedRingClose(&reader);
+}
+
+TEST(SharedRing, SkipsItemsLargerThanASlot) {
+  SharedRingWriter writer(smallRing(uniqueName("oversized")));
+  std::string      error;
+  ASSERT_TRUE(writer.open(error)) << error;
+
+  std::vector<uint8_t> big(8192);
+  EXPECT_FALSE(writer.writeVideo(big.data(), big.size(), 64, 32, 256, false, 0));
+  EXPECT_EQ(writer.oversized(), 1u);
+
+  SharedRingReaderC reader;
+  ASSERT_EQ(sharedRingOpen(uniqueName("oversized").c_str(), &reader), SHARED_RING_OK);
+  EXPECT_EQ(sharedRingWriteIndex(&reader, SHARED_RING_VIDEO), 0u);
+  sharedRingClose(&reader);
+}
+
+TEST(SharedRing, RejectsNamesInUseAndInvalidNames) {
+  SharedRingWriter first(smallRing(uniqueName("taken")));
+  SharedRingWriter second(smallRing(uniqueName("taken")));
+  std::string      error;
+  ASSERT_TRUE(first.open(error)) << error;
+  EXPECT_FALSE(second.open(error));
+  EXPECT_NE(error.find("already in use"), std::string::npos);
+
+  SharedRingWriter slash(smallRing("a/b"));
+  EXPECT_FALSE(slash.open(error));
+
+  SharedRingReaderC reader;
+  EXPECT_EQ(sharedRingOpen(uniqueName("missing").c_str(), &reader), SHARED_RING_NOT_FOUND);
+  EXPECT_EQ(sharedRingOpen("", &reader), SHARED_RING_INVALID);
+}
+
+TEST(SharedRing, ReadersOutliveTheWriter) {
+  auto writer = std::make_unique<SharedRingWriter>(smallRing(uniqueName("closed")));
+  std::string error;
+  ASSERT_TRUE(writer->open(error)) << error;
+  SharedRingReaderC reader;
+  ASSERT_EQ(sharedRingOpen(uniqueName("closed").c_str(), &reader), SHARED_RING_OK);
+
+  std::vector<uint8_t> pixels = testFrame(0, 4, 4);
+  ASSERT_TRUE(writer->writeVideo(pixels.data(), pixels.size(), 4, 4, 16, false, 0));
+  EXPECT_FALSE(sharedRingClosed(&reader));
+  writer.reset();
+
+  EXPECT_TRUE(sharedRingClosed(&reader));
+  SharedRingFrameC frame{};
+  ASSERT_EQ(sharedRingBeginRead(&reader, SHARED_RING_VIDEO, 0, &frame), SHARED_RING_OK);
+  EXPECT_TRUE(matchesTestFrame(frame));
+  sharedRingClose(&reader);
+
+  // The name is free again
+  SharedRingWriter next(smallRing(uniqueName("closed")));
+  EXPECT_TRUE(next.open(error)) << error;
+}
+
+TEST(SharedRing, StreamsToAnotherProcess) {
+  const std::string name = uniqueName("fork");
+  SharedRingWriter  writer(smallRing(name));
+  std::string       error;
+  ASSERT_TRUE(writer.open(error)) << error;
+
+  constexpr uint64_t kFrames = 2000;
+  pid_t              child   = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    // Reader process: only the C header, its own mapping, and the exit code
+    SharedRingReaderC reader;
+    if (sharedRingOpen(name.c_str(), &reader) != SHARED_RING_OK) {
+      _exit(10);
+    }
+    uint64_t next = 0, read = 0;
+    for (;;) {
+      SharedRingFrameC frame{};
+      int              status = sharedRingBeginRead(&reader, SHARED_RING_VIDEO, next, &frame);
+      if (status == SHARED_RING_NOT_READY) {
+        if (sharedRingClosed(&reader) && sharedRingWriteIndex(&reader, SHARED_RING_VIDEO) <= next) {
+          break;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+      if (status == SHARED_RING_OVERWRITTEN) {
+        next = sharedRingOldest(&reader, SHARED_RING_VIDEO);
+        continue;
+      }
+      if (status != SHARED_RING_OK) {
+        _exit(11);
+      }
+      bool intact = matchesTestFrame(frame);
+      if (sharedRingEndRead(&reader, &frame)) {
+        if (!intact || frame.timestampMs != static_cast<int64_t>(frame.index)) {
+          _exit(12); // A frame that passed the sequence check must be consistent
+        }
+        read++;
+      }
+      next++;
+    }
+    sharedRingClose(&reader);
+    _exit(read > 0 && next == kFrames ? 0 : 13);
+  }
+
+  for (uint64_t n = 0; n < kFrames; n++) {
+    std::vector<uint8_t> pixels = testFrame(n, 16, 16);
+    ASSERT_TRUE(writer.writeVideo(pixels.data(), pixels.size(), 16, 16, 64, false, static_cast<int64_t>(n)));
+    if (n % 64 == 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+  }
+  writer.close();
+
+  int status = 0;
+  ASSERT_EQ(waitpid(child, &status, 0), child);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+}
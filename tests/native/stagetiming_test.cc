@@ -0,0 +1,79 @@
+#include "stagetiming.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+TEST(StageTiming, BucketsCoverEveryDuration) {
+  // Consecutive buckets are contiguous, and each value lands in the bucket that starts at or below it
+  for (size_t index = 1; index < StageTiming::kBucketCount; index++) {
+    ASSERT_GT(StageTiming::bucketLowerBound(index), StageTiming::bucketLowerBound(index - 1));
+  }
+  for (uint64_t ns : {0ull, 1ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, (1ull << 39) + 5}) {
+    size_t index = StageTiming::bucketIndex(ns);
+    EXPECT_LE(StageTiming::bucketLowerBound(index), ns);
+    EXPECT_GT(StageTiming::bucketLowerBound(index + 1), ns);
+  }
+  EXPECT_EQ(StageTiming::bucketIndex(~0ull), StageTiming::kBucketCount - 1);
+}
+
+TEST(StageTiming, PercentilesOfUniformDurations) {
+  StageTiming timing;
+  for (uint64_t us = 1; us <= 1000; us++) {
+    timing.record(us * 1000);
+  }
+
+  StageTimingSnapshot snapshot = timing.snapshot();
+  EXPECT_EQ(snapshot.count, 1000u);
+  EXPECT_NEAR(snapshot.meanMs, 0.5005, 1e-9);
+  EXPECT_DOUBLE_EQ(snapshot.maxMs, 1.0);
+  EXPECT_NEAR(snapshot.p50Ms, 0.5, 0.5 * 0.04);
+  EXPECT_NEAR(snapshot.p90Ms, 0.9, 0.9 * 0.04);
+  EXPECT_NEAR(snapshot.p99Ms, 0.99, 0.99 * 0.04);
+  EXPECT_LE(snapshot.p999Ms, snapshot.maxMs);
+}
+
+TEST(StageTiming, TailIsVisibleInHighPercentiles) {
+  StageTiming timing;
+  for (int i = 0; i < 990; i++) {
+    timing.record(100000); // 0.1 ms
+  }
+  for (int i = 0; i < 10; i++) {
+    timing.record(50000000); // 50 ms
+  }
+
+  StageTimingSnapshot snapshot = timing.snapshot();
+  EXPECT_NEAR(snapshot.p50Ms, 0.1, 0.004);
+  EXPECT_NEAR(snapshot.p90Ms, 0.1, 0.004);
+  EXPECT_NEAR(snapshot.p999Ms, 50.0, 2.0);
+  EXPECT_DOUBLE_EQ(snapshot.maxMs, 50.0);
+}
+
+TEST(StageTiming, ResetClearsEverything) {
+  StageTiming timing;
+  timing.record(42);
+  timing.reset();
+
+  StageTimingSnapshot snapshot = timing.snapshot();
+  EXPECT_EQ(snapshot.count, 0u);
+  EXPECT_EQ(snapshot.maxMs, 0.0);
+  EXPECT_EQ(snapshot.p99Ms, 0.0);
+}
+
+TEST(StageTiming, ConcurrentRecordersLoseNothing) {
+  StageTiming              timing;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&timing, t] {
+      for (int i = 0; i < 10000; i++) {
+        timing.record(static_cast<uint64_t>(1000 * (t + 1)));
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  StageTimingSnapshot snapshot = timing.snapshot();
+  EXPECT_EQ(snapshot.count, 40000u);
+  EXPECT_DOUBLE_EQ(snapshot.maxMs, 0.004);
+}
@@ -0,0 +1,179 @@
+#include "targetregistry.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+CaptureTarget window(uint32_t id, const char *title, const char *appName, int32_t width = 800, int32_t height = 600) {
+  CaptureTarget target;
+  target.isWindow = true;
+  target.windowID = id;
+  target.width    = width;
+  target.height   = height;
+  target.title    = title;
+  target.appName  = appName;
+  return target;
+}
+
+CaptureTarget display(uint32_t id) {
+  CaptureTarget target;
+  target.isDisplay = true;
+  target.displayID = id;
+  target.width     = 1920;
+  target.height    = 1080;
+  return target;
+}
+
+/** Backend whose targets the test edits; counts enumerations */
+struct FakeBackend {
+  std::mutex                 mutex;
+  std::vector<CaptureTarget> targets;
+  std::atomic<int>           calls{0};
+
+  TargetRegistry::EnumerateFn enumerate() {
+    return [this](int32_t, std::vector<CaptureTarget> &out, std::string &) {
+      std::lock_guard<std::mutex> lock(mutex);
+      calls++;
+      out = targets;
+      return true;
+    };
+  }
+
+  void set(std::vector<CaptureTarget> next) {
+    std::lock_guard<std::mutex> lock(mutex);
+    targets = std::move(next);
+  }
+};
+
+} // namespace
+
+TEST(TargetRegistry, DiffsByIdentity) {
+  std::vector<CaptureTarget> before = {display(1), window(7, "Editor", "Code"), window(9, "Inbox", "Mail")};
+  std::vector<CaptureTarget> after  = {display(1), window(7, "Editor - main.cc", "Code"), window(12, "Chat", "Slack")};
+
+  TargetChanges changes;
+  diffTargets(before, after, changes);
+  ASSERT_EQ(changes.added.size(), 1u);
+  EXPECT_EQ(changes.added[0].windowID, 12u);
+  ASSERT_EQ(changes.removed.size(), 1u);
+  EXPECT_EQ(changes.removed[0].title, "Inbox");
+  ASSERT_EQ(changes.updated.size(), 1u);
+  EXPECT_EQ(changes.updated[0].title, "Editor - main.cc");
+
+  // Display 1 and window 1 are different targets
+  CaptureTarget sameID = window(1, "Window", "App");
+  diffTargets({display(1)}, {sameID}, changes);
+  EXPECT_EQ(changes.added.size(), 1u);
+  EXPECT_EQ(changes.removed.size(), 1u);
+}
+
+TEST(TargetRegistry, FiltersNatively) {
+  std::vector<CaptureTarget> targets = {display(1), display(2), window(3, "Doc", "TextEdit"),
+                                        window(4, "Tooltip", "TextEdit", 120, 30), window(5, "Song", "Music")};
+
+  TargetFilter byApp;
+  byApp.appName = "textedit";
+  EXPECT_EQ(filterTargets(targets, byApp).size(), 2u);
+
+  TargetFilter bySize;
+  bySize.minWidth  = 200;
+  bySize.minHeight = 100;
+  EXPECT_EQ(filterTargets(targets, bySize).size(), 4u);
+
+  TargetFilter byDisplay;
+  byDisplay.displayID                 = 2;
+  std::vector<CaptureTarget> matching = filterTargets(targets, byDisplay);
+  ASSERT_EQ(matching.size(), 4u);
+  EXPECT_EQ(matching[0].displayID, 2u);
+}
+
+TEST(TargetRegistry, ReusesTheCacheWithinMaxAge) {
+  FakeBackend backend;
+  backend.set({display(1), window(2, "Doc", "Editor")});
+  TargetRegistry registry(backend.enumerate());
+
+  std::vector<CaptureTarget> targets;
+  std::string                error;
+  ASSERT_TRUE(registry.targets(TargetFilter(), 60000, targets, error));
+  ASSERT_TRUE(registry.targets(TargetFilter(), 60000, targets, error));
+  EXPECT_EQ(backend.calls.load(), 1);
+  EXPECT_EQ(targets.size(), 2u);
+
+  // Each type is cached separately, and a zero age always asks the backend
+  TargetFilter displays;
+  displays.type = 1;
+  registry.targets(displays, 60000, targets, error);
+  registry.targets(TargetFilter(), 0, targets, error);
+  EXPECT_EQ(backend.calls.load(), 3);
+  EXPECT_EQ(registry.cacheLifetimeMs(), 0);
+}
+
+TEST(TargetRegistry, ReportsChangesPerSubscriberFilter) {
+  FakeBackend backend;
+  backend.set({window(1, "Doc", "Editor"), window(2, "Song", "Music")});
+  TargetRegistry registry(backend.enumerate());
+
+  std::vector<TargetChanges> all;
+  std::vector<TargetChanges> editorOnly;
+  TargetFilter               editor;
+  editor.appName = "editor";
+
+  uint64_t allID    = registry.subscribe(TargetFilter(), 60000, [&](const TargetChanges &c) { all.push_back(c); });
+  uint64_t editorID = registry.subscribe(editor, 60000, [&](const TargetChanges &c) { editorOnly.push_back(c); });
+  EXPECT_EQ(registry.cacheLifetimeMs(), 60000);
+
+  // Nothing changed since subscribing
+  registry.pollOnce();
+  EXPECT_TRUE(all.empty());
+
+  backend.set({window(1, "Doc (edited)", "Editor"), window(3, "Video", "Player")});
+  registry.pollOnce();
+  ASSERT_EQ(all.size(), 1u);
+  EXPECT_EQ(all[0].added.size(), 1u);
+  EXPECT_EQ(all[0].removed.size(), 1u);
+  EXPECT_EQ(all[0].updated.size(), 1u);
+  ASSERT_EQ(editorOnly.size(), 1u);
+  EXPECT_TRUE(editorOnly[0].added.empty());
+  EXPECT_TRUE(editorOnly[0].removed.empty());
+  EXPECT_EQ(editorOnly[0].updated.size(), 1u);
+
+  // Unsubscribed callbacks are never called again
+  registry.unsubscribe(allID);
+  backend.set({});
+  registry.pollOnce();
+  EXPECT_EQ(all.size(), 1u);
+  ASSERT_EQ(editorOnly.size(), 2u);
+  EXPECT_EQ(editorOnly[1].removed.size(), 1u);
+  registry.unsubscribe(editorID);
+}
+
+TEST(TargetRegistry, PollsOnItsOwnThreadWhileSubscribed) {
+  FakeBackend backend;
+  backend.set({display(1)});
+  TargetRegistry registry(backend.enumerate());
+
+  std::mutex              mutex;
+  std::condition_variable changed;
+  bool                    sawWindow = false;
+  uint64_t                id        = registry.subscribe(TargetFilter(), TargetRegistry::kMinPollMs, [&](const TargetChanges &c) {
+    std::lock_guard<std::mutex> lock(mutex);
+    sawWindow = !c.added.empty() && c.added[0].isWindow;
+    changed.notify_all();
+  });
+
+  backend.set({display(1), window(5, "New", "App")});
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    EXPECT_TRUE(changed.wait_for(lock, std::chrono::seconds(5), [&] { return sawWindow; }));
+  }
+
+  registry.unsubscribe(id);
+  int calls = backend.calls.load();
+  std::this_thread::sleep_for(std::chrono::milliseconds(3 * TargetRegistry::kMinPollMs));
+  EXPECT_LE(backend.calls.load(), calls + 1);
+}
@@ -0,0 +1,258 @@
+#include "videopipeline.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Produces solid frames whose first byte carries the frame count */
+class SyntheticSource : public VideoFrameSource {
+public:
+  AcquireResult acquireFrame(VideoFrame &frame, uint32_t) override {
+    frame.width       = 64;
+    frame.height      = 32;
+    frame.bytesPerRow = 64 * 4;
+    frame.pixels.resize(frame.bytesPerRow * frame.height);
+    std::memset(frame.pixels.data(), static_cast<int>(produced & 0xff), frame.pixels.size());
+    produced++;
+    return AcquireResult::Frame;
+  }
+  const char *lastAcquireError() const override {
+    return "";
+  }
+
+  std::atomic<uint64_t> produced{0};
+};
+
+/** Copies the frame and sleeps to simulate an expensive encoder */
+class SlowEncoder : public VideoFrameEncoder {
+public:
+  explicit SlowEncoder(std::chrono::milliseconds cost) : cost(cost) {}
+
+  bool encodeFrame(const VideoFrame &frame, EncodedFrame &out) override {
+    std::this_thread::sleep_for(cost);
+    out.data.assign(frame.pixels.begin(), frame.pixels.begin() + 16);
+    out.width       = frame.width;
+    out.height      = frame.height;
+    out.bytesPerRow = frame.bytesPerRow;
+    out.format      = "test";
+    return true;
+  }
+  const char *lastEncodeError() const override {
+    return "";
+  }
+
+  std::chrono::milliseconds cost;
+};
+
+/** Delivers frames, failing every other acquisition, until it runs out and reports Fatal */
+class FailingSource : public VideoFrameSource {
+public:
+  explicit FailingSource(uint64_t frames) : frames(frames) {}
+
+  AcquireResult acquireFrame(VideoFrame &frame, uint32_t) override {
+    if (produced >= frames) {
+      return AcquireResult::Fatal;
+    }
+    if (attempts++ % 2 == 1) {
+      return AcquireResult::Error;
+    }
+    frame.width       = 64;
+    frame.height      = 32;
+    frame.bytesPerRow = 64 * 4;
+    frame.pixels.assign(frame.bytesPerRow * frame.height, static_cast<uint8_t>(produced & 0xff));
+    produced++;
+    return AcquireResult::Frame;
+  }
+  const char *lastAcquireError() const override {
+    return produced >= frames ? "source gone" : "no frame this time";
+  }
+
+  const uint64_t        frames;
+  std::atomic<uint64_t> produced{0};
+  std::atomic<uint64_t> attempts{0};
+};
+
+/** Fails every third frame */
+class FlakyEncoder : public VideoFrameEncoder {
+public:
+  bool encodeFrame(const VideoFrame &frame, EncodedFrame &out) override {
+    if (++encoded % 3 == 0) {
+      return false;
+    }
+    out.data.assign(frame.pixels.begin(), frame.pixels.begin() + 16);
+    out.format = "test";
+    return true;
+  }
+  const char *lastEncodeError() const override {
+    return "encode failed";
+  }
+
+  uint64_t encoded = 0;
+};
+
+struct Delivered {
+  std::mutex               mutex;
+  std::vector<int64_t>     timestamps;
+  std::vector<uint8_t>     firstBytes;
+  std::vector<std::string> exits;
+  size_t                   framesAfterExit = 0;
+};
+
+void onVideoFrame(uint8_t *data, int32_t, int32_t, int32_t, const char *timestamp, const char *format, size_t, void *ctx) {
+  auto                       *delivered = static_cast<Delivered *>(ctx);
+  std::lock_guard<std::mutex> lock(delivered->mutex);
+  delivered->timestamps.push_back(std::stoll(timestamp));
+  delivered->firstBytes.push_back(data[0]);
+  delivered->framesAfterExit += delivered->exits.size();
+  EXPECT_STREQ(format, "test");
+}
+
+void onExit(char *error, void *ctx) {
+  auto                       *delivered = static_cast<Delivered *>(ctx);
+  std::lock_guard<std::mutex> lock(delivered->mutex);
+  delivered->exits.push_back(error ? error : "");
+}
+
+} // namespace
+
+TEST(VideoPipeline, CaptureCadenceIsIndependentOfEncodeCost) {
+  SyntheticSource source;
+  SlowEncoder     encoder(std::chrono::milliseconds(50));
+  VideoPipeline   pipeline(source, encoder, 2);
+  Delivered       delivered;
+
+  ASSERT_TRUE(pipeline.start(200.0f, onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  pipeline.stop();
+
+  VideoPipelineStats stats = pipeline.stats();
+  // ~100 frames captured at 200 fps, but only ~10 can be encoded at 50 ms each
+  EXPECT_GT(stats.framesCaptured, 60u);
+  EXPECT_LT(stats.framesEncoded, 15u);
+  EXPECT_GT(stats.framesDropped, 40u);
+  EXPECT_EQ(stats.framesEncoded, delivered.timestamps.size());
+  EXPECT_GE(stats.encode.meanMs, 45.0);
+  EXPECT_GT(stats.acquire.count, 0u);
+}
+
+TEST(VideoPipeline, DeliversFramesInCaptureOrder) {
+  SyntheticSource source;
+  SlowEncoder     encoder(std::chrono::milliseconds(0));
+  VideoPipeline   pipeline(source, encoder, 4);
+  Delivered       delivered;
+
+  ASSERT_TRUE(pipeline.start(100.0f, onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  pipeline.stop();
+
+  ASSERT_GT(delivered.firstBytes.size(), 10u);
+  for (size_t i = 1; i < delivered.timestamps.size(); i++) {
+    EXPECT_GE(delivered.timestamps[i], delivered.timestamps[i - 1]);
+    EXPECT_EQ(static_cast<uint8_t>(delivered.firstBytes[i] - delivered.firstBytes[i - 1]), 1);
+  }
+  EXPECT_EQ(pipeline.stats().framesDropped, 0u);
+}
+
+TEST(VideoPipeline, RestartAfterStop) {
+  SyntheticSource source;
+  SlowEncoder     encoder(std::chrono::milliseconds(1));
+  VideoPipeline   pipeline(source, encoder);
+  Delivered       delivered;
+
+  ASSERT_TRUE(pipeline.start(100.0f, onVideoFrame, nullptr, &delivered));
+  EXPECT_FALSE(pipeline.start(100.0f, onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  pipeline.stop();
+  EXPECT_FALSE(pipeline.isRunning());
+
+  size_t firstRun = delivered.timestamps.size();
+  ASSERT_TRUE(pipeline.start(100.0f, onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  pipeline.stop();
+  EXPECT_GT(delivered.timestamps.size(), firstRun);
+}
+
+TEST(VideoPipeline, AdaptiveControllerLowersFrameRate) {
+  SyntheticSource source;
+  SlowEncoder     encoder(std::chrono::milliseconds(20));
+  VideoPipeline   pipeline(source, encoder, 2);
+  Delivered       delivered;
+
+  // Only the frame rate may move, so an encode budget overrun must slow capture down
+  QualitySettings configured;
+  configured.frameRate = 100;
+  QualityBounds bounds;
+  bounds.minQuality = configured.quality;
+  bounds.minScale   = configured.scale;
+  QualityBudget budget;
+  budget.maxEncodeMsPerFrame = 5;
+  auto controller            = std::make_shared<AdaptiveQualityController>(budget, bounds, configured);
+  pipeline.setQualityController(controller);
+
+  ASSERT_TRUE(pipeline.start(100.0f, onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  pipeline.stop();
+
+  AdaptiveQualityStats stats = controller->stats();
+  EXPECT_GT(stats.downgrades, 0u);
+  EXPECT_EQ(stats.lastAdjustment, QualityAdjustment::LowerFrameRate);
+  EXPECT_GT(pipeline.frameInterval(), std::chrono::milliseconds(10));
+}
+
+TEST(VideoPipeline, FrameRateChangesWhileRunning) {
+  SyntheticSource source;
+  SlowEncoder     encoder(std::chrono::milliseconds(1));
+  VideoPipeline   pipeline(source, encoder);
+  Delivered       delivered;
+
+  ASSERT_TRUE(pipeline.start(10.0f, onVideoFrame, nullptr, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  pipeline.setFrameRate(200.0f);
+  EXPECT_EQ(pipeline.frameInterval(), std::chrono::microseconds(5000));
+  uint64_t before = source.produced.load();
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  pipeline.stop();
+
+  // At the old rate the second period would hold about three frames
+  EXPECT_GT(source.produced.load() - before, 10u);
+}
+
+TEST(VideoPipeline, CountsFailedFramesWithoutExiting) {
+  FailingSource source(1000000);
+  FlakyEncoder  encoder;
+  VideoPipeline pipeline(source, encoder);
+  Delivered     delivered;
+
+  ASSERT_TRUE(pipeline.start(200.0f, onVideoFrame, onExit, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  pipeline.stop();
+
+  VideoPipelineStats stats = pipeline.stats();
+  EXPECT_GT(stats.acquireFailures, 10u);
+  EXPECT_GT(stats.encodeFailures, 5u);
+  EXPECT_FALSE(delivered.timestamps.empty());
+  EXPECT_TRUE(delivered.exits.empty());
+}
+
+TEST(VideoPipeline, ReportsFatalErrorOnceAfterTheLastFrame) {
+  FailingSource source(6);
+  SlowEncoder   encoder(std::chrono::milliseconds(0));
+  VideoPipeline pipeline(source, encoder);
+  Delivered     delivered;
+
+  ASSERT_TRUE(pipeline.start(200.0f, onVideoFrame, onExit, &delivered));
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  uint64_t attempts = source.attempts.load();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  pipeline.stop();
+
+  ASSERT_EQ(delivered.exits.size(), 1u);
+  EXPECT_EQ(delivered.exits[0], "source gone");
+  EXPECT_EQ(delivered.framesAfterExit, 0u);
+  EXPECT_LE(delivered.timestamps.size(), 6u);
+  // The capture stage stopped with the fatal error
+  EXPECT_EQ(source.attempts.load(), attempts);
+}